@@ -20,6 +20,7 @@
 #include "absl/flags/marshalling.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "components/cloud_config/parameter_client.h"
 #include "public/constants.h"
@@ -70,6 +71,39 @@ ABSL_FLAG(std::string, telemetry_config, "mode: EXPERIMENT",
           "Telemetry configuration for exporting raw or noised metrics");
 ABSL_FLAG(std::string, data_loading_prefix_allowlist, "",
           "Allowlist for blob prefixes.");
+ABSL_FLAG(std::string, data_loading_readiness_policy, "all_prefixes",
+          "When to start serving during the initial data load: 'all_prefixes' "
+          "or 'critical_prefixes'.");
+ABSL_FLAG(std::string, data_loading_critical_prefixes, "",
+          "Blob prefixes loaded first during the initial data load.");
+ABSL_FLAG(std::string, data_loading_cache_checkpoint_directory, "",
+          "Local directory the cache is checkpointed to for warm restarts. "
+          "Disabled if empty.");
+ABSL_FLAG(absl::Duration, realtime_batch_window, absl::ZeroDuration(),
+          "How long realtime updates are batched before they are applied.");
+ABSL_FLAG(int32_t, realtime_max_batch_messages, 64,
+          "Maximum number of realtime messages applied in one batch.");
+ABSL_FLAG(int32_t, realtime_cleanup_batch_interval, 0,
+          "Deleted keys of realtime updates are removed once every this many "
+          "batches. Disabled if 0.");
+ABSL_FLAG(bool, cache_enable_key_filter, false,
+          "Whether the cache keeps a Bloom filter of its keys to skip lookups "
+          "of absent keys.");
+ABSL_FLAG(bool, cache_parse_json_values, false,
+          "Whether the cache parses values as JSON when they are loaded, for "
+          "V1 responses that are not routed to V2.");
+ABSL_FLAG(std::string, response_compression_algorithm, "none",
+          "Algorithm the compression groups of V2 responses are compressed "
+          "with, if the request accepts it: 'none', 'brotli' or 'gzip'.");
+ABSL_FLAG(int32_t, response_compression_level, -1,
+          "Brotli quality or zlib level of response compression. The default "
+          "of the algorithm if negative.");
+ABSL_FLAG(int64_t, response_compression_min_size_bytes, 0,
+          "Responses whose compression groups add up to fewer bytes are not "
+          "compressed.");
+ABSL_FLAG(int32_t, response_compression_num_threads, 4,
+          "Number of threads compressing the compression groups of "
+          "responses.");
 ABSL_FLAG(bool, add_missing_keys_v1, false,
           "Whether to add missing keys for v1.");
 ABSL_FLAG(bool, enable_consented_log, false, "Whether to enable consented log");
@@ -106,6 +140,44 @@ class LocalParameterClient : public ParameterClient {
     string_flag_values_.insert(
         {"kv-server-local-data-loading-blob-prefix-allowlist",
          absl::GetFlag(FLAGS_data_loading_prefix_allowlist)});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-readiness-policy",
+         absl::GetFlag(FLAGS_data_loading_readiness_policy)});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-critical-prefixes",
+         absl::GetFlag(FLAGS_data_loading_critical_prefixes)});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-cache-checkpoint-directory",
+         absl::GetFlag(FLAGS_data_loading_cache_checkpoint_directory)});
+    string_flag_values_.insert(
+        {"kv-server-local-realtime-batch-window-millis",
+         absl::StrCat(absl::ToInt64Milliseconds(
+             absl::GetFlag(FLAGS_realtime_batch_window)))});
+    string_flag_values_.insert(
+        {"kv-server-local-realtime-max-batch-messages",
+         absl::StrCat(absl::GetFlag(FLAGS_realtime_max_batch_messages))});
+    string_flag_values_.insert(
+        {"kv-server-local-realtime-cleanup-batch-interval",
+         absl::StrCat(absl::GetFlag(FLAGS_realtime_cleanup_batch_interval))});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-enable-key-filter",
+         absl::GetFlag(FLAGS_cache_enable_key_filter) ? "true" : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-parse-json-values",
+         absl::GetFlag(FLAGS_cache_parse_json_values) ? "true" : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-response-compression-algorithm",
+         absl::GetFlag(FLAGS_response_compression_algorithm)});
+    string_flag_values_.insert(
+        {"kv-server-local-response-compression-level",
+         absl::StrCat(absl::GetFlag(FLAGS_response_compression_level))});
+    string_flag_values_.insert(
+        {"kv-server-local-response-compression-min-size-bytes",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_response_compression_min_size_bytes))});
+    string_flag_values_.insert(
+        {"kv-server-local-response-compression-num-threads",
+         absl::StrCat(absl::GetFlag(FLAGS_response_compression_num_threads))});
     string_flag_values_.insert({"kv-server-local-consented-debug-token",
                                 absl::GetFlag(FLAGS_consented_debug_token)});
     // Insert more string flag values here.
@@ -15,12 +15,20 @@
  */
 
 #include <filesystem>
+#include <fstream>
 #include <string>
 #include <utility>
 
+#include "absl/log/log.h"
 #include "absl/status/statusor.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "components/data/blob_storage/blob_storage_change_notifier.h"
+#include "components/data/blob_storage/blob_storage_client_local.h"
+#include "components/data/blob_storage/delta_file_notifier.h"
 #include "gtest/gtest.h"
+#include "public/data_loading/filename_utils.h"
 
 namespace kv_server {
 namespace {
@@ -36,5 +44,50 @@ TEST(BlobStorageChangeNotifierLocalTest, SmokeTest) {
   EXPECT_TRUE(notifier.ok());
 }
 
+// Measures the time from writing a delta file into the local directory until
+// `DeltaFileNotifier` reports it, which is when the server starts loading it.
+TEST(BlobStorageChangeNotifierLocalTest, DeltaFileIsNotifiedPromptly) {
+  const std::filesystem::path directory =
+      std::filesystem::path(::testing::TempDir()) / "delta_latency";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  absl::StatusOr<std::unique_ptr<BlobStorageChangeNotifier>> change_notifier =
+      BlobStorageChangeNotifier::Create(
+          LocalNotifierMetadata{.local_directory = directory});
+  ASSERT_TRUE(change_notifier.ok());
+  privacy_sandbox::server_common::log::NoOpContext log_context;
+  FileBlobStorageClient blob_client(log_context);
+  auto delta_file_notifier = DeltaFileNotifier::Create(blob_client);
+
+  const std::string delta_file = ToDeltaFileName(1).value();
+  absl::Notification notified;
+  absl::Time notified_at;
+  auto callback = [&](const std::string& key) {
+    if (key == delta_file && !notified.HasBeenNotified()) {
+      notified_at = absl::Now();
+      notified.Notify();
+    }
+  };
+  ASSERT_TRUE(delta_file_notifier
+                  ->Start(**change_notifier, {.bucket = directory.string()},
+                          {{"", ""}}, std::move(callback))
+                  .ok());
+  // Let the notifier do its initial listing before the file is written.
+  absl::SleepFor(absl::Milliseconds(200));
+  const absl::Time written_at = absl::Now();
+  {
+    std::ofstream file(directory / delta_file);
+    file << "arbitrary file contents";
+  }
+  const bool was_notified =
+      notified.WaitForNotificationWithTimeout(absl::Seconds(10));
+  ASSERT_TRUE(delta_file_notifier->Stop().ok());
+  std::filesystem::remove_all(directory);
+  ASSERT_TRUE(was_notified);
+  const absl::Duration latency = notified_at - written_at;
+  LOG(INFO) << "Delta file visible to the data loader after " << latency;
+  EXPECT_LT(latency, absl::Seconds(1));
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -12,9 +12,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
@@ -31,6 +40,22 @@ using ::privacy_sandbox::server_common::SleepFor;
 
 // TODO(b/237669491): This is arbitrary, consider changing it.
 constexpr absl::Duration kPollInterval = absl::Seconds(5);
+// If inotify is available, the directory is only rescanned at this interval
+// in case an event was missed, e.g., because the event queue overflowed.
+constexpr absl::Duration kSafetyNetScanInterval = absl::Minutes(1);
+// Files are reported once they are completely written, either in place or
+// by moving them into the directory.
+constexpr uint32_t kInotifyMask = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+// Size and modification time of a file found by a safety net scan.
+struct FileState {
+  std::uintmax_t size;
+  std::filesystem::file_time_type last_write_time;
+
+  bool operator==(const FileState& other) const {
+    return size == other.size && last_write_time == other.last_write_time;
+  }
+};
 
 class LocalChangeNotifier : public ChangeNotifier {
  public:
@@ -38,6 +63,9 @@ class LocalChangeNotifier : public ChangeNotifier {
       std::filesystem::path local_directory,
       privacy_sandbox::server_common::log::PSLogContext& log_context)
       : local_directory_(local_directory), log_context_(log_context) {
+    // The watch is added before the initial scan so that no file is missed.
+    // Files found by both are deduplicated using `files_in_directory_`.
+    WatchDirectory();
     PS_VLOG(1, log_context_)
         << "Building initial list of local files in directory: "
         << local_directory_.string();
@@ -49,6 +77,7 @@ class LocalChangeNotifier : public ChangeNotifier {
     files_in_directory_ = std::move(status_or.value());
     PS_VLOG(1, log_context_)
         << "Found " << files_in_directory_.size() << " files.";
+    next_scan_time_ = absl::Now() + ScanInterval();
   }
 
   ~LocalChangeNotifier() {
@@ -57,6 +86,7 @@ class LocalChangeNotifier : public ChangeNotifier {
       PS_LOG(ERROR, log_context_)
           << "Error stopping LocalChangeNotifier SleepFor:" << status;
     }
+    CloseInotify();
   }
 
   absl::StatusOr<std::vector<std::string>> GetNotifications(
@@ -64,37 +94,199 @@ class LocalChangeNotifier : public ChangeNotifier {
       const std::function<bool()>& should_stop_callback) override {
     PS_LOG(INFO, log_context_)
         << "Watching for new files in directory: " << local_directory_.string();
-
+    const absl::Time deadline = absl::Now() + max_wait;
     while (true) {
       if (should_stop_callback()) {
         PS_VLOG(1, log_context_) << "Callback says to stop watching, stopping.";
         return std::vector<std::string>{};
       }
 
-      if (max_wait <= absl::ZeroDuration()) {
+      const absl::Time now = absl::Now();
+      if (deadline <= now) {
         PS_VLOG(1, log_context_)
             << "No new files found within timeout, stopping.";
         return absl::DeadlineExceededError("No messages found");
       }
 
-      auto status_or = FindNewFiles(files_in_directory_);
-      if (!status_or.ok()) {
-        return status_or.status();
+      absl::flat_hash_set<std::string> new_files;
+      if (inotify_fd_ >= 0) {
+        auto status_or = ReadInotifyEvents();
+        if (!status_or.ok()) {
+          return status_or.status();
+        }
+        new_files = *std::move(status_or);
+      }
+      // Without inotify, the directory is scanned on every iteration.
+      if (inotify_fd_ < 0 || now >= next_scan_time_) {
+        auto status_or = FindNewFiles(files_in_directory_);
+        if (!status_or.ok()) {
+          return status_or.status();
+        }
+        next_scan_time_ = now + ScanInterval();
+        if (inotify_fd_ >= 0) {
+          // Inotify only reports completely written files, so must the scan.
+          *status_or = TakeSettledFiles(*std::move(status_or), new_files);
+          if (!unsettled_files_.empty()) {
+            next_scan_time_ = now + kPollInterval;
+          }
+        }
+        new_files.insert(status_or->begin(), status_or->end());
       }
-      if (!status_or->empty()) {
+      if (!new_files.empty()) {
         PS_VLOG(1, log_context_) << "Found new local files.";
         // Add the new files to the running list so that they'll be ignored if
         // GetNotifications is called again.
-        files_in_directory_.insert(status_or->begin(), status_or->end());
-        return std::vector<std::string>{status_or->begin(), status_or->end()};
+        files_in_directory_.insert(new_files.begin(), new_files.end());
+        return std::vector<std::string>{new_files.begin(), new_files.end()};
       }
 
-      max_wait -= kPollInterval;
-      sleep_for_.Duration(kPollInterval);
+      // Wake up at least every `kPollInterval` to check
+      // `should_stop_callback`.
+      const absl::Duration wait = std::max(
+          std::min({deadline - now, next_scan_time_ - now, kPollInterval}),
+          absl::ZeroDuration());
+      if (inotify_fd_ >= 0) {
+        WaitForInotifyEvents(wait);
+      } else {
+        sleep_for_.Duration(wait);
+      }
     }
   }
 
  private:
+  absl::Duration ScanInterval() const {
+    return inotify_fd_ >= 0 ? kSafetyNetScanInterval : kPollInterval;
+  }
+
+  // Starts watching the directory with inotify. Falls back to polling the
+  // directory if that fails.
+  void WatchDirectory() {
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+      PS_LOG(WARNING, log_context_)
+          << "inotify_init1 failed: " << std::strerror(errno)
+          << ". Polling directory every " << kPollInterval << " instead.";
+      return;
+    }
+    if (inotify_add_watch(inotify_fd_, local_directory_.c_str(),
+                          kInotifyMask) < 0) {
+      PS_LOG(WARNING, log_context_)
+          << "inotify_add_watch failed for " << local_directory_.string()
+          << ": " << std::strerror(errno) << ". Polling directory every "
+          << kPollInterval << " instead.";
+      CloseInotify();
+    }
+  }
+
+  void CloseInotify() {
+    if (inotify_fd_ >= 0) {
+      close(inotify_fd_);
+      inotify_fd_ = -1;
+    }
+  }
+
+  // Waits until inotify events are available or `timeout` passes.
+  void WaitForInotifyEvents(absl::Duration timeout) const {
+    pollfd fd = {.fd = inotify_fd_, .events = POLLIN};
+    // Round up so that a timeout below 1ms does not turn into a busy loop.
+    const int timeout_ms = static_cast<int>(
+        absl::ToInt64Milliseconds(timeout + absl::Microseconds(999)));
+    if (poll(&fd, 1, timeout_ms) < 0 && errno != EINTR) {
+      PS_LOG(ERROR, log_context_) << "poll failed: " << std::strerror(errno);
+    }
+  }
+
+  // Drains pending inotify events and returns the names of files not in
+  // `files_in_directory_`.
+  absl::StatusOr<absl::flat_hash_set<std::string>> ReadInotifyEvents() {
+    absl::flat_hash_set<std::string> new_files;
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+      const ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+      if (length < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return new_files;
+        }
+        if (errno == EINTR) {
+          continue;
+        }
+        return absl::InternalError(absl::StrCat(
+            "Error reading inotify events: ", std::strerror(errno)));
+      }
+      for (const char* ptr = buffer; ptr < buffer + length;) {
+        const auto* event = reinterpret_cast<const inotify_event*>(ptr);
+        ptr += sizeof(inotify_event) + event->len;
+        if (event->mask & IN_Q_OVERFLOW) {
+          PS_LOG(WARNING, log_context_)
+              << "inotify event queue overflowed, rescanning directory.";
+          next_scan_time_ = absl::InfinitePast();
+          continue;
+        }
+        if (event->mask & IN_IGNORED) {
+          PS_LOG(WARNING, log_context_)
+              << "inotify watch for " << local_directory_.string()
+              << " was removed. Polling directory every " << kPollInterval
+              << " instead.";
+          CloseInotify();
+          next_scan_time_ = absl::InfinitePast();
+          return new_files;
+        }
+        if (event->len == 0 || (event->mask & IN_ISDIR) ||
+            !(event->mask & kInotifyMask)) {
+          continue;
+        }
+        std::string filename(event->name);
+        unsettled_files_.erase(filename);
+        if (!files_in_directory_.contains(filename)) {
+          PS_VLOG(1, log_context_) << "Found new file: " << filename;
+          new_files.insert(std::move(filename));
+        }
+      }
+    }
+  }
+
+  // Returns the files of `scanned_files` that are in `notified_files` or whose
+  // size and modification time did not change since the previous scan, i.e.,
+  // which are not being written anymore. The other files are kept in
+  // `unsettled_files_` to be checked again by the next scan.
+  absl::flat_hash_set<std::string> TakeSettledFiles(
+      absl::flat_hash_set<std::string> scanned_files,
+      const absl::flat_hash_set<std::string>& notified_files) {
+    absl::flat_hash_map<std::string, FileState> unsettled_files;
+    for (auto it = scanned_files.begin(); it != scanned_files.end();) {
+      const std::string& filename = *it;
+      const std::filesystem::path path = local_directory_ / filename;
+      std::error_code error_code;
+      FileState state;
+      state.size = std::filesystem::file_size(path, error_code);
+      if (!error_code) {
+        state.last_write_time =
+            std::filesystem::last_write_time(path, error_code);
+      }
+      if (error_code) {
+        // E.g., the file was removed since it was listed.
+        scanned_files.erase(it++);
+        continue;
+      }
+      if (notified_files.contains(filename)) {
+        ++it;
+        continue;
+      }
+      if (const auto unsettled_it = unsettled_files_.find(filename);
+          unsettled_it != unsettled_files_.end() &&
+          unsettled_it->second == state) {
+        ++it;
+        continue;
+      }
+      PS_VLOG(1, log_context_)
+          << "Waiting for file to be completely written: " << filename;
+      unsettled_files.emplace(filename, state);
+      scanned_files.erase(it++);
+    }
+    unsettled_files_ = std::move(unsettled_files);
+    return scanned_files;
+  }
+
   // Returns a set of file paths that are in the watched directory but not in
   // previous_files.  Returns just the filename, not the path.
   absl::StatusOr<absl::flat_hash_set<std::string>> FindNewFiles(
@@ -125,6 +317,12 @@ class LocalChangeNotifier : public ChangeNotifier {
   // We can't store std::filesystem::path objects in the set because the paths
   // aren't guaranteed to be canonical so we store the string paths instead.
   absl::flat_hash_set<std::string> files_in_directory_;
+  // Files found by a safety net scan that may still be written, with their
+  // state at the time of the scan.
+  absl::flat_hash_map<std::string, FileState> unsettled_files_;
+  // -1 if the directory is polled instead of watched with inotify.
+  int inotify_fd_ = -1;
+  absl::Time next_scan_time_;
   privacy_sandbox::server_common::log::PSLogContext& log_context_;
 };
 
@@ -18,10 +18,13 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "components/data/common/change_notifier.h"
 #include "gtest/gtest.h"
 
@@ -171,5 +174,78 @@ TEST_F(ChangeNotifierLocalTest, MultipleGetNotificationsCalls) {
   }
 }
 
+TEST_F(ChangeNotifierLocalTest, NewFileIsNotifiedWithoutWaitingForPollInterval) {
+  absl::StatusOr<std::unique_ptr<ChangeNotifier>> notifier =
+      ChangeNotifier::Create(
+          kv_server::LocalNotifierMetadata{::testing::TempDir()});
+  ASSERT_TRUE(notifier.ok());
+  auto should_stop_callback = []() { return false; };
+
+  absl::Time written_at;
+  std::thread writer([this, &written_at]() {
+    absl::SleepFor(absl::Milliseconds(100));
+    written_at = absl::Now();
+    CreateFileInTmpDir("DELTA_1");
+  });
+  const auto status_or =
+      (*notifier)->GetNotifications(absl::Seconds(10), should_stop_callback);
+  const absl::Time notified_at = absl::Now();
+  writer.join();
+
+  ASSERT_TRUE(status_or.ok()) << status_or.status();
+  EXPECT_EQ(status_or.value(), std::vector<std::string>{"DELTA_1"});
+  const absl::Duration latency = notified_at - written_at;
+  LOG(INFO) << "Delta file notified after " << latency;
+  // Polling the directory every 5 seconds would take up to 5 seconds.
+  EXPECT_LT(latency, absl::Seconds(1));
+}
+
+TEST_F(ChangeNotifierLocalTest, FileMovedIntoDirectoryIsNotified) {
+  const std::filesystem::path staging_dir =
+      std::filesystem::path(::testing::TempDir()) / "staging";
+  std::filesystem::create_directories(staging_dir);
+  {
+    std::ofstream file(staging_dir / "DELTA_1");
+    file << "arbitrary file contents";
+  }
+  absl::StatusOr<std::unique_ptr<ChangeNotifier>> notifier =
+      ChangeNotifier::Create(
+          kv_server::LocalNotifierMetadata{::testing::TempDir()});
+  ASSERT_TRUE(notifier.ok());
+  auto should_stop_callback = []() { return false; };
+
+  std::filesystem::rename(
+      staging_dir / "DELTA_1",
+      std::filesystem::path(::testing::TempDir()) / "DELTA_1");
+  const absl::Time start = absl::Now();
+  const auto status_or =
+      (*notifier)->GetNotifications(absl::Seconds(10), should_stop_callback);
+  ASSERT_TRUE(status_or.ok()) << status_or.status();
+  EXPECT_EQ(status_or.value(), std::vector<std::string>{"DELTA_1"});
+  EXPECT_LT(absl::Now() - start, absl::Seconds(1));
+}
+
+TEST_F(ChangeNotifierLocalTest, FileIsNotNotifiedBeforeItIsClosed) {
+  absl::StatusOr<std::unique_ptr<ChangeNotifier>> notifier =
+      ChangeNotifier::Create(
+          kv_server::LocalNotifierMetadata{::testing::TempDir()});
+  ASSERT_TRUE(notifier.ok());
+  auto should_stop_callback = []() { return false; };
+
+  const std::filesystem::path path =
+      std::filesystem::path(::testing::TempDir()) / "DELTA_1";
+  std::ofstream file(path);
+  file << "partially written file" << std::flush;
+  auto status_or = (*notifier)->GetNotifications(absl::Milliseconds(500),
+                                                  should_stop_callback);
+  EXPECT_EQ(absl::StatusCode::kDeadlineExceeded, status_or.status().code());
+
+  file.close();
+  status_or =
+      (*notifier)->GetNotifications(absl::Seconds(10), should_stop_callback);
+  ASSERT_TRUE(status_or.ok()) << status_or.status();
+  EXPECT_EQ(status_or.value(), std::vector<std::string>{"DELTA_1"});
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -0,0 +1,456 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data/converters/partition_output_cbor_writer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/str_cat.h"
+#include "nlohmann/json.hpp"
+
+namespace kv_server {
+namespace {
+
+inline constexpr std::string_view kPartitionId = "id";
+inline constexpr std::string_view kKeyGroupOutputs = "keyGroupOutputs";
+inline constexpr std::string_view kTags = "tags";
+inline constexpr std::string_view kKeyValues = "keyValues";
+inline constexpr std::string_view kValue = "value";
+
+// CBOR major types, see https://www.rfc-editor.org/rfc/rfc8949#section-3.1.
+inline constexpr uint8_t kCborUnsignedInteger = 0;
+inline constexpr uint8_t kCborTextString = 3;
+inline constexpr uint8_t kCborArray = 4;
+inline constexpr uint8_t kCborMap = 5;
+
+// Appends the head of a CBOR data item with the shortest encoding of
+// `argument`, which is what libcbor writes for definite length items.
+void AppendCborHead(uint8_t major_type, uint64_t argument,
+                    std::string& output) {
+  const char initial_byte = static_cast<char>(major_type << 5);
+  if (argument < 24) {
+    output.push_back(initial_byte | static_cast<char>(argument));
+    return;
+  }
+  int num_bytes = 8;
+  char additional_info = 27;
+  if (argument <= std::numeric_limits<uint8_t>::max()) {
+    num_bytes = 1;
+    additional_info = 24;
+  } else if (argument <= std::numeric_limits<uint16_t>::max()) {
+    num_bytes = 2;
+    additional_info = 25;
+  } else if (argument <= std::numeric_limits<uint32_t>::max()) {
+    num_bytes = 4;
+    additional_info = 26;
+  }
+  output.push_back(initial_byte | additional_info);
+  for (int i = num_bytes - 1; i >= 0; --i) {
+    output.push_back(static_cast<char>(argument >> (8 * i)));
+  }
+}
+
+void AppendCborText(std::string_view text, std::string& output) {
+  AppendCborHead(kCborTextString, text.size(), output);
+  output.append(text);
+}
+
+// Parses strings that only hold an integer, without whitespace or a "+".
+std::optional<int64_t> ParseInt64(std::string_view text) {
+  int64_t value;
+  const auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc() || end != text.data() + text.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+enum class JsonType { kNull, kBoolean, kNumber, kString, kObject, kArray };
+
+// JSON object or array that is being transcoded.
+enum class Context {
+  kRoot,
+  kPartitionOutput,
+  kKeyGroupOutputs,
+  kKeyGroupOutput,
+  kTags,
+  kKeyValues,
+  kValueObject,
+};
+
+// Fields of the `PartitionOutput`, `KeyGroupOutput` and `ValueObject` protos.
+enum class Field {
+  kUnknown,
+  kId,
+  kKeyGroupOutputs,
+  kUdfOutputApiVersion,
+  kTags,
+  kKeyValues,
+  kValue,
+};
+
+// Accepts the JSON names and the original proto field names, like the
+// protobuf JSON parser.
+Field GetField(Context context, std::string_view name) {
+  switch (context) {
+    case Context::kPartitionOutput:
+      if (name == kPartitionId) {
+        return Field::kId;
+      }
+      if (name == kKeyGroupOutputs || name == "key_group_outputs") {
+        return Field::kKeyGroupOutputs;
+      }
+      if (name == "udfOutputApiVersion" || name == "udf_output_api_version") {
+        return Field::kUdfOutputApiVersion;
+      }
+      break;
+    case Context::kKeyGroupOutput:
+      if (name == kTags) {
+        return Field::kTags;
+      }
+      if (name == kKeyValues || name == "key_values") {
+        return Field::kKeyValues;
+      }
+      break;
+    case Context::kValueObject:
+      if (name == kValue) {
+        return Field::kValue;
+      }
+      break;
+    default:
+      break;
+  }
+  return Field::kUnknown;
+}
+
+// SAX handler that transcodes one partition output from JSON to CBOR. The
+// partition output and key group output headers are written before their
+// contents, and the key group output count is inserted once it is known.
+// The key-values of a key group output are buffered to be sorted.
+class PartitionOutputTranscoder : public nlohmann::json::json_sax_t {
+ public:
+  PartitionOutputTranscoder(int32_t id, std::string& output)
+      : id_(id), output_(output) {}
+
+  const absl::Status& status() const { return status_; }
+
+  bool null() override { return OnValue(JsonType::kNull); }
+
+  bool boolean(bool value) override { return OnValue(JsonType::kBoolean); }
+
+  bool number_integer(number_integer_t value) override {
+    return OnValue(JsonType::kNumber, value);
+  }
+
+  bool number_unsigned(number_unsigned_t value) override {
+    if (value > std::numeric_limits<int64_t>::max()) {
+      return OnValue(JsonType::kNumber);
+    }
+    return OnValue(JsonType::kNumber, static_cast<int64_t>(value));
+  }
+
+  bool number_float(number_float_t value, const string_t& text) override {
+    // Integral numbers may be written with a fraction or an exponent.
+    if (std::trunc(value) == value && value >= -0x1p63 && value < 0x1p63) {
+      return OnValue(JsonType::kNumber, static_cast<int64_t>(value));
+    }
+    return OnValue(JsonType::kNumber);
+  }
+
+  bool string(string_t& value) override {
+    if (ignored_depth_ > 0) {
+      return true;
+    }
+    // Integer fields may also be written as strings.
+    std::optional<int64_t> integer;
+    if (stack_.back().context == Context::kPartitionOutput) {
+      integer = ParseInt64(value);
+    }
+    if (!OnValue(JsonType::kString, integer)) {
+      return false;
+    }
+    if (stack_.back().context == Context::kTags) {
+      tags_.push_back(std::move(value));
+    } else if (stack_.back().context == Context::kValueObject) {
+      value_ = std::move(value);
+    }
+    return true;
+  }
+
+  bool binary(binary_t& value) override {
+    return Fail("Unexpected binary value");
+  }
+
+  bool start_object(std::size_t size) override {
+    return OnValue(JsonType::kObject);
+  }
+
+  bool key(string_t& key) override {
+    if (ignored_depth_ > 0) {
+      return true;
+    }
+    Frame& frame = stack_.back();
+    if (frame.context == Context::kKeyValues) {
+      key_ = std::move(key);
+      return true;
+    }
+    field_ = GetField(frame.context, key);
+    if (field_ == Field::kUnknown) {
+      return Fail(absl::StrCat("Unknown field: ", key));
+    }
+    const uint32_t field_bit = 1u << static_cast<int>(field_);
+    if ((frame.seen_fields & field_bit) != 0) {
+      return Fail(absl::StrCat("Duplicate field: ", key));
+    }
+    frame.seen_fields |= field_bit;
+    return true;
+  }
+
+  bool end_object() override { return OnEnd(); }
+
+  bool start_array(std::size_t size) override {
+    return OnValue(JsonType::kArray);
+  }
+
+  bool end_array() override { return OnEnd(); }
+
+  bool parse_error(std::size_t position, const std::string& last_token,
+                   const nlohmann::json::exception& error) override {
+    status_ = absl::InvalidArgumentError(error.what());
+    return false;
+  }
+
+ private:
+  struct Frame {
+    Context context;
+    // Bit set of the fields of an object that were already parsed.
+    uint32_t seen_fields = 0;
+  };
+
+  bool Fail(absl::string_view message) {
+    status_ = absl::InvalidArgumentError(
+        absl::StrCat("Invalid partition output: ", message));
+    return false;
+  }
+
+  // Accepts `null` for the default value, or a container of the expected
+  // type, which becomes the current context.
+  bool OnFieldValue(JsonType type, JsonType expected_type, Context context) {
+    if (type == JsonType::kNull) {
+      return true;
+    }
+    if (type != expected_type) {
+      return Fail("Unexpected value type");
+    }
+    stack_.push_back({.context = context});
+    return true;
+  }
+
+  // Called for every JSON value, before the contents of objects and arrays.
+  // `integer` is set for numbers and strings that hold an int64 value.
+  bool OnValue(JsonType type, std::optional<int64_t> integer = std::nullopt) {
+    const bool is_container =
+        type == JsonType::kObject || type == JsonType::kArray;
+    if (ignored_depth_ > 0) {
+      ignored_depth_ += is_container ? 1 : 0;
+      return true;
+    }
+    switch (stack_.back().context) {
+      case Context::kRoot:
+        if (type != JsonType::kObject) {
+          return Fail("Not a JSON object");
+        }
+        StartPartitionOutput();
+        stack_.push_back({.context = Context::kPartitionOutput});
+        return true;
+      case Context::kPartitionOutput:
+        switch (field_) {
+          case Field::kId:
+            return type == JsonType::kNull || integer.has_value() ||
+                   Fail("Invalid id");
+          case Field::kUdfOutputApiVersion:
+            return type == JsonType::kNull ||
+                   (integer.has_value() &&
+                    *integer >= std::numeric_limits<int32_t>::min() &&
+                    *integer <= std::numeric_limits<int32_t>::max()) ||
+                   Fail("Invalid udfOutputApiVersion");
+          default:
+            return OnFieldValue(type, JsonType::kArray,
+                                Context::kKeyGroupOutputs);
+        }
+      case Context::kKeyGroupOutputs:
+        if (type != JsonType::kObject) {
+          return Fail("Key group output is not a JSON object");
+        }
+        tags_.clear();
+        key_values_.clear();
+        stack_.push_back({.context = Context::kKeyGroupOutput});
+        return true;
+      case Context::kKeyGroupOutput:
+        if (field_ == Field::kTags) {
+          return OnFieldValue(type, JsonType::kArray, Context::kTags);
+        }
+        return OnFieldValue(type, JsonType::kObject, Context::kKeyValues);
+      case Context::kTags:
+        return type == JsonType::kString || Fail("Tag is not a string");
+      case Context::kKeyValues:
+        if (type != JsonType::kObject) {
+          return Fail(absl::StrCat("Value of ", key_, " is not an object"));
+        }
+        value_.clear();
+        stack_.push_back({.context = Context::kValueObject});
+        return true;
+      case Context::kValueObject:
+        // Any JSON value is a valid `google.protobuf.Value`, but only string
+        // values are encoded.
+        ignored_depth_ = is_container ? 1 : 0;
+        return true;
+    }
+    return true;
+  }
+
+  // Called at the end of every JSON object and array.
+  bool OnEnd() {
+    if (ignored_depth_ > 0) {
+      --ignored_depth_;
+      return true;
+    }
+    const Context context = stack_.back().context;
+    stack_.pop_back();
+    switch (context) {
+      case Context::kPartitionOutput:
+        EndPartitionOutput();
+        return true;
+      case Context::kKeyGroupOutput:
+        return EndKeyGroupOutput();
+      case Context::kValueObject:
+        key_values_.emplace_back(std::move(key_), std::move(value_));
+        return true;
+      default:
+        return true;
+    }
+  }
+
+  void StartPartitionOutput() {
+    AppendCborHead(kCborMap, 2, output_);
+    AppendCborText(kPartitionId, output_);
+    // The id is encoded as uint32, like `PartitionOutputsCborEncode` does.
+    AppendCborHead(kCborUnsignedInteger, static_cast<uint32_t>(id_), output_);
+    AppendCborText(kKeyGroupOutputs, output_);
+    key_group_outputs_offset_ = output_.size();
+  }
+
+  void EndPartitionOutput() {
+    std::string head;
+    AppendCborHead(kCborArray, num_key_group_outputs_, head);
+    output_.insert(key_group_outputs_offset_, head);
+  }
+
+  bool EndKeyGroupOutput() {
+    if (key_values_.empty()) {
+      return true;
+    }
+    // This is a requirement by Chrome to follow
+    // https://datatracker.ietf.org/doc/html/rfc7049#section-3.9
+    std::sort(key_values_.begin(), key_values_.end(),
+              [](const auto& lhs, const auto& rhs) {
+                if (lhs.first.size() != rhs.first.size()) {
+                  return lhs.first.size() < rhs.first.size();
+                }
+                return lhs.first < rhs.first;
+              });
+    if (auto duplicate = std::adjacent_find(
+            key_values_.begin(), key_values_.end(),
+            [](const auto& lhs, const auto& rhs) {
+              return lhs.first == rhs.first;
+            });
+        duplicate != key_values_.end()) {
+      return Fail(absl::StrCat("Duplicate key: ", duplicate->first));
+    }
+    AppendCborHead(kCborMap, 2, output_);
+    AppendCborText(kTags, output_);
+    AppendCborHead(kCborArray, tags_.size(), output_);
+    for (const auto& tag : tags_) {
+      AppendCborText(tag, output_);
+    }
+    AppendCborText(kKeyValues, output_);
+    AppendCborHead(kCborMap, key_values_.size(), output_);
+    for (const auto& [key, value] : key_values_) {
+      AppendCborText(key, output_);
+      AppendCborHead(kCborMap, 1, output_);
+      AppendCborText(kValue, output_);
+      AppendCborText(value, output_);
+    }
+    ++num_key_group_outputs_;
+    return true;
+  }
+
+  const int32_t id_;
+  std::string& output_;
+  absl::Status status_;
+  absl::InlinedVector<Frame, 8> stack_ = {{.context = Context::kRoot}};
+  // Field of the innermost proto object that the next value belongs to.
+  Field field_ = Field::kUnknown;
+  // Nesting depth inside of a non-string `google.protobuf.Value`.
+  int ignored_depth_ = 0;
+  size_t key_group_outputs_offset_ = 0;
+  int64_t num_key_group_outputs_ = 0;
+  // Contents of the current key group output.
+  std::vector<std::string> tags_;
+  std::vector<std::pair<std::string, std::string>> key_values_;
+  // Key and value of the current key-value.
+  std::string key_;
+  std::string value_;
+};
+
+}  // namespace
+
+PartitionOutputsCborWriter::PartitionOutputsCborWriter(int64_t expected_size)
+    : expected_size_(expected_size) {
+  AppendCborHead(kCborArray, expected_size_, output_);
+  header_size_ = output_.size();
+}
+
+absl::Status PartitionOutputsCborWriter::Add(
+    int32_t id, std::string_view partition_output_json) {
+  const size_t offset = output_.size();
+  PartitionOutputTranscoder transcoder(id, output_);
+  if (!nlohmann::json::sax_parse(partition_output_json, &transcoder)) {
+    output_.resize(offset);
+    return transcoder.status();
+  }
+  ++size_;
+  return absl::OkStatus();
+}
+
+std::string PartitionOutputsCborWriter::Finish() && {
+  if (size_ != expected_size_) {
+    std::string head;
+    AppendCborHead(kCborArray, size_, head);
+    output_.replace(0, header_size_, head);
+  }
+  return std::move(output_);
+}
+
+}  // namespace kv_server
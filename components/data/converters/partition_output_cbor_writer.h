@@ -0,0 +1,64 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_CONVERTERS_PARTITION_OUTPUT_CBOR_WRITER_H_
+#define COMPONENTS_DATA_CONVERTERS_PARTITION_OUTPUT_CBOR_WRITER_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "absl/status/status.h"
+
+namespace kv_server {
+
+// Writes a CBOR array of UDF partition outputs, transcoding each partition
+// output straight from the JSON returned by the UDF into the output buffer.
+//
+// The JSON is validated like `application_pa::PartitionOutputFromJson` does,
+// i.e., unknown fields, duplicate fields and map keys, and values of the wrong
+// type are rejected. The resulting bytes are the same as the ones of
+// `PartitionOutputsCborEncode` for the parsed `PartitionOutput`s: key groups
+// without key-values are dropped, the key-values are sorted by key length and
+// then lexicographically, and values that are not strings are encoded as
+// empty strings.
+class PartitionOutputsCborWriter {
+ public:
+  // `expected_size` is the number of partition outputs that are expected to
+  // be added. The array header is only rewritten if the number differs.
+  explicit PartitionOutputsCborWriter(int64_t expected_size);
+
+  // Appends the partition output `partition_output_json` with its id set to
+  // `id`. On error, nothing is appended.
+  absl::Status Add(int32_t id, std::string_view partition_output_json);
+
+  // Number of partition outputs added so far.
+  int64_t size() const { return size_; }
+
+  // Returns the CBOR array of the partition outputs added so far.
+  std::string Finish() &&;
+
+ private:
+  const int64_t expected_size_;
+  // Size of the array header written for `expected_size_`.
+  size_t header_size_;
+  int64_t size_ = 0;
+  std::string output_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_CONVERTERS_PARTITION_OUTPUT_CBOR_WRITER_H_
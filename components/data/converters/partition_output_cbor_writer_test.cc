@@ -0,0 +1,259 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data/converters/partition_output_cbor_writer.h"
+
+#include <string>
+#include <vector>
+
+#include "components/data/converters/cbor_converter.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "public/applications/pa/response_utils.h"
+
+namespace kv_server {
+namespace {
+
+using ordered_json = nlohmann::ordered_json;
+
+std::string ToCbor(const ordered_json& json) {
+  std::vector<uint8_t> cbor = ordered_json::to_cbor(json);
+  return std::string(cbor.begin(), cbor.end());
+}
+
+TEST(PartitionOutputsCborWriterTest, EncodesPartitionOutputs) {
+  PartitionOutputsCborWriter writer(/*expected_size=*/2);
+  ASSERT_TRUE(writer
+                  .Add(0, R"({
+                    "keyGroupOutputs": [{
+                      "tags": ["custom", "keys"],
+                      "keyValues": {"hello": {"value": "world"}}
+                    }]
+                  })")
+                  .ok());
+  ASSERT_TRUE(writer
+                  .Add(1, R"({
+                    "id": 100,
+                    "keyGroupOutputs": [{
+                      "tags": ["structured", "groupNames"],
+                      "keyValues": {
+                        "hello2": {"value": "world2"},
+                        "b": {"value": "\"quoted\" é"},
+                        "a": {"value": "a"}
+                      }
+                    }]
+                  })")
+                  .ok());
+  EXPECT_EQ(writer.size(), 2);
+
+  ordered_json expected = ordered_json::parse(R"([
+    {
+      "id": 0,
+      "keyGroupOutputs": [{
+        "tags": ["custom", "keys"],
+        "keyValues": {"hello": {"value": "world"}}
+      }]
+    },
+    {
+      "id": 1,
+      "keyGroupOutputs": [{
+        "tags": ["structured", "groupNames"],
+        "keyValues": {
+          "a": {"value": "a"},
+          "b": {"value": "\"quoted\" é"},
+          "hello2": {"value": "world2"}
+        }
+      }]
+    }
+  ])");
+  EXPECT_EQ(std::move(writer).Finish(), ToCbor(expected));
+}
+
+TEST(PartitionOutputsCborWriterTest, DropsKeyGroupOutputsWithoutKeyValues) {
+  PartitionOutputsCborWriter writer(/*expected_size=*/1);
+  ASSERT_TRUE(writer
+                  .Add(5, R"({
+                    "keyGroupOutputs": [
+                      {"tags": ["custom", "keys"], "keyValues": {}},
+                      {"tags": ["custom", "keys"]},
+                      {"keyValues": {"key": {"value": "value"}}}
+                    ]
+                  })")
+                  .ok());
+
+  ordered_json expected = ordered_json::parse(R"([
+    {
+      "id": 5,
+      "keyGroupOutputs": [
+        {"tags": [], "keyValues": {"key": {"value": "value"}}}
+      ]
+    }
+  ])");
+  EXPECT_EQ(std::move(writer).Finish(), ToCbor(expected));
+}
+
+TEST(PartitionOutputsCborWriterTest, EncodesNonStringValuesAsEmptyStrings) {
+  PartitionOutputsCborWriter writer(/*expected_size=*/1);
+  ASSERT_TRUE(writer
+                  .Add(1, R"({
+                    "keyGroupOutputs": [{
+                      "tags": ["keys"],
+                      "keyValues": {
+                        "null": {"value": null},
+                        "number": {"value": 1.5},
+                        "object": {"value": {"a": ["b", {"c": "d"}]}},
+                        "list": {"value": [1, "two", {}]},
+                        "missing": {}
+                      }
+                    }]
+                  })")
+                  .ok());
+
+  ordered_json expected = ordered_json::parse(R"([
+    {
+      "id": 1,
+      "keyGroupOutputs": [{
+        "tags": ["keys"],
+        "keyValues": {
+          "list": {"value": ""},
+          "null": {"value": ""},
+          "number": {"value": ""},
+          "object": {"value": ""},
+          "missing": {"value": ""}
+        }
+      }]
+    }
+  ])");
+  EXPECT_EQ(std::move(writer).Finish(), ToCbor(expected));
+}
+
+TEST(PartitionOutputsCborWriterTest, AcceptsProtoFieldNamesAndDefaults) {
+  PartitionOutputsCborWriter writer(/*expected_size=*/3);
+  EXPECT_TRUE(writer
+                  .Add(1, R"({
+                    "id": "7",
+                    "udf_output_api_version": 1,
+                    "key_group_outputs": [{
+                      "tags": null,
+                      "key_values": {"key": {"value": "value"}}
+                    }]
+                  })")
+                  .ok());
+  EXPECT_TRUE(writer.Add(2, R"({"udfOutputApiVersion": 1.0})").ok());
+  EXPECT_TRUE(writer.Add(3, R"({"id": null, "keyGroupOutputs": null})").ok());
+
+  ordered_json expected = ordered_json::parse(R"([
+    {
+      "id": 1,
+      "keyGroupOutputs": [
+        {"tags": [], "keyValues": {"key": {"value": "value"}}}
+      ]
+    },
+    {"id": 2, "keyGroupOutputs": []},
+    {"id": 3, "keyGroupOutputs": []}
+  ])");
+  EXPECT_EQ(std::move(writer).Finish(), ToCbor(expected));
+}
+
+TEST(PartitionOutputsCborWriterTest, RejectsInvalidPartitionOutputs) {
+  for (const auto* partition_output_json : {
+           R"("json_string_not_object")",
+           R"({"keyGroupOtputs": []})",
+           R"({"keyGroupOutputs": [}])",
+           R"({"keyGroupOutputs": {}})",
+           R"({"keyGroupOutputs": [[]]})",
+           R"({"id": "one"})",
+           R"({"id": 1.5})",
+           R"({"id": 1, "id": 2})",
+           R"({"udfOutputApiVersion": 4294967296})",
+           R"({"keyGroupOutputs": [], "key_group_outputs": []})",
+           R"({"keyGroupOutputs": [{"tags": [1]}]})",
+           R"({"keyGroupOutputs": [{"tags": "keys"}]})",
+           R"({"keyGroupOutputs": [{"keyValues": {"key": "value"}}]})",
+           R"({"keyGroupOutputs": [{"keyValues": {"key": {"val": ""}}}]})",
+           R"({"keyGroupOutputs": [{"keyValues": {"k": {}, "k": {}}}]})",
+           R"({"keyGroupOutputs": [{"unknown": {}}]})",
+           R"({} {})",
+       }) {
+    PartitionOutputsCborWriter writer(/*expected_size=*/1);
+    const auto status = writer.Add(1, partition_output_json);
+    EXPECT_FALSE(status.ok()) << partition_output_json;
+    EXPECT_EQ(writer.size(), 0);
+    EXPECT_EQ(std::move(writer).Finish(), ToCbor(ordered_json::array()));
+  }
+}
+
+TEST(PartitionOutputsCborWriterTest, SkipsInvalidPartitionOutputs) {
+  PartitionOutputsCborWriter writer(/*expected_size=*/3);
+  EXPECT_TRUE(writer.Add(1, R"({"keyGroupOutputs": []})").ok());
+  EXPECT_FALSE(
+      writer.Add(2, R"({"keyGroupOutputs": [{"keyValues": {"a": 1}}]})").ok());
+  EXPECT_TRUE(writer.Add(3, R"({"keyGroupOutputs": []})").ok());
+
+  ordered_json expected = ordered_json::parse(R"([
+    {"id": 1, "keyGroupOutputs": []},
+    {"id": 3, "keyGroupOutputs": []}
+  ])");
+  EXPECT_EQ(std::move(writer).Finish(), ToCbor(expected));
+}
+
+TEST(PartitionOutputsCborWriterTest, RewritesArrayHeaderOfDifferentSize) {
+  PartitionOutputsCborWriter writer(/*expected_size=*/300);
+  ordered_json expected = ordered_json::array();
+  for (int id = 0; id < 20; ++id) {
+    ASSERT_TRUE(writer.Add(id, R"({"keyGroupOutputs": []})").ok());
+    expected.push_back(
+        {{"id", id}, {"keyGroupOutputs", ordered_json::array()}});
+  }
+  EXPECT_EQ(std::move(writer).Finish(), ToCbor(expected));
+}
+
+TEST(PartitionOutputsCborWriterTest, MatchesPartitionOutputsCborEncode) {
+  const std::vector<std::string> partition_output_jsons = {
+      R"({"keyGroupOutputs": []})",
+      R"({
+        "id": 3,
+        "keyGroupOutputs": [
+          {
+            "tags": ["custom", "keys"],
+            "keyValues": {
+              "longer_key": {"value": "v1"},
+              "key": {"value": {"nested": [1, 2, 3]}},
+              "kez": {"value": "v2"}
+            }
+          },
+          {"tags": ["renderUrls"]},
+          {"tags": [], "keyValues": {"": {"value": ""}}}
+        ]
+      })",
+  };
+  google::protobuf::RepeatedPtrField<application_pa::PartitionOutput>
+      partition_outputs;
+  PartitionOutputsCborWriter writer(partition_output_jsons.size());
+  for (int i = 0; i < static_cast<int>(partition_output_jsons.size()); ++i) {
+    auto partition_output =
+        application_pa::PartitionOutputFromJson(partition_output_jsons[i]);
+    ASSERT_TRUE(partition_output.ok()) << partition_output.status();
+    partition_output->set_id(i);
+    *partition_outputs.Add() = *std::move(partition_output);
+    ASSERT_TRUE(writer.Add(i, partition_output_jsons[i]).ok());
+  }
+  const auto expected = PartitionOutputsCborEncode(partition_outputs);
+  ASSERT_TRUE(expected.ok()) << expected.status();
+  EXPECT_EQ(std::move(writer).Finish(), *expected);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,122 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "components/data_server/cache/bloom_filter.h"
+
+#include <algorithm>
+
+#include "absl/hash/hash.h"
+
+namespace kv_server {
+namespace {
+
+constexpr int64_t kBitsPerKey = 12;
+constexpr int64_t kBitsPerBlock = 256;
+constexpr int64_t kGrowthFactor = 4;
+
+// Odd multipliers that pick the bit set in each word of a block, see
+// https://github.com/apache/parquet-format/blob/master/BloomFilter.md.
+constexpr uint32_t kSalts[] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU,
+                               0xa2b7289dU, 0x705495c7U, 0x2df1424bU,
+                               0x9efc4947U, 0x5c6bfb31U};
+
+uint32_t GetMask(uint64_t hash, int word) {
+  return uint32_t{1} << ((static_cast<uint32_t>(hash) * kSalts[word]) >> 27);
+}
+
+uint64_t Hash(std::string_view key) {
+  return absl::Hash<std::string_view>()(key);
+}
+
+}  // namespace
+
+BlockedBloomFilter::BlockedBloomFilter(int64_t capacity)
+    : capacity_(std::max<int64_t>(capacity, 1)),
+      num_blocks_((capacity_ * kBitsPerKey + kBitsPerBlock - 1) /
+                  kBitsPerBlock),
+      words_(num_blocks_ * kWordsPerBlock) {}
+
+int64_t BlockedBloomFilter::GetBlockOffset(uint64_t hash) const {
+  // Maps the upper half of the hash onto [0, num_blocks_) without a division.
+  const uint64_t block =
+      ((hash >> 32) * static_cast<uint64_t>(num_blocks_)) >> 32;
+  return static_cast<int64_t>(block) * kWordsPerBlock;
+}
+
+void BlockedBloomFilter::Add(uint64_t hash) {
+  std::atomic<uint32_t>* block = &words_[GetBlockOffset(hash)];
+  for (int i = 0; i < kWordsPerBlock; ++i) {
+    block[i].fetch_or(GetMask(hash, i), std::memory_order_release);
+  }
+}
+
+bool BlockedBloomFilter::MayContain(uint64_t hash) const {
+  const std::atomic<uint32_t>* block = &words_[GetBlockOffset(hash)];
+  for (int i = 0; i < kWordsPerBlock; ++i) {
+    if ((block[i].load(std::memory_order_acquire) & GetMask(hash, i)) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ScalableBloomFilter::ScalableBloomFilter(int64_t initial_capacity)
+    : num_filters_(1), num_keys_in_last_filter_(0) {
+  filters_[0] = std::make_unique<BlockedBloomFilter>(initial_capacity);
+}
+
+void ScalableBloomFilter::Add(std::string_view key) {
+  const uint64_t hash = Hash(key);
+  // Keys that already test positive are not added again, so that updates of
+  // existing keys do not count towards the capacity of the last filter.
+  if (MayContain(hash)) {
+    return;
+  }
+  const int num_filters = num_filters_.load(std::memory_order_acquire);
+  BlockedBloomFilter& filter = *filters_[num_filters - 1];
+  filter.Add(hash);
+  if (num_keys_in_last_filter_.fetch_add(1, std::memory_order_relaxed) + 1 >
+          filter.capacity() &&
+      num_filters < kMaxFilters) {
+    Grow(num_filters);
+  }
+}
+
+bool ScalableBloomFilter::MayContain(std::string_view key) const {
+  return MayContain(Hash(key));
+}
+
+bool ScalableBloomFilter::MayContain(uint64_t hash) const {
+  const int num_filters = num_filters_.load(std::memory_order_acquire);
+  // Newer filters are larger, so they are more likely to have the key.
+  for (int i = num_filters - 1; i >= 0; --i) {
+    if (filters_[i]->MayContain(hash)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ScalableBloomFilter::Grow(int num_filters) {
+  absl::MutexLock lock(&grow_mutex_);
+  // Another writer already grew the filter.
+  if (num_filters_.load(std::memory_order_relaxed) != num_filters) {
+    return;
+  }
+  filters_[num_filters] = std::make_unique<BlockedBloomFilter>(
+      filters_[num_filters - 1]->capacity() * kGrowthFactor);
+  num_keys_in_last_filter_.store(0, std::memory_order_relaxed);
+  num_filters_.store(num_filters + 1, std::memory_order_release);
+}
+
+}  // namespace kv_server
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_BLOOM_FILTER_H_
+#define COMPONENTS_DATA_SERVER_CACHE_BLOOM_FILTER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace kv_server {
+
+// Split block Bloom filter with a fixed capacity. Each key sets one bit in each
+// of the 8 words of a single 256 bit block, so a lookup touches one cache line.
+// At capacity, the false positive rate is about 0.5%.
+//
+// `Add` and `MayContain` may be called concurrently from any thread. Keys can
+// not be removed.
+class BlockedBloomFilter {
+ public:
+  explicit BlockedBloomFilter(int64_t capacity);
+
+  void Add(uint64_t hash);
+  bool MayContain(uint64_t hash) const;
+
+  int64_t capacity() const { return capacity_; }
+
+ private:
+  static constexpr int kWordsPerBlock = 8;
+
+  // Returns the index of the first word of the block of `hash`.
+  int64_t GetBlockOffset(uint64_t hash) const;
+
+  const int64_t capacity_;
+  const int64_t num_blocks_;
+  std::vector<std::atomic<uint32_t>> words_;
+};
+
+// Bloom filter of strings that grows with the number of keys added to it, by
+// adding filters with four times the capacity of the previous one. Lookups
+// check all the filters, so the number of keys does not need to be known up
+// front. The false positive rate is below 1% per filter, i.e., it grows
+// slowly, with the logarithm of the number of keys.
+//
+// `Add` and `MayContain` may be called concurrently from any thread, and
+// `MayContain` never blocks. Keys can not be removed, so keys that were
+// removed from the owning container keep testing positive.
+class ScalableBloomFilter {
+ public:
+  explicit ScalableBloomFilter(int64_t initial_capacity = 1 << 16);
+
+  void Add(std::string_view key);
+  bool MayContain(std::string_view key) const;
+
+ private:
+  // With the default initial capacity, the last filter holds 2^46 keys. Once
+  // it is full, it keeps taking keys at a higher false positive rate.
+  static constexpr int kMaxFilters = 16;
+
+  bool MayContain(uint64_t hash) const;
+  void Grow(int num_filters);
+
+  // Filters at index `num_filters_` and above are only written by `Grow`,
+  // under `grow_mutex_`, before they are published by `num_filters_`.
+  std::array<std::unique_ptr<BlockedBloomFilter>, kMaxFilters> filters_;
+  std::atomic<int> num_filters_;
+  // Number of keys added to the last filter.
+  std::atomic<int64_t> num_keys_in_last_filter_;
+  absl::Mutex grow_mutex_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_BLOOM_FILTER_H_
@@ -0,0 +1,112 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/bloom_filter.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+// Returns the fraction of keys that were never added that test positive.
+double GetFalsePositiveRate(const ScalableBloomFilter& filter,
+                            int64_t num_keys) {
+  int64_t false_positives = 0;
+  for (int64_t i = 0; i < num_keys; ++i) {
+    if (filter.MayContain(absl::StrCat("absent", i))) {
+      ++false_positives;
+    }
+  }
+  return static_cast<double>(false_positives) / num_keys;
+}
+
+TEST(ScalableBloomFilterTest, EmptyFilterHasNoKeys) {
+  ScalableBloomFilter filter;
+  EXPECT_FALSE(filter.MayContain(""));
+  EXPECT_FALSE(filter.MayContain("key"));
+}
+
+TEST(ScalableBloomFilterTest, AddedKeysArePresent) {
+  ScalableBloomFilter filter;
+  filter.Add("key1");
+  filter.Add("");
+  EXPECT_TRUE(filter.MayContain("key1"));
+  EXPECT_TRUE(filter.MayContain(""));
+  EXPECT_FALSE(filter.MayContain("key2"));
+}
+
+TEST(ScalableBloomFilterTest, GrowsWithoutFalseNegatives) {
+  // Small initial capacity, so that the keys span several filters.
+  ScalableBloomFilter filter(/*initial_capacity=*/64);
+  constexpr int64_t kNumKeys = 100000;
+  for (int64_t i = 0; i < kNumKeys; ++i) {
+    filter.Add(absl::StrCat("key", i));
+  }
+  for (int64_t i = 0; i < kNumKeys; ++i) {
+    EXPECT_TRUE(filter.MayContain(absl::StrCat("key", i))) << i;
+  }
+  EXPECT_LT(GetFalsePositiveRate(filter, kNumKeys), 0.1);
+}
+
+TEST(ScalableBloomFilterTest, FalsePositiveRateAtCapacity) {
+  constexpr int64_t kNumKeys = 100000;
+  ScalableBloomFilter filter(kNumKeys);
+  for (int64_t i = 0; i < kNumKeys; ++i) {
+    filter.Add(absl::StrCat("key", i));
+  }
+  EXPECT_LT(GetFalsePositiveRate(filter, kNumKeys), 0.02);
+}
+
+TEST(ScalableBloomFilterTest, ReaddingKeysDoesNotGrowFilter) {
+  ScalableBloomFilter filter(/*initial_capacity=*/1000);
+  for (int i = 0; i < 100; ++i) {
+    for (int64_t k = 0; k < 1000; ++k) {
+      filter.Add(absl::StrCat("key", k));
+    }
+  }
+  // Still a single filter at capacity.
+  EXPECT_LT(GetFalsePositiveRate(filter, 100000), 0.02);
+}
+
+TEST(ScalableBloomFilterTest, ConcurrentAddsAndLookups) {
+  ScalableBloomFilter filter(/*initial_capacity=*/16);
+  constexpr int kNumThreads = 4;
+  constexpr int64_t kKeysPerThread = 10000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&filter, t]() {
+      for (int64_t i = 0; i < kKeysPerThread; ++i) {
+        const std::string key = absl::StrCat(t, ":", i);
+        filter.Add(key);
+        EXPECT_TRUE(filter.MayContain(key));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < kNumThreads; ++t) {
+    for (int64_t i = 0; i < kKeysPerThread; ++i) {
+      EXPECT_TRUE(filter.MayContain(absl::StrCat(t, ":", i)));
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
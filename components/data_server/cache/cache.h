@@ -20,14 +20,73 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
 #include "components/data_server/cache/get_key_value_set_result.h"
+#include "components/data_server/cache/json_value.h"
 #include "components/util/request_context.h"
+#include "flatbuffers/flatbuffers.h"
 
 namespace kv_server {
 
+// Flatbuffer view over the values of a string set, e.g., the values of a
+// `StringSet` stored in a `KeyValueMutationRecord`.
+using FlatbufferStringVector =
+    flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>;
+
+// Receives the contents of a cache from `Cache::Export`. Applying the visited
+// values, in any order, to an empty cache with the same logical commit times
+// and prefixes, followed by `Cache::RemoveDeletedKeys` with the visited
+// cleanup times, recreates the exported cache.
+//
+// `prefix` is the prefix of the update or delete that last changed a value.
+// Applying values with their prefix keeps deleted values cleaned up by the
+// `Cache::RemoveDeletedKeys` of the prefix they were deleted with, and keeps
+// the memory stats of each prefix.
+//
+// Returning a non-ok status from any method stops the export.
+class CacheVisitor {
+ public:
+  virtual ~CacheVisitor() = default;
+
+  // Called once, before any value is visited, with the maximum logical commit
+  // time passed to `Cache::RemoveDeletedKeys` for each prefix.
+  virtual absl::Status VisitCleanupLogicalCommitTimes(
+      const absl::flat_hash_map<std::string, int64_t>&
+          prefix_cleanup_logical_commit_times) = 0;
+
+  // `value` is empty if the key is marked as deleted.
+  virtual absl::Status VisitKeyValue(std::string_view key,
+                                     std::string_view value,
+                                     int64_t logical_commit_time,
+                                     bool is_deleted,
+                                     std::string_view prefix) = 0;
+
+  // Set values are visited in groups sharing the same logical commit time,
+  // deletion state and prefix. A key may be visited more than once.
+  virtual absl::Status VisitKeyValueSet(std::string_view key,
+                                        absl::Span<std::string_view> values,
+                                        int64_t logical_commit_time,
+                                        bool is_deleted,
+                                        std::string_view prefix) = 0;
+
+  virtual absl::Status VisitUInt32ValueSet(std::string_view key,
+                                           absl::Span<uint32_t> values,
+                                           int64_t logical_commit_time,
+                                           bool is_deleted,
+                                           std::string_view prefix) = 0;
+
+  virtual absl::Status VisitUInt64ValueSet(std::string_view key,
+                                           absl::Span<uint64_t> values,
+                                           int64_t logical_commit_time,
+                                           bool is_deleted,
+                                           std::string_view prefix) = 0;
+};
+
 // Interface for in-memory datastore.
 // One cache object is only for keys in one namespace.
 class Cache {
@@ -53,6 +112,25 @@ class Cache {
       const RequestContext& request_context,
       const absl::flat_hash_set<std::string_view>& key_set) const = 0;
 
+  // Returns false if none of the lookups above can find `key`. Cheap, and
+  // may return true for keys that are not in the cache. The default
+  // implementation always returns true.
+  virtual bool MayContainKey(std::string_view key) const { return true; }
+
+  // Looks up the values of the given keys as serialized
+  // `google.protobuf.Value`s, see `SerializeAsJsonValue`, i.e., in the form of
+  // the values of v1 GetValues responses. The default implementation converts
+  // the values returned by `GetKeyValuePairs` on every call.
+  virtual absl::flat_hash_map<std::string, std::string> GetSerializedJsonValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const {
+    auto kv_pairs = GetKeyValuePairs(request_context, key_set);
+    for (auto& [key, value] : kv_pairs) {
+      value = SerializeAsJsonValue(value);
+    }
+    return kv_pairs;
+  }
+
   // Inserts or updates the key with the new value for a given prefix
   virtual void UpdateKeyValue(
       privacy_sandbox::server_common::log::PSLogContext& log_context,
@@ -110,6 +188,118 @@ class Cache {
   virtual void RemoveDeletedKeys(
       privacy_sandbox::server_common::log::PSLogContext& log_context,
       int64_t logical_commit_time, std::string_view prefix = "") = 0;
+
+  // Visits every value in the cache, including values marked as deleted that
+  // were not cleaned up yet. The visitor is not called with cache locks held,
+  // so updates to the cache are only blocked while values are copied out of
+  // it. Updates made during the export may or may not be visited.
+  virtual absl::Status Export(CacheVisitor& visitor) {
+    return absl::UnimplementedError("Cache does not support exports.");
+  }
+
+  // A mutation of the string value of a key, see `UpdateKeyValue` and
+  // `DeleteKey`.
+  struct KeyValueMutation {
+    std::string_view key;
+    // Ignored for deletions.
+    std::string_view value;
+    int64_t logical_commit_time = 0;
+    bool is_deletion = false;
+  };
+
+  // Applies `mutations` in order, as if by calling `UpdateKeyValue` or
+  // `DeleteKey` for each of them. Implementations may apply the whole batch
+  // under a single lock acquisition.
+  virtual void ApplyKeyValueMutations(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      absl::Span<const KeyValueMutation> mutations,
+      std::string_view prefix = "") {
+    for (const auto& mutation : mutations) {
+      if (mutation.is_deletion) {
+        DeleteKey(log_context, mutation.key, mutation.logical_commit_time,
+                  prefix);
+      } else {
+        UpdateKeyValue(log_context, mutation.key, mutation.value,
+                       mutation.logical_commit_time, prefix);
+      }
+    }
+  }
+
+  // Overloads of the set mutations above that take the values as flatbuffer
+  // vectors, i.e., straight from a deserialized `KeyValueMutationRecord`.
+  //
+  // The default implementations copy the values and delegate to the span
+  // based overloads. Implementations that can apply the values in place should
+  // override these to avoid the intermediate copies.
+  virtual void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const FlatbufferStringVector& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") {
+    auto values = ToVector(value_set);
+    UpdateKeyValueSet(log_context, key, absl::MakeSpan(values),
+                      logical_commit_time, prefix);
+  }
+
+  virtual void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint32_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") {
+    auto values = ToVector(value_set);
+    UpdateKeyValueSet(log_context, key, absl::MakeSpan(values),
+                      logical_commit_time, prefix);
+  }
+
+  virtual void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint64_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") {
+    auto values = ToVector(value_set);
+    UpdateKeyValueSet(log_context, key, absl::MakeSpan(values),
+                      logical_commit_time, prefix);
+  }
+
+  virtual void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const FlatbufferStringVector& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") {
+    auto values = ToVector(value_set);
+    DeleteValuesInSet(log_context, key, absl::MakeSpan(values),
+                      logical_commit_time, prefix);
+  }
+
+  virtual void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint32_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") {
+    auto values = ToVector(value_set);
+    DeleteValuesInSet(log_context, key, absl::MakeSpan(values),
+                      logical_commit_time, prefix);
+  }
+
+  virtual void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint64_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") {
+    auto values = ToVector(value_set);
+    DeleteValuesInSet(log_context, key, absl::MakeSpan(values),
+                      logical_commit_time, prefix);
+  }
+
+ private:
+  static std::vector<std::string_view> ToVector(
+      const FlatbufferStringVector& value_set) {
+    std::vector<std::string_view> values;
+    values.reserve(value_set.size());
+    for (const auto* value : value_set) {
+      values.push_back(value->string_view());
+    }
+    return values;
+  }
+
+  template <typename T>
+  static std::vector<T> ToVector(const flatbuffers::Vector<T>& value_set) {
+    return std::vector<T>(value_set.begin(), value_set.end());
+  }
 };
 
 }  // namespace kv_server
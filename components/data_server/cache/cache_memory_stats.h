@@ -0,0 +1,96 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_CACHE_MEMORY_STATS_H_
+#define COMPONENTS_DATA_SERVER_CACHE_CACHE_MEMORY_STATS_H_
+
+#include <cstdint>
+
+namespace kv_server {
+
+// Memory used by the entries of one value type of a cache. Byte counts are
+// the sizes of the stored keys and values, without the overhead of the
+// containers that hold them.
+struct ValueMemoryStats {
+  // Total size of the keys, including keys that only hold deleted values.
+  int64_t key_bytes = 0;
+  // Number of values that are not deleted, i.e., one per key for key-value
+  // pairs, and the set cardinality for sets.
+  int64_t cardinality = 0;
+  // Total size of the stored values, including set values marked as deleted.
+  int64_t value_bytes = 0;
+  // Number of deleted keys and set values that are kept until cleanup.
+  int64_t tombstones = 0;
+  // Total serialized size of the bitsets of uint sets.
+  int64_t bitset_bytes = 0;
+
+  ValueMemoryStats& operator+=(const ValueMemoryStats& other) {
+    key_bytes += other.key_bytes;
+    cardinality += other.cardinality;
+    value_bytes += other.value_bytes;
+    tombstones += other.tombstones;
+    bitset_bytes += other.bitset_bytes;
+    return *this;
+  }
+
+  ValueMemoryStats& operator-=(const ValueMemoryStats& other) {
+    key_bytes -= other.key_bytes;
+    cardinality -= other.cardinality;
+    value_bytes -= other.value_bytes;
+    tombstones -= other.tombstones;
+    bitset_bytes -= other.bitset_bytes;
+    return *this;
+  }
+
+  friend bool operator==(const ValueMemoryStats& lhs,
+                         const ValueMemoryStats& rhs) {
+    return lhs.key_bytes == rhs.key_bytes &&
+           lhs.cardinality == rhs.cardinality &&
+           lhs.value_bytes == rhs.value_bytes &&
+           lhs.tombstones == rhs.tombstones &&
+           lhs.bitset_bytes == rhs.bitset_bytes;
+  }
+
+  friend bool operator!=(const ValueMemoryStats& lhs,
+                         const ValueMemoryStats& rhs) {
+    return !(lhs == rhs);
+  }
+};
+
+// Memory used by the entries of a cache, per value type.
+struct CacheMemoryStats {
+  ValueMemoryStats key_values;
+  ValueMemoryStats string_sets;
+  ValueMemoryStats uint32_sets;
+  ValueMemoryStats uint64_sets;
+
+  friend bool operator==(const CacheMemoryStats& lhs,
+                         const CacheMemoryStats& rhs) {
+    return lhs.key_values == rhs.key_values &&
+           lhs.string_sets == rhs.string_sets &&
+           lhs.uint32_sets == rhs.uint32_sets &&
+           lhs.uint64_sets == rhs.uint64_sets;
+  }
+
+  friend bool operator!=(const CacheMemoryStats& lhs,
+                         const CacheMemoryStats& rhs) {
+    return !(lhs == rhs);
+  }
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_CACHE_MEMORY_STATS_H_
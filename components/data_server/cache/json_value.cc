@@ -0,0 +1,33 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/json_value.h"
+
+#include <string>
+
+#include "google/protobuf/util/json_util.h"
+#include "src/google/protobuf/struct.pb.h"
+
+namespace kv_server {
+
+std::string SerializeAsJsonValue(std::string_view value) {
+  google::protobuf::Value value_proto;
+  if (!google::protobuf::util::JsonStringToMessage(value, &value_proto).ok()) {
+    value_proto.Clear();
+    value_proto.set_string_value(std::string(value));
+  }
+  return value_proto.SerializeAsString();
+}
+
+}  // namespace kv_server
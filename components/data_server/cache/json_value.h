@@ -0,0 +1,32 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_JSON_VALUE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_JSON_VALUE_H_
+
+#include <string>
+#include <string_view>
+
+namespace kv_server {
+
+// Returns `value` parsed from JSON into a serialized `google.protobuf.Value`.
+// If `value` is not valid JSON, the returned `Value` holds `value` as a
+// string value instead.
+std::string SerializeAsJsonValue(std::string_view value);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_JSON_VALUE_H_
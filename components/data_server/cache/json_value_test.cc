@@ -0,0 +1,61 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/json_value.h"
+
+#include "gtest/gtest.h"
+#include "src/google/protobuf/struct.pb.h"
+
+namespace kv_server {
+namespace {
+
+using google::protobuf::Value;
+
+Value ParseValue(const std::string& serialized) {
+  Value value;
+  EXPECT_TRUE(value.ParseFromString(serialized));
+  return value;
+}
+
+TEST(JsonValueTest, ParsesJsonObjects) {
+  const Value value =
+      ParseValue(SerializeAsJsonValue(R"({"a": [1, "b"], "c": true})"));
+  ASSERT_TRUE(value.has_struct_value());
+  const auto& fields = value.struct_value().fields();
+  ASSERT_EQ(fields.size(), 2);
+  ASSERT_EQ(fields.at("a").list_value().values_size(), 2);
+  EXPECT_EQ(fields.at("a").list_value().values(0).number_value(), 1);
+  EXPECT_EQ(fields.at("a").list_value().values(1).string_value(), "b");
+  EXPECT_TRUE(fields.at("c").bool_value());
+}
+
+TEST(JsonValueTest, ParsesJsonScalars) {
+  EXPECT_EQ(ParseValue(SerializeAsJsonValue("1.5")).number_value(), 1.5);
+  EXPECT_EQ(ParseValue(SerializeAsJsonValue(R"("json string")")).string_value(),
+            "json string");
+}
+
+TEST(JsonValueTest, KeepsInvalidJsonAsString) {
+  const Value value = ParseValue(SerializeAsJsonValue("not {json"));
+  EXPECT_EQ(value.string_value(), "not {json");
+}
+
+TEST(JsonValueTest, KeepsEmptyValueAsString) {
+  const Value value = ParseValue(SerializeAsJsonValue(""));
+  ASSERT_TRUE(value.has_string_value());
+  EXPECT_EQ(value.string_value(), "");
+}
+
+}  // namespace
+}  // namespace kv_server
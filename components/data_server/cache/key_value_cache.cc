@@ -13,28 +13,119 @@
 // limitations under the License.
 #include "components/data_server/cache/key_value_cache.h"
 
+#include <algorithm>
 #include <memory>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/log/log.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/cache/get_key_value_set_result.h"
+#include "components/data_server/cache/json_value.h"
+#include "src/util/status_macro/status_macros.h"
 
 namespace kv_server {
+namespace {
+
+std::string_view ToStringView(std::string_view value) { return value; }
+
+std::string_view ToStringView(const flatbuffers::String* value) {
+  return value->string_view();
+}
+
+// Returns a span over the elements of a flatbuffer vector of scalars.
+// Flatbuffers stores scalars little-endian, so on little-endian hosts the
+// vector can be read in place.
+template <typename T>
+absl::Span<const T> ToSpan(const flatbuffers::Vector<T>& values) {
+  static_assert(FLATBUFFERS_LITTLEENDIAN,
+                "Reading flatbuffer vectors in place requires a little-endian "
+                "host.");
+  return absl::MakeConstSpan(values.data(), values.size());
+}
+
+// Value types that partition the cache memory metrics.
+constexpr std::string_view kKeyValueMemoryPartition = "key_value";
+constexpr std::string_view kStringSetMemoryPartition = "string_set";
+constexpr std::string_view kUInt32SetMemoryPartition = "uint32_set";
+constexpr std::string_view kUInt64SetMemoryPartition = "uint64_set";
+
+template <const auto& definition>
+void LogMemoryMetric(const std::string& partition, int64_t delta) {
+  if (delta == 0) {
+    return;
+  }
+  LogIfError(KVServerContextMap()->SafeMetric().LogUpDownCounter<definition>(
+      {{partition, static_cast<double>(delta)}}));
+}
+
+// Logs the change from `logged_stats` to `stats` for the memory of
+// `value_type` values of `prefix`.
+void LogValueMemoryMetrics(std::string_view value_type,
+                           std::string_view prefix,
+                           const ValueMemoryStats& stats,
+                           const ValueMemoryStats& logged_stats) {
+  if (stats == logged_stats) {
+    return;
+  }
+  ValueMemoryStats delta = stats;
+  delta -= logged_stats;
+  const std::string partition = absl::StrCat(value_type, ":", prefix);
+  LogMemoryMetric<kCacheKeyBytes>(partition, delta.key_bytes);
+  LogMemoryMetric<kCacheValueCardinality>(partition, delta.cardinality);
+  LogMemoryMetric<kCacheValueBytes>(partition, delta.value_bytes);
+  LogMemoryMetric<kCacheTombstones>(partition, delta.tombstones);
+  LogMemoryMetric<kCacheBitsetBytes>(partition, delta.bitset_bytes);
+}
+
+// Number of keys whose values are copied out of the cache at a time by
+// `Export`.
+constexpr size_t kExportChunkSize = 1000;
+
+}  // namespace
 
 absl::flat_hash_map<std::string, std::string> KeyValueCache::GetKeyValuePairs(
     const RequestContext& request_context,
     const absl::flat_hash_set<std::string_view>& key_set) const {
+  return LookUpKeyValuePairs(request_context, key_set,
+                             /*serialized_json_values=*/false);
+}
+
+absl::flat_hash_map<std::string, std::string>
+KeyValueCache::GetSerializedJsonValues(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  if (!parse_json_values_) {
+    return Cache::GetSerializedJsonValues(request_context, key_set);
+  }
+  return LookUpKeyValuePairs(request_context, key_set,
+                             /*serialized_json_values=*/true);
+}
+
+absl::flat_hash_map<std::string, std::string>
+KeyValueCache::LookUpKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set,
+    bool serialized_json_values) const {
   ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
                               kGetValuePairsLatencyInMicros>
       latency_recorder(request_context.GetInternalLookupMetricsContext());
   absl::flat_hash_map<std::string, std::string> kv_pairs;
+  const std::vector<std::string_view> keys = GetKeysToLookUp(key_set);
+  if (keys.empty()) {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheMiss);
+    return kv_pairs;
+  }
   absl::ReaderMutexLock lock(&mutex_);
-  for (std::string_view key : key_set) {
+  for (std::string_view key : keys) {
     const auto key_iter = map_.find(key);
     if (key_iter == map_.end() || key_iter->second.value == nullptr) {
       continue;
@@ -42,7 +133,10 @@ absl::flat_hash_map<std::string, std::string> KeyValueCache::GetKeyValuePairs(
       PS_VLOG(9, request_context.GetPSLogContext())
           << "Get called for " << key
           << ". returning value: " << *(key_iter->second.value);
-      kv_pairs.insert_or_assign(key, *(key_iter->second.value));
+      const CacheValue& cache_value = key_iter->second;
+      kv_pairs.insert_or_assign(key, serialized_json_values
+                                         ? *cache_value.serialized_json_value
+                                         : *cache_value.value);
     }
   }
   if (kv_pairs.empty()) {
@@ -59,11 +153,16 @@ std::unique_ptr<GetKeyValueSetResult> KeyValueCache::GetKeyValueSet(
   ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
                               kGetKeyValueSetLatencyInMicros>
       latency_recorder(request_context.GetInternalLookupMetricsContext());
+  auto result = GetKeyValueSetResult::Create();
+  const std::vector<std::string_view> keys = GetKeysToLookUp(key_set);
+  if (keys.empty()) {
+    LogCacheAccessMetrics(request_context, kKeyValueSetCacheMiss);
+    return result;
+  }
   // lock the cache map
   absl::ReaderMutexLock lock(&set_map_mutex_);
-  auto result = GetKeyValueSetResult::Create();
   bool cache_hit = false;
-  for (const auto& key : key_set) {
+  for (const auto& key : keys) {
     PS_VLOG(8, request_context.GetPSLogContext()) << "Getting key: " << key;
     const auto key_itr = key_to_value_set_map_.find(key);
     if (key_itr != key_to_value_set_map_.end()) {
@@ -88,6 +187,14 @@ std::unique_ptr<GetKeyValueSetResult> KeyValueCache::GetKeyValueSet(
   return result;
 }
 
+bool KeyValueCache::MayContainKey(std::string_view key) const {
+  if (!enable_key_filter_) {
+    return true;
+  }
+  absl::ReaderMutexLock lock(&key_filter_mutex_);
+  return key_filter_->MayContain(key);
+}
+
 // Looks up and returns int32 value set result for the given key set.
 std::unique_ptr<GetKeyValueSetResult> KeyValueCache::GetUInt32ValueSet(
     const RequestContext& request_context,
@@ -134,8 +241,50 @@ void KeyValueCache::UpdateKeyValue(
   PS_VLOG(9, log_context) << "Received update for [" << key << "] at "
                           << logical_commit_time
                           << ". value will be set to: " << value;
+  auto serialized_json_value = MaybeSerializeAsJsonValue(value);
+  const uint32_t prefix_id = prefix_ids_.GetOrAddId(prefix);
   absl::MutexLock lock(&mutex_);
+  UpdateKeyValueLocked(log_context, key, value,
+                       std::move(serialized_json_value), logical_commit_time,
+                       prefix, prefix_id);
+}
+
+void KeyValueCache::ApplyKeyValueMutations(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    absl::Span<const KeyValueMutation> mutations, std::string_view prefix) {
+  PS_VLOG(9, log_context) << "Received " << mutations.size()
+                          << " key-value mutations";
+  std::vector<std::unique_ptr<std::string>> serialized_json_values;
+  if (parse_json_values_) {
+    serialized_json_values.reserve(mutations.size());
+    for (const auto& mutation : mutations) {
+      serialized_json_values.push_back(
+          mutation.is_deletion ? nullptr
+                               : MaybeSerializeAsJsonValue(mutation.value));
+    }
+  }
+  const uint32_t prefix_id = prefix_ids_.GetOrAddId(prefix);
+  absl::MutexLock lock(&mutex_);
+  for (size_t i = 0; i < mutations.size(); ++i) {
+    const auto& mutation = mutations[i];
+    if (mutation.is_deletion) {
+      DeleteKeyLocked(log_context, mutation.key, mutation.logical_commit_time,
+                      prefix, prefix_id);
+    } else {
+      UpdateKeyValueLocked(log_context, mutation.key, mutation.value,
+                           parse_json_values_
+                               ? std::move(serialized_json_values[i])
+                               : nullptr,
+                           mutation.logical_commit_time, prefix, prefix_id);
+    }
+  }
+}
 
+void KeyValueCache::UpdateKeyValueLocked(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, std::string_view value,
+    std::unique_ptr<std::string> serialized_json_value,
+    int64_t logical_commit_time, std::string_view prefix, uint32_t prefix_id) {
   auto max_cleanup_logical_commit_time =
       max_cleanup_logical_commit_time_map_[prefix];
 
@@ -159,12 +308,31 @@ void KeyValueCache::UpdateKeyValue(
     return;
   }
 
+  ValueMemoryStats& memory_stats = key_value_memory_stats_[prefix];
+  if (key_iter == map_.end()) {
+    memory_stats.key_bytes += key.size();
+  } else if (key_iter->second.value == nullptr) {
+    --memory_stats.tombstones;
+  } else {
+    --memory_stats.cardinality;
+    memory_stats.value_bytes -= key_iter->second.ValueBytes();
+  }
+  CacheValue cache_value = {
+      .value = std::make_unique<std::string>(value),
+      .serialized_json_value = std::move(serialized_json_value),
+      .last_logical_commit_time = logical_commit_time,
+      .prefix_id = prefix_id};
+  ++memory_stats.cardinality;
+  memory_stats.value_bytes += cache_value.ValueBytes();
+  AddToKeyFilter(key);
+
   if (key_iter != map_.end() &&
       key_iter->second.last_logical_commit_time < logical_commit_time &&
       key_iter->second.value == nullptr) {
-    // should always have this, but checking just in case
-
-    if (auto prefix_deleted_nodes_iter = deleted_nodes_map_.find(prefix);
+    // should always have this, but checking just in case. The tombstone is
+    // tracked under the prefix it was deleted with.
+    if (auto prefix_deleted_nodes_iter = deleted_nodes_map_.find(
+            prefix_ids_.GetPrefix(key_iter->second.prefix_id));
         prefix_deleted_nodes_iter != deleted_nodes_map_.end()) {
       auto dl_key_iter = prefix_deleted_nodes_iter->second.find(
           key_iter->second.last_logical_commit_time);
@@ -175,19 +343,17 @@ void KeyValueCache::UpdateKeyValue(
     }
   }
 
-  map_.insert_or_assign(key, {.value = std::make_unique<std::string>(value),
-                              .last_logical_commit_time = logical_commit_time});
+  map_.insert_or_assign(key, std::move(cache_value));
 }
 
-void KeyValueCache::UpdateKeyValueSet(
+template <typename ValuesT>
+void KeyValueCache::UpdateStringSetValues(
     privacy_sandbox::server_common::log::PSLogContext& log_context,
-    std::string_view key, absl::Span<std::string_view> input_value_set,
+    std::string_view key, const ValuesT& input_value_set,
     int64_t logical_commit_time, std::string_view prefix) {
-  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
-                              kUpdateKeyValueSetLatency>
-      latency_recorder(KVServerContextMap()->SafeMetric());
   PS_VLOG(9, log_context) << "Received update for [" << key << "] at "
                           << logical_commit_time;
+  const uint32_t prefix_id = prefix_ids_.GetOrAddId(prefix);
   std::unique_ptr<absl::MutexLock> key_lock;
   absl::flat_hash_map<std::string, SetValueMeta>* existing_value_set;
   // The max cleanup time needs to be locked before doing this comparison
@@ -203,7 +369,7 @@ void KeyValueCache::UpdateKeyValueSet(
           << logical_commit_time << " is older than the current cutoff time:"
           << max_cleanup_logical_commit_time;
       return;
-    } else if (input_value_set.empty()) {
+    } else if (input_value_set.size() == 0) {
       PS_VLOG(1, log_context)
           << "Skipping the update as it has no value in the set.";
       return;
@@ -217,11 +383,22 @@ void KeyValueCache::UpdateKeyValueSet(
       auto mutex_value_map_pair = std::make_unique<std::pair<
           absl::Mutex, absl::flat_hash_map<std::string, SetValueMeta>>>();
 
+      ValueMemoryStats memory_stats_delta;
+      memory_stats_delta.key_bytes = key.size();
       for (const auto& value : input_value_set) {
-        mutex_value_map_pair->second.emplace(
-            value, SetValueMeta{logical_commit_time, /*is_deleted=*/false});
+        const std::string_view value_view = ToStringView(value);
+        if (mutex_value_map_pair->second
+                .emplace(value_view,
+                         SetValueMeta{logical_commit_time,
+                                      /*is_deleted=*/false, prefix_id})
+                .second) {
+          ++memory_stats_delta.cardinality;
+          memory_stats_delta.value_bytes += value_view.size();
+        }
       }
+      AddToKeyFilter(key);
       key_to_value_set_map_.emplace(key, std::move(mutex_value_map_pair));
+      AddStringSetMemoryStats(prefix, memory_stats_delta);
       return;
     }
     // The given key has an existing value set, then
@@ -232,20 +409,45 @@ void KeyValueCache::UpdateKeyValueSet(
     existing_value_set = &key_itr->second->second;
   }  // end locking map;
 
+  ValueMemoryStats memory_stats_delta;
   for (const auto& value : input_value_set) {
-    auto& current_value_state = (*existing_value_set)[value];
+    const std::string_view value_view = ToStringView(value);
+    auto [value_itr, inserted] = existing_value_set->try_emplace(value_view);
+    if (inserted) {
+      ++memory_stats_delta.cardinality;
+      memory_stats_delta.value_bytes += value_view.size();
+    }
+    auto& current_value_state = value_itr->second;
     if (current_value_state.last_logical_commit_time >= logical_commit_time) {
       // no need to update
       continue;
     }
+    if (current_value_state.is_deleted) {
+      --memory_stats_delta.tombstones;
+      ++memory_stats_delta.cardinality;
+    }
     // Insert new value or update existing value with
     // the recent logical commit time. If the existing value was marked
     // deleted, update is_deleted boolean to false
     current_value_state.is_deleted = false;
     current_value_state.last_logical_commit_time = logical_commit_time;
+    current_value_state.prefix_id = prefix_id;
   }
+  AddStringSetMemoryStats(prefix, memory_stats_delta);
   // end locking key
 }
+
+void KeyValueCache::UpdateKeyValueSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, absl::Span<std::string_view> input_value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kUpdateKeyValueSetLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  UpdateStringSetValues(log_context, key, input_value_set, logical_commit_time,
+                        prefix);
+}
+
 void KeyValueCache::UpdateKeyValueSet(
     privacy_sandbox::server_common::log::PSLogContext& log_context,
     std::string_view key, absl::Span<uint32_t> value_set,
@@ -257,6 +459,7 @@ void KeyValueCache::UpdateKeyValueSet(
                           << logical_commit_time;
   uint32_sets_cache_.UpdateSetValues(log_context, key, value_set,
                                      logical_commit_time, prefix);
+  AddToKeyFilter(key);
 }
 
 void KeyValueCache::UpdateKeyValueSet(
@@ -270,6 +473,7 @@ void KeyValueCache::UpdateKeyValueSet(
                           << logical_commit_time;
   uint64_sets_cache_.UpdateSetValues(log_context, key, value_set,
                                      logical_commit_time, prefix);
+  AddToKeyFilter(key);
 }
 
 void KeyValueCache::DeleteKey(
@@ -280,7 +484,15 @@ void KeyValueCache::DeleteKey(
                           << logical_commit_time;
   ScopeLatencyMetricsRecorder<ServerSafeMetricsContext, kDeleteKeyLatency>
       latency_recorder(KVServerContextMap()->SafeMetric());
+  const uint32_t prefix_id = prefix_ids_.GetOrAddId(prefix);
   absl::MutexLock lock(&mutex_);
+  DeleteKeyLocked(log_context, key, logical_commit_time, prefix, prefix_id);
+}
+
+void KeyValueCache::DeleteKeyLocked(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, int64_t logical_commit_time, std::string_view prefix,
+    uint32_t prefix_id) {
   auto max_cleanup_logical_commit_time =
       max_cleanup_logical_commit_time_map_[prefix];
   if (logical_commit_time <= max_cleanup_logical_commit_time) {
@@ -297,20 +509,29 @@ void KeyValueCache::DeleteKey(
     // If key is missing, we still need to add a null value to the map to
     // avoid the late coming update with smaller logical commit time
     // inserting value to the map for the given key
-    map_.insert_or_assign(
-        key,
-        {.value = nullptr, .last_logical_commit_time = logical_commit_time});
+    ValueMemoryStats& memory_stats = key_value_memory_stats_[prefix];
+    if (key_iter == map_.end()) {
+      memory_stats.key_bytes += key.size();
+      ++memory_stats.tombstones;
+    } else if (key_iter->second.value != nullptr) {
+      --memory_stats.cardinality;
+      memory_stats.value_bytes -= key_iter->second.ValueBytes();
+      ++memory_stats.tombstones;
+    }
+    map_.insert_or_assign(key,
+                          {.value = nullptr,
+                           .last_logical_commit_time = logical_commit_time,
+                           .prefix_id = prefix_id});
     deleted_nodes_map_[prefix].emplace(logical_commit_time, key);
   }
 }
 
-void KeyValueCache::DeleteValuesInSet(
+template <typename ValuesT>
+void KeyValueCache::DeleteStringSetValues(
     privacy_sandbox::server_common::log::PSLogContext& log_context,
-    std::string_view key, absl::Span<std::string_view> value_set,
+    std::string_view key, const ValuesT& value_set,
     int64_t logical_commit_time, std::string_view prefix) {
-  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
-                              kDeleteValuesInSetLatency>
-      latency_recorder(KVServerContextMap()->SafeMetric());
+  const uint32_t prefix_id = prefix_ids_.GetOrAddId(prefix);
   std::unique_ptr<absl::MutexLock> key_lock;
   absl::flat_hash_map<std::string, SetValueMeta>* existing_value_set;
   // The max cleanup time needs to be locked before doing this comparison
@@ -319,7 +540,7 @@ void KeyValueCache::DeleteValuesInSet(
     auto max_cleanup_logical_commit_time =
         set_cache_max_cleanup_logical_commit_time_[prefix];
     if (logical_commit_time <= max_cleanup_logical_commit_time ||
-        value_set.empty()) {
+        value_set.size() == 0) {
       return;
     }
     auto key_itr = key_to_value_set_map_.find(key);
@@ -330,14 +551,26 @@ void KeyValueCache::DeleteValuesInSet(
       auto mutex_value_map_pair = std::make_unique<std::pair<
           absl::Mutex, absl::flat_hash_map<std::string, SetValueMeta>>>();
 
+      ValueMemoryStats memory_stats_delta;
+      memory_stats_delta.key_bytes = key.size();
       for (const auto& value : value_set) {
-        mutex_value_map_pair->second.emplace(
-            value, SetValueMeta{logical_commit_time, /*is_deleted=*/true});
+        const std::string_view value_view = ToStringView(value);
+        if (mutex_value_map_pair->second
+                .emplace(value_view,
+                         SetValueMeta{logical_commit_time, /*is_deleted=*/true,
+                                      prefix_id})
+                .second) {
+          ++memory_stats_delta.tombstones;
+          memory_stats_delta.value_bytes += value_view.size();
+        }
       }
+      AddToKeyFilter(key);
       key_to_value_set_map_.emplace(key, std::move(mutex_value_map_pair));
+      AddStringSetMemoryStats(prefix, memory_stats_delta);
       // Add to deleted set nodes
-      for (const std::string_view value : value_set) {
-        deleted_set_nodes_map_[prefix][logical_commit_time][key].emplace(value);
+      for (const auto& value : value_set) {
+        deleted_set_nodes_map_[prefix][logical_commit_time][key].emplace(
+            ToStringView(value));
       }
       return;
     }
@@ -347,20 +580,33 @@ void KeyValueCache::DeleteValuesInSet(
   }  // end locking map
   // Keep track of the values to be added to the deleted set nodes
   std::vector<std::string_view> values_to_delete;
+  ValueMemoryStats memory_stats_delta;
   for (const auto& value : value_set) {
-    auto& current_value_state = (*existing_value_set)[value];
+    const std::string_view value_view = ToStringView(value);
+    auto [value_itr, inserted] = existing_value_set->try_emplace(value_view);
+    if (inserted) {
+      ++memory_stats_delta.cardinality;
+      memory_stats_delta.value_bytes += value_view.size();
+    }
+    auto& current_value_state = value_itr->second;
     if (current_value_state.last_logical_commit_time >= logical_commit_time) {
       // No need to delete
       continue;
     }
+    if (!current_value_state.is_deleted) {
+      --memory_stats_delta.cardinality;
+      ++memory_stats_delta.tombstones;
+    }
     // Add a value that represents a deleted value, or mark the existing value
     // deleted. We need to add the value in deleted state to the map to avoid
     // late arriving update with smaller logical commit time
     // inserting the same value
     current_value_state.last_logical_commit_time = logical_commit_time;
     current_value_state.is_deleted = true;
-    values_to_delete.push_back(value);
+    current_value_state.prefix_id = prefix_id;
+    values_to_delete.push_back(value_view);
   }
+  AddStringSetMemoryStats(prefix, memory_stats_delta);
   if (!values_to_delete.empty()) {
     // Release key lock before locking the map to avoid potential deadlock
     // caused by cycle in the ordering of lock acquisitions
@@ -372,6 +618,17 @@ void KeyValueCache::DeleteValuesInSet(
   }
 }
 
+void KeyValueCache::DeleteValuesInSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kDeleteValuesInSetLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  DeleteStringSetValues(log_context, key, value_set, logical_commit_time,
+                        prefix);
+}
+
 void KeyValueCache::DeleteValuesInSet(
     privacy_sandbox::server_common::log::PSLogContext& log_context,
     std::string_view key, absl::Span<uint32_t> value_set,
@@ -383,6 +640,7 @@ void KeyValueCache::DeleteValuesInSet(
                           << logical_commit_time;
   uint32_sets_cache_.DeleteSetValues(log_context, key, value_set,
                                      logical_commit_time, prefix);
+  AddToKeyFilter(key);
 }
 
 void KeyValueCache::DeleteValuesInSet(
@@ -396,6 +654,7 @@ void KeyValueCache::DeleteValuesInSet(
                           << logical_commit_time;
   uint64_sets_cache_.DeleteSetValues(log_context, key, value_set,
                                      logical_commit_time, prefix);
+  AddToKeyFilter(key);
 }
 
 void KeyValueCache::RemoveDeletedKeys(
@@ -407,6 +666,8 @@ void KeyValueCache::RemoveDeletedKeys(
   CleanUpKeyValueMap(log_context, logical_commit_time, prefix);
   CleanUpKeyValueSetMap(log_context, logical_commit_time, prefix);
   CleanUpUIntSetMaps(log_context, logical_commit_time, prefix);
+  MaybeRebuildKeyFilter();
+  LogMemoryMetrics();
 }
 
 void KeyValueCache::CleanUpKeyValueMap(
@@ -423,6 +684,8 @@ void KeyValueCache::CleanUpKeyValueMap(
   if (deleted_nodes_per_prefix == deleted_nodes_map_.end()) {
     return;
   }
+  ValueMemoryStats& memory_stats = key_value_memory_stats_[prefix];
+  int64_t num_removed_keys = 0;
   auto it = deleted_nodes_per_prefix->second.begin();
 
   while (it != deleted_nodes_per_prefix->second.end()) {
@@ -434,11 +697,15 @@ void KeyValueCache::CleanUpKeyValueMap(
     auto key_iter = map_.find(it->second);
     if (key_iter != map_.end() && key_iter->second.value == nullptr &&
         key_iter->second.last_logical_commit_time <= logical_commit_time) {
+      memory_stats.key_bytes -= key_iter->first.size();
+      --memory_stats.tombstones;
       map_.erase(key_iter);
+      ++num_removed_keys;
     }
 
     ++it;
   }
+  AddRemovedKeys(num_removed_keys);
   deleted_nodes_per_prefix->second.erase(
       deleted_nodes_per_prefix->second.begin(), it);
   if (deleted_nodes_per_prefix->second.empty()) {
@@ -461,6 +728,8 @@ void KeyValueCache::CleanUpKeyValueSetMap(
   if (deleted_nodes_per_prefix == deleted_set_nodes_map_.end()) {
     return;
   }
+  ValueMemoryStats memory_stats_delta;
+  int64_t num_removed_keys = 0;
   auto delete_itr = deleted_nodes_per_prefix->second.begin();
   while (delete_itr != deleted_nodes_per_prefix->second.end()) {
     if (delete_itr->first > logical_commit_time) {
@@ -478,23 +747,30 @@ void KeyValueCache::CleanUpKeyValueSetMap(
                 existing_value_itr->second.last_logical_commit_time <=
                     logical_commit_time) {
               // Delete the existing value that is marked deleted from set
+              --memory_stats_delta.tombstones;
+              memory_stats_delta.value_bytes -=
+                  existing_value_itr->first.size();
               key_itr->second->second.erase(existing_value_itr);
             }
           }
         }
         if (key_itr->second->second.empty()) {
           // If the value set is empty, erase the key-value_set from cache map
+          memory_stats_delta.key_bytes -= key.size();
           key_to_value_set_map_.erase(key);
+          ++num_removed_keys;
         }
       }
     }
     ++delete_itr;
   }
+  AddRemovedKeys(num_removed_keys);
   deleted_nodes_per_prefix->second.erase(
       deleted_nodes_per_prefix->second.begin(), delete_itr);
   if (deleted_nodes_per_prefix->second.empty()) {
     deleted_set_nodes_map_.erase(prefix);
   }
+  AddStringSetMemoryStats(prefix, memory_stats_delta);
 }
 
 void KeyValueCache::CleanUpUIntSetMaps(
@@ -506,8 +782,216 @@ void KeyValueCache::CleanUpUIntSetMaps(
   PS_VLOG(9, log_context)
       << "Cleaning up uint set maps with a new cutoff timestamp: "
       << logical_commit_time;
-  uint32_sets_cache_.CleanUpValueSets(log_context, logical_commit_time);
-  uint64_sets_cache_.CleanUpValueSets(log_context, logical_commit_time);
+  uint32_sets_cache_.CleanUpValueSets(log_context, logical_commit_time,
+                                      prefix);
+  uint64_sets_cache_.CleanUpValueSets(log_context, logical_commit_time,
+                                      prefix);
+}
+
+void KeyValueCache::UpdateKeyValueSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const FlatbufferStringVector& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kUpdateKeyValueSetLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  UpdateStringSetValues(log_context, key, value_set, logical_commit_time,
+                        prefix);
+}
+
+void KeyValueCache::UpdateKeyValueSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const flatbuffers::Vector<uint32_t>& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kUpdateUInt32ValueSetLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  PS_VLOG(9, log_context) << "Received update for [" << key << "] at "
+                          << logical_commit_time;
+  uint32_sets_cache_.UpdateSetValues(log_context, key, ToSpan(value_set),
+                                     logical_commit_time, prefix);
+  AddToKeyFilter(key);
+}
+
+void KeyValueCache::UpdateKeyValueSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const flatbuffers::Vector<uint64_t>& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kUpdateUInt64ValueSetLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  PS_VLOG(9, log_context) << "Received update for [" << key << "] at "
+                          << logical_commit_time;
+  uint64_sets_cache_.UpdateSetValues(log_context, key, ToSpan(value_set),
+                                     logical_commit_time, prefix);
+  AddToKeyFilter(key);
+}
+
+void KeyValueCache::DeleteValuesInSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const FlatbufferStringVector& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kDeleteValuesInSetLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  DeleteStringSetValues(log_context, key, value_set, logical_commit_time,
+                        prefix);
+}
+
+void KeyValueCache::DeleteValuesInSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const flatbuffers::Vector<uint32_t>& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kDeleteUInt32ValueSetLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  PS_VLOG(9, log_context) << "Received delete for [" << key << "] at "
+                          << logical_commit_time;
+  uint32_sets_cache_.DeleteSetValues(log_context, key, ToSpan(value_set),
+                                     logical_commit_time, prefix);
+  AddToKeyFilter(key);
+}
+
+void KeyValueCache::DeleteValuesInSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const flatbuffers::Vector<uint64_t>& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kDeleteUInt64ValueSetLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  PS_VLOG(9, log_context) << "Received delete for [" << key << "] at "
+                          << logical_commit_time;
+  uint64_sets_cache_.DeleteSetValues(log_context, key, ToSpan(value_set),
+                                     logical_commit_time, prefix);
+  AddToKeyFilter(key);
+}
+
+absl::Status KeyValueCache::Export(CacheVisitor& visitor) {
+  absl::flat_hash_map<std::string, int64_t> cleanup_logical_commit_times;
+  std::vector<std::string> keys;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    cleanup_logical_commit_times = max_cleanup_logical_commit_time_map_;
+    keys.reserve(map_.size());
+    for (const auto& [key, cache_value] : map_) {
+      keys.push_back(key);
+    }
+  }
+  PS_RETURN_IF_ERROR(
+      visitor.VisitCleanupLogicalCommitTimes(cleanup_logical_commit_times));
+  // Values are copied out of the cache a chunk at a time, so that writers are
+  // only blocked while a chunk is copied and not while it is visited.
+  struct ExportedKeyValue {
+    std::string key;
+    // Empty if the key is deleted.
+    std::optional<std::string> value;
+    int64_t logical_commit_time;
+    std::string_view prefix;
+  };
+  std::vector<ExportedKeyValue> key_values;
+  for (size_t begin = 0; begin < keys.size(); begin += kExportChunkSize) {
+    const size_t end = std::min(keys.size(), begin + kExportChunkSize);
+    key_values.clear();
+    {
+      absl::ReaderMutexLock lock(&mutex_);
+      for (size_t i = begin; i < end; ++i) {
+        // Keys cleaned up since are skipped.
+        if (const auto key_iter = map_.find(keys[i]); key_iter != map_.end()) {
+          const CacheValue& cache_value = key_iter->second;
+          key_values.push_back(
+              {.key = std::move(keys[i]),
+               .value = cache_value.value == nullptr
+                            ? std::nullopt
+                            : std::optional(*cache_value.value),
+               .logical_commit_time = cache_value.last_logical_commit_time,
+               .prefix = prefix_ids_.GetPrefix(cache_value.prefix_id)});
+        }
+      }
+    }
+    for (const auto& key_value : key_values) {
+      PS_RETURN_IF_ERROR(visitor.VisitKeyValue(
+          key_value.key,
+          key_value.value.has_value() ? std::string_view(*key_value.value)
+                                      : "",
+          key_value.logical_commit_time,
+          /*is_deleted=*/!key_value.value.has_value(), key_value.prefix));
+    }
+  }
+  PS_RETURN_IF_ERROR(ExportStringSets(visitor));
+  PS_RETURN_IF_ERROR(uint32_sets_cache_.Export(
+      kExportChunkSize,
+      [&visitor](std::string_view key, absl::Span<uint32_t> values,
+                 int64_t logical_commit_time, bool is_deleted,
+                 std::string_view prefix) {
+        return visitor.VisitUInt32ValueSet(key, values, logical_commit_time,
+                                           is_deleted, prefix);
+      }));
+  return uint64_sets_cache_.Export(
+      kExportChunkSize,
+      [&visitor](std::string_view key, absl::Span<uint64_t> values,
+                 int64_t logical_commit_time, bool is_deleted,
+                 std::string_view prefix) {
+        return visitor.VisitUInt64ValueSet(key, values, logical_commit_time,
+                                           is_deleted, prefix);
+      });
+}
+
+absl::Status KeyValueCache::ExportStringSets(CacheVisitor& visitor) {
+  std::vector<std::string> keys;
+  {
+    absl::ReaderMutexLock lock(&set_map_mutex_);
+    keys.reserve(key_to_value_set_map_.size());
+    for (const auto& [key, value_set] : key_to_value_set_map_) {
+      keys.push_back(key);
+    }
+  }
+  struct ExportedValues {
+    std::string_view key;
+    int64_t logical_commit_time;
+    bool is_deleted;
+    std::string_view prefix;
+    std::vector<std::string> values;
+  };
+  std::vector<ExportedValues> value_groups;
+  std::vector<std::string_view> values;
+  for (size_t begin = 0; begin < keys.size(); begin += kExportChunkSize) {
+    const size_t end = std::min(keys.size(), begin + kExportChunkSize);
+    value_groups.clear();
+    {
+      absl::ReaderMutexLock lock(&set_map_mutex_);
+      for (size_t i = begin; i < end; ++i) {
+        const auto key_iter = key_to_value_set_map_.find(keys[i]);
+        if (key_iter == key_to_value_set_map_.end()) {
+          continue;
+        }
+        absl::flat_hash_map<std::tuple<int64_t, bool, uint32_t>, size_t>
+            group_indices;
+        absl::ReaderMutexLock set_lock(&key_iter->second->first);
+        for (const auto& [value, meta] : key_iter->second->second) {
+          const auto [group_iter, inserted] = group_indices.try_emplace(
+              std::tuple(meta.last_logical_commit_time, meta.is_deleted,
+                         meta.prefix_id),
+              value_groups.size());
+          if (inserted) {
+            value_groups.push_back(
+                {.key = keys[i],
+                 .logical_commit_time = meta.last_logical_commit_time,
+                 .is_deleted = meta.is_deleted,
+                 .prefix = prefix_ids_.GetPrefix(meta.prefix_id)});
+          }
+          value_groups[group_iter->second].values.push_back(value);
+        }
+      }
+    }
+    for (const auto& value_group : value_groups) {
+      values.assign(value_group.values.begin(), value_group.values.end());
+      PS_RETURN_IF_ERROR(visitor.VisitKeyValueSet(
+          value_group.key, absl::MakeSpan(values),
+          value_group.logical_commit_time, value_group.is_deleted,
+          value_group.prefix));
+    }
+  }
+  return absl::OkStatus();
 }
 
 void KeyValueCache::LogCacheAccessMetrics(
@@ -518,7 +1002,326 @@ void KeyValueCache::LogCacheAccessMetrics(
           .AccumulateMetric<kCacheAccessEventCount>(1, cache_access_event));
 }
 
-std::unique_ptr<Cache> KeyValueCache::Create() {
-  return absl::WrapUnique(new KeyValueCache());
+absl::flat_hash_map<std::string, CacheMemoryStats>
+KeyValueCache::GetMemoryStats() const {
+  absl::flat_hash_map<std::string, CacheMemoryStats> memory_stats;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    for (const auto& [prefix, stats] : key_value_memory_stats_) {
+      memory_stats[prefix].key_values = stats;
+    }
+  }
+  {
+    absl::MutexLock lock(&set_memory_stats_mutex_);
+    for (const auto& [prefix, stats] : string_set_memory_stats_) {
+      memory_stats[prefix].string_sets = stats;
+    }
+  }
+  for (const auto& [prefix, stats] : uint32_sets_cache_.GetMemoryStats()) {
+    memory_stats[prefix].uint32_sets = stats;
+  }
+  for (const auto& [prefix, stats] : uint64_sets_cache_.GetMemoryStats()) {
+    memory_stats[prefix].uint64_sets = stats;
+  }
+  return memory_stats;
+}
+
+void KeyValueCache::LogMemoryMetrics() {
+  absl::MutexLock lock(&memory_metrics_mutex_);
+  for (const auto& [prefix, stats] : GetMemoryStats()) {
+    CacheMemoryStats& logged_stats = logged_memory_stats_[prefix];
+    LogValueMemoryMetrics(kKeyValueMemoryPartition, prefix, stats.key_values,
+                          logged_stats.key_values);
+    LogValueMemoryMetrics(kStringSetMemoryPartition, prefix, stats.string_sets,
+                          logged_stats.string_sets);
+    LogValueMemoryMetrics(kUInt32SetMemoryPartition, prefix, stats.uint32_sets,
+                          logged_stats.uint32_sets);
+    LogValueMemoryMetrics(kUInt64SetMemoryPartition, prefix, stats.uint64_sets,
+                          logged_stats.uint64_sets);
+    logged_stats = stats;
+  }
+}
+
+void KeyValueCache::AddStringSetMemoryStats(std::string_view prefix,
+                                            const ValueMemoryStats& delta) {
+  if (delta == ValueMemoryStats()) {
+    return;
+  }
+  absl::MutexLock lock(&set_memory_stats_mutex_);
+  string_set_memory_stats_[prefix] += delta;
+}
+
+void KeyValueCache::AddToKeyFilter(std::string_view key) {
+  if (!enable_key_filter_) {
+    return;
+  }
+  absl::ReaderMutexLock lock(&key_filter_mutex_);
+  key_filter_->Add(key);
+  if (rebuilt_key_filter_ != nullptr) {
+    rebuilt_key_filter_->Add(key);
+  }
+}
+
+bool KeyValueCache::KeyFilterHasNone(
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  if (!enable_key_filter_) {
+    return false;
+  }
+  absl::ReaderMutexLock lock(&key_filter_mutex_);
+  for (std::string_view key : key_set) {
+    if (key_filter_->MayContain(key)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<std::string_view> KeyValueCache::GetKeysToLookUp(
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  std::vector<std::string_view> keys;
+  keys.reserve(key_set.size());
+  if (!enable_key_filter_) {
+    keys.assign(key_set.begin(), key_set.end());
+    return keys;
+  }
+  absl::ReaderMutexLock lock(&key_filter_mutex_);
+  for (std::string_view key : key_set) {
+    if (key_filter_->MayContain(key)) {
+      keys.push_back(key);
+    }
+  }
+  return keys;
+}
+
+void KeyValueCache::AddRemovedKeys(int64_t num_keys) {
+  if (enable_key_filter_) {
+    num_removed_keys_.fetch_add(num_keys, std::memory_order_relaxed);
+  }
+}
+
+void KeyValueCache::MaybeRebuildKeyFilter() {
+  if (!enable_key_filter_) {
+    return;
+  }
+  auto rebuilt_key_filter = std::make_unique<ScalableBloomFilter>();
+  {
+    absl::MutexLock lock(&key_filter_mutex_);
+    if (rebuilt_key_filter_ != nullptr ||
+        num_removed_keys_.load(std::memory_order_relaxed) <=
+            num_key_filter_keys_) {
+      return;
+    }
+    // Keys added from now on are added to both filters by `AddToKeyFilter`,
+    // the keys already in the maps are added below.
+    rebuilt_key_filter_ = rebuilt_key_filter.get();
+    num_removed_keys_.store(0, std::memory_order_relaxed);
+  }
+  int64_t num_keys = 0;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    for (const auto& [key, cache_value] : map_) {
+      rebuilt_key_filter->Add(key);
+      ++num_keys;
+    }
+  }
+  {
+    absl::ReaderMutexLock lock(&set_map_mutex_);
+    for (const auto& [key, value_set] : key_to_value_set_map_) {
+      rebuilt_key_filter->Add(key);
+      ++num_keys;
+    }
+  }
+  const auto add_key = [&rebuilt_key_filter, &num_keys](std::string_view key) {
+    rebuilt_key_filter->Add(key);
+    ++num_keys;
+  };
+  uint32_sets_cache_.ForEachKey(add_key);
+  uint64_sets_cache_.ForEachKey(add_key);
+  absl::MutexLock lock(&key_filter_mutex_);
+  key_filter_ = std::move(rebuilt_key_filter);
+  rebuilt_key_filter_ = nullptr;
+  num_key_filter_keys_ = num_keys;
+}
+
+void KeyValueCache::VisitKeyValues(
+    const absl::flat_hash_set<std::string_view>& key_set,
+    bool serialized_json_values,
+    absl::FunctionRef<void(std::string_view key, const std::string* value,
+                           int64_t logical_commit_time)>
+        visit_fn) const {
+  const std::vector<std::string_view> keys = GetKeysToLookUp(key_set);
+  if (keys.empty()) {
+    return;
+  }
+  absl::ReaderMutexLock lock(&mutex_);
+  for (std::string_view key : keys) {
+    if (const auto key_iter = map_.find(key); key_iter != map_.end()) {
+      const CacheValue& cache_value = key_iter->second;
+      visit_fn(key,
+               serialized_json_values ? cache_value.serialized_json_value.get()
+                                      : cache_value.value.get(),
+               cache_value.last_logical_commit_time);
+    }
+  }
+}
+
+void KeyValueCache::VisitStringSetValues(
+    const absl::flat_hash_set<std::string_view>& key_set,
+    std::vector<std::unique_ptr<absl::ReaderMutexLock>>& key_locks,
+    absl::FunctionRef<void(std::string_view key, std::string_view value,
+                           int64_t logical_commit_time, bool is_deleted)>
+        visit_fn) const {
+  const std::vector<std::string_view> keys = GetKeysToLookUp(key_set);
+  if (keys.empty()) {
+    return;
+  }
+  absl::ReaderMutexLock lock(&set_map_mutex_);
+  for (std::string_view key : keys) {
+    const auto key_itr = key_to_value_set_map_.find(key);
+    if (key_itr == key_to_value_set_map_.end()) {
+      continue;
+    }
+    key_locks.push_back(
+        std::make_unique<absl::ReaderMutexLock>(&key_itr->second->first));
+    for (const auto& [value, meta] : key_itr->second->second) {
+      visit_fn(key, value, meta.last_logical_commit_time, meta.is_deleted);
+    }
+  }
+}
+
+KeyValueCache::Deletions KeyValueCache::GetDeletionsToRemove(
+    int64_t logical_commit_time, std::string_view prefix) const {
+  Deletions deletions;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    if (auto deleted_nodes_per_prefix = deleted_nodes_map_.find(prefix);
+        deleted_nodes_per_prefix != deleted_nodes_map_.end()) {
+      for (const auto& [commit_time, key] : deleted_nodes_per_prefix->second) {
+        if (commit_time > logical_commit_time) {
+          break;
+        }
+        if (auto key_iter = map_.find(key);
+            key_iter != map_.end() && key_iter->second.value == nullptr &&
+            key_iter->second.last_logical_commit_time <= logical_commit_time) {
+          deletions.keys.emplace_back(
+              key, key_iter->second.last_logical_commit_time);
+        }
+      }
+    }
+  }
+  {
+    absl::ReaderMutexLock lock(&set_map_mutex_);
+    if (auto deleted_nodes_per_prefix = deleted_set_nodes_map_.find(prefix);
+        deleted_nodes_per_prefix != deleted_set_nodes_map_.end()) {
+      for (const auto& [commit_time, deleted_sets] :
+           deleted_nodes_per_prefix->second) {
+        if (commit_time > logical_commit_time) {
+          break;
+        }
+        for (const auto& [key, values] : deleted_sets) {
+          auto key_itr = key_to_value_set_map_.find(key);
+          if (key_itr == key_to_value_set_map_.end()) {
+            continue;
+          }
+          absl::ReaderMutexLock key_lock(&key_itr->second->first);
+          for (const auto& value : values) {
+            if (auto value_itr = key_itr->second->second.find(value);
+                value_itr != key_itr->second->second.end() &&
+                value_itr->second.is_deleted &&
+                value_itr->second.last_logical_commit_time <=
+                    logical_commit_time) {
+              deletions.string_set_values.push_back(
+                  {.key = key,
+                   .value = value,
+                   .logical_commit_time =
+                       value_itr->second.last_logical_commit_time});
+            }
+          }
+        }
+      }
+    }
+  }
+  deletions.uint32_set_values =
+      uint32_sets_cache_.GetDeletionsToRemove(logical_commit_time, prefix);
+  deletions.uint64_set_values =
+      uint64_sets_cache_.GetDeletionsToRemove(logical_commit_time, prefix);
+  return deletions;
+}
+
+void KeyValueCache::EraseValuesOlderThan(const Deletions& deletions,
+                                         std::string_view prefix) {
+  if (!deletions.keys.empty()) {
+    // Deleted nodes of erased keys are skipped by the next cleanup.
+    absl::MutexLock lock(&mutex_);
+    ValueMemoryStats& memory_stats = key_value_memory_stats_[prefix];
+    for (const auto& [key, logical_commit_time] : deletions.keys) {
+      auto key_iter = map_.find(key);
+      if (key_iter == map_.end() ||
+          key_iter->second.last_logical_commit_time >= logical_commit_time) {
+        continue;
+      }
+      memory_stats.key_bytes -= key_iter->first.size();
+      if (key_iter->second.value == nullptr) {
+        --memory_stats.tombstones;
+      } else {
+        --memory_stats.cardinality;
+        memory_stats.value_bytes -= key_iter->second.ValueBytes();
+      }
+      map_.erase(key_iter);
+      AddRemovedKeys(1);
+    }
+  }
+  if (!deletions.string_set_values.empty()) {
+    absl::MutexLock lock_set_map(&set_map_mutex_);
+    ValueMemoryStats memory_stats_delta;
+    for (const auto& deletion : deletions.string_set_values) {
+      auto key_itr = key_to_value_set_map_.find(deletion.key);
+      if (key_itr == key_to_value_set_map_.end()) {
+        continue;
+      }
+      {
+        absl::MutexLock key_lock(&key_itr->second->first);
+        auto value_itr = key_itr->second->second.find(deletion.value);
+        if (value_itr == key_itr->second->second.end() ||
+            value_itr->second.last_logical_commit_time >=
+                deletion.logical_commit_time) {
+          continue;
+        }
+        if (value_itr->second.is_deleted) {
+          --memory_stats_delta.tombstones;
+        } else {
+          --memory_stats_delta.cardinality;
+        }
+        memory_stats_delta.value_bytes -= value_itr->first.size();
+        key_itr->second->second.erase(value_itr);
+      }
+      if (key_itr->second->second.empty()) {
+        memory_stats_delta.key_bytes -= key_itr->first.size();
+        key_to_value_set_map_.erase(key_itr);
+        AddRemovedKeys(1);
+      }
+    }
+    AddStringSetMemoryStats(prefix, memory_stats_delta);
+  }
+  uint32_sets_cache_.EraseValuesOlderThan(deletions.uint32_set_values, prefix);
+  uint64_sets_cache_.EraseValuesOlderThan(deletions.uint64_set_values, prefix);
+}
+
+std::unique_ptr<std::string> KeyValueCache::MaybeSerializeAsJsonValue(
+    std::string_view value) const {
+  if (!parse_json_values_) {
+    return nullptr;
+  }
+  return std::make_unique<std::string>(SerializeAsJsonValue(value));
+}
+
+KeyValueCache::KeyValueCache(KeyValueCacheOptions options)
+    : enable_key_filter_(options.enable_key_filter),
+      key_filter_(enable_key_filter_ ? std::make_unique<ScalableBloomFilter>()
+                                     : nullptr),
+      parse_json_values_(options.parse_json_values) {}
+
+std::unique_ptr<Cache> KeyValueCache::Create(KeyValueCacheOptions options) {
+  return absl::WrapUnique(new KeyValueCache(options));
 }
 }  // namespace kv_server
@@ -17,21 +17,42 @@
 #ifndef COMPONENTS_DATA_SERVER_CACHE_KEY_VALUE_CACHE_H_
 #define COMPONENTS_DATA_SERVER_CACHE_KEY_VALUE_CACHE_H_
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include "absl/container/btree_map.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
+#include "components/data_server/cache/bloom_filter.h"
 #include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/cache_memory_stats.h"
 #include "components/data_server/cache/get_key_value_set_result.h"
+#include "components/data_server/cache/prefix_ids.h"
 #include "components/data_server/cache/uint_value_set.h"
 #include "components/data_server/cache/uint_value_set_cache.h"
 
 namespace kv_server {
+
+struct KeyValueCacheOptions {
+  // Whether to keep a Bloom filter of the keys in the cache, so that most
+  // lookups of absent keys return without locking or probing the cache maps.
+  // Costs about 2 bytes of memory per key, and a shared lock of the filter per
+  // lookup. Lookups of uint sets are not filtered, since they only lock the
+  // looked up keys. The filter is rebuilt during cleanups once enough keys
+  // were removed.
+  bool enable_key_filter = false;
+  // Whether to convert key-value pairs with `SerializeAsJsonValue` when they
+  // are loaded, so that `GetSerializedJsonValues` does not parse the values on
+  // every lookup. About doubles the memory used by key-value pairs.
+  bool parse_json_values = false;
+};
+
 // In-memory datastore.
 // One cache object is only for keys in one namespace.
 class KeyValueCache : public Cache {
@@ -55,6 +76,16 @@ class KeyValueCache : public Cache {
       const RequestContext& request_context,
       const absl::flat_hash_set<std::string_view>& key_set) const override;
 
+  // Returns the values converted when they were loaded if
+  // `parse_json_values` is enabled.
+  absl::flat_hash_map<std::string, std::string> GetSerializedJsonValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Only returns false if the key filter is enabled. Keys stay in the filter
+  // after they are deleted, until the filter is next rebuilt.
+  bool MayContainKey(std::string_view key) const override;
+
   // Inserts or updates the key with the new value for a given prefix
   void UpdateKeyValue(
       privacy_sandbox::server_common::log::PSLogContext& log_context,
@@ -114,9 +145,60 @@ class KeyValueCache : public Cache {
       privacy_sandbox::server_common::log::PSLogContext& log_context,
       int64_t logical_commit_time, std::string_view prefix = "") override;
 
-  static std::unique_ptr<Cache> Create();
+  // Visits the key-value map, the string set map and the uint set maps in
+  // turn. Values are visited with the prefix of the mutation that last changed
+  // them.
+  absl::Status Export(CacheVisitor& visitor) override;
+
+  // Applies all mutations while holding the key-value map lock once.
+  void ApplyKeyValueMutations(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      absl::Span<const KeyValueMutation> mutations,
+      std::string_view prefix = "") override;
+
+  // Set mutations that read the values in place from flatbuffer vectors,
+  // without copying them into intermediate containers first.
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const FlatbufferStringVector& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint32_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint64_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const FlatbufferStringVector& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint32_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint64_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  // Returns the memory used by the cache per prefix. Changes are attributed
+  // to the prefix of the mutation or cleanup that made them, so the stats of a
+  // prefix are exact as long as prefixes do not share keys.
+  absl::flat_hash_map<std::string, CacheMemoryStats> GetMemoryStats() const;
+
+  static std::unique_ptr<Cache> Create(KeyValueCacheOptions options = {});
+
+  explicit KeyValueCache(KeyValueCacheOptions options = {});
 
  private:
+
   struct CacheValue {
     // We need to be able to set the value to null. For deletion we're keeping
     // the timestamp of the key (to prevent a specific type of out of order
@@ -126,7 +208,19 @@ class KeyValueCache : public Cache {
     // sizeof(string*) when null, sizeof(string*) + sizeof(string) otherwise
     // -- for the unique pointer
     std::unique_ptr<std::string> value;
+    // `value` converted with `SerializeAsJsonValue`, if `parse_json_values` is
+    // enabled and `value` is not null.
+    std::unique_ptr<std::string> serialized_json_value;
     int64_t last_logical_commit_time;
+    // Id in `prefix_ids_` of the prefix of the last update or delete.
+    uint32_t prefix_id;
+
+    // Size of the stored forms of the value.
+    int64_t ValueBytes() const {
+      return (value == nullptr ? 0 : value->size()) +
+             (serialized_json_value == nullptr ? 0
+                                               : serialized_json_value->size());
+    }
   };
   struct SetValueMeta {
     // Last logical commit time for a value
@@ -136,11 +230,111 @@ class KeyValueCache : public Cache {
     // because after deletion, this value should still exist in case
     // there are late-arriving updates to this.
     bool is_deleted;
-    SetValueMeta() : last_logical_commit_time(0), is_deleted(false) {}
-    SetValueMeta(int64_t logical_commit_time, bool deleted)
-        : last_logical_commit_time(logical_commit_time), is_deleted(deleted) {}
+    // Id in `prefix_ids_` of the prefix of the last update or delete. Fits in
+    // the padding after `is_deleted`.
+    uint32_t prefix_id;
+    SetValueMeta()
+        : last_logical_commit_time(0), is_deleted(false), prefix_id(0) {}
+    SetValueMeta(int64_t logical_commit_time, bool deleted, uint32_t prefix_id)
+        : last_logical_commit_time(logical_commit_time),
+          is_deleted(deleted),
+          prefix_id(prefix_id) {}
+  };
+
+  // Looks up the values of `key_set`, or their serialized JSON values if
+  // `serialized_json_values` is true, which requires `parse_json_values`.
+  absl::flat_hash_map<std::string, std::string> LookUpKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set,
+      bool serialized_json_values) const;
+
+  // A string set value marked as deleted.
+  struct StringSetDeletion {
+    std::string key;
+    std::string value;
+    int64_t logical_commit_time;
   };
 
+  // The deleted keys and set values that `RemoveDeletedKeys` would remove for
+  // a logical commit time and prefix.
+  struct Deletions {
+    std::vector<std::pair<std::string, int64_t>> keys;
+    std::vector<StringSetDeletion> string_set_values;
+    std::vector<UIntValueSetCache<UInt32ValueSet>::Deletion> uint32_set_values;
+    std::vector<UIntValueSetCache<UInt64ValueSet>::Deletion> uint64_set_values;
+  };
+
+  // Calls `visit_fn(key, value, logical_commit_time)` for the keys of
+  // `key_set` that are in the key-value map. `value` is null if the key is
+  // marked as deleted, and is the serialized JSON value if
+  // `serialized_json_values` is true, which requires `parse_json_values`.
+  void VisitKeyValues(
+      const absl::flat_hash_set<std::string_view>& key_set,
+      bool serialized_json_values,
+      absl::FunctionRef<void(std::string_view key, const std::string* value,
+                             int64_t logical_commit_time)>
+          visit_fn) const;
+
+  // Calls `visit_fn(key, value, logical_commit_time, is_deleted)` for every
+  // string set value of the keys of `key_set`, including values marked as
+  // deleted. Adds the locks of the visited keys to `key_locks`, the visited
+  // values stay valid while they are held.
+  void VisitStringSetValues(
+      const absl::flat_hash_set<std::string_view>& key_set,
+      std::vector<std::unique_ptr<absl::ReaderMutexLock>>& key_locks,
+      absl::FunctionRef<void(std::string_view key, std::string_view value,
+                             int64_t logical_commit_time, bool is_deleted)>
+          visit_fn) const;
+
+  // Returns the deletions that `RemoveDeletedKeys(logical_commit_time,
+  // prefix)` would remove.
+  Deletions GetDeletionsToRemove(int64_t logical_commit_time,
+                                 std::string_view prefix) const;
+
+  // Erases the keys and set values, deleted or not, that were last mutated
+  // before the matching deletion in `deletions`. Memory changes are attributed
+  // to `prefix`.
+  void EraseValuesOlderThan(const Deletions& deletions,
+                            std::string_view prefix);
+
+  // `serialized_json_value` is the result of `MaybeSerializeAsJsonValue` for
+  // `value`. `prefix_id` is the id of `prefix`.
+  void UpdateKeyValueLocked(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, std::string_view value,
+      std::unique_ptr<std::string> serialized_json_value,
+      int64_t logical_commit_time, std::string_view prefix, uint32_t prefix_id)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns `value` converted with `SerializeAsJsonValue`, or null if
+  // `parse_json_values` is disabled. Called before locking `mutex_`, so that
+  // parsing does not block lookups.
+  std::unique_ptr<std::string> MaybeSerializeAsJsonValue(
+      std::string_view value) const;
+
+  void DeleteKeyLocked(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, int64_t logical_commit_time,
+      std::string_view prefix, uint32_t prefix_id)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Inserts or updates string set values for a given key and prefix.
+  // `ValuesT` is any container of values convertible to `std::string_view`
+  // through `ToStringView()`, e.g., spans and flatbuffer vectors.
+  template <typename ValuesT>
+  void UpdateStringSetValues(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const ValuesT& input_value_set,
+      int64_t logical_commit_time, std::string_view prefix);
+
+  // Marks string set values as deleted for a given key and prefix. See
+  // `UpdateStringSetValues` for the requirements on `ValuesT`.
+  template <typename ValuesT>
+  void DeleteStringSetValues(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const ValuesT& value_set,
+      int64_t logical_commit_time, std::string_view prefix);
+
   // Removes deleted keys from key-value map for a given prefix
   void CleanUpKeyValueMap(
       privacy_sandbox::server_common::log::PSLogContext& log_context,
@@ -155,11 +349,46 @@ class KeyValueCache : public Cache {
       privacy_sandbox::server_common::log::PSLogContext& log_context,
       int64_t logical_commit_time, std::string_view prefix);
 
+  // Exports string sets for `Export`.
+  absl::Status ExportStringSets(CacheVisitor& visitor);
+
   // Logs cache access metrics for cache hit or miss counts. The cache access
   // event name is defined in server_definition.h file
   void LogCacheAccessMetrics(const RequestContext& request_context,
                              std::string_view cache_access_event) const;
 
+  // Logs the changes of the memory stats since they were last logged.
+  void LogMemoryMetrics();
+
+  void AddStringSetMemoryStats(std::string_view prefix,
+                               const ValueMemoryStats& delta);
+
+  // Adds `key` to the key filter, if enabled. Must be called under the lock of
+  // the map that the key is added to, before adding it, so that lookups of the
+  // map never miss the key. Otherwise, must be called after the key was
+  // added, so that `MaybeRebuildKeyFilter` does not miss it.
+  void AddToKeyFilter(std::string_view key);
+
+  // Returns true if the key filter is enabled and has none of `key_set`.
+  bool KeyFilterHasNone(
+      const absl::flat_hash_set<std::string_view>& key_set) const;
+
+  // Returns the keys of `key_set` that the key filter may have, i.e., all of
+  // them if it is disabled. Each key is hashed once.
+  std::vector<std::string_view> GetKeysToLookUp(
+      const absl::flat_hash_set<std::string_view>& key_set) const;
+
+  // Counts `num_keys` keys removed from the maps towards the next rebuild of
+  // the key filter.
+  void AddRemovedKeys(int64_t num_keys);
+
+  // Rebuilds the key filter from the keys in the maps, so that removed keys
+  // stop testing positive, once more keys were removed since it was last built
+  // than it was built with. The cost of a rebuild is thus amortized over the
+  // removals.
+  void MaybeRebuildKeyFilter() ABSL_LOCKS_EXCLUDED(
+      mutex_, set_map_mutex_, key_filter_mutex_);
+
   // mutex for key value map;
   mutable absl::Mutex mutex_;
   // mutex for key value set map;
@@ -180,6 +409,10 @@ class KeyValueCache : public Cache {
   absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_time_map_
       ABSL_GUARDED_BY(mutex_);
 
+  // Memory used by `map_` per prefix.
+  absl::flat_hash_map<std::string, ValueMemoryStats> key_value_memory_stats_
+      ABSL_GUARDED_BY(mutex_);
+
   // The key is the prefix and the value is the maximum
   // logical commit time that is used to do update/delete for key-value set map.
   // TODO(b/284474892) Need to evaluate if we really need to make this variable
@@ -211,10 +444,44 @@ class KeyValueCache : public Cache {
           absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>>>>
       deleted_set_nodes_map_ ABSL_GUARDED_BY(set_map_mutex_);
 
+  // Memory used by `key_to_value_set_map_` per prefix. String set values are
+  // updated under their key lock only, so these stats have their own mutex.
+  // No other lock is taken while holding it.
+  mutable absl::Mutex set_memory_stats_mutex_;
+  absl::flat_hash_map<std::string, ValueMemoryStats> string_set_memory_stats_
+      ABSL_GUARDED_BY(set_memory_stats_mutex_);
+
+  // The memory stats that were last logged as metrics.
+  absl::Mutex memory_metrics_mutex_;
+  absl::flat_hash_map<std::string, CacheMemoryStats> logged_memory_stats_
+      ABSL_GUARDED_BY(memory_metrics_mutex_);
+
+  // Ids of the prefixes recorded in `map_` and `key_to_value_set_map_`.
+  PrefixIds prefix_ids_;
+
   UIntValueSetCache<UInt32ValueSet> uint32_sets_cache_;
   UIntValueSetCache<UInt64ValueSet> uint64_sets_cache_;
 
+  const bool enable_key_filter_;
+  // Guards the key filter pointers only, the filters themselves are
+  // thread-safe. Taken after, and never while taking, the map locks.
+  mutable absl::Mutex key_filter_mutex_;
+  // Keys of all the maps above, or null if the key filter is disabled.
+  std::unique_ptr<ScalableBloomFilter> key_filter_
+      ABSL_GUARDED_BY(key_filter_mutex_);
+  // The filter that `MaybeRebuildKeyFilter` is building, if any. Keys are
+  // added to both filters until it replaces `key_filter_`.
+  ScalableBloomFilter* rebuilt_key_filter_ ABSL_GUARDED_BY(key_filter_mutex_) =
+      nullptr;
+  // Number of keys that `key_filter_` was last built with.
+  int64_t num_key_filter_keys_ ABSL_GUARDED_BY(key_filter_mutex_) = 0;
+  // Number of keys removed from the maps since `key_filter_` was last built.
+  std::atomic<int64_t> num_removed_keys_ = 0;
+
+  const bool parse_json_values_;
+
   friend class KeyValueCacheTestPeer;
+  friend class PrefixPartitionedCache;
 };
 }  // namespace kv_server
 
@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <random>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -23,10 +24,14 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/notification.h"
 #include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/cache_memory_stats.h"
 #include "components/data_server/cache/get_key_value_set_result.h"
+#include "components/data_server/cache/json_value.h"
 #include "components/data_server/cache/mocks.h"
+#include "flatbuffers/flatbuffers.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "public/base_types.pb.h"
@@ -99,6 +104,7 @@ class KeyValueCacheTestPeer {
 namespace {
 
 using privacy_sandbox::server_common::TelemetryProvider;
+using testing::Pair;
 using testing::UnorderedElementsAre;
 using testing::UnorderedElementsAreArray;
 
@@ -108,6 +114,14 @@ class SafePathTestLogContext
   SafePathTestLogContext() = default;
 };
 
+// Finishes `builder` with `offset` as root and returns a view over the root.
+template <typename T>
+const T* FinishAndGetRoot(flatbuffers::FlatBufferBuilder& builder,
+                          flatbuffers::Offset<T> offset) {
+  builder.Finish(offset);
+  return flatbuffers::GetRoot<T>(builder.GetBufferPointer());
+}
+
 class CacheTest : public ::testing::Test {
  protected:
   CacheTest() {
@@ -372,6 +386,28 @@ TEST_F(CacheTest, DeleteKeyInOrderDeleteAfterUpdateWorks) {
   EXPECT_EQ(kv_pairs.size(), 0);
 }
 
+TEST_F(CacheTest, ApplyKeyValueMutationsAppliesMutationsInOrder) {
+  std::unique_ptr<KeyValueCache> cache = std::make_unique<KeyValueCache>();
+  cache->UpdateKeyValue(safe_path_log_context_, "key1", "value1", 1);
+  cache->UpdateKeyValue(safe_path_log_context_, "key2", "value2", 5);
+  std::vector<Cache::KeyValueMutation> mutations = {
+      {.key = "key1", .logical_commit_time = 2, .is_deletion = true},
+      {.key = "key1", .value = "new_value1", .logical_commit_time = 3},
+      {.key = "key2", .value = "stale_value2", .logical_commit_time = 4},
+      {.key = "key3", .value = "value3", .logical_commit_time = 1},
+      {.key = "key3", .logical_commit_time = 2, .is_deletion = true},
+  };
+  cache->ApplyKeyValueMutations(safe_path_log_context_,
+                                absl::MakeSpan(mutations));
+  absl::flat_hash_set<std::string_view> keys = {"key1", "key2", "key3"};
+  absl::flat_hash_map<std::string, std::string> kv_pairs =
+      cache->GetKeyValuePairs(GetRequestContext(), keys);
+  EXPECT_THAT(kv_pairs, UnorderedElementsAre(KVPairEq("key1", "new_value1"),
+                                             KVPairEq("key2", "value2")));
+  auto deleted_nodes = KeyValueCacheTestPeer::ReadDeletedNodes(*cache);
+  EXPECT_THAT(deleted_nodes, UnorderedElementsAre(Pair(2, "key3")));
+}
+
 TEST_F(CacheTest, UpdateSetTestUpdateAfterUpdateWithSameValue) {
   std::unique_ptr<KeyValueCache> cache = std::make_unique<KeyValueCache>();
   std::vector<std::string_view> values = {"v1"};
@@ -1414,5 +1450,806 @@ TEST_F(CacheTest, VerifyCleaningUpUInt32Sets) {
   }
 }
 
+TEST_F(CacheTest, VerifyUpdatingStringSetsFromFlatbufferVectors) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  flatbuffers::FlatBufferBuilder values_builder;
+  const auto* values = FinishAndGetRoot(
+      values_builder, values_builder.CreateVectorOfStrings({"v1", "v2", "v3"}));
+  cache->UpdateKeyValueSet(safe_path_log_context_, "my_key", *values, 1);
+  flatbuffers::FlatBufferBuilder delete_builder;
+  const auto* values_to_delete = FinishAndGetRoot(
+      delete_builder, delete_builder.CreateVectorOfStrings({"v1", "v4"}));
+  cache->DeleteValuesInSet(safe_path_log_context_, "my_key", *values_to_delete,
+                           2);
+  absl::flat_hash_set<std::string_view> value_set =
+      cache->GetKeyValueSet(GetRequestContext(), {"my_key"})
+          ->GetValueSet("my_key");
+  EXPECT_THAT(value_set, UnorderedElementsAre("v2", "v3"));
+}
+
+TEST_F(CacheTest, VerifyUpdatingUInt32SetsFromFlatbufferVectors) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  flatbuffers::FlatBufferBuilder values_builder;
+  const auto* values = FinishAndGetRoot(
+      values_builder,
+      values_builder.CreateVector(std::vector<uint32_t>({1, 2, 3, 4, 5})));
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set1", *values, 1);
+  flatbuffers::FlatBufferBuilder delete_builder;
+  const auto* values_to_delete = FinishAndGetRoot(
+      delete_builder,
+      delete_builder.CreateVector(std::vector<uint32_t>({1, 2})));
+  cache->DeleteValuesInSet(safe_path_log_context_, "set1", *values_to_delete,
+                           2);
+  auto result = cache->GetUInt32ValueSet(GetRequestContext(), {"set1"});
+  auto* set = result->GetUInt32ValueSet("set1");
+  ASSERT_TRUE(set != nullptr);
+  EXPECT_THAT(set->GetValues(), UnorderedElementsAre(3, 4, 5));
+  EXPECT_THAT(set->GetRemovedValues(), UnorderedElementsAre(1, 2));
+}
+
+TEST_F(CacheTest, VerifyUpdatingUInt64SetsFromFlatbufferVectors) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  flatbuffers::FlatBufferBuilder values_builder;
+  const auto* values = FinishAndGetRoot(
+      values_builder, values_builder.CreateVector(std::vector<uint64_t>(
+                          {1, 2, 18446744073709551615UL})));
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set1", *values, 1);
+  auto result = cache->GetUInt64ValueSet(GetRequestContext(), {"set1"});
+  auto* set = result->GetUInt64ValueSet("set1");
+  ASSERT_TRUE(set != nullptr);
+  EXPECT_THAT(set->GetValues(),
+              UnorderedElementsAre(1, 2, 18446744073709551615UL));
+}
+
+// Applies the visited values to `cache`.
+class CopyingCacheVisitor : public CacheVisitor {
+ public:
+  CopyingCacheVisitor(
+      Cache& cache,
+      privacy_sandbox::server_common::log::PSLogContext& log_context)
+      : cache_(cache), log_context_(log_context) {}
+
+  absl::Status VisitCleanupLogicalCommitTimes(
+      const absl::flat_hash_map<std::string, int64_t>&
+          prefix_cleanup_logical_commit_times) override {
+    cleanup_logical_commit_times_ = prefix_cleanup_logical_commit_times;
+    return absl::OkStatus();
+  }
+
+  absl::Status VisitKeyValue(std::string_view key, std::string_view value,
+                             int64_t logical_commit_time, bool is_deleted,
+                             std::string_view prefix) override {
+    if (is_deleted) {
+      cache_.DeleteKey(log_context_, key, logical_commit_time, prefix);
+    } else {
+      cache_.UpdateKeyValue(log_context_, key, value, logical_commit_time,
+                            prefix);
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status VisitKeyValueSet(std::string_view key,
+                                absl::Span<std::string_view> values,
+                                int64_t logical_commit_time, bool is_deleted,
+                                std::string_view prefix) override {
+    return VisitSet(key, values, logical_commit_time, is_deleted, prefix);
+  }
+
+  absl::Status VisitUInt32ValueSet(std::string_view key,
+                                   absl::Span<uint32_t> values,
+                                   int64_t logical_commit_time,
+                                   bool is_deleted,
+                                   std::string_view prefix) override {
+    return VisitSet(key, values, logical_commit_time, is_deleted, prefix);
+  }
+
+  absl::Status VisitUInt64ValueSet(std::string_view key,
+                                   absl::Span<uint64_t> values,
+                                   int64_t logical_commit_time,
+                                   bool is_deleted,
+                                   std::string_view prefix) override {
+    return VisitSet(key, values, logical_commit_time, is_deleted, prefix);
+  }
+
+  const absl::flat_hash_map<std::string, int64_t>&
+  CleanupLogicalCommitTimes() const {
+    return cleanup_logical_commit_times_;
+  }
+
+ private:
+  template <typename T>
+  absl::Status VisitSet(std::string_view key, absl::Span<T> values,
+                        int64_t logical_commit_time, bool is_deleted,
+                        std::string_view prefix) {
+    if (is_deleted) {
+      cache_.DeleteValuesInSet(log_context_, key, values, logical_commit_time,
+                               prefix);
+    } else {
+      cache_.UpdateKeyValueSet(log_context_, key, values, logical_commit_time,
+                               prefix);
+    }
+    return absl::OkStatus();
+  }
+
+  Cache& cache_;
+  privacy_sandbox::server_common::log::PSLogContext& log_context_;
+  absl::flat_hash_map<std::string, int64_t> cleanup_logical_commit_times_;
+};
+
+TEST_F(CacheTest, ExportRecreatesCache) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue(safe_path_log_context_, "key1", "value1", 1);
+  cache->UpdateKeyValue(safe_path_log_context_, "key2", "value2", 2);
+  cache->DeleteKey(safe_path_log_context_, "key2", 3);
+  cache->RemoveDeletedKeys(safe_path_log_context_, 1, "prefix");
+  std::vector<std::string_view> string_values = {"v1", "v2", "v3"};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(string_values), 1);
+  std::vector<std::string_view> string_values_to_delete = {"v1"};
+  cache->DeleteValuesInSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(string_values_to_delete), 2);
+  std::vector<uint32_t> uint32_values = {1, 2, 3};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set2",
+                           absl::MakeSpan(uint32_values), 1);
+  std::vector<uint32_t> uint32_values_to_delete = {1};
+  cache->DeleteValuesInSet(safe_path_log_context_, "set2",
+                           absl::MakeSpan(uint32_values_to_delete), 2);
+  std::vector<uint64_t> uint64_values = {18446744073709551615UL};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set3",
+                           absl::MakeSpan(uint64_values), 1);
+
+  std::unique_ptr<Cache> copy = KeyValueCache::Create();
+  CopyingCacheVisitor visitor(*copy, safe_path_log_context_);
+  ASSERT_TRUE(cache->Export(visitor).ok());
+
+  EXPECT_THAT(visitor.CleanupLogicalCommitTimes(),
+              testing::Contains(testing::Pair("prefix", 1)));
+  EXPECT_THAT(copy->GetKeyValuePairs(GetRequestContext(), {"key1", "key2"}),
+              UnorderedElementsAre(testing::Pair("key1", "value1")));
+  // The deletion is kept, so late-arriving updates are still ignored.
+  copy->UpdateKeyValue(safe_path_log_context_, "key2", "value2", 2);
+  EXPECT_TRUE(copy->GetKeyValuePairs(GetRequestContext(), {"key2"}).empty());
+  EXPECT_THAT(copy->GetKeyValueSet(GetRequestContext(), {"set1"})
+                  ->GetValueSet("set1"),
+              UnorderedElementsAre("v2", "v3"));
+  auto uint32_result = copy->GetUInt32ValueSet(GetRequestContext(), {"set2"});
+  auto* uint32_set = uint32_result->GetUInt32ValueSet("set2");
+  ASSERT_TRUE(uint32_set != nullptr);
+  EXPECT_THAT(uint32_set->GetValues(), UnorderedElementsAre(2, 3));
+  EXPECT_THAT(uint32_set->GetRemovedValues(), UnorderedElementsAre(1));
+  auto uint64_result = copy->GetUInt64ValueSet(GetRequestContext(), {"set3"});
+  auto* uint64_set = uint64_result->GetUInt64ValueSet("set3");
+  ASSERT_TRUE(uint64_set != nullptr);
+  EXPECT_THAT(uint64_set->GetValues(),
+              UnorderedElementsAre(18446744073709551615UL));
+}
+
+TEST_F(CacheTest, ExportStopsOnVisitorError) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue(safe_path_log_context_, "key1", "value1", 1);
+  class FailingCacheVisitor : public CopyingCacheVisitor {
+   public:
+    using CopyingCacheVisitor::CopyingCacheVisitor;
+    absl::Status VisitKeyValue(std::string_view, std::string_view, int64_t,
+                               bool, std::string_view) override {
+      return absl::InternalError("failed");
+    }
+  };
+  std::unique_ptr<Cache> copy = KeyValueCache::Create();
+  FailingCacheVisitor visitor(*copy, safe_path_log_context_);
+  EXPECT_EQ(cache->Export(visitor).code(), absl::StatusCode::kInternal);
+}
+
+absl::flat_hash_map<std::string, CacheMemoryStats> GetMemoryStats(
+    const Cache& cache) {
+  return static_cast<const KeyValueCache&>(cache).GetMemoryStats();
+}
+
+CacheMemoryStats GetTotalMemoryStats(const Cache& cache) {
+  CacheMemoryStats total_stats;
+  for (const auto& [prefix, stats] : GetMemoryStats(cache)) {
+    total_stats.key_values += stats.key_values;
+    total_stats.string_sets += stats.string_sets;
+    total_stats.uint32_sets += stats.uint32_sets;
+    total_stats.uint64_sets += stats.uint64_sets;
+  }
+  return total_stats;
+}
+
+TEST_F(CacheTest, ExportKeepsDeletionPrefixes) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue(safe_path_log_context_, "key1", "value1", 1);
+  cache->DeleteKey(safe_path_log_context_, "key1", 2, "prefix");
+  std::vector<std::string_view> string_values = {"v1", "v2"};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(string_values), 1);
+  std::vector<std::string_view> string_values_to_delete = {"v1"};
+  cache->DeleteValuesInSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(string_values_to_delete), 2,
+                           "prefix");
+  std::vector<uint32_t> uint32_values = {1, 2};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set2",
+                           absl::MakeSpan(uint32_values), 1);
+  std::vector<uint32_t> uint32_values_to_delete = {1};
+  cache->DeleteValuesInSet(safe_path_log_context_, "set2",
+                           absl::MakeSpan(uint32_values_to_delete), 2,
+                           "prefix");
+
+  std::unique_ptr<Cache> copy = KeyValueCache::Create();
+  CopyingCacheVisitor visitor(*copy, safe_path_log_context_);
+  ASSERT_TRUE(cache->Export(visitor).ok());
+  CacheMemoryStats stats = GetTotalMemoryStats(*copy);
+  EXPECT_EQ(stats.key_values.tombstones, 1);
+  EXPECT_EQ(stats.string_sets.tombstones, 1);
+  EXPECT_EQ(stats.uint32_sets.tombstones, 1);
+
+  // The deletions are cleaned up with the prefix they were made with.
+  copy->RemoveDeletedKeys(safe_path_log_context_, 3, "prefix");
+  stats = GetTotalMemoryStats(*copy);
+  EXPECT_EQ(stats.key_values.tombstones, 0);
+  EXPECT_EQ(stats.string_sets.tombstones, 0);
+  EXPECT_EQ(stats.uint32_sets.tombstones, 0);
+  EXPECT_THAT(copy->GetKeyValueSet(GetRequestContext(), {"set1"})
+                  ->GetValueSet("set1"),
+              UnorderedElementsAre("v2"));
+}
+
+TEST_F(CacheTest, ExportKeepsUpdatePrefixes) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  std::unique_ptr<Cache> copy = KeyValueCache::Create();
+  std::vector<std::string_view> string_values = {"v1", "v2"};
+  std::vector<uint32_t> uint32_values = {1, 2};
+  std::vector<uint64_t> uint64_values = {3, 4};
+  for (const auto& prefix : {"", "prefix1", "prefix2"}) {
+    cache->UpdateKeyValue(safe_path_log_context_,
+                          absl::StrCat(prefix, "key1"), "value1", 1, prefix);
+    cache->UpdateKeyValueSet(safe_path_log_context_,
+                             absl::StrCat(prefix, "set1"),
+                             absl::MakeSpan(string_values), 1, prefix);
+    cache->UpdateKeyValueSet(safe_path_log_context_,
+                             absl::StrCat(prefix, "set2"),
+                             absl::MakeSpan(uint32_values), 1, prefix);
+    cache->UpdateKeyValueSet(safe_path_log_context_,
+                             absl::StrCat(prefix, "set3"),
+                             absl::MakeSpan(uint64_values), 1, prefix);
+  }
+  CopyingCacheVisitor visitor(*copy, safe_path_log_context_);
+  ASSERT_TRUE(cache->Export(visitor).ok());
+  EXPECT_TRUE(GetMemoryStats(*copy) == GetMemoryStats(*cache));
+
+  // Mutations of the restored values are accounted to the same prefix as in
+  // the original cache.
+  std::vector<std::string_view> string_values_to_delete = {"v1"};
+  std::vector<uint32_t> uint32_values_to_delete = {1};
+  std::vector<uint64_t> uint64_values_to_delete = {3};
+  for (Cache* c : {cache.get(), copy.get()}) {
+    c->UpdateKeyValue(safe_path_log_context_, "prefix1key1", "value2", 2,
+                      "prefix1");
+    c->DeleteKey(safe_path_log_context_, "prefix2key1", 2, "prefix2");
+    c->DeleteValuesInSet(safe_path_log_context_, "prefix1set1",
+                         absl::MakeSpan(string_values_to_delete), 2,
+                         "prefix1");
+    c->DeleteValuesInSet(safe_path_log_context_, "prefix1set2",
+                         absl::MakeSpan(uint32_values_to_delete), 2,
+                         "prefix1");
+    c->DeleteValuesInSet(safe_path_log_context_, "prefix2set3",
+                         absl::MakeSpan(uint64_values_to_delete), 2,
+                         "prefix2");
+    c->RemoveDeletedKeys(safe_path_log_context_, 2, "prefix2");
+  }
+  const auto memory_stats = GetMemoryStats(*copy);
+  EXPECT_TRUE(memory_stats == GetMemoryStats(*cache));
+  EXPECT_EQ(memory_stats.at("").key_values.cardinality, 1);
+  EXPECT_EQ(memory_stats.at("prefix1").key_values.cardinality, 1);
+  EXPECT_EQ(memory_stats.at("prefix1").key_values.value_bytes, 6);
+  EXPECT_EQ(memory_stats.at("prefix1").string_sets.cardinality, 1);
+  EXPECT_EQ(memory_stats.at("prefix1").string_sets.tombstones, 1);
+  EXPECT_EQ(memory_stats.at("prefix1").uint32_sets.tombstones, 1);
+  EXPECT_EQ(memory_stats.at("prefix2").key_values.key_bytes, 0);
+  EXPECT_EQ(memory_stats.at("prefix2").key_values.cardinality, 0);
+  EXPECT_EQ(memory_stats.at("prefix2").uint64_sets.cardinality, 1);
+  EXPECT_EQ(memory_stats.at("prefix2").uint64_sets.tombstones, 0);
+}
+
+TEST_F(CacheTest, ExportDoesNotBlockUpdatesWhileVisiting) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue(safe_path_log_context_, "key1", "value1", 1);
+  std::vector<std::string_view> string_values = {"v1"};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(string_values), 1);
+  std::vector<uint32_t> uint32_values = {1};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set2",
+                           absl::MakeSpan(uint32_values), 1);
+  // Writes a copy of every visited value back to the exported cache, which
+  // deadlocks if the visitor is called with a cache lock held.
+  class RenamingCacheVisitor : public CopyingCacheVisitor {
+   public:
+    using CopyingCacheVisitor::CopyingCacheVisitor;
+    absl::Status VisitKeyValue(std::string_view key, std::string_view value,
+                               int64_t logical_commit_time, bool is_deleted,
+                               std::string_view prefix) override {
+      return CopyingCacheVisitor::VisitKeyValue(absl::StrCat("copy_", key),
+                                                value, logical_commit_time,
+                                                is_deleted, prefix);
+    }
+    absl::Status VisitKeyValueSet(std::string_view key,
+                                  absl::Span<std::string_view> values,
+                                  int64_t logical_commit_time, bool is_deleted,
+                                  std::string_view prefix) override {
+      return CopyingCacheVisitor::VisitKeyValueSet(
+          absl::StrCat("copy_", key), values, logical_commit_time, is_deleted,
+          prefix);
+    }
+    absl::Status VisitUInt32ValueSet(std::string_view key,
+                                     absl::Span<uint32_t> values,
+                                     int64_t logical_commit_time,
+                                     bool is_deleted,
+                                     std::string_view prefix) override {
+      return CopyingCacheVisitor::VisitUInt32ValueSet(
+          absl::StrCat("copy_", key), values, logical_commit_time, is_deleted,
+          prefix);
+    }
+  };
+  RenamingCacheVisitor visitor(*cache, safe_path_log_context_);
+  ASSERT_TRUE(cache->Export(visitor).ok());
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"copy_key1"}),
+              UnorderedElementsAre(testing::Pair("copy_key1", "value1")));
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"copy_set1"})
+                  ->GetValueSet("copy_set1"),
+              UnorderedElementsAre("v1"));
+  auto uint32_result =
+      cache->GetUInt32ValueSet(GetRequestContext(), {"copy_set2"});
+  auto* uint32_set = uint32_result->GetUInt32ValueSet("copy_set2");
+  ASSERT_TRUE(uint32_set != nullptr);
+  EXPECT_THAT(uint32_set->GetValues(), UnorderedElementsAre(1));
+}
+
+// Recomputes the memory stats from the exported values. Keys of uint sets
+// without values are not exported, so their key bytes are not recomputed,
+// and neither are bitset sizes.
+class MemoryStatsCacheVisitor : public CacheVisitor {
+ public:
+  absl::Status VisitCleanupLogicalCommitTimes(
+      const absl::flat_hash_map<std::string, int64_t>&
+          prefix_cleanup_logical_commit_times) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status VisitKeyValue(std::string_view key, std::string_view value,
+                             int64_t logical_commit_time, bool is_deleted,
+                             std::string_view prefix) override {
+    stats_.key_values.key_bytes += key.size();
+    if (is_deleted) {
+      ++stats_.key_values.tombstones;
+    } else {
+      ++stats_.key_values.cardinality;
+      stats_.key_values.value_bytes += value.size();
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status VisitKeyValueSet(std::string_view key,
+                                absl::Span<std::string_view> values,
+                                int64_t logical_commit_time, bool is_deleted,
+                                std::string_view prefix) override {
+    if (string_set_keys_.insert(std::string(key)).second) {
+      stats_.string_sets.key_bytes += key.size();
+    }
+    for (std::string_view value : values) {
+      stats_.string_sets.value_bytes += value.size();
+    }
+    AddValues(values.size(), is_deleted, stats_.string_sets);
+    return absl::OkStatus();
+  }
+
+  absl::Status VisitUInt32ValueSet(std::string_view key,
+                                   absl::Span<uint32_t> values,
+                                   int64_t logical_commit_time,
+                                   bool is_deleted,
+                                   std::string_view prefix) override {
+    stats_.uint32_sets.value_bytes += values.size() * sizeof(uint32_t);
+    AddValues(values.size(), is_deleted, stats_.uint32_sets);
+    return absl::OkStatus();
+  }
+
+  absl::Status VisitUInt64ValueSet(std::string_view key,
+                                   absl::Span<uint64_t> values,
+                                   int64_t logical_commit_time,
+                                   bool is_deleted,
+                                   std::string_view prefix) override {
+    stats_.uint64_sets.value_bytes += values.size() * sizeof(uint64_t);
+    AddValues(values.size(), is_deleted, stats_.uint64_sets);
+    return absl::OkStatus();
+  }
+
+  const CacheMemoryStats& Stats() const { return stats_; }
+
+ private:
+  static void AddValues(int64_t num_values, bool is_deleted,
+                        ValueMemoryStats& stats) {
+    if (is_deleted) {
+      stats.tombstones += num_values;
+    } else {
+      stats.cardinality += num_values;
+    }
+  }
+
+  CacheMemoryStats stats_;
+  absl::flat_hash_set<std::string> string_set_keys_;
+};
+
+TEST_F(CacheTest, MemoryStatsTrackKeyValueUpdatesDeletesAndCleanup) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue(safe_path_log_context_, "key1", "value1", 1);
+  ValueMemoryStats expected_stats{
+      .key_bytes = 4, .cardinality = 1, .value_bytes = 6};
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).key_values == expected_stats);
+
+  cache->UpdateKeyValue(safe_path_log_context_, "key1", "v", 2);
+  expected_stats.value_bytes = 1;
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).key_values == expected_stats);
+
+  cache->DeleteKey(safe_path_log_context_, "key1", 3);
+  expected_stats = {.key_bytes = 4, .tombstones = 1};
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).key_values == expected_stats);
+
+  // Deleting a missing key adds a tombstone.
+  cache->DeleteKey(safe_path_log_context_, "key2", 4);
+  expected_stats = {.key_bytes = 8, .tombstones = 2};
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).key_values == expected_stats);
+
+  // Ignored updates do not change the stats.
+  cache->UpdateKeyValue(safe_path_log_context_, "key2", "value2", 3);
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).key_values == expected_stats);
+
+  cache->RemoveDeletedKeys(safe_path_log_context_, 4);
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).key_values == ValueMemoryStats());
+}
+
+TEST_F(CacheTest, MemoryStatsTrackStringSetUpdatesDeletesAndCleanup) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  std::vector<std::string_view> values = {"v1", "v22"};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(values), 1);
+  ValueMemoryStats expected_stats{
+      .key_bytes = 4, .cardinality = 2, .value_bytes = 5};
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).string_sets == expected_stats);
+
+  std::vector<std::string_view> values_to_delete = {"v1", "v333"};
+  cache->DeleteValuesInSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(values_to_delete), 2);
+  expected_stats = {
+      .key_bytes = 4, .cardinality = 1, .value_bytes = 9, .tombstones = 2};
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).string_sets == expected_stats);
+
+  std::vector<std::string_view> values_to_add = {"v1"};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(values_to_add), 3);
+  expected_stats = {
+      .key_bytes = 4, .cardinality = 2, .value_bytes = 9, .tombstones = 1};
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).string_sets == expected_stats);
+
+  cache->RemoveDeletedKeys(safe_path_log_context_, 3);
+  expected_stats = {.key_bytes = 4, .cardinality = 2, .value_bytes = 5};
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).string_sets == expected_stats);
+
+  cache->DeleteValuesInSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(values), 4);
+  cache->RemoveDeletedKeys(safe_path_log_context_, 4);
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).string_sets == ValueMemoryStats());
+}
+
+TEST_F(CacheTest, MemoryStatsTrackUIntSetUpdatesDeletesAndCleanup) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  std::vector<uint32_t> uint32_values = {1, 2, 3};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(uint32_values), 1);
+  std::vector<uint64_t> uint64_values = {18446744073709551615UL};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set22",
+                           absl::MakeSpan(uint64_values), 1);
+  auto stats = GetTotalMemoryStats(*cache);
+  EXPECT_EQ(stats.uint32_sets.key_bytes, 4);
+  EXPECT_EQ(stats.uint32_sets.cardinality, 3);
+  EXPECT_EQ(stats.uint32_sets.value_bytes, 12);
+  EXPECT_EQ(stats.uint32_sets.tombstones, 0);
+  EXPECT_GT(stats.uint32_sets.bitset_bytes, 0);
+  EXPECT_EQ(stats.uint64_sets.key_bytes, 5);
+  EXPECT_EQ(stats.uint64_sets.cardinality, 1);
+  EXPECT_EQ(stats.uint64_sets.value_bytes, 8);
+  EXPECT_GT(stats.uint64_sets.bitset_bytes, 0);
+
+  std::vector<uint32_t> uint32_values_to_delete = {1};
+  cache->DeleteValuesInSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(uint32_values_to_delete), 2);
+  stats = GetTotalMemoryStats(*cache);
+  EXPECT_EQ(stats.uint32_sets.cardinality, 2);
+  EXPECT_EQ(stats.uint32_sets.value_bytes, 12);
+  EXPECT_EQ(stats.uint32_sets.tombstones, 1);
+
+  cache->RemoveDeletedKeys(safe_path_log_context_, 2);
+  stats = GetTotalMemoryStats(*cache);
+  EXPECT_EQ(stats.uint32_sets.key_bytes, 4);
+  EXPECT_EQ(stats.uint32_sets.cardinality, 2);
+  EXPECT_EQ(stats.uint32_sets.value_bytes, 8);
+  EXPECT_EQ(stats.uint32_sets.tombstones, 0);
+}
+
+TEST_F(CacheTest, MemoryStatsAreAttributedToPrefixes) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue(safe_path_log_context_, "key1", "value1", 1);
+  cache->DeleteKey(safe_path_log_context_, "key22", 1, "prefix");
+  std::vector<uint32_t> uint32_values = {1, 2};
+  cache->DeleteValuesInSet(safe_path_log_context_, "set1",
+                           absl::MakeSpan(uint32_values), 1, "prefix");
+
+  auto memory_stats = GetMemoryStats(*cache);
+  ASSERT_TRUE(memory_stats.contains(""));
+  ASSERT_TRUE(memory_stats.contains("prefix"));
+  EXPECT_EQ(memory_stats[""].key_values.cardinality, 1);
+  EXPECT_EQ(memory_stats[""].key_values.tombstones, 0);
+  EXPECT_EQ(memory_stats["prefix"].key_values.key_bytes, 5);
+  EXPECT_EQ(memory_stats["prefix"].key_values.tombstones, 1);
+  EXPECT_EQ(memory_stats["prefix"].uint32_sets.tombstones, 2);
+
+  // Cleaning up the root prefix leaves the tombstones of other prefixes.
+  cache->RemoveDeletedKeys(safe_path_log_context_, 1);
+  memory_stats = GetMemoryStats(*cache);
+  EXPECT_EQ(memory_stats["prefix"].key_values.tombstones, 1);
+  EXPECT_EQ(memory_stats["prefix"].uint32_sets.tombstones, 2);
+
+  cache->RemoveDeletedKeys(safe_path_log_context_, 1, "prefix");
+  memory_stats = GetMemoryStats(*cache);
+  EXPECT_EQ(memory_stats[""].key_values.cardinality, 1);
+  EXPECT_EQ(memory_stats["prefix"].key_values.key_bytes, 0);
+  EXPECT_EQ(memory_stats["prefix"].key_values.tombstones, 0);
+  EXPECT_EQ(memory_stats["prefix"].uint32_sets.tombstones, 0);
+}
+
+TEST_F(CacheTest, MemoryStatsMatchCacheContentsAfterOutOfOrderMutations) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  const std::vector<std::string> keys = {"a", "bb", "ccc", "dddd"};
+  const std::vector<std::string> string_values = {"v", "vv", "vvv"};
+  std::mt19937 generator(/*seed=*/42);
+  auto random = [&generator](int64_t bound) {
+    return std::uniform_int_distribution<int64_t>(0, bound - 1)(generator);
+  };
+  for (int64_t i = 1; i <= 2000; ++i) {
+    // Commit times arrive out of order, by up to 20.
+    const int64_t logical_commit_time = std::max<int64_t>(1, i - random(20));
+    const std::string& key = keys[random(keys.size())];
+    std::vector<std::string_view> set_values = {
+        string_values[random(string_values.size())],
+        string_values[random(string_values.size())]};
+    std::vector<uint32_t> uint32_values = {
+        static_cast<uint32_t>(random(100)), static_cast<uint32_t>(random(100))};
+    std::vector<uint64_t> uint64_values = {
+        static_cast<uint64_t>(random(100)), static_cast<uint64_t>(random(100))};
+    switch (random(9)) {
+      case 0:
+        cache->UpdateKeyValue(safe_path_log_context_, key,
+                              string_values[random(string_values.size())],
+                              logical_commit_time);
+        break;
+      case 1:
+        cache->DeleteKey(safe_path_log_context_, key, logical_commit_time);
+        break;
+      case 2:
+        cache->UpdateKeyValueSet(safe_path_log_context_, key,
+                                 absl::MakeSpan(set_values),
+                                 logical_commit_time);
+        break;
+      case 3:
+        cache->DeleteValuesInSet(safe_path_log_context_, key,
+                                 absl::MakeSpan(set_values),
+                                 logical_commit_time);
+        break;
+      case 4:
+        cache->UpdateKeyValueSet(safe_path_log_context_, key,
+                                 absl::MakeSpan(uint32_values),
+                                 logical_commit_time);
+        break;
+      case 5:
+        cache->DeleteValuesInSet(safe_path_log_context_, key,
+                                 absl::MakeSpan(uint32_values),
+                                 logical_commit_time);
+        break;
+      case 6:
+        cache->UpdateKeyValueSet(safe_path_log_context_, key,
+                                 absl::MakeSpan(uint64_values),
+                                 logical_commit_time);
+        break;
+      case 7:
+        cache->DeleteValuesInSet(safe_path_log_context_, key,
+                                 absl::MakeSpan(uint64_values),
+                                 logical_commit_time);
+        break;
+      case 8:
+        cache->RemoveDeletedKeys(safe_path_log_context_,
+                                 logical_commit_time - 20);
+        break;
+    }
+  }
+  MemoryStatsCacheVisitor visitor;
+  ASSERT_TRUE(cache->Export(visitor).ok());
+  const CacheMemoryStats& expected_stats = visitor.Stats();
+  const CacheMemoryStats stats = GetTotalMemoryStats(*cache);
+  EXPECT_TRUE(stats.key_values == expected_stats.key_values);
+  EXPECT_TRUE(stats.string_sets == expected_stats.string_sets);
+  for (const auto& [uint_stats, expected_uint_stats] :
+       {std::pair(stats.uint32_sets, expected_stats.uint32_sets),
+        std::pair(stats.uint64_sets, expected_stats.uint64_sets)}) {
+    EXPECT_EQ(uint_stats.cardinality, expected_uint_stats.cardinality);
+    EXPECT_EQ(uint_stats.value_bytes, expected_uint_stats.value_bytes);
+    EXPECT_EQ(uint_stats.tombstones, expected_uint_stats.tombstones);
+  }
+}
+
+TEST_F(CacheTest, KeyFilterIsDisabledByDefault) {
+  auto cache = KeyValueCache::Create();
+  EXPECT_TRUE(cache->MayContainKey("key"));
+}
+
+TEST_F(CacheTest, KeyFilterHasKeysOfAllValueTypes) {
+  auto cache = KeyValueCache::Create({.enable_key_filter = true});
+  EXPECT_FALSE(cache->MayContainKey("key"));
+  std::vector<std::string_view> string_values = {"v1", "v2"};
+  std::vector<uint32_t> uint32_values = {1, 2};
+  std::vector<uint64_t> uint64_values = {3, 4};
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "value", 1);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "string_set",
+                           absl::MakeSpan(string_values), 1);
+  cache->DeleteValuesInSet(safe_path_log_context_, "deleted_string_set",
+                           absl::MakeSpan(string_values), 1);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "uint32_set",
+                           absl::MakeSpan(uint32_values), 1);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "uint64_set",
+                           absl::MakeSpan(uint64_values), 1);
+  for (std::string_view key : {"key", "string_set", "deleted_string_set",
+                               "uint32_set", "uint64_set"}) {
+    EXPECT_TRUE(cache->MayContainKey(key)) << key;
+  }
+  EXPECT_FALSE(cache->MayContainKey("absent"));
+
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key", "absent"}),
+              UnorderedElementsAre(KVPairEq("key", "value")));
+  EXPECT_TRUE(cache->GetKeyValuePairs(GetRequestContext(), {"absent"}).empty());
+  auto result =
+      cache->GetKeyValueSet(GetRequestContext(), {"string_set", "absent"});
+  EXPECT_THAT(result->GetValueSet("string_set"),
+              UnorderedElementsAre("v1", "v2"));
+  EXPECT_TRUE(result->GetValueSet("absent").empty());
+}
+
+TEST_F(CacheTest, KeyFilterDoesNotChangeLookupResults) {
+  auto cache = KeyValueCache::Create();
+  auto filtered_cache = KeyValueCache::Create({.enable_key_filter = true});
+  std::mt19937 random_engine(42);
+  std::uniform_int_distribution<int> key_distribution(0, 99);
+  std::uniform_int_distribution<int> operation_distribution(0, 4);
+  std::vector<std::string_view> string_values = {"v1", "v2"};
+  for (int64_t logical_commit_time = 1; logical_commit_time <= 500;
+       ++logical_commit_time) {
+    const std::string key =
+        absl::StrCat("key", key_distribution(random_engine));
+    const int operation = operation_distribution(random_engine);
+    for (Cache* c : {cache.get(), filtered_cache.get()}) {
+      switch (operation) {
+        case 0:
+          c->UpdateKeyValue(safe_path_log_context_, key, "value",
+                            logical_commit_time);
+          break;
+        case 1:
+          c->DeleteKey(safe_path_log_context_, key, logical_commit_time);
+          break;
+        case 2:
+          c->UpdateKeyValueSet(safe_path_log_context_, key,
+                               absl::MakeSpan(string_values),
+                               logical_commit_time);
+          break;
+        case 3:
+          c->DeleteValuesInSet(safe_path_log_context_, key,
+                               absl::MakeSpan(string_values),
+                               logical_commit_time);
+          break;
+        case 4:
+          c->RemoveDeletedKeys(safe_path_log_context_,
+                               logical_commit_time - 50);
+          break;
+      }
+    }
+  }
+  // Keys 100 and above were never added.
+  std::vector<std::string> keys;
+  for (int i = 0; i < 200; ++i) {
+    keys.push_back(absl::StrCat("key", i));
+  }
+  for (const auto& key : keys) {
+    const absl::flat_hash_set<std::string_view> key_set = {key};
+    EXPECT_EQ(cache->GetKeyValuePairs(GetRequestContext(), key_set),
+              filtered_cache->GetKeyValuePairs(GetRequestContext(), key_set))
+        << key;
+    EXPECT_THAT(
+        filtered_cache->GetKeyValueSet(GetRequestContext(), key_set)
+            ->GetValueSet(key),
+        UnorderedElementsAreArray(
+            cache->GetKeyValueSet(GetRequestContext(), key_set)
+                ->GetValueSet(key)))
+        << key;
+  }
+}
+
+TEST_F(CacheTest, KeyFilterIsRebuiltWithoutRemovedKeys) {
+  auto cache = KeyValueCache::Create({.enable_key_filter = true});
+  std::vector<std::string_view> string_values = {"v1"};
+  std::vector<uint32_t> uint32_values = {1};
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "value", 1);
+  cache->UpdateKeyValue(safe_path_log_context_, "removed_key", "value", 1);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "string_set",
+                           absl::MakeSpan(string_values), 1);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "removed_string_set",
+                           absl::MakeSpan(string_values), 1);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "uint32_set",
+                           absl::MakeSpan(uint32_values), 1);
+  cache->DeleteKey(safe_path_log_context_, "removed_key", 2);
+  cache->DeleteValuesInSet(safe_path_log_context_, "removed_string_set",
+                           absl::MakeSpan(string_values), 2);
+  EXPECT_TRUE(cache->MayContainKey("removed_key"));
+  EXPECT_TRUE(cache->MayContainKey("removed_string_set"));
+
+  cache->RemoveDeletedKeys(safe_path_log_context_, 2);
+  EXPECT_FALSE(cache->MayContainKey("removed_key"));
+  EXPECT_FALSE(cache->MayContainKey("removed_string_set"));
+  for (std::string_view key : {"key", "string_set", "uint32_set"}) {
+    EXPECT_TRUE(cache->MayContainKey(key)) << key;
+  }
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key"}),
+              UnorderedElementsAre(KVPairEq("key", "value")));
+
+  // Keys added after the rebuild are in the rebuilt filter.
+  cache->UpdateKeyValue(safe_path_log_context_, "removed_key", "value", 3);
+  EXPECT_TRUE(cache->MayContainKey("removed_key"));
+}
+
+TEST_F(CacheTest, SerializedJsonValuesAreParsedOnLoad) {
+  for (const bool parse_json_values : {false, true}) {
+    auto cache =
+        KeyValueCache::Create({.parse_json_values = parse_json_values});
+    cache->UpdateKeyValue(safe_path_log_context_, "json", R"({"a": [1]})", 1);
+    cache->UpdateKeyValue(safe_path_log_context_, "string", "not json", 1);
+    std::vector<Cache::KeyValueMutation> mutations = {
+        {.key = "batched", .value = "2", .logical_commit_time = 1},
+        {.key = "deleted", .logical_commit_time = 1, .is_deletion = true},
+    };
+    cache->ApplyKeyValueMutations(safe_path_log_context_,
+                                  absl::MakeSpan(mutations));
+    EXPECT_THAT(
+        cache->GetSerializedJsonValues(
+            GetRequestContext(),
+            {"json", "string", "batched", "deleted", "absent"}),
+        UnorderedElementsAre(
+            KVPairEq("json", SerializeAsJsonValue(R"({"a": [1]})")),
+            KVPairEq("string", SerializeAsJsonValue("not json")),
+            KVPairEq("batched", SerializeAsJsonValue("2"))))
+        << parse_json_values;
+    // The values themselves are not changed.
+    EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"string"}),
+                UnorderedElementsAre(KVPairEq("string", "not json")))
+        << parse_json_values;
+  }
+}
+
+TEST_F(CacheTest, MemoryStatsIncludeSerializedJsonValues) {
+  auto cache = KeyValueCache::Create({.parse_json_values = true});
+  cache->UpdateKeyValue(safe_path_log_context_, "key1", "[1]", 1);
+  const int64_t json_value_bytes = SerializeAsJsonValue("[1]").size();
+  ValueMemoryStats expected_stats{
+      .key_bytes = 4, .cardinality = 1, .value_bytes = 3 + json_value_bytes};
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).key_values == expected_stats);
+
+  cache->DeleteKey(safe_path_log_context_, "key1", 2);
+  expected_stats = {.key_bytes = 4, .tombstones = 1};
+  EXPECT_TRUE(GetTotalMemoryStats(*cache).key_values == expected_stats);
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/prefix_ids.h"
+
+namespace kv_server {
+
+PrefixIds::PrefixIds() {
+  ids_.emplace("", 0);
+  prefixes_.emplace_back();
+}
+
+uint32_t PrefixIds::GetOrAddId(std::string_view prefix) {
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    if (const auto id_iter = ids_.find(prefix); id_iter != ids_.end()) {
+      return id_iter->second;
+    }
+  }
+  absl::MutexLock lock(&mutex_);
+  const auto [id_iter, inserted] = ids_.try_emplace(prefix, prefixes_.size());
+  if (inserted) {
+    prefixes_.emplace_back(prefix);
+  }
+  return id_iter->second;
+}
+
+std::string_view PrefixIds::GetPrefix(uint32_t id) const {
+  absl::ReaderMutexLock lock(&mutex_);
+  return prefixes_[id];
+}
+
+}  // namespace kv_server
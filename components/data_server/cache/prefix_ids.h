@@ -0,0 +1,59 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_PREFIX_IDS_H_
+#define COMPONENTS_DATA_SERVER_CACHE_PREFIX_IDS_H_
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+namespace kv_server {
+
+// Assigns small integer ids to the prefixes of a cache, so that cache entries
+// can record the prefix they were last mutated with in 4 bytes. Ids are never
+// reused. The empty prefix has id 0.
+//
+// This class is thread-safe.
+class PrefixIds {
+ public:
+  PrefixIds();
+
+  PrefixIds(const PrefixIds&) = delete;
+  PrefixIds& operator=(const PrefixIds&) = delete;
+
+  // Returns the id of `prefix`, assigning one if it has none yet.
+  uint32_t GetOrAddId(std::string_view prefix) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the prefix of `id`, which must have been returned by `GetOrAddId`.
+  // The returned view stays valid for the lifetime of this object.
+  std::string_view GetPrefix(uint32_t id) const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, uint32_t> ids_ ABSL_GUARDED_BY(mutex_);
+  // Indexed by id. A deque, so that views of its elements stay valid when
+  // prefixes are added.
+  std::deque<std::string> prefixes_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_PREFIX_IDS_H_
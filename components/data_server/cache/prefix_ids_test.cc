@@ -0,0 +1,65 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/prefix_ids.h"
+
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(PrefixIdsTest, AssignsStableIds) {
+  PrefixIds prefix_ids;
+  EXPECT_EQ(prefix_ids.GetOrAddId(""), 0);
+  const uint32_t id1 = prefix_ids.GetOrAddId("prefix1");
+  const uint32_t id2 = prefix_ids.GetOrAddId("prefix2");
+  EXPECT_NE(id1, 0);
+  EXPECT_NE(id1, id2);
+  EXPECT_EQ(prefix_ids.GetOrAddId("prefix1"), id1);
+  EXPECT_EQ(prefix_ids.GetPrefix(0), "");
+  EXPECT_EQ(prefix_ids.GetPrefix(id1), "prefix1");
+  EXPECT_EQ(prefix_ids.GetPrefix(id2), "prefix2");
+}
+
+TEST(PrefixIdsTest, ViewsStayValidWhenPrefixesAreAdded) {
+  PrefixIds prefix_ids;
+  const std::string_view prefix =
+      prefix_ids.GetPrefix(prefix_ids.GetOrAddId("prefix"));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&prefix_ids, t] {
+      for (int i = 0; i < 1000; ++i) {
+        const std::string other = absl::StrCat("other", t, "_", i);
+        EXPECT_EQ(prefix_ids.GetPrefix(prefix_ids.GetOrAddId(other)), other);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(prefix, "prefix");
+  EXPECT_EQ(prefix_ids.GetOrAddId("prefix"),
+            prefix_ids.GetOrAddId(std::string("prefix")));
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,654 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/prefix_partitioned_cache.h"
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "src/util/status_macro/status_macros.h"
+
+namespace kv_server {
+namespace {
+
+// Holds the locks and results of the partitions that a lookup consulted, and
+// the values it resolved from them.
+class PrefixPartitionedGetKeyValueSetResult : public GetKeyValueSetResult {
+ public:
+  absl::flat_hash_set<std::string_view> GetValueSet(
+      std::string_view key) const override {
+    if (auto key_itr = string_sets_.find(key); key_itr != string_sets_.end()) {
+      return key_itr->second;
+    }
+    return {};
+  }
+  const UInt32ValueSet* GetUInt32ValueSet(
+      std::string_view key) const override {
+    auto key_itr = uint32_sets_.find(key);
+    return key_itr == uint32_sets_.end() ? nullptr : key_itr->second;
+  }
+  const UInt64ValueSet* GetUInt64ValueSet(
+      std::string_view key) const override {
+    auto key_itr = uint64_sets_.find(key);
+    return key_itr == uint64_sets_.end() ? nullptr : key_itr->second;
+  }
+
+  // Keeps `result` and `key_locks`, which guard the values added to this
+  // object, until this object goes out of scope.
+  void AddPartitionResult(std::unique_ptr<GetKeyValueSetResult> result) {
+    results_.push_back(std::move(result));
+  }
+  void AddKeyLocks(
+      std::vector<std::unique_ptr<absl::ReaderMutexLock>> key_locks) {
+    std::move(key_locks.begin(), key_locks.end(),
+              std::back_inserter(key_locks_));
+  }
+
+  void AddStringSet(std::string_view key,
+                    absl::flat_hash_set<std::string_view> values) {
+    string_sets_.emplace(key, std::move(values));
+  }
+  template <typename SetType>
+  void AddUIntSet(std::string_view key, const SetType* value_set) {
+    if constexpr (std::is_same_v<SetType, UInt32ValueSet>) {
+      uint32_sets_.emplace(key, value_set);
+    } else {
+      uint64_sets_.emplace(key, value_set);
+    }
+  }
+  template <typename SetType>
+  void AddMergedUIntSet(std::string_view key,
+                        std::unique_ptr<SetType> value_set) {
+    AddUIntSet(key, value_set.get());
+    if constexpr (std::is_same_v<SetType, UInt32ValueSet>) {
+      merged_uint32_sets_.push_back(std::move(value_set));
+    } else {
+      merged_uint64_sets_.push_back(std::move(value_set));
+    }
+  }
+
+ private:
+  // Values are added through the methods above.
+  void AddKeyValueSet(
+      std::string_view key, absl::flat_hash_set<std::string_view> value_set,
+      std::unique_ptr<absl::ReaderMutexLock> key_lock) override {}
+  void AddUIntValueSet(
+      std::string_view key,
+      ThreadSafeHashMap<std::string, UInt32ValueSet>::ConstLockedNodePtr
+          value_set_node) override {}
+  void AddUIntValueSet(
+      std::string_view key,
+      ThreadSafeHashMap<std::string, UInt64ValueSet>::ConstLockedNodePtr
+          value_set_node) override {}
+
+  std::vector<std::unique_ptr<GetKeyValueSetResult>> results_;
+  std::vector<std::unique_ptr<absl::ReaderMutexLock>> key_locks_;
+  absl::flat_hash_map<std::string_view, absl::flat_hash_set<std::string_view>>
+      string_sets_;
+  absl::flat_hash_map<std::string_view, const UInt32ValueSet*> uint32_sets_;
+  absl::flat_hash_map<std::string_view, const UInt64ValueSet*> uint64_sets_;
+  std::vector<std::unique_ptr<UInt32ValueSet>> merged_uint32_sets_;
+  std::vector<std::unique_ptr<UInt64ValueSet>> merged_uint64_sets_;
+};
+
+// The latest mutation of a key or set value seen so far.
+struct LatestMutation {
+  int64_t logical_commit_time;
+  bool is_deleted;
+
+  // Replaces this mutation if the other one is newer. Partitions are visited
+  // in the order of their prefixes, so the first prefix wins ties.
+  void Update(int64_t other_logical_commit_time, bool other_is_deleted) {
+    if (other_logical_commit_time > logical_commit_time) {
+      logical_commit_time = other_logical_commit_time;
+      is_deleted = other_is_deleted;
+    }
+  }
+};
+
+template <typename SetType>
+const SetType* GetUIntSet(const GetKeyValueSetResult& result,
+                          std::string_view key) {
+  if constexpr (std::is_same_v<SetType, UInt32ValueSet>) {
+    return result.GetUInt32ValueSet(key);
+  } else {
+    return result.GetUInt64ValueSet(key);
+  }
+}
+
+// Returns a set with the latest mutation of each value of `value_sets`.
+template <typename SetType>
+std::unique_ptr<SetType> MergeUIntSets(
+    const std::vector<const SetType*>& value_sets) {
+  absl::flat_hash_map<typename SetType::value_type, LatestMutation>
+      latest_mutations;
+  for (const SetType* value_set : value_sets) {
+    value_set->ForEachValue([&latest_mutations](
+                                typename SetType::value_type value,
+                                int64_t logical_commit_time, bool is_deleted,
+                                uint32_t prefix_id) {
+      auto [mutation_itr, inserted] = latest_mutations.try_emplace(
+          value, LatestMutation{logical_commit_time, is_deleted});
+      if (!inserted) {
+        mutation_itr->second.Update(logical_commit_time, is_deleted);
+      }
+    });
+  }
+  // Adds the values in groups, since every call optimizes the bitset.
+  absl::flat_hash_map<std::pair<int64_t, bool>,
+                      std::vector<typename SetType::value_type>>
+      value_groups;
+  for (const auto& [value, mutation] : latest_mutations) {
+    value_groups[{mutation.logical_commit_time, mutation.is_deleted}]
+        .push_back(value);
+  }
+  auto merged_set = std::make_unique<SetType>();
+  for (const auto& [mutation, values] : value_groups) {
+    if (mutation.second) {
+      merged_set->Remove(values, mutation.first);
+    } else {
+      merged_set->Add(values, mutation.first);
+    }
+  }
+  return merged_set;
+}
+
+void LogCacheAccessMetrics(const RequestContext& request_context,
+                           std::string_view cache_access_event) {
+  LogIfError(
+      request_context.GetInternalLookupMetricsContext()
+          .AccumulateMetric<kCacheAccessEventCount>(1, cache_access_event));
+}
+
+// Forwards the values of one partition to the visitor of the whole cache.
+// The cleanup logical commit times of all partitions are visited up front.
+class PartitionCacheVisitor : public CacheVisitor {
+ public:
+  explicit PartitionCacheVisitor(CacheVisitor& visitor) : visitor_(visitor) {}
+
+  absl::Status VisitCleanupLogicalCommitTimes(
+      const absl::flat_hash_map<std::string, int64_t>&
+          prefix_cleanup_logical_commit_times) override {
+    return absl::OkStatus();
+  }
+  absl::Status VisitKeyValue(std::string_view key, std::string_view value,
+                             int64_t logical_commit_time, bool is_deleted,
+                             std::string_view prefix) override {
+    return visitor_.VisitKeyValue(key, value, logical_commit_time, is_deleted,
+                                  prefix);
+  }
+  absl::Status VisitKeyValueSet(std::string_view key,
+                                absl::Span<std::string_view> values,
+                                int64_t logical_commit_time, bool is_deleted,
+                                std::string_view prefix) override {
+    return visitor_.VisitKeyValueSet(key, values, logical_commit_time,
+                                     is_deleted, prefix);
+  }
+  absl::Status VisitUInt32ValueSet(std::string_view key,
+                                   absl::Span<uint32_t> values,
+                                   int64_t logical_commit_time,
+                                   bool is_deleted,
+                                   std::string_view prefix) override {
+    return visitor_.VisitUInt32ValueSet(key, values, logical_commit_time,
+                                        is_deleted, prefix);
+  }
+  absl::Status VisitUInt64ValueSet(std::string_view key,
+                                   absl::Span<uint64_t> values,
+                                   int64_t logical_commit_time,
+                                   bool is_deleted,
+                                   std::string_view prefix) override {
+    return visitor_.VisitUInt64ValueSet(key, values, logical_commit_time,
+                                        is_deleted, prefix);
+  }
+
+ private:
+  CacheVisitor& visitor_;
+};
+
+}  // namespace
+
+absl::flat_hash_map<std::string, std::string>
+PrefixPartitionedCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  const std::vector<const KeyValueCache*> partitions = GetPartitions(key_set);
+  if (partitions.size() == 1) {
+    return partitions.front()->GetKeyValuePairs(request_context, key_set);
+  }
+  return MergeKeyValuePairs(request_context, partitions, key_set,
+                            /*serialized_json_values=*/false);
+}
+
+absl::flat_hash_map<std::string, std::string>
+PrefixPartitionedCache::GetSerializedJsonValues(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  if (!partition_options_.parse_json_values) {
+    return Cache::GetSerializedJsonValues(request_context, key_set);
+  }
+  const std::vector<const KeyValueCache*> partitions = GetPartitions(key_set);
+  if (partitions.size() == 1) {
+    return partitions.front()->GetSerializedJsonValues(request_context,
+                                                       key_set);
+  }
+  return MergeKeyValuePairs(request_context, partitions, key_set,
+                            /*serialized_json_values=*/true);
+}
+
+absl::flat_hash_map<std::string, std::string>
+PrefixPartitionedCache::MergeKeyValuePairs(
+    const RequestContext& request_context,
+    const std::vector<const KeyValueCache*>& partitions,
+    const absl::flat_hash_set<std::string_view>& key_set,
+    bool serialized_json_values) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetValuePairsLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  struct LatestValue {
+    LatestMutation mutation;
+    std::optional<std::string> value;
+  };
+  absl::flat_hash_map<std::string_view, LatestValue> latest_values;
+  for (const KeyValueCache* partition : partitions) {
+    partition->VisitKeyValues(
+        key_set, serialized_json_values,
+        [&latest_values](std::string_view key, const std::string* value,
+                         int64_t logical_commit_time) {
+          auto [value_itr, inserted] = latest_values.try_emplace(key);
+          if (!inserted &&
+              value_itr->second.mutation.logical_commit_time >=
+                  logical_commit_time) {
+            return;
+          }
+          value_itr->second.mutation = {logical_commit_time, value == nullptr};
+          if (value == nullptr) {
+            value_itr->second.value.reset();
+          } else {
+            value_itr->second.value = *value;
+          }
+        });
+  }
+  absl::flat_hash_map<std::string, std::string> kv_pairs;
+  for (auto& [key, latest_value] : latest_values) {
+    if (latest_value.value.has_value()) {
+      kv_pairs.emplace(key, *std::move(latest_value.value));
+    }
+  }
+  LogCacheAccessMetrics(request_context, kv_pairs.empty() ? kKeyValueCacheMiss
+                                                          : kKeyValueCacheHit);
+  return kv_pairs;
+}
+
+std::unique_ptr<GetKeyValueSetResult> PrefixPartitionedCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  const std::vector<const KeyValueCache*> partitions = GetPartitions(key_set);
+  if (partitions.size() == 1) {
+    return partitions.front()->GetKeyValueSet(request_context, key_set);
+  }
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetKeyValueSetLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  absl::flat_hash_map<std::string_view,
+                      absl::flat_hash_map<std::string_view, LatestMutation>>
+      latest_mutations;
+  std::vector<std::unique_ptr<absl::ReaderMutexLock>> key_locks;
+  for (const KeyValueCache* partition : partitions) {
+    partition->VisitStringSetValues(
+        key_set, key_locks,
+        [&latest_mutations](std::string_view key, std::string_view value,
+                            int64_t logical_commit_time, bool is_deleted) {
+          auto [mutation_itr, inserted] = latest_mutations[key].try_emplace(
+              value, LatestMutation{logical_commit_time, is_deleted});
+          if (!inserted) {
+            mutation_itr->second.Update(logical_commit_time, is_deleted);
+          }
+        });
+  }
+  auto result = std::make_unique<PrefixPartitionedGetKeyValueSetResult>();
+  for (const auto& [key, value_mutations] : latest_mutations) {
+    absl::flat_hash_set<std::string_view> values;
+    for (const auto& [value, mutation] : value_mutations) {
+      if (!mutation.is_deleted) {
+        values.insert(value);
+      }
+    }
+    result->AddStringSet(key, std::move(values));
+  }
+  result->AddKeyLocks(std::move(key_locks));
+  LogCacheAccessMetrics(request_context, latest_mutations.empty()
+                                             ? kKeyValueSetCacheMiss
+                                             : kKeyValueSetCacheHit);
+  return result;
+}
+
+std::unique_ptr<GetKeyValueSetResult>
+PrefixPartitionedCache::GetUInt32ValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  const std::vector<const KeyValueCache*> partitions = GetPartitions(key_set);
+  if (partitions.size() == 1) {
+    return partitions.front()->GetUInt32ValueSet(request_context, key_set);
+  }
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetUInt32ValueSetLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  return MergeUIntValueSets(request_context, partitions, key_set,
+                            &KeyValueCache::uint32_sets_cache_);
+}
+
+std::unique_ptr<GetKeyValueSetResult>
+PrefixPartitionedCache::GetUInt64ValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  const std::vector<const KeyValueCache*> partitions = GetPartitions(key_set);
+  if (partitions.size() == 1) {
+    return partitions.front()->GetUInt64ValueSet(request_context, key_set);
+  }
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetUInt64ValueSetLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  return MergeUIntValueSets(request_context, partitions, key_set,
+                            &KeyValueCache::uint64_sets_cache_);
+}
+
+template <typename SetType>
+std::unique_ptr<GetKeyValueSetResult>
+PrefixPartitionedCache::MergeUIntValueSets(
+    const RequestContext& request_context,
+    const std::vector<const KeyValueCache*>& partitions,
+    const absl::flat_hash_set<std::string_view>& key_set,
+    UIntValueSetCache<SetType> KeyValueCache::*sets_cache) const {
+  auto result = std::make_unique<PrefixPartitionedGetKeyValueSetResult>();
+  absl::flat_hash_map<std::string_view, std::vector<const SetType*>>
+      key_value_sets;
+  absl::flat_hash_set<std::string_view> partition_keys;
+  for (const KeyValueCache* partition : partitions) {
+    // Sets caches do not filter keys, so only look up the keys that the
+    // partition may have.
+    const std::vector<std::string_view> keys =
+        partition->GetKeysToLookUp(key_set);
+    partition_keys.clear();
+    partition_keys.insert(keys.begin(), keys.end());
+    if (partition_keys.empty()) {
+      continue;
+    }
+    auto partition_result =
+        (partition->*sets_cache).GetValueSet(request_context, partition_keys);
+    for (std::string_view key : partition_keys) {
+      if (const SetType* value_set =
+              GetUIntSet<SetType>(*partition_result, key);
+          value_set != nullptr) {
+        key_value_sets[key].push_back(value_set);
+      }
+    }
+    result->AddPartitionResult(std::move(partition_result));
+  }
+  for (const auto& [key, value_sets] : key_value_sets) {
+    if (value_sets.size() == 1) {
+      result->AddUIntSet(key, value_sets.front());
+    } else {
+      result->AddMergedUIntSet(key, MergeUIntSets(value_sets));
+    }
+  }
+  for (std::string_view key : key_set) {
+    LogCacheAccessMetrics(request_context, key_value_sets.contains(key)
+                                               ? kKeyValueSetCacheHit
+                                               : kKeyValueSetCacheMiss);
+  }
+  return result;
+}
+
+bool PrefixPartitionedCache::MayContainKey(std::string_view key) const {
+  absl::ReaderMutexLock lock(&mutex_);
+  for (const auto& [prefix, partition] : partitions_) {
+    if (partition->MayContainKey(key)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PrefixPartitionedCache::UpdateKeyValue(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, std::string_view value, int64_t logical_commit_time,
+    std::string_view prefix) {
+  GetOrCreatePartition(prefix).UpdateKeyValue(log_context, key, value,
+                                              logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::UpdateKeyValueSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).UpdateKeyValueSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::UpdateKeyValueSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, absl::Span<uint32_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).UpdateKeyValueSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::UpdateKeyValueSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, absl::Span<uint64_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).UpdateKeyValueSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::DeleteKey(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, int64_t logical_commit_time,
+    std::string_view prefix) {
+  GetOrCreatePartition(prefix).DeleteKey(log_context, key, logical_commit_time,
+                                         prefix);
+}
+
+void PrefixPartitionedCache::DeleteValuesInSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).DeleteValuesInSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::DeleteValuesInSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, absl::Span<uint32_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).DeleteValuesInSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::DeleteValuesInSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, absl::Span<uint64_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).DeleteValuesInSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::RemoveDeletedKeys(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    int64_t logical_commit_time, std::string_view prefix) {
+  // The partition is created even if the prefix has no values yet, so that it
+  // ignores mutations older than the cleanup like `KeyValueCache` does.
+  KeyValueCache& partition = GetOrCreatePartition(prefix);
+  std::vector<std::pair<std::string, KeyValueCache*>> other_partitions;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto& max_cleanup_logical_commit_time =
+        max_cleanup_logical_commit_times_[prefix];
+    max_cleanup_logical_commit_time =
+        std::max(max_cleanup_logical_commit_time, logical_commit_time);
+    for (const auto& [other_prefix, other_partition] : partitions_) {
+      if (other_partition.get() != &partition) {
+        other_partitions.emplace_back(other_prefix, other_partition.get());
+      }
+    }
+  }
+  if (!other_partitions.empty()) {
+    // Older values of other partitions are erased before the deletions that
+    // hide them, so lookups never see them again.
+    const KeyValueCache::Deletions deletions =
+        partition.GetDeletionsToRemove(logical_commit_time, prefix);
+    for (const auto& [other_prefix, other_partition] : other_partitions) {
+      other_partition->EraseValuesOlderThan(deletions, other_prefix);
+      other_partition->MaybeRebuildKeyFilter();
+    }
+  }
+  partition.RemoveDeletedKeys(log_context, logical_commit_time, prefix);
+}
+
+absl::Status PrefixPartitionedCache::Export(CacheVisitor& visitor) {
+  absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_times;
+  std::vector<KeyValueCache*> partitions;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    max_cleanup_logical_commit_times = max_cleanup_logical_commit_times_;
+    for (auto& [prefix, partition] : partitions_) {
+      partitions.push_back(partition.get());
+    }
+  }
+  PS_RETURN_IF_ERROR(
+      visitor.VisitCleanupLogicalCommitTimes(max_cleanup_logical_commit_times));
+  PartitionCacheVisitor partition_visitor(visitor);
+  for (KeyValueCache* partition : partitions) {
+    PS_RETURN_IF_ERROR(partition->Export(partition_visitor));
+  }
+  return absl::OkStatus();
+}
+
+void PrefixPartitionedCache::ApplyKeyValueMutations(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    absl::Span<const KeyValueMutation> mutations, std::string_view prefix) {
+  GetOrCreatePartition(prefix).ApplyKeyValueMutations(log_context, mutations,
+                                                      prefix);
+}
+
+void PrefixPartitionedCache::UpdateKeyValueSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const FlatbufferStringVector& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).UpdateKeyValueSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::UpdateKeyValueSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const flatbuffers::Vector<uint32_t>& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).UpdateKeyValueSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::UpdateKeyValueSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const flatbuffers::Vector<uint64_t>& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).UpdateKeyValueSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::DeleteValuesInSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const FlatbufferStringVector& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).DeleteValuesInSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::DeleteValuesInSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const flatbuffers::Vector<uint32_t>& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).DeleteValuesInSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixPartitionedCache::DeleteValuesInSet(
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view key, const flatbuffers::Vector<uint64_t>& value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  GetOrCreatePartition(prefix).DeleteValuesInSet(
+      log_context, key, value_set, logical_commit_time, prefix);
+}
+
+std::vector<std::string> PrefixPartitionedCache::GetPrefixes() const {
+  absl::ReaderMutexLock lock(&mutex_);
+  std::vector<std::string> prefixes;
+  prefixes.reserve(partitions_.size());
+  for (const auto& [prefix, partition] : partitions_) {
+    prefixes.push_back(prefix);
+  }
+  return prefixes;
+}
+
+KeyValueCache& PrefixPartitionedCache::GetOrCreatePartition(
+    std::string_view prefix) {
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    if (auto partition_itr = partitions_.find(prefix);
+        partition_itr != partitions_.end()) {
+      return *partition_itr->second;
+    }
+  }
+  absl::MutexLock lock(&mutex_);
+  auto& partition = partitions_[prefix];
+  if (partition == nullptr) {
+    partition = std::make_unique<KeyValueCache>(partition_options_);
+  }
+  return *partition;
+}
+
+std::vector<const KeyValueCache*> PrefixPartitionedCache::GetPartitions()
+    const {
+  absl::ReaderMutexLock lock(&mutex_);
+  std::vector<const KeyValueCache*> partitions;
+  partitions.reserve(partitions_.size());
+  for (const auto& [prefix, partition] : partitions_) {
+    partitions.push_back(partition.get());
+  }
+  return partitions;
+}
+
+std::vector<const KeyValueCache*> PrefixPartitionedCache::GetPartitions(
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  std::vector<const KeyValueCache*> partitions = GetPartitions();
+  if (partition_options_.enable_key_filter) {
+    partitions.erase(std::remove_if(partitions.begin(), partitions.end(),
+                                    [&key_set](const KeyValueCache* partition) {
+                                      return partition->KeyFilterHasNone(
+                                          key_set);
+                                    }),
+                     partitions.end());
+  }
+  return partitions;
+}
+
+std::unique_ptr<Cache> PrefixPartitionedCache::Create(
+    KeyValueCacheOptions partition_options) {
+  return absl::WrapUnique(new PrefixPartitionedCache(partition_options));
+}
+
+}  // namespace kv_server
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_PREFIX_PARTITIONED_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_PREFIX_PARTITIONED_CACHE_H_
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/get_key_value_set_result.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/cache/uint_value_set_cache.h"
+
+namespace kv_server {
+
+// In-memory datastore that keeps the keys of each blob prefix in a separate
+// partition, i.e., a separate `KeyValueCache` with its own locks and deleted
+// key bookkeeping. Mutations and cleanups of one prefix only lock the
+// partition of that prefix, so prefixes can be loaded concurrently.
+//
+// Lookups return what a single `KeyValueCache` that all mutations were applied
+// to would return: each key, and each set value, resolves to its mutation
+// with the latest logical commit time across the partitions, and is absent if
+// that mutation is a deletion. Mutations with the same logical commit time in
+// different partitions resolve to the prefix that sorts first. Lookups of
+// keys that only one partition has return that partition's values without
+// copying them.
+//
+// Lookups consult every partition that may have the looked up keys. With
+// `enable_key_filter`, a lookup skips the partitions whose filter has none of
+// its keys, so loading a prefix does not block lookups of keys from other
+// prefixes.
+//
+// `RemoveDeletedKeys` also erases the values of other partitions that are
+// older than the deletions it removes, as if the deletions had overwritten
+// them in a single cache.
+//
+// One cache object is only for keys in one namespace.
+class PrefixPartitionedCache : public Cache {
+ public:
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  std::unique_ptr<GetKeyValueSetResult> GetUInt32ValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  std::unique_ptr<GetKeyValueSetResult> GetUInt64ValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  absl::flat_hash_map<std::string, std::string> GetSerializedJsonValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Returns true if any partition may contain `key`.
+  bool MayContainKey(std::string_view key) const override;
+
+  void UpdateKeyValue(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, std::string_view value, int64_t logical_commit_time,
+      std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<std::string_view> value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<uint32_t> value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<uint64_t> value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void DeleteKey(privacy_sandbox::server_common::log::PSLogContext& log_context,
+                 std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<std::string_view> value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<uint32_t> value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<uint64_t> value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  // Cleans up the partition of `prefix`, after erasing the values of the other
+  // partitions that are older than the removed deletions.
+  void RemoveDeletedKeys(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  // Visits the partitions in turn, in the order of their prefixes.
+  absl::Status Export(CacheVisitor& visitor) override;
+
+  void ApplyKeyValueMutations(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      absl::Span<const KeyValueMutation> mutations,
+      std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const FlatbufferStringVector& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint32_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint64_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const FlatbufferStringVector& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint32_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, const flatbuffers::Vector<uint64_t>& value_set,
+      int64_t logical_commit_time, std::string_view prefix = "") override;
+
+  // Returns the prefixes that have a partition, in sorted order.
+  std::vector<std::string> GetPrefixes() const;
+
+  // `partition_options` are used to create the partition of each prefix.
+  static std::unique_ptr<Cache> Create(
+      KeyValueCacheOptions partition_options = {});
+
+ private:
+  explicit PrefixPartitionedCache(KeyValueCacheOptions partition_options)
+      : partition_options_(partition_options) {}
+
+  // Returns the partition of `prefix`, creating it if needed. Partitions are
+  // never removed, so the returned reference stays valid.
+  KeyValueCache& GetOrCreatePartition(std::string_view prefix);
+
+  // Returns the partitions in the order of their prefixes.
+  std::vector<const KeyValueCache*> GetPartitions() const;
+
+  // Returns the partitions, in the order of their prefixes, that may have any
+  // of `key_set`, see `KeyValueCacheOptions::enable_key_filter`.
+  std::vector<const KeyValueCache*> GetPartitions(
+      const absl::flat_hash_set<std::string_view>& key_set) const;
+
+  // Resolves the values of `key_set` across `partitions`.
+  absl::flat_hash_map<std::string, std::string> MergeKeyValuePairs(
+      const RequestContext& request_context,
+      const std::vector<const KeyValueCache*>& partitions,
+      const absl::flat_hash_set<std::string_view>& key_set,
+      bool serialized_json_values) const;
+
+  // Resolves the uint sets of `key_set` across `partitions`, from the sets
+  // cache `sets_cache` of each partition.
+  template <typename SetType>
+  std::unique_ptr<GetKeyValueSetResult> MergeUIntValueSets(
+      const RequestContext& request_context,
+      const std::vector<const KeyValueCache*>& partitions,
+      const absl::flat_hash_set<std::string_view>& key_set,
+      UIntValueSetCache<SetType> KeyValueCache::*sets_cache) const;
+
+  const KeyValueCacheOptions partition_options_;
+  // Only guards the partition map. Reads and writes of a partition are
+  // synchronized by the partition itself.
+  mutable absl::Mutex mutex_;
+  absl::btree_map<std::string, std::unique_ptr<KeyValueCache>> partitions_
+      ABSL_GUARDED_BY(mutex_);
+  // The maximum logical commit time passed to `RemoveDeletedKeys` for each
+  // prefix, see `CacheVisitor::VisitCleanupLogicalCommitTimes`.
+  absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_times_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_PREFIX_PARTITIONED_CACHE_H_
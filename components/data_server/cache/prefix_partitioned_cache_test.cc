@@ -0,0 +1,429 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/prefix_partitioned_cache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "components/data_server/cache/json_value.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::Pair;
+using testing::UnorderedElementsAre;
+
+class SafePathTestLogContext
+    : public privacy_sandbox::server_common::log::SafePathContext {
+ public:
+  SafePathTestLogContext() = default;
+};
+
+// Records the visited string values of a cache export.
+class StringValueVisitor : public CacheVisitor {
+ public:
+  absl::Status VisitCleanupLogicalCommitTimes(
+      const absl::flat_hash_map<std::string, int64_t>&
+          prefix_cleanup_logical_commit_times) override {
+    cleanup_logical_commit_times = prefix_cleanup_logical_commit_times;
+    return absl::OkStatus();
+  }
+  absl::Status VisitKeyValue(std::string_view key, std::string_view value,
+                             int64_t logical_commit_time, bool is_deleted,
+                             std::string_view prefix) override {
+    values.emplace(key, absl::StrCat(prefix, ":", value));
+    return absl::OkStatus();
+  }
+  absl::Status VisitKeyValueSet(std::string_view key,
+                                absl::Span<std::string_view> values,
+                                int64_t logical_commit_time, bool is_deleted,
+                                std::string_view prefix) override {
+    return absl::OkStatus();
+  }
+  absl::Status VisitUInt32ValueSet(std::string_view key,
+                                   absl::Span<uint32_t> values,
+                                   int64_t logical_commit_time,
+                                   bool is_deleted,
+                                   std::string_view prefix) override {
+    return absl::OkStatus();
+  }
+  absl::Status VisitUInt64ValueSet(std::string_view key,
+                                   absl::Span<uint64_t> values,
+                                   int64_t logical_commit_time,
+                                   bool is_deleted,
+                                   std::string_view prefix) override {
+    return absl::OkStatus();
+  }
+
+  absl::flat_hash_map<std::string, int64_t> cleanup_logical_commit_times;
+  absl::flat_hash_map<std::string, std::string> values;
+};
+
+class PrefixPartitionedCacheTest : public ::testing::Test {
+ protected:
+  PrefixPartitionedCacheTest() {
+    InitMetricsContextMap();
+    request_context_ = std::make_shared<RequestContext>();
+  }
+  const RequestContext& GetRequestContext() { return *request_context_; }
+  std::shared_ptr<RequestContext> request_context_;
+  SafePathTestLogContext safe_path_log_context_;
+};
+
+TEST_F(PrefixPartitionedCacheTest, ResolvesKeysAcrossPrefixes) {
+  auto cache = PrefixPartitionedCache::Create();
+  cache->UpdateKeyValue(safe_path_log_context_, "root_key", "root_value", 1);
+  cache->UpdateKeyValue(safe_path_log_context_, "prefix_key", "prefix_value", 1,
+                        "prefix");
+  auto kv_pairs = cache->GetKeyValuePairs(
+      GetRequestContext(), {"root_key", "prefix_key", "missing_key"});
+  EXPECT_THAT(kv_pairs,
+              UnorderedElementsAre(Pair("root_key", "root_value"),
+                                   Pair("prefix_key", "prefix_value")));
+}
+
+TEST_F(PrefixPartitionedCacheTest, CreatesOnePartitionPerPrefix) {
+  auto cache = PrefixPartitionedCache::Create();
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "value", 1, "b");
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "value", 1, "a");
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "value", 1);
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "value", 2, "a");
+  EXPECT_THAT(static_cast<PrefixPartitionedCache&>(*cache).GetPrefixes(),
+              ElementsAre("", "a", "b"));
+}
+
+TEST_F(PrefixPartitionedCacheTest, LatestMutationWinsAcrossPrefixes) {
+  auto cache = PrefixPartitionedCache::Create();
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "b_value", 3, "b");
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "a_value", 2, "a");
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key"}),
+              UnorderedElementsAre(Pair("key", "b_value")));
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "root_value", 1);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key"}),
+              UnorderedElementsAre(Pair("key", "b_value")));
+  // A deletion in one partition hides the older values of the others.
+  cache->DeleteKey(safe_path_log_context_, "key", 4);
+  EXPECT_TRUE(cache->GetKeyValuePairs(GetRequestContext(), {"key"}).empty());
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "a_value", 5, "a");
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key"}),
+              UnorderedElementsAre(Pair("key", "a_value")));
+}
+
+TEST_F(PrefixPartitionedCacheTest, TiesResolveToFirstPrefix) {
+  auto cache = PrefixPartitionedCache::Create();
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "b_value", 1, "b");
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "a_value", 1, "a");
+  std::vector<std::string_view> values = {"v1"};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set",
+                           absl::MakeSpan(values), 1, "a");
+  cache->DeleteValuesInSet(safe_path_log_context_, "set",
+                           absl::MakeSpan(values), 1, "b");
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key"}),
+              UnorderedElementsAre(Pair("key", "a_value")));
+  EXPECT_THAT(
+      cache->GetKeyValueSet(GetRequestContext(), {"set"})->GetValueSet("set"),
+      UnorderedElementsAre("v1"));
+}
+
+TEST_F(PrefixPartitionedCacheTest, ResolvesSerializedJsonValuesByLatestTime) {
+  auto cache = PrefixPartitionedCache::Create({.parse_json_values = true});
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "[2]", 2, "a");
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "[1]", 1);
+  cache->UpdateKeyValue(safe_path_log_context_, "a_key", "3", 1, "a");
+  EXPECT_THAT(cache->GetSerializedJsonValues(GetRequestContext(),
+                                             {"key", "a_key", "missing_key"}),
+              UnorderedElementsAre(Pair("key", SerializeAsJsonValue("[2]")),
+                                   Pair("a_key", SerializeAsJsonValue("3"))));
+}
+
+TEST_F(PrefixPartitionedCacheTest, MergesSetValuesAcrossPrefixes) {
+  auto cache = PrefixPartitionedCache::Create();
+  std::vector<std::string_view> root_values = {"v1", "v2"};
+  std::vector<std::string_view> prefix_values = {"v3"};
+  std::vector<std::string_view> deleted_values = {"v1"};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "both",
+                           absl::MakeSpan(root_values), 1);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "both",
+                           absl::MakeSpan(prefix_values), 1, "prefix");
+  cache->DeleteValuesInSet(safe_path_log_context_, "both",
+                           absl::MakeSpan(deleted_values), 2, "prefix");
+  cache->UpdateKeyValueSet(safe_path_log_context_, "prefix_only",
+                           absl::MakeSpan(prefix_values), 1, "prefix");
+  std::vector<uint32_t> root_uint32_values = {1, 2};
+  std::vector<uint32_t> prefix_uint32_values = {3};
+  std::vector<uint32_t> deleted_uint32_values = {1};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "uint32_set",
+                           absl::MakeSpan(root_uint32_values), 1);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "uint32_set",
+                           absl::MakeSpan(prefix_uint32_values), 1, "prefix");
+  cache->DeleteValuesInSet(safe_path_log_context_, "uint32_set",
+                           absl::MakeSpan(deleted_uint32_values), 2, "prefix");
+  std::vector<uint64_t> uint64_values = {1ull << 40};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "uint64_set",
+                           absl::MakeSpan(uint64_values), 1, "prefix");
+
+  auto result = cache->GetKeyValueSet(GetRequestContext(),
+                                      {"both", "prefix_only", "missing"});
+  EXPECT_THAT(result->GetValueSet("both"), UnorderedElementsAre("v2", "v3"));
+  EXPECT_THAT(result->GetValueSet("prefix_only"), UnorderedElementsAre("v3"));
+  EXPECT_TRUE(result->GetValueSet("missing").empty());
+
+  auto uint32_result = cache->GetUInt32ValueSet(GetRequestContext(),
+                                                {"uint32_set", "uint64_set"});
+  ASSERT_NE(uint32_result->GetUInt32ValueSet("uint32_set"), nullptr);
+  EXPECT_THAT(uint32_result->GetUInt32ValueSet("uint32_set")->GetValues(),
+              UnorderedElementsAre(2, 3));
+  EXPECT_EQ(uint32_result->GetUInt32ValueSet("uint32_set")
+                ->GetValuesBitSet()
+                .cardinality(),
+            2);
+  EXPECT_EQ(uint32_result->GetUInt32ValueSet("uint64_set"), nullptr);
+  auto uint64_result =
+      cache->GetUInt64ValueSet(GetRequestContext(), {"uint64_set"});
+  ASSERT_NE(uint64_result->GetUInt64ValueSet("uint64_set"), nullptr);
+  EXPECT_THAT(uint64_result->GetUInt64ValueSet("uint64_set")->GetValues(),
+              UnorderedElementsAre(1ull << 40));
+}
+
+TEST_F(PrefixPartitionedCacheTest, CleanupOnlyAffectsItsPrefix) {
+  auto cache = PrefixPartitionedCache::Create();
+  cache->DeleteKey(safe_path_log_context_, "key", 2, "a");
+  cache->DeleteKey(safe_path_log_context_, "key", 2, "b");
+  cache->RemoveDeletedKeys(safe_path_log_context_, 3, "a");
+  // Prefix "a" now ignores mutations up to the cleanup time, prefix "b" does
+  // not, but still has its own deletion.
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "a_value", 3, "a");
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "b_value", 1, "b");
+  EXPECT_TRUE(cache->GetKeyValuePairs(GetRequestContext(), {"key"}).empty());
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "b_value", 3, "b");
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key"}),
+              UnorderedElementsAre(Pair("key", "b_value")));
+}
+
+TEST_F(PrefixPartitionedCacheTest, CleanupDoesNotResurfaceOlderValues) {
+  auto cache = PrefixPartitionedCache::Create();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  std::vector<std::string_view> deleted_values = {"v1"};
+  std::vector<uint32_t> uint32_values = {1, 2};
+  std::vector<uint32_t> deleted_uint32_values = {1};
+  std::vector<uint64_t> uint64_values = {1};
+  cache->UpdateKeyValue(safe_path_log_context_, "key", "root_value", 1);
+  cache->UpdateKeyValue(safe_path_log_context_, "newer_key", "root_value", 3);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "set",
+                           absl::MakeSpan(values), 1);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "uint32_set",
+                           absl::MakeSpan(uint32_values), 1);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "uint64_set",
+                           absl::MakeSpan(uint64_values), 1);
+  cache->DeleteKey(safe_path_log_context_, "key", 2, "a");
+  cache->DeleteKey(safe_path_log_context_, "newer_key", 2, "a");
+  cache->DeleteValuesInSet(safe_path_log_context_, "set",
+                           absl::MakeSpan(deleted_values), 2, "a");
+  cache->DeleteValuesInSet(safe_path_log_context_, "uint32_set",
+                           absl::MakeSpan(deleted_uint32_values), 2, "a");
+  cache->DeleteValuesInSet(safe_path_log_context_, "uint64_set",
+                           absl::MakeSpan(uint64_values), 2, "a");
+  cache->RemoveDeletedKeys(safe_path_log_context_, 2, "a");
+
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"key", "newer_key"}),
+      UnorderedElementsAre(Pair("newer_key", "root_value")));
+  EXPECT_THAT(
+      cache->GetKeyValueSet(GetRequestContext(), {"set"})->GetValueSet("set"),
+      UnorderedElementsAre("v2"));
+  auto uint32_result =
+      cache->GetUInt32ValueSet(GetRequestContext(), {"uint32_set"});
+  ASSERT_NE(uint32_result->GetUInt32ValueSet("uint32_set"), nullptr);
+  EXPECT_THAT(uint32_result->GetUInt32ValueSet("uint32_set")->GetValues(),
+              UnorderedElementsAre(2));
+  auto uint64_result =
+      cache->GetUInt64ValueSet(GetRequestContext(), {"uint64_set"});
+  ASSERT_NE(uint64_result->GetUInt64ValueSet("uint64_set"), nullptr);
+  EXPECT_TRUE(
+      uint64_result->GetUInt64ValueSet("uint64_set")->GetValues().empty());
+
+  // The erased values are no longer exported either.
+  StringValueVisitor visitor;
+  ASSERT_TRUE(cache->Export(visitor).ok());
+  EXPECT_THAT(visitor.values,
+              UnorderedElementsAre(Pair("newer_key", ":root_value")));
+}
+
+TEST_F(PrefixPartitionedCacheTest, ExportVisitsAllPartitions) {
+  auto cache = PrefixPartitionedCache::Create();
+  cache->UpdateKeyValue(safe_path_log_context_, "root_key", "root_value", 1);
+  cache->UpdateKeyValue(safe_path_log_context_, "prefix_key", "prefix_value", 1,
+                        "prefix");
+  cache->RemoveDeletedKeys(safe_path_log_context_, 1, "other_prefix");
+  StringValueVisitor visitor;
+  ASSERT_TRUE(cache->Export(visitor).ok());
+  EXPECT_THAT(visitor.cleanup_logical_commit_times,
+              UnorderedElementsAre(Pair("other_prefix", 1)));
+  EXPECT_THAT(visitor.values,
+              UnorderedElementsAre(Pair("root_key", ":root_value"),
+                                   Pair("prefix_key", "prefix:prefix_value")));
+}
+
+TEST_F(PrefixPartitionedCacheTest, BlockedPrefixDoesNotBlockOtherLookups) {
+  auto cache = PrefixPartitionedCache::Create({.enable_key_filter = true});
+  std::vector<std::string_view> values = {"v1"};
+  cache->UpdateKeyValueSet(safe_path_log_context_, "root_key",
+                           absl::MakeSpan(values), 1);
+  cache->UpdateKeyValueSet(safe_path_log_context_, "prefix_key",
+                           absl::MakeSpan(values), 1, "prefix");
+  // Holds the lock of the set of "prefix_key" until the result goes out of
+  // scope, so that updating it blocks the partition of "prefix".
+  auto prefix_result =
+      cache->GetKeyValueSet(GetRequestContext(), {"prefix_key"});
+  std::thread loader([&cache, this] {
+    std::vector<std::string_view> new_values = {"v2"};
+    cache->UpdateKeyValueSet(safe_path_log_context_, "prefix_key",
+                             absl::MakeSpan(new_values), 2, "prefix");
+  });
+  absl::Notification lookup_done;
+  std::thread reader([&cache, &lookup_done, this] {
+    auto result = cache->GetKeyValueSet(GetRequestContext(), {"root_key"});
+    EXPECT_THAT(result->GetValueSet("root_key"), UnorderedElementsAre("v1"));
+    lookup_done.Notify();
+  });
+  EXPECT_TRUE(lookup_done.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  prefix_result.reset();
+  loader.join();
+  reader.join();
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"prefix_key"})
+                  ->GetValueSet("prefix_key"),
+              UnorderedElementsAre("v1", "v2"));
+}
+
+TEST_F(PrefixPartitionedCacheTest, ConcurrentLoadsAndLookupsOfPrefixes) {
+  constexpr int kNumPrefixes = 4;
+  constexpr int kNumKeys = 1000;
+  auto cache = PrefixPartitionedCache::Create({.enable_key_filter = true});
+  for (int i = 0; i < kNumKeys; ++i) {
+    cache->UpdateKeyValue(safe_path_log_context_, absl::StrCat("root_key", i),
+                          "root_value", 1);
+  }
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kNumPrefixes; ++p) {
+    threads.emplace_back([&cache, p, this] {
+      const std::string prefix = absl::StrCat("prefix", p);
+      for (int i = 0; i < kNumKeys; ++i) {
+        cache->UpdateKeyValue(safe_path_log_context_, absl::StrCat(prefix, i),
+                              prefix, 1, prefix);
+      }
+      cache->RemoveDeletedKeys(safe_path_log_context_, 1, prefix);
+    });
+    threads.emplace_back([&cache, this] {
+      for (int i = 0; i < kNumKeys; ++i) {
+        const std::string key = absl::StrCat("root_key", i);
+        EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {key}),
+                    UnorderedElementsAre(Pair(key, "root_value")));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int p = 0; p < kNumPrefixes; ++p) {
+    const std::string prefix = absl::StrCat("prefix", p);
+    for (int i = 0; i < kNumKeys; ++i) {
+      const std::string key = absl::StrCat(prefix, i);
+      EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {key}),
+                  UnorderedElementsAre(Pair(key, prefix)));
+    }
+  }
+}
+
+TEST_F(PrefixPartitionedCacheTest, ConcurrentMutationsOfSharedKeys) {
+  constexpr int kNumPrefixes = 4;
+  constexpr int kNumKeys = 1000;
+  auto cache = PrefixPartitionedCache::Create();
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kNumPrefixes; ++p) {
+    // Every prefix updates every key, later prefixes with later times.
+    threads.emplace_back([&cache, p, this] {
+      const std::string prefix = absl::StrCat("prefix", p);
+      for (int i = 0; i < kNumKeys; ++i) {
+        const std::string key = absl::StrCat("key", i);
+        cache->UpdateKeyValue(safe_path_log_context_, key, prefix, p + 1,
+                              prefix);
+        std::vector<uint32_t> values = {static_cast<uint32_t>(p)};
+        cache->UpdateKeyValueSet(safe_path_log_context_, key,
+                                 absl::MakeSpan(values), p + 1, prefix);
+      }
+    });
+    threads.emplace_back([&cache, this] {
+      for (int i = 0; i < kNumKeys; ++i) {
+        const std::string key = absl::StrCat("key", i);
+        cache->GetKeyValuePairs(GetRequestContext(), {key});
+        cache->GetUInt32ValueSet(GetRequestContext(), {key});
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const std::string last_prefix = absl::StrCat("prefix", kNumPrefixes - 1);
+  for (int i = 0; i < kNumKeys; ++i) {
+    const std::string key = absl::StrCat("key", i);
+    EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {key}),
+                UnorderedElementsAre(Pair(key, last_prefix)));
+    auto result = cache->GetUInt32ValueSet(GetRequestContext(), {key});
+    ASSERT_NE(result->GetUInt32ValueSet(key), nullptr);
+    EXPECT_EQ(result->GetUInt32ValueSet(key)->GetValues().size(),
+              kNumPrefixes);
+  }
+
+  // Deletes every key in a new prefix and cleans it up while looking up the
+  // keys, which must never reappear.
+  for (int i = 0; i < kNumKeys; ++i) {
+    cache->DeleteKey(safe_path_log_context_, absl::StrCat("key", i),
+                     kNumPrefixes + 1, "deletes");
+  }
+  threads.clear();
+  threads.emplace_back([&cache, this] {
+    cache->RemoveDeletedKeys(safe_path_log_context_, kNumPrefixes + 1,
+                             "deletes");
+  });
+  for (int r = 0; r < 2; ++r) {
+    threads.emplace_back([&cache, this] {
+      for (int i = 0; i < kNumKeys; ++i) {
+        EXPECT_TRUE(cache
+                        ->GetKeyValuePairs(GetRequestContext(),
+                                           {absl::StrCat("key", i)})
+                        .empty());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  StringValueVisitor visitor;
+  ASSERT_TRUE(cache->Export(visitor).ok());
+  EXPECT_TRUE(visitor.values.empty());
+}
+
+}  // namespace
+}  // namespace kv_server
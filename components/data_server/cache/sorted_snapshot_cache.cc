@@ -0,0 +1,232 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/sorted_snapshot_cache.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "public/data_loading/data_loading_generated.h"
+#include "public/data_loading/record_utils.h"
+#include "src/util/status_macro/status_macros.h"
+
+namespace kv_server {
+namespace {
+
+// Holds the values of looked up sets. String values point into the mapped
+// snapshot file, so results must not outlive the cache.
+class SortedSnapshotGetKeyValueSetResult : public GetKeyValueSetResult {
+ public:
+  absl::flat_hash_set<std::string_view> GetValueSet(
+      std::string_view key) const override {
+    if (auto key_itr = string_sets_.find(key); key_itr != string_sets_.end()) {
+      return key_itr->second;
+    }
+    return {};
+  }
+  const UInt32ValueSet* GetUInt32ValueSet(
+      std::string_view key) const override {
+    auto key_itr = uint32_sets_.find(key);
+    return key_itr == uint32_sets_.end() ? nullptr : &key_itr->second;
+  }
+  const UInt64ValueSet* GetUInt64ValueSet(
+      std::string_view key) const override {
+    auto key_itr = uint64_sets_.find(key);
+    return key_itr == uint64_sets_.end() ? nullptr : &key_itr->second;
+  }
+
+  void AddStringValues(std::string_view key,
+                       const FlatbufferStringVector& values) {
+    auto& value_set = string_sets_[key];
+    value_set.reserve(values.size());
+    for (const auto* value : values) {
+      value_set.insert(value->string_view());
+    }
+  }
+  template <typename SetType>
+  void AddUIntValues(
+      std::string_view key,
+      const flatbuffers::Vector<typename SetType::value_type>& values,
+      int64_t logical_commit_time) {
+    GetUIntSets<SetType>()[key].Add(
+        absl::MakeConstSpan(values.data(), values.size()),
+        logical_commit_time);
+  }
+
+ private:
+  template <typename SetType>
+  absl::flat_hash_map<std::string, SetType>& GetUIntSets() {
+    if constexpr (std::is_same_v<SetType, UInt32ValueSet>) {
+      return uint32_sets_;
+    } else {
+      return uint64_sets_;
+    }
+  }
+
+  // Values are added by `SortedSnapshotCache` directly.
+  void AddKeyValueSet(
+      std::string_view key, absl::flat_hash_set<std::string_view> value_set,
+      std::unique_ptr<absl::ReaderMutexLock> key_lock) override {}
+  void AddUIntValueSet(
+      std::string_view key,
+      ThreadSafeHashMap<std::string, UInt32ValueSet>::ConstLockedNodePtr
+          value_set_node) override {}
+  void AddUIntValueSet(
+      std::string_view key,
+      ThreadSafeHashMap<std::string, UInt64ValueSet>::ConstLockedNodePtr
+          value_set_node) override {}
+
+  absl::flat_hash_map<std::string, absl::flat_hash_set<std::string_view>>
+      string_sets_;
+  absl::flat_hash_map<std::string, UInt32ValueSet> uint32_sets_;
+  absl::flat_hash_map<std::string, UInt64ValueSet> uint64_sets_;
+};
+
+// Calls `record_callback` with the record of `key` if the snapshot has an
+// update of `key` with a value of `value_type`. Returns false otherwise.
+bool FindUpdate(
+    const SortedSnapshotReader& reader, std::string_view key,
+    Value value_type,
+    const std::function<void(const KeyValueMutationRecord&)>& record_callback) {
+  std::string_view record_bytes = reader.FindRecord(key);
+  if (record_bytes.empty()) {
+    return false;
+  }
+  bool found = false;
+  auto status = DeserializeRecord(
+      record_bytes, [value_type, &found,
+                     &record_callback](const KeyValueMutationRecord& record) {
+        if (record.mutation_type() == KeyValueMutationType::Update &&
+            record.value_type() == value_type) {
+          record_callback(record);
+          found = true;
+        }
+        return absl::OkStatus();
+      });
+  if (!status.ok()) {
+    LOG_FIRST_N(ERROR, 3) << "Failed to deserialize the snapshot record of "
+                          << key << ": " << status;
+  }
+  return found;
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<Cache>> SortedSnapshotCache::Create(
+    const std::string& snapshot_path) {
+  PS_ASSIGN_OR_RETURN(auto reader, SortedSnapshotReader::Open(snapshot_path));
+  return absl::WrapUnique(new SortedSnapshotCache(std::move(reader)));
+}
+
+absl::flat_hash_map<std::string, std::string>
+SortedSnapshotCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetValuePairsLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  absl::flat_hash_map<std::string, std::string> kv_pairs;
+  for (std::string_view key : key_set) {
+    FindUpdate(*reader_, key, Value::StringValue,
+               [key, &kv_pairs](const KeyValueMutationRecord& record) {
+                 kv_pairs.insert_or_assign(
+                     key,
+                     record.value_as_StringValue()->value()->string_view());
+               });
+  }
+  LogCacheAccessMetrics(request_context, kv_pairs.empty() ? kKeyValueCacheMiss
+                                                          : kKeyValueCacheHit);
+  return kv_pairs;
+}
+
+std::unique_ptr<GetKeyValueSetResult> SortedSnapshotCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetKeyValueSetLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  auto result = std::make_unique<SortedSnapshotGetKeyValueSetResult>();
+  bool cache_hit = false;
+  for (std::string_view key : key_set) {
+    cache_hit |= FindUpdate(
+        *reader_, key, Value::StringSet,
+        [key, &result](const KeyValueMutationRecord& record) {
+          result->AddStringValues(key, *record.value_as_StringSet()->value());
+        });
+  }
+  LogCacheAccessMetrics(request_context, cache_hit ? kKeyValueSetCacheHit
+                                                   : kKeyValueSetCacheMiss);
+  return result;
+}
+
+template <typename SetType>
+std::unique_ptr<GetKeyValueSetResult> SortedSnapshotCache::GetUIntValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  auto result = std::make_unique<SortedSnapshotGetKeyValueSetResult>();
+  constexpr bool kIsUInt32 = std::is_same_v<SetType, UInt32ValueSet>;
+  for (std::string_view key : key_set) {
+    const bool cache_hit = FindUpdate(
+        *reader_, key, kIsUInt32 ? Value::UInt32Set : Value::UInt64Set,
+        [key, &result](const KeyValueMutationRecord& record) {
+          if constexpr (kIsUInt32) {
+            result->AddUIntValues<SetType>(
+                key, *record.value_as_UInt32Set()->value(),
+                record.logical_commit_time());
+          } else {
+            result->AddUIntValues<SetType>(
+                key, *record.value_as_UInt64Set()->value(),
+                record.logical_commit_time());
+          }
+        });
+    LogCacheAccessMetrics(request_context, cache_hit ? kKeyValueSetCacheHit
+                                                     : kKeyValueSetCacheMiss);
+  }
+  return result;
+}
+
+std::unique_ptr<GetKeyValueSetResult> SortedSnapshotCache::GetUInt32ValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetUInt32ValueSetLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  return GetUIntValueSet<UInt32ValueSet>(request_context, key_set);
+}
+
+std::unique_ptr<GetKeyValueSetResult> SortedSnapshotCache::GetUInt64ValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetUInt64ValueSetLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  return GetUIntValueSet<UInt64ValueSet>(request_context, key_set);
+}
+
+void SortedSnapshotCache::LogCacheAccessMetrics(
+    const RequestContext& request_context,
+    std::string_view cache_access_event) const {
+  LogIfError(
+      request_context.GetInternalLookupMetricsContext()
+          .AccumulateMetric<kCacheAccessEventCount>(1, cache_access_event));
+}
+
+}  // namespace kv_server
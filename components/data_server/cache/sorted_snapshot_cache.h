@@ -0,0 +1,120 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_SORTED_SNAPSHOT_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_SORTED_SNAPSHOT_CACHE_H_
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/get_key_value_set_result.h"
+#include "public/data_loading/readers/sorted_snapshot_reader.h"
+
+namespace kv_server {
+
+// Read-only datastore that serves lookups straight from a memory mapped
+// sorted snapshot file, see `SortedSnapshotReader`, instead of loading the
+// snapshot into memory. String values and string set values are returned as
+// views into the mapped file, so the resident memory of the cache is bounded
+// by the pages that lookups touch rather than by the size of the snapshot.
+//
+// Sorted snapshots are immutable: the mutation methods are no-ops, and values
+// are visible as written by `generate_snapshot`, i.e., deleted keys and values
+// are not stored.
+//
+// One cache object is only for keys in one namespace.
+class SortedSnapshotCache : public Cache {
+ public:
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  std::unique_ptr<GetKeyValueSetResult> GetUInt32ValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  std::unique_ptr<GetKeyValueSetResult> GetUInt64ValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  void UpdateKeyValue(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, std::string_view value, int64_t logical_commit_time,
+      std::string_view prefix) override {}
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<std::string_view> value_set,
+      int64_t logical_commit_time, std::string_view prefix) override {}
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<uint32_t> value_set,
+      int64_t logical_commit_time, std::string_view prefix) override {}
+  void UpdateKeyValueSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<uint64_t> value_set,
+      int64_t logical_commit_time, std::string_view prefix) override {}
+  void DeleteKey(privacy_sandbox::server_common::log::PSLogContext& log_context,
+                 std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix) override {}
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<std::string_view> value_set,
+      int64_t logical_commit_time, std::string_view prefix) override {}
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<uint32_t> value_set,
+      int64_t logical_commit_time, std::string_view prefix) override {}
+  void DeleteValuesInSet(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      std::string_view key, absl::Span<uint64_t> value_set,
+      int64_t logical_commit_time, std::string_view prefix) override {}
+  void RemoveDeletedKeys(
+      privacy_sandbox::server_common::log::PSLogContext& log_context,
+      int64_t logical_commit_time, std::string_view prefix) override {}
+
+  // Maps the sorted snapshot at `snapshot_path`.
+  static absl::StatusOr<std::unique_ptr<Cache>> Create(
+      const std::string& snapshot_path);
+
+ private:
+  explicit SortedSnapshotCache(std::unique_ptr<SortedSnapshotReader> reader)
+      : reader_(std::move(reader)) {}
+
+  template <typename SetType>
+  std::unique_ptr<GetKeyValueSetResult> GetUIntValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const;
+
+  // Logs cache access metrics for cache hit or miss counts. The cache access
+  // event name is defined in server_definition.h file
+  void LogCacheAccessMetrics(const RequestContext& request_context,
+                             std::string_view cache_access_event) const;
+
+  std::unique_ptr<SortedSnapshotReader> reader_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_SORTED_SNAPSHOT_CACHE_H_
@@ -0,0 +1,156 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/sorted_snapshot_cache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/record_utils.h"
+#include "public/data_loading/writers/sorted_snapshot_writer.h"
+
+namespace kv_server {
+namespace {
+
+using testing::UnorderedElementsAre;
+
+class SafePathTestLogContext
+    : public privacy_sandbox::server_common::log::SafePathContext {
+ public:
+  SafePathTestLogContext() = default;
+};
+
+template <typename ValueT>
+KeyValueMutationRecordT GetRecord(
+    std::string key, ValueT value,
+    KeyValueMutationType mutation_type = KeyValueMutationType::Update) {
+  KeyValueMutationRecordT record = {
+      .mutation_type = mutation_type,
+      .logical_commit_time = 10,
+      .key = std::move(key),
+  };
+  record.value.Set(std::move(value));
+  return record;
+}
+
+class SortedSnapshotCacheTest : public ::testing::Test {
+ protected:
+  SortedSnapshotCacheTest() {
+    InitMetricsContextMap();
+    request_context_ = std::make_shared<RequestContext>();
+  }
+
+  void SetUp() override {
+    std::vector<KeyValueMutationRecordT> records;
+    records.push_back(GetRecord("string_key", StringValueT{.value = "value"}));
+    records.push_back(GetRecord(
+        "string_set_key", StringSetT{.value = {"value1", "value2"}}));
+    records.push_back(
+        GetRecord("uint32_set_key", UInt32SetT{.value = {1000, 1001}}));
+    records.push_back(
+        GetRecord("uint64_set_key", UInt64SetT{.value = {1ull << 40}}));
+    records.push_back(GetRecord("deleted_key", StringValueT{.value = "value"},
+                                KeyValueMutationType::Delete));
+    std::sort(records.begin(), records.end(),
+              [](const KeyValueMutationRecordT& left,
+                 const KeyValueMutationRecordT& right) {
+                return SortedSnapshotKeyFingerprint(left.key) <
+                       SortedSnapshotKeyFingerprint(right.key);
+              });
+    std::ofstream file(GetSnapshotPath(), std::ios::binary | std::ios::trunc);
+    auto writer =
+        SortedSnapshotWriter::Create(file, DeltaRecordWriter::Options{});
+    ASSERT_TRUE(writer.ok()) << writer.status();
+    for (auto& record : records) {
+      DataRecordT data_record;
+      data_record.record.Set(std::move(record));
+      ASSERT_TRUE((*writer)->WriteRecord(data_record).ok());
+    }
+    (*writer)->Close();
+    ASSERT_TRUE((*writer)->Status().ok());
+  }
+
+  std::string GetSnapshotPath() const {
+    return absl::StrCat(::testing::TempDir(), "/sorted_snapshot_cache_test");
+  }
+  const RequestContext& GetRequestContext() { return *request_context_; }
+  std::shared_ptr<RequestContext> request_context_;
+  SafePathTestLogContext safe_path_log_context_;
+};
+
+TEST_F(SortedSnapshotCacheTest, RetrievesStringValues) {
+  auto cache = SortedSnapshotCache::Create(GetSnapshotPath());
+  ASSERT_TRUE(cache.ok()) << cache.status();
+  auto kv_pairs = (*cache)->GetKeyValuePairs(
+      GetRequestContext(),
+      {"string_key", "string_set_key", "deleted_key", "missing_key"});
+  EXPECT_EQ(kv_pairs.size(), 1);
+  EXPECT_EQ(kv_pairs["string_key"], "value");
+}
+
+TEST_F(SortedSnapshotCacheTest, RetrievesStringSetValues) {
+  auto cache = SortedSnapshotCache::Create(GetSnapshotPath());
+  ASSERT_TRUE(cache.ok()) << cache.status();
+  auto result = (*cache)->GetKeyValueSet(
+      GetRequestContext(), {"string_set_key", "string_key", "missing_key"});
+  EXPECT_THAT(result->GetValueSet("string_set_key"),
+              UnorderedElementsAre("value1", "value2"));
+  EXPECT_TRUE(result->GetValueSet("string_key").empty());
+  EXPECT_TRUE(result->GetValueSet("missing_key").empty());
+}
+
+TEST_F(SortedSnapshotCacheTest, RetrievesUIntSetValues) {
+  auto cache = SortedSnapshotCache::Create(GetSnapshotPath());
+  ASSERT_TRUE(cache.ok()) << cache.status();
+  auto uint32_result = (*cache)->GetUInt32ValueSet(
+      GetRequestContext(), {"uint32_set_key", "uint64_set_key"});
+  ASSERT_NE(uint32_result->GetUInt32ValueSet("uint32_set_key"), nullptr);
+  EXPECT_THAT(
+      uint32_result->GetUInt32ValueSet("uint32_set_key")->GetValues(),
+      UnorderedElementsAre(1000, 1001));
+  EXPECT_EQ(uint32_result->GetUInt32ValueSet("uint64_set_key"), nullptr);
+  auto uint64_result =
+      (*cache)->GetUInt64ValueSet(GetRequestContext(), {"uint64_set_key"});
+  ASSERT_NE(uint64_result->GetUInt64ValueSet("uint64_set_key"), nullptr);
+  EXPECT_THAT(
+      uint64_result->GetUInt64ValueSet("uint64_set_key")->GetValues(),
+      UnorderedElementsAre(1ull << 40));
+}
+
+TEST_F(SortedSnapshotCacheTest, IgnoresMutations) {
+  auto cache = SortedSnapshotCache::Create(GetSnapshotPath());
+  ASSERT_TRUE(cache.ok()) << cache.status();
+  (*cache)->UpdateKeyValue(safe_path_log_context_, "string_key", "new_value",
+                           20);
+  (*cache)->DeleteKey(safe_path_log_context_, "string_key", 30);
+  auto kv_pairs =
+      (*cache)->GetKeyValuePairs(GetRequestContext(), {"string_key"});
+  EXPECT_EQ(kv_pairs["string_key"], "value");
+}
+
+TEST(SortedSnapshotCacheCreateTest, FailsForMissingSnapshot) {
+  auto cache = SortedSnapshotCache::Create(
+      absl::StrCat(::testing::TempDir(), "/missing_sorted_snapshot"));
+  EXPECT_FALSE(cache.ok());
+}
+
+}  // namespace
+}  // namespace kv_server
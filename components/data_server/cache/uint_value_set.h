@@ -22,6 +22,7 @@
 #include "absl/container/btree_map.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "components/data_server/cache/cache_memory_stats.h"
 
 #include "roaring.hh"
 #include "roaring64map.hh"
@@ -47,32 +48,56 @@ class UIntValueSet {
   const BitsetType& GetValuesBitSet() const;
   // Returns values marked as removed from the set.
   absl::flat_hash_set<ValueType> GetRemovedValues() const;
+  // Returns the number of values marked as removed from the set.
+  size_t GetRemovedValuesCount() const;
+  // Returns the memory used by the values of the set, including values marked
+  // as removed. The key bytes are not known to the set, so they are zero.
+  ValueMemoryStats GetMemoryStats() const;
+  // Calls `fn(value, logical_commit_time, is_deleted, prefix_id)` for every
+  // value in the set, including values marked as removed.
+  template <typename Fn>
+  void ForEachValue(Fn&& fn) const;
 
   // Adds values associated with `logical_commit_time` to the set. If a value
   // with the same or greater `logical_commit_time` already exists in the set,
-  // then this is a noop.
-  void Add(absl::Span<ValueType> values, int64_t logical_commit_time);
+  // then this is a noop. `prefix_id` is recorded with the values, see
+  // `PrefixIds`.
+  void Add(absl::Span<const ValueType> values, int64_t logical_commit_time,
+           uint32_t prefix_id = 0);
   // Marks values associated with `logical_commit_time` as removed from the set.
   // If a value with the same or greater `logical_commit_time` already exists in
   // the set, then this is a noop.
-  void Remove(absl::Span<ValueType> values, int64_t logical_commit_time);
+  void Remove(absl::Span<const ValueType> values, int64_t logical_commit_time,
+              uint32_t prefix_id = 0);
   // Cleans up space occupied by values (including value metadata) matching the
   // condition `logical_commit_time` <= `cutoff_logical_commit_time` and are
   // marked as removed.
   void Cleanup(int64_t cutoff_logical_commit_time);
+  // Erases `value` and its metadata if it was last added or removed before
+  // `logical_commit_time`.
+  void EraseIfOlder(ValueType value, int64_t logical_commit_time);
 
  private:
   struct ValueMetadata {
     int64_t logical_commit_time;
     bool is_deleted;
+    // Id of the prefix of the last mutation of the value. Fits in the padding
+    // after `is_deleted`.
+    uint32_t prefix_id;
   };
 
-  void AddOrRemove(absl::Span<ValueType> values, int64_t logical_commit_time,
-                   bool is_deleted);
+  void AddOrRemove(absl::Span<const ValueType> values,
+                   int64_t logical_commit_time, bool is_deleted,
+                   uint32_t prefix_id);
+
+  // Forgets that `value` was removed at `logical_commit_time`, so that
+  // cleaning up that commit time does not drop the metadata of the value.
+  void ForgetRemoval(ValueType value, int64_t logical_commit_time);
 
   BitsetType values_bitset_;
   absl::flat_hash_map<ValueType, ValueMetadata> values_metadata_;
   absl::btree_map<int64_t, absl::flat_hash_set<ValueType>> deleted_values_;
+  size_t num_removed_values_ = 0;
 };
 
 // Define specialized aliases for 32 and 64 bit unsigned int sets.
@@ -109,38 +134,69 @@ UIntValueSet<ValueType, BitsetType>::GetRemovedValues() const {
   return removed_values;
 }
 
+template <typename ValueType, typename BitsetType>
+size_t UIntValueSet<ValueType, BitsetType>::GetRemovedValuesCount() const {
+  return num_removed_values_;
+}
+
+template <typename ValueType, typename BitsetType>
+ValueMemoryStats UIntValueSet<ValueType, BitsetType>::GetMemoryStats() const {
+  ValueMemoryStats stats;
+  stats.cardinality = values_bitset_.cardinality();
+  stats.tombstones = num_removed_values_;
+  stats.value_bytes =
+      (stats.cardinality + stats.tombstones) * sizeof(ValueType);
+  stats.bitset_bytes = values_bitset_.getSizeInBytes();
+  return stats;
+}
+
+template <typename ValueType, typename BitsetType>
+template <typename Fn>
+void UIntValueSet<ValueType, BitsetType>::ForEachValue(Fn&& fn) const {
+  for (const auto& [value, metadata] : values_metadata_) {
+    fn(value, metadata.logical_commit_time, metadata.is_deleted,
+       metadata.prefix_id);
+  }
+}
+
 template <typename ValueType, typename BitsetType>
 void UIntValueSet<ValueType, BitsetType>::AddOrRemove(
-    absl::Span<ValueType> values, int64_t logical_commit_time,
-    bool is_deleted) {
+    absl::Span<const ValueType> values, int64_t logical_commit_time,
+    bool is_deleted, uint32_t prefix_id) {
   for (auto value : values) {
     auto* metadata = &values_metadata_[value];
     if (metadata->logical_commit_time >= logical_commit_time) {
       continue;
     }
+    if (metadata->is_deleted) {
+      ForgetRemoval(value, metadata->logical_commit_time);
+    }
     metadata->logical_commit_time = logical_commit_time;
     metadata->is_deleted = is_deleted;
+    metadata->prefix_id = prefix_id;
     if (is_deleted) {
       values_bitset_.remove(value);
       deleted_values_[logical_commit_time].insert(value);
+      ++num_removed_values_;
     } else {
       values_bitset_.add(value);
-      deleted_values_[logical_commit_time].erase(value);
     }
   }
   values_bitset_.runOptimize();
 }
 
 template <typename ValueType, typename BitsetType>
-void UIntValueSet<ValueType, BitsetType>::Add(absl::Span<ValueType> values,
-                                              int64_t logical_commit_time) {
-  AddOrRemove(values, logical_commit_time, /*is_deleted=*/false);
+void UIntValueSet<ValueType, BitsetType>::Add(
+    absl::Span<const ValueType> values, int64_t logical_commit_time,
+    uint32_t prefix_id) {
+  AddOrRemove(values, logical_commit_time, /*is_deleted=*/false, prefix_id);
 }
 
 template <typename ValueType, typename BitsetType>
-void UIntValueSet<ValueType, BitsetType>::Remove(absl::Span<ValueType> values,
-                                                 int64_t logical_commit_time) {
-  AddOrRemove(values, logical_commit_time, /*is_deleted=*/true);
+void UIntValueSet<ValueType, BitsetType>::Remove(
+    absl::Span<const ValueType> values, int64_t logical_commit_time,
+    uint32_t prefix_id) {
+  AddOrRemove(values, logical_commit_time, /*is_deleted=*/true, prefix_id);
 }
 
 template <typename ValueType, typename BitsetType>
@@ -151,7 +207,7 @@ void UIntValueSet<ValueType, BitsetType>::Cleanup(
       break;
     }
     for (auto value : values) {
-      values_metadata_.erase(value);
+      num_removed_values_ -= values_metadata_.erase(value);
     }
   }
   deleted_values_.erase(
@@ -160,15 +216,51 @@ void UIntValueSet<ValueType, BitsetType>::Cleanup(
 }
 
 template <typename ValueType, typename BitsetType>
-absl::flat_hash_set<ValueType> BitSetToUintSet(const BitsetType& bitset) {
-  auto num_values = bitset.cardinality();
-  auto data = std::make_unique<ValueType[]>(num_values);
+void UIntValueSet<ValueType, BitsetType>::EraseIfOlder(
+    ValueType value, int64_t logical_commit_time) {
+  auto metadata_itr = values_metadata_.find(value);
+  if (metadata_itr == values_metadata_.end() ||
+      metadata_itr->second.logical_commit_time >= logical_commit_time) {
+    return;
+  }
+  if (metadata_itr->second.is_deleted) {
+    ForgetRemoval(value, metadata_itr->second.logical_commit_time);
+  } else {
+    values_bitset_.remove(value);
+  }
+  values_metadata_.erase(metadata_itr);
+}
+
+template <typename ValueType, typename BitsetType>
+void UIntValueSet<ValueType, BitsetType>::ForgetRemoval(
+    ValueType value, int64_t logical_commit_time) {
+  if (auto deleted_itr = deleted_values_.find(logical_commit_time);
+      deleted_itr != deleted_values_.end()) {
+    deleted_itr->second.erase(value);
+    if (deleted_itr->second.empty()) {
+      deleted_values_.erase(deleted_itr);
+    }
+  }
+  --num_removed_values_;
+}
+
+// Writes the values of `bitset` to `values` in ascending order. `values` must
+// have room for `bitset.cardinality()` values.
+template <typename ValueType, typename BitsetType>
+void BitSetToUintArray(const BitsetType& bitset, ValueType* values) {
   if constexpr (std::is_same_v<BitsetType, roaring::Roaring>) {
-    bitset.toUint32Array(data.get());
+    bitset.toUint32Array(values);
   }
   if constexpr (std::is_same_v<BitsetType, roaring::Roaring64Map>) {
-    bitset.toUint64Array(data.get());
+    bitset.toUint64Array(values);
   }
+}
+
+template <typename ValueType, typename BitsetType>
+absl::flat_hash_set<ValueType> BitSetToUintSet(const BitsetType& bitset) {
+  auto num_values = bitset.cardinality();
+  auto data = std::make_unique<ValueType[]>(num_values);
+  BitSetToUintArray(bitset, data.get());
   return absl::flat_hash_set<ValueType>(data.get(), data.get() + num_values);
 }
 
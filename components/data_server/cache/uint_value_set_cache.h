@@ -17,21 +17,38 @@
 #ifndef COMPONENTS_DATA_SERVER_CACHE_UINT_VALUE_SET_CACHE_H_
 #define COMPONENTS_DATA_SERVER_CACHE_UINT_VALUE_SET_CACHE_H_
 
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 #include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
 #include "components/container/thread_safe_hash_map.h"
+#include "components/data_server/cache/cache_memory_stats.h"
 #include "components/data_server/cache/get_key_value_set_result.h"
+#include "components/data_server/cache/prefix_ids.h"
 #include "components/util/request_context.h"
 #include "src/logger/request_context_logger.h"
+#include "src/util/status_macro/status_macros.h"
 
 namespace kv_server {
 
 template <typename SetType>
 class UIntValueSetCache {
  public:
+  // A set value marked as deleted.
+  struct Deletion {
+    std::string key;
+    typename SetType::value_type value;
+    int64_t logical_commit_time;
+  };
+
   // Returns "uint" value set result for given set keys.
   std::unique_ptr<GetKeyValueSetResult> GetValueSet(
       const RequestContext& request_context,
@@ -41,7 +58,8 @@ class UIntValueSetCache {
   // exists, updates its timestamp to the latest logical commit time.
   void UpdateSetValues(
       privacy_sandbox::server_common::log::PSLogContext& log_context,
-      std::string_view key, absl::Span<typename SetType::value_type> value_set,
+      std::string_view key,
+      absl::Span<const typename SetType::value_type> value_set,
       int64_t logical_commit_time, std::string_view prefix = "");
 
   // Deletes set values for a given key and prefix. After the deletion,
@@ -49,7 +67,8 @@ class UIntValueSetCache {
   // late-arriving updates to this value.
   void DeleteSetValues(
       privacy_sandbox::server_common::log::PSLogContext& log_context,
-      std::string_view key, absl::Span<typename SetType::value_type> value_set,
+      std::string_view key,
+      absl::Span<const typename SetType::value_type> value_set,
       int64_t logical_commit_time, std::string_view prefix = "");
 
   // Removes the set values that were deleted before the specified
@@ -59,7 +78,44 @@ class UIntValueSetCache {
       privacy_sandbox::server_common::log::PSLogContext& log_context,
       int64_t logical_commit_time, std::string_view prefix = "");
 
+  // Returns the deleted set values that `CleanUpValueSets` would remove for
+  // `logical_commit_time` and `prefix`, grouped by key.
+  std::vector<Deletion> GetDeletionsToRemove(int64_t logical_commit_time,
+                                             std::string_view prefix) const;
+
+  // Erases the set values, deleted or not, that were last mutated before the
+  // deletion of the same value in `deletions`. Memory changes are attributed
+  // to `prefix`.
+  void EraseValuesOlderThan(absl::Span<const Deletion> deletions,
+                            std::string_view prefix);
+
+  // Calls `visit_fn(key, values, logical_commit_time, is_deleted, prefix)` for
+  // the set values of every key, grouped by logical commit time, deletion
+  // state and the prefix of the mutation that last changed them. Values are
+  // copied `chunk_size` keys at a time and `visit_fn` is called without
+  // holding any lock of the cache. Stops at the first non-ok status returned
+  // by `visit_fn`.
+  absl::Status Export(
+      size_t chunk_size,
+      absl::FunctionRef<absl::Status(
+          std::string_view key,
+          absl::Span<typename SetType::value_type> values,
+          int64_t logical_commit_time, bool is_deleted,
+          std::string_view prefix)>
+          visit_fn);
+
+  // Calls `visit_fn(key)` for the key of every set, while holding a shared lock
+  // of the sets map.
+  void ForEachKey(absl::FunctionRef<void(std::string_view key)> visit_fn);
+
+  // Returns the memory used by the sets per prefix. Changes are attributed to
+  // the prefix of the mutation or cleanup that made them, so the stats of a
+  // prefix are exact as long as prefixes do not share set keys.
+  absl::flat_hash_map<std::string, ValueMemoryStats> GetMemoryStats() const;
+
  private:
+  void AddMemoryStats(std::string_view prefix, const ValueMemoryStats& delta);
+
   // Maps set key to unsigned int value set per prefix.
   ThreadSafeHashMap<std::string, SetType> sets_map_;
   // Maps prefix to maximum clean up commit time. Set updates for this prefix
@@ -70,6 +126,12 @@ class UIntValueSetCache {
   ThreadSafeHashMap<std::string,
                     absl::btree_map<int64_t, absl::flat_hash_set<std::string>>>
       deleted_sets_map_;
+  // Ids of the prefixes recorded with the set values.
+  PrefixIds prefix_ids_;
+  // Guards `memory_stats_` only, no other lock is taken while holding it.
+  mutable absl::Mutex memory_stats_mutex_;
+  absl::flat_hash_map<std::string, ValueMemoryStats> memory_stats_
+      ABSL_GUARDED_BY(memory_stats_mutex_);
 
   // Allow a unit test class to access private members to verify correct
   // deletion and clean up.
@@ -91,7 +153,8 @@ std::unique_ptr<GetKeyValueSetResult> UIntValueSetCache<SetType>::GetValueSet(
 template <typename SetType>
 void UIntValueSetCache<SetType>::UpdateSetValues(
     privacy_sandbox::server_common::log::PSLogContext& log_context,
-    std::string_view key, absl::Span<typename SetType::value_type> value_set,
+    std::string_view key,
+    absl::Span<const typename SetType::value_type> value_set,
     int64_t logical_commit_time, std::string_view prefix) {
   if (value_set.empty()) {
     PS_VLOG(8, log_context)
@@ -108,21 +171,30 @@ void UIntValueSetCache<SetType>::UpdateSetValues(
         << *prefix_max_time_node.value();
     return;  // Skip old updates.
   }
+  ValueMemoryStats stats_delta;
   auto cached_set_node = sets_map_.Get(key);
   if (!cached_set_node.is_present()) {
     auto result = sets_map_.PutIfAbsent(key, SetType());
     if (result.second) {
       PS_VLOG(8, log_context) << "Added new key: [" << key << "] is a new key.";
+      // An empty set already holds an empty bitset.
+      stats_delta.key_bytes = key.size();
+      stats_delta += result.first.value()->GetMemoryStats();
     }
     cached_set_node = std::move(result.first);
   }
-  cached_set_node.value()->Add(value_set, logical_commit_time);
+  stats_delta -= cached_set_node.value()->GetMemoryStats();
+  cached_set_node.value()->Add(value_set, logical_commit_time,
+                               prefix_ids_.GetOrAddId(prefix));
+  stats_delta += cached_set_node.value()->GetMemoryStats();
+  AddMemoryStats(prefix, stats_delta);
 }
 
 template <typename SetType>
 void UIntValueSetCache<SetType>::DeleteSetValues(
     privacy_sandbox::server_common::log::PSLogContext& log_context,
-    std::string_view key, absl::Span<typename SetType::value_type> value_set,
+    std::string_view key,
+    absl::Span<const typename SetType::value_type> value_set,
     int64_t logical_commit_time, std::string_view prefix) {
   if (value_set.empty()) {
     PS_VLOG(8, log_context)
@@ -140,12 +212,21 @@ void UIntValueSetCache<SetType>::DeleteSetValues(
     return;  // Skip old deletes.
   }
   {
+    ValueMemoryStats stats_delta;
     auto cached_set_node = sets_map_.Get(key);
     if (!cached_set_node.is_present()) {
       auto result = sets_map_.PutIfAbsent(key, SetType());
+      if (result.second) {
+        stats_delta.key_bytes = key.size();
+        stats_delta += result.first.value()->GetMemoryStats();
+      }
       cached_set_node = std::move(result.first);
     }
-    cached_set_node.value()->Remove(value_set, logical_commit_time);
+    stats_delta -= cached_set_node.value()->GetMemoryStats();
+    cached_set_node.value()->Remove(value_set, logical_commit_time,
+                                    prefix_ids_.GetOrAddId(prefix));
+    stats_delta += cached_set_node.value()->GetMemoryStats();
+    AddMemoryStats(prefix, stats_delta);
   }
   {
     // Mark set as having deleted elements.
@@ -196,12 +277,156 @@ void UIntValueSetCache<SetType>::CleanUpValueSets(
     }
   }
   {
+    ValueMemoryStats stats_delta;
     for (const auto& set : cleanup_sets) {
       if (auto set_node = sets_map_.Get(set); set_node.is_present()) {
+        stats_delta -= set_node.value()->GetMemoryStats();
         set_node.value()->Cleanup(logical_commit_time);
+        stats_delta += set_node.value()->GetMemoryStats();
+      }
+    }
+    AddMemoryStats(prefix, stats_delta);
+  }
+}
+
+template <typename SetType>
+std::vector<typename UIntValueSetCache<SetType>::Deletion>
+UIntValueSetCache<SetType>::GetDeletionsToRemove(
+    int64_t logical_commit_time, std::string_view prefix) const {
+  absl::flat_hash_set<std::string> cleanup_sets;
+  {
+    auto prefix_deleted_sets_node = deleted_sets_map_.CGet(prefix);
+    if (!prefix_deleted_sets_node.is_present()) {
+      return {};
+    }
+    for (const auto& [commit_time, deleted_sets] :
+         *prefix_deleted_sets_node.value()) {
+      if (commit_time > logical_commit_time) {
+        break;
       }
+      cleanup_sets.insert(deleted_sets.begin(), deleted_sets.end());
     }
   }
+  std::vector<Deletion> deletions;
+  for (const auto& set : cleanup_sets) {
+    auto set_node = sets_map_.CGet(set);
+    if (!set_node.is_present()) {
+      continue;
+    }
+    set_node.value()->ForEachValue(
+        [&](typename SetType::value_type value, int64_t value_commit_time,
+            bool is_deleted, uint32_t prefix_id) {
+          if (is_deleted && value_commit_time <= logical_commit_time) {
+            deletions.push_back({.key = set,
+                                 .value = value,
+                                 .logical_commit_time = value_commit_time});
+          }
+        });
+  }
+  return deletions;
+}
+
+template <typename SetType>
+void UIntValueSetCache<SetType>::EraseValuesOlderThan(
+    absl::Span<const Deletion> deletions, std::string_view prefix) {
+  ValueMemoryStats stats_delta;
+  auto begin = deletions.begin();
+  while (begin != deletions.end()) {
+    const auto end =
+        std::find_if(begin, deletions.end(), [begin](const Deletion& deletion) {
+          return deletion.key != begin->key;
+        });
+    if (auto set_node = sets_map_.Get(begin->key); set_node.is_present()) {
+      stats_delta -= set_node.value()->GetMemoryStats();
+      for (auto deletion = begin; deletion != end; ++deletion) {
+        set_node.value()->EraseIfOlder(deletion->value,
+                                       deletion->logical_commit_time);
+      }
+      stats_delta += set_node.value()->GetMemoryStats();
+    }
+    begin = end;
+  }
+  AddMemoryStats(prefix, stats_delta);
+}
+
+template <typename SetType>
+void UIntValueSetCache<SetType>::ForEachKey(
+    absl::FunctionRef<void(std::string_view key)> visit_fn) {
+  for (const auto& set_node : sets_map_) {
+    visit_fn(*set_node.key());
+  }
+}
+
+template <typename SetType>
+absl::Status UIntValueSetCache<SetType>::Export(
+    size_t chunk_size,
+    absl::FunctionRef<absl::Status(
+        std::string_view key, absl::Span<typename SetType::value_type> values,
+        int64_t logical_commit_time, bool is_deleted, std::string_view prefix)>
+        visit_fn) {
+  std::vector<std::string> keys;
+  for (const auto& set_node : sets_map_) {
+    keys.push_back(*set_node.key());
+  }
+  struct ExportedValues {
+    std::string_view key;
+    int64_t logical_commit_time;
+    bool is_deleted;
+    std::string_view prefix;
+    std::vector<typename SetType::value_type> values;
+  };
+  std::vector<ExportedValues> value_groups;
+  for (size_t begin = 0; begin < keys.size(); begin += chunk_size) {
+    const size_t end = std::min(keys.size(), begin + chunk_size);
+    value_groups.clear();
+    for (size_t i = begin; i < end; ++i) {
+      auto set_node = sets_map_.CGet(keys[i]);
+      if (!set_node.is_present()) {
+        continue;
+      }
+      absl::flat_hash_map<std::tuple<int64_t, bool, uint32_t>, size_t>
+          group_indices;
+      set_node.value()->ForEachValue([&](typename SetType::value_type value,
+                                         int64_t logical_commit_time,
+                                         bool is_deleted, uint32_t prefix_id) {
+        const auto [group_iter, inserted] = group_indices.try_emplace(
+            std::tuple(logical_commit_time, is_deleted, prefix_id),
+            value_groups.size());
+        if (inserted) {
+          value_groups.push_back(
+              {.key = keys[i],
+               .logical_commit_time = logical_commit_time,
+               .is_deleted = is_deleted,
+               .prefix = prefix_ids_.GetPrefix(prefix_id)});
+        }
+        value_groups[group_iter->second].values.push_back(value);
+      });
+    }
+    for (auto& value_group : value_groups) {
+      PS_RETURN_IF_ERROR(visit_fn(
+          value_group.key, absl::MakeSpan(value_group.values),
+          value_group.logical_commit_time, value_group.is_deleted,
+          value_group.prefix));
+    }
+  }
+  return absl::OkStatus();
+}
+
+template <typename SetType>
+absl::flat_hash_map<std::string, ValueMemoryStats>
+UIntValueSetCache<SetType>::GetMemoryStats() const {
+  absl::MutexLock lock(&memory_stats_mutex_);
+  return memory_stats_;
+}
+
+template <typename SetType>
+void UIntValueSetCache<SetType>::AddMemoryStats(
+    std::string_view prefix, const ValueMemoryStats& delta) {
+  if (delta == ValueMemoryStats()) {
+    return;
+  }
+  absl::MutexLock lock(&memory_stats_mutex_);
+  memory_stats_[prefix] += delta;
 }
 
 }  // namespace kv_server
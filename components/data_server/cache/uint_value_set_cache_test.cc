@@ -43,6 +43,18 @@ class UIntValueSetCacheTest : public ::testing::Test {
     return cache.deleted_sets_map_;
   }
 
+  // Recomputes the memory stats of all prefixes from the cached sets.
+  template <typename SetType>
+  static ValueMemoryStats ComputeMemoryStats(
+      UIntValueSetCache<SetType>& cache) {
+    ValueMemoryStats stats;
+    for (auto& set_node : cache.sets_map_) {
+      stats.key_bytes += set_node.key()->size();
+      stats += set_node.value()->GetMemoryStats();
+    }
+    return stats;
+  }
+
   std::shared_ptr<RequestContext> request_context_;
   SafePathTestLogContext safe_path_log_context_;
 };
@@ -189,6 +201,49 @@ void VerifyCleaningUpSets(std::shared_ptr<RequestContext> request_context,
   }
 }
 
+template <typename SetType>
+ValueMemoryStats GetTotalMemoryStats(const UIntValueSetCache<SetType>& cache) {
+  ValueMemoryStats total_stats;
+  for (const auto& [prefix, stats] : cache.GetMemoryStats()) {
+    total_stats += stats;
+  }
+  return total_stats;
+}
+
+template <typename SetType>
+void VerifyMemoryStats(SafePathTestLogContext& safe_path_log_context) {
+  UIntValueSetCache<SetType> cache;
+  auto values = std::vector<typename SetType::value_type>({1, 2, 3, 4});
+  auto delete_values = std::vector<typename SetType::value_type>({3, 4, 5});
+  auto readd_values = std::vector<typename SetType::value_type>({4});
+  cache.UpdateSetValues(safe_path_log_context, "set1", absl::MakeSpan(values),
+                        1);
+  cache.UpdateSetValues(safe_path_log_context, "set2", absl::MakeSpan(values),
+                        1, "prefix");
+  EXPECT_TRUE(GetTotalMemoryStats(cache) ==
+              UIntValueSetCacheTest::ComputeMemoryStats(cache));
+  cache.DeleteSetValues(safe_path_log_context, "set1",
+                        absl::MakeSpan(delete_values), 2);
+  cache.DeleteSetValues(safe_path_log_context, "set3",
+                        absl::MakeSpan(delete_values), 2);
+  EXPECT_TRUE(GetTotalMemoryStats(cache) ==
+              UIntValueSetCacheTest::ComputeMemoryStats(cache));
+  cache.UpdateSetValues(safe_path_log_context, "set1",
+                        absl::MakeSpan(readd_values), 3);
+  EXPECT_TRUE(GetTotalMemoryStats(cache) ==
+              UIntValueSetCacheTest::ComputeMemoryStats(cache));
+  cache.CleanUpValueSets(safe_path_log_context, 3);
+  EXPECT_TRUE(GetTotalMemoryStats(cache) ==
+              UIntValueSetCacheTest::ComputeMemoryStats(cache));
+
+  auto memory_stats = cache.GetMemoryStats();
+  EXPECT_EQ(memory_stats[""].key_bytes, 8);
+  EXPECT_EQ(memory_stats[""].cardinality, 3);
+  EXPECT_EQ(memory_stats[""].tombstones, 0);
+  EXPECT_EQ(memory_stats["prefix"].key_bytes, 4);
+  EXPECT_EQ(memory_stats["prefix"].cardinality, 4);
+}
+
 TEST_F(UIntValueSetCacheTest, VerifyUpdatingSets) {
   VerifyUpdatingSets<UInt32ValueSet>(request_context_, safe_path_log_context_);
   VerifyUpdatingSets<UInt64ValueSet>(request_context_, safe_path_log_context_);
@@ -206,5 +261,10 @@ TEST_F(UIntValueSetCacheTest, VerifyCleaningUpSets) {
                                        safe_path_log_context_);
 }
 
+TEST_F(UIntValueSetCacheTest, VerifyMemoryStats) {
+  VerifyMemoryStats<UInt32ValueSet>(safe_path_log_context_);
+  VerifyMemoryStats<UInt64ValueSet>(safe_path_log_context_);
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -22,6 +22,7 @@
 namespace kv_server {
 namespace {
 
+using testing::ElementsAre;
 using testing::UnorderedElementsAre;
 
 TEST(UInt32ValueSet, VerifyAddingValues) {
@@ -37,6 +38,20 @@ TEST(UInt32ValueSet, VerifyBitSetToUint32Set) {
   EXPECT_THAT(BitSetToUint32Set(bitset), UnorderedElementsAre(1, 2, 3, 4, 5));
 }
 
+TEST(UInt32ValueSet, VerifyBitSetToUintArray) {
+  roaring::Roaring bitset({5, 1, 4294967295, 3});
+  std::vector<uint32_t> values(bitset.cardinality());
+  BitSetToUintArray(bitset, values.data());
+  EXPECT_THAT(values, ElementsAre(1, 3, 5, 4294967295));
+}
+
+TEST(UInt64ValueSet, VerifyBitSetToUintArray) {
+  roaring::Roaring64Map bitset({18446744073709551615ull, 1, 4294967296});
+  std::vector<uint64_t> values(bitset.cardinality());
+  BitSetToUintArray(bitset, values.data());
+  EXPECT_THAT(values, ElementsAre(1, 4294967296, 18446744073709551615ull));
+}
+
 TEST(UInt32ValueSet, VerifyRemovingValues) {
   UInt32ValueSet value_set;
   auto values = std::vector<uint32_t>{1, 2, 3, 4, 5};
@@ -67,5 +82,58 @@ TEST(UInt32ValueSet, VerifyCleaningUpValues) {
   EXPECT_TRUE(value_set.GetRemovedValues().empty());
 }
 
+TEST(UInt32ValueSet, VerifyReaddedValuesSurviveCleanup) {
+  UInt32ValueSet value_set;
+  auto values = std::vector<uint32_t>{1, 2};
+  value_set.Add(absl::MakeSpan(values), 1);
+  value_set.Remove(absl::MakeSpan(values), 2);
+  auto readded_values = std::vector<uint32_t>{1};
+  value_set.Add(absl::MakeSpan(readded_values), 3);
+  EXPECT_THAT(value_set.GetRemovedValues(), UnorderedElementsAre(2));
+  EXPECT_EQ(value_set.GetRemovedValuesCount(), 1);
+  value_set.Cleanup(2);
+  EXPECT_TRUE(value_set.GetRemovedValues().empty());
+  EXPECT_EQ(value_set.GetRemovedValuesCount(), 0);
+  // The value keeps its metadata, so a late removal is still ignored.
+  value_set.Remove(absl::MakeSpan(readded_values), 2);
+  EXPECT_THAT(value_set.GetValues(), UnorderedElementsAre(1));
+}
+
+TEST(UInt32ValueSet, VerifyMemoryStats) {
+  UInt32ValueSet value_set;
+  auto values = std::vector<uint32_t>{1, 2, 3};
+  value_set.Add(absl::MakeSpan(values), 1);
+  auto removed_values = std::vector<uint32_t>{1};
+  value_set.Remove(absl::MakeSpan(removed_values), 2);
+  auto stats = value_set.GetMemoryStats();
+  EXPECT_EQ(stats.key_bytes, 0);
+  EXPECT_EQ(stats.cardinality, 2);
+  EXPECT_EQ(stats.tombstones, 1);
+  EXPECT_EQ(stats.value_bytes, 12);
+  EXPECT_EQ(stats.bitset_bytes,
+            static_cast<int64_t>(value_set.GetValuesBitSet().getSizeInBytes()));
+  value_set.Cleanup(2);
+  stats = value_set.GetMemoryStats();
+  EXPECT_EQ(stats.tombstones, 0);
+  EXPECT_EQ(stats.value_bytes, 8);
+}
+
+TEST(UInt32ValueSet, VerifyErasingOlderValues) {
+  UInt32ValueSet value_set;
+  auto values = std::vector<uint32_t>{1, 2, 3};
+  value_set.Add(absl::MakeSpan(values), 1);
+  auto removed_values = std::vector<uint32_t>{2};
+  value_set.Remove(absl::MakeSpan(removed_values), 2);
+  value_set.EraseIfOlder(1, 2);
+  value_set.EraseIfOlder(2, 3);
+  value_set.EraseIfOlder(3, 1);
+  EXPECT_THAT(value_set.GetValues(), UnorderedElementsAre(3));
+  EXPECT_TRUE(value_set.GetRemovedValues().empty());
+  EXPECT_EQ(value_set.GetRemovedValuesCount(), 0);
+  // Erased values have no metadata left, so older mutations apply again.
+  value_set.Add(absl::MakeSpan(removed_values), 1);
+  EXPECT_THAT(value_set.GetValues(), UnorderedElementsAre(2, 3));
+}
+
 }  // namespace
 }  // namespace kv_server
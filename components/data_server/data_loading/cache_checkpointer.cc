@@ -0,0 +1,428 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/data_loading/cache_checkpointer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "public/data_loading/data_loading_generated.h"
+#include "public/data_loading/writers/delta_record_stream_writer.h"
+#include "src/util/status_macro/status_macros.h"
+
+namespace kv_server {
+namespace {
+
+using ::privacy_sandbox::server_common::PeriodicClosure;
+
+constexpr std::string_view kTempDirectorySuffix = ".tmp";
+constexpr std::string_view kOldDirectorySuffix = ".old";
+
+class FileRecordStream : public RecordStream {
+ public:
+  explicit FileRecordStream(const std::filesystem::path& path)
+      : stream_(path, std::ios::binary) {}
+  std::istream& Stream() override { return stream_; }
+
+ private:
+  std::ifstream stream_;
+};
+
+// Returns the name of the checkpoint file with the values of `prefix`.
+std::string CheckpointFileName(std::string_view prefix) {
+  return absl::StrCat("PREFIX_", absl::BytesToHexString(prefix));
+}
+
+// Writes the visited cache values to the checkpoint files in `directory`. The
+// riegeli writers are only created once the cleanup logical commit times,
+// which are part of the file metadata, are visited.
+class CheckpointRecordWriter : public CacheVisitor {
+ public:
+  CheckpointRecordWriter(std::filesystem::path directory,
+                         KVFileMetadata metadata,
+                         std::optional<CodeConfig> udf_config)
+      : directory_(std::move(directory)),
+        metadata_(std::move(metadata)),
+        udf_config_(std::move(udf_config)) {}
+
+  absl::Status VisitCleanupLogicalCommitTimes(
+      const absl::flat_hash_map<std::string, int64_t>&
+          prefix_cleanup_logical_commit_times) override {
+    auto& cleanup_logical_commit_times =
+        *metadata_.mutable_cache_checkpoint()
+             ->mutable_prefix_cleanup_logical_commit_times();
+    for (const auto& [prefix, logical_commit_time] :
+         prefix_cleanup_logical_commit_times) {
+      cleanup_logical_commit_times[prefix] = logical_commit_time;
+    }
+    metadata_visited_ = true;
+    // The file of the empty prefix is always written, so that a checkpoint of
+    // an empty cache is restored too.
+    PS_ASSIGN_OR_RETURN(auto* record_writer, GetRecordWriter(/*prefix=*/""));
+    if (!udf_config_.has_value()) {
+      return absl::OkStatus();
+    }
+    DataRecordT data_record;
+    data_record.record.Set(UserDefinedFunctionsConfigT{
+        .language = UserDefinedFunctionsLanguage::Javascript,
+        .code_snippet = udf_config_->js,
+        .handler_name = udf_config_->udf_handler_name,
+        .logical_commit_time = udf_config_->logical_commit_time,
+        .version = udf_config_->version,
+        .wasm_bin = udf_config_->wasm_bin,
+    });
+    return record_writer->WriteRecord(data_record);
+  }
+
+  absl::Status VisitKeyValue(std::string_view key, std::string_view value,
+                             int64_t logical_commit_time, bool is_deleted,
+                             std::string_view prefix) override {
+    KeyValueMutationRecordT kv_mutation_record =
+        CreateMutationRecord(key, logical_commit_time, is_deleted);
+    kv_mutation_record.value.Set(StringValueT{.value = std::string(value)});
+    return WriteRecord(prefix, std::move(kv_mutation_record));
+  }
+
+  absl::Status VisitKeyValueSet(std::string_view key,
+                                absl::Span<std::string_view> values,
+                                int64_t logical_commit_time, bool is_deleted,
+                                std::string_view prefix) override {
+    KeyValueMutationRecordT kv_mutation_record =
+        CreateMutationRecord(key, logical_commit_time, is_deleted);
+    kv_mutation_record.value.Set(
+        StringSetT{.value = std::vector<std::string>(values.begin(),
+                                                     values.end())});
+    return WriteRecord(prefix, std::move(kv_mutation_record));
+  }
+
+  absl::Status VisitUInt32ValueSet(std::string_view key,
+                                   absl::Span<uint32_t> values,
+                                   int64_t logical_commit_time,
+                                   bool is_deleted,
+                                   std::string_view prefix) override {
+    KeyValueMutationRecordT kv_mutation_record =
+        CreateMutationRecord(key, logical_commit_time, is_deleted);
+    kv_mutation_record.value.Set(
+        UInt32SetT{.value = std::vector<uint32_t>(values.begin(),
+                                                  values.end())});
+    return WriteRecord(prefix, std::move(kv_mutation_record));
+  }
+
+  absl::Status VisitUInt64ValueSet(std::string_view key,
+                                   absl::Span<uint64_t> values,
+                                   int64_t logical_commit_time,
+                                   bool is_deleted,
+                                   std::string_view prefix) override {
+    KeyValueMutationRecordT kv_mutation_record =
+        CreateMutationRecord(key, logical_commit_time, is_deleted);
+    kv_mutation_record.value.Set(
+        UInt64SetT{.value = std::vector<uint64_t>(values.begin(),
+                                                  values.end())});
+    return WriteRecord(prefix, std::move(kv_mutation_record));
+  }
+
+  // Flushes all records to the files.
+  absl::Status Close() {
+    if (!metadata_visited_) {
+      return absl::InternalError("Cache export did not visit any metadata.");
+    }
+    for (auto& [prefix, file] : files_) {
+      file->record_writer->Close();
+      PS_RETURN_IF_ERROR(file->record_writer->Status());
+      file->stream.flush();
+      if (!file->stream.good()) {
+        return absl::InternalError(
+            absl::StrCat("Failed to write checkpoint file of prefix '",
+                         prefix, "'"));
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  int64_t NumRecords() const { return num_records_; }
+
+ private:
+  struct CheckpointFile {
+    std::ofstream stream;
+    std::unique_ptr<DeltaRecordStreamWriter<std::ofstream>> record_writer;
+  };
+
+  static KeyValueMutationRecordT CreateMutationRecord(
+      std::string_view key, int64_t logical_commit_time, bool is_deleted) {
+    return KeyValueMutationRecordT{
+        .mutation_type = is_deleted ? KeyValueMutationType::Delete
+                                    : KeyValueMutationType::Update,
+        .logical_commit_time = logical_commit_time,
+        .key = std::string(key),
+    };
+  }
+
+  absl::StatusOr<DeltaRecordStreamWriter<std::ofstream>*> GetRecordWriter(
+      std::string_view prefix) {
+    if (!metadata_visited_) {
+      return absl::InternalError(
+          "Cache values were visited before the metadata.");
+    }
+    if (const auto file_iter = files_.find(prefix);
+        file_iter != files_.end()) {
+      return file_iter->second->record_writer.get();
+    }
+    const std::filesystem::path path = directory_ / CheckpointFileName(prefix);
+    auto file = std::make_unique<CheckpointFile>();
+    file->stream.open(path, std::ios::binary | std::ios::trunc);
+    if (!file->stream.is_open()) {
+      return absl::InternalError(
+          absl::StrCat("Failed to open ", path.string()));
+    }
+    KVFileMetadata metadata = metadata_;
+    metadata.mutable_cache_checkpoint()->set_prefix(prefix);
+    PS_ASSIGN_OR_RETURN(
+        file->record_writer,
+        DeltaRecordStreamWriter<std::ofstream>::Create(
+            file->stream,
+            DeltaRecordWriter::Options{.enable_compression = true,
+                                       .metadata = std::move(metadata)}));
+    auto* record_writer = file->record_writer.get();
+    files_.emplace(prefix, std::move(file));
+    return record_writer;
+  }
+
+  absl::Status WriteRecord(std::string_view prefix,
+                           KeyValueMutationRecordT kv_mutation_record) {
+    PS_ASSIGN_OR_RETURN(auto* record_writer, GetRecordWriter(prefix));
+    DataRecordT data_record;
+    data_record.record.Set(std::move(kv_mutation_record));
+    num_records_++;
+    return record_writer->WriteRecord(data_record);
+  }
+
+  const std::filesystem::path directory_;
+  KVFileMetadata metadata_;
+  std::optional<CodeConfig> udf_config_;
+  bool metadata_visited_ = false;
+  absl::flat_hash_map<std::string, std::unique_ptr<CheckpointFile>> files_;
+  int64_t num_records_ = 0;
+};
+
+}  // namespace
+
+CacheCheckpointer::CacheCheckpointer(
+    Options options, std::unique_ptr<PeriodicClosure> periodic_closure)
+    : options_(std::move(options)),
+      periodic_closure_(std::move(periodic_closure)) {}
+
+CacheCheckpointer::~CacheCheckpointer() { Stop(); }
+
+std::filesystem::path CacheCheckpointer::CheckpointPath() const {
+  return std::filesystem::path(options_.directory) /
+         kCacheCheckpointDirectoryName;
+}
+
+bool CacheCheckpointer::HasCheckpoint() const {
+  std::error_code error;
+  return std::filesystem::is_directory(CheckpointPath(), error);
+}
+
+std::vector<std::filesystem::path> CacheCheckpointer::CheckpointFiles() const {
+  std::vector<std::filesystem::path> files;
+  std::error_code error;
+  std::filesystem::directory_iterator file_iter(CheckpointPath(), error);
+  for (; !error && file_iter != std::filesystem::directory_iterator();
+       file_iter.increment(error)) {
+    if (file_iter->is_regular_file(error)) {
+      files.push_back(file_iter->path());
+    }
+  }
+  if (error) {
+    PS_LOG(ERROR, options_.log_context)
+        << "Failed to list cache checkpoint " << CheckpointPath() << ": "
+        << error.message();
+    return {};
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+std::unique_ptr<RecordStream> CacheCheckpointer::OpenCheckpointFile(
+    const std::filesystem::path& path) const {
+  return std::make_unique<FileRecordStream>(path);
+}
+
+void CacheCheckpointer::RemoveCheckpoint() const {
+  std::error_code error;
+  std::filesystem::remove_all(CheckpointPath(), error);
+  if (error) {
+    PS_LOG(ERROR, options_.log_context)
+        << "Failed to remove cache checkpoint " << CheckpointPath() << ": "
+        << error.message();
+  }
+}
+
+absl::StatusOr<absl::flat_hash_map<std::string, std::string>>
+CacheCheckpointer::ValidateCheckpointMetadata(
+    const KVFileMetadata& metadata,
+    const absl::flat_hash_set<std::string>& prefixes) const {
+  if (!metadata.has_cache_checkpoint()) {
+    return absl::FailedPreconditionError("File is not a cache checkpoint.");
+  }
+  const auto& checkpoint = metadata.cache_checkpoint();
+  if (checkpoint.data_bucket() != options_.data_bucket) {
+    return absl::FailedPreconditionError(
+        absl::StrCat("Checkpoint was written for bucket ",
+                     checkpoint.data_bucket(), " but server loads data from ",
+                     options_.data_bucket));
+  }
+  if (checkpoint.num_shards() != options_.num_shards ||
+      metadata.sharding_metadata().shard_num() != options_.shard_num) {
+    return absl::FailedPreconditionError(absl::StrCat(
+        "Checkpoint was written for shard ",
+        metadata.sharding_metadata().shard_num(), " of ",
+        checkpoint.num_shards(), " but server is shard ", options_.shard_num,
+        " of ", options_.num_shards));
+  }
+  if (metadata.sharding_metadata().sharding_function_fingerprint() !=
+      options_.sharding_function_fingerprint.value_or("")) {
+    return absl::FailedPreconditionError(
+        "Checkpoint was written with a different sharding function.");
+  }
+  absl::flat_hash_map<std::string, std::string> prefix_ending_delta_files(
+      checkpoint.prefix_ending_delta_files().begin(),
+      checkpoint.prefix_ending_delta_files().end());
+  if (prefix_ending_delta_files.size() != prefixes.size()) {
+    return absl::FailedPreconditionError(
+        "Checkpoint was written for different prefixes.");
+  }
+  for (const auto& prefix : prefixes) {
+    if (!prefix_ending_delta_files.contains(prefix)) {
+      return absl::FailedPreconditionError(
+          absl::StrCat("Checkpoint is missing prefix '", prefix, "'"));
+    }
+  }
+  return prefix_ending_delta_files;
+}
+
+void CacheCheckpointer::RecordDeltaFileLoaded(std::string_view prefix,
+                                              std::string_view delta_file) {
+  absl::MutexLock l(&mu_);
+  auto& ending_delta_file = prefix_ending_delta_files_[prefix];
+  if (delta_file > ending_delta_file) {
+    ending_delta_file = std::string(delta_file);
+  }
+}
+
+void CacheCheckpointer::RecordUdfConfig(CodeConfig code_config) {
+  absl::MutexLock l(&mu_);
+  if (!udf_config_.has_value() ||
+      code_config.logical_commit_time >= udf_config_->logical_commit_time) {
+    udf_config_ = std::move(code_config);
+  }
+}
+
+absl::Status CacheCheckpointer::WriteCheckpoint() {
+  absl::MutexLock write_lock(&write_mu_);
+  const absl::Time start = absl::Now();
+  // The delta files recorded so far are fully loaded into the cache before it
+  // is exported. The export may include some records from later files, which
+  // is fine since applying them again is a noop.
+  KVFileMetadata metadata;
+  std::optional<CodeConfig> udf_config;
+  {
+    absl::MutexLock l(&mu_);
+    auto* checkpoint = metadata.mutable_cache_checkpoint();
+    checkpoint->mutable_prefix_ending_delta_files()->insert(
+        prefix_ending_delta_files_.begin(), prefix_ending_delta_files_.end());
+    udf_config = udf_config_;
+  }
+  metadata.mutable_cache_checkpoint()->set_data_bucket(options_.data_bucket);
+  metadata.mutable_cache_checkpoint()->set_num_shards(options_.num_shards);
+  metadata.mutable_sharding_metadata()->set_shard_num(options_.shard_num);
+  if (options_.sharding_function_fingerprint.has_value()) {
+    metadata.mutable_sharding_metadata()->set_sharding_function_fingerprint(
+        *options_.sharding_function_fingerprint);
+  }
+  std::error_code error;
+  std::filesystem::create_directories(options_.directory, error);
+  if (error) {
+    return absl::InternalError(
+        absl::StrCat("Failed to create checkpoint directory ",
+                     options_.directory, ": ", error.message()));
+  }
+  const std::filesystem::path checkpoint_path = CheckpointPath();
+  std::filesystem::path temp_path = checkpoint_path;
+  temp_path += kTempDirectorySuffix;
+  std::filesystem::remove_all(temp_path, error);
+  if (!error) {
+    std::filesystem::create_directory(temp_path, error);
+  }
+  if (error) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to create ", temp_path.string(), ": ", error.message()));
+  }
+  int64_t num_records = 0;
+  {
+    CheckpointRecordWriter record_writer(temp_path, std::move(metadata),
+                                         std::move(udf_config));
+    PS_RETURN_IF_ERROR(options_.cache.Export(record_writer));
+    PS_RETURN_IF_ERROR(record_writer.Close());
+    num_records = record_writer.NumRecords();
+  }
+  // Directories can not be replaced atomically, so the previous checkpoint is
+  // moved out of the way first. A crash before the new one is moved in only
+  // means the next start loads from blob storage.
+  std::filesystem::path old_path = checkpoint_path;
+  old_path += kOldDirectorySuffix;
+  std::filesystem::remove_all(old_path, error);
+  if (!error && HasCheckpoint()) {
+    std::filesystem::rename(checkpoint_path, old_path, error);
+  }
+  if (!error) {
+    std::filesystem::rename(temp_path, checkpoint_path, error);
+  }
+  if (error) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to rename ", temp_path.string(), ": ", error.message()));
+  }
+  // Left for the next checkpoint to remove if this fails.
+  std::filesystem::remove_all(old_path, error);
+  PS_LOG(INFO, options_.log_context)
+      << "Wrote cache checkpoint with " << num_records << " records to "
+      << checkpoint_path << " in " << absl::Now() - start;
+  return absl::OkStatus();
+}
+
+absl::Status CacheCheckpointer::Start() {
+  PS_LOG(INFO, options_.log_context)
+      << "Writing cache checkpoints to " << options_.directory << " every "
+      << options_.interval;
+  return periodic_closure_->StartDelayed(options_.interval, [this] {
+    if (const auto status = WriteCheckpoint(); !status.ok()) {
+      PS_LOG(ERROR, options_.log_context)
+          << "Failed to write cache checkpoint: " << status;
+    }
+  });
+}
+
+void CacheCheckpointer::Stop() {
+  if (periodic_closure_->IsRunning()) {
+    periodic_closure_->Stop();
+  }
+}
+
+}  // namespace kv_server
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_DATA_LOADING_CACHE_CHECKPOINTER_H_
+#define COMPONENTS_DATA_SERVER_DATA_LOADING_CACHE_CHECKPOINTER_H_
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "components/data_server/cache/cache.h"
+#include "components/udf/code_config.h"
+#include "public/data_loading/readers/riegeli_stream_io.h"
+#include "public/data_loading/riegeli_metadata.pb.h"
+#include "src/logger/request_context_logger.h"
+#include "src/util/periodic_closure.h"
+
+namespace kv_server {
+
+// Name of the checkpoint directory in `CacheCheckpointer::Options::directory`.
+inline constexpr std::string_view kCacheCheckpointDirectoryName =
+    "CACHE_CHECKPOINT";
+
+// Writes checkpoints of the cache to local disk, so that a restarting server
+// can restore its cache from the checkpoint and only load the delta files
+// written after it, instead of loading snapshot and delta files from blob
+// storage.
+//
+// A checkpoint is a directory of riegeli files of `DataRecord`s, like snapshot
+// files, with one record per key and set values grouped by logical commit
+// time. Values are written to the file of the prefix they were last updated
+// or deleted with, and restored under that prefix, so that deleted values are
+// cleaned up with their prefix and the cache memory stats of each prefix are
+// the same after a restore. The latest UDF config is written to the file of
+// the empty prefix. The `KVFileMetadata` of every file records its prefix and
+// the last delta file loaded for each prefix. Checkpoints are written to a
+// temporary directory which then replaces the previous checkpoint, so a crash
+// while writing never leaves a partial checkpoint behind.
+//
+// This class is thread-safe.
+class CacheCheckpointer {
+ public:
+  struct Options {
+    Cache& cache;
+    // Directory on local disk the checkpoint is written to.
+    std::string directory;
+    // How often checkpoints are written once `Start` is called.
+    absl::Duration interval = absl::Minutes(10);
+    // A checkpoint is only valid for a server loading data from the same
+    // bucket into the same shard.
+    std::string data_bucket;
+    int32_t shard_num = 0;
+    int32_t num_shards = 1;
+    // See `KeySharder::GetFingerprint`.
+    std::optional<std::string> sharding_function_fingerprint = std::nullopt;
+    privacy_sandbox::server_common::log::PSLogContext& log_context;
+  };
+
+  explicit CacheCheckpointer(
+      Options options,
+      std::unique_ptr<privacy_sandbox::server_common::PeriodicClosure>
+          periodic_closure =
+              privacy_sandbox::server_common::PeriodicClosure::Create());
+  ~CacheCheckpointer();
+
+  CacheCheckpointer(const CacheCheckpointer&) = delete;
+  CacheCheckpointer& operator=(const CacheCheckpointer&) = delete;
+
+  std::filesystem::path CheckpointPath() const;
+
+  bool HasCheckpoint() const;
+
+  // Returns the files of the checkpoint, or an empty list if there is none.
+  std::vector<std::filesystem::path> CheckpointFiles() const;
+
+  // Returns a stream over `path`, one of the `CheckpointFiles`.
+  std::unique_ptr<RecordStream> OpenCheckpointFile(
+      const std::filesystem::path& path) const;
+
+  // Deletes the checkpoint, e.g., if it can not be restored.
+  void RemoveCheckpoint() const;
+
+  // Returns the last delta file loaded for each prefix if `metadata` belongs
+  // to a checkpoint written for the same data and shard as this server, with
+  // exactly the given `prefixes`. Returns a `FailedPreconditionError`
+  // describing the mismatch otherwise.
+  absl::StatusOr<absl::flat_hash_map<std::string, std::string>>
+  ValidateCheckpointMetadata(
+      const KVFileMetadata& metadata,
+      const absl::flat_hash_set<std::string>& prefixes) const;
+
+  // Records that all delta files up to `delta_file` for `prefix` are loaded
+  // into the cache.
+  void RecordDeltaFileLoaded(std::string_view prefix,
+                             std::string_view delta_file)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Records the UDF config loaded into the UDF client, so that it is restored
+  // together with the cache.
+  void RecordUdfConfig(CodeConfig code_config) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Writes a checkpoint of the cache now.
+  absl::Status WriteCheckpoint() ABSL_LOCKS_EXCLUDED(mu_, write_mu_);
+
+  // Starts writing a checkpoint every `Options::interval` in the background.
+  absl::Status Start();
+
+  // Stops writing checkpoints. Waits for a checkpoint being written, if any.
+  void Stop();
+
+ private:
+  const Options options_;
+  std::unique_ptr<privacy_sandbox::server_common::PeriodicClosure>
+      periodic_closure_;
+  // Serializes checkpoint writes.
+  absl::Mutex write_mu_;
+  mutable absl::Mutex mu_;
+  absl::flat_hash_map<std::string, std::string> prefix_ending_delta_files_
+      ABSL_GUARDED_BY(mu_);
+  std::optional<CodeConfig> udf_config_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_DATA_LOADING_CACHE_CHECKPOINTER_H_
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/data_loading/cache_checkpointer.h"
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/telemetry/server_definition.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/readers/riegeli_stream_record_reader_factory.h"
+#include "public/data_loading/record_utils.h"
+
+namespace kv_server {
+namespace {
+
+using testing::Pair;
+using testing::UnorderedElementsAre;
+
+class CacheCheckpointerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    InitMetricsContextMap();
+    directory_ =
+        std::filesystem::path(::testing::TempDir()) /
+        ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::remove_all(directory_);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory_); }
+
+  CacheCheckpointer::Options CreateOptions() {
+    return CacheCheckpointer::Options{
+        .cache = *cache_,
+        .directory = directory_.string(),
+        .data_bucket = "bucket",
+        .shard_num = 1,
+        .num_shards = 2,
+        .sharding_function_fingerprint = "fingerprint",
+        .log_context = log_context_,
+    };
+  }
+
+  std::filesystem::path directory_;
+  std::unique_ptr<Cache> cache_ = KeyValueCache::Create();
+  privacy_sandbox::server_common::log::NoOpContext log_context_;
+};
+
+TEST_F(CacheCheckpointerTest, WritesCheckpoint) {
+  cache_->UpdateKeyValue(log_context_, "key1", "value1", 1);
+  cache_->DeleteKey(log_context_, "key2", 2);
+  std::vector<uint32_t> values = {1, 2, 3};
+  cache_->UpdateKeyValueSet(log_context_, "set1", absl::MakeSpan(values), 3);
+  cache_->DeleteKey(log_context_, "key3", 4, "prefix");
+  CacheCheckpointer checkpointer(CreateOptions());
+  EXPECT_FALSE(checkpointer.HasCheckpoint());
+  checkpointer.RecordDeltaFileLoaded("", "DELTA_0000000000000002");
+  checkpointer.RecordDeltaFileLoaded("", "DELTA_0000000000000001");
+  checkpointer.RecordDeltaFileLoaded("prefix", "");
+  checkpointer.RecordUdfConfig({.js = "function hello() {}",
+                                .udf_handler_name = "hello",
+                                .logical_commit_time = 1,
+                                .version = 1});
+  ASSERT_TRUE(checkpointer.WriteCheckpoint().ok());
+  ASSERT_TRUE(checkpointer.HasCheckpoint());
+
+  RiegeliStreamRecordReaderFactory reader_factory;
+  absl::Mutex mu;
+  absl::flat_hash_map<std::string, std::vector<std::string>> prefix_keys;
+  std::string udf_handler_name;
+  for (const auto& path : checkpointer.CheckpointFiles()) {
+    auto record_reader =
+        reader_factory.CreateConcurrentReader([&checkpointer, &path]() {
+          return checkpointer.OpenCheckpointFile(path);
+        });
+    auto metadata = record_reader->GetKVFileMetadata();
+    ASSERT_TRUE(metadata.ok()) << metadata.status();
+    EXPECT_EQ(metadata->cache_checkpoint().data_bucket(), "bucket");
+    EXPECT_EQ(metadata->cache_checkpoint().num_shards(), 2);
+    EXPECT_EQ(metadata->sharding_metadata().shard_num(), 1);
+    EXPECT_EQ(metadata->sharding_metadata().sharding_function_fingerprint(),
+              "fingerprint");
+    EXPECT_THAT(metadata->cache_checkpoint().prefix_ending_delta_files(),
+                UnorderedElementsAre(Pair("", "DELTA_0000000000000002"),
+                                     Pair("prefix", "")));
+    auto& keys = prefix_keys[metadata->cache_checkpoint().prefix()];
+    auto status = record_reader->ReadStreamRecords([&](std::string_view raw) {
+      return DeserializeRecord(raw, [&](const DataRecord& data_record) {
+        absl::MutexLock l(&mu);
+        if (data_record.record_type() == Record::UserDefinedFunctionsConfig) {
+          udf_handler_name = data_record.record_as_UserDefinedFunctionsConfig()
+                                 ->handler_name()
+                                 ->str();
+        } else {
+          keys.push_back(
+              data_record.record_as_KeyValueMutationRecord()->key()->str());
+        }
+        return absl::OkStatus();
+      });
+    });
+    ASSERT_TRUE(status.ok()) << status;
+  }
+  // Deletions are written to the file of the prefix they were made with.
+  EXPECT_THAT(prefix_keys,
+              UnorderedElementsAre(
+                  Pair("", UnorderedElementsAre("key1", "key2", "set1")),
+                  Pair("prefix", UnorderedElementsAre("key3"))));
+  EXPECT_EQ(udf_handler_name, "hello");
+}
+
+TEST_F(CacheCheckpointerTest, ReplacesPreviousCheckpoint) {
+  CacheCheckpointer checkpointer(CreateOptions());
+  checkpointer.RecordDeltaFileLoaded("", "DELTA_0000000000000001");
+  ASSERT_TRUE(checkpointer.WriteCheckpoint().ok());
+  checkpointer.RecordDeltaFileLoaded("", "DELTA_0000000000000002");
+  ASSERT_TRUE(checkpointer.WriteCheckpoint().ok());
+  const auto files = checkpointer.CheckpointFiles();
+  ASSERT_EQ(files.size(), 1);
+  RiegeliStreamRecordReaderFactory reader_factory;
+  auto record_reader = reader_factory.CreateConcurrentReader(
+      [&checkpointer, &files]() {
+        return checkpointer.OpenCheckpointFile(files[0]);
+      });
+  auto metadata = record_reader->GetKVFileMetadata();
+  ASSERT_TRUE(metadata.ok()) << metadata.status();
+  auto prefix_ending_delta_files = checkpointer.ValidateCheckpointMetadata(
+      *metadata, /*prefixes=*/{""});
+  ASSERT_TRUE(prefix_ending_delta_files.ok());
+  EXPECT_THAT(*prefix_ending_delta_files,
+              UnorderedElementsAre(Pair("", "DELTA_0000000000000002")));
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(directory_),
+                          std::filesystem::directory_iterator()),
+            1);
+  checkpointer.RemoveCheckpoint();
+  EXPECT_FALSE(checkpointer.HasCheckpoint());
+  EXPECT_TRUE(checkpointer.CheckpointFiles().empty());
+}
+
+TEST_F(CacheCheckpointerTest, ValidateCheckpointMetadata) {
+  CacheCheckpointer checkpointer(CreateOptions());
+  KVFileMetadata metadata;
+  metadata.mutable_sharding_metadata()->set_shard_num(1);
+  metadata.mutable_sharding_metadata()->set_sharding_function_fingerprint(
+      "fingerprint");
+  auto* checkpoint = metadata.mutable_cache_checkpoint();
+  checkpoint->set_data_bucket("bucket");
+  checkpoint->set_num_shards(2);
+  (*checkpoint->mutable_prefix_ending_delta_files())[""] =
+      "DELTA_0000000000000001";
+  (*checkpoint->mutable_prefix_ending_delta_files())["prefix"] = "";
+  auto prefix_ending_delta_files =
+      checkpointer.ValidateCheckpointMetadata(metadata, {"", "prefix"});
+  ASSERT_TRUE(prefix_ending_delta_files.ok());
+  EXPECT_THAT(*prefix_ending_delta_files,
+              UnorderedElementsAre(Pair("", "DELTA_0000000000000001"),
+                                   Pair("prefix", "")));
+
+  EXPECT_EQ(checkpointer.ValidateCheckpointMetadata(metadata, {""})
+                .status()
+                .code(),
+            absl::StatusCode::kFailedPrecondition);
+  EXPECT_EQ(checkpointer.ValidateCheckpointMetadata(metadata, {"", "other"})
+                .status()
+                .code(),
+            absl::StatusCode::kFailedPrecondition);
+  for (auto mismatch :
+       std::vector<std::function<void(KVFileMetadata&)>>{
+           [](KVFileMetadata& m) {
+             m.mutable_cache_checkpoint()->set_data_bucket("other");
+           },
+           [](KVFileMetadata& m) {
+             m.mutable_cache_checkpoint()->set_num_shards(3);
+           },
+           [](KVFileMetadata& m) {
+             m.mutable_sharding_metadata()->set_shard_num(0);
+           },
+           [](KVFileMetadata& m) {
+             m.mutable_sharding_metadata()->set_sharding_function_fingerprint(
+                 "other");
+           },
+           [](KVFileMetadata& m) { m.clear_cache_checkpoint(); },
+       }) {
+    KVFileMetadata mismatched_metadata = metadata;
+    mismatch(mismatched_metadata);
+    EXPECT_EQ(checkpointer
+                  .ValidateCheckpointMetadata(mismatched_metadata,
+                                              {"", "prefix"})
+                  .status()
+                  .code(),
+              absl::StatusCode::kFailedPrecondition);
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/data_loading/data_loading_progress.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+#include "components/telemetry/server_definition.h"
+
+namespace kv_server {
+namespace {
+
+constexpr std::string_view kAllPrefixesPolicy = "all_prefixes";
+constexpr std::string_view kCriticalPrefixesPolicy = "critical_prefixes";
+
+}  // namespace
+
+absl::StatusOr<ReadinessPolicy> ParseReadinessPolicy(std::string_view policy) {
+  if (policy == kAllPrefixesPolicy) {
+    return ReadinessPolicy::kAllPrefixes;
+  }
+  if (policy == kCriticalPrefixesPolicy) {
+    return ReadinessPolicy::kCriticalPrefixes;
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("Unknown readiness policy: ", policy));
+}
+
+std::string_view ReadinessPolicyName(ReadinessPolicy policy) {
+  switch (policy) {
+    case ReadinessPolicy::kAllPrefixes:
+      return kAllPrefixesPolicy;
+    case ReadinessPolicy::kCriticalPrefixes:
+      return kCriticalPrefixesPolicy;
+  }
+  return "unknown";
+}
+
+std::string_view DataLoadingPhaseName(DataLoadingPhase phase) {
+  switch (phase) {
+    case DataLoadingPhase::kPending:
+      return "pending";
+    case DataLoadingPhase::kLoadingSnapshots:
+      return "loading_snapshots";
+    case DataLoadingPhase::kLoadingDeltas:
+      return "loading_deltas";
+    case DataLoadingPhase::kDone:
+      return "done";
+  }
+  return "unknown";
+}
+
+double PrefixLoadingProgress::RecordsPerSecond() const {
+  const double seconds = absl::ToDoubleSeconds(loading_duration);
+  return seconds > 0 ? static_cast<double>(records_loaded) / seconds : 0;
+}
+
+DataLoadingProgress::DataLoadingProgress(
+    const absl::flat_hash_set<std::string>& prefixes, ReadinessPolicy policy,
+    const absl::flat_hash_set<std::string>& critical_prefixes)
+    : policy_(policy) {
+  for (const auto& prefix : prefixes) {
+    if (critical_prefixes.contains(prefix)) {
+      critical_prefixes_.push_back(prefix);
+    } else {
+      other_prefixes_.push_back(prefix);
+    }
+    progress_[prefix] = PrefixLoadingProgress{};
+  }
+  std::sort(critical_prefixes_.begin(), critical_prefixes_.end());
+  std::sort(other_prefixes_.begin(), other_prefixes_.end());
+}
+
+std::vector<std::string> DataLoadingProgress::PrefixesInLoadingOrder() const {
+  std::vector<std::string> prefixes = critical_prefixes_;
+  prefixes.insert(prefixes.end(), other_prefixes_.begin(),
+                  other_prefixes_.end());
+  return prefixes;
+}
+
+std::vector<std::string> DataLoadingProgress::PrefixesRequiredForReadiness()
+    const {
+  if (policy_ == ReadinessPolicy::kCriticalPrefixes) {
+    return critical_prefixes_;
+  }
+  return PrefixesInLoadingOrder();
+}
+
+void DataLoadingProgress::SetPhase(std::string_view prefix,
+                                   DataLoadingPhase phase) {
+  absl::MutexLock l(&mu_);
+  progress_[prefix].phase = phase;
+}
+
+void DataLoadingProgress::RecordFileLoaded(std::string_view prefix,
+                                           int64_t num_records,
+                                           absl::Duration duration) {
+  {
+    absl::MutexLock l(&mu_);
+    auto& progress = progress_[prefix];
+    progress.files_loaded++;
+    progress.records_loaded += num_records;
+    progress.loading_duration += duration;
+  }
+  const double seconds = absl::ToDoubleSeconds(duration);
+  if (seconds > 0) {
+    LogIfError(KVServerContextMap()
+                   ->SafeMetric()
+                   .LogHistogram<kDataLoadingRecordsPerSecond>(
+                       static_cast<double>(num_records) / seconds));
+  }
+}
+
+bool DataLoadingProgress::AllDone(
+    const std::vector<std::string>& prefixes) const {
+  return std::all_of(prefixes.begin(), prefixes.end(),
+                     [this](const std::string& prefix) {
+                       auto it = progress_.find(prefix);
+                       return it != progress_.end() &&
+                              it->second.phase == DataLoadingPhase::kDone;
+                     });
+}
+
+bool DataLoadingProgress::IsReady() const {
+  const auto required_prefixes = PrefixesRequiredForReadiness();
+  absl::ReaderMutexLock l(&mu_);
+  return AllDone(required_prefixes);
+}
+
+bool DataLoadingProgress::IsComplete() const {
+  const auto prefixes = PrefixesInLoadingOrder();
+  absl::ReaderMutexLock l(&mu_);
+  return AllDone(prefixes);
+}
+
+absl::flat_hash_map<std::string, PrefixLoadingProgress>
+DataLoadingProgress::GetProgress() const {
+  absl::ReaderMutexLock l(&mu_);
+  return progress_;
+}
+
+}  // namespace kv_server
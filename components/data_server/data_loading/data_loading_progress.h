@@ -0,0 +1,125 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_DATA_LOADING_DATA_LOADING_PROGRESS_H_
+#define COMPONENTS_DATA_SERVER_DATA_LOADING_DATA_LOADING_PROGRESS_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace kv_server {
+
+// Phases a blob prefix goes through during the initial data load.
+enum class DataLoadingPhase {
+  kPending,
+  kLoadingSnapshots,
+  kLoadingDeltas,
+  kDone,
+};
+
+// Controls when the server is ready to serve during the initial data load.
+enum class ReadinessPolicy {
+  // Ready once snapshot and delta files for all prefixes are loaded.
+  kAllPrefixes,
+  // Ready once snapshot and delta files for critical prefixes are loaded. The
+  // remaining prefixes are loaded in the background while serving.
+  kCriticalPrefixes,
+};
+
+// Parses "all_prefixes" or "critical_prefixes" into a `ReadinessPolicy`.
+absl::StatusOr<ReadinessPolicy> ParseReadinessPolicy(std::string_view policy);
+
+std::string_view ReadinessPolicyName(ReadinessPolicy policy);
+
+std::string_view DataLoadingPhaseName(DataLoadingPhase phase);
+
+struct PrefixLoadingProgress {
+  DataLoadingPhase phase = DataLoadingPhase::kPending;
+  int64_t files_loaded = 0;
+  int64_t records_loaded = 0;
+  // Time spent loading files for the prefix.
+  absl::Duration loading_duration = absl::ZeroDuration();
+
+  // Returns the ingestion rate of the prefix so far.
+  double RecordsPerSecond() const;
+};
+
+// Tracks per-prefix progress of the initial data load and decides, based on
+// the readiness policy, when the server can start serving.
+//
+// This class is thread-safe.
+class DataLoadingProgress {
+ public:
+  // `prefixes` are all the prefixes to be loaded. Critical prefixes not in
+  // `prefixes` are ignored.
+  DataLoadingProgress(
+      const absl::flat_hash_set<std::string>& prefixes, ReadinessPolicy policy,
+      const absl::flat_hash_set<std::string>& critical_prefixes);
+
+  DataLoadingProgress(const DataLoadingProgress&) = delete;
+  DataLoadingProgress& operator=(const DataLoadingProgress&) = delete;
+
+  ReadinessPolicy Policy() const { return policy_; }
+
+  // Returns the prefixes in the order they should be loaded, i.e., critical
+  // prefixes first. Prefixes are sorted within each group.
+  std::vector<std::string> PrefixesInLoadingOrder() const;
+
+  // Returns the prefixes that must be loaded before the server is ready, in
+  // loading order.
+  std::vector<std::string> PrefixesRequiredForReadiness() const;
+
+  void SetPhase(std::string_view prefix, DataLoadingPhase phase)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Records that a file with `num_records` records was loaded for `prefix` in
+  // `duration`.
+  void RecordFileLoaded(std::string_view prefix, int64_t num_records,
+                        absl::Duration duration) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns true once the prefixes required by the readiness policy are
+  // loaded.
+  bool IsReady() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns true once all prefixes are loaded.
+  bool IsComplete() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::flat_hash_map<std::string, PrefixLoadingProgress> GetProgress() const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  bool AllDone(const std::vector<std::string>& prefixes) const
+      ABSL_SHARED_LOCKS_REQUIRED(mu_);
+
+  const ReadinessPolicy policy_;
+  // Both lists are immutable after construction.
+  std::vector<std::string> critical_prefixes_;
+  std::vector<std::string> other_prefixes_;
+  mutable absl::Mutex mu_;
+  absl::flat_hash_map<std::string, PrefixLoadingProgress> progress_
+      ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_DATA_LOADING_DATA_LOADING_PROGRESS_H_
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/data_loading/data_loading_progress.h"
+
+#include "components/telemetry/server_definition.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+
+class DataLoadingProgressTest : public ::testing::Test {
+ protected:
+  void SetUp() override { InitMetricsContextMap(); }
+};
+
+TEST_F(DataLoadingProgressTest, ParseReadinessPolicy) {
+  EXPECT_EQ(ParseReadinessPolicy("all_prefixes").value(),
+            ReadinessPolicy::kAllPrefixes);
+  EXPECT_EQ(ParseReadinessPolicy("critical_prefixes").value(),
+            ReadinessPolicy::kCriticalPrefixes);
+  EXPECT_EQ(ParseReadinessPolicy("invalid").status().code(),
+            absl::StatusCode::kInvalidArgument);
+  for (auto policy :
+       {ReadinessPolicy::kAllPrefixes, ReadinessPolicy::kCriticalPrefixes}) {
+    EXPECT_EQ(ParseReadinessPolicy(ReadinessPolicyName(policy)).value(),
+              policy);
+  }
+}
+
+TEST_F(DataLoadingProgressTest, CriticalPrefixesAreLoadedFirst) {
+  DataLoadingProgress progress({"", "b", "c", "d"},
+                               ReadinessPolicy::kAllPrefixes, {"", "c"});
+  EXPECT_THAT(progress.PrefixesInLoadingOrder(),
+              ElementsAre("", "c", "b", "d"));
+  EXPECT_THAT(progress.PrefixesRequiredForReadiness(),
+              ElementsAre("", "c", "b", "d"));
+}
+
+TEST_F(DataLoadingProgressTest, IgnoresCriticalPrefixesNotLoaded) {
+  DataLoadingProgress progress({"", "b"}, ReadinessPolicy::kCriticalPrefixes,
+                               {"b", "unknown"});
+  EXPECT_THAT(progress.PrefixesInLoadingOrder(), ElementsAre("b", ""));
+  EXPECT_THAT(progress.PrefixesRequiredForReadiness(), ElementsAre("b"));
+  EXPECT_FALSE(progress.GetProgress().contains("unknown"));
+}
+
+TEST_F(DataLoadingProgressTest, AllPrefixesPolicyIsReadyWhenComplete) {
+  DataLoadingProgress progress({"", "b"}, ReadinessPolicy::kAllPrefixes, {""});
+  EXPECT_FALSE(progress.IsReady());
+  progress.SetPhase("", DataLoadingPhase::kDone);
+  EXPECT_FALSE(progress.IsReady());
+  progress.SetPhase("b", DataLoadingPhase::kLoadingDeltas);
+  EXPECT_FALSE(progress.IsReady());
+  progress.SetPhase("b", DataLoadingPhase::kDone);
+  EXPECT_TRUE(progress.IsReady());
+  EXPECT_TRUE(progress.IsComplete());
+}
+
+TEST_F(DataLoadingProgressTest, CriticalPrefixesPolicyIsReadyBeforeComplete) {
+  DataLoadingProgress progress({"", "b"}, ReadinessPolicy::kCriticalPrefixes,
+                               {""});
+  EXPECT_FALSE(progress.IsReady());
+  progress.SetPhase("", DataLoadingPhase::kLoadingSnapshots);
+  EXPECT_FALSE(progress.IsReady());
+  progress.SetPhase("", DataLoadingPhase::kDone);
+  EXPECT_TRUE(progress.IsReady());
+  EXPECT_FALSE(progress.IsComplete());
+  progress.SetPhase("b", DataLoadingPhase::kDone);
+  EXPECT_TRUE(progress.IsComplete());
+}
+
+TEST_F(DataLoadingProgressTest, RecordFileLoaded) {
+  DataLoadingProgress progress({"", "b"}, ReadinessPolicy::kAllPrefixes, {});
+  progress.RecordFileLoaded("b", 100, absl::Seconds(1));
+  progress.RecordFileLoaded("b", 300, absl::Seconds(1));
+  const auto prefix_progress = progress.GetProgress();
+  EXPECT_EQ(prefix_progress.at("").files_loaded, 0);
+  EXPECT_EQ(prefix_progress.at("").RecordsPerSecond(), 0);
+  EXPECT_EQ(prefix_progress.at("b").files_loaded, 2);
+  EXPECT_EQ(prefix_progress.at("b").records_loaded, 400);
+  EXPECT_EQ(prefix_progress.at("b").loading_duration, absl::Seconds(2));
+  EXPECT_DOUBLE_EQ(prefix_progress.at("b").RecordsPerSecond(), 200);
+}
+
+}  // namespace
+}  // namespace kv_server
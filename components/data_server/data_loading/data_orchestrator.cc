@@ -17,6 +17,10 @@
 
 #include <algorithm>
 #include <deque>
+#include <memory>
+#include <optional>
+#include <istream>
+#include <streambuf>
 #include <utility>
 #include <vector>
 
@@ -24,8 +28,10 @@
 #include "absl/functional/bind_front.h"
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 #include "components/data/file_group/file_group_search_utils.h"
 #include "components/errors/error_tag.h"
+#include "components/telemetry/server_definition.h"
 #include "public/constants.h"
 #include "public/data_loading/data_loading_generated.h"
 #include "public/data_loading/filename_utils.h"
@@ -47,10 +53,43 @@ enum class ErrorTag : int {
 //  for file updates.
 constexpr std::string_view kDefaultPrefixForRealTimeUpdates = "";
 constexpr std::string_view kDefaultDataSourceForRealtimeUpdates = "realtime";
+constexpr std::string_view kDataSourceForCacheCheckpoint = "cache_checkpoint";
 
 using ::privacy_sandbox::server_common::RetryUntilOk;
 using privacy_sandbox::server_common::TraceWithStatusOr;
 
+// Reads a string in place, unlike `std::istringstream`, which copies it. The
+// string must outlive the reads.
+class StringViewStreambuf : public std::streambuf {
+ public:
+  void Reset(std::string_view data) {
+    char* begin = const_cast<char*>(data.data());
+    setg(begin, begin, begin + data.size());
+  }
+
+ protected:
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override {
+    off_type base = 0;
+    if (dir == std::ios_base::cur) {
+      base = gptr() - eback();
+    } else if (dir == std::ios_base::end) {
+      base = egptr() - eback();
+    }
+    return seekpos(pos_type(base + off), which);
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+    const off_type offset = pos;
+    if (!(which & std::ios_base::in) || offset < 0 ||
+        offset > egptr() - eback()) {
+      return pos_type(off_type(-1));
+    }
+    setg(eback(), eback() + offset, egptr());
+    return pos;
+  }
+};
+
 // Holds an input stream pointing to a blob of Riegeli records.
 class BlobRecordStream : public RecordStream {
  public:
@@ -84,38 +123,48 @@ void LogDataLoadingMetrics(std::string_view source,
                            data_loading_stats.total_dropped_records)}}));
 }
 
+// If `string_value_batch` is set, string value mutations are added to it
+// instead of being applied to the cache right away.
 absl::Status ApplyUpdateMutation(
     std::string_view prefix, const KeyValueMutationRecord& record, Cache& cache,
-    privacy_sandbox::server_common::log::PSLogContext& log_context) {
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    KeyValueMutationBatch* string_value_batch) {
   if (record.value_type() == Value::StringValue) {
     PS_ASSIGN_OR_RETURN(auto value,
                         MaybeGetRecordValue<std::string_view>(record));
+    if (string_value_batch != nullptr) {
+      string_value_batch->Add(record.key()->string_view(), value,
+                              record.logical_commit_time(),
+                              /*is_deletion=*/false);
+      return absl::OkStatus();
+    }
     cache.UpdateKeyValue(log_context, record.key()->string_view(), value,
                          record.logical_commit_time(), prefix);
     return absl::OkStatus();
   }
+  // Set values are passed to the cache as views over the record's flatbuffer
+  // vectors to avoid copying them into intermediate vectors.
   if (record.value_type() == Value::StringSet) {
     PS_ASSIGN_OR_RETURN(
-        auto values,
-        MaybeGetRecordValue<std::vector<std::string_view>>(record));
-    cache.UpdateKeyValueSet(log_context, record.key()->string_view(),
-                            absl::MakeSpan(values),
+        const auto* values,
+        MaybeGetRecordValue<const FlatbufferStringVector*>(record));
+    cache.UpdateKeyValueSet(log_context, record.key()->string_view(), *values,
                             record.logical_commit_time(), prefix);
     return absl::OkStatus();
   }
   if (record.value_type() == Value::UInt32Set) {
-    PS_ASSIGN_OR_RETURN(auto values,
-                        MaybeGetRecordValue<std::vector<uint32_t>>(record));
-    cache.UpdateKeyValueSet(log_context, record.key()->string_view(),
-                            absl::MakeSpan(values),
+    PS_ASSIGN_OR_RETURN(
+        const auto* values,
+        MaybeGetRecordValue<const flatbuffers::Vector<uint32_t>*>(record));
+    cache.UpdateKeyValueSet(log_context, record.key()->string_view(), *values,
                             record.logical_commit_time(), prefix);
     return absl::OkStatus();
   }
   if (record.value_type() == Value::UInt64Set) {
-    PS_ASSIGN_OR_RETURN(auto values,
-                        MaybeGetRecordValue<std::vector<uint64_t>>(record));
-    cache.UpdateKeyValueSet(log_context, record.key()->string_view(),
-                            absl::MakeSpan(values),
+    PS_ASSIGN_OR_RETURN(
+        const auto* values,
+        MaybeGetRecordValue<const flatbuffers::Vector<uint64_t>*>(record));
+    cache.UpdateKeyValueSet(log_context, record.key()->string_view(), *values,
                             record.logical_commit_time(), prefix);
     return absl::OkStatus();
   }
@@ -126,34 +175,40 @@ absl::Status ApplyUpdateMutation(
 
 absl::Status ApplyDeleteMutation(
     std::string_view prefix, const KeyValueMutationRecord& record, Cache& cache,
-    privacy_sandbox::server_common::log::PSLogContext& log_context) {
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    KeyValueMutationBatch* string_value_batch) {
   if (record.value_type() == Value::StringValue) {
+    if (string_value_batch != nullptr) {
+      string_value_batch->Add(record.key()->string_view(), /*value=*/"",
+                              record.logical_commit_time(),
+                              /*is_deletion=*/true);
+      return absl::OkStatus();
+    }
     cache.DeleteKey(log_context, record.key()->string_view(),
                     record.logical_commit_time(), prefix);
     return absl::OkStatus();
   }
   if (record.value_type() == Value::StringSet) {
     PS_ASSIGN_OR_RETURN(
-        auto values,
-        MaybeGetRecordValue<std::vector<std::string_view>>(record));
-    cache.DeleteValuesInSet(log_context, record.key()->string_view(),
-                            absl::MakeSpan(values),
+        const auto* values,
+        MaybeGetRecordValue<const FlatbufferStringVector*>(record));
+    cache.DeleteValuesInSet(log_context, record.key()->string_view(), *values,
                             record.logical_commit_time(), prefix);
     return absl::OkStatus();
   }
   if (record.value_type() == Value::UInt32Set) {
-    PS_ASSIGN_OR_RETURN(auto values,
-                        MaybeGetRecordValue<std::vector<uint32_t>>(record));
-    cache.DeleteValuesInSet(log_context, record.key()->string_view(),
-                            absl::MakeSpan(values),
+    PS_ASSIGN_OR_RETURN(
+        const auto* values,
+        MaybeGetRecordValue<const flatbuffers::Vector<uint32_t>*>(record));
+    cache.DeleteValuesInSet(log_context, record.key()->string_view(), *values,
                             record.logical_commit_time(), prefix);
     return absl::OkStatus();
   }
   if (record.value_type() == Value::UInt64Set) {
-    PS_ASSIGN_OR_RETURN(auto values,
-                        MaybeGetRecordValue<std::vector<uint64_t>>(record));
-    cache.DeleteValuesInSet(log_context, record.key()->string_view(),
-                            absl::MakeSpan(values),
+    PS_ASSIGN_OR_RETURN(
+        const auto* values,
+        MaybeGetRecordValue<const flatbuffers::Vector<uint64_t>*>(record));
+    cache.DeleteValuesInSet(log_context, record.key()->string_view(), *values,
                             record.logical_commit_time(), prefix);
     return absl::OkStatus();
   }
@@ -203,13 +258,34 @@ bool ShouldProcessRecord(
   return false;
 }
 
+// Returns true if every record in the file described by `metadata` is known to
+// belong to this server's shard, i.e., the file was written for this shard
+// using the same sharding function as the server's `key_sharder`.
+bool IsPreshardedForServer(const KVFileMetadata& metadata,
+                           const DataOrchestrator::Options& options) {
+  if (options.num_shards <= 1 || !metadata.has_sharding_metadata()) {
+    return false;
+  }
+  const auto& sharding_metadata = metadata.sharding_metadata();
+  if (sharding_metadata.shard_num() != options.shard_num ||
+      !sharding_metadata.has_sharding_function_fingerprint()) {
+    return false;
+  }
+  const auto fingerprint =
+      options.key_sharder.GetFingerprint(options.num_shards);
+  return fingerprint.has_value() &&
+         *fingerprint == sharding_metadata.sharding_function_fingerprint();
+}
+
 absl::Status ApplyKeyValueMutationToCache(
     std::string_view prefix, const KeyValueMutationRecord& record, Cache& cache,
     int64_t& max_timestamp, DataLoadingStats& data_loading_stats,
-    privacy_sandbox::server_common::log::PSLogContext& log_context) {
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    KeyValueMutationBatch* string_value_batch = nullptr) {
   switch (record.mutation_type()) {
     case KeyValueMutationType::Update: {
-      if (auto status = ApplyUpdateMutation(prefix, record, cache, log_context);
+      if (auto status = ApplyUpdateMutation(prefix, record, cache, log_context,
+                                            string_value_batch);
           !status.ok()) {
         return status;
       }
@@ -218,7 +294,8 @@ absl::Status ApplyKeyValueMutationToCache(
       break;
     }
     case KeyValueMutationType::Delete: {
-      if (auto status = ApplyDeleteMutation(prefix, record, cache, log_context);
+      if (auto status = ApplyDeleteMutation(prefix, record, cache, log_context,
+                                            string_value_batch);
           !status.ok()) {
         return status;
       }
@@ -239,23 +316,31 @@ absl::StatusOr<DataLoadingStats> LoadCacheWithData(
     StreamRecordReader& record_reader, Cache& cache, int64_t& max_timestamp,
     const int32_t server_shard_num, const int32_t num_shards,
     UdfClient& udf_client, const KeySharder& key_sharder,
-    privacy_sandbox::server_common::log::PSLogContext& log_context) {
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    bool is_presharded = false,
+    CacheCheckpointer* cache_checkpointer = nullptr,
+    KeyValueMutationBatch* string_value_batch = nullptr) {
   DataLoadingStats data_loading_stats;
   const auto process_data_record_fn = [prefix, &cache, &max_timestamp,
                                        &data_loading_stats, server_shard_num,
                                        num_shards, &udf_client, &key_sharder,
-                                       &log_context](
+                                       &log_context, is_presharded,
+                                       cache_checkpointer, string_value_batch](
                                           const DataRecord& data_record) {
     if (data_record.record_type() == Record::KeyValueMutationRecord) {
       const auto* record = data_record.record_as_KeyValueMutationRecord();
-      if (!ShouldProcessRecord(*record, num_shards, server_shard_num,
+      // Records from pre-sharded files are known to belong to this shard, so
+      // there is no need to hash every key.
+      if (!is_presharded &&
+          !ShouldProcessRecord(*record, num_shards, server_shard_num,
                                key_sharder, data_loading_stats, log_context)) {
         // NOTE: currently upstream logic retries on non-ok status
         // this will get us in a loop
         return absl::OkStatus();
       }
       return ApplyKeyValueMutationToCache(prefix, *record, cache, max_timestamp,
-                                          data_loading_stats, log_context);
+                                          data_loading_stats, log_context,
+                                          string_value_batch);
     } else if (data_record.record_type() ==
                Record::UserDefinedFunctionsConfig) {
       const auto* udf_config =
@@ -264,8 +349,12 @@ absl::StatusOr<DataLoadingStats> LoadCacheWithData(
           << "Setting UDF code snippet for version: " << udf_config->version()
           << ", handler: " << udf_config->handler_name()->str()
           << ", code length: " << udf_config->code_snippet()->str().size();
-      return udf_client.SetCodeObject(BuildCodeConfig(*udf_config, log_context),
-                                      log_context);
+      auto code_config = BuildCodeConfig(*udf_config, log_context);
+      PS_RETURN_IF_ERROR(udf_client.SetCodeObject(code_config, log_context));
+      if (cache_checkpointer != nullptr) {
+        cache_checkpointer->RecordUdfConfig(std::move(code_config));
+      }
+      return absl::OkStatus();
     }
     return StatusWithErrorTag(
         absl::InvalidArgumentError(
@@ -310,6 +399,12 @@ absl::StatusOr<DataLoadingStats> LoadCacheWithDataFromFile(
         .total_dropped_records = 0,
     };
   }
+  const bool is_presharded = IsPreshardedForServer(metadata, options);
+  if (is_presharded) {
+    PS_VLOG(2, options.log_context)
+        << "Blob " << location << " is pre-sharded for shard num "
+        << options.shard_num << ". Skipping per-record shard checks.";
+  }
   std::string file_name =
       location.prefix.empty()
           ? location.key
@@ -319,7 +414,8 @@ absl::StatusOr<DataLoadingStats> LoadCacheWithDataFromFile(
       LoadCacheWithData(file_name, location.prefix, *record_reader, cache,
                         max_timestamp, options.shard_num, options.num_shards,
                         options.udf_client, options.key_sharder,
-                        options.log_context),
+                        options.log_context, is_presharded,
+                        options.cache_checkpointer),
       _ << "Blob: " << location);
   cache.RemoveDeletedKeys(options.log_context, max_timestamp, location.prefix);
   return data_loading_stats;
@@ -338,6 +434,176 @@ absl::StatusOr<DataLoadingStats> TraceLoadCacheWithDataFromFile(
        {"key", std::move(location.key)}});
 }
 
+// Loads the file at `location` and records its ingestion rate in `progress`.
+absl::Status LoadFileAndTrackProgress(BlobStorageClient::DataLocation location,
+                                      const DataOrchestrator::Options& options,
+                                      DataLoadingProgress& progress) {
+  const std::string prefix = location.prefix;
+  const absl::Time start = absl::Now();
+  PS_ASSIGN_OR_RETURN(auto data_loading_stats,
+                      TraceLoadCacheWithDataFromFile(std::move(location),
+                                                     options));
+  progress.RecordFileLoaded(prefix,
+                            data_loading_stats.total_updated_records +
+                                data_loading_stats.total_deleted_records,
+                            absl::Now() - start);
+  return absl::OkStatus();
+}
+
+// Calls `options.on_initial_load_complete`, if set, once all prefixes are
+// loaded.
+void NotifyInitialLoadComplete(const DataOrchestrator::Options& options,
+                               const DataLoadingProgress& loading_progress) {
+  if (!loading_progress.IsComplete()) {
+    return;
+  }
+  PS_LOG(INFO, options.log_context) << "Initial data load is complete";
+  if (options.on_initial_load_complete) {
+    options.on_initial_load_complete();
+  }
+}
+
+// Returns the latest delta file included in the most recent complete snapshot
+// file group of `prefix`, or nullopt if `prefix` has no snapshot.
+absl::StatusOr<std::optional<std::string>> FindSnapshotEndingDeltaFile(
+    const DataOrchestrator::Options& options, const std::string& prefix) {
+  auto location = BlobStorageClient::DataLocation{
+      .bucket = options.data_bucket, .prefix = prefix};
+  PS_ASSIGN_OR_RETURN(
+      auto snapshot_group,
+      FindMostRecentFileGroup(
+          location,
+          FileGroupFilter{.file_type = FileType::SNAPSHOT,
+                          .status = FileGroup::FileStatus::kComplete},
+          options.blob_client));
+  if (!snapshot_group.has_value() || snapshot_group->Filenames().empty()) {
+    return std::nullopt;
+  }
+  location.key = *snapshot_group->Filenames().begin();
+  auto record_reader =
+      options.delta_stream_reader_factory.CreateConcurrentReader(
+          /*stream_factory=*/[&location, &options]() {
+            return std::make_unique<BlobRecordStream>(
+                options.blob_client.GetBlobReader(location));
+          });
+  PS_ASSIGN_OR_RETURN(auto metadata, record_reader->GetKVFileMetadata(),
+                      _ << "Blob " << location);
+  return metadata.snapshot().ending_delta_file();
+}
+
+// Restores the cache from the checkpoint of `options.cache_checkpointer`, if
+// there is one written for the allowlisted prefixes that is not older than
+// their most recent snapshots. Returns the last delta file included in the
+// checkpoint for each prefix, or nullopt if the cache was not restored.
+absl::StatusOr<std::optional<absl::flat_hash_map<std::string, std::string>>>
+MaybeRestoreCacheCheckpoint(const DataOrchestrator::Options& options) {
+  CacheCheckpointer* cache_checkpointer = options.cache_checkpointer;
+  if (cache_checkpointer == nullptr || !cache_checkpointer->HasCheckpoint()) {
+    return std::nullopt;
+  }
+  const auto checkpoint_path = cache_checkpointer->CheckpointPath();
+  struct CheckpointFile {
+    std::string prefix;
+    std::unique_ptr<StreamRecordReader> record_reader;
+  };
+  std::vector<CheckpointFile> checkpoint_files;
+  // All files of a checkpoint share their metadata except for the prefix.
+  std::optional<KVFileMetadata> metadata;
+  absl::StatusOr<absl::flat_hash_map<std::string, std::string>>
+      prefix_ending_delta_files;
+  for (auto& path : cache_checkpointer->CheckpointFiles()) {
+    auto record_reader =
+        options.delta_stream_reader_factory.CreateConcurrentReader(
+            /*stream_factory=*/[cache_checkpointer, path]() {
+              return cache_checkpointer->OpenCheckpointFile(path);
+            });
+    auto file_metadata = record_reader->GetKVFileMetadata();
+    if (!file_metadata.ok()) {
+      PS_LOG(WARNING, options.log_context)
+          << "Failed to read cache checkpoint file " << path << ": "
+          << file_metadata.status();
+      return std::nullopt;
+    }
+    prefix_ending_delta_files = cache_checkpointer->ValidateCheckpointMetadata(
+        *file_metadata, options.blob_prefix_allowlist.Prefixes());
+    if (!prefix_ending_delta_files.ok()) {
+      PS_LOG(INFO, options.log_context)
+          << "Not restoring cache checkpoint " << checkpoint_path << ": "
+          << prefix_ending_delta_files.status();
+      return std::nullopt;
+    }
+    checkpoint_files.push_back(
+        {.prefix = file_metadata->cache_checkpoint().prefix(),
+         .record_reader = std::move(record_reader)});
+    metadata = *std::move(file_metadata);
+  }
+  if (!metadata.has_value()) {
+    PS_LOG(WARNING, options.log_context)
+        << "Cache checkpoint " << checkpoint_path << " has no files";
+    return std::nullopt;
+  }
+  // Delta files included in a newer snapshot may have been deleted, so the
+  // checkpoint can only be restored if it includes the latest snapshots.
+  for (const auto& [prefix, ending_delta_file] : *prefix_ending_delta_files) {
+    PS_ASSIGN_OR_RETURN(auto snapshot_ending_delta_file,
+                        FindSnapshotEndingDeltaFile(options, prefix));
+    if (snapshot_ending_delta_file.has_value() &&
+        *snapshot_ending_delta_file > ending_delta_file) {
+      PS_LOG(INFO, options.log_context)
+          << "Not restoring cache checkpoint " << checkpoint_path
+          << ": prefix '" << prefix << "' has a snapshot up to "
+          << *snapshot_ending_delta_file << " but the checkpoint only has "
+          << "data up to '" << ending_delta_file << "'";
+      return std::nullopt;
+    }
+  }
+  PS_LOG(INFO, options.log_context)
+      << "Restoring cache from checkpoint " << checkpoint_path;
+  const absl::Time start = absl::Now();
+  DataLoadingStats data_loading_stats;
+  for (auto& checkpoint_file : checkpoint_files) {
+    int64_t max_timestamp = 0;
+    // The checkpoint only has records of this server's shard. Records are
+    // loaded under the prefix of their file, i.e., the prefix they were last
+    // updated or deleted with.
+    auto file_data_loading_stats = LoadCacheWithData(
+        kDataSourceForCacheCheckpoint, checkpoint_file.prefix,
+        *checkpoint_file.record_reader, options.cache, max_timestamp,
+        options.shard_num, options.num_shards, options.udf_client,
+        options.key_sharder, options.log_context, /*is_presharded=*/true,
+        cache_checkpointer);
+    if (!file_data_loading_stats.ok()) {
+      // The cache may be partially restored at this point. Remove the
+      // checkpoint so that the next attempt falls back to loading from blob
+      // storage.
+      cache_checkpointer->RemoveCheckpoint();
+      return file_data_loading_stats.status();
+    }
+    data_loading_stats.total_updated_records +=
+        file_data_loading_stats->total_updated_records;
+    data_loading_stats.total_deleted_records +=
+        file_data_loading_stats->total_deleted_records;
+  }
+  for (const auto& [prefix, logical_commit_time] :
+       metadata->cache_checkpoint().prefix_cleanup_logical_commit_times()) {
+    options.cache.RemoveDeletedKeys(options.log_context, logical_commit_time,
+                                    prefix);
+  }
+  absl::flat_hash_map<std::string, std::string> ending_delta_files;
+  for (const auto& [prefix, ending_delta_file] : *prefix_ending_delta_files) {
+    cache_checkpointer->RecordDeltaFileLoaded(prefix, ending_delta_file);
+    if (!ending_delta_file.empty()) {
+      ending_delta_files[prefix] = ending_delta_file;
+    }
+  }
+  PS_LOG(INFO, options.log_context)
+      << "Restored cache from checkpoint with "
+      << data_loading_stats.total_updated_records +
+             data_loading_stats.total_deleted_records
+      << " records in " << absl::Now() - start;
+  return ending_delta_files;
+}
+
 #if defined(MICROSOFT_AD_SELECTION_BUILD)
 std::string MicrosoftGetFullPathForLocation(
     const BlobStorageClient::DataLocation& location) {
@@ -357,9 +623,17 @@ class DataOrchestratorImpl : public DataOrchestrator {
   // date until this file.
   DataOrchestratorImpl(
       Options options,
-      absl::flat_hash_map<std::string, std::string> prefix_last_basenames)
+      absl::flat_hash_map<std::string, std::string> prefix_last_basenames,
+      std::unique_ptr<DataLoadingProgress> loading_progress,
+      bool restored_from_checkpoint)
       : options_(std::move(options)),
-        prefix_last_basenames_(std::move(prefix_last_basenames)) {}
+        prefix_last_basenames_(std::move(prefix_last_basenames)),
+        loading_progress_(std::move(loading_progress)),
+        restored_from_checkpoint_(restored_from_checkpoint),
+        realtime_update_batcher_(
+            options_.realtime_batching,
+            absl::bind_front(&DataOrchestratorImpl::LoadCacheWithRealtimeBatch,
+                             this)) {}
 
   ~DataOrchestratorImpl() override {
     if (!data_loader_thread_) return;
@@ -371,59 +645,40 @@ class DataOrchestratorImpl : public DataOrchestrator {
         << "Sent cancel signal to data loader thread";
     PS_LOG(INFO, options_.log_context)
         << "Stopping loading new data from " << options_.data_bucket;
+    // The data loader thread may start the delta notifier after loading
+    // deferred prefixes, so join it before stopping the notifier.
+    data_loader_thread_->join();
+    if (options_.cache_checkpointer != nullptr) {
+      options_.cache_checkpointer->Stop();
+    }
     if (options_.delta_notifier.IsRunning()) {
       if (const auto s = options_.delta_notifier.Stop(); !s.ok()) {
         PS_LOG(ERROR, options_.log_context) << "Failed to stop notify: " << s;
       }
     }
     PS_LOG(INFO, options_.log_context) << "Delta notifier stopped";
-    data_loader_thread_->join();
     PS_LOG(INFO, options_.log_context) << "Stopped loading new data";
   }
 
+  // Loads the prefixes required by the readiness policy, critical prefixes
+  // first. `ending_delta_files` has the last delta file already loaded for
+  // each prefix, if any. Returns the last delta file loaded for each prefix.
   static absl::StatusOr<absl::flat_hash_map<std::string, std::string>> Init(
-      Options& options) {
-    auto ending_delta_files = LoadSnapshotFiles(options);
-    if (!ending_delta_files.ok()) {
-      return ending_delta_files.status();
-    }
+      Options& options, DataLoadingProgress& loading_progress,
+      absl::flat_hash_map<std::string, std::string> ending_delta_files,
+      bool load_snapshots) {
 #if defined(MICROSOFT_AD_SELECTION_BUILD)
     auto ann_status = MicrosoftLoadAnnSnapshotFiles(options);
     if (!ann_status.ok()) {
       // ann is not mandatory to use
     }
 #endif  // defined(MICROSOFT_AD_SELECTION_BUILD)
-    for (const auto& prefix : options.blob_prefix_allowlist.Prefixes()) {
-      auto location = BlobStorageClient::DataLocation{
-          .bucket = options.data_bucket, .prefix = prefix};
-      auto iter = ending_delta_files->find(prefix);
-      auto maybe_filenames = options.blob_client.ListBlobs(
-          location,
-          {.prefix = std::string(FilePrefix<FileType::DELTA>()),
-           .start_after =
-               iter != ending_delta_files->end() ? iter->second : ""});
-      if (!maybe_filenames.ok()) {
-        return maybe_filenames.status();
-      }
-      PS_LOG(INFO, options.log_context)
-          << "Initializing cache with " << maybe_filenames->size()
-          << " delta files from " << location;
-      for (auto&& basename : std::move(*maybe_filenames)) {
-        auto blob = BlobStorageClient::DataLocation{
-            .bucket = options.data_bucket, .prefix = prefix, .key = basename};
-        if (!IsDeltaFilename(blob.key)) {
-          PS_LOG(WARNING, options.log_context)
-              << "Saw a file " << blob
-              << " not in delta file format. Skipping it.";
-          continue;
-        }
-        (*ending_delta_files)[prefix] = blob.key;
-        if (const auto s = TraceLoadCacheWithDataFromFile(blob, options);
-            !s.ok()) {
-          return s.status();
-        }
-        PS_LOG(INFO, options.log_context) << "Done loading " << blob;
-      }
+    PS_LOG(INFO, options.log_context)
+        << "Initializing cache with readiness policy: "
+        << ReadinessPolicyName(loading_progress.Policy());
+    for (const auto& prefix : loading_progress.PrefixesRequiredForReadiness()) {
+      PS_RETURN_IF_ERROR(LoadPrefix(options, prefix, loading_progress,
+                                    ending_delta_files, load_snapshots));
     }
     return ending_delta_files;
   }
@@ -434,30 +689,99 @@ class DataOrchestratorImpl : public DataOrchestrator {
     }
     PS_LOG(INFO, options_.log_context)
         << "Transitioning to state ContinuouslyLoadNewData";
+    if (loading_progress_->IsComplete()) {
+      PS_RETURN_IF_ERROR(StartDeltaNotifier());
+      MaybeStartCacheCheckpointer();
+      data_loader_thread_ = std::make_unique<std::thread>(
+          absl::bind_front(&DataOrchestratorImpl::ProcessNewFiles, this));
+    } else {
+      // The delta notifier needs the last delta file loaded for every prefix,
+      // so it is only started once the deferred prefixes are loaded.
+      data_loader_thread_ = std::make_unique<std::thread>([this] {
+        if (!LoadDeferredPrefixes()) {
+          return;
+        }
+        RetryUntilOk([this] { return StartDeltaNotifier(); },
+                     "StartDeltaNotifier",
+                     LogStatusSafeMetricsFn<kLoadNewFilesStatus>(),
+                     options_.log_context);
+        MaybeStartCacheCheckpointer();
+        ProcessNewFiles();
+      });
+    }
+
+    // Messages are applied, and their failures logged, asynchronously by
+    // `LoadCacheWithRealtimeBatch`, so the stats of each message are not
+    // returned.
+    return options_.realtime_thread_pool_manager.Start(
+        [this](const std::string& message_body)
+            -> absl::StatusOr<DataLoadingStats> {
+          realtime_update_batcher_.Apply(message_body);
+          return DataLoadingStats();
+        });
+  }
+
+  absl::flat_hash_map<std::string, PrefixLoadingProgress>
+  GetInitialLoadProgress() const override {
+    return loading_progress_->GetProgress();
+  }
+
+ private:
+  absl::Status StartDeltaNotifier() {
     auto prefix_last_basenames = prefix_last_basenames_;
-    absl::Status status = options_.delta_notifier.Start(
+    return options_.delta_notifier.Start(
         options_.change_notifier, {.bucket = options_.data_bucket},
         std::move(prefix_last_basenames),
         absl::bind_front(&DataOrchestratorImpl::EnqueueNewFilesToProcess,
                          this));
-    if (!status.ok()) {
-      return status;
+  }
+
+  // Checkpoints are only written once all prefixes are loaded.
+  void MaybeStartCacheCheckpointer() {
+    if (options_.cache_checkpointer == nullptr) {
+      return;
     }
-    data_loader_thread_ = std::make_unique<std::thread>(
-        absl::bind_front(&DataOrchestratorImpl::ProcessNewFiles, this));
+    if (const auto status = options_.cache_checkpointer->Start();
+        !status.ok()) {
+      PS_LOG(ERROR, options_.log_context)
+          << "Failed to start writing cache checkpoints: " << status;
+    }
+  }
 
-    return options_.realtime_thread_pool_manager.Start(
-        [this, &cache = options_.cache, &log_context = options_.log_context,
-         &delta_stream_reader_factory = options_.delta_stream_reader_factory](
-            const std::string& message_body) {
-          return LoadCacheWithHighPriorityUpdates(
-              kDefaultDataSourceForRealtimeUpdates,
-              kDefaultPrefixForRealTimeUpdates, delta_stream_reader_factory,
-              message_body, cache, log_context);
-        });
+  bool IsStopped() {
+    absl::MutexLock l(&mu_);
+    return stop_;
+  }
+
+  // Loads the prefixes that were not required for readiness during `Init`.
+  // Returns false if the orchestrator was stopped before they were all loaded.
+  bool LoadDeferredPrefixes() {
+    for (const auto& prefix : loading_progress_->PrefixesInLoadingOrder()) {
+      if (loading_progress_->GetProgress()[prefix].phase ==
+          DataLoadingPhase::kDone) {
+        continue;
+      }
+      PS_LOG(INFO, options_.log_context)
+          << "Loading deferred prefix: '" << prefix << "'";
+      RetryUntilOk(
+          [this, &prefix]() -> absl::Status {
+            if (IsStopped()) {
+              return absl::OkStatus();
+            }
+            return LoadPrefix(options_, prefix, *loading_progress_,
+                              prefix_last_basenames_,
+                              /*load_snapshots=*/!restored_from_checkpoint_);
+          },
+          "LoadDeferredPrefix", LogStatusSafeMetricsFn<kLoadNewFilesStatus>(),
+          options_.log_context);
+      if (IsStopped()) {
+        return false;
+      }
+    }
+    NotifyInitialLoadComplete(options_, *loading_progress_);
+    return true;
   }
 
- private:
   bool HasNewEventToProcess() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
     return !unprocessed_basenames_.empty() || stop_ == true;
   }
@@ -536,6 +860,10 @@ class DataOrchestratorImpl : public DataOrchestrator {
             },
             "LoadNewFile", LogStatusSafeMetricsFn<kLoadNewFilesStatus>(),
             options_.log_context);
+        if (options_.cache_checkpointer != nullptr) {
+          options_.cache_checkpointer->RecordDeltaFileLoaded(blob.prefix,
+                                                             blob.key);
+        }
 #if defined(MICROSOFT_AD_SELECTION_BUILD)
       }
 #endif  // defined(MICROSOFT_AD_SELECTION_BUILD)
@@ -551,64 +879,116 @@ class DataOrchestratorImpl : public DataOrchestrator {
     // TODO: block if the queue is too large: consumption is too slow.
   }
 
-  // Loads snapshot files if there are any.
-  // Returns the latest delta file to be included in a snapshot.
-  static absl::StatusOr<absl::flat_hash_map<std::string, std::string>>
-  LoadSnapshotFiles(const Options& options) {
-    absl::flat_hash_map<std::string, std::string> ending_delta_files;
-    for (const auto& prefix : options.blob_prefix_allowlist.Prefixes()) {
-      auto location = BlobStorageClient::DataLocation{
-          .bucket = options.data_bucket, .prefix = prefix};
+  // Loads snapshot and delta files for `prefix`. Records the last delta file
+  // loaded for `prefix` in `ending_delta_files`. Snapshot files are skipped if
+  // `load_snapshots` is false, i.e., the cache was restored from a checkpoint.
+  static absl::Status LoadPrefix(
+      const Options& options, const std::string& prefix,
+      DataLoadingProgress& loading_progress,
+      absl::flat_hash_map<std::string, std::string>& ending_delta_files,
+      bool load_snapshots) {
+    if (load_snapshots) {
+      loading_progress.SetPhase(prefix, DataLoadingPhase::kLoadingSnapshots);
+      PS_RETURN_IF_ERROR(LoadSnapshotFiles(options, prefix, loading_progress,
+                                           ending_delta_files));
+    }
+    loading_progress.SetPhase(prefix, DataLoadingPhase::kLoadingDeltas);
+    auto location = BlobStorageClient::DataLocation{
+        .bucket = options.data_bucket, .prefix = prefix};
+    auto iter = ending_delta_files.find(prefix);
+    auto maybe_filenames = options.blob_client.ListBlobs(
+        location,
+        {.prefix = std::string(FilePrefix<FileType::DELTA>()),
+         .start_after = iter != ending_delta_files.end() ? iter->second : ""});
+    if (!maybe_filenames.ok()) {
+      return maybe_filenames.status();
+    }
+    PS_LOG(INFO, options.log_context)
+        << "Initializing cache with " << maybe_filenames->size()
+        << " delta files from " << location;
+    for (auto&& basename : std::move(*maybe_filenames)) {
+      auto blob = BlobStorageClient::DataLocation{
+          .bucket = options.data_bucket, .prefix = prefix, .key = basename};
+      if (!IsDeltaFilename(blob.key)) {
+        PS_LOG(WARNING, options.log_context)
+            << "Saw a file " << blob
+            << " not in delta file format. Skipping it.";
+        continue;
+      }
+      ending_delta_files[prefix] = blob.key;
+      PS_RETURN_IF_ERROR(
+          LoadFileAndTrackProgress(blob, options, loading_progress));
+      PS_LOG(INFO, options.log_context) << "Done loading " << blob;
+    }
+    if (options.cache_checkpointer != nullptr) {
+      auto iter = ending_delta_files.find(prefix);
+      options.cache_checkpointer->RecordDeltaFileLoaded(
+          prefix, iter != ending_delta_files.end() ? iter->second : "");
+    }
+    loading_progress.SetPhase(prefix, DataLoadingPhase::kDone);
+    const auto progress = loading_progress.GetProgress()[prefix];
+    PS_LOG(INFO, options.log_context)
+        << "Done loading prefix '" << prefix << "': " << progress.files_loaded
+        << " files, " << progress.records_loaded << " records in "
+        << progress.loading_duration << " ("
+        << progress.RecordsPerSecond() << " records/s)";
+    return absl::OkStatus();
+  }
+
+  // Loads snapshot files for `prefix` if there are any. Records the latest
+  // delta file included in a snapshot in `ending_delta_files`.
+  static absl::Status LoadSnapshotFiles(
+      const Options& options, const std::string& prefix,
+      DataLoadingProgress& loading_progress,
+      absl::flat_hash_map<std::string, std::string>& ending_delta_files) {
+    auto location = BlobStorageClient::DataLocation{
+        .bucket = options.data_bucket, .prefix = prefix};
+    PS_LOG(INFO, options.log_context)
+        << "Initializing cache with snapshot file(s) from: " << location;
+    PS_ASSIGN_OR_RETURN(
+        auto snapshot_group,
+        FindMostRecentFileGroup(
+            location,
+            FileGroupFilter{.file_type = FileType::SNAPSHOT,
+                            .status = FileGroup::FileStatus::kComplete},
+            options.blob_client));
+    if (!snapshot_group.has_value()) {
       PS_LOG(INFO, options.log_context)
-          << "Initializing cache with snapshot file(s) from: " << location;
-      PS_ASSIGN_OR_RETURN(
-          auto snapshot_group,
-          FindMostRecentFileGroup(
-              location,
-              FileGroupFilter{.file_type = FileType::SNAPSHOT,
-                              .status = FileGroup::FileStatus::kComplete},
-              options.blob_client));
-      if (!snapshot_group.has_value()) {
+          << "No snapshot files found in: " << location;
+      return absl::OkStatus();
+    }
+    for (const auto& snapshot : snapshot_group->Filenames()) {
+      auto snapshot_blob = BlobStorageClient::DataLocation{
+          .bucket = options.data_bucket, .prefix = prefix, .key = snapshot};
+      auto record_reader =
+          options.delta_stream_reader_factory.CreateConcurrentReader(
+              /*stream_factory=*/[&snapshot_blob, &options]() {
+                return std::make_unique<BlobRecordStream>(
+                    options.blob_client.GetBlobReader(snapshot_blob));
+              });
+      PS_ASSIGN_OR_RETURN(auto metadata, record_reader->GetKVFileMetadata());
+      if (metadata.has_sharding_metadata() &&
+          metadata.sharding_metadata().shard_num() != options.shard_num) {
         PS_LOG(INFO, options.log_context)
-            << "No snapshot files found in: " << location;
+            << "Snapshot " << snapshot_blob << " belongs to shard num "
+            << metadata.sharding_metadata().shard_num()
+            << " but server shard num is " << options.shard_num
+            << ". Skipping it.";
         continue;
       }
-      for (const auto& snapshot : snapshot_group->Filenames()) {
-        auto snapshot_blob = BlobStorageClient::DataLocation{
-            .bucket = options.data_bucket, .prefix = prefix, .key = snapshot};
-        auto record_reader =
-            options.delta_stream_reader_factory.CreateConcurrentReader(
-                /*stream_factory=*/[&snapshot_blob, &options]() {
-                  return std::make_unique<BlobRecordStream>(
-                      options.blob_client.GetBlobReader(snapshot_blob));
-                });
-        PS_ASSIGN_OR_RETURN(auto metadata, record_reader->GetKVFileMetadata());
-        if (metadata.has_sharding_metadata() &&
-            metadata.sharding_metadata().shard_num() != options.shard_num) {
-          PS_LOG(INFO, options.log_context)
-              << "Snapshot " << snapshot_blob << " belongs to shard num "
-              << metadata.sharding_metadata().shard_num()
-              << " but server shard num is " << options.shard_num
-              << ". Skipping it.";
-          continue;
-        }
-        PS_LOG(INFO, options.log_context)
-            << "Loading snapshot file: " << snapshot_blob;
-        if (const auto s =
-                TraceLoadCacheWithDataFromFile(snapshot_blob, options);
-            !s.ok()) {
-          return s.status();
-        }
-        if (auto iter = ending_delta_files.find(prefix);
-            iter == ending_delta_files.end() ||
-            metadata.snapshot().ending_delta_file() > iter->second) {
-          ending_delta_files[prefix] = metadata.snapshot().ending_delta_file();
-        }
-        PS_LOG(INFO, options.log_context)
-            << "Done loading snapshot file: " << snapshot_blob;
+      PS_LOG(INFO, options.log_context)
+          << "Loading snapshot file: " << snapshot_blob;
+      PS_RETURN_IF_ERROR(
+          LoadFileAndTrackProgress(snapshot_blob, options, loading_progress));
+      if (auto iter = ending_delta_files.find(prefix);
+          iter == ending_delta_files.end() ||
+          metadata.snapshot().ending_delta_file() > iter->second) {
+        ending_delta_files[prefix] = metadata.snapshot().ending_delta_file();
       }
+      PS_LOG(INFO, options.log_context)
+          << "Done loading snapshot file: " << snapshot_blob;
     }
-    return ending_delta_files;
+    return absl::OkStatus();
   }
 
 #if defined(MICROSOFT_AD_SELECTION_BUILD)
@@ -673,18 +1053,59 @@ class DataOrchestratorImpl : public DataOrchestrator {
   }
 #endif  // defined(MICROSOFT_AD_SELECTION_BUILD)
 
-  absl::StatusOr<DataLoadingStats> LoadCacheWithHighPriorityUpdates(
-      std::string_view data_source, std::string_view prefix,
-      StreamRecordReaderFactory& delta_stream_reader_factory,
-      const std::string& record_string, Cache& cache,
-      privacy_sandbox::server_common::log::PSLogContext& log_context) {
-    std::istringstream is(record_string);
+  // Decodes the realtime messages of a batch one after the other and applies
+  // their string value mutations to the cache with a single batched write.
+  // Messages that cannot be fully decoded are logged, and the records decoded
+  // before the error are still applied, as for messages applied one at a time.
+  // Batches are applied one at a time, see `RealtimeUpdateBatcher`.
+  void LoadCacheWithRealtimeBatch(absl::Span<const std::string_view> messages) {
+    KeyValueMutationBatch string_value_batch;
     int64_t max_timestamp = 0;
-    auto record_reader = delta_stream_reader_factory.CreateReader(is);
-    return LoadCacheWithData(data_source, prefix, *record_reader, cache,
-                             max_timestamp, options_.shard_num,
-                             options_.num_shards, options_.udf_client,
-                             options_.key_sharder, log_context);
+    // Each message is a separate file, so it needs its own reader, but the
+    // messages are read in place rather than copied into a string stream.
+    StringViewStreambuf message_buffer;
+    std::istream message_stream(&message_buffer);
+    for (const auto message : messages) {
+      message_buffer.Reset(message);
+      message_stream.clear();
+      auto record_reader =
+          options_.delta_stream_reader_factory.CreateReader(message_stream);
+      // Data loading metrics are logged for each message.
+      if (const auto stats = LoadCacheWithData(
+              kDefaultDataSourceForRealtimeUpdates,
+              kDefaultPrefixForRealTimeUpdates, *record_reader, options_.cache,
+              max_timestamp, options_.shard_num, options_.num_shards,
+              options_.udf_client, options_.key_sharder, options_.log_context,
+              /*is_presharded=*/false, options_.cache_checkpointer,
+              &string_value_batch);
+          !stats.ok()) {
+        PS_LOG(ERROR, options_.log_context)
+            << "Failed to apply realtime message: " << stats.status();
+        LogServerErrorMetric(kRealtimeMessageApplicationFailure);
+      }
+    }
+    string_value_batch.ApplyTo(options_.cache, options_.log_context,
+                               kDefaultPrefixForRealTimeUpdates);
+    MaybeRemoveRealtimeDeletedKeys(max_timestamp);
+  }
+
+  // Removes deleted keys up to the latest realtime update once every
+  // `Options::realtime_cleanup_batch_interval` batches, instead of never
+  // cleaning up after realtime deletions.
+  void MaybeRemoveRealtimeDeletedKeys(int64_t batch_max_timestamp) {
+    if (options_.realtime_cleanup_batch_interval <= 0) {
+      return;
+    }
+    realtime_max_timestamp_ =
+        std::max(realtime_max_timestamp_, batch_max_timestamp);
+    if (++realtime_batches_since_cleanup_ <
+        options_.realtime_cleanup_batch_interval) {
+      return;
+    }
+    realtime_batches_since_cleanup_ = 0;
+    options_.cache.RemoveDeletedKeys(options_.log_context,
+                                     realtime_max_timestamp_,
+                                     kDefaultPrefixForRealTimeUpdates);
   }
 
   const Options options_;
@@ -694,18 +1115,46 @@ class DataOrchestratorImpl : public DataOrchestrator {
   bool stop_ ABSL_GUARDED_BY(mu_) = false;
   // last basename of file in initialization.
   absl::flat_hash_map<std::string, std::string> prefix_last_basenames_;
+  std::unique_ptr<DataLoadingProgress> loading_progress_;
+  // If true, snapshot files of deferred prefixes are not loaded.
+  const bool restored_from_checkpoint_;
+  // Only accessed by `LoadCacheWithRealtimeBatch`, which is never called
+  // concurrently.
+  int64_t realtime_max_timestamp_ = 0;
+  int64_t realtime_batches_since_cleanup_ = 0;
+  RealtimeUpdateBatcher realtime_update_batcher_;
 };  // NOLINT
 
 }  // namespace
 
 absl::StatusOr<std::unique_ptr<DataOrchestrator>> DataOrchestrator::TryCreate(
     Options options) {
-  const auto prefix_last_basenames = DataOrchestratorImpl::Init(options);
+  for (const auto& prefix : options.critical_prefixes) {
+    if (!options.blob_prefix_allowlist.Contains(prefix)) {
+      PS_LOG(WARNING, options.log_context)
+          << "Critical prefix '" << prefix
+          << "' is not allowlisted. Ignoring it.";
+    }
+  }
+  auto loading_progress = std::make_unique<DataLoadingProgress>(
+      options.blob_prefix_allowlist.Prefixes(), options.readiness_policy,
+      options.critical_prefixes);
+  PS_ASSIGN_OR_RETURN(auto checkpoint_ending_delta_files,
+                      MaybeRestoreCacheCheckpoint(options));
+  const bool restored_from_checkpoint =
+      checkpoint_ending_delta_files.has_value();
+  const auto prefix_last_basenames = DataOrchestratorImpl::Init(
+      options, *loading_progress,
+      std::move(checkpoint_ending_delta_files).value_or(
+          absl::flat_hash_map<std::string, std::string>()),
+      /*load_snapshots=*/!restored_from_checkpoint);
   if (!prefix_last_basenames.ok()) {
     return prefix_last_basenames.status();
   }
+  NotifyInitialLoadComplete(options, *loading_progress);
   auto orchestrator = std::make_unique<DataOrchestratorImpl>(
-      std::move(options), std::move(prefix_last_basenames.value()));
+      std::move(options), std::move(prefix_last_basenames.value()),
+      std::move(loading_progress), restored_from_checkpoint);
   return orchestrator;
 }
 }  // namespace kv_server
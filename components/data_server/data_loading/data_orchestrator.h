@@ -16,11 +16,14 @@
 #ifndef COMPONENTS_DATA_SERVER_DATA_LOADING_DATA_ORCHESTRATOR_H_
 #define COMPONENTS_DATA_SERVER_DATA_LOADING_DATA_ORCHESTRATOR_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
 #include "components/data/blob_storage/blob_prefix_allowlist.h"
@@ -30,6 +33,9 @@
 #include "components/data/realtime/realtime_notifier.h"
 #include "components/data/realtime/realtime_thread_pool_manager.h"
 #include "components/data_server/cache/cache.h"
+#include "components/data_server/data_loading/cache_checkpointer.h"
+#include "components/data_server/data_loading/data_loading_progress.h"
+#include "components/data_server/data_loading/realtime_update_batcher.h"
 #include "components/udf/udf_client.h"
 #include "public/data_loading/readers/riegeli_stream_io.h"
 #include "public/data_loading/readers/stream_record_reader_factory.h"
@@ -62,6 +68,28 @@ class DataOrchestrator {
     const int32_t num_shards = 1;
     const KeySharder key_sharder;
     BlobPrefixAllowlist blob_prefix_allowlist;
+    // Decides which prefixes must be loaded before `TryCreate` returns.
+    ReadinessPolicy readiness_policy = ReadinessPolicy::kAllPrefixes;
+    // Prefixes loaded before any other prefix during the initial data load.
+    // With `ReadinessPolicy::kCriticalPrefixes`, only these prefixes are loaded
+    // by `TryCreate` and the remaining ones are loaded after `Start`.
+    absl::flat_hash_set<std::string> critical_prefixes = {};
+    // Called once all allowlisted prefixes are loaded, which may be after
+    // `TryCreate` returns depending on `readiness_policy`.
+    std::function<void()> on_initial_load_complete = nullptr;
+    // If set, the cache is restored from the checkpoint written by
+    // `cache_checkpointer`, if any, instead of loading snapshot files, and
+    // checkpoints are written periodically once the initial data load is
+    // complete.
+    CacheCheckpointer* cache_checkpointer = nullptr;
+    // Realtime updates received concurrently are decoded and applied to the
+    // cache in batches, see `RealtimeUpdateBatcher`.
+    RealtimeUpdateBatcherOptions realtime_batching = {};
+    // If positive, deleted keys with logical commit times up to the latest
+    // realtime update are removed from the cache once every this many realtime
+    // batches. As with the cleanup after each delta file, updates older than
+    // the cleanup time are ignored afterwards.
+    int64_t realtime_cleanup_batch_interval = 0;
     privacy_sandbox::server_common::log::PSLogContext& log_context;
 #if defined(MICROSOFT_AD_SELECTION_BUILD)
     microsoft::ANNIndex& microsoft_ann_index;
@@ -69,14 +97,20 @@ class DataOrchestrator {
   };
 
   // Creates initial state. Scans the bucket and initializes the cache with data
-  // read from the files in the bucket.
+  // read from the files in the bucket. Returns once the prefixes required by
+  // `Options::readiness_policy` are loaded.
   static absl::StatusOr<std::unique_ptr<DataOrchestrator>> TryCreate(
       Options options);
 
   // Starts a separate thread to monitor and load new data until the returned
   // this object is destructed.
   // Returns immediately without blocking.
+  // Prefixes not loaded by `TryCreate` are loaded before monitoring new data.
   virtual absl::Status Start() = 0;
+
+  // Returns the progress of the initial data load for each prefix.
+  virtual absl::flat_hash_map<std::string, PrefixLoadingProgress>
+  GetInitialLoadProgress() const = 0;
 };
 }  // namespace kv_server
 
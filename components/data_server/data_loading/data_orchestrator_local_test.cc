@@ -0,0 +1,374 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests the initial data load of the data orchestrator with data files stored
+// in local blob storage.
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/notification.h"
+#include "components/data/blob_storage/blob_storage_client_local.h"
+#include "components/data/common/mocks.h"
+#include "components/data_server/cache/cache_memory_stats.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/data_loading/data_orchestrator.h"
+#include "components/udf/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/filename_utils.h"
+#include "public/data_loading/readers/riegeli_stream_record_reader_factory.h"
+#include "public/data_loading/writers/delta_record_stream_writer.h"
+#include "public/sharding/key_sharder.h"
+#include "public/sharding/sharding_function.h"
+
+namespace kv_server {
+namespace {
+
+using testing::_;
+using testing::Pair;
+using testing::Return;
+using testing::UnorderedElementsAre;
+
+// Writes a data file with one update record per key to `path`.
+void WriteDataFile(const std::filesystem::path& path,
+                   const std::vector<std::string>& keys,
+                   int64_t logical_commit_time,
+                   KVFileMetadata metadata = KVFileMetadata()) {
+  std::stringstream data_stream;
+  {
+    auto record_writer = DeltaRecordStreamWriter<>::Create(
+        data_stream, DeltaRecordWriter::Options{.metadata = metadata});
+    ASSERT_TRUE(record_writer.ok()) << record_writer.status();
+    for (const auto& key : keys) {
+      KeyValueMutationRecordT kv_mutation_record = {
+          .mutation_type = KeyValueMutationType::Update,
+          .logical_commit_time = logical_commit_time,
+          .key = key,
+      };
+      kv_mutation_record.value.Set(StringValueT{.value = key + "_value"});
+      DataRecordT data_record;
+      data_record.record.Set(std::move(kv_mutation_record));
+      ASSERT_TRUE((*record_writer)->WriteRecord(data_record).ok());
+    }
+  }
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream file(path, std::ios::binary);
+  file << data_stream.str();
+}
+
+class DataOrchestratorLocalTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    InitMetricsContextMap();
+    data_dir_ = std::filesystem::path(::testing::TempDir()) /
+                ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::remove_all(data_dir_);
+    std::filesystem::create_directories(data_dir_);
+    ON_CALL(notifier_, IsRunning).WillByDefault(Return(false));
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(data_dir_);
+    std::filesystem::remove_all(CheckpointDirectory());
+  }
+
+  std::filesystem::path CheckpointDirectory() const {
+    std::filesystem::path directory = data_dir_;
+    directory += "_checkpoint";
+    return directory;
+  }
+
+  std::unique_ptr<CacheCheckpointer> CreateCheckpointer() {
+    return std::make_unique<CacheCheckpointer>(CacheCheckpointer::Options{
+        .cache = *cache_,
+        .directory = CheckpointDirectory().string(),
+        .data_bucket = data_dir_.string(),
+        .log_context = log_context_,
+    });
+  }
+
+  DataOrchestrator::Options CreateOptions(
+      std::string_view prefix_allowlist, ReadinessPolicy readiness_policy,
+      absl::flat_hash_set<std::string> critical_prefixes,
+      std::function<void()> on_initial_load_complete,
+      CacheCheckpointer* cache_checkpointer = nullptr) {
+    return DataOrchestrator::Options{
+        .data_bucket = data_dir_.string(),
+        .cache = *cache_,
+        .blob_client = blob_client_,
+        .delta_notifier = notifier_,
+        .change_notifier = change_notifier_,
+        .udf_client = udf_client_,
+        .delta_stream_reader_factory = delta_stream_reader_factory_,
+        .realtime_thread_pool_manager = realtime_thread_pool_manager_,
+        .key_sharder = KeySharder(ShardingFunction{/*seed=*/""}),
+        .blob_prefix_allowlist = BlobPrefixAllowlist(prefix_allowlist),
+        .readiness_policy = readiness_policy,
+        .critical_prefixes = std::move(critical_prefixes),
+        .on_initial_load_complete = std::move(on_initial_load_complete),
+        .cache_checkpointer = cache_checkpointer,
+        .log_context = log_context_,
+#if defined(MICROSOFT_AD_SELECTION_BUILD)
+        .microsoft_ann_index = microsoft_ann_index_,
+#endif  // defined(MICROSOFT_AD_SELECTION_BUILD)
+    };
+  }
+
+  // Writes a snapshot covering delta 1 and deltas 1 and 2 for `prefix`. Only
+  // the snapshot and delta 2 are expected to be loaded.
+  void WritePrefixFiles(std::string_view prefix) {
+    const std::string key_prefix =
+        prefix.empty() ? "main" : std::string(prefix);
+    const std::filesystem::path dir = data_dir_ / prefix;
+    KVFileMetadata snapshot_metadata;
+    *snapshot_metadata.mutable_snapshot()->mutable_starting_file() =
+        ToDeltaFileName(1).value();
+    *snapshot_metadata.mutable_snapshot()->mutable_ending_delta_file() =
+        ToDeltaFileName(1).value();
+    WriteDataFile(dir / ToSnapshotFileName(1).value(),
+                  {key_prefix + "_snapshot"}, 1, snapshot_metadata);
+    WriteDataFile(dir / ToDeltaFileName(1).value(), {key_prefix + "_delta1"},
+                  1);
+    WriteDataFile(dir / ToDeltaFileName(2).value(), {key_prefix + "_delta2"},
+                  2);
+  }
+
+  absl::flat_hash_map<std::string, std::string> Lookup(
+      const absl::flat_hash_set<std::string_view>& keys) {
+    RequestContext request_context;
+    return cache_->GetKeyValuePairs(request_context, keys);
+  }
+
+  absl::flat_hash_map<std::string, CacheMemoryStats> GetMemoryStats() {
+    return static_cast<const KeyValueCache&>(*cache_).GetMemoryStats();
+  }
+
+  std::filesystem::path data_dir_;
+  std::unique_ptr<Cache> cache_ = KeyValueCache::Create();
+  privacy_sandbox::server_common::log::NoOpContext log_context_;
+  FileBlobStorageClient blob_client_{log_context_};
+  RiegeliStreamRecordReaderFactory delta_stream_reader_factory_;
+  testing::NiceMock<MockDeltaFileNotifier> notifier_;
+  MockBlobStorageChangeNotifier change_notifier_;
+  MockUdfClient udf_client_;
+  MockRealtimeThreadPoolManager realtime_thread_pool_manager_;
+#if defined(MICROSOFT_AD_SELECTION_BUILD)
+  kv_server::microsoft::ANNIndex microsoft_ann_index_;
+#endif  // defined(MICROSOFT_AD_SELECTION_BUILD)
+};
+
+TEST_F(DataOrchestratorLocalTest, AllPrefixesPolicyLoadsAllPrefixes) {
+  WritePrefixFiles("");
+  WritePrefixFiles("prefix1");
+  bool initial_load_complete = false;
+  auto orchestrator = DataOrchestrator::TryCreate(CreateOptions(
+      "prefix1", ReadinessPolicy::kAllPrefixes, {},
+      [&initial_load_complete] { initial_load_complete = true; }));
+  ASSERT_TRUE(orchestrator.ok()) << orchestrator.status();
+  EXPECT_TRUE(initial_load_complete);
+  EXPECT_THAT(
+      Lookup({"main_snapshot", "main_delta1", "main_delta2",
+              "prefix1_snapshot", "prefix1_delta1", "prefix1_delta2"}),
+      UnorderedElementsAre(Pair("main_snapshot", "main_snapshot_value"),
+                           Pair("main_delta2", "main_delta2_value"),
+                           Pair("prefix1_snapshot", "prefix1_snapshot_value"),
+                           Pair("prefix1_delta2", "prefix1_delta2_value")));
+  const auto progress = (*orchestrator)->GetInitialLoadProgress();
+  for (const auto& prefix : {"", "prefix1"}) {
+    EXPECT_EQ(progress.at(prefix).phase, DataLoadingPhase::kDone);
+    EXPECT_EQ(progress.at(prefix).files_loaded, 2);
+    EXPECT_EQ(progress.at(prefix).records_loaded, 2);
+  }
+}
+
+TEST_F(DataOrchestratorLocalTest, CriticalPrefixesPolicyDefersOtherPrefixes) {
+  WritePrefixFiles("");
+  WritePrefixFiles("critical");
+  WritePrefixFiles("deferred");
+  absl::Notification initial_load_complete;
+  auto orchestrator = DataOrchestrator::TryCreate(CreateOptions(
+      "critical,deferred", ReadinessPolicy::kCriticalPrefixes, {"critical"},
+      [&initial_load_complete] { initial_load_complete.Notify(); }));
+  ASSERT_TRUE(orchestrator.ok()) << orchestrator.status();
+
+  // Only critical prefixes are loaded before serving.
+  EXPECT_FALSE(initial_load_complete.HasBeenNotified());
+  EXPECT_THAT(Lookup({"main_delta2", "critical_delta2", "deferred_delta2"}),
+              UnorderedElementsAre(Pair("main_delta2", "main_delta2_value"),
+                                   Pair("critical_delta2",
+                                        "critical_delta2_value")));
+  auto progress = (*orchestrator)->GetInitialLoadProgress();
+  EXPECT_EQ(progress.at("").phase, DataLoadingPhase::kDone);
+  EXPECT_EQ(progress.at("critical").phase, DataLoadingPhase::kDone);
+  EXPECT_EQ(progress.at("deferred").phase, DataLoadingPhase::kPending);
+
+  // The delta notifier starts after the deferred prefix is loaded, from the
+  // last delta file of every prefix.
+  absl::Notification notifier_started;
+  EXPECT_CALL(notifier_,
+              Start(_, _,
+                    UnorderedElementsAre(
+                        Pair("", ToDeltaFileName(2).value()),
+                        Pair("critical", ToDeltaFileName(2).value()),
+                        Pair("deferred", ToDeltaFileName(2).value())),
+                    _))
+      .WillOnce(testing::InvokeWithoutArgs([&notifier_started] {
+        notifier_started.Notify();
+        return absl::OkStatus();
+      }));
+  EXPECT_CALL(realtime_thread_pool_manager_, Start)
+      .WillOnce(Return(absl::OkStatus()));
+  ASSERT_TRUE((*orchestrator)->Start().ok());
+  ASSERT_TRUE(
+      initial_load_complete.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  ASSERT_TRUE(
+      notifier_started.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  EXPECT_THAT(Lookup({"deferred_snapshot", "deferred_delta2"}),
+              UnorderedElementsAre(
+                  Pair("deferred_snapshot", "deferred_snapshot_value"),
+                  Pair("deferred_delta2", "deferred_delta2_value")));
+  progress = (*orchestrator)->GetInitialLoadProgress();
+  EXPECT_EQ(progress.at("deferred").phase, DataLoadingPhase::kDone);
+}
+
+TEST_F(DataOrchestratorLocalTest, CriticalPrefixesPolicyFailsOnCriticalError) {
+  WritePrefixFiles("");
+  // The critical prefix directory is missing, so listing its files fails.
+  auto orchestrator = DataOrchestrator::TryCreate(
+      CreateOptions("critical", ReadinessPolicy::kCriticalPrefixes,
+                    {"critical"}, /*on_initial_load_complete=*/nullptr));
+  EXPECT_FALSE(orchestrator.ok());
+}
+
+TEST_F(DataOrchestratorLocalTest, RestoresCheckpointAndLoadsNewerDeltas) {
+  WritePrefixFiles("");
+  WritePrefixFiles("prefix1");
+  absl::flat_hash_map<std::string, CacheMemoryStats> checkpoint_memory_stats;
+  {
+    auto checkpointer = CreateCheckpointer();
+    auto orchestrator = DataOrchestrator::TryCreate(
+        CreateOptions("prefix1", ReadinessPolicy::kAllPrefixes, {},
+                      /*on_initial_load_complete=*/nullptr,
+                      checkpointer.get()));
+    ASSERT_TRUE(orchestrator.ok()) << orchestrator.status();
+    ASSERT_TRUE(checkpointer->WriteCheckpoint().ok());
+    checkpoint_memory_stats = GetMemoryStats();
+  }
+  WriteDataFile(data_dir_ / ToDeltaFileName(3).value(), {"main_delta3"}, 3);
+
+  // Restart with an empty cache.
+  cache_ = KeyValueCache::Create();
+  auto checkpointer = CreateCheckpointer();
+  auto orchestrator = DataOrchestrator::TryCreate(
+      CreateOptions("prefix1", ReadinessPolicy::kAllPrefixes, {},
+                    /*on_initial_load_complete=*/nullptr, checkpointer.get()));
+  ASSERT_TRUE(orchestrator.ok()) << orchestrator.status();
+  EXPECT_THAT(
+      Lookup({"main_snapshot", "main_delta2", "main_delta3",
+              "prefix1_snapshot", "prefix1_delta2"}),
+      UnorderedElementsAre(Pair("main_snapshot", "main_snapshot_value"),
+                           Pair("main_delta2", "main_delta2_value"),
+                           Pair("main_delta3", "main_delta3_value"),
+                           Pair("prefix1_snapshot", "prefix1_snapshot_value"),
+                           Pair("prefix1_delta2", "prefix1_delta2_value")));
+  // Only the delta file written after the checkpoint is loaded.
+  const auto progress = (*orchestrator)->GetInitialLoadProgress();
+  EXPECT_EQ(progress.at("").files_loaded, 1);
+  EXPECT_EQ(progress.at("prefix1").files_loaded, 0);
+  // The restored values are accounted to the prefixes they were loaded with.
+  auto memory_stats = GetMemoryStats();
+  EXPECT_TRUE(memory_stats["prefix1"] == checkpoint_memory_stats["prefix1"]);
+  EXPECT_EQ(memory_stats[""].key_values.cardinality,
+            checkpoint_memory_stats[""].key_values.cardinality + 1);
+}
+
+TEST_F(DataOrchestratorLocalTest, KeepsPrefixMemoryStatsOfRestoredValues) {
+  WritePrefixFiles("");
+  WritePrefixFiles("prefix1");
+  {
+    auto checkpointer = CreateCheckpointer();
+    auto orchestrator = DataOrchestrator::TryCreate(
+        CreateOptions("prefix1", ReadinessPolicy::kAllPrefixes, {},
+                      /*on_initial_load_complete=*/nullptr,
+                      checkpointer.get()));
+    ASSERT_TRUE(orchestrator.ok()) << orchestrator.status();
+    ASSERT_TRUE(checkpointer->WriteCheckpoint().ok());
+  }
+
+  cache_ = KeyValueCache::Create();
+  auto checkpointer = CreateCheckpointer();
+  auto orchestrator = DataOrchestrator::TryCreate(
+      CreateOptions("prefix1", ReadinessPolicy::kAllPrefixes, {},
+                    /*on_initial_load_complete=*/nullptr, checkpointer.get()));
+  ASSERT_TRUE(orchestrator.ok()) << orchestrator.status();
+  // Update and delete the restored values of prefix1, like later delta files
+  // of prefix1 would.
+  cache_->UpdateKeyValue(log_context_, "prefix1_snapshot", "updated", 3,
+                         "prefix1");
+  cache_->DeleteKey(log_context_, "prefix1_delta2", 3, "prefix1");
+  auto memory_stats = GetMemoryStats();
+  EXPECT_EQ(memory_stats["prefix1"].key_values.cardinality, 1);
+  EXPECT_EQ(memory_stats["prefix1"].key_values.tombstones, 1);
+  EXPECT_EQ(memory_stats["prefix1"].key_values.value_bytes,
+            /*"updated"*/ 7);
+  EXPECT_EQ(memory_stats[""].key_values.cardinality, 2);
+  EXPECT_EQ(memory_stats[""].key_values.tombstones, 0);
+
+  cache_->RemoveDeletedKeys(log_context_, 3, "prefix1");
+  memory_stats = GetMemoryStats();
+  EXPECT_EQ(memory_stats["prefix1"].key_values.tombstones, 0);
+  EXPECT_EQ(memory_stats["prefix1"].key_values.key_bytes,
+            /*"prefix1_snapshot"*/ 16);
+}
+
+TEST_F(DataOrchestratorLocalTest, DoesNotRestoreCheckpointOlderThanSnapshot) {
+  WritePrefixFiles("");
+  {
+    auto checkpointer = CreateCheckpointer();
+    auto orchestrator = DataOrchestrator::TryCreate(
+        CreateOptions("", ReadinessPolicy::kAllPrefixes, {},
+                      /*on_initial_load_complete=*/nullptr,
+                      checkpointer.get()));
+    ASSERT_TRUE(orchestrator.ok()) << orchestrator.status();
+    ASSERT_TRUE(checkpointer->WriteCheckpoint().ok());
+  }
+  KVFileMetadata snapshot_metadata;
+  *snapshot_metadata.mutable_snapshot()->mutable_starting_file() =
+      ToDeltaFileName(1).value();
+  *snapshot_metadata.mutable_snapshot()->mutable_ending_delta_file() =
+      ToDeltaFileName(3).value();
+  WriteDataFile(data_dir_ / ToSnapshotFileName(2).value(),
+                {"main_snapshot2"}, 3, snapshot_metadata);
+
+  cache_ = KeyValueCache::Create();
+  auto checkpointer = CreateCheckpointer();
+  auto orchestrator = DataOrchestrator::TryCreate(
+      CreateOptions("", ReadinessPolicy::kAllPrefixes, {},
+                    /*on_initial_load_complete=*/nullptr, checkpointer.get()));
+  ASSERT_TRUE(orchestrator.ok()) << orchestrator.status();
+  // The data is loaded from the newer snapshot instead of the checkpoint.
+  EXPECT_THAT(Lookup({"main_snapshot", "main_snapshot2"}),
+              UnorderedElementsAre(
+                  Pair("main_snapshot2", "main_snapshot2_value")));
+}
+
+}  // namespace
+}  // namespace kv_server
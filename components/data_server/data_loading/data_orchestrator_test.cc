@@ -708,6 +708,61 @@ TEST_F(DataOrchestratorTest, CreateOrchestratorWithRealtimeDisabled) {
   ASSERT_TRUE(maybe_orchestrator.ok());
 }
 
+TEST_F(DataOrchestratorTest, AppliesRealtimeUpdatesAndRemovesDeletedKeys) {
+  ON_CALL(blob_client_, ListBlobs)
+      .WillByDefault(Return(std::vector<std::string>({})));
+  options_.realtime_cleanup_batch_interval = 1;
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options_);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+  auto orchestrator = std::move(maybe_orchestrator.value());
+
+  EXPECT_CALL(notifier_, Start).WillOnce(Return(absl::OkStatus()));
+  EXPECT_CALL(notifier_, IsRunning).Times(1).WillOnce(Return(true));
+  EXPECT_CALL(notifier_, Stop()).Times(1).WillOnce(Return(absl::OkStatus()));
+  std::function<absl::StatusOr<DataLoadingStats>(const std::string&)>
+      realtime_callback;
+  EXPECT_CALL(realtime_thread_pool_manager_, Start)
+      .WillOnce([&realtime_callback](auto callback) {
+        realtime_callback = std::move(callback);
+        return absl::OkStatus();
+      });
+  auto realtime_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*realtime_reader, ReadStreamRecords)
+      .Times(1)
+      .WillOnce(
+          [](const std::function<absl::Status(std::string_view)>& callback) {
+            KeyValueMutationRecordT update_record = {
+                .mutation_type = KeyValueMutationType::Update,
+                .logical_commit_time = 3,
+                .key = "foo",
+            };
+            update_record.value.Set(GetSimpleStringValue("foo value"));
+            auto [update_buffer, serialized_update] =
+                Serialize(GetNativeDataRecord(std::move(update_record)));
+            callback(serialized_update).IgnoreError();
+            KeyValueMutationRecordT delete_record = {
+                .mutation_type = KeyValueMutationType::Delete,
+                .logical_commit_time = 4,
+                .key = "bar",
+            };
+            delete_record.value.Set(StringValueT{.value = ""});
+            auto [delete_buffer, serialized_delete] =
+                Serialize(GetNativeDataRecord(std::move(delete_record)));
+            callback(serialized_delete).IgnoreError();
+            return absl::OkStatus();
+          });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateReader)
+      .WillOnce(Return(ByMove(std::move(realtime_reader))));
+  EXPECT_CALL(cache_, UpdateKeyValue(_, "foo", "foo value", 3, "")).Times(1);
+  EXPECT_CALL(cache_, DeleteKey(_, "bar", 4, "")).Times(1);
+  EXPECT_CALL(cache_, RemoveDeletedKeys(_, 4, "")).Times(1);
+
+  EXPECT_TRUE(orchestrator->Start().ok());
+  ASSERT_TRUE(realtime_callback);
+  // The only caller of the batcher applies its own message before returning.
+  EXPECT_TRUE(realtime_callback("realtime message").ok());
+}
+
 TEST_F(DataOrchestratorTest, InitCacheShardedSuccessSkipRecord) {
   testing::StrictMock<MockCache> strict_cache;
 
@@ -816,6 +871,96 @@ TEST_F(DataOrchestratorTest, InitCacheShardedSuccessSkipRecord) {
   ASSERT_TRUE(maybe_orchestrator.ok());
 }
 
+TEST_F(DataOrchestratorTest, InitCacheShardedSkipsShardCheckForPresharded) {
+  testing::StrictMock<MockCache> strict_cache;
+
+  const std::vector<std::string> fnames({ToDeltaFileName(1).value()});
+  EXPECT_CALL(
+      blob_client_,
+      ListBlobs(GetTestLocation(),
+                AllOf(Field(&BlobStorageClient::ListOptions::start_after, ""),
+                      Field(&BlobStorageClient::ListOptions::prefix,
+                            FilePrefix<FileType::SNAPSHOT>()))))
+      .Times(1)
+      .WillOnce(Return(std::vector<std::string>()));
+#if defined(MICROSOFT_AD_SELECTION_BUILD)
+  EXPECT_CALL(
+      blob_client_,
+      ListBlobs(GetTestLocation(),
+                AllOf(Field(&BlobStorageClient::ListOptions::start_after, ""),
+                      Field(&BlobStorageClient::ListOptions::prefix,
+                            FilePrefix<FileType::ANNSNAPSHOT>()))))
+      .Times(1)
+      .WillOnce(Return(std::vector<std::string>()));
+#endif  // defined(MICROSOFT_AD_SELECTION_BUILD)
+  EXPECT_CALL(
+      blob_client_,
+      ListBlobs(GetTestLocation(),
+                AllOf(Field(&BlobStorageClient::ListOptions::start_after, ""),
+                      Field(&BlobStorageClient::ListOptions::prefix,
+                            FilePrefix<FileType::DELTA>()))))
+      .WillOnce(Return(fnames));
+
+  // The file claims to be written for shard 1 with the server's sharding
+  // function, so its records are loaded without being re-hashed.
+  KVFileMetadata metadata;
+  metadata.mutable_sharding_metadata()->set_shard_num(1);
+  metadata.mutable_sharding_metadata()->set_sharding_function_fingerprint(
+      ShardingFunction(/*seed=*/"").GetFingerprint(/*num_shards=*/2));
+  auto update_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*update_reader, GetKVFileMetadata)
+      .Times(1)
+      .WillOnce(Return(metadata));
+  EXPECT_CALL(*update_reader, ReadStreamRecords)
+      .Times(1)
+      .WillOnce(
+          [](const std::function<absl::Status(std::string_view)>& callback) {
+            // key: "shard1" -> shard num: 0
+            KeyValueMutationRecordT kv_mutation_record = {
+                .mutation_type = KeyValueMutationType::Update,
+                .logical_commit_time = 3,
+                .key = "shard1",
+            };
+            kv_mutation_record.value.Set(GetSimpleStringValue("bar value"));
+            DataRecordT data_record =
+                GetNativeDataRecord(std::move(kv_mutation_record));
+            auto [fbs_buffer, serialized_string_view] = Serialize(data_record);
+            callback(serialized_string_view).IgnoreError();
+            return absl::OkStatus();
+          });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .Times(1)
+      .WillOnce(Return(ByMove(std::move(update_reader))));
+
+  EXPECT_CALL(strict_cache, UpdateKeyValue(_, "shard1", "bar value", 3, _))
+      .Times(1);
+  EXPECT_CALL(strict_cache, RemoveDeletedKeys(_, 3, _)).Times(1);
+
+  auto sharded_options = DataOrchestrator::Options{
+      .data_bucket = GetTestLocation().bucket,
+      .cache = strict_cache,
+      .blob_client = blob_client_,
+      .delta_notifier = notifier_,
+      .change_notifier = change_notifier_,
+      .udf_client = udf_client_,
+      .delta_stream_reader_factory = delta_stream_reader_factory_,
+      .realtime_thread_pool_manager = realtime_thread_pool_manager_,
+      .shard_num = 1,
+      .num_shards = 2,
+      .key_sharder =
+          kv_server::KeySharder(kv_server::ShardingFunction{/*seed=*/""}),
+      .blob_prefix_allowlist = BlobPrefixAllowlist(""),
+      .log_context = log_context_
+#if defined(MICROSOFT_AD_SELECTION_BUILD)
+      ,
+      .microsoft_ann_index = microsoft_ann_index_,
+#endif  // defined(MICROSOFT_AD_SELECTION_BUILD)
+  };
+
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(sharded_options);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+}
+
 TEST_F(DataOrchestratorTest, InitCacheSkipsSnapshotFilesForOtherShards) {
   auto snapshot_name = ToSnapshotFileName(1);
   EXPECT_CALL(
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/data_loading/realtime_update_batcher.h"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace kv_server {
+
+void RealtimeUpdateBatcher::Apply(std::string_view message) {
+  mu_.Lock();
+  const auto has_room = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return static_cast<int64_t>(queue_.size()) < options_.max_queued_messages;
+  };
+  mu_.Await(absl::Condition(&has_room));
+  queue_.emplace_back(message);
+  if (applying_) {
+    mu_.Unlock();
+    return;
+  }
+  applying_ = true;
+  const auto has_full_batch = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return static_cast<int64_t>(queue_.size()) >= options_.max_batch_messages;
+  };
+  std::vector<std::string> batch;
+  std::vector<std::string_view> batch_messages;
+  while (!queue_.empty()) {
+    if (options_.batch_window > absl::ZeroDuration()) {
+      mu_.AwaitWithTimeout(absl::Condition(&has_full_batch),
+                           options_.batch_window);
+    }
+    const auto batch_end =
+        queue_.begin() +
+        std::min<int64_t>(queue_.size(), options_.max_batch_messages);
+    batch.assign(std::make_move_iterator(queue_.begin()),
+                 std::make_move_iterator(batch_end));
+    queue_.erase(queue_.begin(), batch_end);
+    // The batch is owned by this call, so it is applied without holding the
+    // lock, while other callers queue the next batch.
+    mu_.Unlock();
+    batch_messages.assign(batch.begin(), batch.end());
+    apply_batch_fn_(batch_messages);
+    mu_.Lock();
+  }
+  applying_ = false;
+  mu_.Unlock();
+}
+
+void KeyValueMutationBatch::Add(std::string_view key, std::string_view value,
+                                int64_t logical_commit_time,
+                                bool is_deletion) {
+  auto [it, inserted] = mutations_.try_emplace(key);
+  if (!inserted && it->second.logical_commit_time >= logical_commit_time) {
+    return;
+  }
+  it->second.value = is_deletion ? "" : value;
+  it->second.logical_commit_time = logical_commit_time;
+  it->second.is_deletion = is_deletion;
+}
+
+void KeyValueMutationBatch::ApplyTo(
+    Cache& cache,
+    privacy_sandbox::server_common::log::PSLogContext& log_context,
+    std::string_view prefix) {
+  std::vector<Cache::KeyValueMutation> mutations;
+  mutations.reserve(mutations_.size());
+  for (const auto& [key, mutation] : mutations_) {
+    mutations.push_back({
+        .key = key,
+        .value = mutation.value,
+        .logical_commit_time = mutation.logical_commit_time,
+        .is_deletion = mutation.is_deletion,
+    });
+  }
+  cache.ApplyKeyValueMutations(log_context, mutations, prefix);
+  mutations_.clear();
+}
+
+}  // namespace kv_server
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_DATA_LOADING_REALTIME_UPDATE_BATCHER_H_
+#define COMPONENTS_DATA_SERVER_DATA_LOADING_REALTIME_UPDATE_BATCHER_H_
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "components/data_server/cache/cache.h"
+#include "src/logger/request_context_logger.h"
+
+namespace kv_server {
+
+struct RealtimeUpdateBatcherOptions {
+  // How long the applier of a batch waits for more messages before applying
+  // the batch.
+  absl::Duration batch_window = absl::ZeroDuration();
+  // A batch is closed as soon as it holds this many messages.
+  int64_t max_batch_messages = 64;
+  // `Apply` blocks while this many messages are queued, so that the queue stays
+  // bounded when messages arrive faster than they are applied. Must be
+  // positive.
+  int64_t max_queued_messages = 1024;
+};
+
+// Groups realtime update messages received concurrently by the realtime
+// notifier threads into batches, so that each batch is decoded and applied to
+// the cache together instead of one message at a time.
+//
+// `Apply` queues a copy of its message and returns without waiting for it to
+// be applied, so that notifier threads keep receiving messages while a batch
+// is applied and batches fill up to `Options::max_batch_messages`. The caller
+// that finds no batch being applied becomes the applier: it waits up to
+// `Options::batch_window` for the queue to hold a full batch, applies up to
+// `Options::max_batch_messages` queued messages with a single call to the
+// `ApplyBatchFn`, and repeats until the queue is empty. Batches are thus
+// applied one at a time, in the order their messages were queued, and all
+// queued messages are applied once every `Apply` call has returned.
+//
+// This class is thread-safe.
+class RealtimeUpdateBatcher {
+ public:
+  using Options = RealtimeUpdateBatcherOptions;
+
+  // Applies a batch of messages. Failures are handled by the function itself,
+  // e.g., by logging them, since the callers of `Apply` do not wait for them.
+  using ApplyBatchFn =
+      absl::AnyInvocable<void(absl::Span<const std::string_view>)>;
+
+  RealtimeUpdateBatcher(Options options, ApplyBatchFn apply_batch_fn)
+      : options_(std::move(options)),
+        apply_batch_fn_(std::move(apply_batch_fn)) {}
+
+  RealtimeUpdateBatcher(const RealtimeUpdateBatcher&) = delete;
+  RealtimeUpdateBatcher& operator=(const RealtimeUpdateBatcher&) = delete;
+
+  // Queues `message` to be applied. Blocks while
+  // `Options::max_queued_messages` messages are queued, and while the caller
+  // applies the queued messages if it became the applier.
+  void Apply(std::string_view message) ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  const Options options_;
+  ApplyBatchFn apply_batch_fn_;
+  absl::Mutex mu_;
+  // Messages not applied yet, in the order they were queued. Messages of the
+  // batch being applied are no longer in the queue.
+  std::deque<std::string> queue_ ABSL_GUARDED_BY(mu_);
+  bool applying_ ABSL_GUARDED_BY(mu_) = false;
+};
+
+// Collects the string value mutations of a batch of records, keeping only the
+// mutation the cache would end up with for each key, so that the batch is
+// applied with a single `Cache::ApplyKeyValueMutations` call.
+class KeyValueMutationBatch {
+ public:
+  // Adds the mutation, unless the batch already holds a mutation of `key`
+  // with the same or a later logical commit time. Like the cache, keeps the
+  // first of two mutations with the same logical commit time.
+  void Add(std::string_view key, std::string_view value,
+           int64_t logical_commit_time, bool is_deletion);
+
+  int64_t size() const { return mutations_.size(); }
+
+  // Applies the collected mutations to `cache` and clears the batch.
+  void ApplyTo(Cache& cache,
+               privacy_sandbox::server_common::log::PSLogContext& log_context,
+               std::string_view prefix = "");
+
+ private:
+  struct Mutation {
+    std::string value;
+    int64_t logical_commit_time;
+    bool is_deletion;
+  };
+
+  absl::flat_hash_map<std::string, Mutation> mutations_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_DATA_LOADING_REALTIME_UPDATE_BATCHER_H_
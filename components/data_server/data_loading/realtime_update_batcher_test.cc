@@ -0,0 +1,152 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/data_loading/realtime_update_batcher.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "components/data_server/cache/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::_;
+using testing::ElementsAre;
+using testing::IsEmpty;
+using testing::UnorderedElementsAre;
+
+using Batcher = RealtimeUpdateBatcher;
+
+class RealtimeUpdateBatcherTest : public ::testing::Test {
+ protected:
+  Batcher::ApplyBatchFn RecordBatches() {
+    return [this](absl::Span<const std::string_view> messages) {
+      absl::MutexLock lock(&mu_);
+      batches_.emplace_back(messages.begin(), messages.end());
+    };
+  }
+
+  // Blocks the first batch until `unblock_` is notified, and notifies
+  // `applying_` once it is applied.
+  Batcher::ApplyBatchFn BlockFirstBatch() {
+    return [this, record_batches = RecordBatches()](
+               absl::Span<const std::string_view> messages) mutable {
+      if (!applying_.HasBeenNotified()) {
+        applying_.Notify();
+        unblock_.WaitForNotification();
+      }
+      record_batches(messages);
+    };
+  }
+
+  std::vector<std::vector<std::string>> Batches() {
+    absl::MutexLock lock(&mu_);
+    return batches_;
+  }
+
+  absl::Mutex mu_;
+  std::vector<std::vector<std::string>> batches_ ABSL_GUARDED_BY(mu_);
+  absl::Notification applying_;
+  absl::Notification unblock_;
+};
+
+TEST_F(RealtimeUpdateBatcherTest, AppliesSingleMessage) {
+  Batcher batcher({}, RecordBatches());
+  batcher.Apply("message1");
+  batcher.Apply("message2");
+  EXPECT_THAT(Batches(),
+              ElementsAre(ElementsAre("message1"), ElementsAre("message2")));
+}
+
+TEST_F(RealtimeUpdateBatcherTest, AppliesConcurrentMessagesInOneBatch) {
+  Batcher batcher(
+      {.batch_window = absl::Seconds(30), .max_batch_messages = 3},
+      RecordBatches());
+  std::vector<std::thread> threads;
+  for (const auto* message : {"message1", "message2", "message3"}) {
+    threads.emplace_back([&batcher, message] { batcher.Apply(message); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(Batches(), ElementsAre(UnorderedElementsAre(
+                             "message1", "message2", "message3")));
+}
+
+TEST_F(RealtimeUpdateBatcherTest, QueuesMessagesWithoutWaitingForThem) {
+  Batcher batcher({.max_batch_messages = 3}, BlockFirstBatch());
+  std::thread applier([&batcher] { batcher.Apply("first"); });
+  applying_.WaitForNotification();
+  // The batch being applied does not block these calls, so a single thread
+  // fills the next batches.
+  for (const auto* message : {"second1", "second2", "second3", "third1"}) {
+    batcher.Apply(message);
+  }
+  EXPECT_THAT(Batches(), IsEmpty());
+  unblock_.Notify();
+  applier.join();
+  EXPECT_THAT(Batches(),
+              ElementsAre(ElementsAre("first"),
+                          ElementsAre("second1", "second2", "second3"),
+                          ElementsAre("third1")));
+}
+
+TEST_F(RealtimeUpdateBatcherTest, BlocksWhileQueueIsFull) {
+  Batcher batcher({.max_batch_messages = 2, .max_queued_messages = 2},
+                  BlockFirstBatch());
+  std::thread applier([&batcher] { batcher.Apply("first"); });
+  applying_.WaitForNotification();
+  batcher.Apply("second1");
+  batcher.Apply("second2");
+  absl::Notification queued;
+  std::thread blocked([&batcher, &queued] {
+    batcher.Apply("third1");
+    queued.Notify();
+  });
+  EXPECT_FALSE(queued.WaitForNotificationWithTimeout(absl::Milliseconds(100)));
+  unblock_.Notify();
+  blocked.join();
+  applier.join();
+  EXPECT_THAT(Batches(), ElementsAre(ElementsAre("first"),
+                                     ElementsAre("second1", "second2"),
+                                     ElementsAre("third1")));
+}
+
+TEST(KeyValueMutationBatchTest, AppliesLatestMutationOfEachKey) {
+  privacy_sandbox::server_common::log::NoOpContext log_context;
+  MockCache cache;
+  EXPECT_CALL(cache, UpdateKeyValue(_, "key1", "value2", 2, "prefix"))
+      .Times(1);
+  EXPECT_CALL(cache, DeleteKey(_, "key2", 3, "prefix")).Times(1);
+  KeyValueMutationBatch batch;
+  batch.Add("key1", "value1", 1, /*is_deletion=*/false);
+  batch.Add("key1", "value2", 2, /*is_deletion=*/false);
+  batch.Add("key1", "value3", 2, /*is_deletion=*/false);
+  batch.Add("key2", "", 3, /*is_deletion=*/true);
+  batch.Add("key2", "value1", 1, /*is_deletion=*/false);
+  EXPECT_EQ(batch.size(), 2);
+  batch.ApplyTo(cache, log_context, "prefix");
+  EXPECT_EQ(batch.size(), 0);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -15,6 +15,7 @@
 
 #include "absl/log/log.h"
 #include "components/data_server/request_handler/compression/compression_brotli.h"
+#include "components/data_server/request_handler/compression/compression_gzip.h"
 #include "components/data_server/request_handler/compression/uncompressed.h"
 #include "quiche/common/quiche_data_writer.h"
 
@@ -28,20 +29,26 @@ void CompressionGroupConcatenator::AddCompressionGroup(
 
 std::unique_ptr<CompressionGroupConcatenator>
 CompressionGroupConcatenator::Create(CompressionType type) {
-  if (type == CompressionType::kUncompressed) {
-    return std::make_unique<UncompressedConcatenator>();
-  } else {
-    return std::make_unique<BrotliCompressionGroupConcatenator>();
+  switch (type) {
+    case CompressionType::kUncompressed:
+      return std::make_unique<UncompressedConcatenator>();
+    case CompressionType::kGzip:
+      return std::make_unique<GzipCompressionGroupConcatenator>();
+    default:
+      return std::make_unique<BrotliCompressionGroupConcatenator>();
   }
 }
 
 std::unique_ptr<CompressedBlobReader> CompressedBlobReader::Create(
     CompressionGroupConcatenator::CompressionType type,
     std::string_view compressed) {
-  if (type == CompressionGroupConcatenator::CompressionType::kUncompressed) {
-    return std::make_unique<UncompressedBlobReader>(compressed);
-  } else {
-    return std::make_unique<BrotliCompressionBlobReader>(compressed);
+  switch (type) {
+    case CompressionGroupConcatenator::CompressionType::kUncompressed:
+      return std::make_unique<UncompressedBlobReader>(compressed);
+    case CompressionGroupConcatenator::CompressionType::kGzip:
+      return std::make_unique<GzipCompressionBlobReader>(compressed);
+    default:
+      return std::make_unique<BrotliCompressionBlobReader>(compressed);
   }
 }
 
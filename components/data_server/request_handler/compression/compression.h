@@ -41,7 +41,7 @@ class CompressionGroupConcatenator {
  public:
   virtual ~CompressionGroupConcatenator() = default;
 
-  enum class CompressionType { kUncompressed = 0, kBrotli /* TODO: kGzip */ };
+  enum class CompressionType { kUncompressed = 0, kBrotli, kGzip };
 
   static std::unique_ptr<CompressionGroupConcatenator> Create(
       CompressionType type);
@@ -31,34 +31,22 @@ namespace {
 // Responsible for compressing one compression group.
 absl::StatusOr<std::string> CompressOnePartition(std::string_view partition) {
   VLOG(5) << "Compressing " << partition;
-  size_t buffer_size = BrotliEncoderMaxCompressedSize(partition.size());
   // The output consists of the size of the compressed data and the compressed
   // data
-  std::string partition_output(sizeof(uint32_t) + buffer_size, '\0');
-
-  if (auto rc = BrotliEncoderCompress(
-          /*quality=*/BROTLI_DEFAULT_QUALITY,
-          /*lgwin=*/BROTLI_DEFAULT_WINDOW,
-          /*mode=*/BROTLI_DEFAULT_MODE,
-          /*input_size=*/partition.size(),
-          /*input_buffer=*/
-          reinterpret_cast<const uint8_t*>(partition.data()),
-          /*encoded_size=*/&buffer_size,
-          /*encoded_buffer=*/
-          reinterpret_cast<uint8_t*>(&partition_output.at(sizeof(uint32_t))));
-      rc == BROTLI_FALSE) {
-    return absl::InternalError(absl::StrCat("Brotli failed to compress"));
-  }
-  // Shrink the output to only what's used by Brotli.
+  std::string partition_output(sizeof(uint32_t), '\0');
   // TODO(b/278269394): For compression groups, if the compressed value of one
   // group > original value, we should not do compression. But currently we
   // can only use one compression algo for all groups. So we can't simply stop
   // using the algo for one group in that case.
-  partition_output.resize(sizeof(uint32_t) + buffer_size);
+  if (auto status = AppendBrotliCompressed(partition, BROTLI_DEFAULT_QUALITY,
+                                           partition_output);
+      !status.ok()) {
+    return status;
+  }
   quiche::QuicheDataWriter data_writer(sizeof(uint32_t),
                                        partition_output.data());
   // Rewrite the data size to be the real encoded size
-  data_writer.WriteUInt32(buffer_size);
+  data_writer.WriteUInt32(partition_output.size() - sizeof(uint32_t));
   VLOG(5) << "partition output size: " << partition_output.size();
   return partition_output;
 }
@@ -165,6 +153,30 @@ class BrotliDecoder {
 
 }  // namespace
 
+absl::Status AppendBrotliCompressed(std::string_view input, int quality,
+                                    std::string& output) {
+  const size_t offset = output.size();
+  size_t buffer_size = BrotliEncoderMaxCompressedSize(input.size());
+  output.resize(offset + buffer_size);
+  if (auto rc = BrotliEncoderCompress(
+          /*quality=*/quality,
+          /*lgwin=*/BROTLI_DEFAULT_WINDOW,
+          /*mode=*/BROTLI_DEFAULT_MODE,
+          /*input_size=*/input.size(),
+          /*input_buffer=*/
+          reinterpret_cast<const uint8_t*>(input.data()),
+          /*encoded_size=*/&buffer_size,
+          /*encoded_buffer=*/
+          reinterpret_cast<uint8_t*>(&output[offset]));
+      rc == BROTLI_FALSE) {
+    output.resize(offset);
+    return absl::InternalError(absl::StrCat("Brotli failed to compress"));
+  }
+  // Shrink the output to only what's used by Brotli.
+  output.resize(offset + buffer_size);
+  return absl::OkStatus();
+}
+
 absl::StatusOr<std::string> BrotliCompressionGroupConcatenator::Build() const {
   std::vector<std::string> compression_groups;
   // Go through every partition to compress them one by one.
@@ -12,12 +12,22 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_COMPRESSION_BROTLI_H_
+#define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_COMPRESSION_BROTLI_H_
+
 #include <string>
+#include <string_view>
 
+#include "absl/status/status.h"
 #include "components/data_server/request_handler/compression/compression.h"
 
 namespace kv_server {
 
+// Compresses `input` into one Brotli stream of the given `quality` (0-11) and
+// appends it to `output`. On error, `output` is left unchanged.
+absl::Status AppendBrotliCompressed(std::string_view input, int quality,
+                                    std::string& output);
+
 // Builds compression groups that are compressed by Brotli.
 class BrotliCompressionGroupConcatenator : public CompressionGroupConcatenator {
  public:
@@ -34,3 +44,5 @@ class BrotliCompressionBlobReader : public CompressedBlobReader {
 };
 
 }  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_COMPRESSION_BROTLI_H_
@@ -0,0 +1,156 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "components/data_server/request_handler/compression/compression_group_compressor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "brotli/encode.h"
+#include "components/data_server/request_handler/compression/compression_brotli.h"
+#include "components/data_server/request_handler/compression/compression_gzip.h"
+#include "zlib.h"
+
+namespace kv_server {
+
+namespace {
+
+using CompressionType = CompressionGroupCompressor::CompressionType;
+
+absl::Status AppendCompressed(CompressionType type, int level,
+                              std::string_view input, std::string& output) {
+  switch (type) {
+    case CompressionType::kBrotli:
+      return AppendBrotliCompressed(
+          input, level < 0 ? BROTLI_DEFAULT_QUALITY : level, output);
+    case CompressionType::kGzip:
+      return AppendGzipCompressed(
+          input, level < 0 ? Z_DEFAULT_COMPRESSION : level, output);
+    default:
+      output.append(input);
+      return absl::OkStatus();
+  }
+}
+
+// The groups of one response, which the calling thread and the threads of the
+// pool take one at a time. Shared with the tasks scheduled on the pool, which
+// may only start once all groups are compressed.
+struct CompressionBatch {
+  CompressionBatch(CompressionType type, int level,
+                   const std::vector<std::string*>& contents)
+      : type(type),
+        level(level),
+        contents(contents),
+        outputs(contents.size()),
+        statuses(contents.size()),
+        remaining(contents.size()) {}
+
+  // Compresses groups until none is left to take.
+  void CompressGroups() {
+    for (size_t i = next.fetch_add(1); i < contents.size();
+         i = next.fetch_add(1)) {
+      statuses[i] = AppendCompressed(type, level, *contents[i], outputs[i]);
+      remaining.DecrementCount();
+    }
+  }
+
+  const CompressionType type;
+  const int level;
+  const std::vector<std::string*> contents;
+  std::vector<std::string> outputs;
+  std::vector<absl::Status> statuses;
+  std::atomic<size_t> next = 0;
+  // Number of groups that are not compressed yet.
+  absl::BlockingCounter remaining;
+};
+
+}  // namespace
+
+CompressionGroupCompressor::CompressionGroupCompressor(
+    Options options, CompressionThreadPool* thread_pool)
+    : options_(std::move(options)), thread_pool_(thread_pool) {}
+
+std::string_view CompressionGroupCompressor::Name(CompressionType type) {
+  switch (type) {
+    case CompressionType::kBrotli:
+      return "brotli";
+    case CompressionType::kGzip:
+      return "gzip";
+    default:
+      return "none";
+  }
+}
+
+absl::StatusOr<CompressionType> CompressionGroupCompressor::FromName(
+    std::string_view name) {
+  for (CompressionType type :
+       {CompressionType::kUncompressed, CompressionType::kBrotli,
+        CompressionType::kGzip}) {
+    if (name == Name(type)) {
+      return type;
+    }
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("Unknown compression algorithm: ", name));
+}
+
+absl::StatusOr<CompressionType> CompressionGroupCompressor::Compress(
+    const std::vector<std::string*>& contents) const {
+  if (options_.type == CompressionType::kUncompressed) {
+    return CompressionType::kUncompressed;
+  }
+  int64_t total_size = 0;
+  for (const std::string* content : contents) {
+    total_size += content->size();
+  }
+  if (total_size < options_.min_size_bytes) {
+    VLOG(9) << "Not compressing " << total_size << " bytes";
+    return CompressionType::kUncompressed;
+  }
+
+  auto batch = std::make_shared<CompressionBatch>(options_.type,
+                                                 options_.level, contents);
+  if (thread_pool_ != nullptr && contents.size() > 1) {
+    // The calling thread takes one of the groups.
+    const size_t num_tasks = std::min<size_t>(contents.size() - 1,
+                                              thread_pool_->num_threads());
+    for (size_t i = 0; i < num_tasks; ++i) {
+      thread_pool_->Schedule([batch] { batch->CompressGroups(); });
+    }
+  }
+  batch->CompressGroups();
+  batch->remaining.Wait();
+
+  // Contents are only replaced once every group is compressed, so that an
+  // error leaves them as is.
+  for (const absl::Status& status : batch->statuses) {
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  for (size_t i = 0; i < contents.size(); ++i) {
+    VLOG(9) << "Compressed " << contents[i]->size() << " bytes into "
+            << batch->outputs[i].size();
+    *contents[i] = std::move(batch->outputs[i]);
+  }
+  return options_.type;
+}
+
+}  // namespace kv_server
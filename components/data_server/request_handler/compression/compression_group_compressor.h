@@ -0,0 +1,90 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_COMPRESSION_GROUP_COMPRESSOR_H_
+#define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_COMPRESSION_GROUP_COMPRESSOR_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/status/statusor.h"
+#include "components/data_server/request_handler/compression/compression.h"
+#include "components/data_server/request_handler/compression/compression_thread_pool.h"
+
+namespace kv_server {
+
+// Compresses the content of each compression group of a V2 response on its
+// own, as specified by
+// https://github.com/WICG/turtledove/blob/main/FLEDGE_Key_Value_Server_API.md#response-version-20
+// Groups are compressed in parallel on a thread pool shared across requests,
+// which the calling thread helps, so that requests neither spawn threads of
+// their own nor wait for groups queued behind other requests.
+//
+// Thread-safe, can be shared across requests.
+class CompressionGroupCompressor {
+ public:
+  using CompressionType = CompressionGroupConcatenator::CompressionType;
+
+  struct Options {
+    CompressionType type = CompressionType::kUncompressed;
+    // Brotli quality (0-11) or zlib level (0-9). Negative values select the
+    // default of the algorithm. Note that Brotli defaults to its best and by
+    // far slowest quality, see compression_benchmark for the trade-offs.
+    int level = -1;
+    // The algorithm applies to all the groups of a response, so responses
+    // whose groups add up to fewer bytes are left uncompressed altogether,
+    // since compressing them costs more CPU than it saves in bytes.
+    int64_t min_size_bytes = 0;
+  };
+
+  // Without `thread_pool`, groups are compressed one after the other on the
+  // calling thread. `thread_pool` is not owned and must outlive the
+  // compressor.
+  explicit CompressionGroupCompressor(
+      Options options, CompressionThreadPool* thread_pool = nullptr);
+
+  const Options& options() const { return options_; }
+  CompressionType type() const { return options_.type; }
+
+  // Name of the algorithm in `GetValuesRequest.accept_compression`.
+  static std::string_view Name(CompressionType type);
+
+  // Returns the algorithm named `name`, or an error if there is none.
+  static absl::StatusOr<CompressionType> FromName(std::string_view name);
+
+  // Whether the `accepted` algorithm names of a request include the one of
+  // this compressor, which never holds for `kUncompressed`.
+  template <typename Names>
+  bool IsAcceptedBy(const Names& accepted) const {
+    return options_.type != CompressionType::kUncompressed &&
+           absl::c_linear_search(accepted, Name(options_.type));
+  }
+
+  // Replaces each of `contents` by its compressed form and returns the
+  // algorithm used, which is `kUncompressed` if the contents were left as is.
+  // On error, the contents are left as is.
+  absl::StatusOr<CompressionType> Compress(
+      const std::vector<std::string*>& contents) const;
+
+ private:
+  const Options options_;
+  CompressionThreadPool* const thread_pool_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_COMPRESSION_GROUP_COMPRESSOR_H_
@@ -0,0 +1,228 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/request_handler/compression/compression_group_compressor.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "components/data_server/request_handler/compression/uncompressed.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using CompressionType = CompressionGroupCompressor::CompressionType;
+
+struct TestingParameters {
+  CompressionType type;
+  int level;
+  // Groups are compressed on the calling thread only if 0.
+  int num_threads;
+};
+
+class CompressionGroupCompressorTest
+    : public ::testing::TestWithParam<TestingParameters> {
+ protected:
+  CompressionGroupCompressorTest()
+      : thread_pool_(GetParam().num_threads > 0
+                         ? std::make_unique<CompressionThreadPool>(
+                               GetParam().num_threads)
+                         : nullptr) {}
+
+  CompressionGroupCompressor CreateCompressor(int64_t min_size_bytes = 0) {
+    return CompressionGroupCompressor(
+        {
+            .type = GetParam().type,
+            .level = GetParam().level,
+            .min_size_bytes = min_size_bytes,
+        },
+        thread_pool_.get());
+  }
+
+ private:
+  std::unique_ptr<CompressionThreadPool> thread_pool_;
+};
+
+INSTANTIATE_TEST_SUITE_P(
+    CompressionGroupCompressorTest, CompressionGroupCompressorTest,
+    testing::Values(
+        TestingParameters{CompressionType::kBrotli, -1, 0},
+        TestingParameters{CompressionType::kBrotli, 5, 4},
+        TestingParameters{CompressionType::kGzip, -1, 0},
+        TestingParameters{CompressionType::kGzip, 1, 4},
+        TestingParameters{CompressionType::kGzip, 9, 16}));
+
+std::vector<std::string*> Pointers(std::vector<std::string>& contents) {
+  std::vector<std::string*> pointers;
+  for (auto& content : contents) {
+    pointers.push_back(&content);
+  }
+  return pointers;
+}
+
+// Reads back the compressed contents, which have no size prefix, through the
+// blob reader of their algorithm.
+std::vector<std::string> Decompress(CompressionType type,
+                                    const std::vector<std::string>& contents) {
+  UncompressedConcatenator concatenator;
+  for (const auto& content : contents) {
+    concatenator.AddCompressionGroup(content);
+  }
+  auto blob = concatenator.Build();
+  EXPECT_TRUE(blob.ok()) << blob.status();
+  auto blob_reader = CompressedBlobReader::Create(type, *blob);
+  std::vector<std::string> decompressed;
+  while (!blob_reader->IsDoneReading()) {
+    auto group = blob_reader->ExtractOneCompressionGroup();
+    EXPECT_TRUE(group.ok()) << group.status();
+    if (!group.ok()) {
+      break;
+    }
+    decompressed.push_back(*std::move(group));
+  }
+  return decompressed;
+}
+
+TEST_P(CompressionGroupCompressorTest, CompressesEachGroup) {
+  std::vector<std::string> groups = {"", std::string(1000, 'a')};
+  for (int i = 0; i < 20; ++i) {
+    std::string group;
+    for (int j = 0; j < 100 * i; ++j) {
+      absl::StrAppend(&group, R"({"key)", j, R"(":{"value":")", i * j, "\"}");
+    }
+    groups.push_back(std::move(group));
+  }
+  std::vector<std::string> contents = groups;
+  CompressionGroupCompressor compressor = CreateCompressor();
+
+  auto type = compressor.Compress(Pointers(contents));
+  ASSERT_TRUE(type.ok()) << type.status();
+  EXPECT_EQ(*type, GetParam().type);
+  EXPECT_LT(contents[1].size(), groups[1].size());
+  EXPECT_EQ(Decompress(GetParam().type, contents), groups);
+}
+
+TEST_P(CompressionGroupCompressorTest, SkipsResponsesBelowMinSize) {
+  std::vector<std::string> groups = {std::string(10, 'a'),
+                                     std::string(20, 'b')};
+  std::vector<std::string> contents = groups;
+  CompressionGroupCompressor compressor =
+      CreateCompressor(/*min_size_bytes=*/31);
+
+  auto type = compressor.Compress(Pointers(contents));
+  ASSERT_TRUE(type.ok()) << type.status();
+  EXPECT_EQ(*type, CompressionType::kUncompressed);
+  EXPECT_EQ(contents, groups);
+
+  contents.push_back("c");
+  groups.push_back("c");
+  type = compressor.Compress(Pointers(contents));
+  ASSERT_TRUE(type.ok()) << type.status();
+  EXPECT_EQ(*type, GetParam().type);
+  EXPECT_EQ(Decompress(GetParam().type, contents), groups);
+}
+
+TEST_P(CompressionGroupCompressorTest, CompressesNoGroups) {
+  CompressionGroupCompressor compressor = CreateCompressor();
+  auto type = compressor.Compress({});
+  ASSERT_TRUE(type.ok()) << type.status();
+  EXPECT_EQ(*type, GetParam().type);
+}
+
+TEST(CompressionGroupCompressorTest, UncompressedLeavesContentsAsIs) {
+  std::vector<std::string> contents = {std::string(1000, 'a'), "b"};
+  CompressionGroupCompressor compressor(
+      {.type = CompressionType::kUncompressed});
+  auto type = compressor.Compress(Pointers(contents));
+  ASSERT_TRUE(type.ok()) << type.status();
+  EXPECT_EQ(*type, CompressionType::kUncompressed);
+  EXPECT_THAT(contents, testing::ElementsAre(std::string(1000, 'a'), "b"));
+}
+
+TEST(CompressionGroupCompressorTest, InvalidLevelLeavesContentsAsIs) {
+  std::vector<std::string> contents = {std::string(1000, 'a'), "b"};
+  CompressionGroupCompressor compressor(
+      {.type = CompressionType::kGzip, .level = 10});
+  EXPECT_FALSE(compressor.Compress(Pointers(contents)).ok());
+  EXPECT_THAT(contents, testing::ElementsAre(std::string(1000, 'a'), "b"));
+}
+
+TEST(CompressionGroupCompressorTest,
+     InvalidLevelLeavesContentsAsIsWithThreadPool) {
+  std::vector<std::string> contents = {std::string(1000, 'a'), "b", "c"};
+  CompressionThreadPool thread_pool(/*num_threads=*/2);
+  CompressionGroupCompressor compressor(
+      {.type = CompressionType::kGzip, .level = 10}, &thread_pool);
+  EXPECT_FALSE(compressor.Compress(Pointers(contents)).ok());
+  EXPECT_THAT(contents,
+              testing::ElementsAre(std::string(1000, 'a'), "b", "c"));
+}
+
+TEST(CompressionGroupCompressorTest, SharesThreadPoolAcrossRequests) {
+  CompressionThreadPool thread_pool(/*num_threads=*/2);
+  CompressionGroupCompressor compressor({.type = CompressionType::kGzip},
+                                        &thread_pool);
+  std::vector<std::string> groups(8, std::string(1000, 'a'));
+  std::vector<std::thread> requests;
+  for (int i = 0; i < 8; ++i) {
+    requests.emplace_back([&compressor, &groups] {
+      std::vector<std::string> contents = groups;
+      auto type = compressor.Compress(Pointers(contents));
+      ASSERT_TRUE(type.ok()) << type.status();
+      EXPECT_EQ(Decompress(CompressionType::kGzip, contents), groups);
+    });
+  }
+  for (auto& request : requests) {
+    request.join();
+  }
+}
+
+TEST(CompressionGroupCompressorTest, Name) {
+  EXPECT_EQ(CompressionGroupCompressor::Name(CompressionType::kUncompressed),
+            "none");
+  EXPECT_EQ(CompressionGroupCompressor::Name(CompressionType::kBrotli),
+            "brotli");
+  EXPECT_EQ(CompressionGroupCompressor::Name(CompressionType::kGzip), "gzip");
+}
+
+TEST(CompressionGroupCompressorTest, FromName) {
+  for (CompressionType type :
+       {CompressionType::kUncompressed, CompressionType::kBrotli,
+        CompressionType::kGzip}) {
+    auto from_name = CompressionGroupCompressor::FromName(
+        CompressionGroupCompressor::Name(type));
+    ASSERT_TRUE(from_name.ok()) << from_name.status();
+    EXPECT_EQ(*from_name, type);
+  }
+  EXPECT_FALSE(CompressionGroupCompressor::FromName("zstd").ok());
+}
+
+TEST(CompressionGroupCompressorTest, IsAcceptedBy) {
+  const std::vector<std::string> accepted = {"none", "gzip"};
+  EXPECT_TRUE(CompressionGroupCompressor({.type = CompressionType::kGzip})
+                  .IsAcceptedBy(accepted));
+  EXPECT_FALSE(CompressionGroupCompressor({.type = CompressionType::kBrotli})
+                   .IsAcceptedBy(accepted));
+  EXPECT_FALSE(
+      CompressionGroupCompressor({.type = CompressionType::kUncompressed})
+          .IsAcceptedBy(accepted));
+}
+
+}  // namespace
+}  // namespace kv_server
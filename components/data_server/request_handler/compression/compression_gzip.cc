@@ -0,0 +1,136 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "components/data_server/request_handler/compression/compression_gzip.h"
+
+#include <limits>
+#include <string>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "quiche/common/quiche_data_writer.h"
+#include "zlib.h"
+
+namespace kv_server {
+
+namespace {
+
+// Adding 16 to the default window bits makes zlib write (and expect) a gzip
+// header and trailer instead of a zlib one.
+constexpr int kGzipWindowBits = 15 + 16;
+constexpr int kMemLevel = 8;
+constexpr size_t kInflateChunkSize = 16 * 1024;
+
+}  // namespace
+
+absl::Status AppendGzipCompressed(std::string_view input, int level,
+                                  std::string& output) {
+  if (input.size() > std::numeric_limits<uInt>::max()) {
+    return absl::InvalidArgumentError("Input is too large for gzip");
+  }
+  z_stream stream = {};
+  if (deflateInit2(&stream, level, Z_DEFLATED, kGzipWindowBits, kMemLevel,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return absl::InternalError("gzip encoder cannot be initialized");
+  }
+  const size_t offset = output.size();
+  // Large enough for a single deflate call, header and trailer included.
+  output.resize(offset + deflateBound(&stream, input.size()));
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = input.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&output[offset]);
+  stream.avail_out = output.size() - offset;
+  const int rc = deflate(&stream, Z_FINISH);
+  deflateEnd(&stream);
+  if (rc != Z_STREAM_END) {
+    output.resize(offset);
+    return absl::InternalError(absl::StrCat("gzip failed to compress: ", rc));
+  }
+  output.resize(offset + stream.total_out);
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::string> GzipDecompress(std::string_view compressed) {
+  if (compressed.size() > std::numeric_limits<uInt>::max()) {
+    return absl::InvalidArgumentError("Input is too large for gzip");
+  }
+  z_stream stream = {};
+  if (inflateInit2(&stream, kGzipWindowBits) != Z_OK) {
+    return absl::InternalError("gzip decoder cannot be initialized");
+  }
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+  stream.avail_in = compressed.size();
+  std::string output;
+  int rc = Z_OK;
+  while (rc == Z_OK) {
+    const size_t offset = output.size();
+    output.resize(offset + kInflateChunkSize);
+    stream.next_out = reinterpret_cast<Bytef*>(&output[offset]);
+    stream.avail_out = kInflateChunkSize;
+    rc = inflate(&stream, Z_NO_FLUSH);
+    output.resize(offset + kInflateChunkSize - stream.avail_out);
+  }
+  inflateEnd(&stream);
+  switch (rc) {
+    case Z_STREAM_END:
+      if (stream.avail_in != 0) {
+        return absl::DataLossError("corrupted (exuberant) input");
+      }
+      return output;
+    case Z_BUF_ERROR:
+      // Since there is always room for output, zlib only reports this once
+      // the input is exhausted before the end of the stream.
+      return absl::DataLossError("corrupted (truncated) input");
+    default:
+      return absl::DataLossError(absl::StrCat(
+          "corrupted input: ", stream.msg != nullptr ? stream.msg : ""));
+  }
+}
+
+absl::StatusOr<std::string> GzipCompressionGroupConcatenator::Build() const {
+  std::string output;
+  // Go through every partition to compress them one by one.
+  for (const auto& partition : Partitions()) {
+    VLOG(5) << "Compressing " << partition;
+    // Each compression group consists of the size of the compressed data and
+    // the compressed data.
+    const size_t offset = output.size();
+    output.resize(offset + sizeof(uint32_t));
+    if (auto status =
+            AppendGzipCompressed(partition, Z_DEFAULT_COMPRESSION, output);
+        !status.ok()) {
+      return status;
+    }
+    quiche::QuicheDataWriter data_writer(sizeof(uint32_t), &output[offset]);
+    data_writer.WriteUInt32(output.size() - offset - sizeof(uint32_t));
+  }
+  return output;
+}
+
+absl::StatusOr<std::string>
+GzipCompressionBlobReader::ExtractOneCompressionGroup() {
+  uint32_t compression_group_size = 0;
+  if (!data_reader_.ReadUInt32(&compression_group_size)) {
+    return absl::InvalidArgumentError("Failed to read compression group size");
+  }
+  VLOG(9) << "compression_group_size: " << compression_group_size;
+  std::string_view compressed_data;
+  if (!data_reader_.ReadStringPiece(&compressed_data, compression_group_size)) {
+    return absl::InvalidArgumentError("Failed to read compression group");
+  }
+  return GzipDecompress(compressed_data);
+}
+
+}  // namespace kv_server
@@ -0,0 +1,53 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_COMPRESSION_GZIP_H_
+#define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_COMPRESSION_GZIP_H_
+
+#include <string>
+#include <string_view>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "components/data_server/request_handler/compression/compression.h"
+
+namespace kv_server {
+
+// Compresses `input` into one gzip member of the given zlib `level` (0-9, or
+// -1 for zlib's default) and appends it to `output`. On error, `output` is
+// left unchanged.
+absl::Status AppendGzipCompressed(std::string_view input, int level,
+                                  std::string& output);
+
+// Decompresses the gzip member `compressed`.
+absl::StatusOr<std::string> GzipDecompress(std::string_view compressed);
+
+// Builds compression groups that are compressed by gzip.
+class GzipCompressionGroupConcatenator : public CompressionGroupConcatenator {
+ public:
+  absl::StatusOr<std::string> Build() const override;
+};
+
+// Reads compression groups built with GzipCompressionGroupConcatenator.
+class GzipCompressionBlobReader : public CompressedBlobReader {
+ public:
+  explicit GzipCompressionBlobReader(std::string_view compressed)
+      : CompressedBlobReader(compressed) {}
+
+  absl::StatusOr<std::string> ExtractOneCompressionGroup() override;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_COMPRESSION_GZIP_H_
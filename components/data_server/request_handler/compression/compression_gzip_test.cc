@@ -0,0 +1,104 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/request_handler/compression/compression_gzip.h"
+
+#include <string>
+#include <string_view>
+
+#include "absl/log/log.h"
+#include "components/data_server/request_handler/compression/uncompressed.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+const std::string_view kTestString = "large message";
+const std::string_view kTestString2 = "large message 2";
+
+TEST(GzipCompressionBlobReaderTest, Success) {
+  // "qwertyuiop" compressed by `gzip -n`.
+  const unsigned char gzip_data[] = {
+      0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+      0x2b, 0x2c, 0x4f, 0x2d, 0x2a, 0xa9, 0x2c, 0xcd, 0xcc, 0x2f,
+      0x00, 0x00, 0x2d, 0x2c, 0xc9, 0x40, 0x0a, 0x00, 0x00, 0x00};
+
+  UncompressedConcatenator concatenator;
+  concatenator.AddCompressionGroup(
+      std::string(reinterpret_cast<const char*>(gzip_data), sizeof(gzip_data)));
+  auto maybe_compression_group_blob = concatenator.Build();
+  ASSERT_TRUE(maybe_compression_group_blob.ok());
+
+  GzipCompressionBlobReader blob_reader(*maybe_compression_group_blob);
+
+  EXPECT_FALSE(blob_reader.IsDoneReading());
+
+  auto maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+  ASSERT_TRUE(maybe_compression_group.ok()) << maybe_compression_group.status();
+  EXPECT_EQ(*maybe_compression_group, "qwertyuiop");
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(GzipCompressionGroupConcatenatorTest, Success) {
+  GzipCompressionGroupConcatenator concatenator;
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  concatenator.AddCompressionGroup(std::string(kTestString2));
+  std::string large_message(500000, 'a');
+  concatenator.AddCompressionGroup(large_message);
+
+  auto maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok()) << maybe_output.status();
+  LOG(INFO) << "compressed size: " << maybe_output->size();
+
+  GzipCompressionBlobReader blob_reader(*maybe_output);
+
+  EXPECT_FALSE(blob_reader.IsDoneReading());
+
+  auto maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+  EXPECT_TRUE(maybe_compression_group.ok());
+  EXPECT_EQ(*maybe_compression_group, kTestString);
+  EXPECT_FALSE(blob_reader.IsDoneReading());
+
+  maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+  EXPECT_TRUE(maybe_compression_group.ok());
+  EXPECT_EQ(*maybe_compression_group, kTestString2);
+  EXPECT_FALSE(blob_reader.IsDoneReading());
+
+  maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+  EXPECT_TRUE(maybe_compression_group.ok());
+  EXPECT_EQ(*maybe_compression_group, large_message);
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(GzipDecompressTest, RejectsCorruptedInput) {
+  std::string compressed;
+  ASSERT_TRUE(AppendGzipCompressed(kTestString, 6, compressed).ok());
+  auto decompressed = GzipDecompress(compressed);
+  ASSERT_TRUE(decompressed.ok()) << decompressed.status();
+  EXPECT_EQ(*decompressed, kTestString);
+
+  EXPECT_EQ(GzipDecompress("").status().code(), absl::StatusCode::kDataLoss);
+  const std::string_view truncated = std::string_view(compressed).substr(0, 15);
+  EXPECT_EQ(GzipDecompress(truncated).status().code(),
+            absl::StatusCode::kDataLoss);
+  EXPECT_EQ(GzipDecompress(compressed + "x").status().code(),
+            absl::StatusCode::kDataLoss);
+  compressed[12] ^= 0xff;
+  EXPECT_EQ(GzipDecompress(compressed).status().code(),
+            absl::StatusCode::kDataLoss);
+}
+
+}  // namespace
+}  // namespace kv_server
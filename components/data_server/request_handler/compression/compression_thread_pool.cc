@@ -0,0 +1,57 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "components/data_server/request_handler/compression/compression_thread_pool.h"
+
+#include <utility>
+
+namespace kv_server {
+
+CompressionThreadPool::CompressionThreadPool(int num_threads) {
+  threads_.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back([this] { Work(); });
+  }
+}
+
+CompressionThreadPool::~CompressionThreadPool() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stopping_ = true;
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void CompressionThreadPool::Schedule(absl::AnyInvocable<void() &&> task) {
+  absl::MutexLock lock(&mutex_);
+  tasks_.push_back(std::move(task));
+}
+
+void CompressionThreadPool::Work() {
+  while (true) {
+    mutex_.LockWhen(
+        absl::Condition(this, &CompressionThreadPool::HasTaskOrStopping));
+    if (tasks_.empty()) {
+      mutex_.Unlock();
+      return;
+    }
+    absl::AnyInvocable<void() &&> task = std::move(tasks_.front());
+    tasks_.pop_front();
+    mutex_.Unlock();
+    std::move(task)();
+  }
+}
+
+}  // namespace kv_server
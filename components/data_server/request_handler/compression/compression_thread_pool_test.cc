@@ -0,0 +1,57 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/request_handler/compression/compression_thread_pool.h"
+
+#include <atomic>
+
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/notification.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(CompressionThreadPoolTest, RunsTasksInParallel) {
+  CompressionThreadPool thread_pool(/*num_threads=*/2);
+  EXPECT_EQ(thread_pool.num_threads(), 2);
+  absl::BlockingCounter started(2);
+  absl::Notification release;
+  for (int i = 0; i < 2; ++i) {
+    thread_pool.Schedule([&started, &release] {
+      started.DecrementCount();
+      release.WaitForNotification();
+    });
+  }
+  // Only returns if both tasks run at the same time.
+  started.Wait();
+  release.Notify();
+}
+
+TEST(CompressionThreadPoolTest, RunsQueuedTasksBeforeDestruction) {
+  std::atomic<int> num_runs = 0;
+  {
+    absl::Notification release;
+    CompressionThreadPool thread_pool(/*num_threads=*/1);
+    thread_pool.Schedule([&release] { release.WaitForNotification(); });
+    for (int i = 0; i < 10; ++i) {
+      thread_pool.Schedule([&num_runs] { ++num_runs; });
+    }
+    release.Notify();
+  }
+  EXPECT_EQ(num_runs, 10);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -20,8 +20,8 @@
 #include <vector>
 
 #include "components/data/converters/cbor_converter.h"
+#include "components/data/converters/partition_output_cbor_writer.h"
 #include "components/errors/error_tag.h"
-#include "public/applications/pa/response_utils.h"
 #include "src/util/status_macro/status_macros.h"
 
 namespace kv_server {
@@ -41,34 +41,21 @@ absl::StatusOr<std::string> CborV2EncoderDecoder::EncodeV2GetValuesResponse(
 absl::StatusOr<std::string> CborV2EncoderDecoder::EncodePartitionOutputs(
     std::vector<std::pair<int32_t, std::string>>& partition_output_pairs,
     const RequestContextFactory& request_context_factory) const {
-  google::protobuf::RepeatedPtrField<application_pa::PartitionOutput>
-      partition_outputs;
-  for (auto& partition_output_pair : partition_output_pairs) {
-    auto partition_output =
-        application_pa::PartitionOutputFromJson(partition_output_pair.second);
-    if (partition_output.ok()) {
-      partition_output.value().set_id(partition_output_pair.first);
-      *partition_outputs.Add() = partition_output.value();
-    } else {
-      PS_VLOG(2, request_context_factory.Get().GetPSLogContext())
-          << partition_output.status();
+  PartitionOutputsCborWriter writer(partition_output_pairs.size());
+  for (const auto& [id, partition_output_json] : partition_output_pairs) {
+    if (const auto status = writer.Add(id, partition_output_json);
+        !status.ok()) {
+      PS_VLOG(2, request_context_factory.Get().GetPSLogContext()) << status;
     }
   }
 
-  if (partition_outputs.empty()) {
+  if (writer.size() == 0) {
     return StatusWithErrorTag(
         absl::InternalError(
             "Parsing partition output proto from json failed for all outputs"),
         __FILE__, ErrorTag::kParsePartitionOutput);
   }
-
-  const auto cbor_string = PartitionOutputsCborEncode(partition_outputs);
-  if (!cbor_string.ok()) {
-    PS_VLOG(2, request_context_factory.Get().GetPSLogContext())
-        << "CBOR encode failed for partition outputs";
-    return cbor_string.status();
-  }
-  return cbor_string.value();
+  return std::move(writer).Finish();
 }
 
 absl::StatusOr<v2::GetValuesRequest>
@@ -44,7 +44,6 @@ enum class ErrorTag : int {
 
 using google::protobuf::RepeatedPtrField;
 using google::protobuf::Struct;
-using google::protobuf::Value;
 using google::protobuf::util::JsonStringToMessage;
 
 constexpr char kKeysTag[] = "keys";
@@ -102,24 +101,21 @@ void ProcessKeyValues(
     application_pa::KeyGroupOutput key_group_output,
     google::protobuf::Map<std::string, v1::V1SingleLookupResult>&
         result_struct) {
-  for (auto&& [k, v] : std::move(key_group_output.key_values())) {
+  for (auto& [k, v] : *key_group_output.mutable_key_values()) {
     v1::V1SingleLookupResult result;
     if (v.value().has_string_value()) {
-      Value value_proto;
       absl::Status status =
-          JsonStringToMessage(v.value().string_value(), &value_proto);
-      if (status.ok()) {
-        *result.mutable_value() = value_proto;
-      } else {
+          JsonStringToMessage(v.value().string_value(), result.mutable_value());
+      if (!status.ok()) {
         // If string is not a Json string that can be parsed into Value
         // proto,
         // simply set it as pure string value to the response.
-        *result.mutable_value() = std::move(v.value());
+        *result.mutable_value() = std::move(*v.mutable_value());
       }
     } else {
-      *result.mutable_value() = std::move(v.value());
+      *result.mutable_value() = std::move(*v.mutable_value());
     }
-    result_struct[std::move(k)] = std::move(result);
+    result_struct[k] = std::move(result);
   }
 }
 
@@ -201,14 +197,14 @@ absl::Status ConvertToV1Response(RequestContextFactory& request_context_factory,
   // string_output should be a JSON object
   PS_VLOG(7, request_context_factory.Get().GetPSLogContext())
       << "Received v2 response: " << v2_response.DebugString();
-  const auto outputs = application_pa::PartitionOutputFromJson(string_output);
+  auto outputs = application_pa::PartitionOutputFromJson(string_output);
   if (!outputs.ok()) {
     PS_LOG(ERROR, request_context_factory.Get().GetPSLogContext())
         << outputs.status();
     return outputs.status();
   }
-  for (const auto& key_group_output : outputs->key_group_outputs()) {
-    ProcessKeyGroupOutput(key_group_output, v1_response);
+  for (auto& key_group_output : *outputs->mutable_key_group_outputs()) {
+    ProcessKeyGroupOutput(std::move(key_group_output), v1_response);
   }
 
   return absl::OkStatus();
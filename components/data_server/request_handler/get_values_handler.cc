@@ -33,8 +33,6 @@
 namespace kv_server {
 namespace {
 using google::protobuf::RepeatedPtrField;
-using google::protobuf::Struct;
-using google::protobuf::Value;
 using grpc::StatusCode;
 using v1::GetValuesRequest;
 using v1::GetValuesResponse;
@@ -59,12 +57,17 @@ void ProcessKeys(
     bool add_missing_keys_v1) {
   if (keys.empty()) return;
   auto actual_keys = GetKeys(keys);
-  auto kv_pairs = cache.GetKeyValuePairs(request_context, actual_keys);
+  // Values that are not JSON strings that can be parsed into Value protos are
+  // returned as pure string values. The cache may have parsed the values when
+  // they were loaded, in which case only the binary Value protos are parsed
+  // here.
+  auto json_values =
+      cache.GetSerializedJsonValues(request_context, actual_keys);
   // TODO(b/326118416): Record cache hit and miss metrics
   for (const auto& key : actual_keys) {
     v1::V1SingleLookupResult result;
-    const auto key_iter = kv_pairs.find(key);
-    if (key_iter == kv_pairs.end()) {
+    const auto key_iter = json_values.find(key);
+    if (key_iter == json_values.end()) {
       if (add_missing_keys_v1) {
         auto status = result.mutable_status();
         status->set_code(static_cast<int>(absl::StatusCode::kNotFound));
@@ -72,17 +75,12 @@ void ProcessKeys(
         result_struct[key] = std::move(result);
       }
     } else {
-      Value value_proto;
-      absl::Status status = google::protobuf::util::JsonStringToMessage(
-          key_iter->second, &value_proto);
-      if (status.ok()) {
-        *result.mutable_value() = value_proto;
-      } else {
-        // If string is not a Json string that can be parsed into Value
-        // proto, simply set it as pure string value to the response.
-        google::protobuf::Value value;
-        value.set_string_value(std::move(key_iter->second));
-        *result.mutable_value() = std::move(value);
+      if (!result.mutable_value()->ParseFromString(key_iter->second)) {
+        PS_LOG(ERROR, request_context.GetPSLogContext())
+            << "Failed to parse the cached value of " << key;
+        auto status = result.mutable_status();
+        status->set_code(static_cast<int>(absl::StatusCode::kInternal));
+        status->set_message("Invalid cached value");
       }
       result_struct[key] = std::move(result);
     }
@@ -311,6 +311,59 @@ TEST_F(GetValuesHandlerTest, TestResponseOnDifferentValueFormats) {
   EXPECT_THAT(response, EqualsProto(expected_from_json));
 }
 
+class SafePathTestLogContext
+    : public privacy_sandbox::server_common::log::SafePathContext {
+ public:
+  SafePathTestLogContext() = default;
+};
+
+TEST_F(GetValuesHandlerTest, TestResponseOnValuesParsedOnLoad) {
+  auto cache = KeyValueCache::Create({.parse_json_values = true});
+  SafePathTestLogContext log_context;
+  cache->UpdateKeyValue(log_context, "key1", R"json({"k1": [1, "v"]})json",
+                        1);
+  cache->UpdateKeyValue(log_context, "key2", "v2", 1);
+
+  GetValuesRequest request;
+  request.add_keys("key1,key2,key3");
+  GetValuesResponse response;
+  GetValuesHandler handler(*cache, mock_get_values_adapter_,
+                           /*use_v2=*/false);
+  ASSERT_TRUE(
+      handler.GetValues(GetRequestContextFactory(), request, &response).ok());
+  GetValuesResponse expected;
+  TextFormat::ParseFromString(
+      R"pb(
+        keys {
+          key: "key1"
+          value {
+            value {
+              struct_value {
+                fields {
+                  key: "k1"
+                  value {
+                    list_value {
+                      values { number_value: 1 }
+                      values { string_value: "v" }
+                    }
+                  }
+                }
+              }
+            }
+          }
+        }
+        keys {
+          key: "key2"
+          value { value { string_value: "v2" } }
+        }
+        keys {
+          key: "key3"
+          value { status { code: 5 message: "Key not found" } }
+        })pb",
+      &expected);
+  EXPECT_THAT(response, EqualsProto(expected));
+}
+
 TEST_F(GetValuesHandlerTest, CallsV2Adapter) {
   GetValuesResponse adapter_response;
   TextFormat::ParseFromString(R"pb(keys {
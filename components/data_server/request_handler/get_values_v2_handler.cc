@@ -14,6 +14,8 @@
 
 #include "components/data_server/request_handler/get_values_v2_handler.h"
 
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -22,11 +24,14 @@
 #include <vector>
 
 #include "absl/algorithm/container.h"
+#include "absl/functional/function_ref.h"
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/ascii.h"
+#include "absl/synchronization/notification.h"
 #include "components/data/converters/cbor_converter.h"
 #include "components/data_server/request_handler/encryption/ohttp_server_encryptor.h"
+#include "components/data_server/request_handler/partitions/multi_partition_processor.h"
 #include "components/data_server/request_handler/partitions/partition_processor.h"
 #include "components/data_server/request_handler/status/get_values_v2_status.h"
 #include "components/telemetry/server_definition.h"
@@ -39,7 +44,6 @@
 #include "public/query/v2/get_values_v2.grpc.pb.h"
 #include "quiche/oblivious_http/common/oblivious_http_header_key_config.h"
 #include "quiche/oblivious_http/oblivious_http_gateway.h"
-#include "src/communication/encoding_utils.h"
 #include "src/communication/framing_utils.h"
 #include "src/telemetry/telemetry.h"
 #include "src/util/status_macro/status_macros.h"
@@ -49,11 +53,139 @@ namespace {
 
 using grpc::StatusCode;
 using privacy_sandbox::server_common::FromAbslStatus;
+using privacy_sandbox::server_common::ToAbslStatus;
 using v2::GetValuesHttpRequest;
 using v2::ObliviousGetValuesRequest;
 
 constexpr std::string_view kIsPas = "is_pas";
 
+// Calls `start` with a callback and blocks until that callback is invoked.
+grpc::Status WaitForCallback(
+    absl::FunctionRef<void(GetValuesV2Handler::DoneCallback)> start,
+    ExecutionMetadata& execution_metadata) {
+  absl::Notification done;
+  grpc::Status status;
+  start([&](grpc::Status callback_status,
+            ExecutionMetadata callback_execution_metadata) {
+    status = std::move(callback_status);
+    execution_metadata = std::move(callback_execution_metadata);
+    done.Notify();
+  });
+  done.WaitForNotification();
+  return status;
+}
+
+// Sets up the log context of `request`, whose debug info goes to `response`,
+// and checks that the request has partitions.
+grpc::Status PrepareRequest(RequestContextFactory& request_context_factory,
+                            const v2::GetValuesRequest& request,
+                            v2::GetValuesResponse* response) {
+  PS_VLOG(9) << "Update log context " << request.log_context() << ";"
+             << request.consented_debug_config();
+  request_context_factory.UpdateLogContext(
+      request.log_context(), request.consented_debug_config(),
+      [response]() { return response->mutable_debug_info(); });
+  PS_VLOG(9, request_context_factory.Get().GetPSLogContext())
+      << "v2 GetValuesRequest: " << request;
+  if (request.partitions().empty()) {
+    return grpc::Status(StatusCode::INTERNAL,
+                        "At least 1 partition is required");
+  }
+  return grpc::Status::OK;
+}
+
+// Size of the framing header of OHTTP plaintexts: one byte for the framing
+// version and compression algorithm, followed by the size of the payload in 4
+// bytes, in network byte order. See
+// https://github.com/WICG/turtledove/blob/main/FLEDGE_Key_Value_Server_API.md#encryption
+constexpr size_t kFramingHeaderSize = 5;
+
+// Returns the payload of the framed and padded `plaintext`, like
+// `DecodeRequestPayload` does, but without copying it. The compression
+// algorithm is not used, since requests are never compressed.
+absl::StatusOr<std::string_view> DeframeRequest(std::string_view plaintext) {
+  if (plaintext.size() < kFramingHeaderSize) {
+    return absl::InvalidArgumentError(
+        "Request is shorter than its framing header");
+  }
+  uint32_t payload_size = 0;
+  for (size_t i = 1; i < kFramingHeaderSize; ++i) {
+    payload_size = (payload_size << 8) | static_cast<uint8_t>(plaintext[i]);
+  }
+  if (payload_size > plaintext.size() - kFramingHeaderSize) {
+    return absl::InvalidArgumentError(
+        "Request is shorter than the payload size in its framing header");
+  }
+  return plaintext.substr(kFramingHeaderSize, payload_size);
+}
+
+// Frames the `response`, whose compression groups were compressed with
+// `compression_type`, and pads it to `encoded_data_size` bytes, like
+// `EncodeResponsePayload` does, but in place. The framing version is 0, and
+// the compression algorithms have the values of the framing header.
+void FrameResponse(size_t encoded_data_size,
+                   CompressionGroupCompressor::CompressionType compression_type,
+                   std::string& response) {
+  const size_t payload_size = response.size();
+  // Zero-fills the padding.
+  response.resize(encoded_data_size);
+  std::memmove(response.data() + kFramingHeaderSize, response.data(),
+               payload_size);
+  response[0] = static_cast<char>(compression_type);
+  for (size_t i = 1; i < kFramingHeaderSize; ++i) {
+    response[i] = static_cast<char>(payload_size >>
+                                    (8 * (kFramingHeaderSize - 1 - i)));
+  }
+}
+
+// Compresses the content of each compression group of `response` and returns
+// the algorithm used, which is `kUncompressed` if the groups were too small to
+// be worth it.
+absl::StatusOr<CompressionGroupCompressor::CompressionType>
+CompressCompressionGroups(const CompressionGroupCompressor& compressor,
+                          const RequestContextFactory& request_context_factory,
+                          v2::GetValuesResponse& response) {
+  std::vector<std::string*> contents;
+  contents.reserve(response.compression_groups_size());
+  for (auto& compression_group : *response.mutable_compression_groups()) {
+    contents.push_back(compression_group.mutable_content());
+  }
+  PS_ASSIGN_OR_RETURN(const auto compression_type,
+                      compressor.Compress(contents));
+  PS_VLOG(9, request_context_factory.Get().GetPSLogContext())
+      << "Compression groups compressed with "
+      << CompressionGroupCompressor::Name(compression_type);
+  return compression_type;
+}
+
+// Pads and encrypts the encoded `response` into `oblivious_response`. The
+// response is framed in place, and the encrypted response is moved into
+// `oblivious_response`, so that the only other copies of the response are
+// the ones made by the OHTTP library.
+grpc::Status EncryptResponse(
+    const RequestContextFactory& request_context_factory,
+    OhttpServerEncryptor& encryptor, std::string response,
+    CompressionGroupCompressor::CompressionType compression_type,
+    google::api::HttpBody* oblivious_response) {
+  auto encoded_data_size = privacy_sandbox::server_common::GetEncodedDataSize(
+      response.size(), kMinResponsePaddingBytes);
+  if (encoded_data_size > kMaxResponsePaddingBytes) {
+    return GetExternalStatusForV2(
+        absl::InternalError("Framed response exceeded maximum size of 2MB"));
+  }
+  FrameResponse(encoded_data_size, compression_type, response);
+  auto encrypted_response = encryptor.EncryptResponse(
+      std::move(response), request_context_factory.Get().GetPSLogContext());
+  if (!encrypted_response.ok()) {
+    return grpc::Status(grpc::StatusCode::INTERNAL,
+                        absl::StrCat(encrypted_response.status().code(), " : ",
+                                     encrypted_response.status().message()));
+  }
+  oblivious_response->set_content_type(std::string(kKVOhttpResponseLabel));
+  oblivious_response->set_data(*std::move(encrypted_response));
+  return grpc::Status::OK;
+}
+
 }  // namespace
 
 grpc::Status GetValuesV2Handler::GetValuesHttp(
@@ -61,31 +193,91 @@ grpc::Status GetValuesV2Handler::GetValuesHttp(
     const std::multimap<grpc::string_ref, grpc::string_ref>& headers,
     const GetValuesHttpRequest& request, google::api::HttpBody* response,
     ExecutionMetadata& execution_metadata) const {
+  return WaitForCallback(
+      [&](DoneCallback on_done) {
+        GetValuesHttpAsync(request_context_factory, headers, request, response,
+                           std::move(on_done));
+      },
+      execution_metadata);
+}
+
+void GetValuesV2Handler::GetValuesHttpAsync(
+    RequestContextFactory& request_context_factory,
+    const std::multimap<grpc::string_ref, grpc::string_ref>& headers,
+    const GetValuesHttpRequest& request, google::api::HttpBody* response,
+    DoneCallback on_done) const {
   PS_VLOG(9, request_context_factory.Get().GetPSLogContext())
       << "GetValuesHttpRequest with headers: " << request;
   auto v2_codec = V2EncoderDecoder::Create(V2EncoderDecoder::GetContentType(
       headers, V2EncoderDecoder::ContentType::kJson));
-  return FromAbslStatus(
-      GetValuesHttp(request_context_factory, request.raw_body().data(),
-                    *response->mutable_data(), execution_metadata, *v2_codec));
+  const V2EncoderDecoder& codec = *v2_codec;
+  // The response does not report a compression algorithm.
+  GetValuesHttpAsync(
+      request_context_factory, request.raw_body().data(),
+      *response->mutable_data(), codec, /*compress=*/false,
+      [v2_codec = std::move(v2_codec), on_done = std::move(on_done)](
+          absl::Status status, ExecutionMetadata execution_metadata,
+          CompressionGroupCompressor::CompressionType) mutable {
+        on_done(FromAbslStatus(status), std::move(execution_metadata));
+      });
 }
 
-absl::Status GetValuesV2Handler::GetValuesHttp(
+void GetValuesV2Handler::GetValuesHttpAsync(
     RequestContextFactory& request_context_factory, std::string_view request,
-    std::string& response, ExecutionMetadata& execution_metadata,
-    const V2EncoderDecoder& v2_codec) const {
+    std::string& response, const V2EncoderDecoder& v2_codec, bool compress,
+    EncodedResponseCallback on_done) const {
   PS_VLOG(9, request_context_factory.Get().GetPSLogContext())
       << "GetValuesHttpRequest body: " << request;
-  PS_ASSIGN_OR_RETURN(v2::GetValuesRequest request_proto,
-                      v2_codec.DecodeToV2GetValuesRequestProto(request));
-
-  v2::GetValuesResponse response_proto;
-  PS_RETURN_IF_ERROR(GetValues(
-      request_context_factory, request_proto, &response_proto,
-      execution_metadata, IsSinglePartitionUseCase(request_proto), v2_codec));
-  PS_ASSIGN_OR_RETURN(response,
-                      v2_codec.EncodeV2GetValuesResponse(response_proto));
-  return absl::OkStatus();
+  auto request_proto = v2_codec.DecodeToV2GetValuesRequestProto(request);
+  if (!request_proto.ok()) {
+    on_done(std::move(request_proto).status(), ExecutionMetadata(),
+            CompressionGroupCompressor::CompressionType::kUncompressed);
+    return;
+  }
+  // Owned by the callback until the response is encoded.
+  struct Protos {
+    v2::GetValuesRequest request;
+    v2::GetValuesResponse response;
+  };
+  auto protos = std::make_unique<Protos>();
+  protos->request = *std::move(request_proto);
+  Protos& protos_ref = *protos;
+  GetValuesAsync(
+      request_context_factory, protos_ref.request, &protos_ref.response,
+      IsSinglePartitionUseCase(protos_ref.request), v2_codec,
+      [this, &request_context_factory, &response, &v2_codec, compress,
+       protos = std::move(protos), on_done = std::move(on_done)](
+          grpc::Status status, ExecutionMetadata execution_metadata) mutable {
+        constexpr auto kUncompressed =
+            CompressionGroupCompressor::CompressionType::kUncompressed;
+        if (!status.ok()) {
+          on_done(ToAbslStatus(status), std::move(execution_metadata),
+                  kUncompressed);
+          return;
+        }
+        auto compression_type = kUncompressed;
+        if (compress &&
+            compressor_.IsAcceptedBy(protos->request.accept_compression())) {
+          auto compressed = CompressCompressionGroups(
+              compressor_, request_context_factory, protos->response);
+          if (!compressed.ok()) {
+            on_done(std::move(compressed).status(),
+                    std::move(execution_metadata), kUncompressed);
+            return;
+          }
+          compression_type = *compressed;
+        }
+        auto encoded_response =
+            v2_codec.EncodeV2GetValuesResponse(protos->response);
+        if (!encoded_response.ok()) {
+          on_done(std::move(encoded_response).status(),
+                  std::move(execution_metadata), kUncompressed);
+          return;
+        }
+        response = *std::move(encoded_response);
+        on_done(absl::OkStatus(), std::move(execution_metadata),
+                compression_type);
+      });
 }
 
 bool IsSinglePartitionUseCase(const v2::GetValuesRequest& request) {
@@ -100,54 +292,61 @@ grpc::Status GetValuesV2Handler::ObliviousGetValues(
     const ObliviousGetValuesRequest& oblivious_request,
     google::api::HttpBody* oblivious_response,
     ExecutionMetadata& execution_metadata) const {
+  return WaitForCallback(
+      [&](DoneCallback on_done) {
+        ObliviousGetValuesAsync(request_context_factory, headers,
+                                oblivious_request, oblivious_response,
+                                std::move(on_done));
+      },
+      execution_metadata);
+}
+
+void GetValuesV2Handler::ObliviousGetValuesAsync(
+    RequestContextFactory& request_context_factory,
+    const std::multimap<grpc::string_ref, grpc::string_ref>& headers,
+    const ObliviousGetValuesRequest& oblivious_request,
+    google::api::HttpBody* oblivious_response, DoneCallback on_done) const {
   PS_VLOG(9, request_context_factory.Get().GetPSLogContext())
       << "Received ObliviousGetValues request.";
-  OhttpServerEncryptor encryptor(key_fetcher_manager_);
-  auto maybe_padded_plain_text =
-      encryptor.DecryptRequest(oblivious_request.raw_body().data(),
-                               request_context_factory.Get().GetPSLogContext());
+  auto encryptor = std::make_unique<OhttpServerEncryptor>(key_fetcher_manager_);
+  auto maybe_padded_plain_text = encryptor->DecryptRequest(
+      oblivious_request.raw_body().data(),
+      request_context_factory.Get().GetPSLogContext());
   if (!maybe_padded_plain_text.ok()) {
-    return FromAbslStatus(maybe_padded_plain_text.status());
+    on_done(FromAbslStatus(maybe_padded_plain_text.status()),
+            ExecutionMetadata());
+    return;
   }
-  std::string response;
-  absl::StatusOr<privacy_sandbox::server_common::DecodedRequest>
-      decoded_request = privacy_sandbox::server_common::DecodeRequestPayload(
-          *maybe_padded_plain_text);
+  // Points into the plaintext, which the encryptor owns.
+  absl::StatusOr<std::string_view> decoded_request =
+      DeframeRequest(*maybe_padded_plain_text);
   if (!decoded_request.ok()) {
-    return FromAbslStatus(decoded_request.status());
+    on_done(FromAbslStatus(decoded_request.status()), ExecutionMetadata());
+    return;
   }
   auto v2_codec = V2EncoderDecoder::Create(V2EncoderDecoder::GetContentType(
       headers, V2EncoderDecoder::ContentType::kCbor));
-  if (const auto s = GetValuesHttp(request_context_factory,
-                                   std::move(decoded_request->compressed_data),
-                                   response, execution_metadata, *v2_codec);
-      !s.ok()) {
-    return FromAbslStatus(s);
-  }
-  auto encoded_data_size = privacy_sandbox::server_common::GetEncodedDataSize(
-      response.size(), kMinResponsePaddingBytes);
-  if (encoded_data_size > kMaxResponsePaddingBytes) {
-    return GetExternalStatusForV2(
-        absl::InternalError("Framed response exceeded maximum size of 2MB"));
-  }
-  auto maybe_padded_response =
-      privacy_sandbox::server_common::EncodeResponsePayload(
-          privacy_sandbox::server_common::CompressionType::kUncompressed,
-          std::move(response), encoded_data_size);
-  if (!maybe_padded_response.ok()) {
-    return FromAbslStatus(maybe_padded_response.status());
-  }
-  auto encrypted_response = encryptor.EncryptResponse(
-      std::move(*maybe_padded_response),
-      request_context_factory.Get().GetPSLogContext());
-  if (!encrypted_response.ok()) {
-    return grpc::Status(grpc::StatusCode::INTERNAL,
-                        absl::StrCat(encrypted_response.status().code(), " : ",
-                                     encrypted_response.status().message()));
-  }
-  oblivious_response->set_content_type(std::string(kKVOhttpResponseLabel));
-  oblivious_response->set_data(*encrypted_response);
-  return grpc::Status::OK;
+  const V2EncoderDecoder& codec = *v2_codec;
+  auto response = std::make_unique<std::string>();
+  std::string& response_ref = *response;
+  GetValuesHttpAsync(
+      request_context_factory, *decoded_request, response_ref, codec,
+      /*compress=*/true,
+      [&request_context_factory, oblivious_response,
+       encryptor = std::move(encryptor), v2_codec = std::move(v2_codec),
+       response = std::move(response), on_done = std::move(on_done)](
+          absl::Status status, ExecutionMetadata execution_metadata,
+          CompressionGroupCompressor::CompressionType
+              compression_type) mutable {
+        if (!status.ok()) {
+          on_done(FromAbslStatus(status), std::move(execution_metadata));
+          return;
+        }
+        on_done(EncryptResponse(request_context_factory, *encryptor,
+                                std::move(*response), compression_type,
+                                oblivious_response),
+                std::move(execution_metadata));
+      });
 }
 
 grpc::Status GetValuesV2Handler::GetValues(
@@ -155,23 +354,68 @@ grpc::Status GetValuesV2Handler::GetValues(
     const v2::GetValuesRequest& request, v2::GetValuesResponse* response,
     ExecutionMetadata& execution_metadata, bool single_partition_use_case,
     const V2EncoderDecoder& v2_codec) const {
-  PS_VLOG(9) << "Update log context " << request.log_context() << ";"
-             << request.consented_debug_config();
-  request_context_factory.UpdateLogContext(
-      request.log_context(), request.consented_debug_config(),
-      [response]() { return response->mutable_debug_info(); });
-  PS_VLOG(9, request_context_factory.Get().GetPSLogContext())
-      << "v2 GetValuesRequest: " << request;
-  if (request.partitions().empty()) {
-    return grpc::Status(StatusCode::INTERNAL,
-                        "At least 1 partition is required");
+  return WaitForCallback(
+      [&](DoneCallback on_done) {
+        GetValuesAsync(request_context_factory, request, response,
+                       single_partition_use_case, v2_codec,
+                       std::move(on_done));
+      },
+      execution_metadata);
+}
+
+void GetValuesV2Handler::GetValuesAsync(
+    RequestContextFactory& request_context_factory,
+    const v2::GetValuesRequest& request, v2::GetValuesResponse* response,
+    bool single_partition_use_case, const V2EncoderDecoder& v2_codec,
+    DoneCallback on_done) const {
+  if (auto status = PrepareRequest(request_context_factory, request, response);
+      !status.ok()) {
+    on_done(std::move(status), ExecutionMetadata());
+    return;
+  }
+  std::unique_ptr<PartitionProcessor> partition_processor =
+      PartitionProcessor::Create(single_partition_use_case,
+                                 request_context_factory, udf_client_,
+                                 v2_codec);
+  const PartitionProcessor& processor = *partition_processor;
+  // The callback owns the processor so that it outlives the UDF execution.
+  processor.ProcessAsync(
+      request, *response,
+      [partition_processor = std::move(partition_processor),
+       on_done = std::move(on_done)](
+          absl::Status status, ExecutionMetadata execution_metadata) mutable {
+        on_done(GetExternalStatusForV2(status), std::move(execution_metadata));
+      });
+}
+
+void GetValuesV2Handler::GetValuesStreamAsync(
+    RequestContextFactory& request_context_factory,
+    const v2::GetValuesRequest& request, v2::GetValuesResponse* response,
+    const V2EncoderDecoder& v2_codec,
+    CompressionGroupCallback on_compression_group, DoneCallback on_done) const {
+  if (IsSinglePartitionUseCase(request)) {
+    GetValuesAsync(request_context_factory, request, response,
+                   /*single_partition_use_case=*/true, v2_codec,
+                   std::move(on_done));
+    return;
+  }
+  if (auto status = PrepareRequest(request_context_factory, request, response);
+      !status.ok()) {
+    on_done(std::move(status), ExecutionMetadata());
+    return;
   }
-  const auto partition_processor = PartitionProcessor::Create(
-      single_partition_use_case, request_context_factory, udf_client_,
-      v2_codec);
-  const auto response_status =
-      partition_processor->Process(request, *response, execution_metadata);
-  return GetExternalStatusForV2(response_status);
+  auto partition_processor = std::make_unique<MultiPartitionProcessor>(
+      request_context_factory, udf_client_, v2_codec,
+      /*enable_per_partition_metadata=*/false, compressor_.options());
+  const MultiPartitionProcessor& processor = *partition_processor;
+  // The callback owns the processor so that it outlives the UDF execution.
+  processor.ProcessStreamingAsync(
+      request, std::move(on_compression_group),
+      [partition_processor = std::move(partition_processor),
+       on_done = std::move(on_done)](
+          absl::Status status, ExecutionMetadata execution_metadata) mutable {
+        on_done(GetExternalStatusForV2(status), std::move(execution_metadata));
+      });
 }
 
 }  // namespace kv_server
@@ -24,10 +24,12 @@
 #include <utility>
 #include <vector>
 
+#include "absl/functional/any_invocable.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/escaping.h"
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/request_handler/compression/compression.h"
+#include "components/data_server/request_handler/compression/compression_group_compressor.h"
 #include "components/data_server/request_handler/content_type/encoder.h"
 #include "components/telemetry/server_definition.h"
 #include "components/udf/udf_client.h"
@@ -50,24 +52,50 @@ bool IsSinglePartitionUseCase(const v2::GetValuesRequest& request);
 class GetValuesV2Handler {
  public:
   // Accepts a functor to create compression blob builder for testing purposes.
+  //
+  // `compressor` compresses the compression groups of the responses to
+  // requests that accept its algorithm. Oblivious responses report the
+  // algorithm in their framing header, while other responses are only
+  // compressed if they are streamed, one group at a time.
   explicit GetValuesV2Handler(
       const UdfClient& udf_client,
       privacy_sandbox::server_common::KeyFetcherManagerInterface&
           key_fetcher_manager,
       std::function<CompressionGroupConcatenator::FactoryFunctionType>
           create_compression_group_concatenator =
-              &CompressionGroupConcatenator::Create)
+              &CompressionGroupConcatenator::Create,
+      CompressionGroupCompressor compressor =
+          CompressionGroupCompressor(CompressionGroupCompressor::Options()))
       : udf_client_(udf_client),
         create_compression_group_concatenator_(
             std::move(create_compression_group_concatenator)),
-        key_fetcher_manager_(key_fetcher_manager) {}
-
+        key_fetcher_manager_(key_fetcher_manager),
+        compressor_(std::move(compressor)) {}
+
+  // Invoked once the response is populated.
+  using DoneCallback = absl::AnyInvocable<void(
+      grpc::Status status, ExecutionMetadata execution_metadata)>;
+  // Invoked with each compression group of a streamed response.
+  using CompressionGroupCallback =
+      absl::AnyInvocable<void(v2::CompressionGroup compression_group)>;
+
+  // The *Async methods do not block the calling thread while the UDFs
+  // execute. `on_done` is invoked exactly once, possibly on a UDF execution
+  // thread. The request context factory, request, response and codec must
+  // outlive that call, while the headers are only read before the method
+  // returns. The other methods block until the response is populated.
   grpc::Status GetValuesHttp(
       RequestContextFactory& request_context_factory,
       const std::multimap<grpc::string_ref, grpc::string_ref>& headers,
       const v2::GetValuesHttpRequest& request, google::api::HttpBody* response,
       ExecutionMetadata& execution_metadata) const;
 
+  void GetValuesHttpAsync(
+      RequestContextFactory& request_context_factory,
+      const std::multimap<grpc::string_ref, grpc::string_ref>& headers,
+      const v2::GetValuesHttpRequest& request, google::api::HttpBody* response,
+      DoneCallback on_done) const;
+
   grpc::Status GetValues(RequestContextFactory& request_context_factory,
                          const v2::GetValuesRequest& request,
                          v2::GetValuesResponse* response,
@@ -75,6 +103,26 @@ class GetValuesV2Handler {
                          bool single_partition_use_case,
                          const V2EncoderDecoder& v2_codec) const;
 
+  void GetValuesAsync(RequestContextFactory& request_context_factory,
+                      const v2::GetValuesRequest& request,
+                      v2::GetValuesResponse* response,
+                      bool single_partition_use_case,
+                      const V2EncoderDecoder& v2_codec,
+                      DoneCallback on_done) const;
+
+  // Same as `GetValuesAsync`, except that each compression group of a
+  // multi-partition request is handed to `on_compression_group` as soon as
+  // its partitions complete, instead of being added to `response`, which only
+  // gets the debug info. `on_compression_group` is never invoked
+  // concurrently, nor after `on_done`. Single partition requests are
+  // processed like `GetValuesAsync` does.
+  void GetValuesStreamAsync(RequestContextFactory& request_context_factory,
+                            const v2::GetValuesRequest& request,
+                            v2::GetValuesResponse* response,
+                            const V2EncoderDecoder& v2_codec,
+                            CompressionGroupCallback on_compression_group,
+                            DoneCallback on_done) const;
+
   // Supports requests encrypted with a fixed key for debugging/demoing.
   // X25519 Secret key (priv key).
   // https://www.ietf.org/archive/id/draft-ietf-ohai-ohttp-03.html#appendix-A-2
@@ -97,12 +145,25 @@ class GetValuesV2Handler {
       google::api::HttpBody* response,
       ExecutionMetadata& execution_metadata) const;
 
+  void ObliviousGetValuesAsync(
+      RequestContextFactory& request_context_factory,
+      const std::multimap<grpc::string_ref, grpc::string_ref>& headers,
+      const v2::ObliviousGetValuesRequest& request,
+      google::api::HttpBody* response, DoneCallback on_done) const;
+
  private:
-  absl::Status GetValuesHttp(RequestContextFactory& request_context_factory,
-                             std::string_view request,
-                             std::string& json_response,
-                             ExecutionMetadata& execution_metadata,
-                             const V2EncoderDecoder& v2_codec) const;
+  // Invoked once the response is encoded, with the algorithm its compression
+  // groups were compressed with.
+  using EncodedResponseCallback = absl::AnyInvocable<void(
+      absl::Status status, ExecutionMetadata execution_metadata,
+      CompressionGroupCompressor::CompressionType compression_type)>;
+
+  // `request` is only read before the method returns. The compression groups
+  // of the response are only compressed if `compress`.
+  void GetValuesHttpAsync(RequestContextFactory& request_context_factory,
+                          std::string_view request, std::string& response,
+                          const V2EncoderDecoder& v2_codec, bool compress,
+                          EncodedResponseCallback on_done) const;
 
   // Invokes UDF to process one partition.
   absl::Status ProcessOnePartition(
@@ -124,6 +185,7 @@ class GetValuesV2Handler {
       create_compression_group_concatenator_;
   privacy_sandbox::server_common::KeyFetcherManagerInterface&
       key_fetcher_manager_;
+  CompressionGroupCompressor compressor_;
 };
 
 }  // namespace kv_server
@@ -15,6 +15,7 @@
 #include "components/data_server/request_handler/get_values_v2_handler.h"
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -23,6 +24,7 @@
 #include "components/data/converters/cbor_converter.h"
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/cache/mocks.h"
+#include "components/data_server/request_handler/compression/compression_gzip.h"
 #include "components/data_server/request_handler/content_type/json_encoder.h"
 #include "components/udf/mocks.h"
 #include "gmock/gmock.h"
@@ -965,6 +967,99 @@ TEST_F(GetValuesHandlerTest, PureGRPCTestFailure) {
   EXPECT_THAT(resp, EqualsProto(res));
 }
 
+TEST_F(GetValuesHandlerTest, GetValuesStream_StreamsEachCompressionGroup) {
+  v2::GetValuesRequest req;
+  TextFormat::ParseFromString(
+      R"pb(partitions {
+             id: 1
+             compression_group_id: 0
+             arguments { data { string_value: "ECHO" } }
+           }
+           partitions {
+             id: 2
+             compression_group_id: 1
+             arguments { data { string_value: "ECHO" } }
+           })pb",
+      &req);
+  GetValuesV2Handler handler(mock_udf_client_, fake_key_fetcher_manager_);
+  // One batch per compression group.
+  EXPECT_CALL(mock_udf_client_, BatchExecuteCode(_, _, _))
+      .Times(2)
+      .WillRepeatedly(
+          [](const RequestContextFactory&,
+             absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>&
+                 udf_input_map,
+             ExecutionMetadata&) {
+            absl::flat_hash_map<UniquePartitionIdTuple, std::string> outputs;
+            for (const auto& [id, udf_input] : udf_input_map) {
+              outputs[id] = R"({"keyGroupOutputs": []})";
+            }
+            return outputs;
+          });
+  v2::GetValuesResponse resp;
+  auto request_context_factory = std::make_unique<RequestContextFactory>();
+  JsonV2EncoderDecoder v2_codec;
+  std::vector<int32_t> compression_group_ids;
+  std::optional<grpc::Status> status;
+  handler.GetValuesStreamAsync(
+      *request_context_factory, req, &resp, v2_codec,
+      [&compression_group_ids](v2::CompressionGroup compression_group) {
+        EXPECT_FALSE(compression_group.content().empty());
+        compression_group_ids.push_back(
+            compression_group.compression_group_id());
+      },
+      [&status](grpc::Status done_status, ExecutionMetadata) {
+        status = std::move(done_status);
+      });
+  ASSERT_TRUE(status.has_value());
+  ASSERT_TRUE(status->ok()) << "code: " << status->error_code()
+                            << ", msg: " << status->error_message();
+
+  EXPECT_THAT(compression_group_ids, UnorderedElementsAre(0, 1));
+  EXPECT_THAT(resp, EqualsProto(v2::GetValuesResponse()));
+}
+
+TEST_F(GetValuesHandlerTest, GetValuesStream_SinglePartition) {
+  v2::GetValuesRequest req;
+  TextFormat::ParseFromString(
+      R"pb(partitions {
+             id: 9
+             arguments { data { string_value: "ECHO" } }
+           }
+           metadata {
+             fields {
+               key: "is_pas"
+               value { string_value: "true" }
+             }
+           })pb",
+      &req);
+  GetValuesV2Handler handler(mock_udf_client_, fake_key_fetcher_manager_);
+  EXPECT_CALL(mock_udf_client_, ExecuteCode(_, _, _, _))
+      .WillOnce(Return("ECHO"));
+  v2::GetValuesResponse resp;
+  auto request_context_factory = std::make_unique<RequestContextFactory>();
+  JsonV2EncoderDecoder v2_codec;
+  int num_compression_groups = 0;
+  std::optional<grpc::Status> status;
+  handler.GetValuesStreamAsync(
+      *request_context_factory, req, &resp, v2_codec,
+      [&num_compression_groups](v2::CompressionGroup) {
+        ++num_compression_groups;
+      },
+      [&status](grpc::Status done_status, ExecutionMetadata) {
+        status = std::move(done_status);
+      });
+  ASSERT_TRUE(status.has_value());
+  ASSERT_TRUE(status->ok()) << "code: " << status->error_code()
+                            << ", msg: " << status->error_message();
+
+  EXPECT_EQ(num_compression_groups, 0);
+  v2::GetValuesResponse res;
+  TextFormat::ParseFromString(
+      R"pb(single_partition { id: 9 string_output: "ECHO" })pb", &res);
+  EXPECT_THAT(resp, EqualsProto(res));
+}
+
 TEST_F(GetValuesHandlerTest,
        PureGRPCTest_SinglePartitionUseCase_PassesPartitionMetadata) {
   v2::GetValuesRequest req;
@@ -1295,5 +1390,158 @@ TEST_F(GetValuesHandlerTest, ObliviousGetValuesTest_PadsToMinPaddingSize) {
   EXPECT_EQ(response_unwrapper.UnwrapOhttp().size(), kMinResponsePaddingBytes);
 }
 
+TEST_F(GetValuesHandlerTest,
+       ObliviousGetValuesTest_FramesResponseLikeEncodeResponsePayload) {
+  ExecutionMetadata execution_metadata;
+  std::multimap<grpc::string_ref, grpc::string_ref> headers = {
+      {std::string(kKVContentTypeHeader),
+       std::string(kContentEncodingCborHeaderValue)}};
+  // Large enough to be padded beyond the minimum size.
+  std::string output = absl::Substitute(
+      R"json({"keyGroupOutputs":[{"keyValues":{"hello":{"value":"$0"}}}]})json",
+      std::string(100000, 'a'));
+  absl::flat_hash_map<UniquePartitionIdTuple, std::string>
+      batch_execute_output = {{{0, 0}, output}};
+  EXPECT_CALL(mock_udf_client_, BatchExecuteCode(_, _, _))
+      .WillOnce(Return(batch_execute_output));
+  GetValuesV2Handler handler(mock_udf_client_, fake_key_fetcher_manager_);
+
+  nlohmann::json request_body_json = R"json({
+    "partitions": [
+        {
+            "id": 0
+        }
+    ]
+  })json"_json;
+  std::vector<uint8_t> cbor_vector = nlohmann::json::to_cbor(request_body_json);
+  std::string request_body =
+      std::string(cbor_vector.begin(), cbor_vector.end());
+  // Padded beyond the size of the request, which is deframed in place.
+  auto maybe_padded_request =
+      privacy_sandbox::server_common::EncodeResponsePayload(
+          privacy_sandbox::server_common::CompressionType::kUncompressed,
+          request_body, /*encoded_data_size=*/4096);
+  ASSERT_TRUE(maybe_padded_request.ok());
+  OHTTPRequest ohttp_request(*maybe_padded_request);
+  auto [request, response_unwrapper] = ohttp_request.Build();
+  auto request_context_factory = std::make_unique<RequestContextFactory>();
+  const auto result = handler.ObliviousGetValues(
+      *request_context_factory, headers, request,
+      &response_unwrapper.RawResponse(), execution_metadata);
+  ASSERT_TRUE(result.ok()) << "code: " << result.error_code()
+                           << ", msg: " << result.error_message();
+
+  const std::string padded_response = response_unwrapper.UnwrapOhttp();
+  auto deframed_response =
+      privacy_sandbox::server_common::DecodeRequestPayload(padded_response);
+  ASSERT_TRUE(deframed_response.ok()) << deframed_response.status();
+  auto expected_padded_response =
+      privacy_sandbox::server_common::EncodeResponsePayload(
+          privacy_sandbox::server_common::CompressionType::kUncompressed,
+          deframed_response->compressed_data,
+          privacy_sandbox::server_common::GetEncodedDataSize(
+              deframed_response->compressed_data.size(),
+              kMinResponsePaddingBytes));
+  ASSERT_TRUE(expected_padded_response.ok());
+  EXPECT_GT(padded_response.size(), kMinResponsePaddingBytes);
+  EXPECT_EQ(padded_response, *expected_padded_response);
+}
+
+TEST_F(GetValuesHandlerTest,
+       ObliviousGetValuesTest_ReportsCompressionInFramingHeader) {
+  ExecutionMetadata execution_metadata;
+  std::multimap<grpc::string_ref, grpc::string_ref> headers = {
+      {std::string(kKVContentTypeHeader),
+       std::string(kContentEncodingCborHeaderValue)}};
+  std::string output = absl::Substitute(
+      R"json({"keyGroupOutputs":[{"keyValues":{"hello":{"value":"$0"}}}]})json",
+      std::string(1000, 'a'));
+  absl::flat_hash_map<UniquePartitionIdTuple, std::string>
+      batch_execute_output = {{{0, 0}, output}, {{1, 1}, output}};
+  EXPECT_CALL(mock_udf_client_, BatchExecuteCode(_, _, _))
+      .WillOnce(Return(batch_execute_output));
+  CompressionThreadPool thread_pool(/*num_threads=*/2);
+  GetValuesV2Handler handler(
+      mock_udf_client_, fake_key_fetcher_manager_,
+      &CompressionGroupConcatenator::Create,
+      CompressionGroupCompressor(
+          {.type = CompressionGroupCompressor::CompressionType::kGzip},
+          &thread_pool));
+
+  nlohmann::json request_body_json = R"json({
+    "acceptCompression": ["none", "gzip"],
+    "partitions": [
+        {
+            "id": 0,
+            "compressionGroupId": 0
+        },
+        {
+            "id": 1,
+            "compressionGroupId": 1
+        }
+    ]
+  })json"_json;
+  std::vector<uint8_t> cbor_vector = nlohmann::json::to_cbor(request_body_json);
+  std::string request_body =
+      std::string(cbor_vector.begin(), cbor_vector.end());
+  auto maybe_padded_request =
+      privacy_sandbox::server_common::EncodeResponsePayload(
+          privacy_sandbox::server_common::CompressionType::kUncompressed,
+          request_body,
+          privacy_sandbox::server_common::GetEncodedDataSize(
+              request_body.size(), kMinResponsePaddingBytes));
+  ASSERT_TRUE(maybe_padded_request.ok());
+  OHTTPRequest ohttp_request(*maybe_padded_request);
+  auto [request, response_unwrapper] = ohttp_request.Build();
+  auto request_context_factory = std::make_unique<RequestContextFactory>();
+  const auto result = handler.ObliviousGetValues(
+      *request_context_factory, headers, request,
+      &response_unwrapper.RawResponse(), execution_metadata);
+  ASSERT_TRUE(result.ok()) << "code: " << result.error_code()
+                           << ", msg: " << result.error_message();
+
+  auto deframed_response = privacy_sandbox::server_common::DecodeRequestPayload(
+      response_unwrapper.UnwrapOhttp());
+  ASSERT_TRUE(deframed_response.ok()) << deframed_response.status();
+  EXPECT_EQ(deframed_response->compression_type,
+            privacy_sandbox::server_common::CompressionType::kGzip);
+  nlohmann::json response_json =
+      nlohmann::json::from_cbor(deframed_response->compressed_data,
+                                /*strict=*/true, /*allow_exceptions=*/false);
+  ASSERT_FALSE(response_json.is_discarded());
+  ASSERT_EQ(response_json["compressionGroups"].size(), 2);
+  for (auto& compression_group : response_json["compressionGroups"]) {
+    const auto& content = compression_group["content"].get_binary();
+    auto decompressed = GzipDecompress(std::string_view(
+        reinterpret_cast<const char*>(content.data()), content.size()));
+    ASSERT_TRUE(decompressed.ok()) << decompressed.status();
+    nlohmann::json partition_outputs = nlohmann::json::from_cbor(
+        *decompressed, /*strict=*/true, /*allow_exceptions=*/false);
+    ASSERT_FALSE(partition_outputs.is_discarded());
+    EXPECT_EQ(partition_outputs.size(), 1);
+  }
+}
+
+TEST_F(GetValuesHandlerTest, ObliviousGetValuesTest_TruncatedFramingFails) {
+  ExecutionMetadata execution_metadata;
+  std::multimap<grpc::string_ref, grpc::string_ref> headers = {
+      {std::string(kKVContentTypeHeader),
+       std::string(kContentEncodingCborHeaderValue)}};
+  EXPECT_CALL(mock_udf_client_, BatchExecuteCode(_, _, _)).Times(0);
+  GetValuesV2Handler handler(mock_udf_client_, fake_key_fetcher_manager_);
+
+  // The framing header states a payload of 256 bytes.
+  OHTTPRequest ohttp_request(std::string("\x00\x00\x00\x01\x00"
+                                         "abc",
+                                         8));
+  auto [request, response_unwrapper] = ohttp_request.Build();
+  auto request_context_factory = std::make_unique<RequestContextFactory>();
+  const auto result = handler.ObliviousGetValues(
+      *request_context_factory, headers, request,
+      &response_unwrapper.RawResponse(), execution_metadata);
+  EXPECT_FALSE(result.ok());
+  EXPECT_TRUE(response_unwrapper.RawResponse().data().empty());
+}
+
 }  // namespace
 }  // namespace kv_server
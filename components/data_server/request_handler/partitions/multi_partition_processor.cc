@@ -14,6 +14,8 @@
 
 #include "components/data_server/request_handler/partitions/multi_partition_processor.h"
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -21,6 +23,7 @@
 #include "absl/algorithm/container.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
 #include "components/data_server/request_handler/content_type/encoder.h"
 #include "components/data_server/request_handler/status/status_tag.h"
 #include "components/errors/error_tag.h"
@@ -299,10 +302,9 @@ BuildUdfMetadataMap(const v2::GetValuesRequest& request,
       id_to_udf_metadata_map;
   for (const auto& partition : request.partitions()) {
     UniquePartitionIdTuple id{partition.id(), partition.compression_group_id()};
+    // The request metadata is shared by all the partitions, see
+    // `UdfClient::BatchExecuteCodeAsync`.
     UDFExecutionMetadata udf_metadata;
-    if (request.has_metadata()) {
-      *udf_metadata.mutable_request_metadata() = request.metadata();
-    }
     if (!partition.metadata().fields().empty()) {
       *udf_metadata.mutable_partition_metadata() = partition.metadata();
     }
@@ -316,20 +318,11 @@ BuildUdfMetadataMap(const v2::GetValuesRequest& request,
   return id_to_udf_metadata_map;
 }
 
-}  // namespace
-
-MultiPartitionProcessor::MultiPartitionProcessor(
-    const RequestContextFactory& request_context_factory,
-    const UdfClient& udf_client, const V2EncoderDecoder& v2_codec,
-    bool enable_per_partition_metadata)
-    : request_context_factory_(request_context_factory),
-      udf_client_(udf_client),
-      v2_codec_(v2_codec),
-      enable_per_partition_metadata_(enable_per_partition_metadata) {}
-
-absl::Status MultiPartitionProcessor::Process(
-    const v2::GetValuesRequest& request, v2::GetValuesResponse& response,
-    ExecutionMetadata& execution_metadata) const {
+// Returns the UDF input of each partition of `request`.
+absl::StatusOr<absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>>
+BuildUdfInputMap(const v2::GetValuesRequest& request,
+                 const RequestContextFactory& request_context_factory,
+                 bool enable_per_partition_metadata) {
   if (HasDuplicatePartitionAndCompressionGroupIds(request)) {
     return V2RequestFormatErrorAsExternalHttpError(absl::InvalidArgumentError(
         "Each partition must have a unique <id, "
@@ -338,9 +331,9 @@ absl::Status MultiPartitionProcessor::Process(
 
   absl::flat_hash_map<UniquePartitionIdTuple, UDFInput> udf_input_map;
   auto id_to_udf_metadata_map = BuildUdfMetadataMap(
-      request, request_context_factory_, enable_per_partition_metadata_);
+      request, request_context_factory, enable_per_partition_metadata);
   if (!id_to_udf_metadata_map.ok()) {
-    PS_VLOG(1, request_context_factory_.Get().GetPSLogContext())
+    PS_VLOG(1, request_context_factory.Get().GetPSLogContext())
         << "Error building partition metadata map";
     return V2RequestFormatErrorAsExternalHttpError(
         std::move(id_to_udf_metadata_map.status()));
@@ -356,12 +349,201 @@ absl::Status MultiPartitionProcessor::Process(
         id, UDFInput{.execution_metadata = std::move(udf_metadata),
                      .arguments = partition.arguments()});
   }
+  return udf_input_map;
+}
 
-  PS_ASSIGN_OR_RETURN(
-      auto id_to_output_map,
-      udf_client_.BatchExecuteCode(request_context_factory_, udf_input_map,
-                                   execution_metadata));
+CompressionGroupCompressor::Options GroupCompressionOptions(
+    CompressionGroupCompressor::Options options) {
+  // The size of the whole response is not known while its groups are built.
+  options.min_size_bytes = 0;
+  return options;
+}
 
+// Collects the compression groups of a streamed response, which are built on
+// different UDF execution threads, and invokes the done callback once all of
+// them were handed over.
+class StreamingExecution {
+ public:
+  StreamingExecution(
+      size_t size,
+      MultiPartitionProcessor::CompressionGroupCallback on_compression_group,
+      PartitionProcessor::DoneCallback on_done)
+      : remaining_(size),
+        on_compression_group_(std::move(on_compression_group)),
+        on_done_(std::move(on_done)) {
+    metadata_.custom_code_total_execution_time_micros = 0;
+  }
+
+  // `compression_group` is an error if no partition of the group succeeded.
+  void Add(absl::StatusOr<v2::CompressionGroup> compression_group,
+           const ExecutionMetadata& metadata) {
+    absl::Status status;
+    ExecutionMetadata batch_metadata;
+    {
+      absl::MutexLock lock(&mutex_);
+      // Record the longest UDF execution time across all parallel executions
+      metadata_.custom_code_total_execution_time_micros =
+          std::max(metadata_.custom_code_total_execution_time_micros,
+                   metadata.custom_code_total_execution_time_micros);
+      if (compression_group.ok()) {
+        // Called under the lock so that the groups are handed over one at a
+        // time.
+        on_compression_group_(*std::move(compression_group));
+        built_any_ = true;
+      } else if (status_.ok()) {
+        status_ = std::move(compression_group).status();
+      }
+      if (--remaining_ > 0) {
+        return;
+      }
+      status = built_any_ ? absl::OkStatus() : std::move(status_);
+      batch_metadata = metadata_;
+    }
+    on_done_(std::move(status), std::move(batch_metadata));
+  }
+
+ private:
+  absl::Mutex mutex_;
+  size_t remaining_ ABSL_GUARDED_BY(mutex_);
+  bool built_any_ ABSL_GUARDED_BY(mutex_) = false;
+  // First error of the groups that failed.
+  absl::Status status_ ABSL_GUARDED_BY(mutex_);
+  ExecutionMetadata metadata_ ABSL_GUARDED_BY(mutex_);
+  MultiPartitionProcessor::CompressionGroupCallback on_compression_group_
+      ABSL_GUARDED_BY(mutex_);
+  PartitionProcessor::DoneCallback on_done_;
+};
+
+}  // namespace
+
+MultiPartitionProcessor::MultiPartitionProcessor(
+    const RequestContextFactory& request_context_factory,
+    const UdfClient& udf_client, const V2EncoderDecoder& v2_codec,
+    bool enable_per_partition_metadata,
+    CompressionGroupCompressor::Options compression_options,
+    bool build_compression_groups_eagerly)
+    : request_context_factory_(request_context_factory),
+      udf_client_(udf_client),
+      v2_codec_(v2_codec),
+      enable_per_partition_metadata_(enable_per_partition_metadata),
+      compressor_(GroupCompressionOptions(std::move(compression_options))),
+      build_compression_groups_eagerly_(build_compression_groups_eagerly) {}
+
+void MultiPartitionProcessor::ProcessAsync(const v2::GetValuesRequest& request,
+                                           v2::GetValuesResponse& response,
+                                           DoneCallback on_done) const {
+  if (build_compression_groups_eagerly_) {
+    ProcessStreamingAsync(
+        request, /*compress=*/false,
+        [&response](v2::CompressionGroup compression_group) {
+          *response.add_compression_groups() = std::move(compression_group);
+        },
+        std::move(on_done));
+    return;
+  }
+  auto udf_input_map = BuildUdfInputMap(request, request_context_factory_,
+                                        enable_per_partition_metadata_);
+  if (!udf_input_map.ok()) {
+    on_done(std::move(udf_input_map).status(), ExecutionMetadata());
+    return;
+  }
+  udf_client_.BatchExecuteCodeAsync(
+      request_context_factory_,
+      request.has_metadata() ? &request.metadata() : nullptr, *udf_input_map,
+      [this, &request, &response, on_done = std::move(on_done)](
+          absl::StatusOr<
+              absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
+              id_to_output_map,
+          ExecutionMetadata execution_metadata) mutable {
+        if (!id_to_output_map.ok()) {
+          on_done(std::move(id_to_output_map).status(),
+                  std::move(execution_metadata));
+          return;
+        }
+        on_done(BuildResponse(request, *std::move(id_to_output_map), response),
+                std::move(execution_metadata));
+      });
+}
+
+void MultiPartitionProcessor::ProcessStreamingAsync(
+    const v2::GetValuesRequest& request,
+    CompressionGroupCallback on_compression_group, DoneCallback on_done) const {
+  ProcessStreamingAsync(request,
+                        compressor_.IsAcceptedBy(request.accept_compression()),
+                        std::move(on_compression_group), std::move(on_done));
+}
+
+void MultiPartitionProcessor::ProcessStreamingAsync(
+    const v2::GetValuesRequest& request, bool compress,
+    CompressionGroupCallback on_compression_group, DoneCallback on_done) const {
+  auto udf_input_map = BuildUdfInputMap(request, request_context_factory_,
+                                        enable_per_partition_metadata_);
+  if (!udf_input_map.ok()) {
+    on_done(std::move(udf_input_map).status(), ExecutionMetadata());
+    return;
+  }
+  if (udf_input_map->empty()) {
+    on_done(absl::InvalidArgumentError("All partitions failed."),
+            ExecutionMetadata());
+    return;
+  }
+  struct CompressionGroupInput {
+    // In the order of the request.
+    std::vector<int32_t> partition_ids;
+    absl::flat_hash_map<UniquePartitionIdTuple, UDFInput> udf_input_map;
+  };
+  absl::flat_hash_map<int32_t, CompressionGroupInput> compression_groups;
+  for (const auto& partition : request.partitions()) {
+    UniquePartitionIdTuple id{partition.id(), partition.compression_group_id()};
+    auto& compression_group =
+        compression_groups[partition.compression_group_id()];
+    compression_group.partition_ids.push_back(partition.id());
+    compression_group.udf_input_map.insert_or_assign(
+        id, std::move((*udf_input_map)[id]));
+  }
+
+  auto execution = std::make_shared<StreamingExecution>(
+      compression_groups.size(), std::move(on_compression_group),
+      std::move(on_done));
+  for (auto& [group_id, compression_group] : compression_groups) {
+    udf_client_.BatchExecuteCodeAsync(
+        request_context_factory_,
+        request.has_metadata() ? &request.metadata() : nullptr,
+        compression_group.udf_input_map,
+        [this, execution, compress, group_id = group_id,
+         partition_ids = std::move(compression_group.partition_ids)](
+            absl::StatusOr<
+                absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
+                id_to_output_map,
+            ExecutionMetadata execution_metadata) {
+          if (!id_to_output_map.ok()) {
+            execution->Add(std::move(id_to_output_map).status(),
+                           execution_metadata);
+            return;
+          }
+          std::vector<std::pair<int32_t, std::string>> partition_output_pairs;
+          for (int32_t partition_id : partition_ids) {
+            auto it = id_to_output_map->find({partition_id, group_id});
+            if (it == id_to_output_map->end()) {
+              PS_VLOG(3, request_context_factory_.Get().GetPSLogContext())
+                  << "Failed to execute UDF for partition.id " << partition_id
+                  << " and compression_group_id " << group_id;
+              continue;
+            }
+            partition_output_pairs.emplace_back(partition_id,
+                                                std::move(it->second));
+          }
+          execution->Add(
+              BuildCompressionGroup(group_id, partition_output_pairs, compress),
+              execution_metadata);
+        });
+  }
+}
+
+absl::Status MultiPartitionProcessor::BuildResponse(
+    const v2::GetValuesRequest& request,
+    absl::flat_hash_map<UniquePartitionIdTuple, std::string> id_to_output_map,
+    v2::GetValuesResponse& response) const {
   // Build a map of compression_group_id to <partition_id, udf_output>
   absl::flat_hash_map<int32_t, std::vector<std::pair<int32_t, std::string>>>
       compression_group_map = BuildCompressionGroupToPartitionOutputMap(
@@ -370,17 +552,14 @@ absl::Status MultiPartitionProcessor::Process(
   // The content of each compressed blob is a CBOR/JSON list of partition
   // outputs or a V2CompressionGroup protobuf message.
   for (auto& [group_id, partition_output_pairs] : compression_group_map) {
-    const auto maybe_content = v2_codec_.EncodePartitionOutputs(
-        partition_output_pairs, request_context_factory_);
-    if (!maybe_content.ok()) {
+    auto compression_group = BuildCompressionGroup(
+        group_id, partition_output_pairs, /*compress=*/false);
+    if (!compression_group.ok()) {
       PS_VLOG(3, request_context_factory_.Get().GetPSLogContext())
-          << maybe_content.status();
+          << compression_group.status();
       continue;
     }
-    // TODO(b/355464083): Compress the compression_group content
-    auto* compression_group = response.add_compression_groups();
-    compression_group->set_content(std::move(*maybe_content));
-    compression_group->set_compression_group_id(group_id);
+    *response.add_compression_groups() = *std::move(compression_group);
   }
   if (response.compression_groups().empty()) {
     return absl::InvalidArgumentError("All partitions failed.");
@@ -388,4 +567,25 @@ absl::Status MultiPartitionProcessor::Process(
   return absl::OkStatus();
 }
 
+absl::StatusOr<v2::CompressionGroup>
+MultiPartitionProcessor::BuildCompressionGroup(
+    int32_t compression_group_id,
+    std::vector<std::pair<int32_t, std::string>>& partition_output_pairs,
+    bool compress) const {
+  PS_ASSIGN_OR_RETURN(std::string content,
+                      v2_codec_.EncodePartitionOutputs(
+                          partition_output_pairs, request_context_factory_));
+  if (compress) {
+    PS_ASSIGN_OR_RETURN(const auto compression_type,
+                        compressor_.Compress({&content}));
+    PS_VLOG(9, request_context_factory_.Get().GetPSLogContext())
+        << "Compression group " << compression_group_id << " compressed with "
+        << CompressionGroupCompressor::Name(compression_type);
+  }
+  v2::CompressionGroup compression_group;
+  compression_group.set_compression_group_id(compression_group_id);
+  compression_group.set_content(std::move(content));
+  return compression_group;
+}
+
 }  // namespace kv_server
@@ -17,6 +17,13 @@
 #ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_PARTITIONS_MULTI_PARTITION_PROCESSOR_H_
 #define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_PARTITIONS_MULTI_PARTITION_PROCESSOR_H_
 
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/any_invocable.h"
+#include "components/data_server/request_handler/compression/compression_group_compressor.h"
 #include "components/data_server/request_handler/content_type/encoder.h"
 #include "components/data_server/request_handler/partitions/partition_processor.h"
 #include "components/udf/udf_client.h"
@@ -29,21 +36,70 @@ namespace kv_server {
 // Processor for v2::GetValuesRequest with multiple partitions
 class MultiPartitionProcessor : public PartitionProcessor {
  public:
-  MultiPartitionProcessor(const RequestContextFactory& request_context_factory,
-                          const UdfClient& udf_client,
-                          const V2EncoderDecoder& v2_codec,
-                          bool enable_per_partition_metadata = false);
+  // Invoked with each compression group of a streamed response.
+  using CompressionGroupCallback =
+      absl::AnyInvocable<void(v2::CompressionGroup compression_group)>;
+
+  // If `build_compression_groups_eagerly`, `ProcessAsync` builds each
+  // compression group as soon as its partitions complete, like
+  // `ProcessStreamingAsync`, instead of once all partitions completed.
+  // `compression_options` only apply to `ProcessStreamingAsync`.
+  MultiPartitionProcessor(
+      const RequestContextFactory& request_context_factory,
+      const UdfClient& udf_client, const V2EncoderDecoder& v2_codec,
+      bool enable_per_partition_metadata = false,
+      CompressionGroupCompressor::Options compression_options = {},
+      bool build_compression_groups_eagerly = false);
+
+  // Passes input to UDF and populates GetValuesResponse.compression_groups.
+  // The content of the compression groups is left uncompressed, since the
+  // algorithm is reported along with the whole response, see
+  // `GetValuesV2Handler`.
+  void ProcessAsync(const v2::GetValuesRequest& request,
+                    v2::GetValuesResponse& response,
+                    DoneCallback on_done) const override;
 
-  // Passes input to UDF and populates GetValuesResponse.compression_groups
-  absl::Status Process(const v2::GetValuesRequest& request,
-                       v2::GetValuesResponse& response,
-                       ExecutionMetadata& execution_metadata) const override;
+  // Same as `ProcessAsync`, but hands each compression group to
+  // `on_compression_group` instead of adding it to a response. The UDFs of
+  // each compression group run as a separate batch, and the group is encoded
+  // and compressed as soon as that batch completes, so a slow partition only
+  // delays its own group. Groups are compressed with the algorithm of the
+  // compression options if the request accepts it. Since each group is
+  // compressed on its own, `min_size_bytes` of the options is not used.
+  //
+  // `on_compression_group` is never invoked concurrently, nor after
+  // `on_done`, which gets an error if no compression group could be built.
+  void ProcessStreamingAsync(const v2::GetValuesRequest& request,
+                             CompressionGroupCallback on_compression_group,
+                             DoneCallback on_done) const;
 
  private:
+  // Same as the public `ProcessStreamingAsync`, but only compresses the
+  // groups if `compress`.
+  void ProcessStreamingAsync(const v2::GetValuesRequest& request, bool compress,
+                             CompressionGroupCallback on_compression_group,
+                             DoneCallback on_done) const;
+
+  // Populates the compression groups of `response` from the UDF outputs.
+  absl::Status BuildResponse(
+      const v2::GetValuesRequest& request,
+      absl::flat_hash_map<UniquePartitionIdTuple, std::string> id_to_output_map,
+      v2::GetValuesResponse& response) const;
+
+  // Encodes the outputs of the partitions of one compression group, and
+  // compresses them on their own if `compress`.
+  absl::StatusOr<v2::CompressionGroup> BuildCompressionGroup(
+      int32_t compression_group_id,
+      std::vector<std::pair<int32_t, std::string>>& partition_output_pairs,
+      bool compress) const;
+
   const RequestContextFactory& request_context_factory_;
   const UdfClient& udf_client_;
   const V2EncoderDecoder& v2_codec_;
   bool enable_per_partition_metadata_;
+  // Compresses the streamed groups one at a time, as they are built.
+  const CompressionGroupCompressor compressor_;
+  bool build_compression_groups_eagerly_;
 };
 
 }  // namespace kv_server
@@ -15,11 +15,14 @@
 #include "components/data_server/request_handler/partitions/multi_partition_processor.h"
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/log/log.h"
+#include "components/data_server/request_handler/compression/compression_gzip.h"
 #include "components/data_server/request_handler/content_type/mocks.h"
 #include "components/data_server/request_handler/status/status_tag.h"
 #include "components/udf/mocks.h"
@@ -37,12 +40,68 @@ namespace {
 using google::protobuf::TextFormat;
 using grpc::StatusCode;
 using testing::_;
+using testing::ElementsAre;
+using testing::Pair;
 using testing::Return;
 using testing::ReturnRef;
 using testing::UnorderedElementsAre;
 using v2::GetValuesHttpRequest;
 using v2::ObliviousGetValuesRequest;
 
+// Holds each batch of UDF executions until the test completes it, so that
+// batches complete in the order of the test, like UDFs of uneven latency.
+class DeferredUdfClient : public MockUdfClient {
+ public:
+  using UdfClient::BatchExecuteCodeAsync;
+
+  void BatchExecuteCodeAsync(
+      const RequestContextFactory& request_context_factory,
+      absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
+      BatchExecuteCodeCallback callback) const override {
+    std::vector<UniquePartitionIdTuple> ids;
+    for (const auto& [id, udf_input] : udf_input_map) {
+      ids.push_back(id);
+    }
+    batches_.push_back({std::move(ids), std::move(callback)});
+  }
+
+  int NumPendingBatches() const { return batches_.size(); }
+
+  // Completes the batch with the partitions of `compression_group_id`.
+  void Complete(
+      int32_t compression_group_id,
+      absl::flat_hash_map<UniquePartitionIdTuple, std::string> outputs) {
+    Finish(compression_group_id, std::move(outputs));
+  }
+
+  void Fail(int32_t compression_group_id, absl::Status status) {
+    Finish(compression_group_id, std::move(status));
+  }
+
+ private:
+  struct Batch {
+    std::vector<UniquePartitionIdTuple> ids;
+    BatchExecuteCodeCallback callback;
+  };
+
+  void Finish(
+      int32_t compression_group_id,
+      absl::StatusOr<absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
+          outputs) {
+    auto it = absl::c_find_if(batches_, [&](const Batch& batch) {
+      return absl::c_all_of(batch.ids, [&](const auto& id) {
+        return std::get<1>(id) == compression_group_id;
+      });
+    });
+    ASSERT_NE(it, batches_.end());
+    auto callback = std::move(it->callback);
+    batches_.erase(it);
+    callback(std::move(outputs), ExecutionMetadata());
+  }
+
+  mutable std::vector<Batch> batches_;
+};
+
 struct TestingParameters {
   const std::string_view request_json;
 };
@@ -288,6 +347,284 @@ TEST_P(MultiPartitionProcessorTest, IgnoreFailedUdfCompressionGroup) {
   EXPECT_THAT(response, EqualsProto(expected_response));
 }
 
+TEST_P(MultiPartitionProcessorTest, LeavesCompressionGroupsUncompressed) {
+  absl::flat_hash_map<UniquePartitionIdTuple, std::string>
+      batch_execute_output = {{{0, 0}, "output1"}, {{0, 1}, "output2"}};
+  EXPECT_CALL(mock_udf_client_, BatchExecuteCode(_, _, _))
+      .WillOnce(Return(batch_execute_output));
+  const std::string content(1000, 'a');
+  EXPECT_CALL(mock_v2_codec_, EncodePartitionOutputs(_, _))
+      .Times(2)
+      .WillRepeatedly(Return(content));
+
+  auto request = GetTestRequestBody();
+  request.add_accept_compression("gzip");
+  v2::GetValuesResponse response;
+  ExecutionMetadata unused_execution_metadata;
+  // The handler compresses the whole response, since it reports the
+  // algorithm in the framing header.
+  MultiPartitionProcessor processor(
+      *request_context_factory_, mock_udf_client_, mock_v2_codec_,
+      /*enable_per_partition_metadata=*/false,
+      {.type = CompressionGroupCompressor::CompressionType::kGzip});
+  const auto status =
+      processor.Process(request, response, unused_execution_metadata);
+  ASSERT_TRUE(status.ok()) << status;
+
+  ASSERT_EQ(response.compression_groups_size(), 2);
+  for (const auto& compression_group : response.compression_groups()) {
+    EXPECT_EQ(compression_group.content(), content);
+  }
+}
+
+TEST_P(MultiPartitionProcessorTest, StreamingDoesNotCompressIfNotAccepted) {
+  EXPECT_CALL(mock_udf_client_, BatchExecuteCode(_, _, _))
+      .Times(2)
+      .WillRepeatedly(
+          [](const RequestContextFactory&,
+             absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>&
+                 udf_input_map,
+             ExecutionMetadata&) {
+            absl::flat_hash_map<UniquePartitionIdTuple, std::string> outputs;
+            for (const auto& [id, udf_input] : udf_input_map) {
+              outputs[id] = "output";
+            }
+            return outputs;
+          });
+  const std::string content(1000, 'a');
+  EXPECT_CALL(mock_v2_codec_, EncodePartitionOutputs(_, _))
+      .Times(2)
+      .WillRepeatedly(Return(content));
+
+  auto request = GetTestRequestBody();
+  request.add_accept_compression("gzip");
+  MultiPartitionProcessor processor(
+      *request_context_factory_, mock_udf_client_, mock_v2_codec_,
+      /*enable_per_partition_metadata=*/false,
+      {.type = CompressionGroupCompressor::CompressionType::kBrotli});
+  std::vector<v2::CompressionGroup> compression_groups;
+  std::optional<absl::Status> status;
+  processor.ProcessStreamingAsync(
+      request,
+      [&compression_groups](v2::CompressionGroup compression_group) {
+        compression_groups.push_back(std::move(compression_group));
+      },
+      [&status](absl::Status done_status, ExecutionMetadata) {
+        status = std::move(done_status);
+      });
+  ASSERT_TRUE(status.has_value());
+  ASSERT_TRUE(status->ok()) << *status;
+
+  ASSERT_EQ(compression_groups.size(), 2);
+  for (const auto& compression_group : compression_groups) {
+    EXPECT_EQ(compression_group.content(), content);
+  }
+}
+
+TEST_P(MultiPartitionProcessorTest,
+       StreamsEachCompressionGroupOnceItsPartitionsComplete) {
+  DeferredUdfClient udf_client;
+  EXPECT_CALL(mock_v2_codec_,
+              EncodePartitionOutputs(ElementsAre(Pair(0, "output1")), _))
+      .WillOnce(Return("compression_group_1_content"));
+  EXPECT_CALL(mock_v2_codec_,
+              EncodePartitionOutputs(
+                  ElementsAre(Pair(0, "output0"), Pair(2, "output2")), _))
+      .WillOnce(Return("compression_group_0_content"));
+
+  const auto request = GetTestRequestBody();
+  MultiPartitionProcessor processor(*request_context_factory_, udf_client,
+                                    mock_v2_codec_);
+  std::vector<v2::CompressionGroup> compression_groups;
+  std::optional<absl::Status> status;
+  processor.ProcessStreamingAsync(
+      request,
+      [&compression_groups](v2::CompressionGroup compression_group) {
+        compression_groups.push_back(std::move(compression_group));
+      },
+      [&status](absl::Status done_status, ExecutionMetadata) {
+        status = std::move(done_status);
+      });
+  // Each compression group runs as a separate batch.
+  ASSERT_EQ(udf_client.NumPendingBatches(), 2);
+
+  // The fast group does not wait for the slow one.
+  udf_client.Complete(/*compression_group_id=*/1, {{{0, 1}, "output1"}});
+  v2::CompressionGroup expected_compression_group;
+  TextFormat::ParseFromString(
+      R"pb(compression_group_id: 1 content: "compression_group_1_content")pb",
+      &expected_compression_group);
+  EXPECT_THAT(compression_groups,
+              ElementsAre(EqualsProto(expected_compression_group)));
+  EXPECT_FALSE(status.has_value());
+
+  udf_client.Complete(/*compression_group_id=*/0,
+                      {{{0, 0}, "output0"}, {{2, 0}, "output2"}});
+  ASSERT_EQ(compression_groups.size(), 2);
+  TextFormat::ParseFromString(
+      R"pb(compression_group_id: 0 content: "compression_group_0_content")pb",
+      &expected_compression_group);
+  EXPECT_THAT(compression_groups[1], EqualsProto(expected_compression_group));
+  ASSERT_TRUE(status.has_value());
+  EXPECT_TRUE(status->ok()) << *status;
+}
+
+TEST_P(MultiPartitionProcessorTest, StreamingIgnoresFailedCompressionGroup) {
+  DeferredUdfClient udf_client;
+  EXPECT_CALL(mock_v2_codec_,
+              EncodePartitionOutputs(ElementsAre(Pair(0, "output1")), _))
+      .WillOnce(Return("compression_group_1_content"));
+
+  const auto request = GetTestRequestBody();
+  MultiPartitionProcessor processor(*request_context_factory_, udf_client,
+                                    mock_v2_codec_);
+  std::vector<v2::CompressionGroup> compression_groups;
+  std::optional<absl::Status> status;
+  processor.ProcessStreamingAsync(
+      request,
+      [&compression_groups](v2::CompressionGroup compression_group) {
+        compression_groups.push_back(std::move(compression_group));
+      },
+      [&status](absl::Status done_status, ExecutionMetadata) {
+        status = std::move(done_status);
+      });
+  udf_client.Fail(/*compression_group_id=*/0,
+                  absl::InternalError("Batch UDF execution error"));
+  udf_client.Complete(/*compression_group_id=*/1, {{{0, 1}, "output1"}});
+
+  ASSERT_EQ(compression_groups.size(), 1);
+  EXPECT_EQ(compression_groups[0].compression_group_id(), 1);
+  ASSERT_TRUE(status.has_value());
+  EXPECT_TRUE(status->ok()) << *status;
+}
+
+TEST_P(MultiPartitionProcessorTest, StreamingReturnsErrorWhenAllGroupsFail) {
+  DeferredUdfClient udf_client;
+  EXPECT_CALL(mock_v2_codec_, EncodePartitionOutputs(_, _)).Times(0);
+
+  const auto request = GetTestRequestBody();
+  MultiPartitionProcessor processor(*request_context_factory_, udf_client,
+                                    mock_v2_codec_);
+  int num_compression_groups = 0;
+  std::optional<absl::Status> status;
+  processor.ProcessStreamingAsync(
+      request,
+      [&num_compression_groups](v2::CompressionGroup) {
+        ++num_compression_groups;
+      },
+      [&status](absl::Status done_status, ExecutionMetadata) {
+        status = std::move(done_status);
+      });
+  udf_client.Fail(/*compression_group_id=*/1,
+                  absl::InternalError("Batch UDF execution error"));
+  EXPECT_FALSE(status.has_value());
+  udf_client.Fail(/*compression_group_id=*/0,
+                  absl::InternalError("Batch UDF execution error"));
+
+  EXPECT_EQ(num_compression_groups, 0);
+  ASSERT_TRUE(status.has_value());
+  EXPECT_FALSE(status->ok());
+  EXPECT_FALSE(IsV2RequestFormatError(*status));
+}
+
+TEST_P(MultiPartitionProcessorTest, StreamingCompressesEachCompressionGroup) {
+  EXPECT_CALL(mock_udf_client_, BatchExecuteCode(_, _, _))
+      .Times(2)
+      .WillRepeatedly(
+          [](const RequestContextFactory&,
+             absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>&
+                 udf_input_map,
+             ExecutionMetadata&) {
+            absl::flat_hash_map<UniquePartitionIdTuple, std::string> outputs;
+            for (const auto& [id, udf_input] : udf_input_map) {
+              outputs[id] = "output";
+            }
+            return outputs;
+          });
+  const std::string content(1000, 'a');
+  EXPECT_CALL(mock_v2_codec_, EncodePartitionOutputs(_, _))
+      .Times(2)
+      .WillRepeatedly(Return(content));
+
+  auto request = GetTestRequestBody();
+  request.add_accept_compression("gzip");
+  // Groups are built one at a time, so the size of the response is unknown.
+  MultiPartitionProcessor processor(
+      *request_context_factory_, mock_udf_client_, mock_v2_codec_,
+      /*enable_per_partition_metadata=*/false,
+      {.type = CompressionGroupCompressor::CompressionType::kGzip,
+       .min_size_bytes = 1000000});
+  std::vector<v2::CompressionGroup> compression_groups;
+  std::optional<absl::Status> status;
+  processor.ProcessStreamingAsync(
+      request,
+      [&compression_groups](v2::CompressionGroup compression_group) {
+        compression_groups.push_back(std::move(compression_group));
+      },
+      [&status](absl::Status done_status, ExecutionMetadata) {
+        status = std::move(done_status);
+      });
+  ASSERT_TRUE(status.has_value());
+  ASSERT_TRUE(status->ok()) << *status;
+
+  ASSERT_EQ(compression_groups.size(), 2);
+  for (const auto& compression_group : compression_groups) {
+    EXPECT_LT(compression_group.content().size(), content.size());
+    const auto decompressed = GzipDecompress(compression_group.content());
+    ASSERT_TRUE(decompressed.ok()) << decompressed.status();
+    EXPECT_EQ(*decompressed, content);
+  }
+}
+
+TEST_P(MultiPartitionProcessorTest,
+       BuildsCompressionGroupsEagerlyBeforeAllPartitionsComplete) {
+  DeferredUdfClient udf_client;
+  EXPECT_CALL(mock_v2_codec_,
+              EncodePartitionOutputs(ElementsAre(Pair(0, "output1")), _))
+      .WillOnce(Return("compression_group_1_content"));
+  EXPECT_CALL(mock_v2_codec_,
+              EncodePartitionOutputs(
+                  ElementsAre(Pair(0, "output0"), Pair(2, "output2")), _))
+      .WillOnce(Return("compression_group_0_content"));
+
+  const auto request = GetTestRequestBody();
+  v2::GetValuesResponse response;
+  MultiPartitionProcessor processor(
+      *request_context_factory_, udf_client, mock_v2_codec_,
+      /*enable_per_partition_metadata=*/false, /*compression_options=*/{},
+      /*build_compression_groups_eagerly=*/true);
+  std::optional<absl::Status> status;
+  processor.ProcessAsync(request, response,
+                         [&status](absl::Status done_status,
+                                   ExecutionMetadata) {
+                           status = std::move(done_status);
+                         });
+
+  // The outputs of the fast group are encoded, and no longer held, while the
+  // slow group is still running.
+  udf_client.Complete(/*compression_group_id=*/1, {{{0, 1}, "output1"}});
+  EXPECT_EQ(response.compression_groups_size(), 1);
+  EXPECT_FALSE(status.has_value());
+
+  udf_client.Complete(/*compression_group_id=*/0,
+                      {{{0, 0}, "output0"}, {{2, 0}, "output2"}});
+  ASSERT_TRUE(status.has_value());
+  EXPECT_TRUE(status->ok()) << *status;
+  v2::GetValuesResponse expected_response;
+  TextFormat::ParseFromString(
+      R"pb(
+        compression_groups {
+          compression_group_id: 1
+          content: "compression_group_1_content"
+        }
+        compression_groups {
+          compression_group_id: 0
+          content: "compression_group_0_content"
+        })pb",
+      &expected_response);
+  EXPECT_THAT(response, EqualsProto(expected_response));
+}
+
 TEST_P(MultiPartitionProcessorTest, IgnoreFailedUdfPartition) {
   nlohmann::json output1 = nlohmann::json::parse(R"(
   {
@@ -15,7 +15,9 @@
 #include "components/data_server/request_handler/partitions/partition_processor.h"
 
 #include <memory>
+#include <utility>
 
+#include "absl/synchronization/notification.h"
 #include "components/data_server/request_handler/content_type/encoder.h"
 #include "components/data_server/request_handler/partitions/multi_partition_processor.h"
 #include "components/data_server/request_handler/partitions/single_partition_processor.h"
@@ -24,6 +26,22 @@
 
 namespace kv_server {
 
+absl::Status PartitionProcessor::Process(
+    const v2::GetValuesRequest& request, v2::GetValuesResponse& response,
+    ExecutionMetadata& execution_metadata) const {
+  absl::Notification done;
+  absl::Status status;
+  ProcessAsync(request, response,
+               [&](absl::Status process_status,
+                   ExecutionMetadata process_execution_metadata) {
+                 status = std::move(process_status);
+                 execution_metadata = std::move(process_execution_metadata);
+                 done.Notify();
+               });
+  done.WaitForNotification();
+  return status;
+}
+
 std::unique_ptr<PartitionProcessor> PartitionProcessor::Create(
     bool single_partition_use_case,
     const RequestContextFactory& request_context_factory,
@@ -19,6 +19,7 @@
 
 #include <memory>
 
+#include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
 #include "components/data_server/request_handler/content_type/encoder.h"
 #include "components/udf/udf_client.h"
@@ -30,13 +31,24 @@ namespace kv_server {
 // Processor for v2::GetValuesRequest partitions
 class PartitionProcessor {
  public:
+  // Invoked once the response is populated.
+  using DoneCallback = absl::AnyInvocable<void(
+      absl::Status status, ExecutionMetadata execution_metadata)>;
+
   virtual ~PartitionProcessor() = default;
 
   // Handles building input for UdfClient and processes the UDF output
   // to populate the v2::GetValuesResponse
-  virtual absl::Status Process(const v2::GetValuesRequest& request,
-                               v2::GetValuesResponse& response,
-                               ExecutionMetadata& execution_metadata) const = 0;
+  absl::Status Process(const v2::GetValuesRequest& request,
+                       v2::GetValuesResponse& response,
+                       ExecutionMetadata& execution_metadata) const;
+
+  // Same as `Process`, without blocking the calling thread while the UDFs
+  // execute. `on_done` is invoked exactly once, possibly on a UDF execution
+  // thread. `request`, `response` and this processor must outlive that call.
+  virtual void ProcessAsync(const v2::GetValuesRequest& request,
+                            v2::GetValuesResponse& response,
+                            DoneCallback on_done) const = 0;
 
   static std::unique_ptr<PartitionProcessor> Create(
       bool single_partition_use_case,
@@ -32,17 +32,21 @@ SinglePartitionProcessor::SinglePartitionProcessor(
     : request_context_factory_(request_context_factory),
       udf_client_(udf_client) {}
 
-absl::Status SinglePartitionProcessor::Process(
-    const v2::GetValuesRequest& request, v2::GetValuesResponse& response,
-    ExecutionMetadata& execution_metadata) const {
+void SinglePartitionProcessor::ProcessAsync(const v2::GetValuesRequest& request,
+                                            v2::GetValuesResponse& response,
+                                            DoneCallback on_done) const {
   if (request.partitions().size() > 1) {
-    return V2RequestFormatErrorAsExternalHttpError(absl::InvalidArgumentError(
-        "This use case only accepts single partitions, but "
-        "multiple partitions were found."));
+    on_done(V2RequestFormatErrorAsExternalHttpError(absl::InvalidArgumentError(
+                "This use case only accepts single partitions, but "
+                "multiple partitions were found.")),
+            ExecutionMetadata());
+    return;
   }
   if (request.partitions().empty()) {
-    return V2RequestFormatErrorAsExternalHttpError(
-        absl::InvalidArgumentError("No partitions in request."));
+    on_done(V2RequestFormatErrorAsExternalHttpError(
+                absl::InvalidArgumentError("No partitions in request.")),
+            ExecutionMetadata());
+    return;
   }
 
   // TODO(b/355434272): Return early on CBOR content type (not supported)
@@ -56,20 +60,26 @@ absl::Status SinglePartitionProcessor::Process(
   if (!req_partition.metadata().fields().empty()) {
     *udf_metadata.mutable_partition_metadata() = req_partition.metadata();
   }
-  const auto maybe_output_string =
-      udf_client_.ExecuteCode(request_context_factory_, std::move(udf_metadata),
-                              req_partition.arguments(), execution_metadata);
-  if (!maybe_output_string.ok()) {
-    resp_partition->mutable_status()->set_code(
-        static_cast<int>(maybe_output_string.status().code()));
-    resp_partition->mutable_status()->set_message(
-        maybe_output_string.status().message());
-    return maybe_output_string.status();
-  }
-  PS_VLOG(5, request_context_factory_.Get().GetPSLogContext())
-      << "UDF output: " << maybe_output_string.value();
-  resp_partition->set_string_output(std::move(maybe_output_string).value());
-  return absl::OkStatus();
+  udf_client_.ExecuteCodeAsync(
+      request_context_factory_, std::move(udf_metadata),
+      req_partition.arguments(),
+      [this, resp_partition, on_done = std::move(on_done)](
+          absl::StatusOr<std::string> maybe_output_string,
+          ExecutionMetadata execution_metadata) mutable {
+        if (!maybe_output_string.ok()) {
+          resp_partition->mutable_status()->set_code(
+              static_cast<int>(maybe_output_string.status().code()));
+          resp_partition->mutable_status()->set_message(
+              maybe_output_string.status().message());
+          on_done(maybe_output_string.status(), std::move(execution_metadata));
+          return;
+        }
+        PS_VLOG(5, request_context_factory_.Get().GetPSLogContext())
+            << "UDF output: " << maybe_output_string.value();
+        resp_partition->set_string_output(
+            std::move(maybe_output_string).value());
+        on_done(absl::OkStatus(), std::move(execution_metadata));
+      });
 }
 
 }  // namespace kv_server
@@ -32,9 +32,9 @@ class SinglePartitionProcessor : public PartitionProcessor {
                            const UdfClient& udf_client);
 
   // Passes input to UDF and populates GetValuesResponse.single_partition_output
-  absl::Status Process(const v2::GetValuesRequest& request,
-                       v2::GetValuesResponse& response,
-                       ExecutionMetadata& execution_metadata) const override;
+  void ProcessAsync(const v2::GetValuesRequest& request,
+                    v2::GetValuesResponse& response,
+                    DoneCallback on_done) const override;
 
  private:
   const RequestContextFactory& request_context_factory_;
@@ -16,6 +16,12 @@
 
 #include <grpcpp/grpcpp.h>
 
+#include <deque>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
 #include "public/query/v2/get_values_v2.grpc.pb.h"
 #include "src/telemetry/telemetry.h"
 
@@ -28,10 +34,10 @@ using v2::GetValuesHttpRequest;
 using v2::KeyValueService;
 
 template <typename RequestT, typename ResponseT>
-using HandlerFunctionT = grpc::Status (GetValuesV2Handler::*)(
+using HandlerFunctionT = void (GetValuesV2Handler::*)(
     RequestContextFactory&, const RequestT&, ResponseT*,
-    ExecutionMetadata& execution_metadata, bool single_partition_use_case,
-    const V2EncoderDecoder& v2_codec) const;
+    bool single_partition_use_case, const V2EncoderDecoder& v2_codec,
+    GetValuesV2Handler::DoneCallback on_done) const;
 
 inline void LogTotalExecutionWithoutCustomCodeMetric(
     const privacy_sandbox::server_common::Stopwatch& stopwatch,
@@ -47,74 +53,231 @@ inline void LogTotalExecutionWithoutCustomCodeMetric(
       (duration_micros)));
 }
 
+// Returns the callback that logs the metrics of the request and finishes it,
+// which keeps the request context alive until then. The request and response
+// must not be accessed once the reactor is finished.
+template <typename RequestT, typename ResponseT>
+GetValuesV2Handler::DoneCallback FinishRequestCallback(
+    grpc::ServerUnaryReactor* reactor, const RequestT* request,
+    ResponseT* response,
+    std::unique_ptr<RequestContextFactory> request_context_factory) {
+  return [reactor, request, response,
+          stopwatch =
+              std::make_unique<privacy_sandbox::server_common::Stopwatch>(),
+          request_context_factory = std::move(request_context_factory)](
+             grpc::Status status, ExecutionMetadata execution_metadata) {
+    LogRequestCommonSafeMetrics(request, response, status, *stopwatch);
+    LogTotalExecutionWithoutCustomCodeMetric(
+        *stopwatch, execution_metadata.custom_code_total_execution_time_micros,
+        *request_context_factory);
+    reactor->Finish(status);
+  };
+}
+
 template <typename RequestT, typename ResponseT>
 grpc::ServerUnaryReactor* HandleRequest(
-    RequestContextFactory& request_context_factory,
+    std::unique_ptr<RequestContextFactory> request_context_factory,
     CallbackServerContext* context, const RequestT* request,
     ResponseT* response, bool is_single_partition_use_case,
     const GetValuesV2Handler& handler,
     HandlerFunctionT<RequestT, ResponseT> handler_function) {
-  privacy_sandbox::server_common::Stopwatch stopwatch;
-  ExecutionMetadata execution_metadata;
+  RequestContextFactory& request_context_factory_ref =
+      *request_context_factory;
+  auto* reactor = context->DefaultReactor();
+  auto on_done = FinishRequestCallback(reactor, request, response,
+                                       std::move(request_context_factory));
   auto v2_codec = V2EncoderDecoder::Create(V2EncoderDecoder::GetContentType(
       context->client_metadata(),
       /*default_content_type=*/V2EncoderDecoder::ContentType::kProto));
-  grpc::Status status = (handler.*handler_function)(
-      request_context_factory, *request, response, execution_metadata,
-      is_single_partition_use_case, *v2_codec);
-  auto* reactor = context->DefaultReactor();
-  reactor->Finish(status);
-  LogRequestCommonSafeMetrics(request, response, status, stopwatch);
-  LogTotalExecutionWithoutCustomCodeMetric(
-      stopwatch, execution_metadata.custom_code_total_execution_time_micros,
-      request_context_factory);
+  const V2EncoderDecoder& v2_codec_ref = *v2_codec;
+  (handler.*handler_function)(
+      request_context_factory_ref, *request, response,
+      is_single_partition_use_case, v2_codec_ref,
+      [v2_codec = std::move(v2_codec), on_done = std::move(on_done)](
+          grpc::Status status, ExecutionMetadata execution_metadata) mutable {
+        on_done(std::move(status), std::move(execution_metadata));
+      });
   return reactor;
 }
 
+// Writes the responses of a streamed request in order, as the handler builds
+// them, and finishes the RPC once the handler is done and every response was
+// written. gRPC only allows one write in flight, so the responses that are
+// built in the meantime are queued.
+class GetValuesStreamReactor
+    : public grpc::ServerWriteReactor<v2::GetValuesResponse> {
+ public:
+  GetValuesStreamReactor(const GetValuesV2Handler& handler,
+                         CallbackServerContext* context,
+                         const v2::GetValuesRequest* request)
+      : request_(request),
+        v2_codec_(V2EncoderDecoder::Create(V2EncoderDecoder::GetContentType(
+            context->client_metadata(),
+            /*default_content_type=*/V2EncoderDecoder::ContentType::kProto))) {
+    handler.GetValuesStreamAsync(
+        request_context_factory_, *request, &last_response_, *v2_codec_,
+        [this](v2::CompressionGroup compression_group) {
+          v2::GetValuesResponse response;
+          *response.add_compression_groups() = std::move(compression_group);
+          Step step;
+          {
+            absl::MutexLock lock(&mutex_);
+            if (cancelled_) {
+              return;
+            }
+            pending_responses_.push_back(std::move(response));
+            step = NextStep();
+          }
+          TakeStep(std::move(step));
+        },
+        [this](grpc::Status status, ExecutionMetadata execution_metadata) {
+          LogRequestCommonSafeMetrics(request_, &last_response_, status,
+                                      stopwatch_);
+          LogTotalExecutionWithoutCustomCodeMetric(
+              stopwatch_,
+              execution_metadata.custom_code_total_execution_time_micros,
+              request_context_factory_);
+          Step step;
+          {
+            absl::MutexLock lock(&mutex_);
+            // The debug info, or the single partition, comes last.
+            if (status.ok() && !cancelled_ &&
+                last_response_.ByteSizeLong() > 0) {
+              pending_responses_.push_back(std::move(last_response_));
+            }
+            status_ = std::move(status);
+            step = NextStep();
+          }
+          TakeStep(std::move(step));
+        });
+  }
+
+  void OnWriteDone(bool ok) override {
+    Step step;
+    {
+      absl::MutexLock lock(&mutex_);
+      writing_ = false;
+      if (!ok) {
+        // The stream is broken, later writes would fail too.
+        cancelled_ = true;
+        pending_responses_.clear();
+      }
+      step = NextStep();
+    }
+    TakeStep(std::move(step));
+  }
+
+  void OnCancel() override {
+    absl::MutexLock lock(&mutex_);
+    cancelled_ = true;
+    pending_responses_.clear();
+  }
+
+  void OnDone() override { delete this; }
+
+ private:
+  // The gRPC call to make once the lock is released, since gRPC may react
+  // inline.
+  struct Step {
+    bool start_write = false;
+    std::optional<grpc::Status> finish_status;
+  };
+
+  // Takes the next pending response to write, if no write is in flight, or
+  // decides to finish the RPC once there is nothing left to write. The RPC is
+  // only finished after the handler is done, since it uses the request until
+  // then.
+  //
+  // Must be called in the same critical section that changed the state:
+  // once the lock is released, another thread may finish the RPC, after which
+  // the reactor may be deleted at any time.
+  Step NextStep() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    if (writing_ || finished_) {
+      return {};
+    }
+    if (pending_responses_.empty()) {
+      if (!status_.has_value()) {
+        return {};
+      }
+      finished_ = true;
+      return {.finish_status = std::move(status_)};
+    }
+    writing_response_ = std::move(pending_responses_.front());
+    pending_responses_.pop_front();
+    writing_ = true;
+    return {.start_write = true};
+  }
+
+  // Makes the gRPC call of `step`. The reactor must not be accessed after this
+  // returns, unless a write is known to be in flight.
+  void TakeStep(Step step) ABSL_LOCKS_EXCLUDED(mutex_) {
+    if (step.finish_status.has_value()) {
+      Finish(*std::move(step.finish_status));
+    } else if (step.start_write) {
+      StartWrite(&writing_response_);
+    }
+  }
+
+  const v2::GetValuesRequest* request_;
+  RequestContextFactory request_context_factory_;
+  std::unique_ptr<V2EncoderDecoder> v2_codec_;
+  privacy_sandbox::server_common::Stopwatch stopwatch_;
+  // Written by the handler until it is done.
+  v2::GetValuesResponse last_response_;
+  absl::Mutex mutex_;
+  std::deque<v2::GetValuesResponse> pending_responses_ ABSL_GUARDED_BY(mutex_);
+  // Only accessed by the write in flight.
+  v2::GetValuesResponse writing_response_;
+  bool writing_ ABSL_GUARDED_BY(mutex_) = false;
+  bool cancelled_ ABSL_GUARDED_BY(mutex_) = false;
+  bool finished_ ABSL_GUARDED_BY(mutex_) = false;
+  // Set once the handler is done.
+  std::optional<grpc::Status> status_ ABSL_GUARDED_BY(mutex_);
+};
+
 }  // namespace
 
 grpc::ServerUnaryReactor* KeyValueServiceV2Impl::GetValuesHttp(
     CallbackServerContext* context, const GetValuesHttpRequest* request,
     google::api::HttpBody* response) {
-  privacy_sandbox::server_common::Stopwatch stopwatch;
   auto request_context_factory = std::make_unique<RequestContextFactory>();
-  ExecutionMetadata execution_metadata;
-  grpc::Status status = handler_.GetValuesHttp(
-      *request_context_factory, context->client_metadata(), *request, response,
-      execution_metadata);
+  RequestContextFactory& request_context_factory_ref =
+      *request_context_factory;
   auto* reactor = context->DefaultReactor();
-  reactor->Finish(status);
-  LogRequestCommonSafeMetrics(request, response, status, stopwatch);
-  LogTotalExecutionWithoutCustomCodeMetric(
-      stopwatch, execution_metadata.custom_code_total_execution_time_micros,
-      *request_context_factory);
+  handler_.GetValuesHttpAsync(
+      request_context_factory_ref, context->client_metadata(), *request,
+      response,
+      FinishRequestCallback(reactor, request, response,
+                            std::move(request_context_factory)));
   return reactor;
 }
 grpc::ServerUnaryReactor* KeyValueServiceV2Impl::GetValues(
     grpc::CallbackServerContext* context, const v2::GetValuesRequest* request,
     v2::GetValuesResponse* response) {
-  auto request_context_factory = std::make_unique<RequestContextFactory>();
-  return HandleRequest(*request_context_factory, context, request, response,
-                       IsSinglePartitionUseCase(*request), handler_,
-                       &GetValuesV2Handler::GetValues);
+  return HandleRequest(std::make_unique<RequestContextFactory>(), context,
+                       request, response, IsSinglePartitionUseCase(*request),
+                       handler_, &GetValuesV2Handler::GetValuesAsync);
+}
+
+grpc::ServerWriteReactor<v2::GetValuesResponse>*
+KeyValueServiceV2Impl::GetValuesStream(grpc::CallbackServerContext* context,
+                                       const v2::GetValuesRequest* request) {
+  return new GetValuesStreamReactor(handler_, context, request);
 }
 
 grpc::ServerUnaryReactor* KeyValueServiceV2Impl::ObliviousGetValues(
     CallbackServerContext* context,
     const v2::ObliviousGetValuesRequest* request,
     google::api::HttpBody* response) {
-  privacy_sandbox::server_common::Stopwatch stopwatch;
   auto request_context_factory = std::make_unique<RequestContextFactory>();
-  ExecutionMetadata execution_metadata;
-  grpc::Status status = handler_.ObliviousGetValues(
-      *request_context_factory, context->client_metadata(), *request, response,
-      execution_metadata);
+  RequestContextFactory& request_context_factory_ref =
+      *request_context_factory;
   auto* reactor = context->DefaultReactor();
-  reactor->Finish(status);
-  LogRequestCommonSafeMetrics(request, response, status, stopwatch);
-  LogTotalExecutionWithoutCustomCodeMetric(
-      stopwatch, execution_metadata.custom_code_total_execution_time_micros,
-      *request_context_factory);
+  handler_.ObliviousGetValuesAsync(
+      request_context_factory_ref, context->client_metadata(), *request,
+      response,
+      FinishRequestCallback(reactor, request, response,
+                            std::move(request_context_factory)));
   return reactor;
 }
 
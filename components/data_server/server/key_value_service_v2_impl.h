@@ -28,6 +28,9 @@
 namespace kv_server {
 
 // Implements Key-Value service Query V2 API.
+//
+// Requests are finished once their UDFs complete, so the server threads are
+// not blocked while the UDFs execute.
 class KeyValueServiceV2Impl final
     : public v2::KeyValueService::CallbackService {
  public:
@@ -43,6 +46,12 @@ class KeyValueServiceV2Impl final
                                       const v2::GetValuesRequest* request,
                                       v2::GetValuesResponse* response) override;
 
+  // Writes each compression group as soon as it is built, see
+  // `GetValuesV2Handler::GetValuesStreamAsync`.
+  grpc::ServerWriteReactor<v2::GetValuesResponse>* GetValuesStream(
+      grpc::CallbackServerContext* context,
+      const v2::GetValuesRequest* request) override;
+
   grpc::ServerUnaryReactor* ObliviousGetValues(
       grpc::CallbackServerContext* context,
       const v2::ObliviousGetValuesRequest* request,
@@ -0,0 +1,124 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/server/key_value_service_v2_impl.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "components/telemetry/server_definition.h"
+#include "components/udf/mocks.h"
+#include "grpcpp/grpcpp.h"
+#include "gtest/gtest.h"
+#include "src/encryption/key_fetcher/fake_key_fetcher_manager.h"
+
+namespace kv_server {
+namespace {
+
+// Completes each batch of UDF executions on a thread of its own, so that the
+// handler completes while the reactor writes the compression groups that
+// completed before.
+class ThreadedUdfClient : public MockUdfClient {
+ public:
+  ~ThreadedUdfClient() override { Join(); }
+
+  void BatchExecuteCodeAsync(
+      const RequestContextFactory& request_context_factory,
+      absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
+      BatchExecuteCodeCallback callback) const override {
+    absl::flat_hash_map<UniquePartitionIdTuple, std::string> outputs;
+    for (const auto& [id, udf_input] : udf_input_map) {
+      outputs[id] = R"({"keyGroupOutputs": []})";
+    }
+    absl::MutexLock lock(&mutex_);
+    threads_.emplace_back([outputs = std::move(outputs),
+                           callback = std::move(callback)]() mutable {
+      callback(std::move(outputs), ExecutionMetadata());
+    });
+  }
+
+  void Join() {
+    std::vector<std::thread> threads;
+    {
+      absl::MutexLock lock(&mutex_);
+      threads = std::move(threads_);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+ private:
+  mutable absl::Mutex mutex_;
+  mutable std::vector<std::thread> threads_ ABSL_GUARDED_BY(mutex_);
+};
+
+class KeyValueServiceV2ImplTest : public ::testing::Test {
+ protected:
+  KeyValueServiceV2ImplTest() {
+    InitMetricsContextMap();
+    service_ = std::make_unique<KeyValueServiceV2Impl>(
+        GetValuesV2Handler(udf_client_, fake_key_fetcher_manager_));
+    grpc::ServerBuilder builder;
+    builder.RegisterService(service_.get());
+    server_ = builder.BuildAndStart();
+    stub_ = v2::KeyValueService::NewStub(
+        server_->InProcessChannel(grpc::ChannelArguments()));
+  }
+  ~KeyValueServiceV2ImplTest() override {
+    udf_client_.Join();
+    server_->Shutdown();
+    server_->Wait();
+  }
+
+  ThreadedUdfClient udf_client_;
+  privacy_sandbox::server_common::FakeKeyFetcherManager
+      fake_key_fetcher_manager_;
+  std::unique_ptr<KeyValueServiceV2Impl> service_;
+  std::unique_ptr<grpc::Server> server_;
+  std::unique_ptr<v2::KeyValueService::Stub> stub_;
+};
+
+// Compression groups and the handler complete on UDF threads while earlier
+// groups are written, so that write completions interleave with the handler
+// completion. The RPC must only finish once, after every group is written.
+TEST_F(KeyValueServiceV2ImplTest, GetValuesStreamWritesEveryGroupBeforeFinish) {
+  constexpr int kNumCompressionGroups = 8;
+  v2::GetValuesRequest request;
+  for (int i = 0; i < kNumCompressionGroups; ++i) {
+    auto* partition = request.add_partitions();
+    partition->set_id(i);
+    partition->set_compression_group_id(i);
+    partition->add_arguments()->mutable_data()->set_string_value("key");
+  }
+  for (int i = 0; i < 100; ++i) {
+    grpc::ClientContext context;
+    auto reader = stub_->GetValuesStream(&context, request);
+    int num_compression_groups = 0;
+    v2::GetValuesResponse response;
+    while (reader->Read(&response)) {
+      num_compression_groups += response.compression_groups_size();
+    }
+    const grpc::Status status = reader->Finish();
+    EXPECT_TRUE(status.ok()) << status.error_message();
+    EXPECT_EQ(num_compression_groups, kNumCompressionGroups);
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -15,6 +15,7 @@
 
 #include "components/data_server/server/server.h"
 
+#include <algorithm>
 #include <optional>
 
 #include "absl/flags/flag.h"
@@ -24,8 +25,10 @@
 #include "absl/log/log.h"
 #include "absl/log/log_sink_registry.h"
 #include "absl/status/status.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "components/data/blob_storage/blob_prefix_allowlist.h"
+#include "components/data_server/request_handler/compression/compression_group_compressor.h"
 #include "components/data_server/request_handler/get_values_adapter.h"
 #include "components/data_server/request_handler/get_values_handler.h"
 #include "components/data_server/request_handler/get_values_v2_handler.h"
@@ -114,10 +117,57 @@ constexpr absl::string_view kAddMissingKeysV1Suffix = "add-missing-keys-v1";
 constexpr absl::string_view kAutoscalerHealthcheck = "autoscaler-healthcheck";
 constexpr absl::string_view kLoadbalancerHealthcheck =
     "loadbalancer-healthcheck";
+// Serving once the initial data load for all allowlisted prefixes is complete.
+constexpr absl::string_view kDataLoadingHealthcheck =
+    "data-loading-healthcheck";
 constexpr absl::string_view kEnableOtelLoggerParameterSuffix =
     "enable-otel-logger";
 constexpr std::string_view kDataLoadingBlobPrefixAllowlistSuffix =
     "data-loading-blob-prefix-allowlist";
+constexpr std::string_view kDataLoadingReadinessPolicySuffix =
+    "data-loading-readiness-policy";
+constexpr std::string_view kDataLoadingCriticalPrefixesSuffix =
+    "data-loading-critical-prefixes";
+// Local directory the cache is checkpointed to for warm restarts. Disabled
+// if empty.
+constexpr std::string_view kDataLoadingCacheCheckpointDirectorySuffix =
+    "data-loading-cache-checkpoint-directory";
+constexpr absl::Duration kCacheCheckpointInterval = absl::Minutes(10);
+// Realtime updates received within this many milliseconds of each other are
+// applied to the cache in one batch.
+constexpr std::string_view kRealtimeBatchWindowMillisSuffix =
+    "realtime-batch-window-millis";
+constexpr std::string_view kRealtimeMaxBatchMessagesSuffix =
+    "realtime-max-batch-messages";
+// Deleted keys of realtime updates are removed once every this many batches.
+// Disabled if 0.
+constexpr std::string_view kRealtimeCleanupBatchIntervalSuffix =
+    "realtime-cleanup-batch-interval";
+// Whether the cache keeps a Bloom filter of its keys to skip lookups of absent
+// keys. Disabled by default.
+constexpr std::string_view kCacheEnableKeyFilterSuffix =
+    "cache-enable-key-filter";
+// Whether the cache parses values as JSON when they are loaded, so that V1
+// responses that are not routed to V2 do not parse them per request. Disabled
+// by default.
+constexpr std::string_view kCacheParseJsonValuesSuffix =
+    "cache-parse-json-values";
+// Algorithm ("none", "brotli" or "gzip") the compression groups of V2
+// responses are compressed with, if the request accepts it.
+constexpr std::string_view kResponseCompressionAlgorithmSuffix =
+    "response-compression-algorithm";
+// Brotli quality or zlib level. The default of the algorithm if negative.
+constexpr std::string_view kResponseCompressionLevelSuffix =
+    "response-compression-level";
+// Responses whose compression groups add up to fewer bytes are not
+// compressed.
+constexpr std::string_view kResponseCompressionMinSizeBytesSuffix =
+    "response-compression-min-size-bytes";
+// Number of threads compressing the compression groups of responses, on top
+// of the request threads.
+constexpr std::string_view kResponseCompressionNumThreadsSuffix =
+    "response-compression-num-threads";
+constexpr int64_t kDefaultResponseCompressionNumThreads = 4;
 constexpr std::string_view kTelemetryConfigSuffix = "telemetry-config";
 constexpr std::string_view kConsentedDebugTokenSuffix = "consented-debug-token";
 constexpr std::string_view kEnableConsentedLogSuffix = "enable-consented-log";
@@ -186,6 +236,117 @@ BlobPrefixAllowlist GetBlobPrefixAllowlist(
   return BlobPrefixAllowlist(prefix_allowlist);
 }
 
+ReadinessPolicy GetReadinessPolicy(const ParameterFetcher& parameter_fetcher,
+                                   PSLogContext& log_context) {
+  const auto policy_name = parameter_fetcher.GetParameter(
+      kDataLoadingReadinessPolicySuffix,
+      /*default_value=*/std::string(
+          ReadinessPolicyName(ReadinessPolicy::kAllPrefixes)));
+  PS_LOG(INFO, log_context) << "Retrieved " << kDataLoadingReadinessPolicySuffix
+                            << " parameter: " << policy_name;
+  auto policy = ParseReadinessPolicy(policy_name);
+  if (!policy.ok()) {
+    PS_LOG(ERROR, log_context)
+        << policy.status() << ". Falling back to waiting for all prefixes.";
+    return ReadinessPolicy::kAllPrefixes;
+  }
+  return *policy;
+}
+
+// Returns the critical prefixes. Like the allowlist, the bucket level prefix is
+// always included.
+absl::flat_hash_set<std::string> GetCriticalPrefixes(
+    const ParameterFetcher& parameter_fetcher, PSLogContext& log_context) {
+  const auto critical_prefixes = parameter_fetcher.GetParameter(
+      kDataLoadingCriticalPrefixesSuffix, /*default_value=*/"");
+  PS_LOG(INFO, log_context)
+      << "Retrieved " << kDataLoadingCriticalPrefixesSuffix
+      << " parameter: " << critical_prefixes;
+  return BlobPrefixAllowlist(critical_prefixes).Prefixes();
+}
+
+// Returns the value of the optional integer parameter, or `default_value` if
+// it is not set or not an integer.
+int64_t GetOptionalInt64Parameter(const ParameterFetcher& parameter_fetcher,
+                                  std::string_view parameter_suffix,
+                                  int64_t default_value,
+                                  PSLogContext& log_context) {
+  const auto value = parameter_fetcher.GetParameter(
+      parameter_suffix, /*default_value=*/absl::StrCat(default_value));
+  PS_LOG(INFO, log_context)
+      << "Retrieved " << parameter_suffix << " parameter: " << value;
+  int64_t result;
+  if (!absl::SimpleAtoi(value, &result)) {
+    PS_LOG(ERROR, log_context)
+        << "Invalid " << parameter_suffix << " parameter: " << value
+        << ". Falling back to " << default_value;
+    return default_value;
+  }
+  return result;
+}
+
+// Returns the value of the optional boolean parameter, or `default_value` if
+// it is not set or not a boolean.
+bool GetOptionalBoolParameter(const ParameterFetcher& parameter_fetcher,
+                              std::string_view parameter_suffix,
+                              bool default_value, PSLogContext& log_context) {
+  const auto value = parameter_fetcher.GetParameter(
+      parameter_suffix,
+      /*default_value=*/default_value ? "true" : "false");
+  PS_LOG(INFO, log_context)
+      << "Retrieved " << parameter_suffix << " parameter: " << value;
+  bool result;
+  if (!absl::SimpleAtob(value, &result)) {
+    PS_LOG(ERROR, log_context)
+        << "Invalid " << parameter_suffix << " parameter: " << value
+        << ". Falling back to " << default_value;
+    return default_value;
+  }
+  return result;
+}
+
+CompressionGroupCompressor::Options GetResponseCompressionOptions(
+    const ParameterFetcher& parameter_fetcher, PSLogContext& log_context) {
+  const CompressionGroupCompressor::Options defaults;
+  const auto algorithm = parameter_fetcher.GetParameter(
+      kResponseCompressionAlgorithmSuffix,
+      /*default_value=*/std::string(
+          CompressionGroupCompressor::Name(defaults.type)));
+  PS_LOG(INFO, log_context)
+      << "Retrieved " << kResponseCompressionAlgorithmSuffix
+      << " parameter: " << algorithm;
+  auto type = CompressionGroupCompressor::FromName(algorithm);
+  if (!type.ok()) {
+    PS_LOG(ERROR, log_context)
+        << type.status() << ". Falling back to uncompressed responses.";
+    return defaults;
+  }
+  return {
+      .type = *type,
+      .level = static_cast<int>(GetOptionalInt64Parameter(
+          parameter_fetcher, kResponseCompressionLevelSuffix, defaults.level,
+          log_context)),
+      .min_size_bytes = GetOptionalInt64Parameter(
+          parameter_fetcher, kResponseCompressionMinSizeBytesSuffix,
+          defaults.min_size_bytes, log_context),
+  };
+}
+
+RealtimeUpdateBatcherOptions GetRealtimeBatchingOptions(
+    const ParameterFetcher& parameter_fetcher, PSLogContext& log_context) {
+  const RealtimeUpdateBatcherOptions defaults;
+  return {
+      .batch_window = absl::Milliseconds(GetOptionalInt64Parameter(
+          parameter_fetcher, kRealtimeBatchWindowMillisSuffix,
+          absl::ToInt64Milliseconds(defaults.batch_window), log_context)),
+      .max_batch_messages = std::max<int64_t>(
+          1, GetOptionalInt64Parameter(parameter_fetcher,
+                                       kRealtimeMaxBatchMessagesSuffix,
+                                       defaults.max_batch_messages,
+                                       log_context)),
+  };
+}
+
 }  // namespace
 
 Server::Server()
@@ -206,8 +367,8 @@ Server::Server()
 // Because the cache relies on telemetry, this function needs to be
 // called right after telemetry has been initialized but before anything that
 // requires the cache has been initialized.
-void Server::InitializeKeyValueCache() {
-  cache_ = KeyValueCache::Create();
+void Server::InitializeKeyValueCache(KeyValueCacheOptions options) {
+  cache_ = KeyValueCache::Create(options);
   cache_->UpdateKeyValue(
       server_safe_log_context_, "hi",
       "Hello, world! If you are seeing this, it means you can "
@@ -447,7 +608,6 @@ absl::Status Server::InitOnceInstancesAreCreated() {
 #if defined(MICROSOFT_AD_SELECTION_BUILD)
   microsoft_ann_index_ = std::make_unique<microsoft::ANNIndex>();
 #endif  // defined(MICROSOFT_AD_SELECTION_BUILD)
-  InitializeKeyValueCache();
   auto span = GetTracer()->StartSpan("InitServer");
   auto scope = opentelemetry::trace::Scope(span);
   PS_LOG(INFO, server_safe_log_context_) << "Creating lifecycle heartbeat...";
@@ -456,6 +616,14 @@ absl::Status Server::InitOnceInstancesAreCreated() {
   ParameterFetcher parameter_fetcher(
       environment_, *parameter_client_,
       LogStatusSafeMetricsFn<kGetParameterStatus>(), server_safe_log_context_);
+  InitializeKeyValueCache({
+      .enable_key_filter = GetOptionalBoolParameter(
+          parameter_fetcher, kCacheEnableKeyFilterSuffix,
+          /*default_value=*/false, server_safe_log_context_),
+      .parse_json_values = GetOptionalBoolParameter(
+          parameter_fetcher, kCacheParseJsonValuesSuffix,
+          /*default_value=*/false, server_safe_log_context_),
+  });
   if (absl::Status status = lifecycle_heartbeat->Start(parameter_fetcher);
       status != absl::OkStatus()) {
     return status;
@@ -703,6 +871,25 @@ std::unique_ptr<DataOrchestrator> Server::CreateDataOrchestrator(
   PS_LOG(INFO, server_safe_log_context_)
       << "Retrieved " << kDataBucketParameterSuffix
       << " parameter: " << data_bucket;
+  const std::string checkpoint_directory = parameter_fetcher.GetParameter(
+      kDataLoadingCacheCheckpointDirectorySuffix, /*default_value=*/"");
+  PS_LOG(INFO, server_safe_log_context_)
+      << "Retrieved " << kDataLoadingCacheCheckpointDirectorySuffix
+      << " parameter: " << checkpoint_directory;
+  if (!checkpoint_directory.empty()) {
+    cache_checkpointer_ =
+        std::make_unique<CacheCheckpointer>(CacheCheckpointer::Options{
+            .cache = *cache_,
+            .directory = checkpoint_directory,
+            .interval = kCacheCheckpointInterval,
+            .data_bucket = data_bucket,
+            .shard_num = shard_num_,
+            .num_shards = num_shards_,
+            .sharding_function_fingerprint =
+                key_sharder.GetFingerprint(num_shards_),
+            .log_context = server_safe_log_context_,
+        });
+  }
   auto metrics_callback =
       LogStatusSafeMetricsFn<kCreateDataOrchestratorStatus>();
   return TraceRetryUntilOk(
@@ -721,6 +908,21 @@ std::unique_ptr<DataOrchestrator> Server::CreateDataOrchestrator(
             .key_sharder = std::move(key_sharder),
             .blob_prefix_allowlist = GetBlobPrefixAllowlist(
                 parameter_fetcher, server_safe_log_context_),
+            .readiness_policy =
+                GetReadinessPolicy(parameter_fetcher, server_safe_log_context_),
+            .critical_prefixes = GetCriticalPrefixes(parameter_fetcher,
+                                                     server_safe_log_context_),
+            .on_initial_load_complete =
+                [this]() {
+                  grpc_server_->GetHealthCheckService()->SetServingStatus(
+                      std::string(kDataLoadingHealthcheck), true);
+                },
+            .cache_checkpointer = cache_checkpointer_.get(),
+            .realtime_batching = GetRealtimeBatchingOptions(
+                parameter_fetcher, server_safe_log_context_),
+            .realtime_cleanup_batch_interval = GetOptionalInt64Parameter(
+                parameter_fetcher, kRealtimeCleanupBatchIntervalSuffix,
+                /*default_value=*/0, server_safe_log_context_),
             .log_context = server_safe_log_context_,
 #if defined(MICROSOFT_AD_SELECTION_BUILD)
             .microsoft_ann_index = *microsoft_ann_index_,
@@ -743,7 +945,22 @@ void Server::CreateGrpcServices(const ParameterFetcher& parameter_fetcher) {
                            add_missing_keys_v1);
   grpc_services_.push_back(
       std::make_unique<KeyValueServiceImpl>(std::move(handler)));
-  GetValuesV2Handler v2handler(*udf_client_, *key_fetcher_manager_);
+  const auto compression_options = GetResponseCompressionOptions(
+      parameter_fetcher, server_safe_log_context_);
+  if (compression_options.type !=
+      CompressionGroupCompressor::CompressionType::kUncompressed) {
+    compression_thread_pool_ = std::make_unique<CompressionThreadPool>(
+        std::max<int64_t>(
+            0, GetOptionalInt64Parameter(
+                   parameter_fetcher, kResponseCompressionNumThreadsSuffix,
+                   kDefaultResponseCompressionNumThreads,
+                   server_safe_log_context_)));
+  }
+  GetValuesV2Handler v2handler(
+      *udf_client_, *key_fetcher_manager_,
+      &CompressionGroupConcatenator::Create,
+      CompressionGroupCompressor(compression_options,
+                                 compression_thread_pool_.get()));
   grpc_services_.push_back(
       std::make_unique<KeyValueServiceV2Impl>(std::move(v2handler)));
 }
@@ -776,6 +993,8 @@ std::unique_ptr<grpc::Server> Server::CreateAndStartGrpcServer() {
       std::string(kAutoscalerHealthcheck), true);
   server->GetHealthCheckService()->SetServingStatus(
       std::string(kLoadbalancerHealthcheck), false);
+  server->GetHealthCheckService()->SetServingStatus(
+      std::string(kDataLoadingHealthcheck), false);
   return server;
 }
 
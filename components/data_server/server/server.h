@@ -31,7 +31,9 @@
 #include "components/data/realtime/realtime_thread_pool_manager.h"
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/data_loading/cache_checkpointer.h"
 #include "components/data_server/data_loading/data_orchestrator.h"
+#include "components/data_server/request_handler/compression/compression_thread_pool.h"
 #include "components/data_server/request_handler/get_values_adapter.h"
 #include "components/data_server/server/lifecycle_heartbeat.h"
 #include "components/data_server/server/parameter_fetcher.h"
@@ -85,7 +87,7 @@ class Server {
       std::unique_ptr<UdfClient> udf_client);
 
   absl::Status InitOnceInstancesAreCreated();
-  void InitializeKeyValueCache();
+  void InitializeKeyValueCache(KeyValueCacheOptions options);
 
   std::unique_ptr<BlobStorageClient> CreateBlobClient(
       const ParameterFetcher& parameter_fetcher);
@@ -123,6 +125,9 @@ class Server {
   std::unique_ptr<ParameterClient> parameter_client_;
   std::unique_ptr<InstanceClient> instance_client_;
   std::string environment_;
+  // Declared before the services, which compress responses on it, so that
+  // it outlives them. Null if responses are not compressed.
+  std::unique_ptr<CompressionThreadPool> compression_thread_pool_;
   std::vector<std::unique_ptr<grpc::Service>> grpc_services_;
   std::unique_ptr<grpc::Server> grpc_server_;
   std::unique_ptr<Cache> cache_;
@@ -144,6 +149,7 @@ class Server {
   std::unique_ptr<BlobStorageChangeNotifier> change_notifier_;
   std::unique_ptr<RealtimeThreadPoolManager> realtime_thread_pool_manager_;
   std::unique_ptr<StreamRecordReaderFactory> delta_stream_reader_factory_;
+  std::unique_ptr<CacheCheckpointer> cache_checkpointer_;
 
   std::unique_ptr<DataOrchestrator> data_orchestrator_;
 
@@ -259,6 +259,22 @@ TEST_F(ServerLocalTest, InitPassesWithDeltaDirectoryAndRealtimeDirectory) {
                    ::testing::Eq("")))
       .Times(2)
       .WillRepeatedly(::testing::Return(""));
+  EXPECT_CALL(
+      *parameter_client,
+      GetParameter("kv-server-environment-data-loading-readiness-policy",
+                   ::testing::Eq("all_prefixes")))
+      .WillOnce(::testing::Return("all_prefixes"));
+  EXPECT_CALL(
+      *parameter_client,
+      GetParameter("kv-server-environment-data-loading-critical-prefixes",
+                   ::testing::Eq("")))
+      .WillOnce(::testing::Return(""));
+  EXPECT_CALL(
+      *parameter_client,
+      GetParameter(
+          "kv-server-environment-data-loading-cache-checkpoint-directory",
+          ::testing::Eq("")))
+      .WillOnce(::testing::Return(""));
   kv_server::Server server;
   absl::Status status =
       server.Init(std::move(parameter_client), std::move(instance_client),
@@ -346,6 +362,22 @@ TEST_F(ServerLocalTest, GracefulServerShutdown) {
                    ::testing::Eq("")))
       .Times(2)
       .WillRepeatedly(::testing::Return(""));
+  EXPECT_CALL(
+      *parameter_client,
+      GetParameter("kv-server-environment-data-loading-readiness-policy",
+                   ::testing::Eq("all_prefixes")))
+      .WillOnce(::testing::Return("all_prefixes"));
+  EXPECT_CALL(
+      *parameter_client,
+      GetParameter("kv-server-environment-data-loading-critical-prefixes",
+                   ::testing::Eq("")))
+      .WillOnce(::testing::Return(""));
+  EXPECT_CALL(
+      *parameter_client,
+      GetParameter(
+          "kv-server-environment-data-loading-cache-checkpoint-directory",
+          ::testing::Eq("")))
+      .WillOnce(::testing::Return(""));
   kv_server::Server server;
   absl::Status status =
       server.Init(std::move(parameter_client), std::move(instance_client),
@@ -436,6 +468,22 @@ TEST_F(ServerLocalTest, ForceServerShutdown) {
                    ::testing::Eq("")))
       .Times(2)
       .WillRepeatedly(::testing::Return(""));
+  EXPECT_CALL(
+      *parameter_client,
+      GetParameter("kv-server-environment-data-loading-readiness-policy",
+                   ::testing::Eq("all_prefixes")))
+      .WillOnce(::testing::Return("all_prefixes"));
+  EXPECT_CALL(
+      *parameter_client,
+      GetParameter("kv-server-environment-data-loading-critical-prefixes",
+                   ::testing::Eq("")))
+      .WillOnce(::testing::Return(""));
+  EXPECT_CALL(
+      *parameter_client,
+      GetParameter(
+          "kv-server-environment-data-loading-cache-checkpoint-directory",
+          ::testing::Eq("")))
+      .WillOnce(::testing::Return(""));
   kv_server::Server server;
   absl::Status status =
       server.Init(std::move(parameter_client), std::move(instance_client),
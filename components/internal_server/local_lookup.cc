@@ -175,11 +175,10 @@ class LocalLookup : public Lookup {
           if (!eval_result.ok()) {
             return eval_result.status();
           }
-          auto uint32_set = BitSetToUint32Set(*eval_result);
           InternalRunSetQueryUInt32Response response;
-          response.mutable_elements()->Reserve(uint32_set.size());
-          response.mutable_elements()->Assign(uint32_set.begin(),
-                                              uint32_set.end());
+          response.mutable_elements()->Resize(eval_result->cardinality(), 0);
+          BitSetToUintArray(*eval_result,
+                            response.mutable_elements()->mutable_data());
           return response;
         });
   }
@@ -202,11 +201,10 @@ class LocalLookup : public Lookup {
           if (!eval_result.ok()) {
             return eval_result.status();
           }
-          auto uint64_set = BitSetToUint64Set(*eval_result);
           InternalRunSetQueryUInt64Response response;
-          response.mutable_elements()->Reserve(uint64_set.size());
-          response.mutable_elements()->Assign(uint64_set.begin(),
-                                              uint64_set.end());
+          response.mutable_elements()->Resize(eval_result->cardinality(), 0);
+          BitSetToUintArray(*eval_result,
+                            response.mutable_elements()->mutable_data());
           return response;
         });
   }
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/lookup_memo.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/status/status.h"
+
+namespace kv_server {
+namespace {
+
+bool IsWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Whether whitespace next to `c` can be dropped without changing the tokens
+// of a query.
+bool IsDelimiter(char c) {
+  switch (c) {
+    case '(':
+    case ')':
+    case '|':
+    case '&':
+    case '-':
+    case ',':
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Missing keys are memoized, but other errors may be transient.
+bool IsMemoizable(const SingleLookupResult& result) {
+  if (result.has_status()) {
+    return result.status().code() ==
+           static_cast<int>(absl::StatusCode::kNotFound);
+  }
+  return true;
+}
+
+}  // namespace
+
+absl::flat_hash_set<std::string_view> LookupMemo::GetKeyValues(
+    const absl::flat_hash_set<std::string_view>& keys,
+    InternalLookupResponse& response) const {
+  absl::flat_hash_set<std::string_view> missing_keys;
+  absl::ReaderMutexLock lock(&mutex_);
+  for (std::string_view key : keys) {
+    if (auto it = key_values_.find(key); it != key_values_.end()) {
+      (*response.mutable_kv_pairs())[std::string(key)] = it->second;
+    } else {
+      missing_keys.insert(key);
+    }
+  }
+  return missing_keys;
+}
+
+void LookupMemo::AddKeyValues(const InternalLookupResponse& response) {
+  absl::MutexLock lock(&mutex_);
+  for (const auto& [key, result] : response.kv_pairs()) {
+    if (!IsMemoizable(result) || key_values_.contains(key) ||
+        !TryReserve(key.size() + result.ByteSizeLong())) {
+      continue;
+    }
+    key_values_.emplace(key, result);
+  }
+}
+
+bool LookupMemo::GetQueryResult(std::string_view query,
+                                InternalRunQueryResponse& response) const {
+  return GetQueryResult(string_queries_, query, response);
+}
+
+bool LookupMemo::GetQueryResult(
+    std::string_view query, InternalRunSetQueryUInt32Response& response) const {
+  return GetQueryResult(uint32_queries_, query, response);
+}
+
+bool LookupMemo::GetQueryResult(
+    std::string_view query, InternalRunSetQueryUInt64Response& response) const {
+  return GetQueryResult(uint64_queries_, query, response);
+}
+
+void LookupMemo::AddQueryResult(std::string_view query,
+                                const InternalRunQueryResponse& response) {
+  AddQueryResult(string_queries_, query, response);
+}
+
+void LookupMemo::AddQueryResult(
+    std::string_view query, const InternalRunSetQueryUInt32Response& response) {
+  AddQueryResult(uint32_queries_, query, response);
+}
+
+void LookupMemo::AddQueryResult(
+    std::string_view query, const InternalRunSetQueryUInt64Response& response) {
+  AddQueryResult(uint64_queries_, query, response);
+}
+
+template <typename ResponseT>
+bool LookupMemo::GetQueryResult(
+    const absl::flat_hash_map<std::string, ResponseT>& results,
+    std::string_view query, ResponseT& response) const {
+  const std::string normalized_query = NormalizeQuery(query);
+  absl::ReaderMutexLock lock(&mutex_);
+  auto it = results.find(normalized_query);
+  if (it == results.end()) {
+    return false;
+  }
+  response = it->second;
+  return true;
+}
+
+template <typename ResponseT>
+void LookupMemo::AddQueryResult(
+    absl::flat_hash_map<std::string, ResponseT>& results,
+    std::string_view query, const ResponseT& response) {
+  std::string normalized_query = NormalizeQuery(query);
+  absl::MutexLock lock(&mutex_);
+  if (results.contains(normalized_query) ||
+      !TryReserve(normalized_query.size() + response.ByteSizeLong())) {
+    return;
+  }
+  results.emplace(std::move(normalized_query), response);
+}
+
+bool LookupMemo::TryReserve(int64_t bytes) {
+  if (bytes_ + bytes > max_bytes_) {
+    return false;
+  }
+  bytes_ += bytes;
+  return true;
+}
+
+std::string LookupMemo::NormalizeQuery(std::string_view query) {
+  std::string normalized;
+  normalized.reserve(query.size());
+  bool in_quotes = false;
+  bool pending_space = false;
+  for (char c : query) {
+    if (in_quotes) {
+      normalized.push_back(c);
+      in_quotes = c != '"';
+      continue;
+    }
+    if (IsWhitespace(c)) {
+      pending_space = !normalized.empty();
+      continue;
+    }
+    if (pending_space && !IsDelimiter(c) && !IsDelimiter(normalized.back())) {
+      normalized.push_back(' ');
+    }
+    pending_space = false;
+    normalized.push_back(c);
+    in_quotes = c == '"';
+  }
+  return normalized;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_INTERNAL_SERVER_LOOKUP_MEMO_H_
+#define COMPONENTS_INTERNAL_SERVER_LOOKUP_MEMO_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "components/internal_server/lookup.pb.h"
+
+namespace kv_server {
+
+// Memoizes the results of the lookups made by the UDF hooks of one request.
+// UDFs often look up the same keys or run the same queries from several
+// partitions or hook calls, and each lookup may go over the network in
+// sharded mode.
+//
+// Only values, missing keys and successful queries are memoized, so that a
+// transient failure is retried by the next lookup. Once `max_bytes` are
+// memoized, further results are not.
+//
+// Thread-safe, since the UDFs of the partitions of a request run
+// concurrently.
+class LookupMemo {
+ public:
+  static constexpr int64_t kDefaultMaxBytes = 1 << 20;
+
+  explicit LookupMemo(int64_t max_bytes = kDefaultMaxBytes)
+      : max_bytes_(max_bytes) {}
+
+  // Adds the memoized results of `keys` to `response`, and returns the keys
+  // that are not memoized. The returned views point into `keys`.
+  absl::flat_hash_set<std::string_view> GetKeyValues(
+      const absl::flat_hash_set<std::string_view>& keys,
+      InternalLookupResponse& response) const;
+  void AddKeyValues(const InternalLookupResponse& response);
+
+  // Returns whether the result of `query` is memoized, in which case it is
+  // copied to `response`. Queries that only differ by the whitespace between
+  // their tokens share their result.
+  bool GetQueryResult(std::string_view query,
+                      InternalRunQueryResponse& response) const;
+  bool GetQueryResult(std::string_view query,
+                      InternalRunSetQueryUInt32Response& response) const;
+  bool GetQueryResult(std::string_view query,
+                      InternalRunSetQueryUInt64Response& response) const;
+  void AddQueryResult(std::string_view query,
+                      const InternalRunQueryResponse& response);
+  void AddQueryResult(std::string_view query,
+                      const InternalRunSetQueryUInt32Response& response);
+  void AddQueryResult(std::string_view query,
+                      const InternalRunSetQueryUInt64Response& response);
+
+  // Returns `query` without the whitespace that does not separate two
+  // tokens, with the remaining whitespace collapsed to single spaces.
+  static std::string NormalizeQuery(std::string_view query);
+
+ private:
+  template <typename ResponseT>
+  bool GetQueryResult(
+      const absl::flat_hash_map<std::string, ResponseT>& results,
+      std::string_view query, ResponseT& response) const;
+  template <typename ResponseT>
+  void AddQueryResult(absl::flat_hash_map<std::string, ResponseT>& results,
+                      std::string_view query, const ResponseT& response);
+
+  // Accounts for `bytes` more memoized bytes and returns true, unless that
+  // exceeds `max_bytes_`.
+  bool TryReserve(int64_t bytes) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const int64_t max_bytes_;
+  mutable absl::Mutex mutex_;
+  int64_t bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::flat_hash_map<std::string, SingleLookupResult> key_values_
+      ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::string, InternalRunQueryResponse> string_queries_
+      ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::string, InternalRunSetQueryUInt32Response>
+      uint32_queries_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::string, InternalRunSetQueryUInt64Response>
+      uint64_queries_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_INTERNAL_SERVER_LOOKUP_MEMO_H_
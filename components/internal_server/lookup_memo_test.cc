@@ -0,0 +1,138 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/internal_server/lookup_memo.h"
+
+#include <string_view>
+
+#include "gmock/gmock.h"
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+#include "public/test_util/proto_matcher.h"
+
+namespace kv_server {
+namespace {
+
+using google::protobuf::TextFormat;
+using testing::IsEmpty;
+using testing::UnorderedElementsAre;
+
+TEST(LookupMemoTest, GetKeyValues_Empty_ReturnsAllKeys) {
+  LookupMemo memo;
+  InternalLookupResponse response;
+  EXPECT_THAT(memo.GetKeyValues({"key1", "key2"}, response),
+              UnorderedElementsAre("key1", "key2"));
+  EXPECT_THAT(response, EqualsProto(InternalLookupResponse()));
+}
+
+TEST(LookupMemoTest, GetKeyValues_ReturnsMemoizedValuesAndMissingKeys) {
+  InternalLookupResponse lookup_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   }
+                                   kv_pairs {
+                                     key: "key2"
+                                     value { status { code: 5 } }
+                                   }
+                              )pb",
+                              &lookup_response);
+  LookupMemo memo;
+  memo.AddKeyValues(lookup_response);
+
+  InternalLookupResponse response;
+  EXPECT_THAT(memo.GetKeyValues({"key1", "key2", "key3"}, response),
+              UnorderedElementsAre("key3"));
+  EXPECT_THAT(response, EqualsProto(lookup_response));
+}
+
+TEST(LookupMemoTest, AddKeyValues_TransientError_NotMemoized) {
+  InternalLookupResponse lookup_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { status { code: 13 } }
+                                   }
+                              )pb",
+                              &lookup_response);
+  LookupMemo memo;
+  memo.AddKeyValues(lookup_response);
+
+  InternalLookupResponse response;
+  EXPECT_THAT(memo.GetKeyValues({"key1"}, response),
+              UnorderedElementsAre("key1"));
+}
+
+TEST(LookupMemoTest, AddKeyValues_OverMaxBytes_NotMemoized) {
+  InternalLookupResponse lookup_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   }
+                              )pb",
+                              &lookup_response);
+  InternalLookupResponse large_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key2"
+                                     value { value: "a much larger value" }
+                                   }
+                              )pb",
+                              &large_response);
+  LookupMemo memo(/*max_bytes=*/20);
+  memo.AddKeyValues(lookup_response);
+  memo.AddKeyValues(large_response);
+
+  InternalLookupResponse response;
+  EXPECT_THAT(memo.GetKeyValues({"key1", "key2"}, response),
+              UnorderedElementsAre("key2"));
+  EXPECT_THAT(response, EqualsProto(lookup_response));
+}
+
+TEST(LookupMemoTest, GetQueryResult_SameTokens_ReturnsMemoizedResult) {
+  InternalRunQueryResponse query_response;
+  query_response.add_elements("a");
+  query_response.add_elements("b");
+  LookupMemo memo;
+  memo.AddQueryResult("A | (B & C)", query_response);
+
+  InternalRunQueryResponse response;
+  EXPECT_TRUE(memo.GetQueryResult("A|(B&C)", response));
+  EXPECT_THAT(response, EqualsProto(query_response));
+  EXPECT_FALSE(memo.GetQueryResult("A|(B|C)", response));
+}
+
+TEST(LookupMemoTest, GetQueryResult_TypedResultsAreMemoizedSeparately) {
+  InternalRunSetQueryUInt32Response uint32_response;
+  uint32_response.add_elements(1);
+  LookupMemo memo;
+  memo.AddQueryResult("A", uint32_response);
+
+  InternalRunSetQueryUInt32Response memoized_uint32_response;
+  EXPECT_TRUE(memo.GetQueryResult("A", memoized_uint32_response));
+  EXPECT_THAT(memoized_uint32_response, EqualsProto(uint32_response));
+  InternalRunSetQueryUInt64Response uint64_response;
+  EXPECT_FALSE(memo.GetQueryResult("A", uint64_response));
+  InternalRunQueryResponse string_response;
+  EXPECT_FALSE(memo.GetQueryResult("A", string_response));
+}
+
+TEST(LookupMemoTest, NormalizeQuery) {
+  EXPECT_EQ(LookupMemo::NormalizeQuery("  A   |  B "), "A|B");
+  EXPECT_EQ(LookupMemo::NormalizeQuery("A\tUNION\n B"), "A UNION B");
+  EXPECT_EQ(LookupMemo::NormalizeQuery("( A - B ) & C"), "(A-B)&C");
+  EXPECT_EQ(LookupMemo::NormalizeQuery(R"("a  b" | C)"), R"("a  b"|C)");
+  EXPECT_THAT(LookupMemo::NormalizeQuery(" \t"), IsEmpty());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -253,10 +253,9 @@ class ShardedLookup : public Lookup {
                               InternalRunSetQueryUInt32Response>(
         request_context, query, [](const auto& result_set) {
           InternalRunSetQueryUInt32Response response;
-          auto uint32_set = BitSetToUint32Set(result_set);
-          response.mutable_elements()->Reserve(uint32_set.size());
-          response.mutable_elements()->Assign(uint32_set.begin(),
-                                              uint32_set.end());
+          response.mutable_elements()->Resize(result_set.cardinality(), 0);
+          BitSetToUintArray(result_set,
+                            response.mutable_elements()->mutable_data());
           return response;
         });
     if (!result.ok()) {
@@ -288,10 +287,9 @@ class ShardedLookup : public Lookup {
                               InternalRunSetQueryUInt64Response>(
         request_context, query, [](const auto& result_set) {
           InternalRunSetQueryUInt64Response response;
-          auto uint64_set = BitSetToUint64Set(result_set);
-          response.mutable_elements()->Reserve(uint64_set.size());
-          response.mutable_elements()->Assign(uint64_set.begin(),
-                                              uint64_set.end());
+          response.mutable_elements()->Resize(result_set.cardinality(), 0);
+          BitSetToUintArray(result_set,
+                            response.mutable_elements()->mutable_data());
           return response;
         });
     if (!result.ok()) {
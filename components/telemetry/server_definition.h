@@ -62,6 +62,12 @@ inline constexpr double kLatencyInMicroSecondsBoundaries[] = {
     1'000'000, 1'300'000, 2'600'000, 5'000'000, 10'000'000'000,
 };
 
+inline constexpr double kRecordsPerSecondBoundaries[] = {
+    1'000,     5'000,     10'000,    50'000,     100'000,
+    250'000,   500'000,   1'000'000, 2'000'000,  4'000'000,
+    8'000'000, 16'000'000,
+};
+
 inline constexpr int kCountHistogramLowerBound = 1;
 inline constexpr int kCountHistogramUpperBound = 5000;
 inline constexpr double kCountHistogram[] = {
@@ -101,6 +107,13 @@ inline constexpr std::string_view kCacheAccessEvents[] = {
     kKeyValueCacheHit, kKeyValueCacheMiss, kKeyValueSetCacheHit,
     kKeyValueSetCacheMiss};
 
+inline constexpr std::string_view kGetValuesMemoHit = "GetValuesMemoHit";
+inline constexpr std::string_view kGetValuesMemoMiss = "GetValuesMemoMiss";
+inline constexpr std::string_view kRunQueryMemoHit = "RunQueryMemoHit";
+inline constexpr std::string_view kRunQueryMemoMiss = "RunQueryMemoMiss";
+inline constexpr std::string_view kLookupMemoEvents[] = {
+    kGetValuesMemoHit, kGetValuesMemoMiss, kRunQueryMemoHit, kRunQueryMemoMiss};
+
 inline constexpr privacy_sandbox::server_common::metrics::PrivacyBudget
     privacy_total_budget = {
         .epsilon = 5,
@@ -488,6 +501,67 @@ inline constexpr privacy_sandbox::server_common::metrics::Definition<
         "data_source",
         privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
 
+// Memory used by the cache, partitioned by "<value type>:<prefix>", e.g.,
+// "key_value:" for key-value pairs loaded from the bucket root, or
+// "uint32_set:prefix1" for uint32 sets loaded from "prefix1". The value types
+// are "key_value", "string_set", "uint32_set" and "uint64_set".
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kCacheKeyBytes(
+        "CacheKeyBytes", "Total size of the keys in the cache in bytes",
+        "cache_partition",
+        privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kCacheValueCardinality(
+        "CacheValueCardinality",
+        "Number of values in the cache that are not deleted, i.e., one per "
+        "key for key-value pairs and the set cardinality for sets",
+        "cache_partition",
+        privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kCacheValueBytes(
+        "CacheValueBytes",
+        "Total size of the values in the cache in bytes, including set "
+        "values marked as deleted",
+        "cache_partition",
+        privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kCacheTombstones(
+        "CacheTombstones",
+        "Number of deleted keys and set values kept in the cache until "
+        "cleanup",
+        "cache_partition",
+        privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kCacheBitsetBytes(
+        "CacheBitsetBytes",
+        "Total serialized size of the bitsets of uint sets in the cache in "
+        "bytes",
+        "cache_partition",
+        privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kDataLoadingRecordsPerSecond(
+        "DataLoadingRecordsPerSecond",
+        "Rate at which records of a data file are loaded during the initial "
+        "data load",
+        kRecordsPerSecondBoundaries);
+
 inline constexpr privacy_sandbox::server_common::metrics::Definition<
     double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
     privacy_sandbox::server_common::metrics::Instrument::kHistogram>
@@ -725,6 +799,18 @@ inline constexpr privacy_sandbox::server_common::metrics::Definition<
                        kCountHistogram, kCountHistogramLowerBound,
                        kCountHistogramUpperBound);
 
+// The hit rate is the rate of duplicate lookups made by the UDF hooks of a
+// request, which are served from the request's `LookupMemo`.
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kLookupMemoEventCount(
+        "LookupMemoEventCount",
+        "Count of keys and queries looked up by UDF hooks that hit or miss "
+        "the lookups already made by the request",
+        "lookup_memo", 4 /*max_partitions_contributed*/, kLookupMemoEvents,
+        kCounterDPUpperBound, kCounterDPLowerBound);
+
 inline constexpr privacy_sandbox::server_common::metrics::Definition<
     double, privacy_sandbox::server_common::metrics::Privacy::kImpacting,
     privacy_sandbox::server_common::metrics::Instrument::kHistogram>
@@ -749,7 +835,7 @@ inline constexpr const privacy_sandbox::server_common::metrics::DefinitionName*
         &kShardedLookupGetUInt32ValueSetLatencyInMicros,
         &kShardedLookupGetUInt64ValueSetLatencyInMicros,
         &kShardedLookupRunSetQueryUInt64LatencyInMicros, &kUDFExecutionCount,
-        &kBatchUDFExecutionLatencyInMicros,
+        &kBatchUDFExecutionLatencyInMicros, &kLookupMemoEventCount,
         &privacy_sandbox::server_common::metrics::kCustom1,
         &privacy_sandbox::server_common::metrics::kCustom2,
         &privacy_sandbox::server_common::metrics::kCustom3,
@@ -774,7 +860,9 @@ inline constexpr const privacy_sandbox::server_common::metrics::DefinitionName*
         &kSeekingInputStreambufSizeLatency,
         &kSeekingInputStreambufUnderflowLatency,
         &kTotalRowsDroppedInDataLoading, &kTotalRowsUpdatedInDataLoading,
-        &kTotalRowsDeletedInDataLoading,
+        &kTotalRowsDeletedInDataLoading, &kDataLoadingRecordsPerSecond,
+        &kCacheKeyBytes, &kCacheValueCardinality, &kCacheValueBytes,
+        &kCacheTombstones, &kCacheBitsetBytes,
         &kConcurrentStreamRecordReaderReadShardRecordsLatency,
         &kConcurrentStreamRecordReaderReadStreamRecordsLatency,
         &kConcurrentStreamRecordReaderReadByteRangeLatency,
@@ -1009,6 +1097,20 @@ inline void LogV1RequestCommonSafeMetrics(
           duration_ms));
 }
 
+// Records `latency` in microseconds the way ScopeLatencyMetricsRecorder does,
+// for code that does not complete in the scope that started it.
+template <typename ContextT, const auto& definition>
+void LogLatencyMetric(ContextT& metrics_context, absl::Duration latency) {
+  if (definition.type_privacy ==
+      privacy_sandbox::server_common::metrics::Privacy::kImpacting) {
+    LogIfError(metrics_context.template AggregateMetricToGetMean<definition>(
+        absl::ToDoubleMicroseconds(latency)));
+  } else {
+    LogIfError(metrics_context.template LogHistogram<definition>(
+        absl::ToDoubleMicroseconds(latency)));
+  }
+}
+
 // Measures the latency of a block of code. The latency is recorded in
 // microseconds as histogram metrics when the object of this class goes
 // out of scope. The metric can be either safe or unsafe metric.
@@ -1026,14 +1128,8 @@ class ScopeLatencyMetricsRecorder {
     stopwatch_ = std::move(stopwatch);
   }
   ~ScopeLatencyMetricsRecorder<ContextT, definition>() {
-    if (definition.type_privacy ==
-        privacy_sandbox::server_common::metrics::Privacy::kImpacting) {
-      LogIfError(metrics_context_.template AggregateMetricToGetMean<definition>(
-          absl::ToDoubleMicroseconds(stopwatch_->GetElapsedTime())));
-    } else {
-      LogIfError(metrics_context_.template LogHistogram<definition>(
-          absl::ToDoubleMicroseconds(stopwatch_->GetElapsedTime())));
-    }
+    LogLatencyMetric<ContextT, definition>(metrics_context_,
+                                           stopwatch_->GetElapsedTime());
   }
 
   // Returns the latency so far
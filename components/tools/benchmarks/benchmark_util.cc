@@ -24,6 +24,8 @@
 #include "absl/strings/str_cat.h"
 #include "absl/time/time.h"
 #include "public/data_loading/writers/delta_record_stream_writer.h"
+#include "public/sharding/key_sharder.h"
+#include "public/sharding/sharding_function.h"
 
 namespace kv_server::benchmark {
 
@@ -87,6 +89,45 @@ absl::Status WriteRecords(int64_t num_records, const int64_t record_size,
   return absl::OkStatus();
 }
 
+absl::Status WriteShardedRecords(int64_t num_records, int64_t record_size,
+                                 int32_t shard_num, int32_t num_shards,
+                                 std::iostream& output_stream) {
+  const KeySharder key_sharder(ShardingFunction(/*seed=*/""));
+  DeltaRecordWriter::Options options;
+  auto* sharding_metadata = options.metadata.mutable_sharding_metadata();
+  sharding_metadata->set_shard_num(shard_num);
+  if (auto fingerprint = key_sharder.GetFingerprint(num_shards);
+      fingerprint.has_value()) {
+    sharding_metadata->set_sharding_function_fingerprint(*fingerprint);
+  }
+  auto record_writer =
+      DeltaRecordStreamWriter<>::Create(output_stream, std::move(options));
+  if (!record_writer.ok()) {
+    return record_writer.status();
+  }
+  for (; num_records > 0; --num_records) {
+    const std::string key = absl::StrCat("foo", num_records);
+    if (key_sharder.GetShardNumForKey(key, num_shards).shard_num !=
+        shard_num) {
+      continue;
+    }
+    StringValueT string_value = {.value = GenerateRandomString(record_size)};
+    KeyValueMutationRecordT kv_mutation_record = {
+        .mutation_type = KeyValueMutationType::Update,
+        .logical_commit_time = absl::ToUnixSeconds(absl::Now()),
+        .key = key,
+    };
+    kv_mutation_record.value.Set(std::move(string_value));
+    DataRecordT data_record;
+    data_record.record.Set(std::move(kv_mutation_record));
+    if (auto status = (*record_writer)->WriteRecord(data_record);
+        !status.ok()) {
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
 absl::StatusOr<std::vector<int64_t>> ParseInt64List(
     const std::vector<std::string>& num_list) {
   std::vector<int64_t> result;
@@ -59,6 +59,15 @@ std::string GenerateRandomString(const int64_t char_count);
 absl::Status WriteRecords(int64_t num_records, int64_t record_size,
                           std::iostream& output_stream);
 
+// Writes up to num_records, each with a size of record_size, to output_stream.
+// Only records whose keys belong to `shard_num` (out of `num_shards`) are
+// written, and the file metadata is tagged with the shard number and the
+// fingerprint of the sharding function used, so that the file looks like a
+// pre-sharded file generated by data_cli.
+absl::Status WriteShardedRecords(int64_t num_records, int64_t record_size,
+                                 int32_t shard_num, int32_t num_shards,
+                                 std::iostream& output_stream);
+
 // Parses a numeric string list into a vector of int64 elements.
 absl::StatusOr<std::vector<int64_t>> ParseInt64List(
     const std::vector<std::string>& num_list);
@@ -21,6 +21,8 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "public/data_loading/readers/delta_record_stream_reader.h"
+#include "public/sharding/key_sharder.h"
+#include "public/sharding/sharding_function.h"
 
 namespace kv_server::benchmark {
 namespace {
@@ -71,5 +73,35 @@ TEST(BenchmarkUtilTest, VerifyWriteRecords) {
   EXPECT_TRUE(status.ok()) << status;
 }
 
+TEST(BenchmarkUtilTest, VerifyWriteShardedRecords) {
+  std::stringstream data_stream;
+  const int32_t shard_num = 1;
+  const int32_t num_shards = 4;
+  auto status = WriteShardedRecords(/*num_records=*/1000, /*record_size=*/8,
+                                    shard_num, num_shards, data_stream);
+  EXPECT_TRUE(status.ok()) << status;
+  DeltaRecordStreamReader record_reader(data_stream);
+  const KeySharder key_sharder(ShardingFunction(/*seed=*/""));
+  auto metadata = record_reader.ReadMetadata();
+  ASSERT_TRUE(metadata.ok()) << metadata.status();
+  EXPECT_EQ(metadata->sharding_metadata().shard_num(), shard_num);
+  EXPECT_EQ(metadata->sharding_metadata().sharding_function_fingerprint(),
+            key_sharder.GetFingerprint(num_shards).value());
+  int64_t num_records_read = 0;
+  status = record_reader.ReadRecords([&](const DataRecord& data_record) {
+    const auto* kv_record = data_record.record_as_KeyValueMutationRecord();
+    EXPECT_EQ(key_sharder
+                  .GetShardNumForKey(kv_record->key()->string_view(),
+                                     num_shards)
+                  .shard_num,
+              shard_num);
+    num_records_read++;
+    return absl::OkStatus();
+  });
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_GT(num_records_read, 0);
+  EXPECT_LT(num_records_read, 1000);
+}
+
 }  // namespace
 }  // namespace kv_server::benchmark
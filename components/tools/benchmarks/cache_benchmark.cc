@@ -34,6 +34,7 @@
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/cache/key_value_cache.h"
 #include "components/data_server/cache/noop_key_value_cache.h"
+#include "components/data_server/cache/prefix_partitioned_cache.h"
 #include "components/tools/benchmarks/benchmark_util.h"
 #include "components/tools/util/configure_telemetry_tools.h"
 
@@ -57,6 +58,10 @@ ABSL_FLAG(std::vector<std::string>, concurrent_readers,
           std::vector<std::string>({"1"}),
           "Number of threads concurrently reading keys from the cache when "
           "benchmarking writes.");
+ABSL_FLAG(std::vector<std::string>, hit_rate_percent,
+          std::vector<std::string>({"100", "10"}),
+          "Percentages of the queried keys that are in the cache for the "
+          "`HitRate` read benchmarks.");
 ABSL_FLAG(int64_t, iterations, -1,
           "Number of iterations to run each benchmark.");
 ABSL_FLAG(int64_t, min_threads, 1,
@@ -77,6 +82,10 @@ using kv_server::benchmark::ParseInt64List;
 // GetKeyValuePairs call.
 // => rz - record size, i.e., approximate byte size of each key/value pair
 // written into the cache. Actual record size is greater than this number.
+// => cw - number of concurrent writers. For the `LoadingPrefix` benchmarks,
+// the writers load a different prefix than the one that serves the reads.
+// => hr - hit rate, i.e., percentage of the queried keys that are in the
+// cache.
 constexpr std::string_view kNoOpCacheGetKeyValuePairsFmt =
     "BM_NoOpCache_GetKeyValuePairs/qz:%d/rz:%d/cw:%d";
 constexpr std::string_view kLockBasedCacheGetKeyValuePairsFmt =
@@ -86,6 +95,18 @@ constexpr std::string_view kNoOpCacheGetKeyValueSetFmt =
 constexpr std::string_view kLockBasedCacheGetKeyValueSetFmt =
     "BM_LockBasedCache_GetKeyValueSet/qz:%d/sqz:%d/rz:%d/cw:%d";
 
+constexpr std::string_view kLockBasedCacheLoadingPrefixFmt =
+    "BM_LockBasedCache_GetKeyValuePairs_LoadingPrefix/qz:%d/rz:%d/cw:%d";
+constexpr std::string_view kPrefixPartitionedCacheLoadingPrefixFmt =
+    "BM_PrefixPartitionedCache_GetKeyValuePairs_LoadingPrefix/qz:%d/rz:%d/"
+    "cw:%d";
+
+constexpr std::string_view kLockBasedCacheHitRateFmt =
+    "BM_LockBasedCache_GetKeyValuePairs_HitRate/qz:%d/rz:%d/hr:%d/cw:%d";
+constexpr std::string_view kLockBasedCacheWithKeyFilterHitRateFmt =
+    "BM_LockBasedCacheWithKeyFilter_GetKeyValuePairs_HitRate/qz:%d/rz:%d/"
+    "hr:%d/cw:%d";
+
 constexpr std::string_view kNoOpCacheUpdateKeyValueFmt =
     "BM_NoOpCache_UpdateKeyValue/ksz:%d/rz:%d/cr:%d";
 constexpr std::string_view kLockBasedCacheUpdateKeyValueFmt =
@@ -108,6 +129,24 @@ Cache* GetLockBasedCache() {
   return cache;
 }
 
+Cache* GetLockBasedCacheWithKeyFilter() {
+  static auto* const cache =
+      KeyValueCache::Create({.enable_key_filter = true}).release();
+  return cache;
+}
+
+// Lookups only lock the partitions whose key filter may have the looked up
+// keys.
+Cache* GetPrefixPartitionedCache() {
+  static auto* const cache =
+      PrefixPartitionedCache::Create({.enable_key_filter = true}).release();
+  return cache;
+}
+
+// Prefix that the concurrent writers load for the `LoadingPrefix`
+// benchmarks. Reads are served from the bucket root.
+constexpr std::string_view kLoadingPrefix = "loading";
+
 std::atomic<int64_t>& GetLogicalTimestamp() {
   static auto* const timestamp = new std::atomic<int64_t>(0);
   return *timestamp;
@@ -153,6 +192,7 @@ struct BenchmarkArgs {
   int64_t set_query_size = 1;
   int64_t keyspace_size = 1;
   int64_t concurrent_tasks = 1;
+  int64_t hit_rate_percent = 100;
   Cache* cache = GetNoOpCache();
 };
 
@@ -184,6 +224,73 @@ void BM_GetKeyValuePairs(::benchmark::State& state, BenchmarkArgs args) {
       ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
 }
 
+// Reads keys of the bucket root while writers load other keys under
+// `kLoadingPrefix`, i.e., the reads are never served from the loaded prefix.
+void BM_GetKeyValuePairsLoadingPrefix(::benchmark::State& state,
+                                      BenchmarkArgs args) {
+  uint seed = args.concurrent_tasks;
+  std::vector<AsyncTask> writer_tasks;
+  benchmark::BenchmarkLogContext log_context;
+  if (state.thread_index() == 0 && args.concurrent_tasks > 0) {
+    auto num_writers = args.concurrent_tasks;
+    writer_tasks.reserve(num_writers);
+    while (num_writers-- > 0) {
+      writer_tasks.emplace_back([args, &seed,
+                                 value = GenerateRandomString(args.record_size),
+                                 &log_context]() {
+        auto key = absl::StrCat(kLoadingPrefix, "/",
+                                rand_r(&seed) % args.query_size);
+        args.cache->UpdateKeyValue(log_context, key, value,
+                                   ++GetLogicalTimestamp(), kLoadingPrefix);
+      });
+    }
+  }
+  auto keys = GetKeys(args.query_size);
+  auto keys_view = ToContainerView<absl::flat_hash_set<std::string_view>>(keys);
+  RequestContext request_context;
+  for (auto _ : state) {
+    ::benchmark::DoNotOptimize(
+        args.cache->GetKeyValuePairs(request_context, keys_view));
+  }
+  state.counters[std::string(kReadsPerSec)] =
+      ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
+}
+
+// Reads keys of which `hit_rate_percent` percent are in the cache, while
+// writers update the keys that are in the cache.
+void BM_GetKeyValuePairsHitRate(::benchmark::State& state,
+                                BenchmarkArgs args) {
+  uint seed = args.concurrent_tasks;
+  const int64_t num_hits = args.query_size * args.hit_rate_percent / 100;
+  std::vector<AsyncTask> writer_tasks;
+  benchmark::BenchmarkLogContext log_context;
+  if (state.thread_index() == 0 && args.concurrent_tasks > 0 && num_hits > 0) {
+    auto num_writers = args.concurrent_tasks;
+    writer_tasks.reserve(num_writers);
+    while (num_writers-- > 0) {
+      writer_tasks.emplace_back([args, num_hits, &seed,
+                                 value = GenerateRandomString(args.record_size),
+                                 &log_context]() {
+        auto key = std::to_string(rand_r(&seed) % num_hits);
+        args.cache->UpdateKeyValue(log_context, key, value,
+                                   ++GetLogicalTimestamp());
+      });
+    }
+  }
+  auto keys = GetKeys(num_hits);
+  for (int64_t i = num_hits; i < args.query_size; i++) {
+    keys.push_back(absl::StrCat("missing", i));
+  }
+  auto keys_view = ToContainerView<absl::flat_hash_set<std::string_view>>(keys);
+  RequestContext request_context;
+  for (auto _ : state) {
+    ::benchmark::DoNotOptimize(
+        args.cache->GetKeyValuePairs(request_context, keys_view));
+  }
+  state.counters[std::string(kReadsPerSec)] =
+      ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
+}
+
 void BM_GetKeyValueSet(::benchmark::State& state, BenchmarkArgs args) {
   uint seed = args.concurrent_tasks;
   std::vector<AsyncTask> writer_tasks;
@@ -322,6 +429,85 @@ void RegisterReadBenchmarks() {
   }
 }
 
+void RegisterLoadingPrefixBenchmarks() {
+  auto query_sizes = ParseInt64List(absl::GetFlag(FLAGS_query_size));
+  auto record_sizes = ParseInt64List(absl::GetFlag(FLAGS_record_size));
+  auto concurrent_writers =
+      ParseInt64List(absl::GetFlag(FLAGS_concurrent_writers));
+  benchmark::BenchmarkLogContext log_context;
+  for (auto query_size : query_sizes.value()) {
+    for (auto record_size : record_sizes.value()) {
+      // Load the keys that are read into the bucket root up front.
+      auto value = GenerateRandomString(record_size);
+      for (const auto& key : GetKeys(query_size)) {
+        for (auto* cache : {GetLockBasedCache(), GetPrefixPartitionedCache()}) {
+          cache->UpdateKeyValue(log_context, key, value,
+                                ++GetLogicalTimestamp());
+        }
+      }
+      for (auto num_writers : concurrent_writers.value()) {
+        auto args = BenchmarkArgs{
+            .record_size = record_size,
+            .query_size = query_size,
+            .concurrent_tasks = num_writers,
+            .cache = GetLockBasedCache(),
+        };
+        ::kv_server::RegisterBenchmark(
+            absl::StrFormat(kLockBasedCacheLoadingPrefixFmt,
+                            query_size, record_size, num_writers),
+            args, BM_GetKeyValuePairsLoadingPrefix);
+        args.cache = GetPrefixPartitionedCache();
+        ::kv_server::RegisterBenchmark(
+            absl::StrFormat(kPrefixPartitionedCacheLoadingPrefixFmt,
+                            query_size, record_size, num_writers),
+            args, BM_GetKeyValuePairsLoadingPrefix);
+      }
+    }
+  }
+}
+
+void RegisterHitRateBenchmarks() {
+  auto query_sizes = ParseInt64List(absl::GetFlag(FLAGS_query_size));
+  auto record_sizes = ParseInt64List(absl::GetFlag(FLAGS_record_size));
+  auto hit_rates = ParseInt64List(absl::GetFlag(FLAGS_hit_rate_percent));
+  auto concurrent_writers =
+      ParseInt64List(absl::GetFlag(FLAGS_concurrent_writers));
+  benchmark::BenchmarkLogContext log_context;
+  for (auto query_size : query_sizes.value()) {
+    for (auto record_size : record_sizes.value()) {
+      // Load the keys that can be hit up front.
+      auto value = GenerateRandomString(record_size);
+      for (const auto& key : GetKeys(query_size)) {
+        for (auto* cache :
+             {GetLockBasedCache(), GetLockBasedCacheWithKeyFilter()}) {
+          cache->UpdateKeyValue(log_context, key, value,
+                                ++GetLogicalTimestamp());
+        }
+      }
+      for (auto hit_rate : hit_rates.value()) {
+        for (auto num_writers : concurrent_writers.value()) {
+          auto args = BenchmarkArgs{
+              .record_size = record_size,
+              .query_size = query_size,
+              .concurrent_tasks = num_writers,
+              .hit_rate_percent = hit_rate,
+              .cache = GetLockBasedCache(),
+          };
+          ::kv_server::RegisterBenchmark(
+              absl::StrFormat(kLockBasedCacheHitRateFmt, query_size,
+                              record_size, hit_rate, num_writers),
+              args, BM_GetKeyValuePairsHitRate);
+          args.cache = GetLockBasedCacheWithKeyFilter();
+          ::kv_server::RegisterBenchmark(
+              absl::StrFormat(kLockBasedCacheWithKeyFilterHitRateFmt,
+                              query_size, record_size, hit_rate, num_writers),
+              args, BM_GetKeyValuePairsHitRate);
+        }
+      }
+    }
+  }
+}
+
 void RegisterWriteBenchmarks() {
   auto keyspace_sizes = ParseInt64List(absl::GetFlag(FLAGS_keyspace_size));
   auto record_sizes = ParseInt64List(absl::GetFlag(FLAGS_record_size));
@@ -381,6 +567,8 @@ int main(int argc, char** argv) {
   absl::ParseCommandLine(argc, argv);
   kv_server::ConfigureTelemetryForTools();
   ::kv_server::RegisterReadBenchmarks();
+  ::kv_server::RegisterLoadingPrefixBenchmarks();
+  ::kv_server::RegisterHitRateBenchmarks();
   ::kv_server::RegisterWriteBenchmarks();
   ::benchmark::RunSpecifiedBenchmarks();
   ::benchmark::Shutdown();
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/data_loading/cache_checkpointer.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+#include "components/tools/util/configure_telemetry_tools.h"
+#include "components/util/platform_initializer.h"
+#include "public/data_loading/data_loading_generated.h"
+#include "public/data_loading/filename_utils.h"
+#include "public/data_loading/readers/riegeli_stream_io.h"
+#include "public/data_loading/record_utils.h"
+#include "src/util/status_macro/status_macros.h"
+
+ABSL_FLAG(std::string, data_directory, "",
+          "Local directory to store benchmark input data files and the cache "
+          "checkpoint in.");
+ABSL_FLAG(int64_t, num_records, 100'000,
+          "Number of records in each data file.");
+ABSL_FLAG(int64_t, record_size, 1024, "Size of each record in data files.");
+ABSL_FLAG(int64_t, num_delta_files, 10,
+          "Number of delta files loaded on top of the snapshot during a cold "
+          "start. Each delta file updates all keys.");
+ABSL_FLAG(int64_t, reader_worker_threads, 16,
+          "Number of worker threads to use for concurrent reading.");
+
+using kv_server::Cache;
+using kv_server::CacheCheckpointer;
+using kv_server::ConcurrentStreamRecordReader;
+using kv_server::DataRecord;
+using kv_server::DeserializeRecord;
+using kv_server::KeyValueCache;
+using kv_server::KeyValueMutationType;
+using kv_server::MaybeGetRecordValue;
+using kv_server::Record;
+using kv_server::RecordStream;
+using kv_server::ToDeltaFileName;
+using kv_server::ToSnapshotFileName;
+using kv_server::benchmark::BenchmarkLogContext;
+using kv_server::benchmark::WriteRecords;
+
+class FileRecordStream : public RecordStream {
+ public:
+  explicit FileRecordStream(const std::filesystem::path& path)
+      : stream_(path, std::ios::binary) {}
+  std::istream& Stream() override { return stream_; }
+
+ private:
+  std::ifstream stream_;
+};
+
+std::filesystem::path DataDirectory() {
+  return absl::GetFlag(FLAGS_data_directory);
+}
+
+std::filesystem::path CheckpointDirectory() {
+  return DataDirectory() / "checkpoint";
+}
+
+// Returns the snapshot file followed by the delta files, in loading order.
+std::vector<std::filesystem::path> DataFiles() {
+  std::vector<std::filesystem::path> files = {
+      DataDirectory() / ToSnapshotFileName(1).value()};
+  for (int64_t i = 1; i <= absl::GetFlag(FLAGS_num_delta_files); ++i) {
+    files.push_back(DataDirectory() / ToDeltaFileName(i).value());
+  }
+  return files;
+}
+
+absl::Status WriteDataFiles() {
+  for (const auto& file : DataFiles()) {
+    std::fstream stream(file, std::ios::in | std::ios::out | std::ios::trunc |
+                                  std::ios::binary);
+    if (auto status = WriteRecords(absl::GetFlag(FLAGS_num_records),
+                                   absl::GetFlag(FLAGS_record_size), stream);
+        !status.ok()) {
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Loads `path` into `cache` and returns the number of records read.
+int64_t LoadFile(const std::filesystem::path& path, Cache& cache,
+                 BenchmarkLogContext& log_context) {
+  ConcurrentStreamRecordReader<std::string_view> record_reader(
+      /*stream_factory=*/
+      [path]() { return std::make_unique<FileRecordStream>(path); },
+      /*options=*/
+      {
+          .num_worker_threads = absl::GetFlag(FLAGS_reader_worker_threads),
+      });
+  std::atomic<int64_t> num_records_read{0};
+  auto status = record_reader.ReadStreamRecords([&](std::string_view raw) {
+    num_records_read++;
+    return DeserializeRecord(raw, [&](const DataRecord& data_record) {
+      if (data_record.record_type() != Record::KeyValueMutationRecord) {
+        return absl::OkStatus();
+      }
+      const auto* record = data_record.record_as_KeyValueMutationRecord();
+      if (record->mutation_type() == KeyValueMutationType::Delete) {
+        cache.DeleteKey(log_context, record->key()->string_view(),
+                        record->logical_commit_time());
+        return absl::OkStatus();
+      }
+      PS_ASSIGN_OR_RETURN(auto value,
+                          MaybeGetRecordValue<std::string_view>(*record));
+      cache.UpdateKeyValue(log_context, record->key()->string_view(), value,
+                           record->logical_commit_time());
+      return absl::OkStatus();
+    });
+  });
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to load " << path << ": " << status;
+  }
+  return num_records_read;
+}
+
+CacheCheckpointer::Options CheckpointerOptions(
+    Cache& cache, BenchmarkLogContext& log_context) {
+  return CacheCheckpointer::Options{
+      .cache = cache,
+      .directory = CheckpointDirectory().string(),
+      .data_bucket = DataDirectory().string(),
+      .log_context = log_context,
+  };
+}
+
+// Loads the snapshot and all delta files, like a server starting without a
+// checkpoint.
+void BM_ColdStart(benchmark::State& state) {
+  BenchmarkLogContext log_context;
+  int64_t num_records_read = 0;
+  for (auto _ : state) {
+    auto cache = KeyValueCache::Create();
+    for (const auto& file : DataFiles()) {
+      num_records_read += LoadFile(file, *cache, log_context);
+    }
+    state.PauseTiming();
+    cache.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(num_records_read);
+}
+
+// Restores the cache from a checkpoint written after loading all files, like
+// a server restarting with a checkpoint.
+void BM_WarmStart(benchmark::State& state) {
+  BenchmarkLogContext log_context;
+  {
+    auto cache = KeyValueCache::Create();
+    for (const auto& file : DataFiles()) {
+      LoadFile(file, *cache, log_context);
+    }
+    CacheCheckpointer checkpointer(CheckpointerOptions(*cache, log_context));
+    if (auto status = checkpointer.WriteCheckpoint(); !status.ok()) {
+      state.SkipWithError(status.ToString().c_str());
+      return;
+    }
+  }
+  int64_t num_records_read = 0;
+  for (auto _ : state) {
+    auto cache = KeyValueCache::Create();
+    CacheCheckpointer checkpointer(CheckpointerOptions(*cache, log_context));
+    // The data files have no prefixes, so neither do the checkpoint files.
+    for (const auto& file : checkpointer.CheckpointFiles()) {
+      num_records_read += LoadFile(file, *cache, log_context);
+    }
+    state.PauseTiming();
+    cache.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(num_records_read);
+}
+
+// Writes a checkpoint of a fully loaded cache.
+void BM_WriteCheckpoint(benchmark::State& state) {
+  BenchmarkLogContext log_context;
+  auto cache = KeyValueCache::Create();
+  for (const auto& file : DataFiles()) {
+    LoadFile(file, *cache, log_context);
+  }
+  CacheCheckpointer checkpointer(CheckpointerOptions(*cache, log_context));
+  for (auto _ : state) {
+    auto status = checkpointer.WriteCheckpoint();
+    benchmark::DoNotOptimize(status);
+  }
+  state.SetItemsProcessed(absl::GetFlag(FLAGS_num_records) *
+                          static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_ColdStart)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_WarmStart)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_WriteCheckpoint)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Sample run:
+//
+// bazel run -c opt \
+//  components/tools/benchmarks:cache_checkpoint_benchmark \
+//    --config=local_instance --config=local_platform -- \
+//    --data_directory=/tmp/checkpoint_benchmark \
+//    --num_records=100000 \
+//    --record_size=1024 \
+//    --num_delta_files=10
+int main(int argc, char** argv) {
+  ::kv_server::PlatformInitializer platform_initializer;
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  if (absl::GetFlag(FLAGS_data_directory).empty()) {
+    LOG(ERROR) << "Flag '--data_directory' must be set.";
+    return -1;
+  }
+  kv_server::ConfigureTelemetryForTools();
+  std::filesystem::create_directories(DataDirectory());
+  if (auto status = WriteDataFiles(); !status.ok()) {
+    LOG(ERROR) << "Failed to write data files. " << status;
+    return -1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  for (const auto& file : DataFiles()) {
+    std::filesystem::remove(file);
+  }
+  std::filesystem::remove_all(CheckpointDirectory());
+  return 0;
+}
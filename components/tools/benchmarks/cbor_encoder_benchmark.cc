@@ -0,0 +1,193 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "benchmark/benchmark.h"
+#include "components/data/converters/cbor_converter.h"
+#include "components/data/converters/partition_output_cbor_writer.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+#include "nlohmann/json.hpp"
+#include "public/applications/pa/response_utils.h"
+
+ABSL_FLAG(std::vector<std::string>, value_size,
+          std::vector<std::string>({"100", "1000", "10000"}),
+          "Approximate sizes of the values returned by the UDF.");
+ABSL_FLAG(std::vector<std::string>, keys_per_partition,
+          std::vector<std::string>({"10", "100"}),
+          "Number of key-values in each partition output.");
+ABSL_FLAG(int64_t, num_partitions, 4,
+          "Number of partition outputs encoded by each request.");
+
+namespace kv_server {
+namespace {
+
+using kv_server::benchmark::ParseInt64List;
+
+// Format variables used to generate benchmark names.
+//
+// => vz - approximate size of each value.
+// => kz - number of key-values in each partition output.
+constexpr std::string_view kProtoFmt =
+    "BM_EncodePartitionOutputs_Proto/vz:%d/kz:%d";
+constexpr std::string_view kTranscoderFmt =
+    "BM_EncodePartitionOutputs_Transcoder/vz:%d/kz:%d";
+
+constexpr std::string_view kRequestsPerSec = "Requests/s";
+constexpr std::string_view kCborBytes = "CborBytes";
+
+// Returns partition outputs like the ones returned by UDFs for typical
+// datasets, i.e., with a keys and a renderUrls key group output.
+std::vector<std::pair<int32_t, std::string>> GeneratePartitionOutputs(
+    int64_t value_size, int64_t keys_per_partition) {
+  uint seed = 42;
+  std::vector<std::pair<int32_t, std::string>> partition_outputs;
+  for (int64_t id = 0; id < absl::GetFlag(FLAGS_num_partitions); ++id) {
+    nlohmann::json key_group_outputs = nlohmann::json::array();
+    for (std::string_view tag : {"keys", "renderUrls"}) {
+      nlohmann::json key_values = nlohmann::json::object();
+      for (int64_t i = 0; i < keys_per_partition / 2; ++i) {
+        std::string value = absl::StrFormat(R"({"campaign":"c%d","ads":[)",
+                                            rand_r(&seed) % 1000);
+        while (static_cast<int64_t>(value.size()) < value_size) {
+          absl::StrAppend(&value, R"({"bid":)", rand_r(&seed) % 100, "},");
+        }
+        value.back() = ']';
+        value.push_back('}');
+        key_values[absl::StrCat(tag, "-", id, "-", i)] = {{"value", value}};
+      }
+      key_group_outputs.push_back(
+          {{"tags", {"custom", tag}}, {"keyValues", std::move(key_values)}});
+    }
+    partition_outputs.emplace_back(
+        id, nlohmann::json({{"keyGroupOutputs", key_group_outputs}}).dump());
+  }
+  return partition_outputs;
+}
+
+void SetCounters(::benchmark::State& state, int64_t json_bytes,
+                 int64_t cbor_bytes) {
+  state.SetBytesProcessed(state.iterations() * json_bytes);
+  state.counters[std::string(kRequestsPerSec)] =
+      ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
+  state.counters[std::string(kCborBytes)] = cbor_bytes;
+}
+
+int64_t JsonBytes(
+    const std::vector<std::pair<int32_t, std::string>>& partition_outputs) {
+  int64_t json_bytes = 0;
+  for (const auto& [id, json] : partition_outputs) {
+    json_bytes += json.size();
+  }
+  return json_bytes;
+}
+
+// Parses the JSON into `PartitionOutput` protos and encodes them with libcbor.
+void BM_EncodePartitionOutputsProto(
+    ::benchmark::State& state,
+    std::vector<std::pair<int32_t, std::string>> partition_outputs) {
+  int64_t cbor_bytes = 0;
+  for (auto _ : state) {
+    google::protobuf::RepeatedPtrField<application_pa::PartitionOutput>
+        partition_output_protos;
+    for (const auto& [id, json] : partition_outputs) {
+      auto partition_output = application_pa::PartitionOutputFromJson(json);
+      if (!partition_output.ok()) {
+        state.SkipWithError(partition_output.status().ToString().c_str());
+        return;
+      }
+      partition_output->set_id(id);
+      *partition_output_protos.Add() = *std::move(partition_output);
+    }
+    auto cbor = PartitionOutputsCborEncode(partition_output_protos);
+    if (!cbor.ok()) {
+      state.SkipWithError(cbor.status().ToString().c_str());
+      return;
+    }
+    cbor_bytes = cbor->size();
+    ::benchmark::DoNotOptimize(cbor);
+  }
+  SetCounters(state, JsonBytes(partition_outputs), cbor_bytes);
+}
+
+// Transcodes the JSON straight to CBOR.
+void BM_EncodePartitionOutputsTranscoder(
+    ::benchmark::State& state,
+    std::vector<std::pair<int32_t, std::string>> partition_outputs) {
+  int64_t cbor_bytes = 0;
+  for (auto _ : state) {
+    PartitionOutputsCborWriter writer(partition_outputs.size());
+    for (const auto& [id, json] : partition_outputs) {
+      if (auto status = writer.Add(id, json); !status.ok()) {
+        state.SkipWithError(status.ToString().c_str());
+        return;
+      }
+    }
+    std::string cbor = std::move(writer).Finish();
+    cbor_bytes = cbor.size();
+    ::benchmark::DoNotOptimize(cbor);
+  }
+  SetCounters(state, JsonBytes(partition_outputs), cbor_bytes);
+}
+
+void RegisterBenchmarks() {
+  auto value_sizes = ParseInt64List(absl::GetFlag(FLAGS_value_size));
+  auto keys_per_partition =
+      ParseInt64List(absl::GetFlag(FLAGS_keys_per_partition));
+  for (auto value_size : value_sizes.value()) {
+    for (auto num_keys : keys_per_partition.value()) {
+      auto partition_outputs = GeneratePartitionOutputs(value_size, num_keys);
+      ::benchmark::RegisterBenchmark(
+          absl::StrFormat(kProtoFmt, value_size, num_keys).c_str(),
+          BM_EncodePartitionOutputsProto, partition_outputs);
+      ::benchmark::RegisterBenchmark(
+          absl::StrFormat(kTranscoderFmt, value_size, num_keys).c_str(),
+          BM_EncodePartitionOutputsTranscoder, partition_outputs);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks for encoding the partition outputs returned by UDFs as CBOR,
+// either through `PartitionOutput` protos or by transcoding the JSON straight
+// to CBOR. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:cbor_encoder_benchmark \
+//    --config=local_instance \
+//    --config=local_platform -- \
+//    --value_size=100,1000,10000 --keys_per_partition=10,100 \
+//    --benchmark_counters_tabular=true --stderrthreshold=0
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
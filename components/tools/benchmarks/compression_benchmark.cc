@@ -0,0 +1,168 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/request_handler/compression/compression_group_compressor.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+
+ABSL_FLAG(std::vector<std::string>, group_size,
+          std::vector<std::string>({"1000", "10000", "100000"}),
+          "Approximate sizes of the compression group contents.");
+ABSL_FLAG(int64_t, num_groups, 4,
+          "Number of compression groups in each response.");
+ABSL_FLAG(std::vector<std::string>, brotli_quality,
+          std::vector<std::string>({"1", "5", "11"}),
+          "Brotli qualities to benchmark.");
+ABSL_FLAG(std::vector<std::string>, gzip_level,
+          std::vector<std::string>({"1", "6", "9"}),
+          "gzip levels to benchmark.");
+
+namespace kv_server {
+namespace {
+
+using CompressionType = CompressionGroupCompressor::CompressionType;
+using kv_server::benchmark::ParseInt64List;
+
+// Format variables used to generate benchmark names.
+//
+// => algo - compression algorithm.
+// => lv - Brotli quality or gzip level.
+// => gz - approximate size of each compression group.
+constexpr std::string_view kCompressFmt =
+    "BM_CompressCompressionGroups/algo:%s/lv:%d/gz:%d";
+
+constexpr std::string_view kResponsesPerSec = "Responses/s";
+constexpr std::string_view kCompressedBytes = "CompressedBytes";
+constexpr std::string_view kCompressionRatio = "CompressionRatio";
+
+// Returns compression group contents that look like the JSON partition
+// outputs returned by UDFs for typical datasets.
+std::vector<std::string> GenerateContents(int64_t group_size) {
+  uint seed = 42;
+  std::vector<std::string> contents;
+  for (int64_t group = 0; group < absl::GetFlag(FLAGS_num_groups); ++group) {
+    std::string content = R"([{"id":0,"keyGroupOutputs":[{"keyValues":{)";
+    for (int64_t i = 0; static_cast<int64_t>(content.size()) < group_size;
+         ++i) {
+      absl::StrAppend(&content, R"("key)", group, "-", i,
+                      R"(":{"value":"{\"campaign\":\"c)", rand_r(&seed) % 1000,
+                      R"(\",\"bid\":)", rand_r(&seed) % 100, R"(}"},)");
+    }
+    content.back() = '}';
+    content.append(R"(,"tags":["custom","keys"]}]}])");
+    contents.push_back(std::move(content));
+  }
+  return contents;
+}
+
+void BM_CompressCompressionGroups(::benchmark::State& state,
+                                  CompressionType type, int64_t level,
+                                  std::vector<std::string> contents) {
+  CompressionGroupCompressor compressor({
+      .type = type,
+      .level = static_cast<int>(level),
+  });
+  int64_t uncompressed_bytes = 0;
+  for (const auto& content : contents) {
+    uncompressed_bytes += content.size();
+  }
+  int64_t compressed_bytes = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<std::string> response_contents = contents;
+    std::vector<std::string*> pointers;
+    for (auto& content : response_contents) {
+      pointers.push_back(&content);
+    }
+    state.ResumeTiming();
+    if (auto compressed = compressor.Compress(pointers); !compressed.ok()) {
+      state.SkipWithError(compressed.status().ToString().c_str());
+      return;
+    }
+    compressed_bytes = 0;
+    for (const auto& content : response_contents) {
+      compressed_bytes += content.size();
+    }
+    ::benchmark::DoNotOptimize(response_contents);
+  }
+  state.SetBytesProcessed(state.iterations() * uncompressed_bytes);
+  state.counters[std::string(kResponsesPerSec)] =
+      ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
+  state.counters[std::string(kCompressedBytes)] = compressed_bytes;
+  state.counters[std::string(kCompressionRatio)] =
+      static_cast<double>(uncompressed_bytes) / compressed_bytes;
+}
+
+void RegisterBenchmark(CompressionType type, int64_t level,
+                       int64_t group_size,
+                       const std::vector<std::string>& contents) {
+  ::benchmark::RegisterBenchmark(
+      absl::StrFormat(kCompressFmt, CompressionGroupCompressor::Name(type),
+                      level, group_size)
+          .c_str(),
+      BM_CompressCompressionGroups, type, level, contents);
+}
+
+void RegisterBenchmarks() {
+  auto group_sizes = ParseInt64List(absl::GetFlag(FLAGS_group_size));
+  auto brotli_qualities = ParseInt64List(absl::GetFlag(FLAGS_brotli_quality));
+  auto gzip_levels = ParseInt64List(absl::GetFlag(FLAGS_gzip_level));
+  for (auto group_size : group_sizes.value()) {
+    const auto contents = GenerateContents(group_size);
+    RegisterBenchmark(CompressionType::kUncompressed, 0, group_size, contents);
+    for (auto quality : brotli_qualities.value()) {
+      RegisterBenchmark(CompressionType::kBrotli, quality, group_size,
+                        contents);
+    }
+    for (auto level : gzip_levels.value()) {
+      RegisterBenchmark(CompressionType::kGzip, level, group_size, contents);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks for compressing the compression groups of V2 responses with
+// each algorithm and level. `CompressionRatio` is the uncompressed size
+// divided by the compressed size. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:compression_benchmark \
+//    --config=local_instance \
+//    --config=local_platform -- \
+//    --group_size=1000,10000,100000 --num_groups=4 \
+//    --brotli_quality=1,5,11 --gzip_level=1,6,9 \
+//    --benchmark_counters_tabular=true --stderrthreshold=0
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+#include "components/tools/util/configure_telemetry_tools.h"
+#include "components/util/platform_initializer.h"
+#include "public/data_loading/csv/concurrent_csv_delta_record_reader.h"
+#include "public/data_loading/csv/csv_delta_record_stream_reader.h"
+#include "public/data_loading/csv/csv_delta_record_stream_writer.h"
+#include "public/data_loading/record_utils.h"
+#include "public/data_loading/writers/delta_record_stream_writer.h"
+#include "src/util/status_macro/status_macros.h"
+
+ABSL_FLAG(int64_t, num_records, 1'000'000,
+          "Number of records in the CSV input.");
+ABSL_FLAG(int64_t, record_size, 256, "Size of each record value.");
+ABSL_FLAG(std::vector<std::string>, args_reader_threads,
+          std::vector<std::string>({"1", "2", "4", "8", "16"}),
+          "A list of numbers of threads used to parse the CSV input. 1 uses "
+          "the single-threaded CsvDeltaRecordStreamReader.");
+ABSL_FLAG(int64_t, chunk_size_bytes, 8 * 1024 * 1024,
+          "Size of the chunks parsed by each thread.");
+
+using kv_server::ConcurrentCsvDeltaRecordReader;
+using kv_server::CsvDeltaRecordStreamReader;
+using kv_server::CsvDeltaRecordStreamWriter;
+using kv_server::DataRecord;
+using kv_server::DataRecordT;
+using kv_server::DeltaRecordReader;
+using kv_server::DeltaRecordStreamWriter;
+using kv_server::DeltaRecordWriter;
+using kv_server::KeyValueMutationRecordT;
+using kv_server::KeyValueMutationType;
+using kv_server::StringValueT;
+using kv_server::benchmark::GenerateRandomString;
+using kv_server::benchmark::ParseInt64List;
+
+namespace {
+
+// CSV input converted by each benchmark iteration.
+std::string* csv_data = nullptr;
+
+absl::StatusOr<std::string> GenerateCsvData() {
+  std::stringstream stream;
+  CsvDeltaRecordStreamWriter record_writer(stream);
+  const std::string value =
+      GenerateRandomString(absl::GetFlag(FLAGS_record_size));
+  for (int64_t i = 0; i < absl::GetFlag(FLAGS_num_records); ++i) {
+    KeyValueMutationRecordT kv_mutation_record = {
+        .mutation_type = KeyValueMutationType::Update,
+        .logical_commit_time = i + 1,
+        .key = absl::StrCat("key", i),
+    };
+    kv_mutation_record.value.Set(StringValueT{.value = value});
+    DataRecordT data_record;
+    data_record.record.Set(std::move(kv_mutation_record));
+    PS_RETURN_IF_ERROR(record_writer.WriteRecord(data_record));
+  }
+  record_writer.Close();
+  return stream.str();
+}
+
+std::unique_ptr<DeltaRecordReader> CreateReader(std::istream& input,
+                                                int64_t num_threads,
+                                                bool preserve_order) {
+  if (num_threads == 1) {
+    return std::make_unique<CsvDeltaRecordStreamReader<std::istream>>(input);
+  }
+  return std::make_unique<ConcurrentCsvDeltaRecordReader>(
+      input, ConcurrentCsvDeltaRecordReader::Options{
+                 .num_worker_threads = num_threads,
+                 .chunk_size_bytes = absl::GetFlag(FLAGS_chunk_size_bytes),
+                 .preserve_order = preserve_order,
+             });
+}
+
+// Converts the CSV input to a delta file, like `data_cli format_data` does.
+void BM_ConvertCsvToDelta(benchmark::State& state, bool preserve_order) {
+  const int64_t num_threads = state.range(0);
+  for (auto _ : state) {
+    std::istringstream input(*csv_data);
+    std::stringstream output;
+    auto record_writer = DeltaRecordStreamWriter<>::Create(
+        output, DeltaRecordWriter::Options{});
+    if (!record_writer.ok()) {
+      state.SkipWithError(record_writer.status().ToString().c_str());
+      return;
+    }
+    auto record_reader = CreateReader(input, num_threads, preserve_order);
+    auto status = record_reader->ReadRecords(
+        [&record_writer](const DataRecord& data_record) {
+          std::unique_ptr<DataRecordT> data_record_native(data_record.UnPack());
+          return (*record_writer)->WriteRecord(*data_record_native);
+        });
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString().c_str());
+      return;
+    }
+    (*record_writer)->Close();
+  }
+  state.counters["MBps"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * csv_data->size()) /
+          (1024 * 1024),
+      benchmark::Counter::kIsRate);
+}
+
+void RegisterBenchmarks() {
+  auto reader_threads =
+      ParseInt64List(absl::GetFlag(FLAGS_args_reader_threads));
+  for (const bool preserve_order : {true, false}) {
+    auto* b = benchmark::RegisterBenchmark(
+        preserve_order ? "BM_ConvertCsvToDelta/ordered"
+                       : "BM_ConvertCsvToDelta/unordered",
+        BM_ConvertCsvToDelta, preserve_order);
+    for (auto num_threads : reader_threads.value()) {
+      b->Arg(num_threads);
+    }
+    b->ArgName("threads")->UseRealTime()->Unit(benchmark::kMillisecond);
+  }
+}
+
+}  // namespace
+
+// Sample run:
+//
+// bazel run -c opt \
+//  components/tools/benchmarks:csv_conversion_benchmark \
+//    --config=local_instance --config=local_platform -- \
+//    --num_records=1000000 \
+//    --record_size=256 \
+//    --args_reader_threads=1,2,4,8,16 \
+//    --chunk_size_bytes=8388608
+int main(int argc, char** argv) {
+  ::kv_server::PlatformInitializer platform_initializer;
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  kv_server::ConfigureTelemetryForTools();
+  auto generated_csv_data = GenerateCsvData();
+  if (!generated_csv_data.ok()) {
+    LOG(ERROR) << "Failed to generate CSV data. "
+               << generated_csv_data.status();
+    return -1;
+  }
+  csv_data = &*generated_csv_data;
+  RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
@@ -37,9 +37,15 @@
 #include "components/tools/benchmarks/benchmark_util.h"
 #include "components/tools/util/configure_telemetry_tools.h"
 #include "components/util/platform_initializer.h"
+#include "public/constants.h"
 #include "public/data_loading/data_loading_generated.h"
+#include "public/data_loading/readers/avro_stream_io.h"
+#include "public/data_loading/readers/delta_record_stream_reader.h"
 #include "public/data_loading/readers/riegeli_stream_io.h"
 #include "public/data_loading/record_utils.h"
+#include "public/data_loading/writers/avro_delta_record_stream_writer.h"
+#include "public/sharding/key_sharder.h"
+#include "public/sharding/sharding_function.h"
 
 ABSL_FLAG(std::string, data_directory, "",
           "Data directory or bucket to store benchmark input data files in.");
@@ -67,36 +73,62 @@ ABSL_FLAG(
     "Chunk size to use when reading blobs in mbs. Ignored for local platform.");
 ABSL_FLAG(int64_t, args_benchmark_iterations, -1,
           "Number of iterations to run each benchmark.");
+ABSL_FLAG(int32_t, num_shards, 1,
+          "Number of shards. If greater than 1, records are filtered by shard "
+          "and, when '--create_input_file' is true, the input data file only "
+          "contains records for '--shard_num'.");
+ABSL_FLAG(int32_t, shard_num, 0,
+          "Shard number of the server loading the data file.");
+ABSL_FLAG(std::vector<std::string>, args_file_formats,
+          std::vector<std::string>({"riegeli"}),
+          "A list of file formats (riegeli, avro) to read the data file in. "
+          "The avro data file is '<filename>.avro' and, when "
+          "'--create_input_file' is true, contains the same records as the "
+          "riegeli data file.");
 
 using kv_server::BlobReader;
 using kv_server::BlobStorageClient;
+using kv_server::AvroConcurrentStreamRecordReader;
+using kv_server::AvroDeltaRecordStreamWriter;
 using kv_server::BlobStorageClientFactory;
 using kv_server::Cache;
 using kv_server::ConcurrentStreamRecordReader;
 using kv_server::DataRecord;
+using kv_server::DataRecordT;
+using kv_server::DeltaRecordStreamReader;
+using kv_server::DeltaRecordWriter;
 using kv_server::DeserializeRecord;
+using kv_server::FileFormat;
 using kv_server::KeyValueCache;
 using kv_server::KeyValueMutationRecord;
 using kv_server::KeyValueMutationType;
+using kv_server::KeySharder;
 using kv_server::MaybeGetRecordValue;
 using kv_server::NoOpKeyValueCache;
 using kv_server::Record;
 using kv_server::RecordStream;
+using kv_server::ShardingFunction;
+using kv_server::StreamRecordReader;
 using kv_server::Value;
 using kv_server::benchmark::ParseInt64List;
 using kv_server::benchmark::WriteRecords;
+using kv_server::benchmark::WriteShardedRecords;
 
 constexpr std::string_view kNoOpCacheNameFormat =
-    "BM_DataLoading_NoOpCache/tds:%d/conns:%d/buf:%d";
+    "BM_DataLoading_NoOpCache/fmt:%s/tds:%d/conns:%d/buf:%d%s";
 constexpr std::string_view kMutexCacheNameFormat =
-    "BM_DataLoading_MutexCache/tds:%d/conns:%d/buf:%d";
+    "BM_DataLoading_MutexCache/fmt:%s/tds:%d/conns:%d/buf:%d%s";
 
 // Args config for benchmarks.
 struct BenchmarkArgs {
+  FileFormat file_format = FileFormat::kRiegeli;
   int64_t reader_worker_threads;
   int64_t client_max_connections;
   int64_t client_max_range_mb;
   std::function<std::unique_ptr<Cache>()> create_cache_fn;
+  // If true, per-record shard checks are skipped when the data file's sharding
+  // metadata matches the server's shard and sharding function.
+  bool trust_sharding_metadata = false;
 };
 
 // Wraps an io stream so that it can used as a blob reader.
@@ -122,13 +154,59 @@ class BlobRecordStream : public RecordStream {
   std::unique_ptr<BlobReader> blob_reader_;
 };
 
-BlobStorageClient::DataLocation GetBlobLocation() {
+BlobStorageClient::DataLocation GetBlobLocation(
+    FileFormat file_format = FileFormat::kRiegeli) {
   return BlobStorageClient::DataLocation{
       .bucket = absl::GetFlag(FLAGS_data_directory),
-      .key = absl::GetFlag(FLAGS_filename),
+      .key = file_format == FileFormat::kAvro
+                 ? absl::StrCat(absl::GetFlag(FLAGS_filename), ".avro")
+                 : absl::GetFlag(FLAGS_filename),
   };
 }
 
+// Writes the records and metadata of the riegeli `src_stream` to `dest_stream`
+// in avro, so that both formats are benchmarked with the same records.
+absl::Status ConvertToAvro(std::iostream& src_stream,
+                           std::iostream& dest_stream) {
+  DeltaRecordStreamReader<> record_reader(src_stream);
+  PS_ASSIGN_OR_RETURN(auto metadata, record_reader.ReadMetadata());
+  PS_ASSIGN_OR_RETURN(
+      auto record_writer,
+      AvroDeltaRecordStreamWriter<std::iostream>::Create(
+          dest_stream, DeltaRecordWriter::Options{.metadata = metadata}));
+  PS_RETURN_IF_ERROR(
+      record_reader.ReadRecords([&record_writer](const DataRecord& record) {
+        std::unique_ptr<DataRecordT> data_record(record.UnPack());
+        return record_writer->WriteRecord(*data_record);
+      }));
+  record_writer->Close();
+  return record_writer->Status();
+}
+
+absl::Status CreateInputFile(BlobStorageClient& blob_client,
+                             FileFormat file_format,
+                             std::iostream& data_stream) {
+  LOG(INFO) << "Creating input file: " << GetBlobLocation(file_format);
+  StreamBlobReader blob_reader(data_stream);
+  PS_RETURN_IF_ERROR(
+      blob_client.PutBlob(blob_reader, GetBlobLocation(file_format)));
+  LOG(INFO) << "Done creating input file: " << GetBlobLocation(file_format);
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::vector<FileFormat>> GetFileFormats() {
+  std::vector<FileFormat> file_formats;
+  for (const auto& format : absl::GetFlag(FLAGS_args_file_formats)) {
+    FileFormat file_format;
+    if (std::string error; !AbslParseFlag(format, &file_format, &error)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid file format: ", format, ". ", error));
+    }
+    file_formats.push_back(file_format);
+  }
+  return file_formats;
+}
+
 int64_t GetBlobSize(BlobStorageClient& blob_client,
                     BlobStorageClient::DataLocation blob) {
   auto blob_reader = blob_client.GetBlobReader(blob);
@@ -157,27 +235,90 @@ void RegisterBenchmarks() {
       ParseInt64List(absl::GetFlag(FLAGS_args_client_max_connections));
   auto client_max_range_mb =
       ParseInt64List(absl::GetFlag(FLAGS_args_client_max_range_mb));
-  for (const int64_t byte_range_mb : client_max_range_mb.value()) {
-    for (const int64_t num_connections : client_max_conns.value()) {
-      for (const int64_t num_threads : num_worker_threads.value()) {
-        auto args = BenchmarkArgs{
-            .reader_worker_threads = num_threads,
-            .client_max_connections = num_connections,
-            .client_max_range_mb = byte_range_mb,
-            .create_cache_fn = []() { return NoOpKeyValueCache::Create(); },
-        };
-        RegisterBenchmark(absl::StrFormat(kNoOpCacheNameFormat, num_threads,
-                                          num_connections, byte_range_mb),
-                          args);
-        args.create_cache_fn = []() { return KeyValueCache::Create(); };
-        RegisterBenchmark(absl::StrFormat(kMutexCacheNameFormat, num_threads,
-                                          num_connections, byte_range_mb),
-                          args);
+  auto file_formats = GetFileFormats();
+  std::vector<bool> trust_sharding_metadata_options = {false};
+  if (absl::GetFlag(FLAGS_num_shards) > 1) {
+    trust_sharding_metadata_options.push_back(true);
+  }
+  for (const FileFormat file_format : file_formats.value()) {
+    const std::string format_name = AbslUnparseFlag(file_format);
+    for (const int64_t byte_range_mb : client_max_range_mb.value()) {
+      for (const int64_t num_connections : client_max_conns.value()) {
+        for (const int64_t num_threads : num_worker_threads.value()) {
+          for (const bool trust_sharding_metadata :
+               trust_sharding_metadata_options) {
+            const std::string shard_check_suffix =
+                absl::GetFlag(FLAGS_num_shards) <= 1 ? ""
+                : trust_sharding_metadata ? "/shard_check:metadata"
+                                          : "/shard_check:hash";
+            auto args = BenchmarkArgs{
+                .file_format = file_format,
+                .reader_worker_threads = num_threads,
+                .client_max_connections = num_connections,
+                .client_max_range_mb = byte_range_mb,
+                .create_cache_fn = []() { return NoOpKeyValueCache::Create(); },
+                .trust_sharding_metadata = trust_sharding_metadata,
+            };
+            RegisterBenchmark(
+                absl::StrFormat(kNoOpCacheNameFormat, format_name, num_threads,
+                                num_connections, byte_range_mb,
+                                shard_check_suffix),
+                args);
+            args.create_cache_fn = []() { return KeyValueCache::Create(); };
+            RegisterBenchmark(
+                absl::StrFormat(kMutexCacheNameFormat, format_name,
+                                num_threads, num_connections, byte_range_mb,
+                                shard_check_suffix),
+                args);
+          }
+        }
       }
     }
   }
 }
 
+// Returns true if the records of the data file must be checked against the
+// server's shard one by one.
+bool ShouldCheckShardPerRecord(StreamRecordReader& record_reader,
+                               const KeySharder& key_sharder,
+                               const BenchmarkArgs& args) {
+  const int32_t num_shards = absl::GetFlag(FLAGS_num_shards);
+  if (num_shards <= 1) {
+    return false;
+  }
+  if (!args.trust_sharding_metadata) {
+    return true;
+  }
+  auto metadata = record_reader.GetKVFileMetadata();
+  if (!metadata.ok() || !metadata->has_sharding_metadata()) {
+    return true;
+  }
+  const auto& sharding_metadata = metadata->sharding_metadata();
+  const auto fingerprint = key_sharder.GetFingerprint(num_shards);
+  return sharding_metadata.shard_num() != absl::GetFlag(FLAGS_shard_num) ||
+         !fingerprint.has_value() ||
+         *fingerprint != sharding_metadata.sharding_function_fingerprint();
+}
+
+std::unique_ptr<StreamRecordReader> CreateRecordReader(
+    BlobStorageClient& blob_client, const BenchmarkArgs& args) {
+  auto stream_factory = [blob_client = &blob_client,
+                         blob = GetBlobLocation(args.file_format)]() {
+    return std::make_unique<BlobRecordStream>(blob_client->GetBlobReader(blob));
+  };
+  if (args.file_format == FileFormat::kAvro) {
+    AvroConcurrentStreamRecordReader::Options options;
+    options.num_worker_threads = args.reader_worker_threads;
+    return std::make_unique<AvroConcurrentStreamRecordReader>(
+        std::move(stream_factory), options);
+  }
+  return std::make_unique<ConcurrentStreamRecordReader<std::string_view>>(
+      std::move(stream_factory),
+      ConcurrentStreamRecordReader<std::string_view>::Options{
+          .num_worker_threads = args.reader_worker_threads,
+      });
+}
+
 absl::Status ApplyUpdateMutation(
     kv_server::benchmark::BenchmarkLogContext& log_context,
     const KeyValueMutationRecord& record, Cache& cache) {
@@ -233,32 +374,41 @@ void BM_LoadDataIntoCache(benchmark::State& state, BenchmarkArgs args) {
       BlobStorageClientFactory::Create();
   std::unique_ptr<BlobStorageClient> blob_client =
       blob_storage_client_factory->CreateBlobStorageClient(options);
-  ConcurrentStreamRecordReader<std::string_view> record_reader(
-      /*stream_factory=*/
-      [blob_client = blob_client.get()]() {
-        return std::make_unique<BlobRecordStream>(
-            blob_client->GetBlobReader(GetBlobLocation()));
-      },
-      /*options=*/
-      {
-          .num_worker_threads = args.reader_worker_threads,
-      });
-  auto stream_size = GetBlobSize(*blob_client, GetBlobLocation());
+  std::unique_ptr<StreamRecordReader> record_reader =
+      CreateRecordReader(*blob_client, args);
+  auto stream_size =
+      GetBlobSize(*blob_client, GetBlobLocation(args.file_format));
   std::atomic<int64_t> num_records_read{0};
   kv_server::benchmark::BenchmarkLogContext log_context;
+  const KeySharder key_sharder(ShardingFunction(/*seed=*/""));
+  const int32_t num_shards = absl::GetFlag(FLAGS_num_shards);
+  const int32_t shard_num = absl::GetFlag(FLAGS_shard_num);
   for (auto _ : state) {
     state.PauseTiming();
     auto cache = args.create_cache_fn();
     state.ResumeTiming();
-    auto status = record_reader.ReadStreamRecords(
-        [&num_records_read, &log_context,
-         cache = cache.get()](std::string_view raw) {
+    // Done inside the timed loop since the server makes this decision for
+    // every file it loads.
+    const bool check_shard_per_record =
+        ShouldCheckShardPerRecord(*record_reader, key_sharder, args);
+    auto status = record_reader->ReadStreamRecords(
+        [&num_records_read, &log_context, &key_sharder, num_shards, shard_num,
+         check_shard_per_record, cache = cache.get()](std::string_view raw) {
           num_records_read++;
-          return DeserializeRecord(raw, [cache, &log_context](
+          return DeserializeRecord(raw, [cache, &log_context, &key_sharder,
+                                         num_shards, shard_num,
+                                         check_shard_per_record](
                                             const DataRecord& data_record) {
             if (data_record.record_type() == Record::KeyValueMutationRecord) {
               const auto* record =
                   data_record.record_as_KeyValueMutationRecord();
+              if (check_shard_per_record &&
+                  key_sharder
+                          .GetShardNumForKey(record->key()->string_view(),
+                                             num_shards)
+                          .shard_num != shard_num) {
+                return absl::OkStatus();
+              }
               switch (record->mutation_type()) {
                 case KeyValueMutationType::Update: {
                   if (auto status =
@@ -307,6 +457,13 @@ void BM_LoadDataIntoCache(benchmark::State& state, BenchmarkArgs args) {
 //    --args_client_max_range_mb=8 \
 //    --args_client_max_connections=64 \
 //    --args_reader_worker_threads=16,32,64 --stderrthreshold=0
+//
+// Add '--args_file_formats=riegeli,avro' to the flags above to compare
+// loading the same records from riegeli and avro data files.
+//
+// Add '--num_shards=4 --shard_num=1' to the flags above to benchmark loading a
+// pre-sharded file with per-record shard checks vs. trusting the sharding
+// metadata of the file.
 int main(int argc, char** argv) {
   ::kv_server::PlatformInitializer platform_initializer;
   absl::InitializeLog();
@@ -320,40 +477,68 @@ int main(int argc, char** argv) {
     LOG(ERROR) << "Flag '--filename' must be not empty.";
     return -1;
   }
+  auto file_formats = GetFileFormats();
+  if (!file_formats.ok()) {
+    LOG(ERROR) << "Flag '--args_file_formats' is invalid. "
+               << file_formats.status();
+    return -1;
+  }
   kv_server::ConfigureTelemetryForTools();
   std::unique_ptr<BlobStorageClientFactory> blob_storage_client_factory =
       BlobStorageClientFactory::Create();
   std::unique_ptr<BlobStorageClient> blob_client =
       blob_storage_client_factory->CreateBlobStorageClient();
   if (absl::GetFlag(FLAGS_create_input_file)) {
-    LOG(INFO) << "Creating input file: " << GetBlobLocation();
     std::stringstream data_stream;
     if (auto status =
-            WriteRecords(absl::GetFlag(FLAGS_num_records),
-                         absl::GetFlag(FLAGS_record_size), data_stream);
+            absl::GetFlag(FLAGS_num_shards) > 1
+                ? WriteShardedRecords(absl::GetFlag(FLAGS_num_records),
+                                      absl::GetFlag(FLAGS_record_size),
+                                      absl::GetFlag(FLAGS_shard_num),
+                                      absl::GetFlag(FLAGS_num_shards),
+                                      data_stream)
+                : WriteRecords(absl::GetFlag(FLAGS_num_records),
+                               absl::GetFlag(FLAGS_record_size), data_stream);
         !status.ok()) {
       LOG(ERROR) << "Failed to write records for data file. " << status;
       return -1;
     }
-    StreamBlobReader blob_reader(data_stream);
-    if (auto status = blob_client->PutBlob(blob_reader, GetBlobLocation());
-        !status.ok()) {
-      LOG(ERROR) << "Failed to write data file. " << status;
-      return -1;
+    for (const FileFormat file_format : *file_formats) {
+      std::stringstream avro_data_stream;
+      if (file_format == FileFormat::kAvro) {
+        data_stream.clear();
+        data_stream.seekg(0);
+        if (auto status = ConvertToAvro(data_stream, avro_data_stream);
+            !status.ok()) {
+          LOG(ERROR) << "Failed to convert records to avro. " << status;
+          return -1;
+        }
+      }
+      data_stream.clear();
+      data_stream.seekg(0);
+      if (auto status = CreateInputFile(*blob_client, file_format,
+                                        file_format == FileFormat::kAvro
+                                            ? avro_data_stream
+                                            : data_stream);
+          !status.ok()) {
+        LOG(ERROR) << "Failed to write data file. " << status;
+        return -1;
+      }
     }
-    LOG(INFO) << "Done creating input file: " << GetBlobLocation();
   }
   RegisterBenchmarks();
   ::benchmark::RunSpecifiedBenchmarks();
   ::benchmark::Shutdown();
   if (absl::GetFlag(FLAGS_create_input_file)) {
-    LOG(INFO) << "Deleting input file: " << GetBlobLocation();
-    if (auto status = blob_client->DeleteBlob(GetBlobLocation());
-        !status.ok()) {
-      LOG(ERROR) << "Failed to write data file. " << status;
-      return -1;
+    for (const FileFormat file_format : *file_formats) {
+      LOG(INFO) << "Deleting input file: " << GetBlobLocation(file_format);
+      if (auto status = blob_client->DeleteBlob(GetBlobLocation(file_format));
+          !status.ok()) {
+        LOG(ERROR) << "Failed to write data file. " << status;
+        return -1;
+      }
+      LOG(INFO) << "Done deleting input file: " << GetBlobLocation(file_format);
     }
-    LOG(INFO) << "Done deleting input file: " << GetBlobLocation();
   }
   return 0;
 }
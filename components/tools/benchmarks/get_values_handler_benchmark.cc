@@ -0,0 +1,164 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/request_handler/get_values_adapter.h"
+#include "components/data_server/request_handler/get_values_handler.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+#include "components/tools/util/configure_telemetry_tools.h"
+#include "components/util/request_context.h"
+#include "public/query/get_values.grpc.pb.h"
+
+ABSL_FLAG(std::vector<std::string>, value_size,
+          std::vector<std::string>({"100", "1000", "10000"}),
+          "Approximate sizes of the JSON values in the cache.");
+ABSL_FLAG(std::vector<std::string>, query_size,
+          std::vector<std::string>({"10", "100"}),
+          "Number of keys looked up by each request.");
+ABSL_FLAG(int64_t, num_keys, 10'000, "Number of keys loaded into the cache.");
+
+namespace kv_server {
+namespace {
+
+using kv_server::benchmark::BenchmarkLogContext;
+using kv_server::benchmark::ParseInt64List;
+
+// Format variables used to generate benchmark names.
+//
+// => vz - approximate size of each JSON value in the cache.
+// => qz - query size, i.e., number of keys looked up by each request.
+constexpr std::string_view kParseOnLookupFmt =
+    "BM_GetValuesHandler_ParseOnLookup/vz:%d/qz:%d";
+constexpr std::string_view kParseOnLoadFmt =
+    "BM_GetValuesHandler_ParseOnLoad/vz:%d/qz:%d";
+
+constexpr std::string_view kRequestsPerSec = "Requests/s";
+
+// Returns a JSON value like the interest group values of typical datasets,
+// i.e., an object with a list of ads that have mostly the same field names.
+std::string GenerateJsonValue(int64_t value_size, uint* seed) {
+  static constexpr std::string_view kWords[] = {
+      "render", "url", "https://ads.example.com/", "creative", "campaign",
+      "size", "300x250", "priority", "bidding", "signals", "seller"};
+  std::string value = absl::StrFormat(
+      R"({"campaign":"c%d","priority":%d,"ads":[)", rand_r(seed) % 1000,
+      rand_r(seed) % 10);
+  while (static_cast<int64_t>(value.size()) < value_size) {
+    absl::StrAppend(&value, R"({"metadata":")",
+                    kWords[rand_r(seed) % std::size(kWords)], R"(","bid":)",
+                    rand_r(seed) % 100, R"(,"sizes":[300,250]},)");
+  }
+  value.back() = ']';
+  value.push_back('}');
+  return value;
+}
+
+std::unique_ptr<Cache> CreateCache(int64_t value_size,
+                                   bool parse_json_values) {
+  auto cache = KeyValueCache::Create({.parse_json_values = parse_json_values});
+  BenchmarkLogContext log_context;
+  uint seed = 42;
+  for (int64_t i = 0; i < absl::GetFlag(FLAGS_num_keys); ++i) {
+    cache->UpdateKeyValue(log_context, absl::StrCat("key", i),
+                          GenerateJsonValue(value_size, &seed),
+                          /*logical_commit_time=*/1);
+  }
+  return cache;
+}
+
+// Serves v1 requests straight from the cache, i.e., without routing them to
+// the UDF, and serializes the responses like the gRPC service does.
+void BM_GetValues(::benchmark::State& state, const Cache* cache,
+                  int64_t query_size) {
+  auto adapter = GetValuesAdapter::Create(/*v2_handler=*/nullptr);
+  GetValuesHandler handler(*cache, *adapter, /*use_v2=*/false);
+  v1::GetValuesRequest request;
+  for (int64_t i = 0; i < query_size; ++i) {
+    request.add_keys(
+        absl::StrCat("key", i * absl::GetFlag(FLAGS_num_keys) / query_size));
+  }
+  RequestContextFactory request_context_factory;
+  for (auto _ : state) {
+    v1::GetValuesResponse response;
+    if (auto status =
+            handler.GetValues(request_context_factory, request, &response);
+        !status.ok()) {
+      state.SkipWithError(status.error_message().c_str());
+      return;
+    }
+    ::benchmark::DoNotOptimize(response.SerializeAsString());
+  }
+  state.counters[std::string(kRequestsPerSec)] =
+      ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
+}
+
+void RegisterBenchmarks() {
+  auto value_sizes = ParseInt64List(absl::GetFlag(FLAGS_value_size));
+  auto query_sizes = ParseInt64List(absl::GetFlag(FLAGS_query_size));
+  for (auto value_size : value_sizes.value()) {
+    // The caches are shared by the benchmarks of all query sizes.
+    const Cache* cache =
+        CreateCache(value_size, /*parse_json_values=*/false).release();
+    const Cache* parsed_cache =
+        CreateCache(value_size, /*parse_json_values=*/true).release();
+    for (auto query_size : query_sizes.value()) {
+      ::benchmark::RegisterBenchmark(
+          absl::StrFormat(kParseOnLookupFmt, value_size, query_size).c_str(),
+          BM_GetValues, cache, query_size);
+      ::benchmark::RegisterBenchmark(
+          absl::StrFormat(kParseOnLoadFmt, value_size, query_size).c_str(),
+          BM_GetValues, parsed_cache, query_size);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks for serving v1 GetValues requests from the cache, with the
+// JSON values parsed on every lookup or once when they are loaded. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:get_values_handler_benchmark \
+//    --config=local_instance \
+//    --config=local_platform -- \
+//    --value_size=100,1000,10000 --query_size=10,100 \
+//    --benchmark_counters_tabular=true --stderrthreshold=0
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  kv_server::ConfigureTelemetryForTools();
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
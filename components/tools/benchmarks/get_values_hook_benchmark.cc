@@ -0,0 +1,316 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "benchmark/benchmark.h"
+#include "components/internal_server/lookup.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+#include "components/tools/util/configure_telemetry_tools.h"
+#include "components/udf/hooks/get_values_hook.h"
+#include "components/util/request_context.h"
+
+ABSL_FLAG(std::vector<std::string>, value_size,
+          std::vector<std::string>({"10", "100", "1000"}),
+          "Sizes of the values returned by the lookup.");
+ABSL_FLAG(std::vector<std::string>, keys_per_call,
+          std::vector<std::string>({"1", "10", "100"}),
+          "Number of keys passed to each getValues call.");
+ABSL_FLAG(std::vector<std::string>, duplicate_percent,
+          std::vector<std::string>({"0", "50", "90"}),
+          "Percentages of the keys of a call that were already looked up by "
+          "an earlier call of the same request.");
+ABSL_FLAG(int64_t, calls_per_request, 10,
+          "Number of getValues calls made by the UDF of each request.");
+ABSL_FLAG(std::vector<std::string>, lookup_latency_micros,
+          std::vector<std::string>({"0", "100"}),
+          "Latencies of the lookups, e.g., of the remote lookups of sharded "
+          "servers.");
+
+namespace kv_server {
+namespace {
+
+using google::scp::roma::FunctionBindingPayload;
+using google::scp::roma::proto::FunctionBindingIoProto;
+using kv_server::benchmark::ParseInt64List;
+
+// Format variables used to generate benchmark names.
+//
+// => vz - size of each value.
+// => kz - number of keys passed to each call.
+constexpr std::string_view kStringOutputFmt =
+    "BM_GetValuesHook_StringOutput/vz:%d/kz:%d";
+constexpr std::string_view kBinaryOutputFmt =
+    "BM_GetValuesHook_BinaryOutput/vz:%d/kz:%d";
+// => dup - percentage of the keys of a call that were already looked up.
+// => lat - latency of each lookup in microseconds.
+constexpr std::string_view kRepeatedKeysFmt =
+    "BM_GetValuesHook_RepeatedKeys/dup:%d/kz:%d/lat:%d";
+
+constexpr std::string_view kCallsPerSec = "Calls/s";
+constexpr std::string_view kLookedUpKeysPerCall = "LookedUpKeys/call";
+
+constexpr int64_t kRepeatedKeysValueSize = 100;
+
+// Returns the same response for every call, so that the benchmark measures
+// the work done by the hook itself.
+class FixedLookup : public Lookup {
+ public:
+  explicit FixedLookup(InternalLookupResponse response)
+      : response_(std::move(response)) {}
+
+  absl::StatusOr<InternalLookupResponse> GetKeyValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys) const override {
+    return response_;
+  }
+
+  absl::StatusOr<InternalLookupResponse> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override {
+    return absl::UnimplementedError("Not used by the benchmark");
+  }
+
+  absl::StatusOr<InternalLookupResponse> GetUInt32ValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override {
+    return absl::UnimplementedError("Not used by the benchmark");
+  }
+
+  absl::StatusOr<InternalLookupResponse> GetUInt64ValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override {
+    return absl::UnimplementedError("Not used by the benchmark");
+  }
+
+  absl::StatusOr<InternalRunQueryResponse> RunQuery(
+      const RequestContext& request_context, std::string query) const override {
+    return absl::UnimplementedError("Not used by the benchmark");
+  }
+
+  absl::StatusOr<InternalRunSetQueryUInt32Response> RunSetQueryUInt32(
+      const RequestContext& request_context, std::string query) const override {
+    return absl::UnimplementedError("Not used by the benchmark");
+  }
+
+  absl::StatusOr<InternalRunSetQueryUInt64Response> RunSetQueryUInt64(
+      const RequestContext& request_context, std::string query) const override {
+    return absl::UnimplementedError("Not used by the benchmark");
+  }
+
+ private:
+  const InternalLookupResponse response_;
+};
+
+// Returns the values of the requested keys after `latency`, and counts the
+// keys that are looked up.
+class CountingLookup : public FixedLookup {
+ public:
+  CountingLookup(InternalLookupResponse values, absl::Duration latency)
+      : FixedLookup(InternalLookupResponse()),
+        values_(std::move(values)),
+        latency_(latency) {}
+
+  absl::StatusOr<InternalLookupResponse> GetKeyValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys) const override {
+    looked_up_keys_ += keys.size();
+    if (latency_ > absl::ZeroDuration()) {
+      absl::SleepFor(latency_);
+    }
+    InternalLookupResponse response;
+    for (std::string_view key : keys) {
+      auto it = values_.kv_pairs().find(std::string(key));
+      if (it != values_.kv_pairs().end()) {
+        (*response.mutable_kv_pairs())[it->first] = it->second;
+      }
+    }
+    return response;
+  }
+
+  int64_t looked_up_keys() const { return looked_up_keys_; }
+
+ private:
+  const InternalLookupResponse values_;
+  const absl::Duration latency_;
+  mutable std::atomic<int64_t> looked_up_keys_{0};
+};
+
+// Returns a JSON value of about `value_size` bytes.
+std::string MakeValue(int64_t value_size) {
+  // Values are JSON, which has quotes that need to be escaped.
+  std::string value = R"({"ad":")";
+  value.resize(std::max<int64_t>(value.size(), value_size - 2), 'x');
+  value.append(R"("})");
+  return value;
+}
+
+// Calls the hook the way V8 does, i.e., with the keys as a list of strings,
+// and looks up the same keys in every call.
+void BM_GetValuesHook(::benchmark::State& state,
+                      GetValuesHook::OutputType output_type,
+                      int64_t value_size, int64_t keys_per_call) {
+  FunctionBindingIoProto input;
+  InternalLookupResponse response;
+  for (int64_t i = 0; i < keys_per_call; ++i) {
+    std::string key = absl::StrCat("key", i);
+    (*response.mutable_kv_pairs())[key].set_value(MakeValue(value_size));
+    input.mutable_input_list_of_string()->add_data(std::move(key));
+  }
+  auto hook = GetValuesHook::Create(output_type);
+  hook->FinishInit(std::make_unique<FixedLookup>(std::move(response)));
+  for (auto _ : state) {
+    // Every call is the first of its request, so that its lookup is not
+    // memoized.
+    state.PauseTiming();
+    auto request_context = std::make_shared<RequestContext>();
+    state.ResumeTiming();
+    FunctionBindingIoProto io = input;
+    FunctionBindingPayload<std::weak_ptr<RequestContext>> payload{
+        io, request_context};
+    (*hook)(payload);
+    ::benchmark::DoNotOptimize(io);
+  }
+  state.counters[std::string(kCallsPerSec)] =
+      ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
+}
+
+// Calls the hook `calls_per_request` times per request, the way a UDF that
+// looks up the keys of each of its inputs does, where `duplicate_percent` of
+// the keys of a call were already looked up by an earlier call.
+void BM_GetValuesHook_RepeatedKeys(::benchmark::State& state,
+                                   int64_t duplicate_percent,
+                                   int64_t keys_per_call,
+                                   int64_t lookup_latency_micros) {
+  const int64_t calls_per_request = absl::GetFlag(FLAGS_calls_per_request);
+  uint seed = 42;
+  int64_t num_keys = 0;
+  std::vector<FunctionBindingIoProto> inputs(calls_per_request);
+  for (auto& input : inputs) {
+    for (int64_t i = 0; i < keys_per_call; ++i) {
+      const bool duplicate =
+          num_keys > 0 && rand_r(&seed) % 100 < duplicate_percent;
+      const int64_t key = duplicate ? rand_r(&seed) % num_keys : num_keys++;
+      input.mutable_input_list_of_string()->add_data(absl::StrCat("key", key));
+    }
+  }
+  InternalLookupResponse values;
+  for (int64_t key = 0; key < num_keys; ++key) {
+    (*values.mutable_kv_pairs())[absl::StrCat("key", key)].set_value(
+        MakeValue(kRepeatedKeysValueSize));
+  }
+  auto lookup = std::make_unique<CountingLookup>(
+      std::move(values), absl::Microseconds(lookup_latency_micros));
+  const CountingLookup& counting_lookup = *lookup;
+  auto hook = GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  hook->FinishInit(std::move(lookup));
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto request_context = std::make_shared<RequestContext>();
+    state.ResumeTiming();
+    for (const auto& input : inputs) {
+      FunctionBindingIoProto io = input;
+      FunctionBindingPayload<std::weak_ptr<RequestContext>> payload{
+          io, request_context};
+      (*hook)(payload);
+      ::benchmark::DoNotOptimize(io);
+    }
+  }
+  const int64_t calls = state.iterations() * calls_per_request;
+  state.counters[std::string(kCallsPerSec)] =
+      ::benchmark::Counter(calls, ::benchmark::Counter::kIsRate);
+  state.counters[std::string(kLookedUpKeysPerCall)] =
+      static_cast<double>(counting_lookup.looked_up_keys()) / calls;
+}
+
+void RegisterBenchmarks() {
+  auto value_sizes = ParseInt64List(absl::GetFlag(FLAGS_value_size));
+  auto keys_per_call = ParseInt64List(absl::GetFlag(FLAGS_keys_per_call));
+  for (auto value_size : value_sizes.value()) {
+    for (auto num_keys : keys_per_call.value()) {
+      ::benchmark::RegisterBenchmark(
+          absl::StrFormat(kStringOutputFmt, value_size, num_keys).c_str(),
+          BM_GetValuesHook, GetValuesHook::OutputType::kString, value_size,
+          num_keys);
+      ::benchmark::RegisterBenchmark(
+          absl::StrFormat(kBinaryOutputFmt, value_size, num_keys).c_str(),
+          BM_GetValuesHook, GetValuesHook::OutputType::kBinary, value_size,
+          num_keys);
+    }
+  }
+  auto duplicate_percents =
+      ParseInt64List(absl::GetFlag(FLAGS_duplicate_percent));
+  auto lookup_latencies =
+      ParseInt64List(absl::GetFlag(FLAGS_lookup_latency_micros));
+  for (auto duplicate_percent : duplicate_percents.value()) {
+    for (auto num_keys : keys_per_call.value()) {
+      for (auto latency : lookup_latencies.value()) {
+        ::benchmark::RegisterBenchmark(
+            absl::StrFormat(kRepeatedKeysFmt, duplicate_percent, num_keys,
+                            latency)
+                .c_str(),
+            BM_GetValuesHook_RepeatedKeys, duplicate_percent, num_keys,
+            latency)
+            ->UseRealTime();
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks for the getValues UDF hook, called directly rather than
+// from a UDF, so that V8 is not part of the measurements.
+// `BM_GetValuesHook_RepeatedKeys` shows how many lookups the per-request memo
+// saves, with `LookedUpKeys/call` the number of keys that are looked up rather
+// than memoized. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:get_values_hook_benchmark \
+//    --config=local_instance \
+//    --config=local_platform -- \
+//    --value_size=10,100,1000 --keys_per_call=1,10,100 \
+//    --duplicate_percent=0,50,90 --calls_per_request=10 \
+//    --lookup_latency_micros=0,100 \
+//    --benchmark_counters_tabular=true --stderrthreshold=0
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  kv_server::ConfigureTelemetryForTools();
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
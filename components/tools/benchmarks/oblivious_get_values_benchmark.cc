@@ -0,0 +1,248 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/check.h"
+#include "absl/log/initialize.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_format.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/request_handler/get_values_v2_handler.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+#include "components/tools/util/configure_telemetry_tools.h"
+#include "components/udf/code_config.h"
+#include "components/udf/udf_client.h"
+#include "components/util/request_context.h"
+#include "grpcpp/grpcpp.h"
+#include "nlohmann/json.hpp"
+#include "public/constants.h"
+#include "quiche/oblivious_http/common/oblivious_http_header_key_config.h"
+#include "quiche/oblivious_http/oblivious_http_client.h"
+#include "src/communication/encoding_utils.h"
+#include "src/communication/framing_utils.h"
+#include "src/encryption/key_fetcher/fake_key_fetcher_manager.h"
+
+ABSL_FLAG(std::vector<std::string>, partitions,
+          std::vector<std::string>({"1", "10"}),
+          "Numbers of partitions in each request.");
+ABSL_FLAG(std::vector<std::string>, value_size,
+          std::vector<std::string>({"1000", "100000"}),
+          "Sizes of the value returned by the UDF of each partition.");
+
+namespace kv_server {
+namespace {
+
+using kv_server::benchmark::ParseInt64List;
+
+// Format variables used to generate benchmark names.
+//
+// => pz - number of partitions in the request.
+// => vz - size of the value returned by each partition.
+constexpr std::string_view kObliviousGetValuesFmt =
+    "BM_ObliviousGetValues/pz:%d/vz:%d";
+
+constexpr std::string_view kRoundTripsPerSec = "RoundTrips/s";
+constexpr std::string_view kRequestBytes = "RequestBytes";
+constexpr std::string_view kResponseBytes = "ResponseBytes";
+
+// Matches the test key pair of `FakeKeyFetcherManager`.
+constexpr uint8_t kTestKeyId = 64;
+
+// Returns the same output for every partition, so that the benchmark
+// measures the work done around UDF execution.
+class FixedOutputUdfClient : public UdfClient {
+ public:
+  explicit FixedOutputUdfClient(int64_t value_size) {
+    nlohmann::json output = {
+        {"keyGroupOutputs",
+         {{{"tags", {"custom", "keys"}},
+           {"keyValues",
+            {{"key", {{"value", std::string(value_size, 'a')}}}}}}}}};
+    output_ = output.dump();
+  }
+
+  absl::StatusOr<std::string> ExecuteCode(
+      const RequestContextFactory& request_context_factory,
+      std::vector<std::string> keys,
+      ExecutionMetadata& execution_metadata) const override {
+    return output_;
+  }
+
+  absl::StatusOr<std::string> ExecuteCode(
+      const RequestContextFactory& request_context_factory,
+      UDFExecutionMetadata&& execution_metadata,
+      const google::protobuf::RepeatedPtrField<UDFArgument>& arguments,
+      ExecutionMetadata& metadata) const override {
+    return output_;
+  }
+
+  absl::StatusOr<absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
+  BatchExecuteCode(
+      const RequestContextFactory& request_context_factory,
+      absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
+      ExecutionMetadata& metadata) const override {
+    absl::flat_hash_map<UniquePartitionIdTuple, std::string> outputs;
+    outputs.reserve(udf_input_map.size());
+    for (const auto& [id, input] : udf_input_map) {
+      outputs.emplace(id, output_);
+    }
+    return outputs;
+  }
+
+  absl::Status Stop() override { return absl::OkStatus(); }
+
+  absl::Status SetCodeObject(
+      CodeConfig code_config,
+      privacy_sandbox::server_common::log::PSLogContext& log_context) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status SetWasmCodeObject(
+      CodeConfig code_config,
+      privacy_sandbox::server_common::log::PSLogContext& log_context) override {
+    return absl::OkStatus();
+  }
+
+ private:
+  std::string output_;
+};
+
+// Returns a framed and padded CBOR request with `num_partitions` partitions,
+// all in the same compression group.
+std::string BuildFramedRequest(int64_t num_partitions) {
+  nlohmann::json partitions = nlohmann::json::array();
+  for (int64_t i = 0; i < num_partitions; ++i) {
+    partitions.push_back({{"id", i},
+                          {"compressionGroupId", 0},
+                          {"arguments", {{{"data", {"key"}}}}}});
+  }
+  nlohmann::json request = {{"partitions", partitions}};
+  std::vector<uint8_t> cbor = nlohmann::json::to_cbor(request);
+  std::string request_body(cbor.begin(), cbor.end());
+  auto framed_request = privacy_sandbox::server_common::EncodeResponsePayload(
+      privacy_sandbox::server_common::CompressionType::kUncompressed,
+      request_body,
+      privacy_sandbox::server_common::GetEncodedDataSize(
+          request_body.size(), kMinResponsePaddingBytes));
+  CHECK_OK(framed_request);
+  return *std::move(framed_request);
+}
+
+// Encrypts the request the way a client does, calls the handler and
+// decrypts its response, so that both the server side framing and the
+// client side costs are part of each round trip.
+void BM_ObliviousGetValues(::benchmark::State& state, int64_t num_partitions,
+                           int64_t value_size) {
+  FixedOutputUdfClient udf_client(value_size);
+  privacy_sandbox::server_common::FakeKeyFetcherManager key_fetcher_manager;
+  GetValuesV2Handler handler(udf_client, key_fetcher_manager);
+  const std::string framed_request = BuildFramedRequest(num_partitions);
+  const std::string public_key = absl::HexStringToBytes(kTestPublicKey);
+  const std::multimap<grpc::string_ref, grpc::string_ref> headers = {
+      {grpc::string_ref(kKVContentTypeHeader.data(),
+                        kKVContentTypeHeader.size()),
+       grpc::string_ref(kContentEncodingCborHeaderValue.data(),
+                        kContentEncodingCborHeaderValue.size())}};
+  int64_t request_bytes = 0;
+  int64_t response_bytes = 0;
+  for (auto _ : state) {
+    auto config = quiche::ObliviousHttpHeaderKeyConfig::Create(
+        kTestKeyId, kKEMParameter, kKDFParameter, kAEADParameter);
+    CHECK_OK(config);
+    auto encrypted_request =
+        quiche::ObliviousHttpRequest::CreateClientObliviousRequest(
+            framed_request, public_key, *std::move(config),
+            kKVOhttpRequestLabel);
+    CHECK_OK(encrypted_request);
+    v2::ObliviousGetValuesRequest request;
+    request.mutable_raw_body()->set_data(
+        encrypted_request->EncapsulateAndSerialize());
+    auto context = std::move(encrypted_request).value().ReleaseContext();
+
+    RequestContextFactory request_context_factory;
+    google::api::HttpBody response;
+    ExecutionMetadata execution_metadata;
+    const grpc::Status status = handler.ObliviousGetValues(
+        request_context_factory, headers, request, &response,
+        execution_metadata);
+    CHECK(status.ok()) << status.error_message();
+
+    auto decrypted_response =
+        quiche::ObliviousHttpResponse::CreateClientObliviousResponse(
+            response.data(), context, kKVOhttpResponseLabel);
+    CHECK_OK(decrypted_response);
+    auto deframed_response =
+        privacy_sandbox::server_common::DecodeRequestPayload(
+            decrypted_response->GetPlaintextData());
+    CHECK_OK(deframed_response);
+    ::benchmark::DoNotOptimize(deframed_response->compressed_data);
+    request_bytes = request.raw_body().data().size();
+    response_bytes = response.data().size();
+  }
+  state.counters[std::string(kRoundTripsPerSec)] =
+      ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
+  state.counters[std::string(kRequestBytes)] = request_bytes;
+  state.counters[std::string(kResponseBytes)] = response_bytes;
+}
+
+void RegisterBenchmarks() {
+  auto partitions = ParseInt64List(absl::GetFlag(FLAGS_partitions));
+  auto value_sizes = ParseInt64List(absl::GetFlag(FLAGS_value_size));
+  for (auto num_partitions : partitions.value()) {
+    for (auto value_size : value_sizes.value()) {
+      ::benchmark::RegisterBenchmark(
+          absl::StrFormat(kObliviousGetValuesFmt, num_partitions, value_size)
+              .c_str(),
+          BM_ObliviousGetValues, num_partitions, value_size);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmark for encrypt, handle and decrypt round trips through
+// GetValuesV2Handler::ObliviousGetValues, with a UDF client that returns a
+// fixed output so that Roma is not part of the measurements. `RequestBytes`
+// and `ResponseBytes` are the sizes of the encrypted request and response.
+// Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:oblivious_get_values_benchmark \
+//    --config=local_instance \
+//    --config=local_platform -- \
+//    --partitions=1,10 --value_size=1000,100000 \
+//    --benchmark_counters_tabular=true --stderrthreshold=0
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  kv_server::ConfigureTelemetryForTools();
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
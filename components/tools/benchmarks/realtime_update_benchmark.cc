@@ -0,0 +1,277 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/data_loading/realtime_update_batcher.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+#include "components/tools/util/configure_telemetry_tools.h"
+#include "components/util/platform_initializer.h"
+#include "public/data_loading/data_loading_generated.h"
+#include "public/data_loading/readers/riegeli_stream_record_reader_factory.h"
+#include "public/data_loading/record_utils.h"
+#include "public/data_loading/writers/delta_record_stream_writer.h"
+#include "src/util/status_macro/status_macros.h"
+
+ABSL_FLAG(int64_t, num_messages, 10'000,
+          "Number of realtime messages sent by all producers in each "
+          "benchmark iteration.");
+ABSL_FLAG(int64_t, records_per_message, 10,
+          "Number of records in each realtime message.");
+ABSL_FLAG(int64_t, record_size, 1024, "Size of each record value.");
+ABSL_FLAG(int64_t, num_keys, 100'000,
+          "Number of distinct keys updated by the realtime messages.");
+ABSL_FLAG(std::vector<std::string>, args_producer_threads,
+          std::vector<std::string>({"1", "4", "16"}),
+          "A list of numbers of producer threads, i.e., realtime notifier "
+          "threads, sending messages concurrently.");
+ABSL_FLAG(int64_t, batch_window_micros, 0,
+          "How long the first message of a batch waits for more messages.");
+ABSL_FLAG(int64_t, max_batch_messages, 64,
+          "Maximum number of messages in a batch.");
+
+using kv_server::Cache;
+using kv_server::DataRecord;
+using kv_server::DataRecordT;
+using kv_server::DeltaRecordStreamWriter;
+using kv_server::DeltaRecordWriter;
+using kv_server::DeserializeRecord;
+using kv_server::KeyValueCache;
+using kv_server::KeyValueMutationBatch;
+using kv_server::KeyValueMutationRecordT;
+using kv_server::KeyValueMutationType;
+using kv_server::MaybeGetRecordValue;
+using kv_server::RealtimeUpdateBatcher;
+using kv_server::Record;
+using kv_server::RiegeliStreamRecordReaderFactory;
+using kv_server::StringValueT;
+using kv_server::benchmark::BenchmarkLogContext;
+using kv_server::benchmark::GenerateRandomString;
+using kv_server::benchmark::ParseInt64List;
+
+namespace {
+
+// Serialized realtime messages, each a riegeli stream of delta records, as
+// produced by the realtime publisher.
+std::vector<std::string>* messages = nullptr;
+
+absl::StatusOr<std::vector<std::string>> GenerateMessages() {
+  std::vector<std::string> result;
+  const std::string value =
+      GenerateRandomString(absl::GetFlag(FLAGS_record_size));
+  const int64_t num_keys = absl::GetFlag(FLAGS_num_keys);
+  int64_t logical_commit_time = 0;
+  for (int64_t i = 0; i < absl::GetFlag(FLAGS_num_messages); ++i) {
+    std::stringstream stream;
+    PS_ASSIGN_OR_RETURN(auto record_writer,
+                        DeltaRecordStreamWriter<>::Create(
+                            stream, DeltaRecordWriter::Options{}));
+    for (int64_t j = 0; j < absl::GetFlag(FLAGS_records_per_message); ++j) {
+      KeyValueMutationRecordT kv_mutation_record = {
+          .mutation_type = KeyValueMutationType::Update,
+          .logical_commit_time = ++logical_commit_time,
+          .key = absl::StrCat("key", logical_commit_time % num_keys),
+      };
+      kv_mutation_record.value.Set(StringValueT{.value = value});
+      DataRecordT data_record;
+      data_record.record.Set(std::move(kv_mutation_record));
+      PS_RETURN_IF_ERROR(record_writer->WriteRecord(data_record));
+    }
+    record_writer->Close();
+    result.push_back(stream.str());
+  }
+  return result;
+}
+
+// Decodes `message` and passes each key-value mutation record to `fn`.
+template <typename Fn>
+absl::Status ReadMessage(std::string_view message, Fn fn) {
+  std::istringstream is{std::string(message)};
+  RiegeliStreamRecordReaderFactory reader_factory;
+  auto record_reader = reader_factory.CreateReader(is);
+  return record_reader->ReadStreamRecords([&fn](std::string_view raw) {
+    return DeserializeRecord(raw, [&fn](const DataRecord& data_record) {
+      if (data_record.record_type() != Record::KeyValueMutationRecord) {
+        return absl::OkStatus();
+      }
+      return fn(*data_record.record_as_KeyValueMutationRecord());
+    });
+  });
+}
+
+// Applies each message on its own, like realtime notifier threads did before
+// updates were batched.
+absl::Status ApplyMessage(std::string_view message, Cache& cache,
+                          BenchmarkLogContext& log_context) {
+  return ReadMessage(message, [&](const auto& record) {
+    PS_ASSIGN_OR_RETURN(auto value,
+                        MaybeGetRecordValue<std::string_view>(record));
+    cache.UpdateKeyValue(log_context, record.key()->string_view(), value,
+                         record.logical_commit_time());
+    return absl::OkStatus();
+  });
+}
+
+// Applies a batch of messages with a single batched cache write, like the
+// data orchestrator does for realtime updates.
+void ApplyBatch(absl::Span<const std::string_view> batch, Cache& cache,
+                BenchmarkLogContext& log_context) {
+  KeyValueMutationBatch string_value_batch;
+  const auto add_record = [&string_value_batch](const auto& record) {
+    PS_ASSIGN_OR_RETURN(auto value,
+                        MaybeGetRecordValue<std::string_view>(record));
+    string_value_batch.Add(record.key()->string_view(), value,
+                           record.logical_commit_time(),
+                           /*is_deletion=*/false);
+    return absl::OkStatus();
+  };
+  for (const auto message : batch) {
+    if (const auto status = ReadMessage(message, add_record); !status.ok()) {
+      LOG(ERROR) << "Failed to apply message: " << status;
+    }
+  }
+  string_value_batch.ApplyTo(cache, log_context);
+}
+
+double Percentile(const std::vector<double>& sorted_values, double p) {
+  if (sorted_values.empty()) {
+    return 0;
+  }
+  return sorted_values[static_cast<size_t>(p * (sorted_values.size() - 1))];
+}
+
+// Producer threads, standing in for realtime notifier threads, split the
+// messages between them and record how long each message blocks its producer:
+// until it is applied on its own, or, when batched, until it is queued or the
+// producer is done applying batches. All messages are applied once the
+// producers are joined.
+void BM_ApplyRealtimeUpdates(benchmark::State& state, bool batched) {
+  const int64_t num_producers = state.range(0);
+  BenchmarkLogContext log_context;
+  std::vector<double> latencies_us;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto cache = KeyValueCache::Create();
+    RealtimeUpdateBatcher batcher(
+        {
+            .batch_window =
+                absl::Microseconds(absl::GetFlag(FLAGS_batch_window_micros)),
+            .max_batch_messages = absl::GetFlag(FLAGS_max_batch_messages),
+        },
+        [&cache, &log_context](absl::Span<const std::string_view> batch) {
+          ApplyBatch(batch, *cache, log_context);
+        });
+    absl::Mutex mu;
+    state.ResumeTiming();
+    std::vector<std::thread> producers;
+    for (int64_t p = 0; p < num_producers; ++p) {
+      producers.emplace_back([&, p] {
+        std::vector<double> producer_latencies_us;
+        for (size_t i = p; i < messages->size(); i += num_producers) {
+          const absl::Time start = absl::Now();
+          if (batched) {
+            batcher.Apply((*messages)[i]);
+          } else if (const auto status =
+                         ApplyMessage((*messages)[i], *cache, log_context);
+                     !status.ok()) {
+            LOG(ERROR) << "Failed to apply message: " << status;
+          }
+          producer_latencies_us.push_back(
+              absl::ToDoubleMicroseconds(absl::Now() - start));
+        }
+        absl::MutexLock lock(&mu);
+        latencies_us.insert(latencies_us.end(), producer_latencies_us.begin(),
+                            producer_latencies_us.end());
+      });
+    }
+    for (auto& producer : producers) {
+      producer.join();
+    }
+    state.PauseTiming();
+    cache.reset();
+    state.ResumeTiming();
+  }
+  std::sort(latencies_us.begin(), latencies_us.end());
+  state.counters["updates_per_sec"] = benchmark::Counter(
+      state.iterations() * messages->size() *
+          absl::GetFlag(FLAGS_records_per_message),
+      benchmark::Counter::kIsRate);
+  state.counters["p50_latency_us"] = Percentile(latencies_us, 0.5);
+  state.counters["p90_latency_us"] = Percentile(latencies_us, 0.9);
+  state.counters["p99_latency_us"] = Percentile(latencies_us, 0.99);
+}
+
+void RegisterBenchmarks() {
+  auto producer_threads =
+      ParseInt64List(absl::GetFlag(FLAGS_args_producer_threads));
+  for (const bool batched : {false, true}) {
+    auto* b = benchmark::RegisterBenchmark(
+        batched ? "BM_ApplyRealtimeUpdates/batched"
+                : "BM_ApplyRealtimeUpdates/unbatched",
+        BM_ApplyRealtimeUpdates, batched);
+    for (auto num_producers : producer_threads.value()) {
+      b->Arg(num_producers);
+    }
+    b->ArgName("producers")->UseRealTime()->Unit(benchmark::kMillisecond);
+  }
+}
+
+}  // namespace
+
+// Sample run:
+//
+// bazel run -c opt \
+//  components/tools/benchmarks:realtime_update_benchmark \
+//    --config=local_instance --config=local_platform -- \
+//    --num_messages=10000 \
+//    --records_per_message=10 \
+//    --args_producer_threads=1,4,16 \
+//    --batch_window_micros=0 \
+//    --max_batch_messages=64
+int main(int argc, char** argv) {
+  ::kv_server::PlatformInitializer platform_initializer;
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  kv_server::ConfigureTelemetryForTools();
+  auto generated_messages = GenerateMessages();
+  if (!generated_messages.ok()) {
+    LOG(ERROR) << "Failed to generate messages. "
+               << generated_messages.status();
+    return -1;
+  }
+  messages = &*generated_messages;
+  RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,330 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "benchmark/benchmark.h"
+#include "components/tools/util/configure_telemetry_tools.h"
+#include "components/util/platform_initializer.h"
+#include "public/data_loading/readers/riegeli_stream_record_reader_factory.h"
+#include "public/data_loading/record_utils.h"
+#include "public/data_loading/writers/delta_record_stream_writer.h"
+#include "public/data_loading/writers/record_compression.h"
+#include "src/util/status_macro/status_macros.h"
+#include "zdict.h"
+#include "zstd.h"
+
+ABSL_FLAG(int64_t, num_records, 1'000'000, "Number of records to write.");
+ABSL_FLAG(int64_t, record_size, 128, "Approximate size of each value.");
+ABSL_FLAG(std::vector<std::string>, compressions,
+          std::vector<std::string>({"none", "snappy", "brotli:6", "zstd:1",
+                                    "zstd:3", "zstd:9"}),
+          "Compressions to benchmark, formatted as <algorithm>[:<level>]. "
+          "Each zstd compression is also benchmarked on single records, with "
+          "and without a trained dictionary.");
+ABSL_FLAG(int64_t, dictionary_size, 16 * 1024,
+          "Maximum size of trained zstd dictionaries.");
+ABSL_FLAG(int64_t, dictionary_samples, 10'000,
+          "Number of records to train zstd dictionaries on.");
+
+using kv_server::DataRecord;
+using kv_server::DataRecordT;
+using kv_server::DeltaRecordStreamWriter;
+using kv_server::DeltaRecordWriter;
+using kv_server::DeserializeRecord;
+using kv_server::KeyValueMutationRecordT;
+using kv_server::KeyValueMutationType;
+using kv_server::ParseRecordCompression;
+using kv_server::Record;
+using kv_server::RecordCompression;
+using kv_server::RiegeliStreamRecordReaderFactory;
+using kv_server::StringValueT;
+
+namespace {
+
+constexpr std::string_view kFileBytes = "FileBytes";
+constexpr std::string_view kCompressionRatio = "CompressionRatio";
+constexpr std::string_view kDecodedBytesPerSec = "DecodedBytes/s";
+
+// Serialized records decoded by each benchmark iteration.
+std::vector<std::string>* records = nullptr;
+int64_t records_bytes = 0;
+
+// Returns a value that looks like the small JSON values of typical datasets,
+// i.e., mostly the same field names and a few distinct field values.
+std::string GenerateValue(uint* seed) {
+  static constexpr std::string_view kWords[] = {
+      "render", "url", "https://ads.example.com/", "creative", "campaign",
+      "size", "300x250", "priority", "bidding", "signals", "seller"};
+  std::string value = absl::StrFormat(
+      R"({"campaign":"c%d","priority":%d,"ads":[)", rand_r(seed) % 1000,
+      rand_r(seed) % 10);
+  const int64_t record_size = absl::GetFlag(FLAGS_record_size);
+  while (static_cast<int64_t>(value.size()) < record_size) {
+    absl::StrAppend(&value, R"({"w":")",
+                    kWords[rand_r(seed) % std::size(kWords)],
+                    rand_r(seed) % 100, R"("},)");
+  }
+  value.back() = ']';
+  value.push_back('}');
+  return value;
+}
+
+std::vector<std::string> GenerateRecords() {
+  std::vector<std::string> result;
+  result.reserve(absl::GetFlag(FLAGS_num_records));
+  uint seed = 42;
+  for (int64_t i = 0; i < absl::GetFlag(FLAGS_num_records); ++i) {
+    KeyValueMutationRecordT kv_mutation_record = {
+        .mutation_type = KeyValueMutationType::Update,
+        .logical_commit_time = i + 1,
+        .key = absl::StrCat("key", i),
+    };
+    kv_mutation_record.value.Set(StringValueT{.value = GenerateValue(&seed)});
+    DataRecordT data_record;
+    data_record.record.Set(std::move(kv_mutation_record));
+    auto [fbs_buffer, serialized_record] = Serialize(data_record);
+    result.emplace_back(serialized_record);
+  }
+  return result;
+}
+
+absl::StatusOr<std::string> WriteRiegeliFile(
+    const RecordCompression& compression) {
+  std::stringstream stream;
+  PS_ASSIGN_OR_RETURN(auto record_writer,
+                      DeltaRecordStreamWriter<>::Create(
+                          stream, DeltaRecordWriter::Options{
+                                      .enable_compression = true,
+                                      .compression = compression,
+                                  }));
+  for (const auto& record : *records) {
+    PS_RETURN_IF_ERROR(DeserializeRecord(
+        record, [&record_writer](const DataRecordT& data_record) {
+          return record_writer->WriteRecord(data_record);
+        }));
+  }
+  record_writer->Close();
+  PS_RETURN_IF_ERROR(record_writer->Status());
+  return stream.str();
+}
+
+// Deserializes `record` and counts it in `num_records` if it is a key value
+// mutation record.
+absl::Status ReadRecord(std::string_view record, int64_t& num_records) {
+  return DeserializeRecord(record, [&num_records](const DataRecord& record) {
+    num_records += record.record_type() == Record::KeyValueMutationRecord;
+    return absl::OkStatus();
+  });
+}
+
+void ReportSizes(benchmark::State& state, int64_t file_bytes,
+                 int64_t num_records) {
+  if (num_records !=
+      state.iterations() * static_cast<int64_t>(records->size())) {
+    state.SkipWithError("Failed to read all records.");
+    return;
+  }
+  state.counters[std::string(kFileBytes)] = file_bytes;
+  state.counters[std::string(kCompressionRatio)] =
+      static_cast<double>(records_bytes) / file_bytes;
+  state.counters[std::string(kDecodedBytesPerSec)] = benchmark::Counter(
+      state.iterations() * records_bytes, benchmark::Counter::kIsRate);
+}
+
+// Reads a riegeli file written with `compression`, like the server does when
+// loading data files. Riegeli compresses chunks of many records at once.
+void BM_ReadRiegeliFile(benchmark::State& state,
+                        RecordCompression compression) {
+  auto file = WriteRiegeliFile(compression);
+  if (!file.ok()) {
+    state.SkipWithError(file.status().ToString().c_str());
+    return;
+  }
+  RiegeliStreamRecordReaderFactory reader_factory;
+  int64_t num_records = 0;
+  for (auto _ : state) {
+    std::istringstream stream(*file);
+    auto record_reader = reader_factory.CreateReader(stream);
+    auto status = record_reader->ReadStreamRecords(
+        [&num_records](std::string_view record) {
+          return ReadRecord(record, num_records);
+        });
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString().c_str());
+      return;
+    }
+  }
+  ReportSizes(state, file->size(), num_records);
+}
+
+absl::StatusOr<std::string> TrainZstdDictionary() {
+  std::string samples;
+  std::vector<size_t> sample_sizes;
+  for (int64_t i = 0;
+       i < std::min<int64_t>(records->size(),
+                             absl::GetFlag(FLAGS_dictionary_samples));
+       ++i) {
+    samples.append((*records)[i]);
+    sample_sizes.push_back((*records)[i].size());
+  }
+  std::string dictionary(absl::GetFlag(FLAGS_dictionary_size), '\0');
+  const size_t dictionary_size = ZDICT_trainFromBuffer(
+      dictionary.data(), dictionary.size(), samples.data(),
+      sample_sizes.data(), sample_sizes.size());
+  if (ZDICT_isError(dictionary_size)) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to train dictionary: ", ZDICT_getErrorName(dictionary_size)));
+  }
+  dictionary.resize(dictionary_size);
+  return dictionary;
+}
+
+// Compresses and decompresses each record on its own with zstd, which is how
+// small records would have to be stored to be decoded individually, e.g., in
+// sorted snapshots. A dictionary trained on sample records makes up for the
+// redundancy between records that per-record compression cannot exploit.
+//
+// Riegeli readers cannot be configured with a dictionary, so dictionaries are
+// not a `RecordCompression` option of data files.
+void BM_ReadZstdRecords(benchmark::State& state, int level,
+                        bool use_dictionary) {
+  std::string dictionary;
+  if (use_dictionary) {
+    auto trained_dictionary = TrainZstdDictionary();
+    if (!trained_dictionary.ok()) {
+      state.SkipWithError(trained_dictionary.status().ToString().c_str());
+      return;
+    }
+    dictionary = *std::move(trained_dictionary);
+  }
+  std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx(ZSTD_createCCtx(),
+                                                            ZSTD_freeCCtx);
+  std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(ZSTD_createDCtx(),
+                                                            ZSTD_freeDCtx);
+  std::unique_ptr<ZSTD_CDict, decltype(&ZSTD_freeCDict)> cdict(
+      ZSTD_createCDict(dictionary.data(), dictionary.size(), level),
+      ZSTD_freeCDict);
+  std::unique_ptr<ZSTD_DDict, decltype(&ZSTD_freeDDict)> ddict(
+      ZSTD_createDDict(dictionary.data(), dictionary.size()), ZSTD_freeDDict);
+  std::vector<std::string> compressed_records;
+  compressed_records.reserve(records->size());
+  int64_t file_bytes = dictionary.size();
+  for (const auto& record : *records) {
+    std::string compressed(ZSTD_compressBound(record.size()), '\0');
+    const size_t compressed_size = ZSTD_compress_usingCDict(
+        cctx.get(), compressed.data(), compressed.size(), record.data(),
+        record.size(), cdict.get());
+    if (ZSTD_isError(compressed_size)) {
+      state.SkipWithError(ZSTD_getErrorName(compressed_size));
+      return;
+    }
+    compressed.resize(compressed_size);
+    file_bytes += compressed_size;
+    compressed_records.push_back(std::move(compressed));
+  }
+  std::string record;
+  int64_t num_records = 0;
+  for (auto _ : state) {
+    for (const auto& compressed : compressed_records) {
+      record.resize(ZSTD_getFrameContentSize(compressed.data(),
+                                             compressed.size()));
+      const size_t record_size = ZSTD_decompress_usingDDict(
+          dctx.get(), record.data(), record.size(), compressed.data(),
+          compressed.size(), ddict.get());
+      if (ZSTD_isError(record_size)) {
+        state.SkipWithError(ZSTD_getErrorName(record_size));
+        return;
+      }
+      if (auto status = ReadRecord(record, num_records); !status.ok()) {
+        state.SkipWithError(status.ToString().c_str());
+        return;
+      }
+    }
+  }
+  ReportSizes(state, file_bytes, num_records);
+}
+
+absl::Status RegisterBenchmarks() {
+  for (const auto& text : absl::GetFlag(FLAGS_compressions)) {
+    PS_ASSIGN_OR_RETURN(auto compression, ParseRecordCompression(text));
+    benchmark::RegisterBenchmark(
+        absl::StrCat("BM_ReadRiegeliFile/", text).c_str(), BM_ReadRiegeliFile,
+        compression)
+        ->Unit(benchmark::kMillisecond);
+    if (compression.algorithm != RecordCompression::Algorithm::kZstd) {
+      continue;
+    }
+    const int level = compression.level.value_or(ZSTD_CLEVEL_DEFAULT);
+    for (const bool use_dictionary : {false, true}) {
+      benchmark::RegisterBenchmark(
+          absl::StrCat("BM_ReadZstdRecords/", text,
+                       use_dictionary ? "/dictionary" : "/no_dictionary")
+              .c_str(),
+          BM_ReadZstdRecords, level, use_dictionary)
+          ->Unit(benchmark::kMillisecond);
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+// Sample run:
+//
+// bazel run -c opt \
+//  components/tools/benchmarks:record_compression_benchmark \
+//    --config=local_instance --config=local_platform -- \
+//    --num_records=1000000 \
+//    --record_size=128 \
+//    --compressions=none,snappy,brotli:6,zstd:1,zstd:3,zstd:9
+//
+// `FileBytes` and `CompressionRatio` compare the size of the written data,
+// `DecodedBytes/s` the throughput of decompressing and deserializing records.
+int main(int argc, char** argv) {
+  ::kv_server::PlatformInitializer platform_initializer;
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  kv_server::ConfigureTelemetryForTools();
+  auto generated_records = GenerateRecords();
+  records = &generated_records;
+  for (const auto& record : generated_records) {
+    records_bytes += record.size();
+  }
+  if (auto status = RegisterBenchmarks(); !status.ok()) {
+    LOG(ERROR) << "Failed to register benchmarks. " << status;
+    return -1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "benchmark/benchmark.h"
+#include "components/internal_server/lookup.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+#include "components/tools/util/configure_telemetry_tools.h"
+#include "components/udf/hooks/run_query_hook.h"
+#include "components/util/request_context.h"
+
+ABSL_FLAG(std::vector<std::string>, result_size,
+          std::vector<std::string>({"1000", "100000"}),
+          "Numbers of elements in each query result.");
+ABSL_FLAG(int64_t, range_min, 1000000,
+          "Smallest element of the query results.");
+
+namespace kv_server {
+namespace {
+
+using google::scp::roma::FunctionBindingPayload;
+using google::scp::roma::proto::FunctionBindingIoProto;
+using kv_server::benchmark::ParseInt64List;
+
+// Format variables used to generate benchmark names.
+//
+// => rz - number of elements in the query result.
+constexpr std::string_view kRunQueryFmt = "BM_RunQueryHook/rz:%d";
+constexpr std::string_view kRunSetQueryUInt32Fmt =
+    "BM_RunSetQueryUInt32Hook/rz:%d";
+constexpr std::string_view kRunSetQueryUInt64Fmt =
+    "BM_RunSetQueryUInt64Hook/rz:%d";
+
+constexpr std::string_view kCallsPerSec = "Calls/s";
+constexpr std::string_view kOutputBytes = "OutputBytes";
+
+constexpr std::string_view kQuery = "A & B";
+
+// Returns the same results for every query, so that the benchmark measures
+// the work done by the hooks themselves.
+class FixedLookup : public Lookup {
+ public:
+  explicit FixedLookup(int64_t result_size) {
+    const int64_t range_min = absl::GetFlag(FLAGS_range_min);
+    for (int64_t i = 0; i < result_size; ++i) {
+      // Sets are sparse enough for strings and integers to be worth
+      // comparing.
+      const int64_t element = range_min + 2 * i;
+      string_response_.add_elements(absl::StrCat(element));
+      uint32_response_.add_elements(element);
+      uint64_response_.add_elements(element);
+    }
+  }
+
+  absl::StatusOr<InternalLookupResponse> GetKeyValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys) const override {
+    return absl::UnimplementedError("Not used by the benchmark");
+  }
+
+  absl::StatusOr<InternalLookupResponse> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override {
+    return absl::UnimplementedError("Not used by the benchmark");
+  }
+
+  absl::StatusOr<InternalLookupResponse> GetUInt32ValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override {
+    return absl::UnimplementedError("Not used by the benchmark");
+  }
+
+  absl::StatusOr<InternalLookupResponse> GetUInt64ValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override {
+    return absl::UnimplementedError("Not used by the benchmark");
+  }
+
+  absl::StatusOr<InternalRunQueryResponse> RunQuery(
+      const RequestContext& request_context, std::string query) const override {
+    return string_response_;
+  }
+
+  absl::StatusOr<InternalRunSetQueryUInt32Response> RunSetQueryUInt32(
+      const RequestContext& request_context, std::string query) const override {
+    return uint32_response_;
+  }
+
+  absl::StatusOr<InternalRunSetQueryUInt64Response> RunSetQueryUInt64(
+      const RequestContext& request_context, std::string query) const override {
+    return uint64_response_;
+  }
+
+ private:
+  InternalRunQueryResponse string_response_;
+  InternalRunSetQueryUInt32Response uint32_response_;
+  InternalRunSetQueryUInt64Response uint64_response_;
+};
+
+// Calls the hook the way V8 does, i.e., with the query as a string. Each call
+// is the first of its request, so that its result is not memoized.
+template <typename HookType>
+void BM_RunSetQueryHook(::benchmark::State& state, int64_t result_size) {
+  auto hook = HookType::Create();
+  hook->FinishInit(std::make_unique<FixedLookup>(result_size));
+  FunctionBindingIoProto input;
+  input.set_input_string(std::string(kQuery));
+  int64_t output_bytes = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto request_context = std::make_shared<RequestContext>();
+    state.ResumeTiming();
+    FunctionBindingIoProto io = input;
+    FunctionBindingPayload<std::weak_ptr<RequestContext>> payload{
+        io, request_context};
+    (*hook)(payload);
+    ::benchmark::DoNotOptimize(io);
+    // Strings are passed to V8 one by one, integers as a single buffer.
+    output_bytes = io.output_bytes().size();
+    for (const auto& element : io.output_list_of_string().data()) {
+      output_bytes += element.size();
+    }
+  }
+  state.counters[std::string(kCallsPerSec)] =
+      ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
+  state.counters[std::string(kOutputBytes)] = output_bytes;
+}
+
+void RegisterBenchmarks() {
+  auto result_sizes = ParseInt64List(absl::GetFlag(FLAGS_result_size));
+  for (auto result_size : result_sizes.value()) {
+    ::benchmark::RegisterBenchmark(
+        absl::StrFormat(kRunQueryFmt, result_size).c_str(),
+        BM_RunSetQueryHook<RunSetQueryStringHook>, result_size);
+    ::benchmark::RegisterBenchmark(
+        absl::StrFormat(kRunSetQueryUInt32Fmt, result_size).c_str(),
+        BM_RunSetQueryHook<RunSetQueryUInt32Hook>, result_size);
+    ::benchmark::RegisterBenchmark(
+        absl::StrFormat(kRunSetQueryUInt64Fmt, result_size).c_str(),
+        BM_RunSetQueryHook<RunSetQueryUInt64Hook>, result_size);
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks for the runQuery, runSetQueryUInt32 and runSetQueryUInt64
+// UDF hooks, called directly rather than from a UDF, so that V8 is not part
+// of the measurements. `OutputBytes` is the size of the result handed to V8,
+// a list of decimal strings for runQuery and a packed array of integers that
+// UDFs read as a typed array for the others. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:run_query_hook_benchmark \
+//    --config=local_instance \
+//    --config=local_platform -- \
+//    --result_size=1000,100000 --range_min=1000000 \
+//    --benchmark_counters_tabular=true --stderrthreshold=0
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  kv_server::ConfigureTelemetryForTools();
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
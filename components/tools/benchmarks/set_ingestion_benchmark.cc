@@ -0,0 +1,245 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+#include "components/tools/util/configure_telemetry_tools.h"
+#include "public/data_loading/data_loading_generated.h"
+#include "public/data_loading/record_utils.h"
+#include "src/util/status_macro/status_macros.h"
+
+ABSL_FLAG(int64_t, num_records, 10'000,
+          "Number of set delta records applied in each benchmark iteration.");
+ABSL_FLAG(std::vector<std::string>, set_sizes,
+          std::vector<std::string>({"10", "100", "1000"}),
+          "Number of elements in each set record.");
+ABSL_FLAG(int64_t, element_size, 16,
+          "Size of each element of string set records.");
+
+namespace {
+
+// Number of heap allocations done by the process. Used to compute the number
+// of allocations needed to apply each record.
+std::atomic<int64_t> num_allocations{0};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace kv_server {
+namespace {
+
+using kv_server::benchmark::BenchmarkLogContext;
+using kv_server::benchmark::GenerateRandomString;
+using kv_server::benchmark::ParseInt64List;
+
+constexpr std::string_view kCopiedValuesFmt =
+    "BM_ApplySetRecords_CopiedValues/%s/sz:%d";
+constexpr std::string_view kFlatbufferViewsFmt =
+    "BM_ApplySetRecords_FlatbufferViews/%s/sz:%d";
+constexpr std::string_view kAllocationsPerRecord = "Allocs/record";
+
+enum class SetType { kString, kUInt32 };
+
+struct BenchmarkArgs {
+  SetType set_type;
+  int64_t set_size;
+  bool use_flatbuffer_views;
+};
+
+// Serializes `num_records` delta records, each updating a set with `set_size`
+// elements.
+std::vector<flatbuffers::FlatBufferBuilder> GenerateSetRecords(
+    SetType set_type, int64_t num_records, int64_t set_size) {
+  std::vector<flatbuffers::FlatBufferBuilder> records;
+  records.reserve(num_records);
+  for (int64_t i = 0; i < num_records; i++) {
+    KeyValueMutationRecordT kv_mutation_record = {
+        .mutation_type = KeyValueMutationType::Update,
+        .logical_commit_time = i + 1,
+        .key = absl::StrCat("set", i),
+    };
+    if (set_type == SetType::kString) {
+      StringSetT string_set;
+      for (int64_t j = 0; j < set_size; j++) {
+        string_set.value.push_back(absl::StrCat(
+            j, GenerateRandomString(absl::GetFlag(FLAGS_element_size))));
+      }
+      kv_mutation_record.value.Set(std::move(string_set));
+    } else {
+      UInt32SetT uint32_set;
+      for (int64_t j = 0; j < set_size; j++) {
+        uint32_set.value.push_back(static_cast<uint32_t>(j));
+      }
+      kv_mutation_record.value.Set(std::move(uint32_set));
+    }
+    DataRecordT data_record;
+    data_record.record.Set(std::move(kv_mutation_record));
+    records.push_back(FlatBufferObjectFromStruct(data_record));
+  }
+  return records;
+}
+
+absl::Status ApplyCopiedValues(BenchmarkLogContext& log_context,
+                               const KeyValueMutationRecord& record,
+                               Cache& cache) {
+  if (record.value_type() == Value::StringSet) {
+    PS_ASSIGN_OR_RETURN(
+        auto values,
+        MaybeGetRecordValue<std::vector<std::string_view>>(record));
+    cache.UpdateKeyValueSet(log_context, record.key()->string_view(),
+                            absl::MakeSpan(values),
+                            record.logical_commit_time());
+    return absl::OkStatus();
+  }
+  PS_ASSIGN_OR_RETURN(auto values,
+                      MaybeGetRecordValue<std::vector<uint32_t>>(record));
+  cache.UpdateKeyValueSet(log_context, record.key()->string_view(),
+                          absl::MakeSpan(values), record.logical_commit_time());
+  return absl::OkStatus();
+}
+
+absl::Status ApplyFlatbufferViews(BenchmarkLogContext& log_context,
+                                  const KeyValueMutationRecord& record,
+                                  Cache& cache) {
+  if (record.value_type() == Value::StringSet) {
+    PS_ASSIGN_OR_RETURN(
+        const auto* values,
+        MaybeGetRecordValue<const FlatbufferStringVector*>(record));
+    cache.UpdateKeyValueSet(log_context, record.key()->string_view(), *values,
+                            record.logical_commit_time());
+    return absl::OkStatus();
+  }
+  PS_ASSIGN_OR_RETURN(
+      const auto* values,
+      MaybeGetRecordValue<const flatbuffers::Vector<uint32_t>*>(record));
+  cache.UpdateKeyValueSet(log_context, record.key()->string_view(), *values,
+                          record.logical_commit_time());
+  return absl::OkStatus();
+}
+
+void BM_ApplySetRecords(::benchmark::State& state, BenchmarkArgs args) {
+  const auto records =
+      GenerateSetRecords(args.set_type, absl::GetFlag(FLAGS_num_records),
+                         args.set_size);
+  BenchmarkLogContext log_context;
+  int64_t total_allocations = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto cache = KeyValueCache::Create();
+    state.ResumeTiming();
+    const int64_t allocations_before = num_allocations.load();
+    for (const auto& record : records) {
+      auto status = DeserializeRecord(
+          ToStringView(record),
+          [&args, &log_context, &cache](const DataRecord& data_record) {
+            const auto* kv_record =
+                data_record.record_as_KeyValueMutationRecord();
+            return args.use_flatbuffer_views
+                       ? ApplyFlatbufferViews(log_context, *kv_record, *cache)
+                       : ApplyCopiedValues(log_context, *kv_record, *cache);
+          });
+      ::benchmark::DoNotOptimize(status);
+    }
+    total_allocations += num_allocations.load() - allocations_before;
+    state.PauseTiming();
+    cache.reset();
+    state.ResumeTiming();
+  }
+  const int64_t total_records = state.iterations() * records.size();
+  state.SetItemsProcessed(total_records);
+  state.counters[std::string(kAllocationsPerRecord)] =
+      ::benchmark::Counter(static_cast<double>(total_allocations) /
+                           static_cast<double>(total_records));
+}
+
+void RegisterBenchmarks() {
+  auto set_sizes = ParseInt64List(absl::GetFlag(FLAGS_set_sizes));
+  if (!set_sizes.ok()) {
+    LOG(ERROR) << "Failed to parse '--set_sizes'. " << set_sizes.status();
+    return;
+  }
+  for (auto set_type : {SetType::kString, SetType::kUInt32}) {
+    std::string_view set_type_name =
+        set_type == SetType::kString ? "string_set" : "uint32_set";
+    for (int64_t set_size : *set_sizes) {
+      for (bool use_flatbuffer_views : {false, true}) {
+        auto name = absl::StrFormat(
+            use_flatbuffer_views ? kFlatbufferViewsFmt : kCopiedValuesFmt,
+            set_type_name, set_size);
+        ::benchmark::RegisterBenchmark(
+            name.c_str(), BM_ApplySetRecords,
+            BenchmarkArgs{
+                .set_type = set_type,
+                .set_size = set_size,
+                .use_flatbuffer_views = use_flatbuffer_views,
+            })
+            ->MeasureProcessCPUTime()
+            ->UseRealTime();
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Compares applying set-heavy delta records to the cache with values copied
+// into intermediate vectors vs. passed as flatbuffer views. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:set_ingestion_benchmark \
+//    --config=local_instance \
+//    --config=local_platform -- \
+//    --benchmark_counters_tabular=true \
+//    --num_records=10000 \
+//    --set_sizes=10,100,1000
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  kv_server::ConfigureTelemetryForTools();
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
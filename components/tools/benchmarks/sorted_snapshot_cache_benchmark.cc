@@ -0,0 +1,224 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/cache/sorted_snapshot_cache.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+#include "components/tools/util/configure_telemetry_tools.h"
+#include "components/util/request_context.h"
+#include "public/data_loading/record_utils.h"
+#include "public/data_loading/sorted_snapshot_format.h"
+#include "public/data_loading/writers/sorted_snapshot_writer.h"
+#include "src/util/status_macro/status_macros.h"
+
+ABSL_FLAG(std::string, data_directory, "",
+          "Local directory to store the benchmark sorted snapshot in.");
+ABSL_FLAG(std::string, cache_type, "sorted_snapshot",
+          "Cache to benchmark, either 'key_value' or 'sorted_snapshot'. Only "
+          "one cache is created per run, so that the reported resident memory "
+          "belongs to that cache.");
+ABSL_FLAG(int64_t, num_records, 1'000'000, "Number of records in the cache.");
+ABSL_FLAG(int64_t, record_size, 1024, "Size of each value in the cache.");
+ABSL_FLAG(int64_t, block_size, 4096,
+          "Approximate size of each block of the sorted snapshot.");
+
+namespace kv_server {
+namespace {
+
+using kv_server::benchmark::BenchmarkLogContext;
+using kv_server::benchmark::GenerateRandomString;
+
+// Number of distinct queries cycled through by each benchmark.
+constexpr int64_t kNumQueries = 4096;
+constexpr std::string_view kReadsPerSec = "Reads/s";
+constexpr std::string_view kResidentBytes = "ResidentBytes";
+
+std::filesystem::path SortedSnapshotPath() {
+  return std::filesystem::path(absl::GetFlag(FLAGS_data_directory)) /
+         "sorted_snapshot";
+}
+
+std::string GetKey(int64_t i) { return absl::StrCat("key", i); }
+
+// Returns the resident set size of this process, including mapped file pages.
+int64_t GetResidentBytes() {
+  std::ifstream statm("/proc/self/statm");
+  int64_t total_pages = 0;
+  int64_t resident_pages = 0;
+  statm >> total_pages >> resident_pages;
+  return resident_pages * sysconf(_SC_PAGESIZE);
+}
+
+absl::Status WriteSortedSnapshot(const std::string& value) {
+  std::vector<std::string> keys;
+  keys.reserve(absl::GetFlag(FLAGS_num_records));
+  for (int64_t i = 0; i < absl::GetFlag(FLAGS_num_records); ++i) {
+    keys.push_back(GetKey(i));
+  }
+  std::sort(keys.begin(), keys.end(),
+            [](const std::string& left, const std::string& right) {
+              return std::make_pair(SortedSnapshotKeyFingerprint(left), left) <
+                     std::make_pair(SortedSnapshotKeyFingerprint(right), right);
+            });
+  std::ofstream stream(SortedSnapshotPath(), std::ios::binary);
+  PS_ASSIGN_OR_RETURN(
+      auto writer,
+      SortedSnapshotWriter::Create(
+          stream, DeltaRecordWriter::Options{},
+          {.block_size_bytes = absl::GetFlag(FLAGS_block_size)}));
+  for (auto& key : keys) {
+    KeyValueMutationRecordT record = {
+        .mutation_type = KeyValueMutationType::Update,
+        .logical_commit_time = 1,
+        .key = std::move(key),
+    };
+    record.value.Set(StringValueT{.value = value});
+    DataRecordT data_record;
+    data_record.record.Set(std::move(record));
+    PS_RETURN_IF_ERROR(writer->WriteRecord(data_record));
+  }
+  writer->Close();
+  return writer->Status();
+}
+
+// Resident memory of the process before the cache was created.
+int64_t& BaselineResidentBytes() {
+  static int64_t baseline_resident_bytes = 0;
+  return baseline_resident_bytes;
+}
+
+Cache*& GetCache() {
+  static Cache* cache = nullptr;
+  return cache;
+}
+
+absl::Status CreateCache() {
+  const std::string value =
+      GenerateRandomString(absl::GetFlag(FLAGS_record_size));
+  if (absl::GetFlag(FLAGS_cache_type) == "sorted_snapshot") {
+    PS_RETURN_IF_ERROR(WriteSortedSnapshot(value));
+    BaselineResidentBytes() = GetResidentBytes();
+    PS_ASSIGN_OR_RETURN(
+        auto cache, SortedSnapshotCache::Create(SortedSnapshotPath().string()));
+    GetCache() = cache.release();
+    return absl::OkStatus();
+  }
+  if (absl::GetFlag(FLAGS_cache_type) == "key_value") {
+    BaselineResidentBytes() = GetResidentBytes();
+    BenchmarkLogContext log_context;
+    auto cache = KeyValueCache::Create();
+    for (int64_t i = 0; i < absl::GetFlag(FLAGS_num_records); ++i) {
+      cache->UpdateKeyValue(log_context, GetKey(i), value, 1);
+    }
+    GetCache() = cache.release();
+    return absl::OkStatus();
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("Unknown cache type: ", absl::GetFlag(FLAGS_cache_type)));
+}
+
+// Looks up `state.range(0)` random keys per iteration, which are all in the
+// cache if `hit` is set, and none otherwise.
+void BM_GetKeyValuePairs(::benchmark::State& state, bool hit) {
+  std::vector<std::vector<std::string>> queries(kNumQueries);
+  uint seed = 42;
+  for (auto& query : queries) {
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      const int64_t key_index =
+          rand_r(&seed) % absl::GetFlag(FLAGS_num_records);
+      query.push_back(hit ? GetKey(key_index)
+                          : absl::StrCat("missing", key_index));
+    }
+  }
+  std::vector<absl::flat_hash_set<std::string_view>> query_views;
+  for (const auto& query : queries) {
+    query_views.emplace_back(query.begin(), query.end());
+  }
+  RequestContext request_context;
+  int64_t next_query = 0;
+  for (auto _ : state) {
+    ::benchmark::DoNotOptimize(GetCache()->GetKeyValuePairs(
+        request_context, query_views[next_query++ % kNumQueries]));
+  }
+  state.counters[std::string(kReadsPerSec)] = ::benchmark::Counter(
+      state.iterations() * state.range(0), ::benchmark::Counter::kIsRate);
+  state.counters[std::string(kResidentBytes)] =
+      GetResidentBytes() - BaselineResidentBytes();
+}
+
+BENCHMARK_CAPTURE(BM_GetKeyValuePairs, hit, true)
+    ->Arg(1)
+    ->Arg(100)
+    ->Unit(::benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_GetKeyValuePairs, miss, false)
+    ->Arg(1)
+    ->Arg(100)
+    ->Unit(::benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace kv_server
+
+// Sample run:
+//
+// bazel run -c opt \
+//  components/tools/benchmarks:sorted_snapshot_cache_benchmark \
+//    --config=local_instance --config=local_platform -- \
+//    --data_directory=/tmp/sorted_snapshot_benchmark \
+//    --cache_type=sorted_snapshot \
+//    --num_records=1000000 \
+//    --record_size=1024
+//
+// Compare with `--cache_type=key_value`. `ResidentBytes` is the resident
+// memory of the process after the benchmark, minus the resident memory before
+// the cache was created.
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  if (absl::GetFlag(FLAGS_data_directory).empty()) {
+    LOG(ERROR) << "Flag '--data_directory' must be set.";
+    return -1;
+  }
+  kv_server::ConfigureTelemetryForTools();
+  std::filesystem::create_directories(absl::GetFlag(FLAGS_data_directory));
+  if (auto status = kv_server::CreateCache(); !status.ok()) {
+    LOG(ERROR) << "Failed to create cache. " << status;
+    return -1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  std::filesystem::remove(kv_server::SortedSnapshotPath());
+  return 0;
+}
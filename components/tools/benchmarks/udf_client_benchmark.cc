@@ -0,0 +1,366 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/check.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "benchmark/benchmark.h"
+#include "components/tools/benchmarks/benchmark_util.h"
+#include "components/tools/util/configure_telemetry_tools.h"
+#include "components/udf/code_config.h"
+#include "components/udf/udf_client.h"
+#include "components/util/request_context.h"
+#include "src/roma/config/config.h"
+
+ABSL_FLAG(int64_t, number_of_workers, 4, "Number of Roma workers.");
+ABSL_FLAG(std::vector<std::string>, concurrency,
+          std::vector<std::string>({"1", "4", "16", "64"}),
+          "Numbers of UDF executions in flight at any time.");
+ABSL_FLAG(std::vector<std::string>, partitions,
+          std::vector<std::string>({"1", "10", "100"}),
+          "Numbers of partitions executed by each batch.");
+ABSL_FLAG(std::vector<std::string>, metadata_size,
+          std::vector<std::string>({"1000", "100000"}),
+          "Approximate sizes of the request metadata of each batch.");
+
+namespace kv_server {
+namespace {
+
+using kv_server::benchmark::ParseInt64List;
+
+// Format variables used to generate benchmark names.
+//
+// => cz - number of UDF executions in flight, each on its own benchmark
+//         thread for the sync API and all from a single thread for the
+//         async API.
+// => pz - number of partitions in each batch.
+constexpr std::string_view kSyncFmt = "BM_ExecuteCode_Sync/cz:%d";
+constexpr std::string_view kAsyncFmt = "BM_ExecuteCode_Async/cz:%d";
+constexpr std::string_view kBatchFmt = "BM_BatchExecuteCode/pz:%d";
+// => mz - approximate size of the request metadata.
+constexpr std::string_view kCopiedMetadataFmt =
+    "BM_BatchExecuteCode_CopiedMetadata/pz:%d/mz:%d";
+constexpr std::string_view kSharedMetadataFmt =
+    "BM_BatchExecuteCode_SharedMetadata/pz:%d/mz:%d";
+
+constexpr std::string_view kExecutionsPerSec = "Executions/s";
+constexpr std::string_view kThreads = "Threads";
+
+// Checks the thread count every this many iterations.
+constexpr int64_t kThreadCountPeriod = 100;
+
+UdfClient* udf_client = nullptr;
+
+// Returns the number of threads of this process.
+int64_t CountThreads() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    constexpr std::string_view kThreadsPrefix = "Threads:";
+    if (line.rfind(kThreadsPrefix, 0) == 0) {
+      int64_t threads = 0;
+      if (absl::SimpleAtoi(line.substr(kThreadsPrefix.size()), &threads)) {
+        return threads;
+      }
+    }
+  }
+  return 0;
+}
+
+google::protobuf::RepeatedPtrField<UDFArgument> MakeArguments() {
+  google::protobuf::RepeatedPtrField<UDFArgument> arguments;
+  arguments.Add()->mutable_data()->set_string_value("key");
+  return arguments;
+}
+
+// Bounds the number of executions in flight.
+class InFlightLimiter {
+ public:
+  explicit InFlightLimiter(int64_t limit) : limit_(limit) {}
+
+  void Acquire() {
+    absl::MutexLock lock(&mutex_,
+                         absl::Condition(this, &InFlightLimiter::HasCapacity));
+    ++in_flight_;
+  }
+
+  void Release() {
+    absl::MutexLock lock(&mutex_);
+    --in_flight_;
+  }
+
+  void WaitForAll() {
+    absl::MutexLock lock(&mutex_,
+                         absl::Condition(this, &InFlightLimiter::IsIdle));
+  }
+
+ private:
+  bool HasCapacity() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return in_flight_ < limit_;
+  }
+  bool IsIdle() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return in_flight_ == 0;
+  }
+
+  const int64_t limit_;
+  absl::Mutex mutex_;
+  int64_t in_flight_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+void ReportCounters(::benchmark::State& state, int64_t executions,
+                    int64_t max_threads) {
+  state.counters[std::string(kExecutionsPerSec)] =
+      ::benchmark::Counter(executions, ::benchmark::Counter::kIsRate);
+  state.counters[std::string(kThreads)] =
+      ::benchmark::Counter(max_threads, ::benchmark::Counter::kAvgThreads);
+}
+
+// Every benchmark thread blocks on its own execution.
+void BM_ExecuteCode_Sync(::benchmark::State& state) {
+  RequestContextFactory request_context_factory;
+  const auto arguments = MakeArguments();
+  int64_t max_threads = 0;
+  for (auto _ : state) {
+    ExecutionMetadata execution_metadata;
+    auto result = udf_client->ExecuteCode(request_context_factory, {},
+                                          arguments, execution_metadata);
+    if (!result.ok()) {
+      state.SkipWithError(result.status().ToString().c_str());
+      return;
+    }
+    if (state.iterations() % kThreadCountPeriod == 0) {
+      max_threads = std::max(max_threads, CountThreads());
+    }
+  }
+  ReportCounters(state, state.iterations(), max_threads);
+}
+
+// A single thread keeps `concurrency` executions in flight.
+void BM_ExecuteCode_Async(::benchmark::State& state, int64_t concurrency) {
+  RequestContextFactory request_context_factory;
+  const auto arguments = MakeArguments();
+  InFlightLimiter limiter(concurrency);
+  int64_t max_threads = 0;
+  for (auto _ : state) {
+    limiter.Acquire();
+    udf_client->ExecuteCodeAsync(
+        request_context_factory, {}, arguments,
+        [&limiter](absl::StatusOr<std::string> result,
+                   ExecutionMetadata execution_metadata) {
+          if (!result.ok()) {
+            LOG(ERROR) << result.status();
+          }
+          limiter.Release();
+        });
+    if (state.iterations() % kThreadCountPeriod == 0) {
+      max_threads = std::max(max_threads, CountThreads());
+    }
+  }
+  limiter.WaitForAll();
+  ReportCounters(state, state.iterations(), max_threads);
+}
+
+// Executes the partitions of each batch concurrently. The thread count is
+// checked while they are in flight.
+void BM_BatchExecuteCode(::benchmark::State& state, int64_t partitions) {
+  RequestContextFactory request_context_factory;
+  const auto arguments = MakeArguments();
+  int64_t max_threads = 0;
+  for (auto _ : state) {
+    absl::flat_hash_map<UniquePartitionIdTuple, UDFInput> udf_input_map;
+    for (int32_t i = 0; i < partitions; ++i) {
+      udf_input_map[{i, 0}].arguments = arguments;
+    }
+    absl::Notification done;
+    absl::Status status;
+    udf_client->BatchExecuteCodeAsync(
+        request_context_factory, udf_input_map,
+        [&done, &status](
+            absl::StatusOr<
+                absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
+                results,
+            ExecutionMetadata execution_metadata) {
+          status = results.status();
+          done.Notify();
+        });
+    if (state.iterations() % kThreadCountPeriod == 0) {
+      max_threads = std::max(max_threads, CountThreads());
+    }
+    done.WaitForNotification();
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString().c_str());
+      return;
+    }
+  }
+  ReportCounters(state, state.iterations() * partitions, max_threads);
+}
+
+// Returns request metadata of about `size` bytes of JSON.
+google::protobuf::Struct MakeRequestMetadata(int64_t size) {
+  google::protobuf::Struct metadata;
+  auto& fields = *metadata.mutable_fields();
+  for (int64_t i = 0; i * 32 < size; ++i) {
+    fields[absl::StrCat("field", i)].set_string_value(std::string(20, 'x'));
+  }
+  return metadata;
+}
+
+// Executes batches whose partitions all have the same request metadata,
+// which is either copied to and converted to JSON for every partition or
+// converted once and shared by all of them. The UDF ignores the metadata, so
+// the difference is the cost of setting up the batch.
+void BM_BatchExecuteCode_RequestMetadata(::benchmark::State& state,
+                                         int64_t partitions,
+                                         int64_t metadata_size, bool shared) {
+  RequestContextFactory request_context_factory;
+  const auto arguments = MakeArguments();
+  const google::protobuf::Struct request_metadata =
+      MakeRequestMetadata(metadata_size);
+  for (auto _ : state) {
+    absl::flat_hash_map<UniquePartitionIdTuple, UDFInput> udf_input_map;
+    for (int32_t i = 0; i < partitions; ++i) {
+      auto& udf_input = udf_input_map[{i, 0}];
+      udf_input.arguments = arguments;
+      if (!shared) {
+        *udf_input.execution_metadata.mutable_request_metadata() =
+            request_metadata;
+      }
+    }
+    absl::Notification done;
+    absl::Status status;
+    auto callback =
+        [&done, &status](
+            absl::StatusOr<
+                absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
+                results,
+            ExecutionMetadata execution_metadata) {
+          status = results.status();
+          done.Notify();
+        };
+    if (shared) {
+      udf_client->BatchExecuteCodeAsync(request_context_factory,
+                                        &request_metadata, udf_input_map,
+                                        std::move(callback));
+    } else {
+      udf_client->BatchExecuteCodeAsync(request_context_factory,
+                                        udf_input_map, std::move(callback));
+    }
+    done.WaitForNotification();
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString().c_str());
+      return;
+    }
+  }
+  state.counters[std::string(kExecutionsPerSec)] = ::benchmark::Counter(
+      state.iterations() * partitions, ::benchmark::Counter::kIsRate);
+}
+
+void RegisterBenchmarks() {
+  auto concurrencies = ParseInt64List(absl::GetFlag(FLAGS_concurrency));
+  auto partitions = ParseInt64List(absl::GetFlag(FLAGS_partitions));
+  auto metadata_sizes = ParseInt64List(absl::GetFlag(FLAGS_metadata_size));
+  for (auto concurrency : concurrencies.value()) {
+    ::benchmark::RegisterBenchmark(
+        absl::StrFormat(kSyncFmt, concurrency).c_str(), BM_ExecuteCode_Sync)
+        ->Threads(concurrency)
+        ->MeasureProcessCPUTime()
+        ->UseRealTime();
+    ::benchmark::RegisterBenchmark(
+        absl::StrFormat(kAsyncFmt, concurrency).c_str(), BM_ExecuteCode_Async,
+        concurrency)
+        ->MeasureProcessCPUTime()
+        ->UseRealTime();
+  }
+  for (auto num_partitions : partitions.value()) {
+    ::benchmark::RegisterBenchmark(
+        absl::StrFormat(kBatchFmt, num_partitions).c_str(), BM_BatchExecuteCode,
+        num_partitions)
+        ->MeasureProcessCPUTime()
+        ->UseRealTime();
+    for (auto metadata_size : metadata_sizes.value()) {
+      ::benchmark::RegisterBenchmark(
+          absl::StrFormat(kCopiedMetadataFmt, num_partitions, metadata_size)
+              .c_str(),
+          BM_BatchExecuteCode_RequestMetadata, num_partitions, metadata_size,
+          /*shared=*/false)
+          ->MeasureProcessCPUTime()
+          ->UseRealTime();
+      ::benchmark::RegisterBenchmark(
+          absl::StrFormat(kSharedMetadataFmt, num_partitions, metadata_size)
+              .c_str(),
+          BM_BatchExecuteCode_RequestMetadata, num_partitions, metadata_size,
+          /*shared=*/true)
+          ->MeasureProcessCPUTime()
+          ->UseRealTime();
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks for executing a trivial JavaScript UDF on a local Roma
+// instance through the sync and async UdfClient APIs. `Executions/s` is the
+// throughput and `Threads` the peak number of threads of the process, which
+// shows the cost of blocking a thread on each execution. The `*Metadata`
+// benchmarks compare copying the request metadata to every partition of a
+// batch with sharing it. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:udf_client_benchmark \
+//    --config=local_instance \
+//    --config=local_platform -- \
+//    --number_of_workers=4 --concurrency=1,4,16,64 --partitions=1,10,100 \
+//    --metadata_size=1000,100000 \
+//    --benchmark_counters_tabular=true --stderrthreshold=0
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  kv_server::ConfigureTelemetryForTools();
+  google::scp::roma::Config<std::weak_ptr<kv_server::RequestContext>> config;
+  config.number_of_workers = absl::GetFlag(FLAGS_number_of_workers);
+  auto udf_client = kv_server::UdfClient::Create(std::move(config));
+  CHECK(udf_client.ok()) << udf_client.status();
+  CHECK_OK((*udf_client)->SetCodeObject(kv_server::CodeConfig{
+      .js = "hello = (metadata, data) => 'Hello ' + data;",
+      .udf_handler_name = "hello",
+      .logical_commit_time = 1,
+      .version = 1,
+  }));
+  kv_server::udf_client = udf_client->get();
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  CHECK_OK((*udf_client)->Stop());
+  return 0;
+}
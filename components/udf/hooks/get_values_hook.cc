@@ -14,7 +14,9 @@
 
 #include "components/udf/hooks/get_values_hook.h"
 
+#include <algorithm>
 #include <memory>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -23,10 +25,12 @@
 #include "absl/functional/any_invocable.h"
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "components/data_server/cache/cache.h"
 #include "components/internal_server/local_lookup.h"
 #include "components/internal_server/lookup.pb.h"
+#include "components/internal_server/lookup_memo.h"
 #include "components/telemetry/server_definition.h"
 #include "google/protobuf/util/json_util.h"
 #include "nlohmann/json.hpp"
@@ -91,11 +95,194 @@ void SetStatusAsString(absl::StatusCode code, std::string_view message,
   io.set_output_string(status.dump());
 }
 
-void SetOutputAsString(const InternalLookupResponse& response,
-                       FunctionBindingIoProto& io,
-                       const RequestContext& request_context) {
-  PS_VLOG(9, request_context.GetPSLogContext())
-      << "Processing internal lookup response";
+// Returns the length of the UTF-8 sequence at the start of `text`, or 0 if it
+// is not a valid sequence of a non-ASCII code point.
+int Utf8SequenceLength(std::string_view text) {
+  const auto byte = [text](size_t i) {
+    return static_cast<unsigned char>(text[i]);
+  };
+  const unsigned char lead = byte(0);
+  size_t length;
+  // Range of the second byte, which excludes overlong encodings, surrogates
+  // and code points above U+10FFFF.
+  unsigned char min = 0x80;
+  unsigned char max = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    if (lead == 0xE0) {
+      min = 0xA0;
+    } else if (lead == 0xED) {
+      max = 0x9F;
+    }
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    if (lead == 0xF0) {
+      min = 0x90;
+    } else if (lead == 0xF4) {
+      max = 0x8F;
+    }
+  } else {
+    return 0;
+  }
+  if (text.size() < length || byte(1) < min || byte(1) > max) {
+    return 0;
+  }
+  for (size_t i = 2; i < length; ++i) {
+    if (byte(i) < 0x80 || byte(i) > 0xBF) {
+      return 0;
+    }
+  }
+  return length;
+}
+
+// Appends `text` as a JSON string, escaped like `nlohmann::json::dump` does.
+// Returns false if `text` is not valid UTF-8.
+bool AppendJsonString(std::string_view text, std::string& output) {
+  static constexpr char kHexDigits[] = "0123456789abcdef";
+  output.push_back('"');
+  size_t unescaped_start = 0;
+  size_t i = 0;
+  while (i < text.size()) {
+    const auto c = static_cast<unsigned char>(text[i]);
+    if (c >= 0x80) {
+      const int length = Utf8SequenceLength(text.substr(i));
+      if (length == 0) {
+        return false;
+      }
+      i += length;
+      continue;
+    }
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      ++i;
+      continue;
+    }
+    output.append(text.data() + unescaped_start, i - unescaped_start);
+    switch (c) {
+      case '"':
+        output.append("\\\"");
+        break;
+      case '\\':
+        output.append("\\\\");
+        break;
+      case '\b':
+        output.append("\\b");
+        break;
+      case '\f':
+        output.append("\\f");
+        break;
+      case '\n':
+        output.append("\\n");
+        break;
+      case '\r':
+        output.append("\\r");
+        break;
+      case '\t':
+        output.append("\\t");
+        break;
+      default:
+        output.append("\\u00");
+        output.push_back(kHexDigits[c >> 4]);
+        output.push_back(kHexDigits[c & 0xF]);
+    }
+    unescaped_start = ++i;
+  }
+  output.append(text.data() + unescaped_start, text.size() - unescaped_start);
+  output.push_back('"');
+  return true;
+}
+
+// Appends `result` the way `MessageToJsonString` prints it. Only values and
+// statuses without details are handled, which is what `GetKeyValues` returns.
+bool AppendSingleLookupResultJson(const SingleLookupResult& result,
+                                  std::string& output) {
+  switch (result.single_lookup_result_case()) {
+    case SingleLookupResult::kValue:
+      output.append(R"({"value":)");
+      if (!AppendJsonString(result.value(), output)) {
+        return false;
+      }
+      output.push_back('}');
+      return true;
+    case SingleLookupResult::kStatus: {
+      const auto& status = result.status();
+      if (status.details_size() > 0) {
+        return false;
+      }
+      // Fields with default values are omitted.
+      output.append(R"({"status":{)");
+      if (status.code() != 0) {
+        absl::StrAppend(&output, R"("code":)", status.code());
+      }
+      if (!status.message().empty()) {
+        if (status.code() != 0) {
+          output.push_back(',');
+        }
+        output.append(R"("message":)");
+        if (!AppendJsonString(status.message(), output)) {
+          return false;
+        }
+      }
+      output.append("}}");
+      return true;
+    }
+    case SingleLookupResult::SINGLE_LOOKUP_RESULT_NOT_SET:
+      output.append("{}");
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns `response` with an ok status as JSON. The output is the same as the
+// one of `SetOutputAsStringFromProtoJson`, but it is written in a single pass.
+// Returns nullopt for the responses that are not handled, i.e., with set
+// values, status details or strings that are not valid UTF-8.
+std::optional<std::string> LookupResponseToJson(
+    const InternalLookupResponse& response) {
+  // `nlohmann::json` objects are ordered by key.
+  std::vector<const google::protobuf::MapPair<std::string, SingleLookupResult>*>
+      kv_pairs;
+  kv_pairs.reserve(response.kv_pairs().size());
+  size_t estimated_size = 64;
+  for (const auto& kv_pair : response.kv_pairs()) {
+    kv_pairs.push_back(&kv_pair);
+    estimated_size += kv_pair.first.size() + kv_pair.second.value().size() + 16;
+  }
+  std::sort(kv_pairs.begin(), kv_pairs.end(),
+            [](const auto* lhs, const auto* rhs) {
+              return lhs->first < rhs->first;
+            });
+  std::string json;
+  json.reserve(estimated_size);
+  json.push_back('{');
+  if (!kv_pairs.empty()) {
+    json.append(R"("kvPairs":{)");
+    for (const auto* kv_pair : kv_pairs) {
+      if (kv_pair != kv_pairs.front()) {
+        json.push_back(',');
+      }
+      if (!AppendJsonString(kv_pair->first, json)) {
+        return std::nullopt;
+      }
+      json.push_back(':');
+      if (!AppendSingleLookupResultJson(kv_pair->second, json)) {
+        return std::nullopt;
+      }
+    }
+    json.append("},");
+  }
+  absl::StrAppend(&json, R"("status":{"code":0,"message":")", kOkStatusMessage,
+                  R"("}})");
+  return json;
+}
+
+// Converts `response` to JSON with protobuf, and adds the status with
+// `nlohmann::json`.
+void SetOutputAsStringFromProtoJson(const InternalLookupResponse& response,
+                                    FunctionBindingIoProto& io,
+                                    const RequestContext& request_context) {
   std::string kv_pairs_json;
   if (const auto json_status = MessageToJsonString(response, &kv_pairs_json);
       !json_status.ok()) {
@@ -123,6 +310,18 @@ void SetOutputAsString(const InternalLookupResponse& response,
   io.set_output_string(kv_pairs_json_object.dump());
 }
 
+void SetOutputAsString(const InternalLookupResponse& response,
+                       FunctionBindingIoProto& io,
+                       const RequestContext& request_context) {
+  PS_VLOG(9, request_context.GetPSLogContext())
+      << "Processing internal lookup response";
+  if (auto json = LookupResponseToJson(response); json.has_value()) {
+    io.set_output_string(*std::move(json));
+    return;
+  }
+  SetOutputAsStringFromProtoJson(response, io, request_context);
+}
+
 class GetValuesHookImpl : public GetValuesHook {
  public:
   explicit GetValuesHookImpl(OutputType output_type)
@@ -169,7 +368,7 @@ class GetValuesHookImpl : public GetValuesHook {
     PS_VLOG(9, request_context->GetPSLogContext())
         << "Calling internal lookup client";
     absl::StatusOr<InternalLookupResponse> response_or_status =
-        lookup_->GetKeyValues(*request_context, keys);
+        GetKeyValues(*request_context, keys);
     if (!response_or_status.ok()) {
       SetStatus(response_or_status.status().code(),
                 response_or_status.status().message(), payload.io_proto);
@@ -184,6 +383,36 @@ class GetValuesHookImpl : public GetValuesHook {
   }
 
  private:
+  // Only looks up the keys that were not already looked up by the request.
+  absl::StatusOr<InternalLookupResponse> GetKeyValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys) {
+    LookupMemo& memo = request_context.GetLookupMemo();
+    InternalLookupResponse response;
+    const absl::flat_hash_set<std::string_view> missing_keys =
+        memo.GetKeyValues(keys, response);
+    auto& metrics_context = request_context.GetUdfRequestMetricsContext();
+    if (const int hits = keys.size() - missing_keys.size(); hits > 0) {
+      LogIfError(metrics_context.AccumulateMetric<kLookupMemoEventCount>(
+          hits, kGetValuesMemoHit));
+    }
+    if (missing_keys.empty()) {
+      return response;
+    }
+    LogIfError(metrics_context.AccumulateMetric<kLookupMemoEventCount>(
+        static_cast<int>(missing_keys.size()), kGetValuesMemoMiss));
+    absl::StatusOr<InternalLookupResponse> lookup_response =
+        lookup_->GetKeyValues(request_context, missing_keys);
+    if (!lookup_response.ok()) {
+      return lookup_response;
+    }
+    memo.AddKeyValues(*lookup_response);
+    for (auto& [key, result] : *response.mutable_kv_pairs()) {
+      (*lookup_response->mutable_kv_pairs())[key] = std::move(result);
+    }
+    return lookup_response;
+  }
+
   void SetStatus(absl::StatusCode code, std::string_view message,
                  FunctionBindingIoProto& io) {
     if (output_type_ == OutputType::kString) {
@@ -24,6 +24,7 @@
 #include "gmock/gmock.h"
 #include "google/protobuf/message_lite.h"
 #include "google/protobuf/text_format.h"
+#include "google/protobuf/util/json_util.h"
 #include "gtest/gtest.h"
 #include "nlohmann/json.hpp"
 #include "public/test_util/proto_matcher.h"
@@ -33,6 +34,7 @@ namespace kv_server {
 namespace {
 
 using google::protobuf::TextFormat;
+using google::protobuf::json::MessageToJsonString;
 using google::scp::roma::FunctionBindingPayload;
 using google::scp::roma::proto::FunctionBindingIoProto;
 using testing::_;
@@ -157,6 +159,94 @@ TEST_F(GetValuesHookTest, StringOutput_InputIsNotListOfStrings) {
   EXPECT_EQ(io.output_string(), expected.dump());
 }
 
+// Returns the string output for `response` the way the hook computed it
+// before writing the JSON directly, i.e., with protobuf and nlohmann.
+std::string ProtoJsonStringOutput(const InternalLookupResponse& response) {
+  std::string kv_pairs_json;
+  EXPECT_TRUE(MessageToJsonString(response, &kv_pairs_json).ok());
+  nlohmann::json output = nlohmann::json::parse(kv_pairs_json);
+  output["status"]["code"] = 0;
+  output["status"]["message"] = "ok";
+  return output.dump();
+}
+
+TEST_F(GetValuesHookTest, StringOutput_MatchesProtoJsonOutput) {
+  InternalLookupResponse lookup_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key2"
+             value { value: "{\"a\": [1, \"\\u00e9\"]}\n\t\b\f\r\001\177" }
+           }
+           kv_pairs {
+             key: "key10"
+             value { value: "\342\202\254 \360\237\230\200 </script>" }
+           }
+           kv_pairs {
+             key: "Key\\\""
+             value { value: "" }
+           }
+           kv_pairs {
+             key: "key3"
+             value { status { code: 5, message: "Key not found: \"key3\"" } }
+           }
+           kv_pairs {
+             key: "key4"
+             value { status { message: "No code" } }
+           }
+           kv_pairs {
+             key: "key5"
+             value { status {} }
+           }
+           kv_pairs {
+             key: "key6"
+             value {}
+           })pb",
+      &lookup_response);
+  for (const auto& response : {InternalLookupResponse(), lookup_response}) {
+    auto mock_lookup = std::make_unique<MockLookup>();
+    EXPECT_CALL(*mock_lookup, GetKeyValues(_, _)).WillOnce(Return(response));
+
+    FunctionBindingIoProto io;
+    TextFormat::ParseFromString(
+        R"pb(input_list_of_string { data: "key1" data: "key2" })pb", &io);
+    auto get_values_hook =
+        GetValuesHook::Create(GetValuesHook::OutputType::kString);
+    get_values_hook->FinishInit(std::move(mock_lookup));
+    FunctionBindingPayload<std::weak_ptr<RequestContext>> payload{
+        io, GetRequestContext()};
+    (*get_values_hook)(payload);
+
+    EXPECT_EQ(io.output_string(), ProtoJsonStringOutput(response));
+  }
+}
+
+TEST_F(GetValuesHookTest, StringOutput_SuccessfullyProcessesSetValues) {
+  InternalLookupResponse lookup_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key1"
+             value { keyset_values { values: "a" values: "b" } }
+           })pb",
+      &lookup_response);
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, GetKeyValues(_, _))
+      .WillOnce(Return(lookup_response));
+
+  FunctionBindingIoProto io;
+  TextFormat::ParseFromString(R"pb(input_list_of_string { data: "key1" })pb",
+                              &io);
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+  FunctionBindingPayload<std::weak_ptr<RequestContext>> payload{
+      io, GetRequestContext()};
+  (*get_values_hook)(payload);
+
+  EXPECT_EQ(
+      io.output_string(),
+      R"({"kvPairs":{"key1":{"keysetValues":{"values":["a","b"]}}},"status":{"code":0,"message":"ok"}})");
+}
+
 TEST_F(GetValuesHookTest, BinaryOutput_SuccessfullyProcessesValue) {
   absl::flat_hash_set<std::string_view> keys = {"key1", "key2"};
   InternalLookupResponse lookup_response;
@@ -229,5 +319,80 @@ TEST_F(GetValuesHookTest, BinaryOutput_LookupReturnsError) {
   EXPECT_EQ(response.status().message(), "Some error");
 }
 
+TEST_F(GetValuesHookTest, RepeatedKeys_OnlyLooksUpNewKeys) {
+  InternalLookupResponse first_lookup_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   }
+                                   kv_pairs {
+                                     key: "key2"
+                                     value { status { code: 5 } }
+                                   })pb",
+                              &first_lookup_response);
+  InternalLookupResponse second_lookup_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key3"
+                                     value { value: "value3" }
+                                   })pb",
+                              &second_lookup_response);
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup,
+              GetKeyValues(_, absl::flat_hash_set<std::string_view>{
+                                  "key1", "key2"}))
+      .WillOnce(Return(first_lookup_response));
+  EXPECT_CALL(*mock_lookup,
+              GetKeyValues(_, absl::flat_hash_set<std::string_view>{"key3"}))
+      .WillOnce(Return(second_lookup_response));
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+
+  FunctionBindingIoProto first_io;
+  TextFormat::ParseFromString(
+      R"pb(input_list_of_string { data: "key1" data: "key2" })pb", &first_io);
+  FunctionBindingPayload<std::weak_ptr<RequestContext>> first_payload{
+      first_io, GetRequestContext()};
+  (*get_values_hook)(first_payload);
+  FunctionBindingIoProto second_io;
+  TextFormat::ParseFromString(
+      R"pb(input_list_of_string { data: "key1" data: "key2" data: "key3" })pb",
+      &second_io);
+  FunctionBindingPayload<std::weak_ptr<RequestContext>> second_payload{
+      second_io, GetRequestContext()};
+  (*get_values_hook)(second_payload);
+
+  nlohmann::json expected =
+      R"({"kvPairs":{"key1":{"value":"value1"},"key2":{"status":{"code":5}},"key3":{"value":"value3"}},"status":{"code":0,"message":"ok"}})"_json;
+  EXPECT_EQ(second_io.output_string(), expected.dump());
+}
+
+TEST_F(GetValuesHookTest, RepeatedKeys_LooksUpFailedKeysAgain) {
+  absl::flat_hash_set<std::string_view> keys = {"key1"};
+  InternalLookupResponse lookup_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key1"
+             value { status { code: 13, message: "Shard unavailable" } }
+           })pb",
+      &lookup_response);
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, GetKeyValues(_, keys))
+      .Times(2)
+      .WillRepeatedly(Return(lookup_response));
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kBinary);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+
+  for (int i = 0; i < 2; ++i) {
+    FunctionBindingIoProto io;
+    TextFormat::ParseFromString(R"pb(input_list_of_string { data: "key1" })pb",
+                                &io);
+    FunctionBindingPayload<std::weak_ptr<RequestContext>> payload{
+        io, GetRequestContext()};
+    (*get_values_hook)(payload);
+  }
+}
+
 }  // namespace
 }  // namespace kv_server
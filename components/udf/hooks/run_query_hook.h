@@ -23,6 +23,7 @@
 
 #include "absl/strings/str_cat.h"
 #include "components/internal_server/lookup.h"
+#include "components/internal_server/lookup_memo.h"
 #include "components/util/request_context.h"
 #include "nlohmann/json.hpp"
 #include "src/roma/config/function_binding_object_v2.h"
@@ -51,6 +52,9 @@ class RunSetQueryHook {
       absl::StatusCode error_code, std::string_view error_message,
       google::scp::roma::FunctionBindingPayload<std::weak_ptr<RequestContext>>&
           payload);
+  // Only runs `query` if it was not already run by the request.
+  absl::StatusOr<ResponseType> RunQuery(const RequestContext& request_context,
+                                        const std::string& query);
 
   // `lookup_` is initialized separately, since its dependencies create
   // threads. Lazy load is used to ensure that it only happens after Roma
@@ -84,6 +88,38 @@ void RunSetQueryHook<ResponseType>::ReportErrorStatus(
   payload.io_proto.mutable_output_list_of_string()->add_data(status.dump());
 }
 
+template <typename ResponseType>
+absl::StatusOr<ResponseType> RunSetQueryHook<ResponseType>::RunQuery(
+    const RequestContext& request_context, const std::string& query) {
+  LookupMemo& memo = request_context.GetLookupMemo();
+  auto& metrics_context = request_context.GetUdfRequestMetricsContext();
+  if (ResponseType response; memo.GetQueryResult(query, response)) {
+    LogIfError(metrics_context.AccumulateMetric<kLookupMemoEventCount>(
+        1, kRunQueryMemoHit));
+    return response;
+  }
+  LogIfError(metrics_context.AccumulateMetric<kLookupMemoEventCount>(
+      1, kRunQueryMemoMiss));
+  PS_VLOG(9, request_context.GetPSLogContext())
+      << "Calling internal " << HookName() << " client";
+  absl::StatusOr<ResponseType> response_or_status;
+  if constexpr (std::is_same_v<ResponseType, InternalRunQueryResponse>) {
+    response_or_status = lookup_->RunQuery(request_context, query);
+  }
+  if constexpr (std::is_same_v<ResponseType,
+                               InternalRunSetQueryUInt32Response>) {
+    response_or_status = lookup_->RunSetQueryUInt32(request_context, query);
+  }
+  if constexpr (std::is_same_v<ResponseType,
+                               InternalRunSetQueryUInt64Response>) {
+    response_or_status = lookup_->RunSetQueryUInt64(request_context, query);
+  }
+  if (response_or_status.ok()) {
+    memo.AddQueryResult(query, *response_or_status);
+  }
+  return response_or_status;
+}
+
 template <typename ResponseType>
 void RunSetQueryHook<ResponseType>::FinishInit(std::unique_ptr<Lookup> lookup) {
   if (lookup_ == nullptr) {
@@ -119,23 +155,8 @@ void RunSetQueryHook<ResponseType>::operator()(
         << HookName() << " result: " << payload.io_proto.DebugString();
     return;
   }
-  PS_VLOG(9, request_context->GetPSLogContext())
-      << "Calling internal " << HookName() << " client";
-  absl::StatusOr<ResponseType> response_or_status;
-  if constexpr (std::is_same_v<ResponseType, InternalRunQueryResponse>) {
-    response_or_status =
-        lookup_->RunQuery(*request_context, payload.io_proto.input_string());
-  }
-  if constexpr (std::is_same_v<ResponseType,
-                               InternalRunSetQueryUInt32Response>) {
-    response_or_status = lookup_->RunSetQueryUInt32(
-        *request_context, payload.io_proto.input_string());
-  }
-  if constexpr (std::is_same_v<ResponseType,
-                               InternalRunSetQueryUInt64Response>) {
-    response_or_status = lookup_->RunSetQueryUInt64(
-        *request_context, payload.io_proto.input_string());
-  }
+  absl::StatusOr<ResponseType> response_or_status =
+      RunQuery(*request_context, payload.io_proto.input_string());
   if (!response_or_status.ok()) {
     PS_LOG(ERROR, request_context->GetPSLogContext())
         << "Internal " << HookName()
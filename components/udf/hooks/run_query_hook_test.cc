@@ -14,8 +14,11 @@
 
 #include "components/udf/hooks/run_query_hook.h"
 
+#include <cstring>
+#include <limits>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/status/status.h"
 #include "components/internal_server/mocks.h"
@@ -31,6 +34,7 @@ using google::protobuf::TextFormat;
 using google::scp::roma::FunctionBindingPayload;
 using google::scp::roma::proto::FunctionBindingIoProto;
 using testing::_;
+using testing::ElementsAreArray;
 using testing::Return;
 using testing::UnorderedElementsAreArray;
 
@@ -92,6 +96,32 @@ TEST_F(RunQueryHookTest, VerifyProcessingUInt32SetsSuccessfully) {
   EXPECT_THAT(actual_response, EqualsProto(run_query_response));
 }
 
+TEST_F(RunQueryHookTest, UInt64SetsRoundTripAsPackedArray) {
+  InternalRunSetQueryUInt64Response run_query_response;
+  for (uint64_t i = 0; i < 100000; ++i) {
+    run_query_response.add_elements(i << 20);
+  }
+  run_query_response.add_elements(std::numeric_limits<uint64_t>::max());
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, RunSetQueryUInt64(_, "Q"))
+      .WillOnce(Return(run_query_response));
+  FunctionBindingIoProto io;
+  TextFormat::ParseFromString(R"pb(input_string: "Q")pb", &io);
+  auto run_query_hook = RunSetQueryUInt64Hook::Create();
+  run_query_hook->FinishInit(std::move(mock_lookup));
+  FunctionBindingPayload<std::weak_ptr<RequestContext>> payload{
+      io, GetRequestContext()};
+  (*run_query_hook)(payload);
+  ASSERT_TRUE(io.has_output_bytes());
+  ASSERT_EQ(io.output_bytes().size(),
+            run_query_response.elements_size() * sizeof(uint64_t));
+  std::vector<uint64_t> elements(run_query_response.elements_size());
+  std::memcpy(elements.data(), io.output_bytes().data(),
+              io.output_bytes().size());
+  EXPECT_THAT(elements, ElementsAreArray(run_query_response.elements()));
+  EXPECT_EQ(io.output_list_of_string().data_size(), 0);
+}
+
 TEST_F(RunQueryHookTest, RunQueryClientReturnsError) {
   std::string query = "Q";
   auto mock_lookup = std::make_unique<MockLookup>();
@@ -186,5 +216,47 @@ TEST_F(RunQueryHookTest, RunSetQueryUInt64ClientReturnsError) {
           {R"({"code":2,"message":"runSetQueryUInt64 failed with error: Some error"})"}));
 }
 
+TEST_F(RunQueryHookTest, RepeatedQuery_OnlyRunsQueryOnce) {
+  InternalRunQueryResponse run_query_response;
+  TextFormat::ParseFromString(R"pb(elements: "a" elements: "b")pb",
+                              &run_query_response);
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, RunQuery(_, "A | B"))
+      .WillOnce(Return(run_query_response));
+  auto run_query_hook = RunSetQueryStringHook::Create();
+  run_query_hook->FinishInit(std::move(mock_lookup));
+
+  for (const char* query : {"A | B", "A|B"}) {
+    FunctionBindingIoProto io;
+    io.set_input_string(query);
+    FunctionBindingPayload<std::weak_ptr<RequestContext>> payload{
+        io, GetRequestContext()};
+    (*run_query_hook)(payload);
+    EXPECT_THAT(io.output_list_of_string().data(),
+                UnorderedElementsAreArray({"a", "b"}));
+  }
+}
+
+TEST_F(RunQueryHookTest, RepeatedQuery_RunsFailedQueryAgain) {
+  InternalRunSetQueryUInt32Response run_query_response;
+  TextFormat::ParseFromString(R"pb(elements: 1000 elements: 1001)pb",
+                              &run_query_response);
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, RunSetQueryUInt32(_, "Q"))
+      .WillOnce(Return(absl::UnknownError("Some error")))
+      .WillOnce(Return(run_query_response));
+  auto run_query_hook = RunSetQueryUInt32Hook::Create();
+  run_query_hook->FinishInit(std::move(mock_lookup));
+
+  for (int i = 0; i < 3; ++i) {
+    FunctionBindingIoProto io;
+    TextFormat::ParseFromString(R"pb(input_string: "Q")pb", &io);
+    FunctionBindingPayload<std::weak_ptr<RequestContext>> payload{
+        io, GetRequestContext()};
+    (*run_query_hook)(payload);
+    EXPECT_EQ(io.has_output_bytes(), i > 0);
+  }
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -14,10 +14,12 @@
 
 #include "components/udf/udf_client.h"
 
+#include <algorithm>
 #include <functional>
-#include <future>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -25,7 +27,9 @@
 #include "absl/flags/flag.h"
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
 #include "components/errors/error_tag.h"
@@ -60,6 +64,124 @@ constexpr char kInvocationRequestId[] = "id";
 constexpr char kWasmModuleArrayName[] = "wasm_array";
 constexpr int kUdfInterfaceVersion = 1;
 
+// Returns the JSON of `execution_metadata`, like `MessageToJsonString`, but
+// with `request_metadata_json` as its request metadata, so that the request
+// metadata shared by a batch of executions is only printed once. The request
+// metadata of `execution_metadata` is not used.
+absl::StatusOr<std::string> ExecutionMetadataToJson(
+    const UDFExecutionMetadata& execution_metadata,
+    std::string_view request_metadata_json) {
+  std::string json = absl::StrCat(
+      R"({"udfInterfaceVersion":)", execution_metadata.udf_interface_version(),
+      R"(,"requestMetadata":)", request_metadata_json);
+  if (execution_metadata.has_partition_metadata()) {
+    std::string partition_metadata_json;
+    if (const auto json_status =
+            MessageToJsonString(execution_metadata.partition_metadata(),
+                                &partition_metadata_json);
+        !json_status.ok()) {
+      return json_status;
+    }
+    absl::StrAppend(&json, R"(,"partitionMetadata":)", partition_metadata_json);
+  }
+  json.push_back('}');
+  return json;
+}
+
+// Hands the result of an asynchronous execution over to a thread that waits
+// for it. Shared with the callback, which may still run after the waiting
+// thread timed out.
+template <typename T>
+class SyncResponse {
+ public:
+  void Set(absl::StatusOr<T> result, ExecutionMetadata metadata) {
+    result_ = std::move(result);
+    metadata_ = std::move(metadata);
+    notification_.Notify();
+  }
+
+  absl::StatusOr<T> Wait(absl::Duration timeout, ExecutionMetadata& metadata) {
+    if (!notification_.WaitForNotificationWithTimeout(timeout)) {
+      return StatusWithErrorTag(
+          absl::Status(absl::StatusCode::kDeadlineExceeded,
+                       "Timed out waiting for UDF execution result."),
+          __FILE__, ErrorTag::kUdfExecutionTimeoutError);
+    }
+    metadata = std::move(metadata_);
+    return std::move(result_);
+  }
+
+ private:
+  absl::Notification notification_;
+  absl::StatusOr<T> result_;
+  ExecutionMetadata metadata_;
+};
+
+// Collects the outputs of a batch of UDF executions, which complete on
+// different Roma threads, and invokes the callback once all of them did.
+class BatchExecution {
+ public:
+  BatchExecution(size_t size, std::weak_ptr<RequestContext> request_context,
+                 UdfClient::BatchExecuteCodeCallback callback)
+      : remaining_(size),
+        request_context_(std::move(request_context)),
+        callback_(std::move(callback)) {
+    metadata_.custom_code_total_execution_time_micros = 0;
+  }
+
+  void Add(const UniquePartitionIdTuple& id, absl::StatusOr<std::string> result,
+           const ExecutionMetadata& metadata) {
+    auto request_context = request_context_.lock();
+    if (!result.ok() && request_context) {
+      PS_VLOG(1, request_context->GetPSLogContext())
+          << "UDF Execution failed for partition id " << std::get<0>(id)
+          << " and compression_group_id " << std::get<1>(id) << ": "
+          << result.status();
+    }
+    absl::flat_hash_map<UniquePartitionIdTuple, std::string> results;
+    ExecutionMetadata batch_metadata;
+    {
+      absl::MutexLock lock(&mutex_);
+      if (result.ok()) {
+        results_[id] = *std::move(result);
+      }
+      // Record the longest UDF execution time across all parallel executions
+      metadata_.custom_code_total_execution_time_micros =
+          std::max(metadata_.custom_code_total_execution_time_micros,
+                   metadata.custom_code_total_execution_time_micros);
+      if (--remaining_ > 0) {
+        return;
+      }
+      results = std::move(results_);
+      batch_metadata = metadata_;
+    }
+    // This was the last execution of the batch.
+    if (request_context) {
+      LogLatencyMetric<UdfRequestMetricsContext,
+                       kBatchUDFExecutionLatencyInMicros>(
+          request_context->GetUdfRequestMetricsContext(), absl::Now() - start_);
+      request_context.reset();
+    }
+    if (results.empty()) {
+      callback_(absl::InternalError(
+                    "BatchExecuteCode failed for all UDF invocations."),
+                std::move(batch_metadata));
+      return;
+    }
+    callback_(std::move(results), std::move(batch_metadata));
+  }
+
+ private:
+  const absl::Time start_ = absl::Now();
+  absl::Mutex mutex_;
+  size_t remaining_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<UniquePartitionIdTuple, std::string> results_
+      ABSL_GUARDED_BY(mutex_);
+  ExecutionMetadata metadata_ ABSL_GUARDED_BY(mutex_);
+  const std::weak_ptr<RequestContext> request_context_;
+  UdfClient::BatchExecuteCodeCallback callback_;
+};
+
 class UdfClientImpl : public UdfClient {
  public:
   explicit UdfClientImpl(Config<std::weak_ptr<RequestContext>>&& config =
@@ -72,94 +194,43 @@ class UdfClientImpl : public UdfClient {
         udf_min_log_level_(udf_min_log_level),
         roma_service_(std::move(config)) {}
 
-  // Converts the arguments into plain JSON strings to pass to Roma.
   absl::StatusOr<std::string> ExecuteCode(
       const RequestContextFactory& request_context_factory,
       UDFExecutionMetadata&& execution_metadata,
       const google::protobuf::RepeatedPtrField<UDFArgument>& arguments,
       ExecutionMetadata& metadata) const {
-    execution_metadata.set_udf_interface_version(kUdfInterfaceVersion);
-    std::vector<std::string> string_args;
-    string_args.reserve(arguments.size() + 1);
-    std::string json_metadata;
-    if (const auto json_status =
-            MessageToJsonString(execution_metadata, &json_metadata);
-        !json_status.ok()) {
-      return json_status;
-    }
-    string_args.push_back(json_metadata);
-
-    for (int i = 0; i < arguments.size(); ++i) {
-      const auto& arg = arguments[i];
-      const google::protobuf::Message* arg_data;
-      if (arg.tags().values().empty()) {
-        arg_data = &arg.data();
-      } else {
-        arg_data = &arg;
-      }
-      std::string json_arg;
-      if (const auto json_status = MessageToJsonString(*arg_data, &json_arg);
-          !json_status.ok()) {
-        return json_status;
-      }
-      string_args.push_back(json_arg);
+    auto input = BuildInput(std::move(execution_metadata), arguments);
+    if (!input.ok()) {
+      return input.status();
     }
-    return ExecuteCode(request_context_factory, std::move(string_args),
-                       metadata);
+    return ExecuteCode(request_context_factory, *std::move(input), metadata);
   }
 
   absl::StatusOr<std::string> ExecuteCode(
       const RequestContextFactory& request_context_factory,
       std::vector<std::string> input, ExecutionMetadata& metadata) const {
-    std::shared_ptr<absl::Status> response_status =
-        std::make_shared<absl::Status>();
-    std::shared_ptr<std::string> result = std::make_shared<std::string>();
-    std::shared_ptr<absl::Notification> notification =
-        std::make_shared<absl::Notification>();
-    auto invocation_request =
-        BuildInvocationRequest(request_context_factory, std::move(input));
-    PS_VLOG(9, request_context_factory.Get().GetPSLogContext())
-        << "Executing UDF with input arg(s): "
-        << absl::StrJoin(invocation_request.input, ",");
-    ScopeLatencyMetricsRecorder<UdfRequestMetricsContext,
-                                kUDFExecutionLatencyInMicros>
-        latency_recorder(
-            request_context_factory.Get().GetUdfRequestMetricsContext());
-    const auto status = roma_service_.Execute(
-        std::make_unique<InvocationStrRequest<std::weak_ptr<RequestContext>>>(
-            std::move(invocation_request)),
-        [notification, response_status,
-         result](absl::StatusOr<ResponseObject> response) {
-          if (response.ok()) {
-            *result = std::move(response->resp);
-          } else {
-            response_status->Update(std::move(response.status()));
-          }
-          notification->Notify();
+    auto response = std::make_shared<SyncResponse<std::string>>();
+    ExecuteStringsAsync(
+        request_context_factory, std::move(input),
+        [response](absl::StatusOr<std::string> result,
+                   ExecutionMetadata execution_metadata) {
+          response->Set(std::move(result), std::move(execution_metadata));
         });
-    if (!status.status().ok()) {
-      PS_LOG(ERROR, request_context_factory.Get().GetPSLogContext())
-          << "Error sending UDF for execution: " << status.status();
-      return status.status();
-    }
+    return response->Wait(udf_timeout_, metadata);
+  }
 
-    notification->WaitForNotificationWithTimeout(udf_timeout_);
-    if (!notification->HasBeenNotified()) {
-      return StatusWithErrorTag(
-          absl::Status(absl::StatusCode::kDeadlineExceeded,
-                       "Timed out waiting for UDF execution result."),
-          __FILE__, ErrorTag::kUdfExecutionTimeoutError);
-    }
-    if (!response_status->ok()) {
-      PS_LOG(ERROR, request_context_factory.Get().GetPSLogContext())
-          << "Error executing UDF: " << *response_status;
-      return *response_status;
+  void ExecuteCodeAsync(
+      const RequestContextFactory& request_context_factory,
+      UDFExecutionMetadata&& execution_metadata,
+      const google::protobuf::RepeatedPtrField<UDFArgument>& arguments,
+      ExecuteCodeCallback callback) const {
+    auto input = BuildInput(std::move(execution_metadata), arguments);
+    if (!input.ok()) {
+      callback(input.status(), ExecutionMetadata());
+      return;
     }
-    // TODO(b/338813575): waiting on the K&B team. Once that's
-    // implemented we should just use that number.
-    metadata.custom_code_total_execution_time_micros =
-        absl::ToInt64Milliseconds(latency_recorder.GetLatency());
-    return *result;
+    ExecuteStringsAsync(request_context_factory, *std::move(input),
+                        std::move(callback));
   }
 
   absl::StatusOr<absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
@@ -167,63 +238,49 @@ class UdfClientImpl : public UdfClient {
       const RequestContextFactory& request_context_factory,
       absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
       ExecutionMetadata& metadata) const {
-    absl::flat_hash_map<UniquePartitionIdTuple, std::string> results;
-    if (udf_input_map.empty()) {
-      PS_VLOG(5, request_context_factory.Get().GetPSLogContext())
-          << "UDF input map is empty. Not executing any UDFs.";
-      return results;
-    }
-
-    UdfRequestMetricsContext& metrics_context =
-        request_context_factory.Get().GetUdfRequestMetricsContext();
-    LogIfError(metrics_context.LogHistogram<kUDFExecutionCount>(
-        (static_cast<double>(udf_input_map.size()))));
-    ScopeLatencyMetricsRecorder<UdfRequestMetricsContext,
-                                kBatchUDFExecutionLatencyInMicros>
-        latency_recorder(
-            request_context_factory.Get().GetUdfRequestMetricsContext());
-
-    absl::flat_hash_map<UniquePartitionIdTuple,
-                        std::future<absl::StatusOr<std::string>>>
-        responses;
-    metadata.custom_code_total_execution_time_micros = 0;
-    for (auto&& [id, udf_input] : udf_input_map) {
-      responses[id] = std::async(
-          std::launch::async,
-          [this, &request_context_factory, &metadata](UDFInput&& udf_input) {
-            ExecutionMetadata single_run_metadata;
-            auto result =
-                this->ExecuteCode(request_context_factory,
-                                  std::move(udf_input.execution_metadata),
-                                  udf_input.arguments, single_run_metadata);
-            // Record the longest UDF execution time across all parallel
-            // executions
-            metadata.custom_code_total_execution_time_micros = std::max(
-                metadata.custom_code_total_execution_time_micros,
-                single_run_metadata.custom_code_total_execution_time_micros);
-            return result;
-          },
-          std::move(udf_input));
-    }
+    using Results = absl::flat_hash_map<UniquePartitionIdTuple, std::string>;
+    auto response = std::make_shared<SyncResponse<Results>>();
+    BatchExecuteCodeAsync(
+        request_context_factory, udf_input_map,
+        [response](absl::StatusOr<Results> results,
+                   ExecutionMetadata execution_metadata) {
+          response->Set(std::move(results), std::move(execution_metadata));
+        });
+    // The UDFs run concurrently, so the batch takes as long as the slowest.
+    return response->Wait(udf_timeout_, metadata);
+  }
 
-    // Process responses
-    for (auto&& [id, response] : responses) {
-      auto result = response.get();
+  // Sends every UDF to Roma before any of them completes, instead of
+  // dedicating a thread to wait for each one. The last execution to complete
+  // invokes `callback`.
+  void BatchExecuteCodeAsync(
+      const RequestContextFactory& request_context_factory,
+      absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
+      BatchExecuteCodeCallback callback) const {
+    BatchExecuteInputsAsync(request_context_factory,
+                            /*request_metadata_json=*/std::nullopt,
+                            udf_input_map, std::move(callback));
+  }
 
-      if (result.ok()) {
-        results[id] = std::move(result.value());
-      } else {
-        PS_VLOG(1, request_context_factory.Get().GetPSLogContext())
-            << "UDF Execution failed for partition id " << std::get<0>(id)
-            << " and compression_group_id " << std::get<1>(id) << ": "
-            << result.status();
-      }
+  void BatchExecuteCodeAsync(
+      const RequestContextFactory& request_context_factory,
+      const google::protobuf::Struct* request_metadata,
+      absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
+      BatchExecuteCodeCallback callback) const {
+    if (request_metadata == nullptr) {
+      BatchExecuteCodeAsync(request_context_factory, udf_input_map,
+                            std::move(callback));
+      return;
     }
-    if (results.empty()) {
-      return absl::InternalError(
-          "BatchExecuteCode failed for all UDF invocations.");
+    std::string request_metadata_json;
+    if (const auto json_status =
+            MessageToJsonString(*request_metadata, &request_metadata_json);
+        !json_status.ok()) {
+      callback(json_status, ExecutionMetadata());
+      return;
     }
-    return results;
+    BatchExecuteInputsAsync(request_context_factory, request_metadata_json,
+                            udf_input_map, std::move(callback));
   }
 
   absl::Status Init() { return roma_service_.Init(); }
@@ -298,6 +355,140 @@ class UdfClientImpl : public UdfClient {
   }
 
  private:
+  // Sends every UDF to Roma before any of them completes, see
+  // `BatchExecuteCodeAsync`. `request_metadata_json`, if any, is the request
+  // metadata of every UDF.
+  void BatchExecuteInputsAsync(
+      const RequestContextFactory& request_context_factory,
+      std::optional<std::string_view> request_metadata_json,
+      absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
+      BatchExecuteCodeCallback callback) const {
+    if (udf_input_map.empty()) {
+      PS_VLOG(5, request_context_factory.Get().GetPSLogContext())
+          << "UDF input map is empty. Not executing any UDFs.";
+      callback(absl::flat_hash_map<UniquePartitionIdTuple, std::string>(),
+               ExecutionMetadata());
+      return;
+    }
+
+    UdfRequestMetricsContext& metrics_context =
+        request_context_factory.Get().GetUdfRequestMetricsContext();
+    LogIfError(metrics_context.LogHistogram<kUDFExecutionCount>(
+        (static_cast<double>(udf_input_map.size()))));
+    auto batch = std::make_shared<BatchExecution>(
+        udf_input_map.size(), request_context_factory.GetWeakCopy(),
+        std::move(callback));
+    for (auto&& [id, udf_input] : udf_input_map) {
+      auto input = BuildInput(std::move(udf_input.execution_metadata),
+                              udf_input.arguments, request_metadata_json);
+      if (!input.ok()) {
+        batch->Add(id, input.status(), ExecutionMetadata());
+        continue;
+      }
+      ExecuteStringsAsync(
+          request_context_factory, *std::move(input),
+          [batch, id = id](absl::StatusOr<std::string> result,
+                           ExecutionMetadata execution_metadata) {
+            batch->Add(id, std::move(result), execution_metadata);
+          });
+    }
+  }
+
+  // Converts the arguments into plain JSON strings to pass to Roma.
+  // `request_metadata_json`, if any, replaces the request metadata of
+  // `execution_metadata`.
+  static absl::StatusOr<std::vector<std::string>> BuildInput(
+      UDFExecutionMetadata&& execution_metadata,
+      const google::protobuf::RepeatedPtrField<UDFArgument>& arguments,
+      std::optional<std::string_view> request_metadata_json = std::nullopt) {
+    execution_metadata.set_udf_interface_version(kUdfInterfaceVersion);
+    std::vector<std::string> string_args;
+    string_args.reserve(arguments.size() + 1);
+    if (request_metadata_json.has_value()) {
+      auto json_metadata =
+          ExecutionMetadataToJson(execution_metadata, *request_metadata_json);
+      if (!json_metadata.ok()) {
+        return json_metadata.status();
+      }
+      string_args.push_back(*std::move(json_metadata));
+    } else {
+      std::string json_metadata;
+      if (const auto json_status =
+              MessageToJsonString(execution_metadata, &json_metadata);
+          !json_status.ok()) {
+        return json_status;
+      }
+      string_args.push_back(std::move(json_metadata));
+    }
+
+    for (int i = 0; i < arguments.size(); ++i) {
+      const auto& arg = arguments[i];
+      const google::protobuf::Message* arg_data;
+      if (arg.tags().values().empty()) {
+        arg_data = &arg.data();
+      } else {
+        arg_data = &arg;
+      }
+      std::string json_arg;
+      if (const auto json_status = MessageToJsonString(*arg_data, &json_arg);
+          !json_status.ok()) {
+        return json_status;
+      }
+      string_args.push_back(json_arg);
+    }
+    return string_args;
+  }
+
+  // Sends the UDF to Roma and returns without waiting for the result, which
+  // Roma passes to `callback` on one of its threads.
+  void ExecuteStringsAsync(const RequestContextFactory& request_context_factory,
+                           std::vector<std::string> input,
+                           ExecuteCodeCallback callback) const {
+    auto invocation_request =
+        BuildInvocationRequest(request_context_factory, std::move(input));
+    PS_VLOG(9, request_context_factory.Get().GetPSLogContext())
+        << "Executing UDF with input arg(s): "
+        << absl::StrJoin(invocation_request.input, ",");
+    // Shared with the Roma callback so that it can still be invoked here if
+    // the execution does not start.
+    auto shared_callback =
+        std::make_shared<ExecuteCodeCallback>(std::move(callback));
+    // The request may have been abandoned by the time the UDF completes, e.g.,
+    // after a timeout, so the Roma callback only holds a weak reference to it.
+    const auto status = roma_service_.Execute(
+        std::make_unique<InvocationStrRequest<std::weak_ptr<RequestContext>>>(
+            std::move(invocation_request)),
+        [shared_callback, start = absl::Now(),
+         weak_request_context = request_context_factory.GetWeakCopy()](
+            absl::StatusOr<ResponseObject> response) {
+          const absl::Duration latency = absl::Now() - start;
+          ExecutionMetadata metadata;
+          if (auto request_context = weak_request_context.lock()) {
+            LogLatencyMetric<UdfRequestMetricsContext,
+                             kUDFExecutionLatencyInMicros>(
+                request_context->GetUdfRequestMetricsContext(), latency);
+            if (!response.ok()) {
+              PS_LOG(ERROR, request_context->GetPSLogContext())
+                  << "Error executing UDF: " << response.status();
+            }
+          }
+          if (!response.ok()) {
+            (*shared_callback)(std::move(response).status(), metadata);
+            return;
+          }
+          // TODO(b/338813575): waiting on the K&B team. Once that's
+          // implemented we should just use that number.
+          metadata.custom_code_total_execution_time_micros =
+              absl::ToInt64Milliseconds(latency);
+          (*shared_callback)(std::move(response->resp), metadata);
+        });
+    if (!status.status().ok()) {
+      PS_LOG(ERROR, request_context_factory.Get().GetPSLogContext())
+          << "Error sending UDF for execution: " << status.status();
+      (*shared_callback)(status.status(), ExecutionMetadata());
+    }
+  }
+
   InvocationStrRequest<std::weak_ptr<RequestContext>> BuildInvocationRequest(
       const RequestContextFactory& request_context_factory,
       std::vector<std::string> input) const {
@@ -354,6 +545,42 @@ class UdfClientImpl : public UdfClient {
 
 }  // namespace
 
+void UdfClient::ExecuteCodeAsync(
+    const RequestContextFactory& request_context_factory,
+    UDFExecutionMetadata&& execution_metadata,
+    const google::protobuf::RepeatedPtrField<UDFArgument>& arguments,
+    ExecuteCodeCallback callback) const {
+  ExecutionMetadata metadata;
+  auto result = ExecuteCode(request_context_factory,
+                            std::move(execution_metadata), arguments, metadata);
+  callback(std::move(result), std::move(metadata));
+}
+
+void UdfClient::BatchExecuteCodeAsync(
+    const RequestContextFactory& request_context_factory,
+    absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
+    BatchExecuteCodeCallback callback) const {
+  ExecutionMetadata metadata;
+  auto results =
+      BatchExecuteCode(request_context_factory, udf_input_map, metadata);
+  callback(std::move(results), std::move(metadata));
+}
+
+void UdfClient::BatchExecuteCodeAsync(
+    const RequestContextFactory& request_context_factory,
+    const google::protobuf::Struct* request_metadata,
+    absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
+    BatchExecuteCodeCallback callback) const {
+  if (request_metadata != nullptr) {
+    for (auto&& [id, udf_input] : udf_input_map) {
+      *udf_input.execution_metadata.mutable_request_metadata() =
+          *request_metadata;
+    }
+  }
+  BatchExecuteCodeAsync(request_context_factory, udf_input_map,
+                        std::move(callback));
+}
+
 absl::StatusOr<std::unique_ptr<UdfClient>> UdfClient::Create(
     Config<std::weak_ptr<RequestContext>>&& config, absl::Duration udf_timeout,
     absl::Duration udf_update_timeout, int udf_min_log_level) {
@@ -21,6 +21,8 @@
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "components/telemetry/server_definition.h"
@@ -54,6 +56,15 @@ struct CodeObjectMetadata {
 // Client to execute UDF
 class UdfClient {
  public:
+  // Invoked with the output of one UDF execution.
+  using ExecuteCodeCallback = absl::AnyInvocable<void(
+      absl::StatusOr<std::string> result, ExecutionMetadata metadata)>;
+  // Invoked with the outputs of a batch of UDF executions.
+  using BatchExecuteCodeCallback = absl::AnyInvocable<void(
+      absl::StatusOr<absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
+          results,
+      ExecutionMetadata metadata)>;
+
   virtual ~UdfClient() = default;
 
   // This interface is too liberal. We may need to change this to an internal
@@ -82,6 +93,40 @@ class UdfClient {
       absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
       ExecutionMetadata& metadata) const = 0;
 
+  // Executes the UDF like `ExecuteCode`, without blocking the calling thread
+  // while the UDF runs. `callback` is invoked exactly once, possibly on a UDF
+  // execution thread, and `request_context_factory` must outlive that call.
+  // The arguments are only read before this returns.
+  //
+  // The default implementation calls `ExecuteCode` and then `callback`.
+  virtual void ExecuteCodeAsync(
+      const RequestContextFactory& request_context_factory,
+      UDFExecutionMetadata&& execution_metadata,
+      const google::protobuf::RepeatedPtrField<UDFArgument>& arguments,
+      ExecuteCodeCallback callback) const;
+
+  // Executes multiple UDFs like `BatchExecuteCode`, without blocking the
+  // calling thread while they run. Same contract as `ExecuteCodeAsync`.
+  //
+  // The default implementation calls `BatchExecuteCode` and then `callback`.
+  virtual void BatchExecuteCodeAsync(
+      const RequestContextFactory& request_context_factory,
+      absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
+      BatchExecuteCodeCallback callback) const;
+
+  // Same as `BatchExecuteCodeAsync`, with `request_metadata` as the request
+  // metadata of every UDF, unless it is null. It is converted to JSON once
+  // for the whole batch instead of once per UDF, so the request metadata of
+  // `udf_input_map` must not be set.
+  //
+  // The default implementation copies `request_metadata` to every UDF input
+  // and calls `BatchExecuteCodeAsync`.
+  virtual void BatchExecuteCodeAsync(
+      const RequestContextFactory& request_context_factory,
+      const google::protobuf::Struct* request_metadata,
+      absl::flat_hash_map<UniquePartitionIdTuple, UDFInput>& udf_input_map,
+      BatchExecuteCodeCallback callback) const;
+
   virtual absl::Status Stop() = 0;
 
   // Sets the code object that will be used for UDF execution
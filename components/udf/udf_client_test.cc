@@ -22,6 +22,8 @@
 #include <vector>
 
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/notification.h"
 #include "components/internal_server/mocks.h"
 #include "components/udf/code_config.h"
 #include "components/udf/hooks/get_values_hook.h"
@@ -1281,6 +1283,127 @@ TEST_F(UdfClientTest, BatchExecuteCodeSuccess) {
   ASSERT_TRUE(stop.ok());
 }
 
+TEST_F(UdfClientTest, ExecuteCodeAsyncCallsBackWithOutput) {
+  auto udf_client = CreateUdfClient();
+  ASSERT_TRUE(udf_client.ok());
+
+  absl::Status code_obj_status = udf_client.value()->SetCodeObject(CodeConfig{
+      .js = "hello = (metadata, data) => 'Hello world! ' + data;",
+      .udf_handler_name = "hello",
+      .logical_commit_time = 1,
+      .version = 1,
+  });
+  ASSERT_TRUE(code_obj_status.ok());
+
+  google::protobuf::RepeatedPtrField<UDFArgument> args;
+  args.Add()->mutable_data()->set_string_value("key1");
+  absl::Notification done;
+  absl::StatusOr<std::string> result;
+  udf_client.value()->ExecuteCodeAsync(
+      *request_context_factory_, {}, args,
+      [&](absl::StatusOr<std::string> callback_result,
+          ExecutionMetadata metadata) {
+        result = std::move(callback_result);
+        done.Notify();
+      });
+  done.WaitForNotification();
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(*result, R"("Hello world! key1")");
+
+  absl::Status stop = udf_client.value()->Stop();
+  ASSERT_TRUE(stop.ok());
+}
+
+TEST_F(UdfClientTest, BatchExecuteCodeAsyncCallsBackOnceAllComplete) {
+  auto udf_client = CreateUdfClient();
+  ASSERT_TRUE(udf_client.ok());
+
+  absl::Status code_obj_status = udf_client.value()->SetCodeObject(CodeConfig{
+      .js = "hello = (metadata, data) => 'Hello world! ' + data;",
+      .udf_handler_name = "hello",
+      .logical_commit_time = 1,
+      .version = 1,
+  });
+  ASSERT_TRUE(code_obj_status.ok());
+
+  absl::flat_hash_map<UniquePartitionIdTuple, UDFInput> input;
+  for (int i = 0; i < 10; ++i) {
+    UDFArgument arg;
+    arg.mutable_data()->set_string_value(absl::StrCat("key", i));
+    input[{i, 0}].arguments.Add(std::move(arg));
+  }
+  absl::Notification done;
+  int num_calls = 0;
+  absl::StatusOr<absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
+      result;
+  udf_client.value()->BatchExecuteCodeAsync(
+      *request_context_factory_, input,
+      [&](absl::StatusOr<
+              absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
+              callback_result,
+          ExecutionMetadata metadata) {
+        ++num_calls;
+        result = std::move(callback_result);
+        done.Notify();
+      });
+  done.WaitForNotification();
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(result->size(), 10);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ((*result)[{i, 0}], absl::StrCat(R"("Hello world! key)", i, "\""));
+  }
+
+  absl::Status stop = udf_client.value()->Stop();
+  ASSERT_TRUE(stop.ok());
+  EXPECT_EQ(num_calls, 1);
+}
+
+TEST_F(UdfClientTest, BatchExecuteCodeAsyncSharesRequestMetadata) {
+  auto udf_client = CreateUdfClient();
+  ASSERT_TRUE(udf_client.ok());
+
+  absl::Status code_obj_status = udf_client.value()->SetCodeObject(CodeConfig{
+      .js = "hello = (metadata) => metadata;",
+      .udf_handler_name = "hello",
+      .logical_commit_time = 1,
+      .version = 1,
+  });
+  ASSERT_TRUE(code_obj_status.ok());
+
+  google::protobuf::Struct request_metadata;
+  (*request_metadata.mutable_fields())["hostname"].set_string_value(
+      "example.com");
+  absl::flat_hash_map<UniquePartitionIdTuple, UDFInput> input;
+  input[{0, 0}];
+  (*input[{1, 0}]
+        .execution_metadata.mutable_partition_metadata()
+        ->mutable_fields())["k"]
+      .set_string_value("v");
+  absl::Notification done;
+  absl::StatusOr<absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
+      result;
+  udf_client.value()->BatchExecuteCodeAsync(
+      *request_context_factory_, &request_metadata, input,
+      [&](absl::StatusOr<
+              absl::flat_hash_map<UniquePartitionIdTuple, std::string>>
+              callback_result,
+          ExecutionMetadata metadata) {
+        result = std::move(callback_result);
+        done.Notify();
+      });
+  done.WaitForNotification();
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(
+      (*result)[{0, 0}],
+      R"({"udfInterfaceVersion":1,"requestMetadata":{"hostname":"example.com"}})");
+  EXPECT_EQ(
+      (*result)[{1, 0}],
+      R"({"udfInterfaceVersion":1,"requestMetadata":{"hostname":"example.com"},"partitionMetadata":{"k":"v"}})");
+
+  absl::Status stop = udf_client.value()->Stop();
+  ASSERT_TRUE(stop.ok());
+}
+
 TEST_F(UdfClientTest, BatchExecuteCodeIgnoresFailedPartition) {
   auto udf_client = CreateUdfClient();
   ASSERT_TRUE(udf_client.ok());
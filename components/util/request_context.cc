@@ -35,6 +35,7 @@ InternalLookupMetricsContext& RequestContext::GetInternalLookupMetricsContext()
 RequestLogContext& RequestContext::GetRequestLogContext() const {
   return *request_log_context_;
 }
+LookupMemo& RequestContext::GetLookupMemo() const { return lookup_memo_; }
 void RequestContext::UpdateLogContext(
     const privacy_sandbox::server_common::LogContext& log_context,
     const privacy_sandbox::server_common::ConsentedDebugConfiguration&
@@ -22,6 +22,7 @@
 #include <string>
 #include <utility>
 
+#include "components/internal_server/lookup_memo.h"
 #include "components/telemetry/server_definition.h"
 #include "src/logger/request_context_impl.h"
 
@@ -91,6 +92,8 @@ class RequestContext {
   InternalLookupMetricsContext& GetInternalLookupMetricsContext() const;
   RequestLogContext& GetRequestLogContext() const;
   privacy_sandbox::server_common::log::ContextImpl<>& GetPSLogContext() const;
+  // Memo of the lookups made by the UDF hooks for this request.
+  LookupMemo& GetLookupMemo() const;
 
   ~RequestContext() {
     // Remove the metrics context for request_id, This is to ensure that
@@ -107,6 +110,7 @@ class RequestContext {
   UdfRequestMetricsContext& udf_request_metrics_context_;
   InternalLookupMetricsContext& internal_lookup_metrics_context_;
   std::unique_ptr<RequestLogContext> request_log_context_;
+  mutable LookupMemo lookup_memo_;
 };
 
 // Class that facilitates the passing around of request context to
@@ -156,16 +156,6 @@ absl::Status CreateRecordsTable(sqlite3* db) {
   return absl::OkStatus();
 }
 
-absl::Status ValidateRecord(const KeyValueMutationRecordT& record) {
-  if (record.key.empty()) {
-    return absl::InvalidArgumentError("Record key must not be empty.");
-  }
-  if (record.value.type == Value::NONE) {
-    return absl::InvalidArgumentError("Record value must not be empty.");
-  }
-  return absl::OkStatus();
-}
-
 absl::Status PrepareStatement(std::string_view sql_statement,
                               sqlite3_stmt** statement, sqlite3* db) {
   if (int error_code = sqlite3_prepare_v2(db, sql_statement.data(),
@@ -238,19 +228,67 @@ absl::StatusOr<int> ProcessRecordRow(RecordRowCallback& row_callback,
   return error_code;
 }
 
-}  // namespace
+// A `RecordAggregator` that stores records in a sqlite3 table keyed by record
+// key.
+class SqliteRecordAggregator : public RecordAggregator {
+ public:
+  static absl::StatusOr<std::unique_ptr<RecordAggregator>> Create(
+      std::string_view data_file);
+
+  absl::Status InsertOrUpdateRecord(
+      int64_t record_key, const KeyValueMutationRecordT& record) override;
+  absl::Status ReadRecord(int64_t record_key,
+                          std::function<absl::Status(KeyValueMutationRecordT)>
+                              record_callback) override;
+  absl::Status ReadRecords(std::function<absl::Status(KeyValueMutationRecordT)>
+                               record_callback) override;
+  absl::Status DeleteRecord(int64_t record_key) override;
+  absl::Status DeleteRecords() override;
 
-void RecordAggregator::DbDeleter::operator()(sqlite3* db) noexcept {
-  sqlite3_close(db);
-}
+ private:
+  // Frees up resources associated with the sqlite3 connection object.
+  struct DbDeleter {
+    // Does not take ownership of the db pointer.
+    void operator()(sqlite3* db) noexcept;
+  };
+  explicit SqliteRecordAggregator(std::unique_ptr<sqlite3, DbDeleter> db)
+      : db_(std::move(db)) {}
+
+  absl::StatusOr<std::vector<std::string>> MergeSetValueIfRecordExists(
+      int64_t record_key, const KeyValueMutationRecordT& record);
+
+  std::unique_ptr<sqlite3, DbDeleter> db_;
+};
+
+}  // namespace
 
 absl::StatusOr<std::unique_ptr<RecordAggregator>>
 RecordAggregator::CreateInMemoryAggregator() {
-  return CreateFileBackedAggregator(kInMemoryPath);
+  return SqliteRecordAggregator::Create(kInMemoryPath);
 }
 
 absl::StatusOr<std::unique_ptr<RecordAggregator>>
 RecordAggregator::CreateFileBackedAggregator(std::string_view data_file) {
+  return SqliteRecordAggregator::Create(data_file);
+}
+
+absl::Status RecordAggregator::ValidateRecord(
+    const KeyValueMutationRecordT& record) {
+  if (record.key.empty()) {
+    return absl::InvalidArgumentError("Record key must not be empty.");
+  }
+  if (record.value.type == Value::NONE) {
+    return absl::InvalidArgumentError("Record value must not be empty.");
+  }
+  return absl::OkStatus();
+}
+
+void SqliteRecordAggregator::DbDeleter::operator()(sqlite3* db) noexcept {
+  sqlite3_close(db);
+}
+
+absl::StatusOr<std::unique_ptr<RecordAggregator>>
+SqliteRecordAggregator::Create(std::string_view data_file) {
   sqlite3* db;
   DbDeleter db_deleter;
   if (sqlite3_open(data_file.data(), &db) != SQLITE_OK) {
@@ -264,24 +302,23 @@ RecordAggregator::CreateFileBackedAggregator(std::string_view data_file) {
   if (absl::Status status = CreateRecordsTable(db_owner.get()); !status.ok()) {
     return status;
   }
-  return absl::WrapUnique(new RecordAggregator(std::move(db_owner)));
+  return absl::WrapUnique(new SqliteRecordAggregator(std::move(db_owner)));
 }
 
 absl::StatusOr<std::vector<std::string>>
-RecordAggregator::MergeSetValueIfRecordExists(
+SqliteRecordAggregator::MergeSetValueIfRecordExists(
     int64_t record_key, const KeyValueMutationRecordT& record) {
   const auto* string_set = record.value.AsStringSet();
-  auto new_values_set = string_set->value;
-  absl::flat_hash_set<std::string_view> merged_values_set;
-  std::copy(new_values_set.begin(), new_values_set.end(),
-            std::inserter(merged_values_set, merged_values_set.end()));
+  // Owns the merged values, since `existing_record` below does not outlive
+  // the callback.
+  absl::flat_hash_set<std::string> merged_values_set(string_set->value.begin(),
+                                                     string_set->value.end());
   auto status = ReadRecord(
       record_key,
       [&merged_values_set](KeyValueMutationRecordT existing_record) {
         if (existing_record.value.type == Value::StringSet) {
           auto* string_set = existing_record.value.AsStringSet();
-          auto existing_values_set = string_set->value;
-          std::copy(existing_values_set.begin(), existing_values_set.end(),
+          std::move(string_set->value.begin(), string_set->value.end(),
                     std::inserter(merged_values_set, merged_values_set.end()));
         }
         return absl::OkStatus();
@@ -289,14 +326,11 @@ RecordAggregator::MergeSetValueIfRecordExists(
   if (!status.ok()) {
     return status;
   }
-  std::vector<std::string> merged_values_list;
-  for (auto value : merged_values_set) {
-    merged_values_list.push_back(std::string(value));
-  }
-  return merged_values_list;
+  return std::vector<std::string>(merged_values_set.begin(),
+                                  merged_values_set.end());
 }
 
-absl::Status RecordAggregator::InsertOrUpdateRecord(
+absl::Status SqliteRecordAggregator::InsertOrUpdateRecord(
     int64_t record_key, const KeyValueMutationRecordT& record) {
   if (absl::Status status = ValidateRecord(record); !status.ok()) {
     return status;
@@ -347,7 +381,7 @@ absl::Status RecordAggregator::InsertOrUpdateRecord(
   return absl::OkStatus();
 }
 
-absl::Status RecordAggregator::ReadRecord(
+absl::Status SqliteRecordAggregator::ReadRecord(
     int64_t record_key,
     std::function<absl::Status(KeyValueMutationRecordT)> record_callback) {
   sqlite3_stmt* select_stmt;
@@ -376,7 +410,7 @@ absl::Status RecordAggregator::ReadRecord(
                    " error: ", sqlite3_errstr(*result)));
 }
 
-absl::Status RecordAggregator::ReadRecords(
+absl::Status SqliteRecordAggregator::ReadRecords(
     std::function<absl::Status(KeyValueMutationRecordT)> record_callback) {
   sqlite3_stmt* batch_select_stmt;
   if (absl::Status status = PrepareStatement(kBatchSelectRecordsSql,
@@ -433,7 +467,7 @@ absl::Status RecordAggregator::ReadRecords(
   return absl::OkStatus();
 }
 
-absl::Status RecordAggregator::DeleteRecord(int64_t record_key) {
+absl::Status SqliteRecordAggregator::DeleteRecord(int64_t record_key) {
   auto sql = absl::StrFormat(kDeleteRecordSql, record_key);
   if (sqlite3_exec(db_.get(), sql.c_str(), /*callback=*/nullptr,
                    /*callback_arg0=*/0, /*errmsg=*/nullptr) != SQLITE_OK) {
@@ -443,7 +477,7 @@ absl::Status RecordAggregator::DeleteRecord(int64_t record_key) {
   return absl::OkStatus();
 }
 
-absl::Status RecordAggregator::DeleteRecords() {
+absl::Status SqliteRecordAggregator::DeleteRecords() {
   if (sqlite3_exec(db_.get(), kDeleteAllRecordsSql.data(),
                    /*callback=*/nullptr,
                    /*callback_arg0=*/0, /*errmsg=*/nullptr) != SQLITE_OK) {
@@ -29,13 +29,13 @@
 #include "absl/status/statusor.h"
 #include "public/data_loading/record_utils.h"
 
-#include "sqlite3.h"
-
 namespace kv_server {
 // A `RecordAggregator` aggregates flatbuffer native `KeyValueMutationRecord`
 // records added to an aggregator instance from potentially multiple record
-// streams. Records can be aggregated by repeatedly calling
-// `InsertOrUpdateRecord(...)` as follows:
+// streams. `CreateInMemoryAggregator()` and `CreateFileBackedAggregator()`
+// create aggregators backed by sqlite; see `SortMergeRecordAggregator` for an
+// aggregator that sorts and merges records instead. Records can be aggregated
+// by repeatedly calling `InsertOrUpdateRecord(...)` as follows:
 //
 //```
 // auto record_aggregator = RecordAggregator::CreateInMemoryAggregator();
@@ -56,7 +56,7 @@ namespace kv_server {
 //```
 class RecordAggregator {
  public:
-  ~RecordAggregator() = default;
+  virtual ~RecordAggregator() = default;
   RecordAggregator(const RecordAggregator&) = delete;
   RecordAggregator& operator=(const RecordAggregator&) = delete;
 
@@ -82,8 +82,8 @@ class RecordAggregator {
   // successfully.
   // - !absl::OkStatus() - if there are any errors. The returned status
   // contains a detailed error message.
-  absl::Status InsertOrUpdateRecord(int64_t record_key,
-                                    const KeyValueMutationRecordT& record);
+  virtual absl::Status InsertOrUpdateRecord(
+      int64_t record_key, const KeyValueMutationRecordT& record) = 0;
   // Reads a record keyed by `record_key` and calls the provided
   // `record_callback` function with the record. If no record keyed by
   // `record_key` exists, then `record_callback` is never called.
@@ -92,18 +92,19 @@ class RecordAggregator {
   // - absl::OkStatus() - if record is read and processed successfully.
   // - !absl::OkStatus() - if there are any errors. The returned status
   // contains a detailed error message.
-  absl::Status ReadRecord(
+  virtual absl::Status ReadRecord(
       int64_t record_key,
-      std::function<absl::Status(KeyValueMutationRecordT)> record_callback);
-  // Reads all records currently in the aggregator. The `record_callback`
-  // function is called exactly once for each record.
+      std::function<absl::Status(KeyValueMutationRecordT)> record_callback) = 0;
+  // Reads all records currently in the aggregator, in increasing order of
+  // their record keys. The `record_callback` function is called exactly once
+  // for each record.
   //
   // Returns:
   // - absl::OkStatus() - if all records are read and processed successfully.
   // - !absl::OkStatus() - if there are any errors. The returned status
   // contains a detailed error message.
-  absl::Status ReadRecords(
-      std::function<absl::Status(KeyValueMutationRecordT)> record_callback);
+  virtual absl::Status ReadRecords(
+      std::function<absl::Status(KeyValueMutationRecordT)> record_callback) = 0;
 
   // Deletes record keyed by `record_key`. Silently succeeds if the record
   // does not exist.
@@ -112,28 +113,21 @@ class RecordAggregator {
   // - absl::OkStatus() - if record is deleted successfully.
   // - !absl::OkStatus() - if there are any errors. The returned status
   // contains a detailed error message.
-  absl::Status DeleteRecord(int64_t record_key);
+  virtual absl::Status DeleteRecord(int64_t record_key) = 0;
   // Deletes all records in the aggregator.
   //
   // Returns:
   // - absl::OkStatus() - if all records are deleted successfully.
   // - !absl::OkStatus() - if there are any errors. The returned status
   // contains a detailed error message.
-  absl::Status DeleteRecords();
-
- private:
-  // Frees up resources associated with the sqlite3 connection object.
-  struct DbDeleter {
-    // Does not take ownership of the db pointer.
-    void operator()(sqlite3* db) noexcept;
-  };
-  explicit RecordAggregator(std::unique_ptr<sqlite3, DbDeleter> db)
-      : db_(std::move(db)) {}
+  virtual absl::Status DeleteRecords() = 0;
 
-  absl::StatusOr<std::vector<std::string>> MergeSetValueIfRecordExists(
-      int64_t record_key, const KeyValueMutationRecordT& record);
+ protected:
+  RecordAggregator() = default;
 
-  std::unique_ptr<sqlite3, DbDeleter> db_;
+  // Returns an error if `record` cannot be aggregated, i.e., if it has no key
+  // or no value.
+  static absl::Status ValidateRecord(const KeyValueMutationRecordT& record);
 };
 }  // namespace kv_server
 
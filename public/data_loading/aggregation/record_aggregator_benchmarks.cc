@@ -14,14 +14,20 @@
  * limitations under the License.
  */
 
+#include <filesystem>
+#include <memory>
+#include <string>
+
 #include "absl/hash/hash.h"
 #include "absl/strings/str_cat.h"
 #include "benchmark/benchmark.h"
 #include "public/data_loading/aggregation/record_aggregator.h"
+#include "public/data_loading/aggregation/sort_merge_record_aggregator.h"
 #include "public/data_loading/record_utils.h"
 
 using kv_server::KeyValueMutationType;
 using kv_server::RecordAggregator;
+using kv_server::SortMergeRecordAggregator;
 
 static std::string GenerateRecordValue(int64_t char_count) {
   return std::string(char_count, 'A' + (std::rand() % 15));
@@ -47,6 +53,89 @@ static void BM_InMemoryRecordAggregator_InsertRecord(benchmark::State& state) {
   state.SetBytesProcessed(state.range(0) * state.iterations());
 }
 
+static void BM_SortMergeRecordAggregator_InsertRecord(
+    benchmark::State& state) {
+  auto record_aggregator = SortMergeRecordAggregator::Create({});
+  kv_server::StringValueT string_value;
+  string_value.value = GenerateRecordValue(state.range(0));
+  kv_server::KeyValueMutationRecordT record;
+  record.mutation_type = KeyValueMutationType::Update;
+  record.logical_commit_time = 1234567890;
+  record.value.Set(string_value);
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::string record_key = absl::StrCat("key", std::rand() % 10'000);
+    record.key = record_key;
+    size_t record_hash = absl::HashOf(record.key);
+    state.ResumeTiming();
+    auto ignored =
+        (*record_aggregator)->InsertOrUpdateRecord(record_hash, record);
+  }
+  state.SetBytesProcessed(state.range(0) * state.iterations());
+}
+
+enum class AggregatorType { kSqlite, kSortMerge, kSortMergeWithRunFiles };
+
+static std::unique_ptr<RecordAggregator> CreateAggregator(
+    AggregatorType type) {
+  switch (type) {
+    case AggregatorType::kSqlite:
+      return *std::move(RecordAggregator::CreateInMemoryAggregator());
+    case AggregatorType::kSortMerge:
+      return *std::move(SortMergeRecordAggregator::Create({}));
+    case AggregatorType::kSortMergeWithRunFiles:
+      // Spills every 4MB, like a snapshot much larger than memory would.
+      return *std::move(SortMergeRecordAggregator::Create({
+          .run_file_prefix = absl::StrCat(
+              std::filesystem::temp_directory_path().string(),
+              "/record_aggregator_benchmarks.", std::rand()),
+          .max_buffered_bytes = 4 * 1024 * 1024,
+      }));
+  }
+  return nullptr;
+}
+
+// Inserts `state.range(0)` records with 1024 byte values over 10% as many
+// keys, then reads the aggregated records, like snapshot generation does.
+static void BM_RecordAggregator_InsertAndReadRecords(benchmark::State& state,
+                                                     AggregatorType type) {
+  const int64_t num_records = state.range(0);
+  kv_server::StringValueT string_value;
+  string_value.value = GenerateRecordValue(1024);
+  kv_server::KeyValueMutationRecordT record;
+  record.mutation_type = KeyValueMutationType::Update;
+  record.value.Set(string_value);
+  for (auto _ : state) {
+    auto record_aggregator = CreateAggregator(type);
+    for (int64_t i = 0; i < num_records; ++i) {
+      record.key = absl::StrCat("key", std::rand() % (num_records / 10 + 1));
+      record.logical_commit_time = i;
+      auto ignored = record_aggregator->InsertOrUpdateRecord(
+          absl::HashOf(record.key), record);
+    }
+    auto ignored = record_aggregator->ReadRecords(
+        [](kv_server::KeyValueMutationRecordT record) {
+          benchmark::DoNotOptimize(record);
+          return absl::OkStatus();
+        });
+  }
+  state.SetItemsProcessed(num_records * state.iterations());
+}
+
 BENCHMARK(BM_InMemoryRecordAggregator_InsertRecord)->Range(64, 8192);
+BENCHMARK(BM_SortMergeRecordAggregator_InsertRecord)->Range(64, 8192);
+BENCHMARK_CAPTURE(BM_RecordAggregator_InsertAndReadRecords, sqlite,
+                  AggregatorType::kSqlite)
+    ->Range(1'000, 100'000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_RecordAggregator_InsertAndReadRecords, sort_merge,
+                  AggregatorType::kSortMerge)
+    ->Range(1'000, 100'000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_RecordAggregator_InsertAndReadRecords,
+                  sort_merge_with_run_files,
+                  AggregatorType::kSortMergeWithRunFiles)
+    ->Range(1'000, 100'000)
+    ->Unit(benchmark::kMillisecond);
 
 BENCHMARK_MAIN();
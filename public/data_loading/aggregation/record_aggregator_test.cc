@@ -25,6 +25,7 @@
 #include "absl/strings/str_format.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "public/data_loading/aggregation/sort_merge_record_aggregator.h"
 #include "public/data_loading/readers/delta_record_stream_reader.h"
 #include "public/data_loading/record_utils.h"
 #include "public/test_util/data_record.h"
@@ -52,23 +53,45 @@ std::string GetTempDbFilepath() {
                          "RecordAggregatorTest", std::rand());
 }
 
-class RecordAggregatorTest : public ::testing::TestWithParam<bool> {
+enum class AggregatorType {
+  kInMemory,
+  kFileBacked,
+  kSortMerge,
+  kSortMergeWithRunFiles,
+};
+
+class RecordAggregatorTest : public ::testing::TestWithParam<AggregatorType> {
  protected:
   absl::StatusOr<std::unique_ptr<RecordAggregator>> CreateAggregator() {
-    if ((bool)GetParam()) {
-      return RecordAggregator::CreateInMemoryAggregator();
-    } else {
-      auto db_file = GetTempDbFilepath();
-      if (std::filesystem::exists(db_file)) {
-        EXPECT_TRUE(std::filesystem::remove(db_file));
+    switch (GetParam()) {
+      case AggregatorType::kInMemory:
+        return RecordAggregator::CreateInMemoryAggregator();
+      case AggregatorType::kFileBacked: {
+        auto db_file = GetTempDbFilepath();
+        if (std::filesystem::exists(db_file)) {
+          EXPECT_TRUE(std::filesystem::remove(db_file));
+        }
+        return RecordAggregator::CreateFileBackedAggregator(db_file);
       }
-      return RecordAggregator::CreateFileBackedAggregator(db_file);
+      case AggregatorType::kSortMerge:
+        return SortMergeRecordAggregator::Create({});
+      case AggregatorType::kSortMergeWithRunFiles:
+        // Spills every record to its own run file.
+        return SortMergeRecordAggregator::Create({
+            .run_file_prefix = GetTempDbFilepath(),
+            .max_buffered_bytes = 1,
+            .max_merge_fan_in = 2,
+        });
     }
+    return absl::InvalidArgumentError("Unknown aggregator type.");
   }
 };
 
-INSTANTIATE_TEST_SUITE_P(IsInMemoryBacked, RecordAggregatorTest,
-                         testing::Values(true, false));
+INSTANTIATE_TEST_SUITE_P(
+    AggregatorTypes, RecordAggregatorTest,
+    testing::Values(AggregatorType::kInMemory, AggregatorType::kFileBacked,
+                    AggregatorType::kSortMerge,
+                    AggregatorType::kSortMergeWithRunFiles));
 
 TEST_P(RecordAggregatorTest, ValidateReadRecord) {
   auto record_aggregator = RecordAggregatorTest::CreateAggregator();
@@ -0,0 +1,441 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/aggregation/sort_merge_record_aggregator.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <tuple>
+#include <utility>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "public/data_loading/data_loading_generated.h"
+#include "src/util/status_macro/status_macros.h"
+
+namespace kv_server {
+namespace {
+
+using Entry = SortMergeRecordAggregator::Entry;
+
+// Size of the stream buffer of each run file read during a merge.
+constexpr int64_t kRunFileBufferSize = 256 * 1024;
+
+int64_t EntrySize(const Entry& entry) {
+  return sizeof(Entry) + entry.record_blob.size();
+}
+
+bool EntryAfter(const Entry& a, const Entry& b) {
+  return std::tie(a.record_key, a.sequence_number) >
+         std::tie(b.record_key, b.sequence_number);
+}
+
+template <typename T>
+void WriteValue(T value, std::ostream& stream) {
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool ReadValue(std::istream& stream, T& value) {
+  return static_cast<bool>(
+      stream.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+void WriteEntry(const Entry& entry, std::ostream& stream) {
+  WriteValue(entry.record_key, stream);
+  WriteValue(entry.sequence_number, stream);
+  WriteValue(entry.is_deletion, stream);
+  WriteValue(entry.is_string_set, stream);
+  WriteValue(entry.logical_commit_time, stream);
+  WriteValue(static_cast<uint64_t>(entry.record_blob.size()), stream);
+  stream.write(entry.record_blob.data(), entry.record_blob.size());
+}
+
+// Returns false at the end of `stream` or if reading fails.
+bool ReadEntry(std::istream& stream, Entry& entry) {
+  uint64_t record_blob_size = 0;
+  if (!ReadValue(stream, entry.record_key) ||
+      !ReadValue(stream, entry.sequence_number) ||
+      !ReadValue(stream, entry.is_deletion) ||
+      !ReadValue(stream, entry.is_string_set) ||
+      !ReadValue(stream, entry.logical_commit_time) ||
+      !ReadValue(stream, record_blob_size)) {
+    return false;
+  }
+  entry.record_blob.resize(record_blob_size);
+  return static_cast<bool>(
+      stream.read(entry.record_blob.data(), record_blob_size));
+}
+
+// A sequence of entries sorted by record key and sequence number.
+class EntrySource {
+ public:
+  virtual ~EntrySource() = default;
+  // Returns the next entry, or nullptr at the end of the sequence. The entry
+  // is valid until the next call.
+  virtual const Entry* Next() = 0;
+  virtual absl::Status Status() const = 0;
+};
+
+class BufferEntrySource : public EntrySource {
+ public:
+  explicit BufferEntrySource(const std::vector<Entry>& buffer)
+      : buffer_(buffer) {}
+  const Entry* Next() override {
+    return next_ < buffer_.size() ? &buffer_[next_++] : nullptr;
+  }
+  absl::Status Status() const override { return absl::OkStatus(); }
+
+ private:
+  const std::vector<Entry>& buffer_;
+  size_t next_ = 0;
+};
+
+class RunFileEntrySource : public EntrySource {
+ public:
+  explicit RunFileEntrySource(const std::string& run_file)
+      : run_file_(run_file), stream_buffer_(kRunFileBufferSize) {
+    stream_.rdbuf()->pubsetbuf(stream_buffer_.data(), stream_buffer_.size());
+    stream_.open(run_file, std::ios::binary);
+  }
+  const Entry* Next() override {
+    return ReadEntry(stream_, entry_) ? &entry_ : nullptr;
+  }
+  absl::Status Status() const override {
+    if (!stream_.is_open() || stream_.bad()) {
+      return absl::InternalError(
+          absl::StrCat("Failed to read run file: ", run_file_));
+    }
+    return absl::OkStatus();
+  }
+
+ private:
+  const std::string run_file_;
+  std::vector<char> stream_buffer_;
+  std::ifstream stream_;
+  Entry entry_;
+};
+
+// Returns `record_blob`, a serialized string set record, with its values
+// merged with the values of `existing_record_blob`, if any, and deduplicated.
+absl::StatusOr<std::string> MergeStringSetValues(
+    std::string_view record_blob, const std::string* existing_record_blob) {
+  KeyValueMutationRecordT record;
+  PS_RETURN_IF_ERROR(DeserializeRecord(
+      record_blob, [&record](const KeyValueMutationRecordT& record_struct) {
+        record = record_struct;
+        return absl::OkStatus();
+      }));
+  const auto& values = record.value.AsStringSet()->value;
+  absl::flat_hash_set<std::string> merged_values(values.begin(), values.end());
+  if (existing_record_blob != nullptr) {
+    PS_RETURN_IF_ERROR(DeserializeRecord(
+        *existing_record_blob,
+        [&merged_values](const KeyValueMutationRecordT& existing_record) {
+          const auto& existing_values =
+              existing_record.value.AsStringSet()->value;
+          merged_values.insert(existing_values.begin(), existing_values.end());
+          return absl::OkStatus();
+        }));
+  }
+  record.value.Set(StringSetT{
+      .value = {merged_values.begin(), merged_values.end()},
+  });
+  auto [fbs_buffer, serialized_string_view] = Serialize(record);
+  return std::string(serialized_string_view);
+}
+
+// Applies `entry` to `aggregated`, the aggregated entry of the same record key
+// so far, with the same semantics as `RecordAggregator::InsertOrUpdateRecord`
+// and `RecordAggregator::DeleteRecord`. Entries must be applied in increasing
+// sequence number order.
+absl::Status ApplyEntry(Entry entry, std::optional<Entry>& aggregated) {
+  if (entry.is_deletion) {
+    aggregated.reset();
+    return absl::OkStatus();
+  }
+  // Records with the same logical commit time replace each other in insertion
+  // order.
+  if (aggregated.has_value() &&
+      aggregated->logical_commit_time > entry.logical_commit_time) {
+    return absl::OkStatus();
+  }
+  if (entry.is_string_set) {
+    PS_ASSIGN_OR_RETURN(
+        entry.record_blob,
+        MergeStringSetValues(entry.record_blob,
+                             aggregated.has_value() && aggregated->is_string_set
+                                 ? &aggregated->record_blob
+                                 : nullptr));
+  }
+  aggregated = std::move(entry);
+  return absl::OkStatus();
+}
+
+// K-way merges `sources` and calls `callback` with the aggregated entry of
+// each record key, in increasing record key order. Deleted records are
+// skipped.
+absl::Status MergeEntries(
+    const std::vector<std::unique_ptr<EntrySource>>& sources,
+    const std::function<absl::Status(Entry)>& callback) {
+  using HeapItem = std::pair<const Entry*, EntrySource*>;
+  const auto heap_item_after = [](const HeapItem& a, const HeapItem& b) {
+    return EntryAfter(*a.first, *b.first);
+  };
+  std::priority_queue<HeapItem, std::vector<HeapItem>,
+                      decltype(heap_item_after)>
+      heap(heap_item_after);
+  for (const auto& source : sources) {
+    if (const Entry* entry = source->Next(); entry != nullptr) {
+      heap.emplace(entry, source.get());
+    }
+  }
+  std::optional<Entry> aggregated;
+  while (!heap.empty()) {
+    auto [entry, source] = heap.top();
+    heap.pop();
+    if (aggregated.has_value() &&
+        aggregated->record_key != entry->record_key) {
+      PS_RETURN_IF_ERROR(callback(*std::move(aggregated)));
+      aggregated.reset();
+    }
+    PS_RETURN_IF_ERROR(ApplyEntry(*entry, aggregated));
+    if (const Entry* next_entry = source->Next(); next_entry != nullptr) {
+      heap.emplace(next_entry, source);
+    }
+  }
+  if (aggregated.has_value()) {
+    PS_RETURN_IF_ERROR(callback(*std::move(aggregated)));
+  }
+  for (const auto& source : sources) {
+    PS_RETURN_IF_ERROR(source->Status());
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+SortMergeRecordAggregator::~SortMergeRecordAggregator() { RemoveRunFiles(); }
+
+absl::StatusOr<std::unique_ptr<SortMergeRecordAggregator>>
+SortMergeRecordAggregator::Create(Options options) {
+  if (options.max_buffered_bytes < 1) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Max buffered bytes %d must be at least 1.",
+                        options.max_buffered_bytes));
+  }
+  if (options.max_merge_fan_in < 2) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Max merge fan-in %d must be at least 2.",
+                        options.max_merge_fan_in));
+  }
+  return absl::WrapUnique(new SortMergeRecordAggregator(std::move(options)));
+}
+
+absl::Status SortMergeRecordAggregator::InsertOrUpdateRecord(
+    int64_t record_key, const KeyValueMutationRecordT& record) {
+  PS_RETURN_IF_ERROR(ValidateRecord(record));
+  auto [fbs_buffer, serialized_string_view] = Serialize(record);
+  return AddEntry({
+      .record_key = record_key,
+      .is_string_set = record.value.type == Value::StringSet,
+      .logical_commit_time = record.logical_commit_time,
+      .record_blob = std::string(serialized_string_view),
+  });
+}
+
+absl::Status SortMergeRecordAggregator::ReadRecord(
+    int64_t record_key,
+    std::function<absl::Status(KeyValueMutationRecordT)> record_callback) {
+  return ReadEntries([record_key, &record_callback](Entry entry) {
+    if (entry.record_key != record_key) {
+      return absl::OkStatus();
+    }
+    return DeserializeRecord(
+        entry.record_blob,
+        [&record_callback](const KeyValueMutationRecordT& record) {
+          return record_callback(record);
+        });
+  });
+}
+
+absl::Status SortMergeRecordAggregator::ReadRecords(
+    std::function<absl::Status(KeyValueMutationRecordT)> record_callback) {
+  return ReadEntries([&record_callback](Entry entry) {
+    return DeserializeRecord(
+        entry.record_blob,
+        [&record_callback](const KeyValueMutationRecordT& record) {
+          return record_callback(record);
+        });
+  });
+}
+
+absl::Status SortMergeRecordAggregator::DeleteRecord(int64_t record_key) {
+  return AddEntry({.record_key = record_key, .is_deletion = true});
+}
+
+absl::Status SortMergeRecordAggregator::DeleteRecords() {
+  buffer_.clear();
+  buffered_bytes_ = 0;
+  compaction_threshold_bytes_ = options_.max_buffered_bytes;
+  RemoveRunFiles();
+  return absl::OkStatus();
+}
+
+absl::Status SortMergeRecordAggregator::AddEntry(Entry entry) {
+  entry.sequence_number = next_sequence_number_++;
+  buffered_bytes_ += EntrySize(entry);
+  buffer_.push_back(std::move(entry));
+  if (buffered_bytes_ > compaction_threshold_bytes_) {
+    return SpillBuffer();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SortMergeRecordAggregator::SpillBuffer() {
+  PS_RETURN_IF_ERROR(CompactBuffer());
+  if (options_.run_file_prefix.empty()) {
+    // Without run files, the buffer can only shrink by compaction, so wait
+    // for it to double before compacting it again.
+    compaction_threshold_bytes_ =
+        std::max(options_.max_buffered_bytes, 2 * buffered_bytes_);
+    return absl::OkStatus();
+  }
+  std::string run_file =
+      absl::StrCat(options_.run_file_prefix, ".run.", next_run_number_++);
+  std::ofstream stream(run_file, std::ios::binary | std::ios::trunc);
+  for (const auto& entry : buffer_) {
+    WriteEntry(entry, stream);
+  }
+  stream.close();
+  if (!stream) {
+    return absl::InternalError(
+        absl::StrCat("Failed to write run file: ", run_file));
+  }
+  run_files_.push_back(std::move(run_file));
+  buffer_.clear();
+  buffered_bytes_ = 0;
+  if (static_cast<int64_t>(run_files_.size()) > options_.max_merge_fan_in) {
+    return MergeRuns();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SortMergeRecordAggregator::CompactBuffer() {
+  std::sort(buffer_.begin(), buffer_.end(),
+            [](const Entry& a, const Entry& b) { return EntryAfter(b, a); });
+  std::vector<Entry> compacted;
+  for (size_t begin = 0, end = 0; begin < buffer_.size(); begin = end) {
+    end = begin + 1;
+    while (end < buffer_.size() &&
+           buffer_[end].record_key == buffer_[begin].record_key) {
+      ++end;
+    }
+    if (run_files_.empty()) {
+      // The buffer holds every entry of the record, so the entries can be
+      // aggregated into one.
+      std::optional<Entry> aggregated;
+      for (size_t i = begin; i < end; ++i) {
+        PS_RETURN_IF_ERROR(ApplyEntry(std::move(buffer_[i]), aggregated));
+      }
+      if (aggregated.has_value()) {
+        compacted.push_back(*std::move(aggregated));
+      }
+      continue;
+    }
+    // Entries of the record in the run files are applied before the buffered
+    // ones, so only drop the buffered entries that come before a deletion or
+    // before a value that replaces them all, i.e., a non-set value that is at
+    // least as recent as every earlier entry.
+    size_t first_kept = begin;
+    bool has_deletion = false;
+    int64_t max_logical_commit_time = std::numeric_limits<int64_t>::min();
+    for (size_t i = begin; i < end; ++i) {
+      const Entry& entry = buffer_[i];
+      if (entry.is_deletion) {
+        first_kept = i;
+        has_deletion = true;
+        max_logical_commit_time = std::numeric_limits<int64_t>::min();
+        continue;
+      }
+      if (!has_deletion && !entry.is_string_set &&
+          entry.logical_commit_time >= max_logical_commit_time) {
+        first_kept = i;
+      }
+      max_logical_commit_time =
+          std::max(max_logical_commit_time, entry.logical_commit_time);
+    }
+    std::move(buffer_.begin() + first_kept, buffer_.begin() + end,
+              std::back_inserter(compacted));
+  }
+  buffer_ = std::move(compacted);
+  buffered_bytes_ = 0;
+  for (const auto& entry : buffer_) {
+    buffered_bytes_ += EntrySize(entry);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SortMergeRecordAggregator::MergeRuns() {
+  std::vector<std::unique_ptr<EntrySource>> sources;
+  for (const auto& run_file : run_files_) {
+    sources.push_back(std::make_unique<RunFileEntrySource>(run_file));
+  }
+  std::string merged_run_file =
+      absl::StrCat(options_.run_file_prefix, ".run.", next_run_number_++);
+  std::ofstream stream(merged_run_file, std::ios::binary | std::ios::trunc);
+  PS_RETURN_IF_ERROR(MergeEntries(sources, [&stream](Entry entry) {
+    WriteEntry(entry, stream);
+    return absl::OkStatus();
+  }));
+  stream.close();
+  if (!stream) {
+    return absl::InternalError(
+        absl::StrCat("Failed to write run file: ", merged_run_file));
+  }
+  sources.clear();
+  RemoveRunFiles();
+  run_files_.push_back(std::move(merged_run_file));
+  return absl::OkStatus();
+}
+
+absl::Status SortMergeRecordAggregator::ReadEntries(
+    const std::function<absl::Status(Entry)>& callback) {
+  PS_RETURN_IF_ERROR(CompactBuffer());
+  std::vector<std::unique_ptr<EntrySource>> sources;
+  for (const auto& run_file : run_files_) {
+    sources.push_back(std::make_unique<RunFileEntrySource>(run_file));
+  }
+  sources.push_back(std::make_unique<BufferEntrySource>(buffer_));
+  return MergeEntries(sources, callback);
+}
+
+void SortMergeRecordAggregator::RemoveRunFiles() {
+  for (const auto& run_file : run_files_) {
+    std::error_code error_code;
+    std::filesystem::remove(run_file, error_code);
+  }
+  run_files_.clear();
+}
+
+}  // namespace kv_server
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_DATA_LOADING_AGGREGATION_SORT_MERGE_RECORD_AGGREGATOR_H_
+#define PUBLIC_DATA_LOADING_AGGREGATION_SORT_MERGE_RECORD_AGGREGATOR_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "public/data_loading/aggregation/record_aggregator.h"
+
+namespace kv_server {
+
+// A `SortMergeRecordAggregator` aggregates records with the same semantics as
+// the sqlite-backed `RecordAggregator`s, i.e., newer records replace older
+// ones and string set values are merged, but without a per-record database
+// update.
+//
+// Inserted records are appended to an in-memory buffer. Once the buffer holds
+// more than `Options::max_buffered_bytes`, it is sorted by record key and
+// spilled to a run file. Records are aggregated when they are read, by k-way
+// merging the sorted runs with the sorted buffer, so memory use is bounded by
+// the buffer plus one record per run. Runs are merged into a single run
+// whenever there are more than `Options::max_merge_fan_in` of them.
+//
+// `ReadRecord()` and `DeleteRecord()` are supported for parity with the other
+// aggregators, but `ReadRecord()` scans all records, so this aggregator is
+// meant for workloads that insert all records and then read them all, like
+// snapshot generation.
+//
+// NOTE: This class is not thread safe.
+class SortMergeRecordAggregator : public RecordAggregator {
+ public:
+  struct Options {
+    // Prefix of the run files that buffered records are spilled to. Run files
+    // are removed when they are merged and when the aggregator is destroyed.
+    // If empty, records are never spilled and the buffer is compacted in
+    // memory instead.
+    std::string run_file_prefix;
+    int64_t max_buffered_bytes = 256 * 1024 * 1024;
+    int64_t max_merge_fan_in = 64;
+  };
+
+  ~SortMergeRecordAggregator() override;
+
+  static absl::StatusOr<std::unique_ptr<SortMergeRecordAggregator>> Create(
+      Options options);
+
+  absl::Status InsertOrUpdateRecord(
+      int64_t record_key, const KeyValueMutationRecordT& record) override;
+  absl::Status ReadRecord(int64_t record_key,
+                          std::function<absl::Status(KeyValueMutationRecordT)>
+                              record_callback) override;
+  absl::Status ReadRecords(std::function<absl::Status(KeyValueMutationRecordT)>
+                               record_callback) override;
+  absl::Status DeleteRecord(int64_t record_key) override;
+  absl::Status DeleteRecords() override;
+
+  // A record, or the deletion of a record, in insertion order.
+  struct Entry {
+    int64_t record_key = 0;
+    // Position of the entry in insertion order, which breaks ties between
+    // entries with the same record key.
+    int64_t sequence_number = 0;
+    // True if the entry deletes the record, i.e., comes from `DeleteRecord()`.
+    bool is_deletion = false;
+    bool is_string_set = false;
+    int64_t logical_commit_time = 0;
+    // Serialized `KeyValueMutationRecord`. Empty for deletions.
+    std::string record_blob;
+  };
+
+ private:
+  explicit SortMergeRecordAggregator(Options options)
+      : options_(std::move(options)),
+        compaction_threshold_bytes_(options_.max_buffered_bytes) {}
+
+  absl::Status AddEntry(Entry entry);
+  // Sorts and compacts the buffer, then writes it to a new run file if
+  // `Options::run_file_prefix` is set.
+  absl::Status SpillBuffer();
+  // Sorts the buffer by record key and drops entries that cannot affect the
+  // aggregated records.
+  absl::Status CompactBuffer();
+  // Merges all run files into a single run file.
+  absl::Status MergeRuns();
+  // Calls `callback` with the aggregated entry of each record, in increasing
+  // record key order.
+  absl::Status ReadEntries(const std::function<absl::Status(Entry)>& callback);
+  void RemoveRunFiles();
+
+  const Options options_;
+  std::vector<Entry> buffer_;
+  int64_t buffered_bytes_ = 0;
+  // The buffer is spilled or compacted once it holds more bytes than this.
+  int64_t compaction_threshold_bytes_;
+  std::vector<std::string> run_files_;
+  int64_t next_sequence_number_ = 0;
+  int64_t next_run_number_ = 0;
+};
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_AGGREGATION_SORT_MERGE_RECORD_AGGREGATOR_H_
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/aggregation/sort_merge_record_aggregator.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/hash/hash.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/record_utils.h"
+#include "public/test_util/data_record.h"
+
+namespace kv_server {
+namespace {
+
+std::string GetTempRunFilePrefix() {
+  return absl::StrFormat("%s/%s.%d", std::filesystem::temp_directory_path(),
+                         "SortMergeRecordAggregatorTest", std::rand());
+}
+
+// Returns all records of `record_aggregator`, with sorted set values.
+std::vector<KeyValueMutationRecordT> ReadAllRecords(
+    RecordAggregator& record_aggregator) {
+  std::vector<KeyValueMutationRecordT> records;
+  auto status = record_aggregator.ReadRecords(
+      [&records](KeyValueMutationRecordT record) {
+        if (record.value.type == Value::StringSet) {
+          auto& values = record.value.AsStringSet()->value;
+          std::sort(values.begin(), values.end());
+        }
+        records.push_back(std::move(record));
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  return records;
+}
+
+TEST(SortMergeRecordAggregatorTest, MatchesSqliteAggregator) {
+  auto sqlite_aggregator = RecordAggregator::CreateInMemoryAggregator();
+  ASSERT_TRUE(sqlite_aggregator.ok()) << sqlite_aggregator.status();
+  auto sort_merge_aggregator = SortMergeRecordAggregator::Create({
+      .run_file_prefix = GetTempRunFilePrefix(),
+      .max_buffered_bytes = 4096,
+      .max_merge_fan_in = 4,
+  });
+  ASSERT_TRUE(sort_merge_aggregator.ok()) << sort_merge_aggregator.status();
+  std::mt19937 random(/*seed=*/42);
+  for (int i = 0; i < 2000; ++i) {
+    KeyValueMutationRecordT record = {
+        .mutation_type = random() % 4 == 0 ? KeyValueMutationType::Delete
+                                           : KeyValueMutationType::Update,
+        .logical_commit_time = static_cast<int64_t>(random() % 10),
+        .key = absl::StrCat("key", random() % 50),
+    };
+    if (random() % 2 == 0) {
+      record.value.Set(GetSimpleStringValue(absl::StrCat("value", i)));
+    } else {
+      record.value.Set(GetStringSetValue(
+          {absl::StrCat("value", random() % 10),
+           absl::StrCat("value", random() % 10)}));
+    }
+    const int64_t record_key = absl::HashOf(record.key);
+    EXPECT_TRUE(
+        (*sqlite_aggregator)->InsertOrUpdateRecord(record_key, record).ok());
+    EXPECT_TRUE((*sort_merge_aggregator)
+                    ->InsertOrUpdateRecord(record_key, record)
+                    .ok());
+    if (random() % 100 == 0) {
+      EXPECT_TRUE((*sqlite_aggregator)->DeleteRecord(record_key).ok());
+      EXPECT_TRUE((*sort_merge_aggregator)->DeleteRecord(record_key).ok());
+    }
+  }
+  EXPECT_EQ(ReadAllRecords(**sort_merge_aggregator),
+            ReadAllRecords(**sqlite_aggregator));
+}
+
+TEST(SortMergeRecordAggregatorTest, RemovesRunFiles) {
+  const std::string run_file_prefix = GetTempRunFilePrefix();
+  {
+    auto record_aggregator = SortMergeRecordAggregator::Create({
+        .run_file_prefix = run_file_prefix,
+        .max_buffered_bytes = 1,
+    });
+    ASSERT_TRUE(record_aggregator.ok()) << record_aggregator.status();
+    auto record = GetKVMutationRecord(GetSimpleStringValue());
+    EXPECT_TRUE((*record_aggregator)
+                    ->InsertOrUpdateRecord(absl::HashOf(record.key), record)
+                    .ok());
+    EXPECT_TRUE(
+        std::filesystem::exists(absl::StrCat(run_file_prefix, ".run.0")));
+  }
+  EXPECT_FALSE(
+      std::filesystem::exists(absl::StrCat(run_file_prefix, ".run.0")));
+}
+
+TEST(SortMergeRecordAggregatorTest, RejectsInvalidOptions) {
+  EXPECT_EQ(SortMergeRecordAggregator::Create({.max_buffered_bytes = 0})
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(SortMergeRecordAggregator::Create({.max_merge_fan_in = 1})
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+}  // namespace
+}  // namespace kv_server
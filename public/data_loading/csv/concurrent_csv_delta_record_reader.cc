@@ -0,0 +1,312 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/csv/concurrent_csv_delta_record_reader.h"
+
+#include <deque>
+#include <future>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "public/data_loading/record_utils.h"
+#include "riegeli/bytes/string_reader.h"
+#include "riegeli/csv/csv_record.h"
+
+namespace kv_server {
+namespace {
+
+struct ParsedChunk {
+  // Serialized `DataRecord` flatbuffers, in input order.
+  std::vector<std::string> records;
+  absl::Status status;
+};
+
+ParsedChunk ParseChunk(std::string_view chunk,
+                       const riegeli::CsvReaderBase::Options& reader_options,
+                       const CsvDeltaRecordStreamReaderOptions& options) {
+  ParsedChunk parsed;
+  riegeli::CsvReader<riegeli::StringReader<>> csv_reader(
+      riegeli::StringReader<>(chunk), reader_options);
+  riegeli::CsvRecord csv_record;
+  while (csv_reader.ReadRecord(csv_record)) {
+    absl::StatusOr<DataRecordT> data_record =
+        internal::MakeDeltaFileRecordStruct(csv_record, options);
+    if (!data_record.ok()) {
+      parsed.status.Update(data_record.status());
+      continue;
+    }
+    auto [builder, serialized_string_view] = Serialize(*data_record);
+    parsed.records.emplace_back(serialized_string_view);
+  }
+  if (!csv_reader.Close()) {
+    parsed.status.Update(csv_reader.status());
+  }
+  return parsed;
+}
+
+}  // namespace
+
+ConcurrentCsvDeltaRecordReader::ConcurrentCsvDeltaRecordReader(
+    std::istream& src_stream, Options options)
+    : src_stream_(src_stream),
+      options_(std::move(options)),
+      reader_options_(internal::GetRecordReaderOptions<std::istream>(
+          options_.csv_options)),
+      boundary_finder_(reader_options_) {}
+
+absl::Status ConcurrentCsvDeltaRecordReader::Status() const {
+  if (src_stream_.bad()) {
+    return absl::InternalError("Failed to read CSV input stream.");
+  }
+  return absl::OkStatus();
+}
+
+bool ConcurrentCsvDeltaRecordReader::ReadMore(int64_t num_bytes,
+                                              std::string& buffer) {
+  const size_t old_size = buffer.size();
+  buffer.resize(old_size + num_bytes);
+  src_stream_.read(buffer.data() + old_size, num_bytes);
+  buffer.resize(old_size + src_stream_.gcount());
+  return src_stream_.good();
+}
+
+std::string ConcurrentCsvDeltaRecordReader::ReadChunk() {
+  int64_t chunk_size = 0;
+  while (true) {
+    if (!end_of_input_) {
+      end_of_input_ = !ReadMore(options_.chunk_size_bytes, pending_);
+    }
+    if (end_of_input_) {
+      // The last record does not need to end with a line break.
+      chunk_size = pending_.size();
+      break;
+    }
+    // Records larger than the chunk size make the chunk grow until it holds
+    // at least one complete record.
+    if (chunk_size = boundary_finder_.FindLastBoundary(pending_);
+        chunk_size > 0) {
+      break;
+    }
+  }
+  std::string chunk;
+  if (chunk_size == 0) {
+    return chunk;
+  }
+  if (header_.empty()) {
+    // The first chunk starts with the header, which is prepended to every
+    // other chunk so that each chunk can be parsed on its own.
+    const int64_t header_size = boundary_finder_.first_boundary();
+    header_ = pending_.substr(0, header_size > 0 ? header_size : chunk_size);
+  } else {
+    chunk.reserve(header_.size() + chunk_size);
+    chunk.append(header_);
+  }
+  chunk.append(pending_, 0, chunk_size);
+  pending_.erase(0, chunk_size);
+  boundary_finder_.Consume(chunk_size);
+  return chunk;
+}
+
+absl::Status ConcurrentCsvDeltaRecordReader::ReadRecords(
+    const std::function<absl::Status(const DataRecord&)>& record_callback) {
+  if (options_.num_worker_threads < 1) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Num worker threads %d must be at least 1.",
+                        options_.num_worker_threads));
+  }
+  if (options_.chunk_size_bytes < 1) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Chunk size %d must be at least 1 byte.",
+                        options_.chunk_size_bytes));
+  }
+  // Serializes callback calls when records are passed to the callback from
+  // the worker threads.
+  absl::Mutex callback_mu;
+  absl::Status overall_status;
+  const auto pass_records = [&record_callback,
+                             &overall_status](const ParsedChunk& parsed) {
+    for (const auto& record : parsed.records) {
+      overall_status.Update(
+          record_callback(*flatbuffers::GetRoot<DataRecord>(record.data())));
+    }
+    overall_status.Update(parsed.status);
+  };
+  // Chunks are numbered in input order. A chunk is done once its records are
+  // passed to the callback.
+  absl::Mutex chunks_mu;
+  std::deque<std::pair<int64_t, std::string>> unparsed_chunks;
+  absl::flat_hash_map<int64_t, ParsedChunk> parsed_chunks;
+  int64_t num_chunks_read = 0;
+  int64_t num_chunks_done = 0;
+  bool all_chunks_read = false;
+  const auto parse_chunks = [this, &callback_mu, &pass_records, &chunks_mu,
+                             &unparsed_chunks, &parsed_chunks,
+                             &num_chunks_done, &all_chunks_read]() {
+    const auto has_chunk = [&unparsed_chunks, &all_chunks_read]() {
+      return !unparsed_chunks.empty() || all_chunks_read;
+    };
+    while (true) {
+      int64_t index;
+      std::string chunk;
+      {
+        absl::MutexLock lock(&chunks_mu);
+        chunks_mu.Await(absl::Condition(&has_chunk));
+        if (unparsed_chunks.empty()) {
+          return;
+        }
+        index = unparsed_chunks.front().first;
+        chunk = std::move(unparsed_chunks.front().second);
+        unparsed_chunks.pop_front();
+      }
+      ParsedChunk parsed =
+          ParseChunk(chunk, reader_options_, options_.csv_options);
+      if (options_.preserve_order) {
+        absl::MutexLock lock(&chunks_mu);
+        parsed_chunks.emplace(index, std::move(parsed));
+        continue;
+      }
+      {
+        absl::MutexLock lock(&callback_mu);
+        pass_records(parsed);
+      }
+      absl::MutexLock lock(&chunks_mu);
+      ++num_chunks_done;
+    }
+  };
+  // Passes parsed chunks to the callback in input order, if order is
+  // preserved, until fewer than `max_chunks` chunks are read but not done.
+  // This bounds the memory used by chunks waiting to be parsed and by parsed
+  // records waiting to be passed to the callback.
+  const auto wait_for_chunks = [&pass_records, &chunks_mu, &parsed_chunks,
+                                &num_chunks_read,
+                                &num_chunks_done](int64_t max_chunks) {
+    const auto can_progress = [&parsed_chunks, &num_chunks_read,
+                               &num_chunks_done, max_chunks]() {
+      return parsed_chunks.contains(num_chunks_done) ||
+             num_chunks_read - num_chunks_done < max_chunks;
+    };
+    chunks_mu.Lock();
+    while (true) {
+      chunks_mu.Await(absl::Condition(&can_progress));
+      auto it = parsed_chunks.find(num_chunks_done);
+      if (it == parsed_chunks.end()) {
+        break;
+      }
+      ParsedChunk parsed = std::move(it->second);
+      parsed_chunks.erase(it);
+      chunks_mu.Unlock();
+      pass_records(parsed);
+      chunks_mu.Lock();
+      ++num_chunks_done;
+    }
+    chunks_mu.Unlock();
+  };
+  // Like the other concurrent readers, parses with a fixed number of
+  // `std::async` tasks, rather than one per chunk.
+  std::vector<std::future<void>> chunk_parsers;
+  chunk_parsers.reserve(options_.num_worker_threads);
+  for (int64_t i = 0; i < options_.num_worker_threads; ++i) {
+    chunk_parsers.push_back(std::async(std::launch::async, parse_chunks));
+  }
+  const int64_t max_chunks = 2 * options_.num_worker_threads;
+  for (std::string chunk = ReadChunk(); !chunk.empty(); chunk = ReadChunk()) {
+    wait_for_chunks(max_chunks);
+    absl::MutexLock lock(&chunks_mu);
+    unparsed_chunks.emplace_back(num_chunks_read++, std::move(chunk));
+  }
+  {
+    absl::MutexLock lock(&chunks_mu);
+    all_chunks_read = true;
+  }
+  wait_for_chunks(/*max_chunks=*/1);
+  for (auto& chunk_parser : chunk_parsers) {
+    chunk_parser.get();
+  }
+  overall_status.Update(Status());
+  return overall_status;
+}
+
+namespace internal {
+
+CsvRecordBoundaryFinder::CsvRecordBoundaryFinder(
+    const riegeli::CsvReaderBase::Options& reader_options)
+    : quote_(reader_options.quote()),
+      escape_(reader_options.escape()),
+      comment_(reader_options.comment()) {}
+
+int64_t CsvRecordBoundaryFinder::FindLastBoundary(std::string_view data) {
+  for (; scanned_ < static_cast<int64_t>(data.size()); ++scanned_) {
+    const char c = data[scanned_];
+    if (after_escape_) {
+      after_escape_ = false;
+      continue;
+    }
+    if (in_quotes_) {
+      // An escaped quote inside a quoted field, i.e., two quotes, leaves and
+      // enters the quoted field again.
+      if (c == escape_) {
+        after_escape_ = true;
+      } else if (c == quote_) {
+        in_quotes_ = false;
+      }
+      continue;
+    }
+    // Records end with either LF or CR-LF.
+    if (c == '\n') {
+      at_record_start_ = true;
+      in_comment_ = false;
+      last_boundary_ = scanned_ + 1;
+      if (first_boundary_ == 0) {
+        first_boundary_ = last_boundary_;
+      }
+      continue;
+    }
+    if (in_comment_) {
+      continue;
+    }
+    if (at_record_start_ && c == comment_) {
+      in_comment_ = true;
+    } else if (c == escape_) {
+      after_escape_ = true;
+    } else if (c == quote_) {
+      in_quotes_ = true;
+    }
+    at_record_start_ = false;
+  }
+  return last_boundary_;
+}
+
+void CsvRecordBoundaryFinder::Consume(int64_t num_bytes) {
+  first_boundary_ = 0;
+  last_boundary_ = 0;
+  if (num_bytes < scanned_) {
+    scanned_ -= num_bytes;
+    return;
+  }
+  // Consuming everything scanned, e.g., at the end of the input, starts over
+  // at a record boundary.
+  scanned_ = 0;
+  at_record_start_ = true;
+  in_quotes_ = false;
+  in_comment_ = false;
+  after_escape_ = false;
+}
+
+}  // namespace internal
+}  // namespace kv_server
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_DATA_LOADING_CSV_CONCURRENT_CSV_DELTA_RECORD_READER_H_
+#define PUBLIC_DATA_LOADING_CSV_CONCURRENT_CSV_DELTA_RECORD_READER_H_
+
+#include <functional>
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "public/data_loading/csv/csv_delta_record_stream_reader.h"
+#include "public/data_loading/readers/delta_record_reader.h"
+#include "riegeli/csv/csv_reader.h"
+
+namespace kv_server {
+namespace internal {
+
+// Finds record boundaries in CSV input that is read incrementally, i.e.,
+// line breaks outside of quoted fields and comment lines, using the quote,
+// escape and comment characters of the CSV reader options. Scanning resumes
+// where the previous call left off, so each byte is scanned once.
+class CsvRecordBoundaryFinder {
+ public:
+  explicit CsvRecordBoundaryFinder(
+      const riegeli::CsvReaderBase::Options& reader_options);
+
+  // Returns the number of bytes in `data` up to and including the last record
+  // terminator, or 0 if there is none. `data` must start at a record boundary
+  // and extend the `data` of the previous call, minus consumed bytes.
+  int64_t FindLastBoundary(std::string_view data);
+
+  // Returns the number of bytes up to and including the first record
+  // terminator found since the last `Consume`, or 0 if there is none.
+  int64_t first_boundary() const { return first_boundary_; }
+
+  // Drops the first `num_bytes` bytes from the scanned data. `num_bytes` must
+  // be the boundary returned by the last `FindLastBoundary` call, or the size
+  // of all of the data at the end of the input.
+  void Consume(int64_t num_bytes);
+
+ private:
+  std::optional<char> quote_;
+  std::optional<char> escape_;
+  std::optional<char> comment_;
+  // Number of bytes of the data scanned so far.
+  int64_t scanned_ = 0;
+  int64_t first_boundary_ = 0;
+  int64_t last_boundary_ = 0;
+  bool at_record_start_ = true;
+  bool in_quotes_ = false;
+  bool in_comment_ = false;
+  bool after_escape_ = false;
+};
+
+}  // namespace internal
+
+// A `ConcurrentCsvDeltaRecordReader` reads CSV records as `DataRecord` records,
+// like `CsvDeltaRecordStreamReader`, but parses the input on multiple threads.
+//
+// The input is read sequentially in chunks of about `Options::chunk_size_bytes`
+// that end on a record boundary, i.e., a line break outside of a quoted field.
+// Chunks are parsed concurrently by `Options::num_worker_threads` worker
+// threads, each chunk together with the header of the input.
+// At most twice as many chunks as worker threads are held in memory at a time.
+//
+// `ReadRecords` calls the callback for one record at a time, so the callback
+// does not need to be thread-safe:
+//
+// - If `Options::preserve_order` is true, records are passed to the callback
+//   in input order, on the calling thread.
+// - Otherwise, the records of a chunk are passed to the callback as soon as
+//   the chunk is parsed, on the thread that parsed it, so a slow chunk does not
+//   hold back the output of the chunks after it.
+class ConcurrentCsvDeltaRecordReader : public DeltaRecordReader {
+ public:
+  struct Options {
+    CsvDeltaRecordStreamReaderOptions csv_options;
+    int64_t num_worker_threads = std::thread::hardware_concurrency();
+    int64_t chunk_size_bytes = 8 * 1024 * 1024;
+    bool preserve_order = true;
+  };
+
+  ConcurrentCsvDeltaRecordReader(std::istream& src_stream, Options options);
+  ConcurrentCsvDeltaRecordReader(const ConcurrentCsvDeltaRecordReader&) =
+      delete;
+  ConcurrentCsvDeltaRecordReader& operator=(
+      const ConcurrentCsvDeltaRecordReader&) = delete;
+
+  absl::Status ReadRecords(const std::function<absl::Status(const DataRecord&)>&
+                               record_callback) override;
+  bool IsOpen() const override { return !src_stream_.bad(); }
+  absl::Status Status() const override;
+  absl::StatusOr<KVFileMetadata> ReadMetadata() override {
+    return absl::InvalidArgumentError(
+        "ReadMetadata is unimplemented for ConcurrentCsvDeltaRecordReader");
+  }
+
+ private:
+  // Appends up to `num_bytes` bytes from the input to `buffer`. Returns false
+  // once the end of the input is reached.
+  bool ReadMore(int64_t num_bytes, std::string& buffer);
+
+  // Returns the next chunk of complete records, preceded by the header of the
+  // input for every chunk but the first, or an empty string at the end of the
+  // input.
+  std::string ReadChunk();
+
+  std::istream& src_stream_;
+  const Options options_;
+  const riegeli::CsvReaderBase::Options reader_options_;
+  internal::CsvRecordBoundaryFinder boundary_finder_;
+  // Input read past the end of the last chunk.
+  std::string pending_;
+  // The header record of the input, read with the first chunk.
+  std::string header_;
+  bool end_of_input_ = false;
+};
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_CSV_CONCURRENT_CSV_DELTA_RECORD_READER_H_
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/csv/concurrent_csv_delta_record_reader.h"
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/csv/csv_delta_record_stream_writer.h"
+#include "public/data_loading/record_utils.h"
+#include "public/test_util/data_record.h"
+#include "riegeli/csv/csv_reader.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAreArray;
+using testing::UnorderedElementsAreArray;
+
+// Writes records whose values contain field separators, quotes and line
+// breaks, so that chunk boundaries have to skip quoted fields.
+std::vector<DataRecordT> WriteRecords(int num_records,
+                                      std::stringstream& string_stream) {
+  CsvDeltaRecordStreamWriter record_writer(string_stream);
+  std::vector<DataRecordT> records;
+  for (int i = 0; i < num_records; ++i) {
+    auto kv_record = GetKVMutationRecord(GetSimpleStringValue(
+        absl::StrCat("value,", i, i % 3 == 0 ? "\n\"quoted\"\n" : "")));
+    kv_record.key = absl::StrCat("key", i);
+    kv_record.logical_commit_time = i + 1;
+    records.push_back(GetNativeDataRecord(std::move(kv_record)));
+    EXPECT_TRUE(record_writer.WriteRecord(records.back()).ok());
+  }
+  EXPECT_TRUE(record_writer.Flush().ok());
+  return records;
+}
+
+TEST(ConcurrentCsvDeltaRecordReaderTest, ReadsRecordsInOrder) {
+  std::stringstream string_stream;
+  const auto expected = WriteRecords(100, string_stream);
+  ConcurrentCsvDeltaRecordReader record_reader(
+      string_stream, {.num_worker_threads = 4, .chunk_size_bytes = 64});
+  std::vector<DataRecordT> records;
+  auto status = record_reader.ReadRecords([&records](const DataRecord& record) {
+    records.push_back(*record.UnPack());
+    return absl::OkStatus();
+  });
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_THAT(records, ElementsAreArray(expected));
+}
+
+TEST(ConcurrentCsvDeltaRecordReaderTest, ReadsRecordsOutOfOrder) {
+  std::stringstream string_stream;
+  const auto expected = WriteRecords(100, string_stream);
+  ConcurrentCsvDeltaRecordReader record_reader(
+      string_stream, {.num_worker_threads = 4,
+                      .chunk_size_bytes = 64,
+                      .preserve_order = false});
+  std::vector<DataRecordT> records;
+  auto status = record_reader.ReadRecords([&records](const DataRecord& record) {
+    records.push_back(*record.UnPack());
+    return absl::OkStatus();
+  });
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_THAT(records, UnorderedElementsAreArray(expected));
+}
+
+TEST(ConcurrentCsvDeltaRecordReaderTest, ReadsRecordsLargerThanChunkSize) {
+  std::stringstream string_stream;
+  const auto expected = WriteRecords(10, string_stream);
+  ConcurrentCsvDeltaRecordReader record_reader(
+      string_stream, {.num_worker_threads = 2, .chunk_size_bytes = 1});
+  std::vector<DataRecordT> records;
+  auto status = record_reader.ReadRecords([&records](const DataRecord& record) {
+    records.push_back(*record.UnPack());
+    return absl::OkStatus();
+  });
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_THAT(records, ElementsAreArray(expected));
+}
+
+TEST(ConcurrentCsvDeltaRecordReaderTest, ReturnsErrorForInvalidRecords) {
+  const char invalid_data[] =
+      R"csv(key,value,value_type,mutation_type,logical_commit_time
+  key1,value,string,Update,1
+  key2,value,string,Update,invalid_time
+  key3,value,string,Update,3)csv";
+  std::stringstream csv_stream;
+  csv_stream.str(invalid_data);
+  ConcurrentCsvDeltaRecordReader record_reader(
+      csv_stream, {.num_worker_threads = 2, .chunk_size_bytes = 16});
+  int num_records = 0;
+  absl::Status status =
+      record_reader.ReadRecords([&num_records](const DataRecord&) {
+        ++num_records;
+        return absl::OkStatus();
+      });
+  EXPECT_EQ(num_records, 2);
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument) << status;
+  EXPECT_EQ(status.message(),
+            "Cannot convert logical_commit_time:invalid_time to a number.")
+      << status;
+}
+
+TEST(ConcurrentCsvDeltaRecordReaderTest, ReturnsErrorForInvalidOptions) {
+  std::stringstream csv_stream;
+  ConcurrentCsvDeltaRecordReader record_reader(csv_stream,
+                                               {.num_worker_threads = 0});
+  auto status = record_reader.ReadRecords(
+      [](const DataRecord&) { return absl::OkStatus(); });
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument) << status;
+}
+
+TEST(CsvRecordBoundaryFinderTest, SkipsLineBreaksInQuotedFields) {
+  const auto find_last_boundary = [](std::string_view data) {
+    internal::CsvRecordBoundaryFinder finder(riegeli::CsvReaderBase::Options{});
+    return finder.FindLastBoundary(data);
+  };
+  EXPECT_EQ(find_last_boundary(""), 0);
+  EXPECT_EQ(find_last_boundary("a,b"), 0);
+  EXPECT_EQ(find_last_boundary("a,b\nc"), 4);
+  EXPECT_EQ(find_last_boundary("a,b\r\nc"), 5);
+  EXPECT_EQ(find_last_boundary("a,b\nc,\"d\ne"), 4);
+  EXPECT_EQ(find_last_boundary("a,b\nc,\"d\ne\"\"\n\"\nf"), 15);
+}
+
+TEST(CsvRecordBoundaryFinderTest, UsesConfiguredQuoteEscapeAndComment) {
+  riegeli::CsvReaderBase::Options reader_options;
+  reader_options.set_quote('\'').set_escape('\\').set_comment('#');
+  internal::CsvRecordBoundaryFinder finder(reader_options);
+  EXPECT_EQ(finder.FindLastBoundary("a,'b\nc',\"d\n#'\ne\\\nf"), 14);
+  EXPECT_EQ(finder.first_boundary(), 11);
+}
+
+TEST(CsvRecordBoundaryFinderTest, ResumesScanningAfterConsume) {
+  internal::CsvRecordBoundaryFinder finder(riegeli::CsvReaderBase::Options{});
+  std::string data = "a,\"b\nc";
+  EXPECT_EQ(finder.FindLastBoundary(data), 0);
+  data.append("\"\nd,\"e\n");
+  EXPECT_EQ(finder.FindLastBoundary(data), 8);
+  EXPECT_EQ(finder.first_boundary(), 8);
+  data.erase(0, 8);
+  finder.Consume(8);
+  // The quoted field opened before `Consume` is still open.
+  data.append("f\"\ng\n");
+  EXPECT_EQ(finder.FindLastBoundary(data), 10);
+  EXPECT_EQ(finder.first_boundary(), 8);
+}
+
+}  // namespace
+}  // namespace kv_server
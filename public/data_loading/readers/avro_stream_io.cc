@@ -14,11 +14,14 @@
 
 #include "public/data_loading/readers/avro_stream_io.h"
 
+#include <optional>
+
 #include "absl/log/check.h"
 #include "components/errors/error_tag.h"
 #include "public/data_loading/record_utils.h"
 #include "third_party/avro/api/DataFile.hh"
 #include "third_party/avro/api/Schema.hh"
+#include "third_party/avro/api/Specific.hh"
 #include "third_party/avro/api/Stream.hh"
 
 namespace kv_server {
@@ -31,7 +34,8 @@ enum class ErrorTag : int {
   kAvroInputStreamDoesNotSupportSeeking = 4,
   kAvroGenerateByteRangeError = 5,
   kAvroBadStream = 6,
-  kAvroReadByteRangeException = 7
+  kAvroReadByteRangeException = 7,
+  kAvroMisalignedByteRanges = 8
 };
 
 }  // namespace
@@ -150,7 +154,9 @@ AvroConcurrentStreamRecordReader::BuildByteRanges() {
         .begin_offset = byte_range_begin_offset,
         .end_offset = end_offset,
     });
-    byte_range_begin_offset = end_offset + 1;
+    // The next byte range starts at the same offset. Starting after it would
+    // skip a data block whose sync marker starts exactly at `end_offset`.
+    byte_range_begin_offset = end_offset;
   }
   if (byte_ranges.empty() || byte_ranges.back().end_offset != *stream_size) {
     return StatusWithErrorTag(
@@ -172,6 +178,7 @@ absl::Status AvroConcurrentStreamRecordReader::ReadStreamRecords(
   if (!byte_ranges.ok() || byte_ranges->empty()) {
     return byte_ranges.status();
   }
+  const int64_t stream_size = byte_ranges->back().end_offset;
   std::vector<std::future<absl::StatusOr<ByteRangeResult>>>
       byte_range_reader_tasks;
   for (const auto& byte_range : *byte_ranges) {
@@ -181,8 +188,9 @@ absl::Status AvroConcurrentStreamRecordReader::ReadStreamRecords(
     byte_range_reader_tasks.push_back(std::async(
         std::launch::async,
         &AvroConcurrentStreamRecordReader::ReadByteRangeExceptionless, this,
-        std::ref(byte_range), std::ref(callback)));
+        std::ref(byte_range), stream_size, std::ref(callback)));
   }
+  std::optional<ByteRangeResult> prev_byte_range_result;
   int64_t total_records_read = 0;
   for (auto& task : byte_range_reader_tasks) {
     absl::StatusOr<ByteRangeResult> curr_byte_range_result = task.get();
@@ -192,7 +200,19 @@ absl::Status AvroConcurrentStreamRecordReader::ReadStreamRecords(
     if (!curr_byte_range_result.ok()) {
       return curr_byte_range_result.status();
     }
+    if (prev_byte_range_result.has_value() &&
+        prev_byte_range_result->next_byte_range_first_block_pos !=
+            curr_byte_range_result->first_block_pos) {
+      return StatusWithErrorTag(
+          absl::InternalError(absl::StrFormat(
+              "Byte ranges are not aligned: byte range ended before the block "
+              "at byte=%d, but the next byte range started at byte=%d.",
+              prev_byte_range_result->next_byte_range_first_block_pos,
+              curr_byte_range_result->first_block_pos)),
+          __FILE__, ErrorTag::kAvroMisalignedByteRanges);
+    }
     total_records_read += curr_byte_range_result->num_records_read;
+    prev_byte_range_result = *curr_byte_range_result;
   }
   PS_VLOG(2, options_.log_context)
       << "Done reading " << total_records_read << " records in "
@@ -202,11 +222,11 @@ absl::Status AvroConcurrentStreamRecordReader::ReadStreamRecords(
 
 absl::StatusOr<typename AvroConcurrentStreamRecordReader::ByteRangeResult>
 AvroConcurrentStreamRecordReader::ReadByteRangeExceptionless(
-    const ByteRange& byte_range,
+    const ByteRange& byte_range, int64_t stream_size,
     const std::function<absl::Status(const std::string_view&)>&
         record_callback) noexcept {
   try {
-    return ReadByteRange(byte_range, record_callback);
+    return ReadByteRange(byte_range, stream_size, record_callback);
   } catch (const std::exception& e) {
     return StatusWithErrorTag(absl::InternalError(e.what()), __FILE__,
                               ErrorTag::kAvroReadByteRangeException);
@@ -215,7 +235,7 @@ AvroConcurrentStreamRecordReader::ReadByteRangeExceptionless(
 
 absl::StatusOr<typename AvroConcurrentStreamRecordReader::ByteRangeResult>
 AvroConcurrentStreamRecordReader::ReadByteRange(
-    const ByteRange& byte_range,
+    const ByteRange& byte_range, int64_t stream_size,
     const std::function<absl::Status(const std::string_view&)>&
         record_callback) {
   PS_VLOG(2, options_.log_context)
@@ -226,26 +246,37 @@ AvroConcurrentStreamRecordReader::ReadByteRange(
       latency_recorder(KVServerContextMap()->SafeMetric());
   auto record_stream = stream_factory_();
   PS_VLOG(9, options_.log_context) << "creating input stream";
-  avro::InputStreamPtr input_stream =
-      avro::istreamInputStream(record_stream->Stream());
+  avro::InputStreamPtr input_stream = avro::istreamInputStream(
+      record_stream->Stream(), options_.stream_buffer_size_bytes);
   PS_VLOG(9, options_.log_context) << "creating reader";
-  auto record_reader = std::make_unique<avro::DataFileReader<std::string>>(
-      std::move(input_stream));
+  // The reader and its decoder are created once per byte range and decode
+  // every record of the byte range into the same buffer, see below.
+  avro::DataFileReaderBase record_reader(std::move(input_stream));
+  record_reader.init();
   PS_VLOG(9, options_.log_context) << "syncing to block";
   if (record_stream->Stream().bad()) {
     return StatusWithErrorTag(absl::InternalError("Avro stream is bad"),
                               __FILE__, ErrorTag::kAvroBadStream);
   }
   record_stream->Stream().clear();
-  record_reader->sync(byte_range.begin_offset);
+  record_reader.sync(byte_range.begin_offset);
+  ByteRangeResult result;
+  result.first_block_pos =
+      record_reader.hasMore() ? record_reader.previousSync() : stream_size;
   int64_t num_records_read = 0;
   std::string record;
   absl::Status overall_status;
-  while (!record_reader->pastSync(byte_range.end_offset) &&
-         record_reader->read(record)) {
+  // `pastSync` loads the next data block when the current one is exhausted, so
+  // records are decoded straight from the block without checking for more
+  // records again, unlike `avro::DataFileReader::read`.
+  while (!record_reader.pastSync(byte_range.end_offset)) {
+    record_reader.decr();
+    avro::decode(record_reader.decoder(), record);
     overall_status.Update(record_callback(record));
     num_records_read++;
   }
+  result.next_byte_range_first_block_pos =
+      record_reader.hasMore() ? record_reader.previousSync() : stream_size;
   // TODO: b/269119466 - Figure out how to handle this better. Maybe add
   // metrics to track callback failures (??).
   if (!overall_status.ok()) {
@@ -258,7 +289,6 @@ AvroConcurrentStreamRecordReader::ReadByteRange(
       << "Done reading " << num_records_read << " records in byte_range: ["
       << byte_range.begin_offset << "," << byte_range.end_offset << "] in "
       << absl::ToDoubleMilliseconds(latency_recorder.GetLatency()) << " ms.";
-  ByteRangeResult result;
   result.num_records_read = num_records_read;
   return result;
 }
@@ -64,8 +64,10 @@ class AvroStreamReader : public StreamRecordReader {
 // An `AvroConcurrentStreamRecordReader` reads a Avro data stream containing
 // string records concurrently. The reader splits the data stream
 // into byte ranges with an approximately equal number of bytes and reads the
-// chunks in parallel. Each record in the underlying data stream is guaranteed
-// to be read exactly once. The concurrency level can be configured using
+// chunks in parallel. Adjacent byte ranges share their boundary, and both
+// readers resolve it to the first sync marker at or after it, so each data
+// block, and hence each record, in the underlying data stream is guaranteed to
+// be read exactly once. The concurrency level can be configured using
 // `AvroConcurrentStreamRecordReader::Options`.
 //
 // Sample usage:
@@ -95,6 +97,9 @@ class AvroConcurrentStreamRecordReader : public StreamRecordReader {
   struct Options {
     int64_t num_worker_threads = std::thread::hardware_concurrency();
     int64_t min_byte_range_size_bytes = 8 * 1024 * 1024;  // 8MB
+    // Size of the buffer that each byte range reader reads its stream with.
+    // Avro's default of 8KB results in many small reads from blob streams.
+    int64_t stream_buffer_size_bytes = 64 * 1024;  // 64KB
     privacy_sandbox::server_common::log::PSLogContext& log_context =
         const_cast<privacy_sandbox::server_common::log::NoOpContext&>(
             privacy_sandbox::server_common::log::kNoOpContext);
@@ -126,15 +131,21 @@ class AvroConcurrentStreamRecordReader : public StreamRecordReader {
   // Defines metadata/stats returned by a byte range reading task. This is
   // useful for correctness checks.
   struct ByteRangeResult {
+    // Position of the first data block read from the byte range, or the
+    // stream size if there is none.
+    int64_t first_block_pos;
+    // Position of the first data block of the next byte range, or the stream
+    // size if there is none.
+    int64_t next_byte_range_first_block_pos;
     int64_t num_records_read;
   };
 
   absl::StatusOr<ByteRangeResult> ReadByteRange(
-      const ByteRange& shard,
+      const ByteRange& shard, int64_t stream_size,
       const std::function<absl::Status(const std::string_view&)>&
           record_callback);
   absl::StatusOr<ByteRangeResult> ReadByteRangeExceptionless(
-      const ByteRange& shard,
+      const ByteRange& shard, int64_t stream_size,
       const std::function<absl::Status(const std::string_view&)>&
           record_callback) noexcept;
   absl::StatusOr<std::vector<ByteRange>> BuildByteRanges();
@@ -16,6 +16,13 @@
 
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -367,5 +374,115 @@ TEST(AvroStreamIO, SequentialReadingInvalidFile) {
   EXPECT_FALSE(status.ok());
 }
 
+std::vector<std::string> GetDistinctRecords(int64_t num_records) {
+  std::vector<std::string> records;
+  records.reserve(num_records);
+  for (int64_t i = 0; i < num_records; i++) {
+    records.push_back(absl::StrCat("record", i));
+  }
+  return records;
+}
+
+void WriteDistinctAvroRecordsToFile(const std::vector<std::string>& records,
+                                    std::ostream& dest_stream,
+                                    size_t sync_interval) {
+  avro::DataFileWriter<std::string> record_writer(
+      avro::ostreamOutputStream(dest_stream),
+      avro::ValidSchema(avro::BytesSchema()), sync_interval, kAvroDefaultCodec,
+      /*metadata=*/{});
+  for (const std::string& record : records) {
+    record_writer.write(record);
+  }
+  record_writer.close();
+}
+
+// Reads all records of the file at `path` and checks that each of `records`
+// is read exactly once.
+void ExpectReadsAllRecordsExactlyOnce(
+    const std::filesystem::path& path, const std::vector<std::string>& records,
+    const AvroConcurrentStreamRecordReader::Options& options) {
+  AvroConcurrentStreamRecordReader record_reader(
+      [&path] { return std::make_unique<iStreamRecordStream>(path); }, options);
+  absl::Mutex mutex;
+  absl::flat_hash_set<std::string> records_read;
+  int64_t num_records_read = 0;
+  auto status = record_reader.ReadStreamRecords(
+      [&mutex, &records_read, &num_records_read](std::string_view raw) {
+        absl::MutexLock lock(&mutex);
+        records_read.insert(std::string(raw));
+        num_records_read++;
+        return absl::OkStatus();
+      });
+  ASSERT_TRUE(status.ok()) << status;
+  EXPECT_EQ(num_records_read, static_cast<int64_t>(records.size()));
+  EXPECT_EQ(records_read,
+            absl::flat_hash_set<std::string>(records.begin(), records.end()));
+}
+
+class AvroConcurrentReadingTest
+    : public testing::TestWithParam<std::pair<int64_t, int64_t>> {
+ protected:
+  AvroConcurrentReadingTest() { kv_server::InitMetricsContextMap(); }
+};
+
+TEST_P(AvroConcurrentReadingTest, ReadsAllRecordsExactlyOnce) {
+  const auto [num_worker_threads, min_byte_range_size_bytes] = GetParam();
+  const std::filesystem::path path =
+      std::filesystem::path(::testing::TempDir()) /
+      absl::StrCat("ReadsAllRecordsExactlyOnce", num_worker_threads, "_",
+                   min_byte_range_size_bytes, ".avro");
+  const std::vector<std::string> records = GetDistinctRecords(100'000);
+  std::ofstream output_stream(path);
+  WriteDistinctAvroRecordsToFile(records, output_stream,
+                                 /*sync_interval=*/1024);
+  output_stream.close();
+
+  AvroConcurrentStreamRecordReader::Options options;
+  options.num_worker_threads = num_worker_threads;
+  options.min_byte_range_size_bytes = min_byte_range_size_bytes;
+  options.stream_buffer_size_bytes = 4 * 1024;
+  ExpectReadsAllRecordsExactlyOnce(path, records, options);
+}
+
+INSTANTIATE_TEST_SUITE_P(ByteRanges, AvroConcurrentReadingTest,
+                         testing::Values(std::make_pair(1, 1),
+                                         std::make_pair(3, 1),
+                                         std::make_pair(16, 1),
+                                         std::make_pair(64, 1),
+                                         std::make_pair(64, 1000),
+                                         std::make_pair(64, 4096)));
+
+TEST(AvroStreamIO, ConcurrentReadingByteRangeBoundaryAtSyncMarker) {
+  kv_server::InitMetricsContextMap();
+  constexpr std::string_view kFileName = "BoundaryAtSyncMarker.avro";
+  const std::filesystem::path path =
+      std::filesystem::path(::testing::TempDir()) / kFileName;
+  const std::vector<std::string> records = GetDistinctRecords(10'000);
+  std::ofstream output_stream(path);
+  WriteDistinctAvroRecordsToFile(records, output_stream,
+                                 /*sync_interval=*/1024);
+  output_stream.close();
+
+  // Each data block, including the last one, ends with the sync marker, so
+  // the file ends with it as well. The first occurrence of the marker ends the
+  // header, and the second occurrence ends the first data block.
+  std::ifstream input_stream(path, std::ios::binary);
+  const std::string content(std::istreambuf_iterator<char>(input_stream), {});
+  ASSERT_GT(content.size(), 16);
+  const std::string sync_marker = content.substr(content.size() - 16);
+  const size_t header_end = content.find(sync_marker);
+  ASSERT_NE(header_end, std::string::npos);
+  const size_t first_block_end = content.find(sync_marker, header_end + 16);
+  ASSERT_NE(first_block_end, std::string::npos);
+  ASSERT_LT(first_block_end + 16, content.size());
+
+  // With many workers, the first byte range ends exactly at the start of the
+  // sync marker that precedes the second data block.
+  AvroConcurrentStreamRecordReader::Options options;
+  options.num_worker_threads = 1024;
+  options.min_byte_range_size_bytes = first_block_end;
+  ExpectReadsAllRecordsExactlyOnce(path, records, options);
+}
+
 }  // namespace
 }  // namespace kv_server
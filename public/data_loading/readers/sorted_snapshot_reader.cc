@@ -0,0 +1,220 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/readers/sorted_snapshot_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include "absl/cleanup/cleanup.h"
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "src/util/status_macro/status_macros.h"
+
+namespace kv_server {
+namespace {
+
+absl::Status CorruptedSnapshotError(std::string_view message) {
+  return absl::DataLossError(
+      absl::StrCat("Corrupted sorted snapshot: ", message));
+}
+
+}  // namespace
+
+SortedSnapshotReader::SortedSnapshotReader(const char* data, size_t size)
+    : data_(data), size_(size) {}
+
+SortedSnapshotReader::~SortedSnapshotReader() {
+  munmap(const_cast<char*>(data_), size_);
+}
+
+absl::StatusOr<std::unique_ptr<SortedSnapshotReader>>
+SortedSnapshotReader::Open(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, absl::StrCat("Failed to open ", path));
+  }
+  absl::Cleanup close_fd = [fd] { close(fd); };
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    return absl::ErrnoToStatus(errno, absl::StrCat("Failed to stat ", path));
+  }
+  const size_t size = file_stat.st_size;
+  if (size < kSortedSnapshotMagic.size() + sizeof(SortedSnapshotFooter)) {
+    return CorruptedSnapshotError(absl::StrCat(path, " is too small."));
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    return absl::ErrnoToStatus(errno, absl::StrCat("Failed to map ", path));
+  }
+  // Lookups touch few pages at random, so reading ahead only wastes memory.
+  madvise(data, size, MADV_RANDOM);
+  auto reader = absl::WrapUnique(
+      new SortedSnapshotReader(static_cast<const char*>(data), size));
+  PS_RETURN_IF_ERROR(reader->Initialize());
+  return reader;
+}
+
+absl::Status SortedSnapshotReader::Initialize() {
+  if (std::string_view(data_, kSortedSnapshotMagic.size()) !=
+      kSortedSnapshotMagic) {
+    return CorruptedSnapshotError("invalid header.");
+  }
+  SortedSnapshotFooter footer;
+  std::memcpy(&footer, data_ + size_ - sizeof(footer), sizeof(footer));
+  if (std::string_view(footer.magic, sizeof(footer.magic)) !=
+      kSortedSnapshotMagic) {
+    return CorruptedSnapshotError("invalid footer.");
+  }
+  if (footer.version != kSortedSnapshotFormatVersion) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Unsupported sorted snapshot version: ", footer.version));
+  }
+  const uint64_t index_end = size_ - sizeof(footer);
+  if (footer.index_offset % kSortedSnapshotAlignment != 0 ||
+      footer.index_offset > index_end ||
+      index_end - footer.index_offset !=
+          footer.num_blocks * sizeof(SortedSnapshotBlockHandle)) {
+    return CorruptedSnapshotError("invalid index.");
+  }
+  if (footer.metadata_offset > footer.index_offset ||
+      footer.metadata_size > footer.index_offset - footer.metadata_offset ||
+      !metadata_.ParseFromArray(data_ + footer.metadata_offset,
+                                footer.metadata_size)) {
+    return CorruptedSnapshotError("invalid metadata.");
+  }
+  if (footer.num_filter_hashes < 1 || footer.num_filter_hashes > 30) {
+    return CorruptedSnapshotError("invalid number of Bloom filter hashes.");
+  }
+  index_ = absl::MakeConstSpan(
+      reinterpret_cast<const SortedSnapshotBlockHandle*>(data_ +
+                                                         footer.index_offset),
+      footer.num_blocks);
+  uint64_t previous_block_end = kSortedSnapshotMagic.size();
+  for (size_t i = 0; i < index_.size(); ++i) {
+    const SortedSnapshotBlockHandle& block = index_[i];
+    if (block.offset < previous_block_end ||
+        block.offset % kSortedSnapshotAlignment != 0 ||
+        block.filter_offset < block.offset ||
+        block.filter_offset > footer.metadata_offset ||
+        block.size > block.filter_offset - block.offset ||
+        block.filter_offset % kSortedSnapshotAlignment != 0 ||
+        block.filter_size % sizeof(uint64_t) != 0 ||
+        block.filter_size > footer.metadata_offset - block.filter_offset ||
+        (i > 0 && block.first_fingerprint <= index_[i - 1].first_fingerprint)) {
+      return CorruptedSnapshotError(absl::StrCat("invalid block ", i, "."));
+    }
+    previous_block_end = block.filter_offset + block.filter_size;
+  }
+  num_filter_hashes_ = footer.num_filter_hashes;
+  num_records_ = footer.num_records;
+  return absl::OkStatus();
+}
+
+template <typename Fn>
+absl::Status SortedSnapshotReader::ForEachRecordInBlock(
+    const SortedSnapshotBlockHandle& block, Fn&& fn) const {
+  const uint64_t block_end = block.offset + block.size;
+  uint64_t offset = block.offset;
+  while (offset < block_end) {
+    SortedSnapshotRecordHeader header;
+    if (block_end - offset < sizeof(header)) {
+      return CorruptedSnapshotError("truncated record header.");
+    }
+    std::memcpy(&header, data_ + offset, sizeof(header));
+    const uint64_t key_offset = offset + sizeof(header);
+    const uint64_t record_offset =
+        AlignSortedSnapshotOffset(key_offset + header.key_size);
+    const uint64_t next_offset =
+        AlignSortedSnapshotOffset(record_offset + header.record_size);
+    if (next_offset > block_end) {
+      return CorruptedSnapshotError("truncated record.");
+    }
+    if (!fn(header, std::string_view(data_ + key_offset, header.key_size),
+            std::string_view(data_ + record_offset, header.record_size))) {
+      break;
+    }
+    offset = next_offset;
+  }
+  return absl::OkStatus();
+}
+
+std::string_view SortedSnapshotReader::FindRecord(std::string_view key) const {
+  const int64_t fingerprint = SortedSnapshotKeyFingerprint(key);
+  // The only block that can contain `key` is the last one whose first
+  // fingerprint is not greater than `fingerprint`.
+  auto block = std::upper_bound(
+      index_.begin(), index_.end(), fingerprint,
+      [](int64_t fingerprint, const SortedSnapshotBlockHandle& block) {
+        return fingerprint < block.first_fingerprint;
+      });
+  if (block == index_.begin()) {
+    return {};
+  }
+  block = std::prev(block);
+  if (!SortedSnapshotBloomFilterMayContain(
+          fingerprint, num_filter_hashes_,
+          absl::MakeConstSpan(
+              reinterpret_cast<const uint64_t*>(data_ + block->filter_offset),
+              block->filter_size / sizeof(uint64_t)))) {
+    return {};
+  }
+  std::string_view result;
+  auto status = ForEachRecordInBlock(
+      *block, [fingerprint, key, &result](
+                  const SortedSnapshotRecordHeader& header,
+                  std::string_view record_key, std::string_view record_bytes) {
+        if (header.fingerprint == fingerprint && record_key == key) {
+          result = record_bytes;
+          return false;
+        }
+        return header.fingerprint <= fingerprint;
+      });
+  if (!status.ok()) {
+    LOG_FIRST_N(ERROR, 3) << "Failed to look up key: " << key << ". "
+                          << status;
+  }
+  return result;
+}
+
+absl::Status SortedSnapshotReader::ReadRecords(
+    const std::function<absl::Status(std::string_view key,
+                                     std::string_view record_bytes)>&
+        record_callback) const {
+  absl::Status callback_status;
+  for (const SortedSnapshotBlockHandle& block : index_) {
+    PS_RETURN_IF_ERROR(ForEachRecordInBlock(
+        block, [&record_callback, &callback_status](
+                   const SortedSnapshotRecordHeader&, std::string_view key,
+                   std::string_view record_bytes) {
+          callback_status = record_callback(key, record_bytes);
+          return callback_status.ok();
+        }));
+    PS_RETURN_IF_ERROR(callback_status);
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace kv_server
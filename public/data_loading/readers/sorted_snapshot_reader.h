@@ -0,0 +1,89 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_DATA_LOADING_READERS_SORTED_SNAPSHOT_READER_H_
+#define PUBLIC_DATA_LOADING_READERS_SORTED_SNAPSHOT_READER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "public/data_loading/riegeli_metadata.pb.h"
+#include "public/data_loading/sorted_snapshot_format.h"
+
+namespace kv_server {
+
+// A `SortedSnapshotReader` serves point lookups from a sorted snapshot file,
+// see `sorted_snapshot_format.h`, written by `SortedSnapshotWriter`.
+//
+// The file is memory mapped, so only the index, the Bloom filters and the
+// blocks that lookups touch are paged in, and pages can be reclaimed by the
+// kernel under memory pressure. Opening a file validates its footer and
+// index, but not its records.
+//
+// This class is thread safe.
+class SortedSnapshotReader {
+ public:
+  ~SortedSnapshotReader();
+  SortedSnapshotReader(const SortedSnapshotReader&) = delete;
+  SortedSnapshotReader& operator=(const SortedSnapshotReader&) = delete;
+
+  static absl::StatusOr<std::unique_ptr<SortedSnapshotReader>> Open(
+      const std::string& path);
+
+  // Returns the serialized `KeyValueMutationRecord` of `key`, or an empty
+  // string_view if the snapshot does not contain `key`. The returned bytes
+  // point into the mapped file, are valid as long as this reader is, and must
+  // be verified when deserialized, e.g., by `DeserializeRecord()`.
+  std::string_view FindRecord(std::string_view key) const;
+
+  // Calls `record_callback` with the key and the serialized
+  // `KeyValueMutationRecord` of every record in the snapshot, in file order.
+  absl::Status ReadRecords(
+      const std::function<absl::Status(std::string_view key,
+                                       std::string_view record_bytes)>&
+          record_callback) const;
+
+  const KVFileMetadata& GetMetadata() const { return metadata_; }
+  int64_t NumRecords() const { return num_records_; }
+  // Returns the size of the mapped file.
+  int64_t FileSize() const { return size_; }
+
+ private:
+  SortedSnapshotReader(const char* data, size_t size);
+
+  absl::Status Initialize();
+  // Calls `fn(header, key, record_bytes)` for each record of `block`, until
+  // `fn` returns false.
+  template <typename Fn>
+  absl::Status ForEachRecordInBlock(const SortedSnapshotBlockHandle& block,
+                                    Fn&& fn) const;
+
+  const char* data_;
+  const size_t size_;
+  absl::Span<const SortedSnapshotBlockHandle> index_;
+  int num_filter_hashes_ = 0;
+  int64_t num_records_ = 0;
+  KVFileMetadata metadata_;
+};
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_READERS_SORTED_SNAPSHOT_READER_H_
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/readers/sorted_snapshot_reader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/record_utils.h"
+#include "public/data_loading/writers/sorted_snapshot_writer.h"
+
+namespace kv_server {
+namespace {
+
+std::string GetSnapshotPath() {
+  // Names of parameterized tests contain slashes.
+  return absl::StrCat(
+      ::testing::TempDir(), "/",
+      absl::StrReplaceAll(
+          ::testing::UnitTest::GetInstance()->current_test_info()->name(),
+          {{"/", "_"}}));
+}
+
+// Returns `num_keys` keys in the order in which they are stored in sorted
+// snapshots.
+std::vector<std::string> GetSortedKeys(int num_keys) {
+  std::vector<std::string> keys;
+  for (int i = 0; i < num_keys; ++i) {
+    keys.push_back(absl::StrCat("key", i));
+  }
+  std::sort(keys.begin(), keys.end(),
+            [](const std::string& left, const std::string& right) {
+              return std::make_pair(SortedSnapshotKeyFingerprint(left), left) <
+                     std::make_pair(SortedSnapshotKeyFingerprint(right), right);
+            });
+  return keys;
+}
+
+void WriteSnapshot(const std::string& path,
+                   const std::vector<std::string>& keys,
+                   SortedSnapshotBlockOptions block_options = {}) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  KVFileMetadata metadata;
+  metadata.mutable_snapshot()->set_starting_file("DELTA_0000000000000001");
+  auto writer = SortedSnapshotWriter::Create(
+      file, DeltaRecordWriter::Options{.metadata = metadata}, block_options);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  for (const auto& key : keys) {
+    KeyValueMutationRecordT record = {
+        .mutation_type = KeyValueMutationType::Update,
+        .logical_commit_time = 10,
+        .key = key,
+    };
+    record.value.Set(StringValueT{.value = absl::StrCat("value-", key)});
+    DataRecordT data_record;
+    data_record.record.Set(std::move(record));
+    ASSERT_TRUE((*writer)->WriteRecord(data_record).ok());
+  }
+  (*writer)->Close();
+  ASSERT_TRUE((*writer)->Status().ok());
+}
+
+std::string GetStringValue(std::string_view record_bytes) {
+  std::string value;
+  auto status = DeserializeRecord(
+      record_bytes, [&value](const KeyValueMutationRecordT& record) {
+        value = record.value.AsStringValue()->value;
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  return value;
+}
+
+class SortedSnapshotReaderTest : public testing::TestWithParam<int64_t> {};
+
+INSTANTIATE_TEST_SUITE_P(BlockSizes, SortedSnapshotReaderTest,
+                         testing::Values(1, 256, 4096, 1 << 20));
+
+TEST_P(SortedSnapshotReaderTest, FindsAllWrittenKeys) {
+  const auto keys = GetSortedKeys(1000);
+  WriteSnapshot(GetSnapshotPath(), keys,
+                SortedSnapshotBlockOptions{.block_size_bytes = GetParam()});
+  auto reader = SortedSnapshotReader::Open(GetSnapshotPath());
+  ASSERT_TRUE(reader.ok()) << reader.status();
+  EXPECT_EQ((*reader)->NumRecords(), keys.size());
+  EXPECT_EQ((*reader)->GetMetadata().snapshot().starting_file(),
+            "DELTA_0000000000000001");
+  for (const auto& key : keys) {
+    auto record_bytes = (*reader)->FindRecord(key);
+    ASSERT_FALSE(record_bytes.empty()) << key;
+    EXPECT_EQ(GetStringValue(record_bytes), absl::StrCat("value-", key));
+  }
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_TRUE((*reader)->FindRecord(absl::StrCat("missing", i)).empty());
+  }
+}
+
+TEST_P(SortedSnapshotReaderTest, ReadsRecordsInFileOrder) {
+  const auto keys = GetSortedKeys(100);
+  WriteSnapshot(GetSnapshotPath(), keys,
+                SortedSnapshotBlockOptions{.block_size_bytes = GetParam()});
+  auto reader = SortedSnapshotReader::Open(GetSnapshotPath());
+  ASSERT_TRUE(reader.ok()) << reader.status();
+  std::vector<std::string> read_keys;
+  EXPECT_TRUE((*reader)
+                  ->ReadRecords([&read_keys](std::string_view key,
+                                             std::string_view record_bytes) {
+                    EXPECT_EQ(GetStringValue(record_bytes),
+                              absl::StrCat("value-", key));
+                    read_keys.emplace_back(key);
+                    return absl::OkStatus();
+                  })
+                  .ok());
+  EXPECT_EQ(read_keys, keys);
+}
+
+TEST(SortedSnapshotReaderTest, ReadsEmptySnapshot) {
+  WriteSnapshot(GetSnapshotPath(), {});
+  auto reader = SortedSnapshotReader::Open(GetSnapshotPath());
+  ASSERT_TRUE(reader.ok()) << reader.status();
+  EXPECT_EQ((*reader)->NumRecords(), 0);
+  EXPECT_TRUE((*reader)->FindRecord("key").empty());
+}
+
+TEST(SortedSnapshotReaderTest, ReadRecordsStopsOnCallbackError) {
+  WriteSnapshot(GetSnapshotPath(), GetSortedKeys(10));
+  auto reader = SortedSnapshotReader::Open(GetSnapshotPath());
+  ASSERT_TRUE(reader.ok()) << reader.status();
+  int num_calls = 0;
+  auto status = (*reader)->ReadRecords(
+      [&num_calls](std::string_view, std::string_view) {
+        ++num_calls;
+        return absl::InternalError("Callback failed.");
+      });
+  EXPECT_EQ(status.code(), absl::StatusCode::kInternal);
+  EXPECT_EQ(num_calls, 1);
+}
+
+TEST(SortedSnapshotReaderTest, FailsToOpenMissingFile) {
+  auto reader = SortedSnapshotReader::Open(GetSnapshotPath());
+  EXPECT_EQ(reader.status().code(), absl::StatusCode::kNotFound);
+}
+
+TEST(SortedSnapshotReaderTest, FailsToOpenTruncatedFile) {
+  const std::string path = GetSnapshotPath();
+  WriteSnapshot(path, GetSortedKeys(100));
+  std::string contents;
+  {
+    std::ifstream file(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(file), {});
+  }
+  std::ofstream(path, std::ios::binary | std::ios::trunc)
+      .write(contents.data(), contents.size() / 2);
+  auto reader = SortedSnapshotReader::Open(path);
+  EXPECT_EQ(reader.status().code(), absl::StatusCode::kDataLoss);
+}
+
+TEST(SortedSnapshotReaderTest, FailsToOpenFileWithCorruptedIndex) {
+  const std::string path = GetSnapshotPath();
+  WriteSnapshot(path, GetSortedKeys(100),
+                SortedSnapshotBlockOptions{.block_size_bytes = 1});
+  std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+  file.seekg(-static_cast<int>(sizeof(SortedSnapshotFooter)), std::ios::end);
+  SortedSnapshotFooter footer;
+  file.read(reinterpret_cast<char*>(&footer), sizeof(footer));
+  // Swaps the first two blocks, so that their fingerprints are out of order.
+  SortedSnapshotBlockHandle blocks[2];
+  file.seekg(footer.index_offset);
+  file.read(reinterpret_cast<char*>(blocks), sizeof(blocks));
+  std::swap(blocks[0], blocks[1]);
+  file.seekp(footer.index_offset);
+  file.write(reinterpret_cast<const char*>(blocks), sizeof(blocks));
+  file.close();
+  auto reader = SortedSnapshotReader::Open(path);
+  EXPECT_EQ(reader.status().code(), absl::StatusCode::kDataLoss);
+}
+
+}  // namespace
+}  // namespace kv_server
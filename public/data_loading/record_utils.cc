@@ -234,6 +234,46 @@ absl::StatusOr<std::vector<uint64_t>> MaybeGetRecordValue(
                                maybe_value->value()->end());
 }
 
+template <>
+absl::StatusOr<
+    const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>*>
+MaybeGetRecordValue(const KeyValueMutationRecord& record) {
+  const kv_server::StringSet* maybe_value = record.value_as_StringSet();
+  if (!maybe_value || !maybe_value->value()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "KeyValueMutationRecord does not contain expected value type. "
+        "Expected: StringSet",
+        ". Actual: ", EnumNameValue(record.value_type())));
+  }
+  return maybe_value->value();
+}
+
+template <>
+absl::StatusOr<const flatbuffers::Vector<uint32_t>*> MaybeGetRecordValue(
+    const KeyValueMutationRecord& record) {
+  const kv_server::UInt32Set* maybe_value = record.value_as_UInt32Set();
+  if (!maybe_value || !maybe_value->value()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "KeyValueMutationRecord does not contain expected value type. "
+        "Expected: UInt32Set",
+        ". Actual: ", EnumNameValue(record.value_type())));
+  }
+  return maybe_value->value();
+}
+
+template <>
+absl::StatusOr<const flatbuffers::Vector<uint64_t>*> MaybeGetRecordValue(
+    const KeyValueMutationRecord& record) {
+  const kv_server::UInt64Set* maybe_value = record.value_as_UInt64Set();
+  if (!maybe_value || !maybe_value->value()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "KeyValueMutationRecord does not contain expected value type. "
+        "Expected: UInt64Set",
+        ". Actual: ", EnumNameValue(record.value_type())));
+  }
+  return maybe_value->value();
+}
+
 absl::StatusOr<KVFileMetadata> GetKVFileMetadataFromString(
     std::string_view serialized_metadata) {
   KVFileMetadata metadata;
@@ -242,6 +242,28 @@ template <>
 absl::StatusOr<std::vector<uint64_t>> MaybeGetRecordValue(
     const KeyValueMutationRecord& record);
 
+// Returns a view over the strings stored in `record.value` without copying
+// them. The view is only valid as long as `record` is. Returns error if the
+// record.value is not a string set.
+template <>
+absl::StatusOr<
+    const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>*>
+MaybeGetRecordValue(const KeyValueMutationRecord& record);
+
+// Returns a view over the uint32_t values stored in `record.value` without
+// copying them. The view is only valid as long as `record` is. Returns error if
+// the record.value is not a uint32_t set.
+template <>
+absl::StatusOr<const flatbuffers::Vector<uint32_t>*> MaybeGetRecordValue(
+    const KeyValueMutationRecord& record);
+
+// Returns a view over the uint64_t values stored in `record.value` without
+// copying them. The view is only valid as long as `record` is. Returns error if
+// the record.value is not a uint64_t set.
+template <>
+absl::StatusOr<const flatbuffers::Vector<uint64_t>*> MaybeGetRecordValue(
+    const KeyValueMutationRecord& record);
+
 absl::StatusOr<KVFileMetadata> GetKVFileMetadataFromString(
     std::string_view serialized_metadata);
 
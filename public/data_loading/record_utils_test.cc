@@ -140,6 +140,64 @@ TEST(RecordUtilsTest, KeyValueMutationRecordWithStringSetValue) {
   EXPECT_TRUE(status.ok()) << status;
 }
 
+TEST(RecordUtilsTest, KeyValueMutationRecordSetValueViews) {
+  KeyValueMutationRecordT string_set_record;
+  string_set_record.key = "key";
+  string_set_record.value.Set(StringSetT{.value = {"value1", "value2"}});
+  auto [string_set_buffer, string_set_bytes] = Serialize(string_set_record);
+  auto status = DeserializeRecord(
+      string_set_bytes, [](const KeyValueMutationRecord& fbs_record) {
+        auto maybe_values = MaybeGetRecordValue<const flatbuffers::Vector<
+            flatbuffers::Offset<flatbuffers::String>>*>(fbs_record);
+        EXPECT_TRUE(maybe_values.ok()) << maybe_values.status();
+        std::vector<std::string_view> values;
+        for (const auto* value : **maybe_values) {
+          values.push_back(value->string_view());
+        }
+        EXPECT_THAT(values, testing::ElementsAre("value1", "value2"));
+        EXPECT_FALSE(
+            MaybeGetRecordValue<const flatbuffers::Vector<uint32_t>*>(
+                fbs_record)
+                .ok());
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+
+  KeyValueMutationRecordT uint32_set_record;
+  uint32_set_record.key = "key";
+  uint32_set_record.value.Set(UInt32SetT{.value = {1, 2, 3}});
+  auto [uint32_set_buffer, uint32_set_bytes] = Serialize(uint32_set_record);
+  status = DeserializeRecord(
+      uint32_set_bytes, [](const KeyValueMutationRecord& fbs_record) {
+        auto maybe_values =
+            MaybeGetRecordValue<const flatbuffers::Vector<uint32_t>*>(
+                fbs_record);
+        EXPECT_TRUE(maybe_values.ok()) << maybe_values.status();
+        EXPECT_THAT(std::vector<uint32_t>((*maybe_values)->begin(),
+                                          (*maybe_values)->end()),
+                    testing::ElementsAre(1, 2, 3));
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+
+  KeyValueMutationRecordT uint64_set_record;
+  uint64_set_record.key = "key";
+  uint64_set_record.value.Set(UInt64SetT{.value = {4, 5}});
+  auto [uint64_set_buffer, uint64_set_bytes] = Serialize(uint64_set_record);
+  status = DeserializeRecord(
+      uint64_set_bytes, [](const KeyValueMutationRecord& fbs_record) {
+        auto maybe_values =
+            MaybeGetRecordValue<const flatbuffers::Vector<uint64_t>*>(
+                fbs_record);
+        EXPECT_TRUE(maybe_values.ok()) << maybe_values.status();
+        EXPECT_THAT(std::vector<uint64_t>((*maybe_values)->begin(),
+                                          (*maybe_values)->end()),
+                    testing::ElementsAre(4, 5));
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+}
+
 TEST(RecordUtilsTest, DataRecordWithKeyValueMutationRecordWithStringValue) {
   // Serialize
   KeyValueMutationRecordT kv_mutation_record_native;
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/sorted_snapshot_format.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace kv_server {
+namespace {
+
+// Bloom filter probes are derived from the fingerprint by double hashing, see
+// "Less Hashing, Same Performance: Building a Better Bloom Filter".
+uint64_t GetBloomFilterHashDelta(uint64_t hash) {
+  return (hash >> 32) | (hash << 32);
+}
+
+}  // namespace
+
+int64_t SortedSnapshotKeyFingerprint(std::string_view key) {
+  // 64 bit FNV-1a, followed by the MurmurHash3 finalizer to spread the bits.
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : key) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return static_cast<int64_t>(hash);
+}
+
+int GetSortedSnapshotBloomFilterNumHashes(int64_t bits_per_key) {
+  // ln(2) * bits_per_key minimizes the false positive rate.
+  return std::clamp(static_cast<int>(std::lround(bits_per_key * 0.69)), 1, 30);
+}
+
+void AddToSortedSnapshotBloomFilter(int64_t fingerprint, int num_hashes,
+                                    absl::Span<uint64_t> filter) {
+  const uint64_t num_bits = filter.size() * 64;
+  uint64_t hash = static_cast<uint64_t>(fingerprint);
+  const uint64_t delta = GetBloomFilterHashDelta(hash);
+  for (int i = 0; i < num_hashes && num_bits > 0; ++i) {
+    const uint64_t bit = hash % num_bits;
+    filter[bit / 64] |= uint64_t{1} << (bit % 64);
+    hash += delta;
+  }
+}
+
+bool SortedSnapshotBloomFilterMayContain(int64_t fingerprint, int num_hashes,
+                                         absl::Span<const uint64_t> filter) {
+  const uint64_t num_bits = filter.size() * 64;
+  uint64_t hash = static_cast<uint64_t>(fingerprint);
+  const uint64_t delta = GetBloomFilterHashDelta(hash);
+  for (int i = 0; i < num_hashes && num_bits > 0; ++i) {
+    const uint64_t bit = hash % num_bits;
+    if (((filter[bit / 64] >> (bit % 64)) & uint64_t{1}) == 0) {
+      return false;
+    }
+    hash += delta;
+  }
+  return true;
+}
+
+}  // namespace kv_server
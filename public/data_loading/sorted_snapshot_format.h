@@ -0,0 +1,120 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_DATA_LOADING_SORTED_SNAPSHOT_FORMAT_H_
+#define PUBLIC_DATA_LOADING_SORTED_SNAPSHOT_FORMAT_H_
+
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#include "absl/types/span.h"
+
+namespace kv_server {
+
+// Layout of sorted snapshot files, which can be served straight from a
+// memory mapped file, without loading them into a cache first.
+//
+// A sorted snapshot file contains serialized `KeyValueMutationRecord`s
+// ordered by `(SortedSnapshotKeyFingerprint(key), key)`, grouped into blocks:
+//
+// ```
+//  kSortedSnapshotMagic
+//  records of block 0, Bloom filter of block 0
+//  ...
+//  records of block n - 1, Bloom filter of block n - 1
+//  serialized KVFileMetadata
+//  index: SortedSnapshotBlockHandle[n]
+//  SortedSnapshotFooter
+// ```
+//
+// Each record is a `SortedSnapshotRecordHeader` followed by the key and the
+// serialized record. The sparse index holds the first fingerprint of each
+// block, so a lookup binary searches the index, checks the Bloom filter of a
+// single block and only then scans that block. Records with the same
+// fingerprint are never split across blocks. All sections and serialized
+// records start at 8 byte aligned offsets, and integers are stored in little
+// endian byte order.
+inline constexpr std::string_view kSortedSnapshotMagic = "KVSORTED";
+inline constexpr uint32_t kSortedSnapshotFormatVersion = 1;
+inline constexpr int64_t kSortedSnapshotAlignment = 8;
+
+struct SortedSnapshotRecordHeader {
+  int64_t fingerprint;
+  uint32_t key_size;
+  uint32_t record_size;
+};
+
+struct SortedSnapshotBlockHandle {
+  int64_t first_fingerprint;
+  uint64_t offset;
+  uint64_t size;
+  uint64_t filter_offset;
+  uint64_t filter_size;
+};
+
+struct SortedSnapshotFooter {
+  uint64_t index_offset;
+  uint64_t num_blocks;
+  uint64_t metadata_offset;
+  uint64_t metadata_size;
+  uint64_t num_records;
+  uint32_t num_filter_hashes;
+  uint32_t version;
+  char magic[8];
+};
+
+static_assert(std::is_trivially_copyable_v<SortedSnapshotRecordHeader> &&
+              sizeof(SortedSnapshotRecordHeader) == 16);
+static_assert(std::is_trivially_copyable_v<SortedSnapshotBlockHandle> &&
+              sizeof(SortedSnapshotBlockHandle) == 40);
+static_assert(std::is_trivially_copyable_v<SortedSnapshotFooter> &&
+              sizeof(SortedSnapshotFooter) == 56);
+
+struct SortedSnapshotBlockOptions {
+  // A new block is started once the current one holds at least this many
+  // bytes of records.
+  int64_t block_size_bytes = 4096;
+  // ~1% false positives for 10 bits per key.
+  int64_t bloom_filter_bits_per_key = 10;
+};
+
+// Returns a fingerprint of `key` that is stable across processes and
+// releases, unlike `absl::Hash`, since it determines the order of records in
+// sorted snapshot files.
+int64_t SortedSnapshotKeyFingerprint(std::string_view key);
+
+// Returns the number of bits set per key in Bloom filters with
+// `bits_per_key` bits per key.
+int GetSortedSnapshotBloomFilterNumHashes(int64_t bits_per_key);
+
+// Adds `fingerprint` to the Bloom filter stored in `filter`.
+void AddToSortedSnapshotBloomFilter(int64_t fingerprint, int num_hashes,
+                                    absl::Span<uint64_t> filter);
+
+// Returns false if `fingerprint` was definitely not added to `filter`.
+bool SortedSnapshotBloomFilterMayContain(int64_t fingerprint, int num_hashes,
+                                         absl::Span<const uint64_t> filter);
+
+// Returns `offset` rounded up to `kSortedSnapshotAlignment`.
+inline uint64_t AlignSortedSnapshotOffset(uint64_t offset) {
+  return (offset + kSortedSnapshotAlignment - 1) &
+         ~static_cast<uint64_t>(kSortedSnapshotAlignment - 1);
+}
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_SORTED_SNAPSHOT_FORMAT_H_
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/sorted_snapshot_format.h"
+
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(SortedSnapshotFormatTest, KeyFingerprintIsStable) {
+  // Changing fingerprints breaks lookups in existing sorted snapshot files.
+  EXPECT_EQ(SortedSnapshotKeyFingerprint(""), -1166397803181037274);
+  EXPECT_EQ(SortedSnapshotKeyFingerprint("key"), -3491282005168279504);
+}
+
+TEST(SortedSnapshotFormatTest, BloomFilterHasNoFalseNegatives) {
+  constexpr int kNumKeys = 1000;
+  const int num_hashes = GetSortedSnapshotBloomFilterNumHashes(10);
+  std::vector<uint64_t> filter(kNumKeys * 10 / 64 + 1);
+  for (int i = 0; i < kNumKeys; ++i) {
+    AddToSortedSnapshotBloomFilter(
+        SortedSnapshotKeyFingerprint(absl::StrCat("key", i)), num_hashes,
+        absl::MakeSpan(filter));
+  }
+  int num_false_positives = 0;
+  for (int i = 0; i < kNumKeys; ++i) {
+    EXPECT_TRUE(SortedSnapshotBloomFilterMayContain(
+        SortedSnapshotKeyFingerprint(absl::StrCat("key", i)), num_hashes,
+        filter));
+    num_false_positives += SortedSnapshotBloomFilterMayContain(
+        SortedSnapshotKeyFingerprint(absl::StrCat("missing", i)), num_hashes,
+        filter);
+  }
+  // ~1% is expected for 10 bits per key.
+  EXPECT_LT(num_false_positives, kNumKeys / 20);
+}
+
+TEST(SortedSnapshotFormatTest, AlignsOffsets) {
+  EXPECT_EQ(AlignSortedSnapshotOffset(0), 0);
+  EXPECT_EQ(AlignSortedSnapshotOffset(1), 8);
+  EXPECT_EQ(AlignSortedSnapshotOffset(8), 8);
+  EXPECT_EQ(AlignSortedSnapshotOffset(9), 16);
+}
+
+}  // namespace
+}  // namespace kv_server
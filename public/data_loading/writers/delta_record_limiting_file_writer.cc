@@ -15,13 +15,16 @@
 #include "public/data_loading/writers/delta_record_limiting_file_writer.h"
 
 #include "absl/log/log.h"
+#include "public/data_loading/writers/record_compression.h"
 
 namespace kv_server {
 
 riegeli::RecordWriterBase::Options GetRecordWriterOptions(
     const DeltaRecordWriter::Options& options) {
   riegeli::RecordWriterBase::Options writer_options;
-  if (!options.enable_compression) {
+  if (options.enable_compression) {
+    SetRecordCompression(options.compression, writer_options);
+  } else {
     writer_options.set_uncompressed();
   }
   riegeli::RecordsMetadata metadata;
@@ -14,6 +14,7 @@
 
 #include "public/data_loading/writers/delta_record_stream_writer.h"
 
+#include "public/data_loading/writers/record_compression.h"
 #include "riegeli/bytes/ostream_writer.h"
 #include "riegeli/records/record_writer.h"
 
@@ -21,7 +22,9 @@ namespace kv_server {
 riegeli::RecordWriterBase::Options GetRecordWriterOptions(
     const DeltaRecordWriter::Options& options) {
   riegeli::RecordWriterBase::Options writer_options;
-  if (!options.enable_compression) {
+  if (options.enable_compression) {
+    SetRecordCompression(options.compression, writer_options);
+  } else {
     writer_options.set_uncompressed();
   }
   riegeli::RecordsMetadata metadata;
@@ -51,7 +51,19 @@ INSTANTIATE_TEST_SUITE_P(
     testing::Values(DeltaRecordWriter::Options{.enable_compression = false,
                                                .metadata = GetMetadata()},
                     DeltaRecordWriter::Options{.enable_compression = true,
-                                               .metadata = GetMetadata()}));
+                                               .metadata = GetMetadata()},
+                    DeltaRecordWriter::Options{
+                        .enable_compression = true,
+                        .metadata = GetMetadata(),
+                        .compression = {.algorithm =
+                                            RecordCompression::Algorithm::kZstd,
+                                        .level = 9}},
+                    DeltaRecordWriter::Options{
+                        .enable_compression = true,
+                        .metadata = GetMetadata(),
+                        .compression = {
+                            .algorithm =
+                                RecordCompression::Algorithm::kSnappy}}));
 
 TEST_P(DeltaRecordStreamWriterTest,
        ValidateWritingAndReadingWithKVMutationDeltaStream) {
@@ -23,6 +23,7 @@
 #include "absl/status/status.h"
 #include "public/data_loading/record_utils.h"
 #include "public/data_loading/riegeli_metadata.pb.h"
+#include "public/data_loading/writers/record_compression.h"
 
 namespace kv_server {
 
@@ -57,6 +58,10 @@ class DeltaRecordWriter {
 
     // Metadata required for delta files.
     KVFileMetadata metadata;
+
+    // Compression of records if `enable_compression` is true. Only applies to
+    // riegeli files.
+    RecordCompression compression;
   };
   virtual ~DeltaRecordWriter() = default;
 
@@ -0,0 +1,144 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "public/data_loading/writers/record_compression.h"
+
+#include <utility>
+
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+
+namespace kv_server {
+namespace {
+
+constexpr std::string_view kNone = "none";
+constexpr std::string_view kBrotli = "brotli";
+constexpr std::string_view kZstd = "zstd";
+constexpr std::string_view kSnappy = "snappy";
+
+constexpr std::pair<int, int> kBrotliLevels = {0, 11};
+constexpr std::pair<int, int> kZstdLevels = {-32, 22};
+
+std::string_view AlgorithmName(RecordCompression::Algorithm algorithm) {
+  switch (algorithm) {
+    case RecordCompression::Algorithm::kNone:
+      return kNone;
+    case RecordCompression::Algorithm::kBrotli:
+      return kBrotli;
+    case RecordCompression::Algorithm::kZstd:
+      return kZstd;
+    case RecordCompression::Algorithm::kSnappy:
+      return kSnappy;
+  }
+  return "";
+}
+
+}  // namespace
+
+absl::StatusOr<RecordCompression> ParseRecordCompression(
+    std::string_view text) {
+  std::pair<std::string, std::string> parts =
+      absl::StrSplit(text, absl::MaxSplits(':', 1));
+  RecordCompression compression;
+  std::optional<std::pair<int, int>> levels;
+  if (parts.first == kNone) {
+    compression.algorithm = RecordCompression::Algorithm::kNone;
+  } else if (parts.first == kBrotli) {
+    compression.algorithm = RecordCompression::Algorithm::kBrotli;
+    levels = kBrotliLevels;
+  } else if (parts.first == kZstd) {
+    compression.algorithm = RecordCompression::Algorithm::kZstd;
+    levels = kZstdLevels;
+  } else if (parts.first == kSnappy) {
+    compression.algorithm = RecordCompression::Algorithm::kSnappy;
+  } else {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unknown compression algorithm: ", parts.first));
+  }
+  if (parts.second.empty()) {
+    if (absl::StrContains(text, ':')) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Missing compression level: ", text));
+    }
+    return compression;
+  }
+  if (!levels.has_value()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Compression ", parts.first, " does not support levels."));
+  }
+  int level;
+  if (!absl::SimpleAtoi(parts.second, &level) || level < levels->first ||
+      level > levels->second) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Compression level of %s must be between %d and %d.",
+                        parts.first, levels->first, levels->second));
+  }
+  compression.level = level;
+  return compression;
+}
+
+std::string RecordCompressionToString(const RecordCompression& compression) {
+  if (!compression.level.has_value()) {
+    return std::string(AlgorithmName(compression.algorithm));
+  }
+  return absl::StrCat(AlgorithmName(compression.algorithm), ":",
+                      *compression.level);
+}
+
+void SetRecordCompression(const RecordCompression& compression,
+                          riegeli::RecordWriterBase::Options& writer_options) {
+  switch (compression.algorithm) {
+    case RecordCompression::Algorithm::kNone:
+      writer_options.set_uncompressed();
+      return;
+    case RecordCompression::Algorithm::kBrotli:
+      if (compression.level.has_value()) {
+        writer_options.set_brotli(*compression.level);
+      } else {
+        writer_options.set_brotli();
+      }
+      return;
+    case RecordCompression::Algorithm::kZstd:
+      if (compression.level.has_value()) {
+        writer_options.set_zstd(*compression.level);
+      } else {
+        writer_options.set_zstd();
+      }
+      return;
+    case RecordCompression::Algorithm::kSnappy:
+      writer_options.set_snappy();
+      return;
+  }
+}
+
+bool AbslParseFlag(absl::string_view text, RecordCompression* compression,
+                   std::string* error) {
+  auto parsed_compression =
+      ParseRecordCompression(std::string_view(text.data(), text.size()));
+  if (!parsed_compression.ok()) {
+    *error = std::string(parsed_compression.status().message());
+    return false;
+  }
+  *compression = *std::move(parsed_compression);
+  return true;
+}
+
+std::string AbslUnparseFlag(const RecordCompression& compression) {
+  return RecordCompressionToString(compression);
+}
+
+}  // namespace kv_server
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_DATA_LOADING_WRITERS_RECORD_COMPRESSION_H_
+#define PUBLIC_DATA_LOADING_WRITERS_RECORD_COMPRESSION_H_
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/records/record_writer.h"
+
+namespace kv_server {
+
+// Compression of the chunks of riegeli data files. Readers do not need to be
+// configured, because riegeli records the compression of each chunk.
+struct RecordCompression {
+  enum class Algorithm { kNone, kBrotli, kZstd, kSnappy };
+
+  // Defaults to brotli, riegeli's default compression.
+  Algorithm algorithm = Algorithm::kBrotli;
+  // Compression level of brotli (0 to 11) or zstd (-32 to 22). Higher levels
+  // compress better but write slower. Decoding speed mostly depends on the
+  // algorithm. If unset, riegeli's default level of the algorithm is used.
+  std::optional<int> level;
+};
+
+// Parses a compression formatted as "<algorithm>[:<level>]", where algorithm
+// is one of "none", "brotli", "zstd" or "snappy", e.g., "zstd:3".
+absl::StatusOr<RecordCompression> ParseRecordCompression(std::string_view text);
+
+// Formats `compression` such that `ParseRecordCompression` parses it back.
+std::string RecordCompressionToString(const RecordCompression& compression);
+
+// Sets the compression of `writer_options` to `compression`.
+void SetRecordCompression(const RecordCompression& compression,
+                          riegeli::RecordWriterBase::Options& writer_options);
+
+bool AbslParseFlag(absl::string_view text, RecordCompression* compression,
+                   std::string* error);
+
+std::string AbslUnparseFlag(const RecordCompression& compression);
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_WRITERS_RECORD_COMPRESSION_H_
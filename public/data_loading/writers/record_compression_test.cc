@@ -0,0 +1,69 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "public/data_loading/writers/record_compression.h"
+
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(RecordCompressionTest, ParsesAlgorithms) {
+  auto compression = ParseRecordCompression("none");
+  ASSERT_TRUE(compression.ok()) << compression.status();
+  EXPECT_EQ(compression->algorithm, RecordCompression::Algorithm::kNone);
+  compression = ParseRecordCompression("brotli");
+  ASSERT_TRUE(compression.ok()) << compression.status();
+  EXPECT_EQ(compression->algorithm, RecordCompression::Algorithm::kBrotli);
+  EXPECT_FALSE(compression->level.has_value());
+  compression = ParseRecordCompression("zstd");
+  ASSERT_TRUE(compression.ok()) << compression.status();
+  EXPECT_EQ(compression->algorithm, RecordCompression::Algorithm::kZstd);
+  compression = ParseRecordCompression("snappy");
+  ASSERT_TRUE(compression.ok()) << compression.status();
+  EXPECT_EQ(compression->algorithm, RecordCompression::Algorithm::kSnappy);
+}
+
+TEST(RecordCompressionTest, ParsesLevels) {
+  auto compression = ParseRecordCompression("zstd:-5");
+  ASSERT_TRUE(compression.ok()) << compression.status();
+  EXPECT_EQ(compression->algorithm, RecordCompression::Algorithm::kZstd);
+  EXPECT_EQ(compression->level, -5);
+  compression = ParseRecordCompression("brotli:11");
+  ASSERT_TRUE(compression.ok()) << compression.status();
+  EXPECT_EQ(compression->algorithm, RecordCompression::Algorithm::kBrotli);
+  EXPECT_EQ(compression->level, 11);
+}
+
+TEST(RecordCompressionTest, RejectsInvalidCompressions) {
+  for (std::string_view text :
+       {"", "gzip", "zstd:", "zstd:fast", "zstd:23", "brotli:-1", "brotli:12",
+        "snappy:1", "none:0"}) {
+    EXPECT_EQ(ParseRecordCompression(text).status().code(),
+              absl::StatusCode::kInvalidArgument)
+        << text;
+  }
+}
+
+TEST(RecordCompressionTest, FormatsCompressionsThatParseBack) {
+  for (std::string_view text : {"none", "brotli", "brotli:4", "zstd:1",
+                                "zstd:-3", "snappy"}) {
+    auto compression = ParseRecordCompression(text);
+    ASSERT_TRUE(compression.ok()) << compression.status();
+    EXPECT_EQ(RecordCompressionToString(*compression), text);
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -21,21 +21,27 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/hash/hash.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "public/constants.h"
 #include "public/data_loading/aggregation/record_aggregator.h"
+#include "public/data_loading/aggregation/sort_merge_record_aggregator.h"
 #include "public/data_loading/filename_utils.h"
 #include "public/data_loading/readers/delta_record_stream_reader.h"
 #include "public/data_loading/record_utils.h"
 #include "public/data_loading/riegeli_metadata.pb.h"
+#include "public/data_loading/sorted_snapshot_format.h"
 #include "public/data_loading/writers/avro_delta_record_stream_writer.h"
 #include "public/data_loading/writers/delta_record_stream_writer.h"
 #include "public/data_loading/writers/delta_record_writer.h"
+#include "public/data_loading/writers/record_compression.h"
+#include "public/data_loading/writers/sorted_snapshot_writer.h"
 
 namespace kv_server {
 
@@ -79,8 +85,19 @@ class SnapshotStreamWriter {
     std::string temp_data_file;
     // Whether to compress the snapshot stream or not.
     bool compress_snapshot;
+    // Compression of riegeli snapshots if `compress_snapshot` is true.
+    RecordCompression compression;
     // File format.
     FileFormat file_format = FileFormat::kRiegeli;
+    // Whether to aggregate records with a `SortMergeRecordAggregator` instead
+    // of sqlite. Sorted runs are then spilled to files prefixed with
+    // `temp_data_file`, or kept in memory if `temp_data_file` is empty.
+    bool sort_merge_aggregation = false;
+    // Whether to write a sorted snapshot, see `SortedSnapshotWriter`, instead
+    // of a `file_format` snapshot. Sorted snapshots can be served from a
+    // memory mapped file by `SortedSnapshotCache`, but only store key value
+    // mutation records.
+    bool sorted_snapshot = false;
   };
 
   ~SnapshotStreamWriter();
@@ -96,6 +113,19 @@ class SnapshotStreamWriter {
   // delta files generated using `DeltaRecordWriter` instances.
   template <typename SrcStreamT = std::iostream>
   absl::Status WriteRecordStream(SrcStreamT& src_stream);
+  // Writes `data_record`, a record of a base snapshot that later delta records
+  // are merged into. Key value records whose keys are not in `updated_keys`
+  // cannot be changed by the delta records, so they are copied to the output
+  // snapshot stream instead of being aggregated. This way, the cost of
+  // incrementally updating a snapshot scales with the size of the snapshot,
+  // not with the aggregation of all of its records.
+  //
+  // NOTE: `updated_keys` must contain the keys of all key value records that
+  // are written after the base snapshot, and the base snapshot must not
+  // contain duplicate keys, which holds for snapshots written by this class.
+  absl::Status WriteBaseSnapshotRecord(
+      const DataRecordT& data_record,
+      const absl::flat_hash_set<std::string>& updated_keys);
   // Finalizes the snapshot writer and flushes written records and makes them
   // visible in the destination snapshot stream.
   //
@@ -114,10 +144,14 @@ class SnapshotStreamWriter {
                        Options options);
 
   absl::Status InsertOrUpdateRecord(const DataRecordT& record);
+  // Returns the aggregation key of `key`. Aggregated records are read in
+  // increasing aggregation key order, which for sorted snapshots must be the
+  // order of the sorted snapshot.
+  int64_t GetRecordKey(std::string_view key) const;
   template <typename SrcStreamT>
   absl::Status InsertOrUpdateRecords(SrcStreamT& src_stream);
   static absl::StatusOr<std::unique_ptr<RecordAggregator>>
-  CreateRecordAggregator(std::string_view temp_data_file);
+  CreateRecordAggregator(const Options& options);
   static absl::StatusOr<std::unique_ptr<DeltaRecordWriter>>
   CreateDeltaRecordWriter(const Options& options,
                           DestStreamT& dest_snapshot_stream);
@@ -156,7 +190,7 @@ SnapshotStreamWriter<DestStreamT>::Create(const Options& options,
       !status.ok()) {
     return status;
   }
-  auto record_aggregator = CreateRecordAggregator(options.temp_data_file);
+  auto record_aggregator = CreateRecordAggregator(options);
   if (!record_aggregator.ok()) {
     return record_aggregator.status();
   }
@@ -171,6 +205,13 @@ template <typename DestStreamT>
 absl::StatusOr<std::unique_ptr<DeltaRecordWriter>>
 SnapshotStreamWriter<DestStreamT>::CreateDeltaRecordWriter(
     const Options& options, DestStreamT& dest_snapshot_stream) {
+  if (options.sorted_snapshot) {
+    PS_ASSIGN_OR_RETURN(auto record_writer,
+                        SortedSnapshotWriter::Create(
+                            dest_snapshot_stream,
+                            CreateDeltaRecordWriterOptions(options)));
+    return record_writer;
+  }
   switch (options.file_format) {
     case FileFormat::kRiegeli:
       return DeltaRecordStreamWriter<DestStreamT>::Create(
@@ -219,16 +260,31 @@ SnapshotStreamWriter<DestStreamT>::CreateDeltaRecordWriterOptions(
                           "No valid record type specified. ";
           },
       .metadata = options.metadata,
+      .compression = options.compression,
   };
 }
 
 template <typename DestStreamT>
 absl::StatusOr<std::unique_ptr<RecordAggregator>>
 SnapshotStreamWriter<DestStreamT>::CreateRecordAggregator(
-    std::string_view temp_data_file) {
-  return temp_data_file.empty()
+    const Options& options) {
+  if (options.sort_merge_aggregation) {
+    PS_ASSIGN_OR_RETURN(auto record_aggregator,
+                        SortMergeRecordAggregator::Create(
+                            {.run_file_prefix = options.temp_data_file}));
+    return record_aggregator;
+  }
+  return options.temp_data_file.empty()
              ? RecordAggregator::CreateInMemoryAggregator()
-             : RecordAggregator::CreateFileBackedAggregator(temp_data_file);
+             : RecordAggregator::CreateFileBackedAggregator(
+                   options.temp_data_file);
+}
+
+template <typename DestStreamT>
+int64_t SnapshotStreamWriter<DestStreamT>::GetRecordKey(
+    std::string_view key) const {
+  return options_.sorted_snapshot ? SortedSnapshotKeyFingerprint(key)
+                                  : absl::HashOf(key);
 }
 
 template <typename DestStreamT>
@@ -237,7 +293,7 @@ absl::Status SnapshotStreamWriter<DestStreamT>::InsertOrUpdateRecord(
   if (data_record.record.type == Record::KeyValueMutationRecord) {
     const auto* kv_record = data_record.record.AsKeyValueMutationRecord();
     return record_aggregator_->InsertOrUpdateRecord(
-        absl::HashOf(kv_record->key), *kv_record);
+        GetRecordKey(kv_record->key), *kv_record);
   }
   if (data_record.record.type == Record::UserDefinedFunctionsConfig) {
     const auto udf_config = *data_record.record.AsUserDefinedFunctionsConfig();
@@ -276,6 +332,30 @@ absl::Status SnapshotStreamWriter<DestStreamT>::WriteRecord(
   return InsertOrUpdateRecord(data_record);
 }
 
+template <typename DestStreamT>
+absl::Status SnapshotStreamWriter<DestStreamT>::WriteBaseSnapshotRecord(
+    const DataRecordT& data_record,
+    const absl::flat_hash_set<std::string>& updated_keys) {
+  if (is_finalized_) {
+    return absl::FailedPreconditionError(
+        "Cannot write records after finalizing the snapshot.");
+  }
+  // Records of sorted snapshots must be written in order, so they are always
+  // aggregated.
+  if (options_.sorted_snapshot ||
+      data_record.record.type != Record::KeyValueMutationRecord ||
+      updated_keys.contains(
+          data_record.record.AsKeyValueMutationRecord()->key)) {
+    return InsertOrUpdateRecord(data_record);
+  }
+  // By definition, snapshots do NOT contain DELETE mutations.
+  if (data_record.record.AsKeyValueMutationRecord()->mutation_type ==
+      KeyValueMutationType::Delete) {
+    return absl::OkStatus();
+  }
+  return record_writer_->WriteRecord(data_record);
+}
+
 template <typename DestStreamT>
 template <typename SrcStreamT>
 absl::Status SnapshotStreamWriter<DestStreamT>::WriteRecordStream(
@@ -315,7 +395,11 @@ absl::Status SnapshotStreamWriter<DestStreamT>::Finalize() {
       return status;
     }
   }
-  if (absl::Status status = record_writer_->Flush(); !status.ok()) {
+  if (options_.sorted_snapshot) {
+    // The index of a sorted snapshot is only written when closing the writer.
+    record_writer_->Close();
+    PS_RETURN_IF_ERROR(record_writer_->Status());
+  } else if (absl::Status status = record_writer_->Flush(); !status.ok()) {
     return status;
   }
   is_finalized_ = true;
@@ -16,14 +16,22 @@
 
 #include "public/data_loading/writers/snapshot_stream_writer.h"
 
+#include <algorithm>
 #include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
 
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "gmock/gmock.h"
 #include "google/protobuf/util/message_differencer.h"
 #include "gtest/gtest.h"
 #include "public/data_loading/readers/avro_delta_record_stream_reader.h"
 #include "public/data_loading/readers/delta_record_stream_reader.h"
+#include "public/data_loading/readers/sorted_snapshot_reader.h"
 #include "public/data_loading/record_utils.h"
 #include "public/data_loading/writers/delta_record_stream_writer.h"
 #include "public/test_util/data_record.h"
@@ -57,6 +65,57 @@ std::filesystem::path GetRecordAggregatorDbFile() {
   return full_path;
 }
 
+// Returns `num_records` updates and deletes of `num_keys` keys with string
+// and string set values.
+std::vector<DataRecordT> GenerateRecords(int num_records, int num_keys,
+                                         std::mt19937& random) {
+  std::vector<DataRecordT> data_records;
+  for (int i = 0; i < num_records; ++i) {
+    KeyValueMutationRecordT kv_record = {
+        .mutation_type = random() % 5 == 0 ? KeyValueMutationType::Delete
+                                           : KeyValueMutationType::Update,
+        .logical_commit_time = static_cast<int64_t>(random() % 100),
+        .key = absl::StrCat("key", random() % num_keys),
+    };
+    if (random() % 2 == 0) {
+      kv_record.value.Set(GetSimpleStringValue(absl::StrCat("value", i)));
+    } else {
+      kv_record.value.Set(
+          GetStringSetValue({absl::StrCat("value", random() % 10),
+                             absl::StrCat("value", random() % 10)}));
+    }
+    data_records.push_back(GetNativeDataRecord(std::move(kv_record)));
+  }
+  return data_records;
+}
+
+// Returns all records of `record_reader` sorted by key, with sorted set
+// values, so that snapshots can be compared regardless of record order.
+std::vector<DataRecordT> ReadSortedRecords(DeltaRecordReader& record_reader) {
+  std::vector<DataRecordT> data_records;
+  auto status = record_reader.ReadRecords([&data_records](
+                                              const DataRecord& data_record) {
+    std::unique_ptr<DataRecordT> data_record_struct(data_record.UnPack());
+    if (auto* kv_record = data_record_struct->record.AsKeyValueMutationRecord();
+        kv_record != nullptr && kv_record->value.type == Value::StringSet) {
+      auto& values = kv_record->value.AsStringSet()->value;
+      std::sort(values.begin(), values.end());
+    }
+    data_records.push_back(std::move(*data_record_struct));
+    return absl::OkStatus();
+  });
+  EXPECT_TRUE(status.ok()) << status;
+  auto get_key = [](const DataRecordT& data_record) {
+    const auto* kv_record = data_record.record.AsKeyValueMutationRecord();
+    return kv_record == nullptr ? std::string() : kv_record->key;
+  };
+  std::sort(data_records.begin(), data_records.end(),
+            [&get_key](const DataRecordT& a, const DataRecordT& b) {
+              return get_key(a) < get_key(b);
+            });
+  return data_records;
+}
+
 class SnapshotStreamWriterTest
     : public ::testing::TestWithParam<SnapshotWriterOptions> {
  protected:
@@ -110,7 +169,17 @@ INSTANTIATE_TEST_SUITE_P(
         SnapshotWriterOptions{.metadata = GetSnapshotMetadata(),
                               .temp_data_file = GetRecordAggregatorDbFile(),
                               .compress_snapshot = true,
-                              .file_format = FileFormat::kAvro}));
+                              .file_format = FileFormat::kAvro},
+        SnapshotWriterOptions{.metadata = GetSnapshotMetadata(),
+                              .temp_data_file = "",
+                              .compress_snapshot = false,
+                              .file_format = FileFormat::kRiegeli,
+                              .sort_merge_aggregation = true},
+        SnapshotWriterOptions{.metadata = GetSnapshotMetadata(),
+                              .temp_data_file = GetRecordAggregatorDbFile(),
+                              .compress_snapshot = false,
+                              .file_format = FileFormat::kRiegeli,
+                              .sort_merge_aggregation = true}));
 
 TEST_P(SnapshotStreamWriterTest, ValidateThatRecordsAreDedupedInSnapshot) {
   std::stringstream dest_stream;
@@ -375,6 +444,128 @@ TEST_P(SnapshotStreamWriterTest,
   EXPECT_TRUE(status.ok()) << status;
 }
 
+TEST_P(SnapshotStreamWriterTest, IncrementalSnapshotMatchesFullRebuild) {
+  std::mt19937 random(/*seed=*/42);
+  std::stringstream base_snapshot_stream;
+  {
+    auto snapshot_writer = CreateSnapshotWriter(base_snapshot_stream);
+    ASSERT_TRUE(snapshot_writer.ok()) << snapshot_writer.status();
+    auto data_records = GenerateRecords(1000, 200, random);
+    data_records.push_back(
+        GetNativeDataRecord(GetUserDefinedFunctionsConfig()));
+    for (const auto& data_record : data_records) {
+      ASSERT_TRUE((*snapshot_writer)->WriteRecord(data_record).ok());
+    }
+    ASSERT_TRUE((*snapshot_writer)->Finalize().ok());
+  }
+  // Delta records update some of the base snapshot keys and add new ones.
+  const auto delta_records = GenerateRecords(100, 400, random);
+  absl::flat_hash_set<std::string> updated_keys;
+  for (const auto& data_record : delta_records) {
+    updated_keys.insert(data_record.record.AsKeyValueMutationRecord()->key);
+  }
+
+  std::stringstream full_snapshot_stream;
+  std::stringstream incremental_snapshot_stream;
+  for (const bool incremental : {false, true}) {
+    std::stringstream base_stream(base_snapshot_stream.str());
+    std::stringstream& dest_stream =
+        incremental ? incremental_snapshot_stream : full_snapshot_stream;
+    auto snapshot_writer = CreateSnapshotWriter(dest_stream);
+    ASSERT_TRUE(snapshot_writer.ok()) << snapshot_writer.status();
+    auto base_reader = CreateDeltaReader(base_stream);
+    auto status = base_reader->ReadRecords(
+        [&snapshot_writer, &updated_keys,
+         incremental](const DataRecord& data_record) {
+          std::unique_ptr<DataRecordT> data_record_struct(
+              data_record.UnPack());
+          return incremental
+                     ? (*snapshot_writer)
+                           ->WriteBaseSnapshotRecord(*data_record_struct,
+                                                     updated_keys)
+                     : (*snapshot_writer)->WriteRecord(*data_record_struct);
+        });
+    ASSERT_TRUE(status.ok()) << status;
+    for (const auto& data_record : delta_records) {
+      ASSERT_TRUE((*snapshot_writer)->WriteRecord(data_record).ok());
+    }
+    ASSERT_TRUE((*snapshot_writer)->Finalize().ok());
+  }
+
+  auto full_snapshot_reader = CreateDeltaReader(full_snapshot_stream);
+  auto incremental_snapshot_reader =
+      CreateDeltaReader(incremental_snapshot_stream);
+  const auto full_snapshot_records = ReadSortedRecords(*full_snapshot_reader);
+  EXPECT_FALSE(full_snapshot_records.empty());
+  EXPECT_EQ(ReadSortedRecords(*incremental_snapshot_reader),
+            full_snapshot_records);
+}
+
+TEST_P(SnapshotStreamWriterTest,
+       WriteBaseSnapshotRecordFailsAfterFinalizing) {
+  std::stringstream dest_stream;
+  auto snapshot_writer = CreateSnapshotWriter(dest_stream);
+  ASSERT_TRUE(snapshot_writer.ok()) << snapshot_writer.status();
+  ASSERT_TRUE((*snapshot_writer)->Finalize().ok());
+  auto status = (*snapshot_writer)->WriteBaseSnapshotRecord(
+      GetNativeDataRecord(GetKVMutationRecord(GetSimpleStringValue())), {});
+  EXPECT_EQ(status.code(), absl::StatusCode::kFailedPrecondition) << status;
+}
+
+TEST(SnapshotStreamWriterTest, SortedSnapshotMatchesRiegeliSnapshot) {
+  std::mt19937 random(42);
+  const auto data_records = GenerateRecords(1000, 200, random);
+  std::stringstream riegeli_stream;
+  {
+    auto snapshot_writer = SnapshotStreamWriter<std::stringstream>::Create(
+        {.metadata = GetSnapshotMetadata()}, riegeli_stream);
+    ASSERT_TRUE(snapshot_writer.ok()) << snapshot_writer.status();
+    for (const auto& data_record : data_records) {
+      ASSERT_TRUE((*snapshot_writer)->WriteRecord(data_record).ok());
+    }
+    ASSERT_TRUE((*snapshot_writer)->Finalize().ok());
+  }
+  DeltaRecordStreamReader riegeli_reader(riegeli_stream);
+  const auto expected = ReadSortedRecords(riegeli_reader);
+  for (bool sort_merge_aggregation : {false, true}) {
+    const std::string sorted_snapshot_path =
+        absl::StrCat(::testing::TempDir(), "/sorted_snapshot_",
+                     sort_merge_aggregation);
+    {
+      std::ofstream sorted_stream(sorted_snapshot_path, std::ios::binary);
+      auto snapshot_writer = SnapshotStreamWriter<std::ofstream>::Create(
+          {.metadata = GetSnapshotMetadata(),
+           .sort_merge_aggregation = sort_merge_aggregation,
+           .sorted_snapshot = true},
+          sorted_stream);
+      ASSERT_TRUE(snapshot_writer.ok()) << snapshot_writer.status();
+      for (const auto& data_record : data_records) {
+        ASSERT_TRUE((*snapshot_writer)->WriteRecord(data_record).ok());
+      }
+      ASSERT_TRUE((*snapshot_writer)->Finalize().ok());
+    }
+    auto sorted_reader = SortedSnapshotReader::Open(sorted_snapshot_path);
+    ASSERT_TRUE(sorted_reader.ok()) << sorted_reader.status();
+    EXPECT_EQ((*sorted_reader)->NumRecords(), expected.size());
+    EXPECT_EQ((*sorted_reader)->GetMetadata().snapshot().ending_delta_file(),
+              kEndingDeltaFilename);
+    for (const auto& data_record : expected) {
+      const auto& kv_record = *data_record.record.AsKeyValueMutationRecord();
+      auto status = DeserializeRecord(
+          (*sorted_reader)->FindRecord(kv_record.key),
+          [&kv_record](const KeyValueMutationRecordT& sorted_record) {
+            auto record = sorted_record;
+            if (auto* set = record.value.AsStringSet(); set != nullptr) {
+              std::sort(set->value.begin(), set->value.end());
+            }
+            EXPECT_EQ(record, kv_record);
+            return absl::OkStatus();
+          });
+      EXPECT_TRUE(status.ok()) << kv_record.key << ": " << status;
+    }
+  }
+}
+
 TEST(SnapshotStreamWriterTest,
      ValidateCreatingSnapshotWriterWithValidMetadata) {
   std::stringstream dest_stream;
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/writers/sorted_snapshot_writer.h"
+
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+
+namespace kv_server {
+
+SortedSnapshotWriter::SortedSnapshotWriter(
+    std::ostream& dest_stream, Options options,
+    SortedSnapshotBlockOptions block_options)
+    : dest_stream_(dest_stream),
+      options_(std::move(options)),
+      block_options_(block_options),
+      num_filter_hashes_(GetSortedSnapshotBloomFilterNumHashes(
+          block_options.bloom_filter_bits_per_key)) {
+  Write(kSortedSnapshotMagic.data(), kSortedSnapshotMagic.size());
+}
+
+absl::StatusOr<std::unique_ptr<SortedSnapshotWriter>>
+SortedSnapshotWriter::Create(std::ostream& dest_stream, Options options,
+                             SortedSnapshotBlockOptions block_options) {
+  if (block_options.block_size_bytes < 1) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("block_size_bytes %d must be at least 1.",
+                        block_options.block_size_bytes));
+  }
+  if (block_options.bloom_filter_bits_per_key < 1) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("bloom_filter_bits_per_key %d must be at least 1.",
+                        block_options.bloom_filter_bits_per_key));
+  }
+  auto writer = absl::WrapUnique(
+      new SortedSnapshotWriter(dest_stream, std::move(options), block_options));
+  if (!writer->status_.ok()) {
+    return writer->status_;
+  }
+  return writer;
+}
+
+absl::Status SortedSnapshotWriter::WriteRecord(const DataRecordT& data_record) {
+  const auto* kv_record = data_record.record.AsKeyValueMutationRecord();
+  if (kv_record == nullptr) {
+    LOG_FIRST_N(WARNING, 1) << "Sorted snapshots only store key value "
+                               "mutation records. Skipping other records.";
+    return absl::OkStatus();
+  }
+  auto [fbs_buffer, record_bytes] = Serialize(*kv_record);
+  auto status = WriteSerializedRecord(kv_record->key, record_bytes);
+  if (!status.ok() && options_.fb_struct_recovery_function) {
+    options_.fb_struct_recovery_function(data_record);
+  }
+  return status;
+}
+
+absl::Status SortedSnapshotWriter::WriteSerializedRecord(
+    std::string_view key, std::string_view record_bytes) {
+  if (!is_open_) {
+    return absl::FailedPreconditionError(
+        "Cannot write records after closing the writer.");
+  }
+  if (!status_.ok()) {
+    return status_;
+  }
+  if (key.size() > std::numeric_limits<uint32_t>::max() ||
+      record_bytes.size() > std::numeric_limits<uint32_t>::max()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Record is too large. Key: ", key));
+  }
+  const int64_t fingerprint = SortedSnapshotKeyFingerprint(key);
+  if (num_records_ > 0) {
+    if (fingerprint < last_fingerprint_ ||
+        (fingerprint == last_fingerprint_ && key <= last_key_)) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Records must be written in increasing key fingerprint order. Key: ",
+          key, " was written after key: ", last_key_));
+    }
+    // Records with the same fingerprint stay in the same block, so that
+    // lookups only need to scan a single block.
+    if (fingerprint != last_fingerprint_ &&
+        offset_ - index_.back().offset >=
+            static_cast<uint64_t>(block_options_.block_size_bytes)) {
+      FinishBlock();
+    }
+  }
+  if (block_fingerprints_.empty()) {
+    index_.push_back({.first_fingerprint = fingerprint, .offset = offset_});
+  }
+  const SortedSnapshotRecordHeader header = {
+      .fingerprint = fingerprint,
+      .key_size = static_cast<uint32_t>(key.size()),
+      .record_size = static_cast<uint32_t>(record_bytes.size()),
+  };
+  Write(&header, sizeof(header));
+  Write(key.data(), key.size());
+  WritePadding();
+  Write(record_bytes.data(), record_bytes.size());
+  WritePadding();
+  block_fingerprints_.push_back(fingerprint);
+  last_fingerprint_ = fingerprint;
+  last_key_ = key;
+  ++num_records_;
+  return status_;
+}
+
+absl::Status SortedSnapshotWriter::Flush() {
+  if (!dest_stream_.flush() && status_.ok()) {
+    status_ = absl::InternalError("Failed to flush the sorted snapshot.");
+  }
+  return status_;
+}
+
+void SortedSnapshotWriter::Close() {
+  if (!is_open_) {
+    return;
+  }
+  is_open_ = false;
+  if (!block_fingerprints_.empty()) {
+    FinishBlock();
+  }
+  SortedSnapshotFooter footer = {};
+  const std::string metadata = options_.metadata.SerializeAsString();
+  footer.metadata_offset = offset_;
+  footer.metadata_size = metadata.size();
+  Write(metadata.data(), metadata.size());
+  WritePadding();
+  footer.index_offset = offset_;
+  footer.num_blocks = index_.size();
+  Write(index_.data(), index_.size() * sizeof(SortedSnapshotBlockHandle));
+  footer.num_records = num_records_;
+  footer.num_filter_hashes = num_filter_hashes_;
+  footer.version = kSortedSnapshotFormatVersion;
+  std::memcpy(footer.magic, kSortedSnapshotMagic.data(), sizeof(footer.magic));
+  Write(&footer, sizeof(footer));
+  if (auto status = Flush(); !status.ok()) {
+    LOG(ERROR) << "Failed to close sorted snapshot writer: " << status;
+  }
+}
+
+void SortedSnapshotWriter::Write(const void* data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  dest_stream_.write(static_cast<const char*>(data), size);
+  offset_ += size;
+  if (!dest_stream_ && status_.ok()) {
+    status_ = absl::InternalError("Failed to write to the sorted snapshot.");
+  }
+}
+
+void SortedSnapshotWriter::WritePadding() {
+  static constexpr char kZeros[kSortedSnapshotAlignment] = {};
+  Write(kZeros, AlignSortedSnapshotOffset(offset_) - offset_);
+}
+
+void SortedSnapshotWriter::FinishBlock() {
+  SortedSnapshotBlockHandle& block = index_.back();
+  block.size = offset_ - block.offset;
+  std::vector<uint64_t> filter(
+      (block_fingerprints_.size() * block_options_.bloom_filter_bits_per_key +
+       63) /
+      64);
+  for (int64_t fingerprint : block_fingerprints_) {
+    AddToSortedSnapshotBloomFilter(fingerprint, num_filter_hashes_,
+                                   absl::MakeSpan(filter));
+  }
+  block.filter_offset = offset_;
+  block.filter_size = filter.size() * sizeof(uint64_t);
+  Write(filter.data(), block.filter_size);
+  block_fingerprints_.clear();
+}
+
+}  // namespace kv_server
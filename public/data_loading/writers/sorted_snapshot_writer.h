@@ -0,0 +1,94 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_DATA_LOADING_WRITERS_SORTED_SNAPSHOT_WRITER_H_
+#define PUBLIC_DATA_LOADING_WRITERS_SORTED_SNAPSHOT_WRITER_H_
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "public/data_loading/record_utils.h"
+#include "public/data_loading/sorted_snapshot_format.h"
+#include "public/data_loading/writers/delta_record_writer.h"
+
+namespace kv_server {
+
+// A `SortedSnapshotWriter` writes key value mutation records to a sorted
+// snapshot file, see `sorted_snapshot_format.h`. Records must be written in
+// increasing `(SortedSnapshotKeyFingerprint(key), key)` order, which is the
+// order in which `SnapshotStreamWriter` reads aggregated records when
+// `SnapshotStreamWriter::Options::sorted_snapshot` is set.
+//
+// Sorted snapshots only store key value mutation records; other records,
+// e.g., UDF configs, are skipped. The file is complete once the writer is
+// closed.
+//
+// NOTE: This class is not thread safe.
+class SortedSnapshotWriter : public DeltaRecordWriter {
+ public:
+  ~SortedSnapshotWriter() override { Close(); }
+
+  SortedSnapshotWriter(const SortedSnapshotWriter&) = delete;
+  SortedSnapshotWriter& operator=(const SortedSnapshotWriter&) = delete;
+
+  static absl::StatusOr<std::unique_ptr<SortedSnapshotWriter>> Create(
+      std::ostream& dest_stream, Options options,
+      SortedSnapshotBlockOptions block_options = {});
+
+  absl::Status WriteRecord(const DataRecordT& data_record) override;
+  // Writes a serialized `KeyValueMutationRecord` of `key`.
+  absl::Status WriteSerializedRecord(std::string_view key,
+                                     std::string_view record_bytes);
+  const Options& GetOptions() const override { return options_; }
+  absl::Status Flush() override;
+  // Writes the index and the footer of the sorted snapshot.
+  void Close() override;
+  bool IsOpen() override { return is_open_; }
+  absl::Status Status() override { return status_; }
+
+ private:
+  SortedSnapshotWriter(std::ostream& dest_stream, Options options,
+                       SortedSnapshotBlockOptions block_options);
+
+  void Write(const void* data, size_t size);
+  void WritePadding();
+  // Writes the Bloom filter of the current block and adds the block to the
+  // index.
+  void FinishBlock();
+
+  std::ostream& dest_stream_;
+  const Options options_;
+  const SortedSnapshotBlockOptions block_options_;
+  const int num_filter_hashes_;
+  bool is_open_ = true;
+  absl::Status status_;
+  uint64_t offset_ = 0;
+  int64_t num_records_ = 0;
+  int64_t last_fingerprint_ = 0;
+  std::string last_key_;
+  // Fingerprints of the records in the current block.
+  std::vector<int64_t> block_fingerprints_;
+  std::vector<SortedSnapshotBlockHandle> index_;
+};
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_WRITERS_SORTED_SNAPSHOT_WRITER_H_
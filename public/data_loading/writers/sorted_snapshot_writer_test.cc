@@ -0,0 +1,108 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/writers/sorted_snapshot_writer.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "public/data_loading/record_utils.h"
+
+namespace kv_server {
+namespace {
+
+DataRecordT GetDataRecord(std::string key) {
+  KeyValueMutationRecordT record = {
+      .mutation_type = KeyValueMutationType::Update,
+      .logical_commit_time = 10,
+      .key = std::move(key),
+  };
+  record.value.Set(StringValueT{.value = "value"});
+  DataRecordT data_record;
+  data_record.record.Set(std::move(record));
+  return data_record;
+}
+
+TEST(SortedSnapshotWriterTest, RejectsInvalidBlockOptions) {
+  std::stringstream stream;
+  EXPECT_EQ(SortedSnapshotWriter::Create(
+                stream, DeltaRecordWriter::Options{},
+                SortedSnapshotBlockOptions{.block_size_bytes = 0})
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(SortedSnapshotWriter::Create(
+                stream, DeltaRecordWriter::Options{},
+                SortedSnapshotBlockOptions{.bloom_filter_bits_per_key = 0})
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(SortedSnapshotWriterTest, RejectsRecordsOutOfOrder) {
+  std::stringstream stream;
+  auto writer =
+      SortedSnapshotWriter::Create(stream, DeltaRecordWriter::Options{});
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  std::string first_key = "key1";
+  std::string second_key = "key2";
+  if (SortedSnapshotKeyFingerprint(first_key) <
+      SortedSnapshotKeyFingerprint(second_key)) {
+    std::swap(first_key, second_key);
+  }
+  EXPECT_TRUE((*writer)->WriteRecord(GetDataRecord(first_key)).ok());
+  EXPECT_EQ((*writer)->WriteRecord(GetDataRecord(second_key)).code(),
+            absl::StatusCode::kInvalidArgument);
+  // Keys must also be unique.
+  EXPECT_EQ((*writer)->WriteRecord(GetDataRecord(first_key)).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(SortedSnapshotWriterTest, SkipsRecordsThatAreNotKeyValueMutations) {
+  std::stringstream stream;
+  auto writer =
+      SortedSnapshotWriter::Create(stream, DeltaRecordWriter::Options{});
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  DataRecordT data_record;
+  data_record.record.Set(UserDefinedFunctionsConfigT{});
+  EXPECT_TRUE((*writer)->WriteRecord(data_record).ok());
+  (*writer)->Close();
+  EXPECT_TRUE((*writer)->Status().ok());
+  SortedSnapshotFooter footer;
+  const std::string contents = stream.str();
+  ASSERT_GE(contents.size(), sizeof(footer));
+  std::memcpy(&footer, contents.data() + contents.size() - sizeof(footer),
+              sizeof(footer));
+  EXPECT_EQ(footer.num_records, 0);
+  EXPECT_EQ(footer.num_blocks, 0);
+}
+
+TEST(SortedSnapshotWriterTest, FailsToWriteAfterClosing) {
+  std::stringstream stream;
+  auto writer =
+      SortedSnapshotWriter::Create(stream, DeltaRecordWriter::Options{});
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  (*writer)->Close();
+  EXPECT_FALSE((*writer)->IsOpen());
+  EXPECT_EQ((*writer)->WriteRecord(GetDataRecord("key")).code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+}  // namespace
+}  // namespace kv_server
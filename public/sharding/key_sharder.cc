@@ -42,4 +42,13 @@ Shard KeySharder::GetShardNumForKey(std::string_view key,
                    sharding_function_.GetShardNumForKey(key, num_shards)};
 }
 
+std::optional<std::string> KeySharder::GetFingerprint(int num_shards) const {
+  if (shard_key_regex_.has_value()) {
+    // std::regex doesn't expose its pattern, so data locality sharding can't
+    // be fingerprinted.
+    return std::nullopt;
+  }
+  return sharding_function_.GetFingerprint(num_shards);
+}
+
 }  // namespace kv_server
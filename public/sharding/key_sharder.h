@@ -52,6 +52,11 @@ class KeySharder {
   // sharding key. Otherwise, the key itself is treated as the sharding
   // key.
   Shard GetShardNumForKey(std::string_view key, int num_shards) const;
+  // Returns a fingerprint of the key to shard mapping for `num_shards`, so
+  // that data sharded offline can be checked against this sharder. Returns
+  // nullopt if the mapping can't be fingerprinted, i.e., if `shard_key_regex`
+  // is set.
+  std::optional<std::string> GetFingerprint(int num_shards) const;
 
  private:
   ShardingFunction sharding_function_;
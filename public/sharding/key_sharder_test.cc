@@ -49,5 +49,13 @@ TEST(KeySharderTest, VerifyAssigningKeysToShardsWithRegex) {
 
 // try with regex which doesn't match
 
+TEST(KeySharderTest, VerifyFingerprints) {
+  KeySharder key_sharder(ShardingFunction(""));
+  EXPECT_EQ(key_sharder.GetFingerprint(7),
+            ShardingFunction("").GetFingerprint(7));
+  KeySharder regex_key_sharder(ShardingFunction(""), std::regex("(.*)_.*"));
+  EXPECT_EQ(regex_key_sharder.GetFingerprint(7), std::nullopt);
+}
+
 }  // namespace
 }  // namespace kv_server
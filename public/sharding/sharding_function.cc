@@ -16,14 +16,27 @@
 
 #include "public/sharding/sharding_function.h"
 
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+
 namespace kv_server {
+namespace {
+// Bump the version if the mapping from keys to shards changes for the same
+// seed and number of shards.
+constexpr std::string_view kShardingFunctionVersion = "sha256-v1";
+}  // namespace
 
 ShardingFunction::ShardingFunction(std::string seed)
-    : hash_function_(std::move(seed)) {}
+    : seed_(seed), hash_function_(std::move(seed)) {}
 
 int ShardingFunction::GetShardNumForKey(std::string_view key,
                                         int num_shards) const {
   return hash_function_(key, num_shards);
 }
 
+std::string ShardingFunction::GetFingerprint(int num_shards) const {
+  return absl::StrCat(kShardingFunctionVersion, ";seed=",
+                      absl::BytesToHexString(seed_), ";num_shards=", num_shards);
+}
+
 }  // namespace kv_server
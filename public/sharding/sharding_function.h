@@ -30,8 +30,12 @@ class ShardingFunction {
  public:
   explicit ShardingFunction(std::string seed);
   int GetShardNumForKey(std::string_view key, int num_shards) const;
+  // Returns a fingerprint that is equal for sharding functions that assign
+  // every key to the same shard number given `num_shards`.
+  std::string GetFingerprint(int num_shards) const;
 
  private:
+  std::string seed_;
   distributed_point_functions::SHA256HashFunction hash_function_;
 };
 
@@ -28,5 +28,14 @@ TEST(ShardingFunctionTest, VerifyAssigningKeysToShards) {
   EXPECT_EQ(1, func.GetShardNumForKey("key3", 7));
 }
 
+TEST(ShardingFunctionTest, VerifyFingerprints) {
+  EXPECT_EQ(ShardingFunction("").GetFingerprint(7),
+            ShardingFunction("").GetFingerprint(7));
+  EXPECT_NE(ShardingFunction("").GetFingerprint(7),
+            ShardingFunction("").GetFingerprint(8));
+  EXPECT_NE(ShardingFunction("").GetFingerprint(7),
+            ShardingFunction("seed").GetFingerprint(7));
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -24,6 +24,7 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/str_cat.h"
+#include "public/data_loading/csv/concurrent_csv_delta_record_reader.h"
 #include "public/data_loading/csv/csv_delta_record_stream_reader.h"
 #include "public/data_loading/csv/csv_delta_record_stream_writer.h"
 #include "public/data_loading/readers/avro_delta_record_stream_reader.h"
@@ -72,6 +73,11 @@ absl::Status ValidateParams(const FormatDataCommand::Params& params) {
         ". Valid inputs must satisfy the requirement: 0 <= shard_number < "
         "number_of_shards"));
   }
+  if (params.csv_reader_threads < 1) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("csv_reader_threads must be at least 1. Got: ",
+                     params.csv_reader_threads));
+  }
   return absl::OkStatus();
 }
 
@@ -123,13 +129,22 @@ absl::StatusOr<std::unique_ptr<DeltaRecordReader>> CreateRecordReader(
   if (lw_input_format == kCsvFormat) {
     PS_ASSIGN_OR_RETURN(auto record_type, GetRecordKind(params.record_type));
     PS_ASSIGN_OR_RETURN(auto csv_encoding, GetCsvEncoding(params.csv_encoding));
+    CsvDeltaRecordStreamReaderOptions csv_options{
+        .field_separator = params.csv_column_delimiter,
+        .value_separator = params.csv_value_delimiter,
+        .record_type = std::move(record_type),
+        .csv_encoding = std::move(csv_encoding),
+    };
+    if (params.csv_reader_threads > 1) {
+      return std::make_unique<ConcurrentCsvDeltaRecordReader>(
+          input_stream, ConcurrentCsvDeltaRecordReader::Options{
+                            .csv_options = std::move(csv_options),
+                            .num_worker_threads = params.csv_reader_threads,
+                            .preserve_order = params.preserve_record_order,
+                        });
+    }
     return std::make_unique<CsvDeltaRecordStreamReader<std::istream>>(
-        input_stream, CsvDeltaRecordStreamReader<std::istream>::Options{
-                          .field_separator = params.csv_column_delimiter,
-                          .value_separator = params.csv_value_delimiter,
-                          .record_type = std::move(record_type),
-                          .csv_encoding = std::move(csv_encoding),
-                      });
+        input_stream, std::move(csv_options));
   }
   if (lw_input_format == kDeltaFormat) {
     return std::make_unique<DeltaRecordStreamReader<std::istream>>(
@@ -161,6 +176,8 @@ absl::StatusOr<std::unique_ptr<DeltaRecordWriter>> CreateRecordWriter(
   if (params.shard_number >= 0) {
     auto* shard_metadata = metadata.mutable_sharding_metadata();
     shard_metadata->set_shard_num(params.shard_number);
+    shard_metadata->set_sharding_function_fingerprint(
+        ShardingFunction(/*seed=*/"").GetFingerprint(params.number_of_shards));
   }
   if (lw_output_format == kDeltaFormat) {
     return DeltaRecordStreamWriter<std::ostream>::Create(
@@ -63,6 +63,12 @@ class FormatDataCommand : public Command {
     std::string csv_encoding = "PLAINTEXT";
     int64_t shard_number = -1;
     int64_t number_of_shards = -1;
+    // Number of threads used to parse CSV input. If greater than 1, the input
+    // is split into chunks that are parsed concurrently.
+    int64_t csv_reader_threads = 1;
+    // If false, records parsed by multiple threads are written as soon as
+    // they are parsed, which may differ from the input order.
+    bool preserve_record_order = true;
   };
 
   static absl::StatusOr<std::unique_ptr<FormatDataCommand>> Create(
@@ -25,6 +25,7 @@
 #include "public/data_loading/csv/csv_delta_record_stream_writer.h"
 #include "public/data_loading/readers/delta_record_stream_reader.h"
 #include "public/data_loading/writers/delta_record_stream_writer.h"
+#include "public/sharding/sharding_function.h"
 #include "public/test_util/data_record.h"
 
 namespace kv_server {
@@ -97,6 +98,33 @@ TYPED_TEST(FormatDataCommandTest,
   EXPECT_TRUE(delta_reader.ReadRecords(record_callback.AsStdFunction()).ok());
 }
 
+TYPED_TEST(FormatDataCommandTest,
+           ValidateGeneratingCsvToDeltaData_KVMutations_ConcurrentReader) {
+  std::stringstream csv_stream;
+  std::stringstream delta_stream;
+  CsvDeltaRecordStreamWriter csv_writer(csv_stream);
+  const auto& record =
+      GetNativeDataRecord(GetKVMutationRecord(this->GetSampleRecordValue()));
+  EXPECT_TRUE(csv_writer.WriteRecord(record).ok());
+  EXPECT_TRUE(csv_writer.WriteRecord(record).ok());
+  EXPECT_TRUE(csv_writer.WriteRecord(record).ok());
+  csv_writer.Close();
+  auto params = GetParams();
+  params.csv_reader_threads = 4;
+  auto command = FormatDataCommand::Create(params, csv_stream, delta_stream);
+  EXPECT_TRUE(command.ok()) << command.status();
+  EXPECT_TRUE((*command)->Execute().ok());
+  DeltaRecordStreamReader delta_reader(delta_stream);
+  testing::MockFunction<absl::Status(const DataRecord&)> record_callback;
+  EXPECT_CALL(record_callback, Call)
+      .Times(3)
+      .WillRepeatedly([&record](const DataRecord& actual_record) {
+        EXPECT_EQ(*actual_record.UnPack(), record);
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(delta_reader.ReadRecords(record_callback.AsStdFunction()).ok());
+}
+
 TYPED_TEST(FormatDataCommandTest,
            ValidateGeneratingDeltaToCsvData_KvMutations) {
   std::stringstream delta_stream;
@@ -416,6 +444,8 @@ TEST(FormatDataCommandTest,
   auto metadata = delta_reader.ReadMetadata();
   EXPECT_TRUE(metadata.ok());
   EXPECT_EQ(metadata->sharding_metadata().shard_num(), 2);
+  EXPECT_EQ(metadata->sharding_metadata().sharding_function_fingerprint(),
+            ShardingFunction(/*seed=*/"").GetFingerprint(3));
   testing::MockFunction<absl::Status(const DataRecord&)> record_callback;
   EXPECT_CALL(record_callback, Call)
       .Times(3)
@@ -440,5 +470,16 @@ TEST(FormatDataCommandTest, ValidateIncorrectShardingMetadataParams) {
       << status;
 }
 
+TEST(FormatDataCommandTest, ValidateIncorrectCsvReaderThreadsParams) {
+  std::stringstream unused_stream;
+  auto params = GetParams();
+  params.csv_reader_threads = 0;
+  absl::Status status =
+      FormatDataCommand::Create(params, unused_stream, unused_stream).status();
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument) << status;
+  EXPECT_EQ(status.message(), "csv_reader_threads must be at least 1. Got: 0")
+      << status;
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -21,9 +21,12 @@
 #include <fstream>
 #include <functional>
 #include <memory>
+#include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -38,6 +41,7 @@
 #include "public/data_loading/riegeli_metadata.pb.h"
 #include "public/sharding/sharding_function.h"
 #include "src/telemetry/telemetry_provider.h"
+#include "src/util/status_macro/status_macros.h"
 
 namespace kv_server {
 namespace {
@@ -132,18 +136,24 @@ absl::StatusOr<KVFileMetadata> CreateSnapshotMetadata(
   if (params.shard_number >= 0) {
     auto* sharding_metadata = metadata.mutable_sharding_metadata();
     sharding_metadata->set_shard_num(params.shard_number);
+    sharding_metadata->set_sharding_function_fingerprint(
+        ShardingFunction(/*seed=*/"").GetFingerprint(params.number_of_shards));
   }
   return metadata;
 }
 
+// Writes the records of `record_reader` to `snapshot_writer`. If
+// `updated_keys` is set, the records are base snapshot records and only the
+// ones with updated keys are aggregated.
 absl::Status WriteRecordsToSnapshotStream(
     const GenerateSnapshotCommand::Params& params,
     DeltaRecordReader& record_reader,
-    SnapshotStreamWriter<std::ostream>& snapshot_writer) {
+    SnapshotStreamWriter<std::ostream>& snapshot_writer,
+    const absl::flat_hash_set<std::string>* updated_keys = nullptr) {
   ShardingFunction sharding_function(/*seed=*/"");
   return record_reader.ReadRecords(
-      [&params, &snapshot_writer,
-       &sharding_function](const DataRecord& data_record) {
+      [&params, &snapshot_writer, &sharding_function,
+       updated_keys](const DataRecord& data_record) {
         DataRecordT data_record_struct;
         data_record.UnPackTo(&data_record_struct);
         if (params.shard_number >= 0 &&
@@ -159,15 +169,17 @@ absl::Status WriteRecordsToSnapshotStream(
             return absl::OkStatus();
           }
         }
+        if (updated_keys != nullptr) {
+          return snapshot_writer.WriteBaseSnapshotRecord(data_record_struct,
+                                                         *updated_keys);
+        }
         return snapshot_writer.WriteRecord(data_record_struct);
       });
 }
 
-absl::StatusOr<std::string> WriteBaseSnapshotData(
+absl::StatusOr<std::string> ReadBaseSnapshotEndingDeltaFile(
     const GenerateSnapshotCommand::Params& params,
-    BlobStorageClient& blob_client,
-    SnapshotStreamWriter<std::ostream>& snapshot_writer) {
-  LOG(INFO) << "Compacting base snapshot file: " << params.starting_file;
+    BlobStorageClient& blob_client) {
   auto blob_reader = blob_client.GetBlobReader(
       {.bucket = params.data_dir.data(), .key = params.starting_file.data()});
   std::unique_ptr<DeltaRecordReader> record_reader =
@@ -176,23 +188,40 @@ absl::StatusOr<std::string> WriteBaseSnapshotData(
   if (!metadata.ok()) {
     return metadata.status();
   }
-  if (auto status =
-          WriteRecordsToSnapshotStream(params, *record_reader, snapshot_writer);
+  return metadata->snapshot().ending_delta_file();
+}
+
+absl::Status WriteBaseSnapshotData(
+    const GenerateSnapshotCommand::Params& params,
+    BlobStorageClient& blob_client,
+    SnapshotStreamWriter<std::ostream>& snapshot_writer,
+    const absl::flat_hash_set<std::string>* updated_keys) {
+  LOG(INFO) << "Compacting base snapshot file: " << params.starting_file;
+  auto blob_reader = blob_client.GetBlobReader(
+      {.bucket = params.data_dir.data(), .key = params.starting_file.data()});
+  std::unique_ptr<DeltaRecordReader> record_reader =
+      GetRecordReader(blob_reader->Stream(), params.file_format);
+  if (auto metadata = record_reader->ReadMetadata(); !metadata.ok()) {
+    return metadata.status();
+  }
+  if (auto status = WriteRecordsToSnapshotStream(
+          params, *record_reader, snapshot_writer, updated_keys);
       !status.ok()) {
     return status;
   }
   LOG(INFO) << "Successfully compacted base snapshot file: "
             << params.starting_file;
-  return metadata->snapshot().ending_delta_file();
+  return absl::OkStatus();
 }
 
-absl::Status WriteDeltaFilesToSnapshot(
+// Calls `callback` with a reader of each delta file in `delta_files` that is
+// within the range of delta files to compact.
+absl::Status ForEachDeltaFile(
     const std::vector<std::string>& delta_files,
     const GenerateSnapshotCommand::Params& params,
     BlobStorageClient& blob_client,
-    SnapshotStreamWriter<std::ostream>& snapshot_writer) {
+    const std::function<absl::Status(DeltaRecordReader&)>& callback) {
   for (const auto& delta_file : delta_files) {
-    LOG(INFO) << "Compacting delta file: " << delta_file;
     if (!IsDeltaFilename(delta_file)) {
       LOG(INFO) << "Skipping invalid delta filename: " << delta_file;
       continue;
@@ -206,15 +235,49 @@ absl::Status WriteDeltaFilesToSnapshot(
         {.bucket = params.data_dir.data(), .key = delta_file});
     std::unique_ptr<DeltaRecordReader> record_reader =
         GetRecordReader(blob_reader->Stream(), params.file_format);
-    if (auto status = WriteRecordsToSnapshotStream(params, *record_reader,
-                                                   snapshot_writer);
-        !status.ok()) {
+    LOG(INFO) << "Reading delta file: " << delta_file;
+    if (auto status = callback(*record_reader); !status.ok()) {
       return status;
     }
-    LOG(INFO) << "Successfully compacted delta file: " << delta_file;
+    LOG(INFO) << "Successfully read delta file: " << delta_file;
   }
   return absl::OkStatus();
 }
+
+absl::Status WriteDeltaFilesToSnapshot(
+    const std::vector<std::string>& delta_files,
+    const GenerateSnapshotCommand::Params& params,
+    BlobStorageClient& blob_client,
+    SnapshotStreamWriter<std::ostream>& snapshot_writer) {
+  return ForEachDeltaFile(
+      delta_files, params, blob_client,
+      [&params, &snapshot_writer](DeltaRecordReader& record_reader) {
+        return WriteRecordsToSnapshotStream(params, record_reader,
+                                            snapshot_writer);
+      });
+}
+
+// Returns the keys of all key value records in the delta files.
+absl::StatusOr<absl::flat_hash_set<std::string>> ReadUpdatedKeys(
+    const std::vector<std::string>& delta_files,
+    const GenerateSnapshotCommand::Params& params,
+    BlobStorageClient& blob_client) {
+  absl::flat_hash_set<std::string> updated_keys;
+  PS_RETURN_IF_ERROR(ForEachDeltaFile(
+      delta_files, params, blob_client,
+      [&updated_keys](DeltaRecordReader& record_reader) {
+        return record_reader.ReadRecords(
+            [&updated_keys](const DataRecord& data_record) {
+              if (const auto* kv_record =
+                      data_record.record_as_KeyValueMutationRecord();
+                  kv_record != nullptr && kv_record->key() != nullptr) {
+                updated_keys.insert(kv_record->key()->str());
+              }
+              return absl::OkStatus();
+            });
+      }));
+  return updated_keys;
+}
 }  // namespace
 
 GenerateSnapshotCommand::GenerateSnapshotCommand(
@@ -255,29 +318,47 @@ absl::Status GenerateSnapshotCommand::Execute() {
       {.metadata = *snapshot_metadata,
        .temp_data_file =
            params_.in_memory_compaction ? "" : GetTempAggregatorDbFile(params_),
-       .file_format = params_.file_format},
+       .compress_snapshot = params_.compression.algorithm !=
+                            RecordCompression::Algorithm::kNone,
+       .compression = params_.compression,
+       .file_format = params_.file_format,
+       .sort_merge_aggregation = params_.sort_merge_compaction},
       *snapshot_ostream);
   if (!snapshot_writer.ok()) {
     return snapshot_writer.status();
   }
-  std::string_view start_after_delta_file = params_.starting_file;
+  std::string start_after_delta_file = params_.starting_file;
   if (IsSnapshotFilename(params_.starting_file)) {
-    auto snapshot_end_file =
-        WriteBaseSnapshotData(params_, *blob_client_, **snapshot_writer);
-    if (!snapshot_end_file.ok()) {
-      return snapshot_end_file.status();
-    }
-    start_after_delta_file = *snapshot_end_file;
+    PS_ASSIGN_OR_RETURN(
+        start_after_delta_file,
+        ReadBaseSnapshotEndingDeltaFile(params_, *blob_client_));
   }
   auto delta_files =
       blob_client_->ListBlobs({.bucket = params_.data_dir},
                               {.prefix = FilePrefix<FileType::DELTA>().data(),
-                               .start_after = start_after_delta_file.data()});
+                               .start_after = start_after_delta_file});
   if (!delta_files.ok()) {
     return delta_files.status();
   }
   if (IsDeltaFilename(params_.starting_file)) {
-    delta_files->insert(delta_files->begin(), start_after_delta_file.data());
+    delta_files->insert(delta_files->begin(), start_after_delta_file);
+  }
+  if (IsSnapshotFilename(params_.starting_file)) {
+    // In incremental mode, delta files are read twice: once to find the keys
+    // they update and once to aggregate them. They are usually much smaller
+    // than the base snapshot, whose other records are only copied.
+    std::optional<absl::flat_hash_set<std::string>> updated_keys;
+    if (params_.incremental_compaction) {
+      PS_ASSIGN_OR_RETURN(updated_keys, ReadUpdatedKeys(*delta_files, params_,
+                                                        *blob_client_));
+      LOG(INFO) << "Delta files update " << updated_keys->size() << " keys.";
+    }
+    if (auto status = WriteBaseSnapshotData(
+            params_, *blob_client_, **snapshot_writer,
+            updated_keys.has_value() ? &*updated_keys : nullptr);
+        !status.ok()) {
+      return status;
+    }
   }
   if (auto status = WriteDeltaFilesToSnapshot(*delta_files, params_,
                                               *blob_client_, **snapshot_writer);
@@ -24,6 +24,7 @@
 #include "absl/status/statusor.h"
 #include "components/data/blob_storage/blob_storage_client.h"
 #include "public/constants.h"
+#include "public/data_loading/writers/record_compression.h"
 #include "public/data_loading/writers/snapshot_stream_writer.h"
 #include "tools/data_cli/commands/command.h"
 
@@ -38,9 +39,21 @@ class GenerateSnapshotCommand : public Command {
     std::string ending_delta_file;
     std::string snapshot_file;
     bool in_memory_compaction;
+    // If true, records are aggregated by sorting and merging them instead of
+    // through sqlite. Sorted runs are spilled to `working_dir` unless
+    // `in_memory_compaction` is true.
+    bool sort_merge_compaction = true;
+    // If true and `starting_file` is a snapshot, only records of keys that
+    // are updated by the delta files are aggregated, and all other records
+    // of the starting snapshot are copied to the new snapshot as is.
+    bool incremental_compaction = false;
     int64_t shard_number = -1;
     int64_t number_of_shards = -1;
     FileFormat file_format;
+    // Compression of riegeli snapshots. Snapshots are not compressed by
+    // default.
+    RecordCompression compression = {
+        .algorithm = RecordCompression::Algorithm::kNone};
   };
 
   ~GenerateSnapshotCommand();
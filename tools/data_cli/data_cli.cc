@@ -23,6 +23,7 @@
 #include "absl/log/initialize.h"
 #include "absl/log/log.h"
 #include "components/util/platform_initializer.h"
+#include "public/data_loading/writers/record_compression.h"
 #include "tools/data_cli/commands/command.h"
 #include "tools/data_cli/commands/format_data_command.h"
 #include "tools/data_cli/commands/generate_snapshot_command.h"
@@ -50,6 +51,11 @@ ABSL_FLAG(std::string, csv_encoding, "plaintext",
           "Encoding for KEY_VALUE_MUTATION_RECORD values for "
           "CSVs. options=(PLAINTEXT|BASE64)."
           "If the values are binary, BASE64 is recommended.");
+ABSL_FLAG(int64_t, csv_reader_threads, 1,
+          "Number of threads used to parse CSV input.");
+ABSL_FLAG(bool, preserve_record_order, true,
+          "If false and csv_reader_threads > 1, records may be written in a "
+          "different order than they appear in the CSV input.");
 
 // Flags for to generate_snapshot_command
 ABSL_FLAG(std::string, starting_file, "",
@@ -70,6 +76,16 @@ ABSL_FLAG(
 ABSL_FLAG(
     bool, in_memory_compaction, true,
     "If true, delta file compaction to generate snapshots is done in memory.");
+ABSL_FLAG(bool, sort_merge_compaction, false,
+          "If true, delta file compaction sorts and merges records instead of "
+          "aggregating them in sqlite.");
+ABSL_FLAG(bool, incremental_compaction, false,
+          "If true and the starting file is a snapshot, only records of keys "
+          "updated by the delta files are aggregated.");
+ABSL_FLAG(kv_server::RecordCompression, snapshot_compression,
+          {.algorithm = kv_server::RecordCompression::Algorithm::kNone},
+          "Compression of riegeli snapshots, formatted as "
+          "<algorithm>[:<level>]. options=(none|brotli|zstd|snappy)");
 
 // Flags for both format_data_command and generate_snapshot_command
 ABSL_FLAG(int64_t, shard_number, -1,
@@ -94,6 +110,9 @@ Commands:
     [--csv_encoding]     (Optional) Defaults to "PLAINTEXT". Encoding for KEY_VALUE_MUTATION_RECORD values for CSVs.
                                   Possible options=(PLAINTEXT|BASE64).
                                   If the values are binary, BASE64 is recommended.
+    [--csv_reader_threads] (Optional) Defaults to 1. Number of threads used to parse CSV input.
+    [--preserve_record_order] (Optional) Defaults to true. If false and --csv_reader_threads > 1,
+                                  output records may be written in a different order than the input.
     [--shard_number]     (Optional) Defaults to -1 (i.e., not specified).
     [--number_of_shards] (Optional) Defaults to -1 (i.e., not specified). Must be > --shard_number if shard_number >= 0.
   Examples:
@@ -119,6 +138,11 @@ Commands:
                                            File format of input and output files.
     [--working_dir]             (Optional) Defaults to "/tmp". Directory used to write temporary data.
     [--in_memory_compaction]    (Optional) Defaults to true. If false, file backed compaction is used.
+    [--sort_merge_compaction]   (Optional) Defaults to false. If true, records are sorted and merged instead of aggregated in sqlite.
+    [--incremental_compaction]  (Optional) Defaults to false. If true and --starting_file is a snapshot, its records
+                                           are copied unless the delta files update their keys.
+    [--snapshot_compression]    (Optional) Defaults to "none". Possible options=(none|brotli[:level]|zstd[:level]|snappy).
+                                           Compression of riegeli snapshots, e.g., "zstd:3".
     [--shard_number]            (Optional) Defaults to -1 (i.e., not specified).
     [--number_of_shards]        (Optional) Defaults to -1 (i.e., not specified). Must be > --shard_number if shard_number >= 0.
     [--number_of_shards]        (Optional) Defaults to -1 (i.e., not specified). Must be > --shard_number if shard_number >= 0.
@@ -192,6 +216,9 @@ int main(int argc, char** argv) {
             .csv_encoding = absl::GetFlag(FLAGS_csv_encoding),
             .shard_number = absl::GetFlag(FLAGS_shard_number),
             .number_of_shards = absl::GetFlag(FLAGS_number_of_shards),
+            .csv_reader_threads = absl::GetFlag(FLAGS_csv_reader_threads),
+            .preserve_record_order =
+                absl::GetFlag(FLAGS_preserve_record_order),
         },
         *i_stream, *o_stream);
     if (!format_data_command.ok()) {
@@ -213,9 +240,14 @@ int main(int argc, char** argv) {
             .ending_delta_file = absl::GetFlag(FLAGS_ending_delta_file),
             .snapshot_file = absl::GetFlag(FLAGS_snapshot_file),
             .in_memory_compaction = absl::GetFlag(FLAGS_in_memory_compaction),
+            .sort_merge_compaction =
+                absl::GetFlag(FLAGS_sort_merge_compaction),
+            .incremental_compaction =
+                absl::GetFlag(FLAGS_incremental_compaction),
             .shard_number = absl::GetFlag(FLAGS_shard_number),
             .number_of_shards = absl::GetFlag(FLAGS_number_of_shards),
             .file_format = absl::GetFlag(FLAGS_file_format),
+            .compression = absl::GetFlag(FLAGS_snapshot_compression),
         });
     if (!generate_snapshot_command.ok()) {
       LOG(ERROR) << "Failed to create command to generate snapshot. "